@@ -6412,12 +6412,6 @@ static INT LISTVIEW_HitTest(const LISTVIEW_INFO *infoPtr, LPLVHITTESTINFO lpht,
 }
 
 
-/* LISTVIEW_InsertCompare:  callback routine for comparing pszText members of the LV_ITEMS
-   in a LISTVIEW on insert.  Passed to DPA_Sort in LISTVIEW_InsertItem.
-   This function should only be used for inserting items into a sorted list (LVM_INSERTITEM)
-   and not during the processing of a LVM_SORTITEMS message. Applications should provide
-   their own sort proc. when sending LVM_SORTITEMS.
-*/
 /* Platform SDK:
     (remarks on LVITEM: LVM_INSERTITEM will insert the new item in the proper sort postion...
         if:
@@ -6428,14 +6422,42 @@ static INT LISTVIEW_HitTest(const LISTVIEW_INFO *infoPtr, LPLVHITTESTINFO lpht,
     (LVS_SORT* flags): "For the LVS_SORTASCENDING... styles, item indices
     are sorted based on item text..."
 */
-static INT WINAPI LISTVIEW_InsertCompare(  LPVOID first, LPVOID second,  LPARAM lParam)
+
+/***
+ * DESCRIPTION:
+ * Finds where a new item goes in a sorted listview (LVM_INSERTITEM), with a
+ * binary search on the item texts. Items that compare equal keep their
+ * insertion order. This is not used for LVM_SORTITEMS, applications provide
+ * their own sort proc for that.
+ *
+ * PARAMETER(S):
+ * [I] infoPtr : valid pointer to the listview structure
+ * [I] lpLVItem : item to insert
+ * [I] isW : TRUE if lpLVItem is Unicode, FALSE if it's ANSI
+ *
+ * RETURN:
+ *   Index at which the item must be inserted
+ */
+static INT LISTVIEW_GetSortedInsertPos(const LISTVIEW_INFO *infoPtr, const LVITEMW *lpLVItem, BOOL isW)
 {
-    ITEM_INFO* lv_first = (ITEM_INFO*) DPA_GetPtr( (HDPA)first, 0 );
-    ITEM_INFO* lv_second = (ITEM_INFO*) DPA_GetPtr( (HDPA)second, 0 );
-    INT cmpv = textcmpWT(lv_first->hdr.pszText, lv_second->hdr.pszText, TRUE); 
+    INT low = 0, high = infoPtr->nItemCount, mid, cmpv;
+    LPWSTR text = NULL;
+    ITEM_INFO *lpItem;
+
+    if (lpLVItem->mask & LVIF_TEXT) text = textdupTtoW(lpLVItem->pszText, isW);
+
+    while (low < high)
+    {
+        mid = (low + high) / 2;
+        lpItem = DPA_GetPtr( DPA_GetPtr(infoPtr->hdpaItems, mid), 0 );
+        cmpv = textcmpWT(lpItem->hdr.pszText, text, TRUE);
+        if (infoPtr->dwStyle & LVS_SORTDESCENDING) cmpv = -cmpv;
+        if (cmpv > 0) high = mid;
+        else low = mid + 1;
+    }
 
-    /* if we're sorting descending, negate the return value */
-    return (((const LISTVIEW_INFO *)lParam)->dwStyle & LVS_SORTDESCENDING) ? -cmpv : cmpv;
+    textfreeT(text, isW);
+    return low;
 }
 
 /***
@@ -6482,8 +6504,15 @@ static INT LISTVIEW_InsertItemT(LISTVIEW_INFO *infoPtr, const LVITEMW *lpLVItem,
 
     if (lpLVItem->iItem < 0 && !is_sorted) return -1;
 
-    nItem = is_sorted ? infoPtr->nItemCount : min(lpLVItem->iItem, infoPtr->nItemCount);
+    nItem = is_sorted ? LISTVIEW_GetSortedInsertPos(infoPtr, lpLVItem, isW) :
+                        min(lpLVItem->iItem, infoPtr->nItemCount);
     TRACE(" inserting at %d, sorted=%d, count=%d, iItem=%d\n", nItem, is_sorted, infoPtr->nItemCount, lpLVItem->iItem);
+
+    /* grow the arrays geometrically, bulk insertions would reallocate them every few items otherwise */
+    DPA_Grow( infoPtr->hdpaItems, infoPtr->nItemCount / 2 );
+    DPA_Grow( infoPtr->hdpaPosX, infoPtr->nItemCount / 2 );
+    DPA_Grow( infoPtr->hdpaPosY, infoPtr->nItemCount / 2 );
+
     nItem = DPA_InsertPtr( infoPtr->hdpaItems, nItem, hdpaSubItems );
     if (nItem == -1) goto fail;
     infoPtr->nItemCount++;
@@ -6517,14 +6546,6 @@ static INT LISTVIEW_InsertItemT(LISTVIEW_INFO *infoPtr, const LVITEMW *lpLVItem,
     }
     if (!set_main_item(infoPtr, &item, TRUE, isW, &has_changed)) goto undo;
 
-    /* if we're sorted, sort the list, and update the index */
-    if (is_sorted)
-    {
-	DPA_Sort( infoPtr->hdpaItems, LISTVIEW_InsertCompare, (LPARAM)infoPtr );
-	nItem = DPA_GetPtrIndex( infoPtr->hdpaItems, hdpaSubItems );
-	assert(nItem != -1);
-    }
-
     /* make room for the position, if we are in the right mode */
     if ((uView == LVS_SMALLICON) || (uView == LVS_ICON))
     {
@@ -1202,6 +1202,120 @@ static void test_multiselect(void)
     DestroyWindow(hwnd);
 }
 
+static void test_sorted_insert(void)
+{
+    static CHAR texts[][4] = { "c", "a", "b", "b", "0" };
+    static const int expected_pos[] = { 0, 0, 1, 2, 0 };
+    static const char *expected_order[] = { "0", "a", "b", "b", "c" };
+    static const int expected_param[] = { 4, 1, 2, 3, 0 };
+    HWND hwnd;
+    LVITEMA item;
+    CHAR buffer[16];
+    DWORD r;
+    int i;
+
+    hwnd = CreateWindowExA(0, WC_LISTVIEW, "foo",
+                           WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_SORTASCENDING,
+                           0, 0, 100, 100, hwndparent, NULL, GetModuleHandleA(NULL), NULL);
+    ok(hwnd != NULL, "failed to create a listview window\n");
+
+    for (i = 0; i < sizeof(texts)/sizeof(texts[0]); i++)
+    {
+        if (i == 4)
+        {
+            /* the focus must follow its item when an item is inserted before it */
+            ListView_SetItemState(hwnd, 3, LVIS_FOCUSED, LVIS_FOCUSED);
+            r = SendMessage(hwnd, LVM_GETNEXTITEM, -1, LVNI_FOCUSED);
+            expect(3, r);
+        }
+        item.mask = LVIF_TEXT | LVIF_PARAM;
+        item.iItem = 0;
+        item.iSubItem = 0;
+        item.pszText = texts[i];
+        item.lParam = i;
+        r = SendMessage(hwnd, LVM_INSERTITEMA, 0, (LPARAM)&item);
+        ok(r == expected_pos[i], "item %s: expected position %d, got %d\n", texts[i], expected_pos[i], r);
+    }
+
+    for (i = 0; i < sizeof(expected_order)/sizeof(expected_order[0]); i++)
+    {
+        item.mask = LVIF_TEXT | LVIF_PARAM;
+        item.iItem = i;
+        item.iSubItem = 0;
+        item.pszText = buffer;
+        item.cchTextMax = sizeof(buffer);
+        r = SendMessage(hwnd, LVM_GETITEMA, 0, (LPARAM)&item);
+        expect(TRUE, r);
+        ok(!strcmp(buffer, expected_order[i]), "item %d: expected %s, got %s\n", i, expected_order[i], buffer);
+        ok(item.lParam == expected_param[i], "item %d: expected param %d, got %ld\n", i, expected_param[i], item.lParam);
+    }
+
+    r = SendMessage(hwnd, LVM_GETNEXTITEM, -1, LVNI_FOCUSED);
+    expect(4, r);
+
+    DestroyWindow(hwnd);
+}
+
+/* Not a correctness test, traces the time taken by bulk insertions into a
+ * sorted listview. Each half takes about as long as the other when an
+ * insertion doesn't depend on the number of items already there. */
+static void test_sorted_insert_timing(void)
+{
+    const int count = 10000;
+    CHAR text[16], prev[16];
+    DWORD start = 0, elapsed[2];
+    unsigned int seed = 12345;
+    HWND hwnd;
+    LVITEMA item;
+    DWORD r;
+    int i;
+
+    if (!winetest_interactive)
+    {
+        skip("timing test, set WINETEST_INTERACTIVE to run it\n");
+        return;
+    }
+
+    hwnd = CreateWindowExA(0, WC_LISTVIEW, "foo",
+                           WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_SORTASCENDING,
+                           0, 0, 100, 100, hwndparent, NULL, GetModuleHandleA(NULL), NULL);
+    ok(hwnd != NULL, "failed to create a listview window\n");
+
+    SendMessage(hwnd, WM_SETREDRAW, FALSE, 0);
+    for (i = 0; i < count; i++)
+    {
+        if (i % (count / 2) == 0) start = GetTickCount();
+        seed = seed * 1103515245 + 12345;
+        sprintf(text, "%08x", seed);
+        item.mask = LVIF_TEXT;
+        item.iItem = i;
+        item.iSubItem = 0;
+        item.pszText = text;
+        r = SendMessage(hwnd, LVM_INSERTITEMA, 0, (LPARAM)&item);
+        ok(r != -1, "failed to insert item %d\n", i);
+        if (i % (count / 2) == count / 2 - 1) elapsed[i / (count / 2)] = GetTickCount() - start;
+    }
+    SendMessage(hwnd, WM_SETREDRAW, TRUE, 0);
+    trace("inserted %d sorted items, first half in %u ms, second half in %u ms\n",
+          count, elapsed[0], elapsed[1]);
+
+    r = SendMessage(hwnd, LVM_GETITEMCOUNT, 0, 0);
+    expect(count, r);
+    prev[0] = 0;
+    for (i = 0; i < count; i++)
+    {
+        item.iSubItem = 0;
+        item.pszText = text;
+        item.cchTextMax = sizeof(text);
+        SendMessage(hwnd, LVM_GETITEMTEXTA, i, (LPARAM)&item);
+        if (lstrcmpA(prev, text) > 0) break;
+        lstrcpyA(prev, text);
+    }
+    ok(i == count, "item %d (%s) is sorted after %s\n", i, text, prev);
+
+    DestroyWindow(hwnd);
+}
+
 START_TEST(listview)
 {
     HMODULE hComctl32;
@@ -1239,4 +1353,6 @@ START_TEST(listview)
     test_columns();
     test_getorigin();
     test_multiselect();
+    test_sorted_insert();
+    test_sorted_insert_timing();
 }
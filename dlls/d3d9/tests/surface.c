@@ -312,6 +312,62 @@ static void test_lockrect_invalid(IDirect3DDevice9 *device)
     IDirect3DSurface9_Release(surface);
 }
 
+/* a black and a white pixel stretched to 8 pixels, with bilinear filtering
+ * the middle pixels are gray and the colors don't decrease from left to right */
+static void test_stretchrect_filter(IDirect3DDevice9 *device)
+{
+    IDirect3DSurface9 *src = NULL, *dst = NULL;
+    D3DLOCKED_RECT locked_rect;
+    DWORD row[8], prev;
+    HRESULT hr;
+    int i;
+
+    hr = IDirect3DDevice9_CreateOffscreenPlainSurface(device, 2, 1, D3DFMT_X8R8G8B8, D3DPOOL_DEFAULT, &src, 0);
+    ok(SUCCEEDED(hr), "CreateOffscreenPlainSurface failed (%08x)\n", hr);
+    hr = IDirect3DDevice9_CreateOffscreenPlainSurface(device, 8, 1, D3DFMT_X8R8G8B8, D3DPOOL_DEFAULT, &dst, 0);
+    ok(SUCCEEDED(hr), "CreateOffscreenPlainSurface failed (%08x)\n", hr);
+    if (!src || !dst) goto done;
+
+    hr = IDirect3DSurface9_LockRect(src, &locked_rect, NULL, 0);
+    ok(SUCCEEDED(hr), "LockRect failed (%08x)\n", hr);
+    if (FAILED(hr)) goto done;
+    ((DWORD *)locked_rect.pBits)[0] = 0x00000000;
+    ((DWORD *)locked_rect.pBits)[1] = 0x00ffffff;
+    hr = IDirect3DSurface9_UnlockRect(src);
+    ok(SUCCEEDED(hr), "UnlockRect failed (%08x)\n", hr);
+
+    hr = IDirect3DDevice9_StretchRect(device, src, NULL, dst, NULL, D3DTEXF_LINEAR);
+    if (hr == D3DERR_INVALIDCALL)
+    {
+        skip("stretching between offscreen plain surfaces is not supported\n");
+        goto done;
+    }
+    ok(SUCCEEDED(hr), "StretchRect failed (%08x)\n", hr);
+
+    hr = IDirect3DSurface9_LockRect(dst, &locked_rect, NULL, D3DLOCK_READONLY);
+    ok(SUCCEEDED(hr), "LockRect failed (%08x)\n", hr);
+    if (FAILED(hr)) goto done;
+    memcpy(row, locked_rect.pBits, sizeof(row));
+    hr = IDirect3DSurface9_UnlockRect(dst);
+    ok(SUCCEEDED(hr), "UnlockRect failed (%08x)\n", hr);
+
+    ok((row[0] & 0xff) < 0x40, "left pixel is %08x\n", row[0]);
+    ok((row[7] & 0xff) > 0xc0, "right pixel is %08x\n", row[7]);
+    ok((row[2] & 0xff) > 0x10 && (row[2] & 0xff) < 0xf0, "pixel 2 is %08x\n", row[2]);
+    ok((row[3] & 0xff) > 0x10 && (row[3] & 0xff) < 0xf0, "pixel 3 is %08x\n", row[3]);
+    for (i = 0, prev = 0; i < 8; i++)
+    {
+        DWORD b = row[i] & 0xff, g = (row[i] >> 8) & 0xff, r = (row[i] >> 16) & 0xff;
+        ok(r == b && g == b, "pixel %d is %08x, expected gray\n", i, row[i]);
+        ok(b >= prev, "pixel %d is %08x, darker than the previous one\n", i, row[i]);
+        prev = b;
+    }
+
+done:
+    if (dst) IDirect3DSurface9_Release(dst);
+    if (src) IDirect3DSurface9_Release(src);
+}
+
 static unsigned long getref(IUnknown *iface)
 {
     IUnknown_AddRef(iface);
@@ -396,4 +452,5 @@ START_TEST(surface)
     test_lockrect_offset(device_ptr);
     test_lockrect_invalid(device_ptr);
     test_private_data(device_ptr);
+    test_stretchrect_filter(device_ptr);
 }
@@ -28,6 +28,8 @@
  * causes visible results in games can be tested in a way that does not depend on pixel exactness
  */
 
+#include <stdio.h>
+
 #define COBJMACROS
 #include <d3d9.h>
 #include <dxerr9.h>
@@ -4346,6 +4348,116 @@ static void test_constant_clamp_vs(IDirect3DDevice9 *device)
     IDirect3DVertexShader9_Release(shader_11);
 }
 
+static void shader_constant_reload_test(IDirect3DDevice9 *device)
+{
+    IDirect3DPixelShader9 *shader_mov, *shader_add;
+    HRESULT hr;
+    DWORD color;
+    DWORD shader_code_mov[] =  {
+        0xffff0101,                                         /* ps_1_1           */
+        0x00000001, 0x800f0000, 0xa0e40000,                 /* mov r0, c0       */
+        0x0000ffff                                          /* end              */
+    };
+    DWORD shader_code_add[] =  {
+        0xffff0101,                                         /* ps_1_1           */
+        0x00000002, 0x800f0000, 0xa0e40000, 0xa0e40001,     /* add r0, c0, c1   */
+        0x0000ffff                                          /* end              */
+    };
+    float quad1[] = {
+        -1.0,   -1.0,   0.1,
+         0.0,   -1.0,   0.1,
+        -1.0,    0.0,   0.1,
+         0.0,    0.0,   0.1
+    };
+    float quad2[] = {
+         0.0,   -1.0,   0.1,
+         1.0,   -1.0,   0.1,
+         0.0,    0.0,   0.1,
+         1.0,    0.0,   0.1
+    };
+    float quad3[] = {
+         0.0,    0.0,   0.1,
+         1.0,    0.0,   0.1,
+         0.0,    1.0,   0.1,
+         1.0,    1.0,   0.1
+    };
+    float quad4[] = {
+        -1.0,    0.0,   0.1,
+         0.0,    0.0,   0.1,
+        -1.0,    1.0,   0.1,
+         0.0,    1.0,   0.1
+    };
+    float red[4]   = {1.0, 0.0, 0.0, 1.0};
+    float green[4] = {0.0, 1.0, 0.0, 1.0};
+    float blue[4]  = {0.0, 0.0, 1.0, 1.0};
+    float zero[4]  = {0.0, 0.0, 0.0, 0.0};
+
+    /* Constants that were changed while another shader was in use have to reach the
+     * first shader when it is used again, even if only changed constants are uploaded
+     */
+    hr = IDirect3DDevice9_Clear(device, 0, NULL, D3DCLEAR_TARGET, 0xffffffff, 0.0, 0);
+    ok(hr == D3D_OK, "IDirect3DDevice9_Clear returned %s\n", DXGetErrorString9(hr));
+
+    hr = IDirect3DDevice9_CreatePixelShader(device, shader_code_mov, &shader_mov);
+    ok(hr == D3D_OK, "IDirect3DDevice9_CreatePixelShader returned %s\n", DXGetErrorString9(hr));
+    hr = IDirect3DDevice9_CreatePixelShader(device, shader_code_add, &shader_add);
+    ok(hr == D3D_OK, "IDirect3DDevice9_CreatePixelShader returned %s\n", DXGetErrorString9(hr));
+
+    hr = IDirect3DDevice9_SetPixelShaderConstantF(device, 1, zero, 1);
+    ok(hr == D3D_OK, "IDirect3DDevice9_SetPixelShaderConstantF returned %s\n", DXGetErrorString9(hr));
+    hr = IDirect3DDevice9_SetFVF(device, D3DFVF_XYZ);
+    ok(hr == D3D_OK, "IDirect3DDevice9_SetFVF returned %s\n", DXGetErrorString9(hr));
+
+    hr = IDirect3DDevice9_BeginScene(device);
+    ok(hr == D3D_OK, "IDirect3DDevice9_BeginScene returned %s\n", DXGetErrorString9(hr));
+    if(SUCCEEDED(hr))
+    {
+        hr = IDirect3DDevice9_SetPixelShaderConstantF(device, 0, red, 1);
+        ok(hr == D3D_OK, "IDirect3DDevice9_SetPixelShaderConstantF returned %s\n", DXGetErrorString9(hr));
+        hr = IDirect3DDevice9_SetPixelShader(device, shader_mov);
+        ok(hr == D3D_OK, "IDirect3DDevice9_SetPixelShader returned %s\n", DXGetErrorString9(hr));
+        hr = IDirect3DDevice9_DrawPrimitiveUP(device, D3DPT_TRIANGLESTRIP, 2, quad1, 3 * sizeof(float));
+        ok(hr == D3D_OK, "DrawPrimitiveUP failed (%08x)\n", hr);
+
+        hr = IDirect3DDevice9_SetPixelShader(device, shader_add);
+        ok(hr == D3D_OK, "IDirect3DDevice9_SetPixelShader returned %s\n", DXGetErrorString9(hr));
+        hr = IDirect3DDevice9_SetPixelShaderConstantF(device, 0, green, 1);
+        ok(hr == D3D_OK, "IDirect3DDevice9_SetPixelShaderConstantF returned %s\n", DXGetErrorString9(hr));
+        hr = IDirect3DDevice9_DrawPrimitiveUP(device, D3DPT_TRIANGLESTRIP, 2, quad2, 3 * sizeof(float));
+        ok(hr == D3D_OK, "DrawPrimitiveUP failed (%08x)\n", hr);
+
+        hr = IDirect3DDevice9_SetPixelShader(device, shader_mov);
+        ok(hr == D3D_OK, "IDirect3DDevice9_SetPixelShader returned %s\n", DXGetErrorString9(hr));
+        hr = IDirect3DDevice9_DrawPrimitiveUP(device, D3DPT_TRIANGLESTRIP, 2, quad3, 3 * sizeof(float));
+        ok(hr == D3D_OK, "DrawPrimitiveUP failed (%08x)\n", hr);
+
+        hr = IDirect3DDevice9_SetPixelShaderConstantF(device, 0, blue, 1);
+        ok(hr == D3D_OK, "IDirect3DDevice9_SetPixelShaderConstantF returned %s\n", DXGetErrorString9(hr));
+        hr = IDirect3DDevice9_DrawPrimitiveUP(device, D3DPT_TRIANGLESTRIP, 2, quad4, 3 * sizeof(float));
+        ok(hr == D3D_OK, "DrawPrimitiveUP failed (%08x)\n", hr);
+
+        hr = IDirect3DDevice9_EndScene(device);
+        ok(hr == D3D_OK, "IDirect3DDevice9_EndScene returned %s\n", DXGetErrorString9(hr));
+    }
+    hr = IDirect3DDevice9_Present(device, NULL, NULL, NULL, NULL);
+    ok(hr == D3D_OK, "IDirect3DDevice9_Present failed with %s\n", DXGetErrorString9(hr));
+
+    hr = IDirect3DDevice9_SetPixelShader(device, NULL);
+    ok(hr == D3D_OK, "IDirect3DDevice9_SetPixelShader returned %s\n", DXGetErrorString9(hr));
+
+    color = getPixelColor(device, 160, 360);
+    ok(color == 0x00ff0000, "quad 1 has color %08x, expected 0x00ff0000\n", color);
+    color = getPixelColor(device, 480, 360);
+    ok(color == 0x0000ff00, "quad 2 has color %08x, expected 0x0000ff00\n", color);
+    color = getPixelColor(device, 480, 120);
+    ok(color == 0x0000ff00, "quad 3 has color %08x, expected 0x0000ff00\n", color);
+    color = getPixelColor(device, 160, 120);
+    ok(color == 0x000000ff, "quad 4 has color %08x, expected 0x000000ff\n", color);
+
+    IDirect3DPixelShader9_Release(shader_mov);
+    IDirect3DPixelShader9_Release(shader_add);
+}
+
 static void constant_clamp_ps_test(IDirect3DDevice9 *device)
 {
     IDirect3DPixelShader9 *shader_11, *shader_12, *shader_14, *shader_20;
@@ -9213,12 +9325,415 @@ static void texop_test(IDirect3DDevice9 *device)
     if (vertex_declaration) IDirect3DVertexDeclaration9_Release(vertex_declaration);
 }
 
+/* Not a correctness test, traces the draw call rate of a scene of many small draws with
+ * state changes in between. Run it with and without the CSMT registry setting to compare.
+ */
+static void draw_rate_test(IDirect3DDevice9 *device)
+{
+    static const struct vertex quad[] =
+    {
+        {-1.0f, -1.0f,  0.1f,   0xff00ff00},
+        {-1.0f,  1.0f,  0.1f,   0xff00ff00},
+        { 1.0f, -1.0f,  0.1f,   0xff00ff00},
+        { 1.0f,  1.0f,  0.1f,   0xff00ff00},
+    };
+    static const D3DMATRIX identity =
+    {{{
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f,
+    }}};
+    static const WORD indices[] = {0, 1, 2, 3};
+    const unsigned int frames = 20, draws_per_frame = 1000;
+    IDirect3DVertexBuffer9 *vb = NULL;
+    IDirect3DIndexBuffer9 *ib = NULL;
+    unsigned int frame, i, indexed;
+    D3DMATRIX world;
+    DWORD start, elapsed, color, lighting;
+    HRESULT hr;
+    void *data;
+
+    if(!winetest_interactive) {
+        skip("draw rate test, set WINETEST_INTERACTIVE to run it\n");
+        return;
+    }
+
+    hr = IDirect3DDevice9_CreateVertexBuffer(device, sizeof(quad), 0, D3DFVF_XYZ | D3DFVF_DIFFUSE,
+                                              D3DPOOL_MANAGED, &vb, NULL);
+    ok(hr == D3D_OK, "CreateVertexBuffer failed with %s\n", DXGetErrorString9(hr));
+    if(!vb) {
+        skip("Failed to create a vertex buffer\n");
+        return;
+    }
+    hr = IDirect3DVertexBuffer9_Lock(vb, 0, sizeof(quad), &data, 0);
+    ok(hr == D3D_OK, "IDirect3DVertexBuffer9_Lock failed with %s\n", DXGetErrorString9(hr));
+    memcpy(data, quad, sizeof(quad));
+    hr = IDirect3DVertexBuffer9_Unlock(vb);
+    ok(hr == D3D_OK, "IDirect3DVertexBuffer9_Unlock failed with %s\n", DXGetErrorString9(hr));
+
+    hr = IDirect3DDevice9_CreateIndexBuffer(device, sizeof(indices), 0, D3DFMT_INDEX16,
+                                             D3DPOOL_MANAGED, &ib, NULL);
+    ok(hr == D3D_OK, "CreateIndexBuffer failed with %s\n", DXGetErrorString9(hr));
+    if(ib) {
+        hr = IDirect3DIndexBuffer9_Lock(ib, 0, sizeof(indices), &data, 0);
+        ok(hr == D3D_OK, "IDirect3DIndexBuffer9_Lock failed with %s\n", DXGetErrorString9(hr));
+        memcpy(data, indices, sizeof(indices));
+        hr = IDirect3DIndexBuffer9_Unlock(ib);
+        ok(hr == D3D_OK, "IDirect3DIndexBuffer9_Unlock failed with %s\n", DXGetErrorString9(hr));
+        hr = IDirect3DDevice9_SetIndices(device, ib);
+        ok(hr == D3D_OK, "IDirect3DDevice9_SetIndices failed with %s\n", DXGetErrorString9(hr));
+    }
+
+    IDirect3DDevice9_GetRenderState(device, D3DRS_LIGHTING, &lighting);
+    hr = IDirect3DDevice9_SetRenderState(device, D3DRS_LIGHTING, FALSE);
+    ok(hr == D3D_OK, "IDirect3DDevice9_SetRenderState failed with %s\n", DXGetErrorString9(hr));
+    hr = IDirect3DDevice9_SetStreamSource(device, 0, vb, 0, sizeof(quad[0]));
+    ok(hr == D3D_OK, "IDirect3DDevice9_SetStreamSource failed with %s\n", DXGetErrorString9(hr));
+    hr = IDirect3DDevice9_SetFVF(device, D3DFVF_XYZ | D3DFVF_DIFFUSE);
+    ok(hr == D3D_OK, "IDirect3DDevice9_SetFVF failed with %s\n", DXGetErrorString9(hr));
+
+    /* DrawIndexedPrimitive also passes the base vertex index to wined3d on every call */
+    for(indexed = 0; indexed < (ib ? 2 : 1); indexed++) {
+        start = GetTickCount();
+        for(frame = 0; frame < frames; frame++) {
+            hr = IDirect3DDevice9_Clear(device, 0, NULL, D3DCLEAR_TARGET, 0xff0000ff, 0.0, 0);
+            ok(hr == D3D_OK, "IDirect3DDevice9_Clear failed with %08x\n", hr);
+            hr = IDirect3DDevice9_BeginScene(device);
+            ok(hr == D3D_OK, "IDirect3DDevice9_BeginScene failed with %08x\n", hr);
+            if(FAILED(hr)) break;
+
+            /* Tiny quads scattered over the screen, each with its own world matrix and
+             * a render state toggle so that every draw has state to apply
+             */
+            world = identity;
+            U(world).m[0][0] = U(world).m[1][1] = 1.0f / 64.0f;
+            for(i = 0; i < draws_per_frame; i++) {
+                U(world).m[3][0] = ((i % 32) / 16.0f) - 0.97f;
+                U(world).m[3][1] = ((i / 32 % 32) / 16.0f) - 0.97f;
+                IDirect3DDevice9_SetTransform(device, D3DTS_WORLDMATRIX(0), &world);
+                IDirect3DDevice9_SetRenderState(device, D3DRS_DITHERENABLE, i & 1);
+                if(indexed) IDirect3DDevice9_DrawIndexedPrimitive(device, D3DPT_TRIANGLESTRIP, 0, 0, 4, 0, 2);
+                else IDirect3DDevice9_DrawPrimitive(device, D3DPT_TRIANGLESTRIP, 0, 2);
+            }
+
+            /* Cover the screen with the last draw so that the result can be checked */
+            IDirect3DDevice9_SetTransform(device, D3DTS_WORLDMATRIX(0), &identity);
+            if(indexed) hr = IDirect3DDevice9_DrawIndexedPrimitive(device, D3DPT_TRIANGLESTRIP, 0, 0, 4, 0, 2);
+            else hr = IDirect3DDevice9_DrawPrimitive(device, D3DPT_TRIANGLESTRIP, 0, 2);
+            ok(hr == D3D_OK, "Draw (indexed %u) failed with %08x\n", indexed, hr);
+
+            hr = IDirect3DDevice9_EndScene(device);
+            ok(hr == D3D_OK, "IDirect3DDevice9_EndScene failed with %08x\n", hr);
+            hr = IDirect3DDevice9_Present(device, NULL, NULL, NULL, NULL);
+            ok(hr == D3D_OK, "IDirect3DDevice9_Present failed with %08x\n", hr);
+        }
+        elapsed = GetTickCount() - start;
+
+        color = getPixelColor(device, 320, 240);
+        ok(color == 0x0000ff00, "Draw rate scene (indexed %u) has color 0x%08x, expected 0x0000ff00\n",
+           indexed, color);
+        trace("%s: %u frames of %u draws in %u ms, %u draws/s\n",
+              indexed ? "DrawIndexedPrimitive" : "DrawPrimitive", frame, draws_per_frame + 1, elapsed,
+              elapsed ? (unsigned int)(frame * (draws_per_frame + 1) * 1000.0 / elapsed) : 0);
+    }
+
+    IDirect3DDevice9_SetRenderState(device, D3DRS_DITHERENABLE, FALSE);
+    IDirect3DDevice9_SetRenderState(device, D3DRS_LIGHTING, lighting);
+    IDirect3DDevice9_SetStreamSource(device, 0, NULL, 0, 0);
+    IDirect3DDevice9_SetIndices(device, NULL);
+    if(ib) IDirect3DIndexBuffer9_Release(ib);
+    IDirect3DVertexBuffer9_Release(vb);
+}
+
+static void fill_vertex_buffer(IDirect3DVertexBuffer9 *vb, float left, float right, DWORD color)
+{
+    struct vertex *quad;
+    HRESULT hr;
+
+    hr = IDirect3DVertexBuffer9_Lock(vb, 0, 4 * sizeof(*quad), (void **)&quad, 0);
+    ok(hr == D3D_OK, "IDirect3DVertexBuffer9_Lock failed with %08x\n", hr);
+    if(FAILED(hr)) return;
+    quad[0].x = left;   quad[0].y = -1.0f;
+    quad[1].x = left;   quad[1].y =  1.0f;
+    quad[2].x = right;  quad[2].y = -1.0f;
+    quad[3].x = right;  quad[3].y =  1.0f;
+    quad[0].z = quad[1].z = quad[2].z = quad[3].z = 0.1f;
+    quad[0].diffuse = quad[1].diffuse = quad[2].diffuse = quad[3].diffuse = color;
+    hr = IDirect3DVertexBuffer9_Unlock(vb);
+    ok(hr == D3D_OK, "IDirect3DVertexBuffer9_Unlock failed with %08x\n", hr);
+}
+
+/* With the CSMT registry setting wined3d records the draws and replays them on another
+ * thread. Locks, query results and Present have to wait for it, check the pixels there.
+ * The draws come from a vertex buffer, draws from user memory are not recorded.
+ */
+static void command_stream_test(IDirect3DDevice9 *device)
+{
+    static const DWORD clear_colors[] = {0xffff0000, 0xff0000ff, 0xffffff00, 0xff00ffff};
+    static const DWORD quad_colors[] = {0xff00ff00, 0xffffffff, 0xff000000, 0xffff00ff};
+    IDirect3DSurface9 *backbuffer = NULL, *rt = NULL;
+    IDirect3DVertexBuffer9 *vb = NULL;
+    IDirect3DQuery9 *query = NULL;
+    DWORD color, lighting, samples;
+    unsigned int i;
+    HRESULT hr;
+
+    hr = IDirect3DDevice9_CreateVertexBuffer(device, 4 * sizeof(struct vertex), 0, D3DFVF_XYZ | D3DFVF_DIFFUSE,
+                                              D3DPOOL_MANAGED, &vb, NULL);
+    ok(hr == D3D_OK, "CreateVertexBuffer failed with %08x\n", hr);
+    hr = IDirect3DDevice9_GetBackBuffer(device, 0, 0, D3DBACKBUFFER_TYPE_MONO, &backbuffer);
+    ok(hr == D3D_OK, "GetBackBuffer failed with %08x\n", hr);
+    hr = IDirect3DDevice9_CreateRenderTarget(device, 640, 480, D3DFMT_A8R8G8B8, D3DMULTISAMPLE_NONE, 0, TRUE,
+                                             &rt, NULL);
+    ok(hr == D3D_OK, "CreateRenderTarget failed with %08x\n", hr);
+    if(!vb || !backbuffer || !rt) {
+        skip("Failed to create the resources\n");
+        goto out;
+    }
+
+    IDirect3DDevice9_GetRenderState(device, D3DRS_LIGHTING, &lighting);
+    IDirect3DDevice9_SetRenderState(device, D3DRS_LIGHTING, FALSE);
+    hr = IDirect3DDevice9_SetFVF(device, D3DFVF_XYZ | D3DFVF_DIFFUSE);
+    ok(hr == D3D_OK, "SetFVF failed with %08x\n", hr);
+    hr = IDirect3DDevice9_SetStreamSource(device, 0, vb, 0, sizeof(struct vertex));
+    ok(hr == D3D_OK, "SetStreamSource failed with %08x\n", hr);
+    hr = IDirect3DDevice9_SetIndices(device, NULL);
+    ok(hr == D3D_OK, "SetIndices failed with %08x\n", hr);
+    fill_vertex_buffer(vb, -1.0f, 0.0f, 0xff00ff00);
+
+    /* Lock: draw into a lockable render target and read it back right away */
+    hr = IDirect3DDevice9_SetRenderTarget(device, 0, rt);
+    ok(hr == D3D_OK, "SetRenderTarget failed with %08x\n", hr);
+    hr = IDirect3DDevice9_Clear(device, 0, NULL, D3DCLEAR_TARGET, 0xffff0000, 0.0, 0);
+    ok(hr == D3D_OK, "Clear failed with %08x\n", hr);
+    hr = IDirect3DDevice9_BeginScene(device);
+    ok(hr == D3D_OK, "BeginScene failed with %08x\n", hr);
+    if(SUCCEEDED(hr)) {
+        hr = IDirect3DDevice9_DrawIndexedPrimitive(device, D3DPT_TRIANGLESTRIP, 0, 0, 4, 0, 2);
+        ok(hr == D3DERR_INVALIDCALL, "DrawIndexedPrimitive without indices returned %08x\n", hr);
+        hr = IDirect3DDevice9_DrawPrimitive(device, D3DPT_TRIANGLESTRIP, 0, 2);
+        ok(hr == D3D_OK, "DrawPrimitive failed with %08x\n", hr);
+        hr = IDirect3DDevice9_EndScene(device);
+        ok(hr == D3D_OK, "EndScene failed with %08x\n", hr);
+    }
+    color = getPixelColorFromSurface(rt, 160, 240) & 0x00ffffff;
+    ok(color == 0x0000ff00, "Locked pixel 160x240 has color %08x, expected 0x0000ff00\n", color);
+    color = getPixelColorFromSurface(rt, 480, 240) & 0x00ffffff;
+    ok(color == 0x00ff0000, "Locked pixel 480x240 has color %08x, expected 0x00ff0000\n", color);
+
+    /* GetData: the occlusion query counts the samples of the draw before it */
+    hr = IDirect3DDevice9_CreateQuery(device, D3DQUERYTYPE_OCCLUSION, &query);
+    if(hr == D3D_OK && query) {
+        hr = IDirect3DDevice9_BeginScene(device);
+        ok(hr == D3D_OK, "BeginScene failed with %08x\n", hr);
+        hr = IDirect3DQuery9_Issue(query, D3DISSUE_BEGIN);
+        ok(hr == D3D_OK, "Issue(D3DISSUE_BEGIN) failed with %08x\n", hr);
+        hr = IDirect3DDevice9_DrawPrimitive(device, D3DPT_TRIANGLESTRIP, 0, 2);
+        ok(hr == D3D_OK, "DrawPrimitive failed with %08x\n", hr);
+        hr = IDirect3DQuery9_Issue(query, D3DISSUE_END);
+        ok(hr == D3D_OK, "Issue(D3DISSUE_END) failed with %08x\n", hr);
+        hr = IDirect3DDevice9_EndScene(device);
+        ok(hr == D3D_OK, "EndScene failed with %08x\n", hr);
+
+        samples = 0;
+        for(i = 0; i < 500; i++) {
+            hr = IDirect3DQuery9_GetData(query, &samples, sizeof(samples), D3DGETDATA_FLUSH);
+            if(hr != S_FALSE) break;
+            Sleep(10);
+        }
+        ok(hr == S_OK, "GetData failed with %08x\n", hr);
+        ok(samples == 320 * 480, "The query counted %u samples, expected %u\n", samples, 320 * 480);
+        IDirect3DQuery9_Release(query);
+    } else {
+        skip("Occlusion queries are not supported\n");
+    }
+
+    /* Present: more frames than the command stream lets the application run ahead */
+    hr = IDirect3DDevice9_SetRenderTarget(device, 0, backbuffer);
+    ok(hr == D3D_OK, "SetRenderTarget failed with %08x\n", hr);
+    for(i = 0; i < sizeof(clear_colors) / sizeof(clear_colors[0]); i++) {
+        fill_vertex_buffer(vb, -1.0f, 0.0f, quad_colors[i]);
+        hr = IDirect3DDevice9_Clear(device, 0, NULL, D3DCLEAR_TARGET, clear_colors[i], 0.0, 0);
+        ok(hr == D3D_OK, "Clear failed with %08x\n", hr);
+        hr = IDirect3DDevice9_BeginScene(device);
+        ok(hr == D3D_OK, "BeginScene failed with %08x\n", hr);
+        if(SUCCEEDED(hr)) {
+            hr = IDirect3DDevice9_DrawPrimitive(device, D3DPT_TRIANGLESTRIP, 0, 2);
+            ok(hr == D3D_OK, "DrawPrimitive failed with %08x\n", hr);
+            hr = IDirect3DDevice9_EndScene(device);
+            ok(hr == D3D_OK, "EndScene failed with %08x\n", hr);
+        }
+        hr = IDirect3DDevice9_Present(device, NULL, NULL, NULL, NULL);
+        ok(hr == D3D_OK, "Present failed with %08x\n", hr);
+
+        color = getPixelColor(device, 160, 240);
+        ok(color == (quad_colors[i] & 0x00ffffff), "Frame %u: pixel 160x240 has color %08x, expected %08x\n",
+           i, color, quad_colors[i] & 0x00ffffff);
+        color = getPixelColor(device, 480, 240);
+        ok(color == (clear_colors[i] & 0x00ffffff), "Frame %u: pixel 480x240 has color %08x, expected %08x\n",
+           i, color, clear_colors[i] & 0x00ffffff);
+    }
+
+    IDirect3DDevice9_SetStreamSource(device, 0, NULL, 0, 0);
+    IDirect3DDevice9_SetRenderState(device, D3DRS_LIGHTING, lighting);
+
+out:
+    if(rt) IDirect3DSurface9_Release(rt);
+    if(backbuffer) IDirect3DSurface9_Release(backbuffer);
+    if(vb) IDirect3DVertexBuffer9_Release(vb);
+}
+
+/* Runs in a child process started with CSMT enabled */
+static void command_stream_child(void)
+{
+    IDirect3DDevice9 *device;
+    D3DPRESENT_PARAMETERS present_parameters;
+    IDirect3DSwapChain9 *swapchain;
+
+    d3d9_handle = LoadLibraryA("d3d9.dll");
+    if(!d3d9_handle) {
+        skip("Could not load d3d9.dll\n");
+        return;
+    }
+    device = init_d3d9();
+    if(!device) {
+        skip("Creating the device failed\n");
+        return;
+    }
+
+    command_stream_test(device);
+
+    IDirect3DDevice9_GetSwapChain(device, 0, &swapchain);
+    IDirect3DSwapChain9_GetPresentParameters(swapchain, &present_parameters);
+    IDirect3DSwapChain9_Release(swapchain);
+    IDirect3DDevice9_Release(device);
+    DestroyWindow(present_parameters.hDeviceWindow);
+}
+
+static void test_command_stream(void)
+{
+    char cmdline[MAX_PATH + 32], old_value[20], **argv;
+    DWORD type, count;
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+    HKEY hkey;
+    LONG ret;
+
+    /* The setting is read when wined3d is loaded, so it takes a new process */
+    ret = RegCreateKeyA(HKEY_CURRENT_USER, "Software\\Wine\\Direct3D", &hkey);
+    ok(!ret, "RegCreateKeyA failed with %d\n", ret);
+    if(ret) return;
+    count = sizeof(old_value);
+    if(RegQueryValueExA(hkey, "CSMT", NULL, &type, (BYTE *)old_value, &count) || type != REG_SZ)
+        old_value[0] = 0;
+    RegSetValueExA(hkey, "CSMT", 0, REG_SZ, (const BYTE *)"enabled", sizeof("enabled"));
+
+    winetest_get_mainargs(&argv);
+    sprintf(cmdline, "\"%s\" visual csmt", argv[0]);
+    memset(&si, 0, sizeof(si));
+    si.cb = sizeof(si);
+    ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi);
+    ok(ret, "CreateProcess failed with %u\n", GetLastError());
+    if(ret) {
+        winetest_wait_child_process(pi.hProcess);
+        CloseHandle(pi.hProcess);
+        CloseHandle(pi.hThread);
+    }
+
+    if(old_value[0])
+        RegSetValueExA(hkey, "CSMT", 0, REG_SZ, (const BYTE *)old_value, strlen(old_value) + 1);
+    else
+        RegDeleteValueA(hkey, "CSMT");
+    RegCloseKey(hkey);
+}
+
+/* wined3d skips glEnable/glDisable calls that wouldn't change the GL state. Clears and blits
+ * change some of those states themselves, make sure blending is turned on again afterwards
+ * even though the application doesn't touch the blend states.
+ */
+static void redundant_state_test(IDirect3DDevice9 *device)
+{
+    static const struct vertex quad[] =
+    {
+        {-1.0f, -1.0f,  0.1f,   0x8000ff00},
+        {-1.0f,  1.0f,  0.1f,   0x8000ff00},
+        { 1.0f, -1.0f,  0.1f,   0x8000ff00},
+        { 1.0f,  1.0f,  0.1f,   0x8000ff00},
+    };
+    IDirect3DSurface9 *backbuffer = NULL, *offscreen = NULL;
+    DWORD color, lighting;
+    unsigned int i;
+    HRESULT hr;
+
+    hr = IDirect3DDevice9_GetBackBuffer(device, 0, 0, D3DBACKBUFFER_TYPE_MONO, &backbuffer);
+    ok(hr == D3D_OK, "GetBackBuffer failed with %08x\n", hr);
+    hr = IDirect3DDevice9_CreateOffscreenPlainSurface(device, 640, 480, D3DFMT_X8R8G8B8, D3DPOOL_DEFAULT,
+                                                      &offscreen, NULL);
+    ok(hr == D3D_OK, "CreateOffscreenPlainSurface failed with %08x\n", hr);
+    if(!backbuffer || !offscreen) {
+        skip("Failed to create the surfaces\n");
+        goto out;
+    }
+    hr = IDirect3DDevice9_ColorFill(device, offscreen, NULL, 0xffff0000);
+    ok(hr == D3D_OK, "ColorFill failed with %08x\n", hr);
+
+    IDirect3DDevice9_GetRenderState(device, D3DRS_LIGHTING, &lighting);
+    IDirect3DDevice9_SetRenderState(device, D3DRS_LIGHTING, FALSE);
+    IDirect3DDevice9_SetRenderState(device, D3DRS_ALPHABLENDENABLE, TRUE);
+    IDirect3DDevice9_SetRenderState(device, D3DRS_SRCBLEND, D3DBLEND_SRCALPHA);
+    IDirect3DDevice9_SetRenderState(device, D3DRS_DESTBLEND, D3DBLEND_INVSRCALPHA);
+    hr = IDirect3DDevice9_SetFVF(device, D3DFVF_XYZ | D3DFVF_DIFFUSE);
+    ok(hr == D3D_OK, "SetFVF failed with %08x\n", hr);
+
+    /* 0: plain clear, 1: clear after blending was applied once, 2: blit instead of a clear */
+    for(i = 0; i < 3; i++) {
+        if(i < 2) {
+            hr = IDirect3DDevice9_Clear(device, 0, NULL, D3DCLEAR_TARGET, 0xffff0000, 0.0, 0);
+            ok(hr == D3D_OK, "Clear failed with %08x\n", hr);
+        } else {
+            hr = IDirect3DDevice9_StretchRect(device, offscreen, NULL, backbuffer, NULL, D3DTEXF_NONE);
+            ok(hr == D3D_OK, "StretchRect failed with %08x\n", hr);
+        }
+
+        hr = IDirect3DDevice9_BeginScene(device);
+        ok(hr == D3D_OK, "BeginScene failed with %08x\n", hr);
+        if(SUCCEEDED(hr)) {
+            /* Set the state again, to the value it already has */
+            IDirect3DDevice9_SetRenderState(device, D3DRS_ALPHABLENDENABLE, TRUE);
+            hr = IDirect3DDevice9_DrawPrimitiveUP(device, D3DPT_TRIANGLESTRIP, 2, quad, sizeof(quad[0]));
+            ok(hr == D3D_OK, "DrawPrimitiveUP failed with %08x\n", hr);
+            hr = IDirect3DDevice9_EndScene(device);
+            ok(hr == D3D_OK, "EndScene failed with %08x\n", hr);
+        }
+        IDirect3DDevice9_Present(device, NULL, NULL, NULL, NULL);
+
+        color = getPixelColor(device, 320, 240);
+        ok(color_match(color, 0x007f8000, 2), "Pass %u: got color 0x%08x, expected 0x007f8000\n", i, color);
+    }
+
+    IDirect3DDevice9_SetRenderState(device, D3DRS_ALPHABLENDENABLE, FALSE);
+    IDirect3DDevice9_SetRenderState(device, D3DRS_LIGHTING, lighting);
+
+out:
+    if(offscreen) IDirect3DSurface9_Release(offscreen);
+    if(backbuffer) IDirect3DSurface9_Release(backbuffer);
+}
+
 START_TEST(visual)
 {
     IDirect3DDevice9 *device_ptr;
     D3DCAPS9 caps;
     HRESULT hr;
     DWORD color;
+    char **argv;
+    int argc;
+
+    argc = winetest_get_mainargs(&argv);
+    if(argc >= 3 && !strcmp(argv[2], "csmt")) {
+        command_stream_child();
+        return;
+    }
 
     d3d9_handle = LoadLibraryA("d3d9.dll");
     if (!d3d9_handle)
@@ -9308,6 +9823,9 @@ START_TEST(visual)
     pointsize_test(device_ptr);
     tssargtemp_test(device_ptr);
     np2_stretch_rect_test(device_ptr);
+    redundant_state_test(device_ptr);
+    command_stream_test(device_ptr);
+    draw_rate_test(device_ptr);
 
     if (caps.VertexShaderVersion >= D3DVS_VERSION(1, 1))
     {
@@ -9342,6 +9860,7 @@ START_TEST(visual)
         texdepth_test(device_ptr);
         texkill_test(device_ptr);
         x8l8v8u8_test(device_ptr);
+        shader_constant_reload_test(device_ptr);
         if (caps.PixelShaderVersion >= D3DPS_VERSION(1, 4)) {
             constant_clamp_ps_test(device_ptr);
             cnd_test(device_ptr);
@@ -9383,4 +9902,6 @@ cleanup:
         DestroyWindow(present_parameters.hDeviceWindow);
         ok(ref == 0, "The device was not properly freed: refcount %u\n", ref);
     }
+
+    test_command_stream();
 }
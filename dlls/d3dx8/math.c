@@ -112,7 +112,9 @@ FLOAT WINAPI D3DXMatrixfDeterminant(CONST D3DXMATRIX *pm)
 
 D3DXMATRIX* WINAPI D3DXMatrixInverse(D3DXMATRIX *pout, FLOAT *pdeterminant, CONST D3DXMATRIX *pm)
 {
+    static const FLOAT sign[4] = { 1.0f, -1.0f, 1.0f, -1.0f };
     int a, i, j;
+    D3DXMATRIX out;
     D3DXVECTOR4 v, vec[3];
     FLOAT det;
 
@@ -134,11 +136,13 @@ D3DXMATRIX* WINAPI D3DXMatrixInverse(D3DXMATRIX *pout, FLOAT *pdeterminant, CONS
       }
      }
     D3DXVec4Cross(&v, &vec[0], &vec[1], &vec[2]);
-    pout->u.m[0][i] = pow(-1.0f, i) * v.x / det;
-    pout->u.m[1][i] = pow(-1.0f, i) * v.y / det;
-    pout->u.m[2][i] = pow(-1.0f, i) * v.z / det;
-    pout->u.m[3][i] = pow(-1.0f, i) * v.w / det;
+    out.u.m[0][i] = sign[i] * v.x / det;
+    out.u.m[1][i] = sign[i] * v.y / det;
+    out.u.m[2][i] = sign[i] * v.z / det;
+    out.u.m[3][i] = sign[i] * v.w / det;
    }
+   /* pout may be the same matrix as pm */
+   *pout = out;
    return pout;
 }
 
@@ -202,15 +206,19 @@ D3DXMATRIX* WINAPI D3DXMatrixLookAtRH(D3DXMATRIX *pout, CONST D3DXVECTOR3 *peye,
 
 D3DXMATRIX* WINAPI D3DXMatrixMultiply(D3DXMATRIX *pout, CONST D3DXMATRIX *pm1, CONST D3DXMATRIX *pm2)
 {
+    D3DXMATRIX out;
     int i,j;
 
+    /* Computing into a local matrix lets pout be one of the operands, and
+     * lets the compiler keep the operands in registers */
     for (i=0; i<4; i++)
     {
      for (j=0; j<4; j++)
      {
-      pout->u.m[i][j] = pm1->u.m[i][0] * pm2->u.m[0][j] + pm1->u.m[i][1] * pm2->u.m[1][j] + pm1->u.m[i][2] * pm2->u.m[2][j] + pm1->u.m[i][3] * pm2->u.m[3][j];
+      out.u.m[i][j] = pm1->u.m[i][0] * pm2->u.m[0][j] + pm1->u.m[i][1] * pm2->u.m[1][j] + pm1->u.m[i][2] * pm2->u.m[2][j] + pm1->u.m[i][3] * pm2->u.m[3][j];
      }
     }
+    *pout = out;
     return pout;
 }
 
@@ -921,10 +929,13 @@ D3DXQUATERNION* WINAPI D3DXQuaternionLn(D3DXQUATERNION *pout, CONST D3DXQUATERNI
 
 D3DXQUATERNION* WINAPI D3DXQuaternionMultiply(D3DXQUATERNION *pout, CONST D3DXQUATERNION *pq1, CONST D3DXQUATERNION *pq2)
 {
-    pout->x = pq2->w * pq1->x + pq2->x * pq1->w + pq2->y * pq1->z - pq2->z * pq1->y;
-    pout->y = pq2->w * pq1->y - pq2->x * pq1->z + pq2->y * pq1->w + pq2->z * pq1->x;
-    pout->z = pq2->w * pq1->z + pq2->x * pq1->y - pq2->y * pq1->x + pq2->z * pq1->w;
-    pout->w = pq2->w * pq1->w - pq2->x * pq1->x - pq2->y * pq1->y - pq2->z * pq1->z;
+    D3DXQUATERNION out;
+
+    out.x = pq2->w * pq1->x + pq2->x * pq1->w + pq2->y * pq1->z - pq2->z * pq1->y;
+    out.y = pq2->w * pq1->y - pq2->x * pq1->z + pq2->y * pq1->w + pq2->z * pq1->x;
+    out.z = pq2->w * pq1->z + pq2->x * pq1->y - pq2->y * pq1->x + pq2->z * pq1->w;
+    out.w = pq2->w * pq1->w - pq2->x * pq1->x - pq2->y * pq1->y - pq2->z * pq1->z;
+    *pout = out;
     return pout;
 }
 
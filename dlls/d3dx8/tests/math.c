@@ -228,6 +228,9 @@ static void D3DXMatrixTest(void)
     D3DXMatrixInverse(&gotmat,&determinant,&mat);
     expect_mat(expectedmat,gotmat);
     ok(fabs( determinant - expectedfloat ) < admitted_error, "Expected: %f, Got: %f\n", expectedfloat, determinant);
+    gotmat = mat;
+    D3DXMatrixInverse(&gotmat,NULL,&gotmat);
+    expect_mat(expectedmat,gotmat);
     funcpointer = D3DXMatrixInverse(&gotmat,NULL,&mat2);
     ok(funcpointer == NULL, "Expected: %p, Got: %p\n", NULL, funcpointer);
 
@@ -272,6 +275,9 @@ static void D3DXMatrixTest(void)
     U(expectedmat).m[3][0] = -164.0f; U(expectedmat).m[3][1] = -320.0f; U(expectedmat).m[3][2] = 187.0f; U(expectedmat).m[3][3] = 31.0f;
     D3DXMatrixMultiply(&gotmat,&mat,&mat2);
     expect_mat(expectedmat,gotmat);
+    gotmat = mat;
+    D3DXMatrixMultiply(&gotmat,&gotmat,&mat2);
+    expect_mat(expectedmat,gotmat);
 
 /*____________D3DXMatrixMultiplyTranspose____*/
     U(expectedmat).m[0][0] = 73.0f; U(expectedmat).m[0][1] = 231.0f; U(expectedmat).m[0][2] = 239.0f; U(expectedmat).m[0][3] = -164.0f;
@@ -19,6 +19,9 @@
  */
 
 #include "config.h"
+
+#define NONAMELESSUNION
+
 #include "windef.h"
 #include "wingdi.h"
 #include "wine/debug.h"
@@ -26,6 +29,30 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3dx);
 
+/* The array functions below work on a local copy of the matrix: out may
+ * point anywhere, so the compiler would otherwise have to reload the matrix
+ * after every store. The input vector is read before the output is written,
+ * in and out can be the same array. */
+
+static inline void transform_coord3(D3DXVECTOR3 *out, const D3DXVECTOR3 *in, const D3DXMATRIX *m)
+{
+    FLOAT x = in->x, y = in->y, z = in->z, norm;
+
+    norm = m->u.m[0][3] * x + m->u.m[1][3] * y + m->u.m[2][3] * z + m->u.m[3][3];
+    if (norm)
+    {
+        out->x = (m->u.m[0][0] * x + m->u.m[1][0] * y + m->u.m[2][0] * z + m->u.m[3][0]) / norm;
+        out->y = (m->u.m[0][1] * x + m->u.m[1][1] * y + m->u.m[2][1] * z + m->u.m[3][1]) / norm;
+        out->z = (m->u.m[0][2] * x + m->u.m[1][2] * y + m->u.m[2][2] * z + m->u.m[3][2]) / norm;
+    }
+    else
+    {
+        out->x = 0.0f;
+        out->y = 0.0f;
+        out->z = 0.0f;
+    }
+}
+
 /*************************************************************************
  * D3DXVec2TransformArray
  *
@@ -35,13 +62,18 @@ D3DXVECTOR4* WINAPI D3DXVec2TransformArray(
     D3DXVECTOR4* out, UINT outstride, CONST D3DXVECTOR2* in, UINT instride,
     CONST D3DXMATRIX* matrix, UINT elements)
 {
+    D3DXMATRIX m = *matrix;
     unsigned int i;
     TRACE("\n");
     for (i = 0; i < elements; ++i) {
-        D3DXVec2Transform(
-            (D3DXVECTOR4*)((char*)out + outstride * i),
-            (CONST D3DXVECTOR2*)((const char*)in + instride * i),
-            matrix);
+        CONST D3DXVECTOR2 *v = (CONST D3DXVECTOR2*)((const char*)in + instride * i);
+        D3DXVECTOR4 *o = (D3DXVECTOR4*)((char*)out + outstride * i);
+        FLOAT x = v->x, y = v->y;
+
+        o->x = m.u.m[0][0] * x + m.u.m[1][0] * y + m.u.m[3][0];
+        o->y = m.u.m[0][1] * x + m.u.m[1][1] * y + m.u.m[3][1];
+        o->z = m.u.m[0][2] * x + m.u.m[1][2] * y + m.u.m[3][2];
+        o->w = m.u.m[0][3] * x + m.u.m[1][3] * y + m.u.m[3][3];
     }
     return out;
 }
@@ -53,13 +85,22 @@ D3DXVECTOR2* WINAPI D3DXVec2TransformCoordArray(
     D3DXVECTOR2* out, UINT outstride, CONST D3DXVECTOR2* in, UINT instride,
     CONST D3DXMATRIX* matrix, UINT elements)
 {
+    D3DXMATRIX m = *matrix;
     unsigned int i;
     TRACE("\n");
     for (i = 0; i < elements; ++i) {
-        D3DXVec2TransformCoord(
-            (D3DXVECTOR2*)((char*)out + outstride * i),
-            (CONST D3DXVECTOR2*)((const char*)in + instride * i),
-            matrix);
+        CONST D3DXVECTOR2 *v = (CONST D3DXVECTOR2*)((const char*)in + instride * i);
+        D3DXVECTOR2 *o = (D3DXVECTOR2*)((char*)out + outstride * i);
+        FLOAT x = v->x, y = v->y, norm;
+
+        norm = m.u.m[0][3] * x + m.u.m[1][3] * y + m.u.m[3][3];
+        if (norm) {
+            o->x = (m.u.m[0][0] * x + m.u.m[1][0] * y + m.u.m[3][0]) / norm;
+            o->y = (m.u.m[0][1] * x + m.u.m[1][1] * y + m.u.m[3][1]) / norm;
+        } else {
+            o->x = 0.0f;
+            o->y = 0.0f;
+        }
     }
     return out;
 }
@@ -71,13 +112,16 @@ D3DXVECTOR2* WINAPI D3DXVec2TransformNormalArray(
     D3DXVECTOR2* out, UINT outstride, CONST D3DXVECTOR2 *in, UINT instride,
     CONST D3DXMATRIX *matrix, UINT elements)
 {
+    D3DXMATRIX m = *matrix;
     unsigned int i;
     TRACE("\n");
     for (i = 0; i < elements; ++i) {
-        D3DXVec2TransformNormal(
-            (D3DXVECTOR2*)((char*)out + outstride * i),
-            (CONST D3DXVECTOR2*)((const char*)in + instride * i),
-            matrix);
+        CONST D3DXVECTOR2 *v = (CONST D3DXVECTOR2*)((const char*)in + instride * i);
+        D3DXVECTOR2 *o = (D3DXVECTOR2*)((char*)out + outstride * i);
+        FLOAT x = v->x, y = v->y;
+
+        o->x = m.u.m[0][0] * x + m.u.m[1][0] * y;
+        o->y = m.u.m[0][1] * x + m.u.m[1][1] * y;
     }
     return out;
 }
@@ -92,13 +136,21 @@ D3DXVECTOR3* WINAPI D3DXVec3ProjectArray(
     CONST D3DVIEWPORT9* viewport, CONST D3DXMATRIX* projection,
     CONST D3DXMATRIX* view, CONST D3DXMATRIX* world, UINT elements)
 {
+    D3DXMATRIX m;
+    D3DXVECTOR3 vec;
     unsigned int i;
     TRACE("\n");
+
+    /* same as D3DXVec3Project, with the matrices combined only once */
+    D3DXMatrixMultiply(&m, world, view);
+    D3DXMatrixMultiply(&m, &m, projection);
     for (i = 0; i < elements; ++i) {
-        D3DXVec3Project(
-            (D3DXVECTOR3*)((char*)out + outstride * i),
-            (CONST D3DXVECTOR3*)((const char*)in + instride * i),
-            viewport, projection, view, world);
+        D3DXVECTOR3 *o = (D3DXVECTOR3*)((char*)out + outstride * i);
+
+        transform_coord3(&vec, (CONST D3DXVECTOR3*)((const char*)in + instride * i), &m);
+        o->x = viewport->X +  ( 1.0f + vec.x ) * viewport->Width / 2.0f;
+        o->y = viewport->Y +  ( 1.0f - vec.y ) * viewport->Height / 2.0f;
+        o->z = viewport->MinZ + vec.z * ( viewport->MaxZ - viewport->MinZ );
     }
     return out;
 }
@@ -110,13 +162,18 @@ D3DXVECTOR4* WINAPI D3DXVec3TransformArray(
     D3DXVECTOR4* out, UINT outstride, CONST D3DXVECTOR3* in, UINT instride,
     CONST D3DXMATRIX* matrix, UINT elements)
 {
+    D3DXMATRIX m = *matrix;
     unsigned int i;
     TRACE("\n");
     for (i = 0; i < elements; ++i) {
-        D3DXVec3Transform(
-            (D3DXVECTOR4*)((char*)out + outstride * i),
-            (CONST D3DXVECTOR3*)((const char*)in + instride * i),
-            matrix);
+        CONST D3DXVECTOR3 *v = (CONST D3DXVECTOR3*)((const char*)in + instride * i);
+        D3DXVECTOR4 *o = (D3DXVECTOR4*)((char*)out + outstride * i);
+        FLOAT x = v->x, y = v->y, z = v->z;
+
+        o->x = m.u.m[0][0] * x + m.u.m[1][0] * y + m.u.m[2][0] * z + m.u.m[3][0];
+        o->y = m.u.m[0][1] * x + m.u.m[1][1] * y + m.u.m[2][1] * z + m.u.m[3][1];
+        o->z = m.u.m[0][2] * x + m.u.m[1][2] * y + m.u.m[2][2] * z + m.u.m[3][2];
+        o->w = m.u.m[0][3] * x + m.u.m[1][3] * y + m.u.m[2][3] * z + m.u.m[3][3];
     }
     return out;
 }
@@ -128,13 +185,14 @@ D3DXVECTOR3* WINAPI D3DXVec3TransformCoordArray(
     D3DXVECTOR3* out, UINT outstride, CONST D3DXVECTOR3* in, UINT instride,
     CONST D3DXMATRIX* matrix, UINT elements)
 {
+    D3DXMATRIX m = *matrix;
     unsigned int i;
     TRACE("\n");
     for (i = 0; i < elements; ++i) {
-        D3DXVec3TransformCoord(
+        transform_coord3(
             (D3DXVECTOR3*)((char*)out + outstride * i),
             (CONST D3DXVECTOR3*)((const char*)in + instride * i),
-            matrix);
+            &m);
     }
     return out;
 }
@@ -146,13 +204,17 @@ D3DXVECTOR3* WINAPI D3DXVec3TransformNormalArray(
     D3DXVECTOR3* out, UINT outstride, CONST D3DXVECTOR3* in, UINT instride,
     CONST D3DXMATRIX* matrix, UINT elements)
 {
+    D3DXMATRIX m = *matrix;
     unsigned int i;
     TRACE("\n");
     for (i = 0; i < elements; ++i) {
-        D3DXVec3TransformNormal(
-            (D3DXVECTOR3*)((char*)out + outstride * i),
-            (CONST D3DXVECTOR3*)((const char*)in + instride * i),
-            matrix);
+        CONST D3DXVECTOR3 *v = (CONST D3DXVECTOR3*)((const char*)in + instride * i);
+        D3DXVECTOR3 *o = (D3DXVECTOR3*)((char*)out + outstride * i);
+        FLOAT x = v->x, y = v->y, z = v->z;
+
+        o->x = m.u.m[0][0] * x + m.u.m[1][0] * y + m.u.m[2][0] * z;
+        o->y = m.u.m[0][1] * x + m.u.m[1][1] * y + m.u.m[2][1] * z;
+        o->z = m.u.m[0][2] * x + m.u.m[1][2] * y + m.u.m[2][2] * z;
     }
     return out;
 }
@@ -165,13 +227,25 @@ D3DXVECTOR3* WINAPI D3DXVec3UnprojectArray(
     CONST D3DVIEWPORT9* viewport, CONST D3DXMATRIX* projection,
     CONST D3DXMATRIX* view, CONST D3DXMATRIX* world, UINT elements)
 {
+    D3DXMATRIX m;
+    D3DXVECTOR3 vec;
     unsigned int i;
     TRACE("\n");
+
+    /* same as D3DXVec3Unproject, with the matrices combined and inverted only once */
+    D3DXMatrixMultiply(&m, world, view);
+    D3DXMatrixMultiply(&m, &m, projection);
+    if (!D3DXMatrixInverse(&m, NULL, &m)) {
+        WARN("Singular transformation matrix\n");
+        memset(&m, 0, sizeof(m));
+    }
     for (i = 0; i < elements; ++i) {
-        D3DXVec3Unproject(
-            (D3DXVECTOR3*)((char*)out + outstride * i),
-            (CONST D3DXVECTOR3*)((const char*)in + instride * i),
-            viewport, projection, view, world);
+        CONST D3DXVECTOR3 *v = (CONST D3DXVECTOR3*)((const char*)in + instride * i);
+
+        vec.x = 2.0f * ( v->x - viewport->X ) / viewport->Width - 1.0f;
+        vec.y = 1.0f - 2.0f * ( v->y - viewport->Y ) / viewport->Height;
+        vec.z = ( v->z - viewport->MinZ) / ( viewport->MaxZ - viewport->MinZ );
+        transform_coord3((D3DXVECTOR3*)((char*)out + outstride * i), &vec, &m);
     }
     return out;
 }
@@ -183,13 +257,18 @@ D3DXVECTOR4* WINAPI D3DXVec4TransformArray(
     D3DXVECTOR4* out, UINT outstride, CONST D3DXVECTOR4* in, UINT instride,
     CONST D3DXMATRIX* matrix, UINT elements)
 {
+    D3DXMATRIX m = *matrix;
     unsigned int i;
     TRACE("\n");
     for (i = 0; i < elements; ++i) {
-        D3DXVec4Transform(
-            (D3DXVECTOR4*)((char*)out + outstride * i),
-            (CONST D3DXVECTOR4*)((const char*)in + instride * i),
-            matrix);
+        CONST D3DXVECTOR4 *v = (CONST D3DXVECTOR4*)((const char*)in + instride * i);
+        D3DXVECTOR4 *o = (D3DXVECTOR4*)((char*)out + outstride * i);
+        FLOAT x = v->x, y = v->y, z = v->z, w = v->w;
+
+        o->x = m.u.m[0][0] * x + m.u.m[1][0] * y + m.u.m[2][0] * z + m.u.m[3][0] * w;
+        o->y = m.u.m[0][1] * x + m.u.m[1][1] * y + m.u.m[2][1] * z + m.u.m[3][1] * w;
+        o->z = m.u.m[0][2] * x + m.u.m[1][2] * y + m.u.m[2][2] * z + m.u.m[3][2] * w;
+        o->w = m.u.m[0][3] * x + m.u.m[1][3] * y + m.u.m[2][3] * z + m.u.m[3][3] * w;
     }
     return out;
 }
@@ -44,9 +44,6 @@
  *
  * These tests should check:
  *   That inp_vec is not modified.
- *   That the input and output arrays can be the same (MSDN
- *     says they can, and some testing with a native DLL
- *     says so too).
  */
 static void test_D3DXVec_Array(void)
 {
@@ -171,7 +168,112 @@ static void test_D3DXVec_Array(void)
     compare_vectors(exp_vec, out_vec);
 }
 
+/* The input and output arrays can be the same (MSDN says they can, and
+ * some testing with a native DLL says so too); the results must match the
+ * single vector functions. */
+#define SPEED_COUNT 4096
+
+/* values close to zero are compared with an absolute error */
+static BOOL compare_float(FLOAT exp, FLOAT out)
+{
+    return fabs(out - exp) <= admitted_error * max(1.0f, fabs(exp));
+}
+
+static BOOL compare_vec3(const D3DXVECTOR3 *exp, const D3DXVECTOR3 *out)
+{
+    return compare_float(exp->x, out->x) && compare_float(exp->y, out->y) &&
+           compare_float(exp->z, out->z);
+}
+
+static void test_D3DXVec_Array_inplace(void)
+{
+    D3DVIEWPORT9 viewport;
+    D3DXMATRIX mat, projection, view, world;
+    D3DXVECTOR3 eye, at, up, *vec, *exp;
+    DWORD start, elapsed;
+    unsigned int i, j;
+
+    vec = HeapAlloc(GetProcessHeap(), 0, SPEED_COUNT * sizeof(*vec));
+    exp = HeapAlloc(GetProcessHeap(), 0, SPEED_COUNT * sizeof(*exp));
+
+    viewport.Width = 800; viewport.MinZ = 0.2f; viewport.X = 10;
+    viewport.Height = 680; viewport.MaxZ = 0.9f; viewport.Y = 5;
+
+    D3DXMatrixPerspectiveFovLH(&projection, D3DX_PI/4.0f, 20.0f/17.0f, 1.0f, 1000.0f);
+    eye.x = 0.0f; eye.y = 5.0f; eye.z = -20.0f;
+    at.x = 0.0f; at.y = 0.0f; at.z = 0.0f;
+    up.x = 0.0f; up.y = 1.0f; up.z = 0.0f;
+    D3DXMatrixLookAtLH(&view, &eye, &at, &up);
+    D3DXMatrixRotationYawPitchRoll(&world, 0.3f, 0.2f, 0.1f);
+    D3DXMatrixMultiply(&mat, &world, &view);
+
+    for (i = 0; i < SPEED_COUNT; ++i) {
+        exp[i].x = (FLOAT)(i % 64) - 32.0f;
+        exp[i].y = (FLOAT)(i / 64) - 32.0f;
+        exp[i].z = (FLOAT)(i % 7);
+        vec[i] = exp[i];
+    }
+
+    D3DXVec3TransformCoordArray(vec, sizeof(*vec), vec, sizeof(*vec), &mat, SPEED_COUNT);
+    for (i = 0; i < SPEED_COUNT; ++i) {
+        D3DXVec3TransformCoord(&exp[i], &exp[i], &mat);
+        ok(compare_vec3(&exp[i], &vec[i]),
+           "Got (%f, %f, %f), expected (%f, %f, %f) for index %d.\n",
+           vec[i].x, vec[i].y, vec[i].z, exp[i].x, exp[i].y, exp[i].z, i);
+    }
+
+    D3DXVec3ProjectArray(vec, sizeof(*vec), vec, sizeof(*vec), &viewport, &projection, &view, &world, SPEED_COUNT);
+    for (i = 0; i < SPEED_COUNT; ++i) {
+        D3DXVec3Project(&exp[i], &exp[i], &viewport, &projection, &view, &world);
+        ok(compare_vec3(&exp[i], &vec[i]),
+           "Got (%f, %f, %f), expected (%f, %f, %f) for index %d.\n",
+           vec[i].x, vec[i].y, vec[i].z, exp[i].x, exp[i].y, exp[i].z, i);
+    }
+
+    D3DXVec3UnprojectArray(vec, sizeof(*vec), vec, sizeof(*vec), &viewport, &projection, &view, &world, SPEED_COUNT);
+    for (i = 0; i < SPEED_COUNT; ++i) {
+        D3DXVec3Unproject(&exp[i], &exp[i], &viewport, &projection, &view, &world);
+        ok(compare_vec3(&exp[i], &vec[i]),
+           "Got (%f, %f, %f), expected (%f, %f, %f) for index %d.\n",
+           vec[i].x, vec[i].y, vec[i].z, exp[i].x, exp[i].y, exp[i].z, i);
+    }
+
+    /* throughput of the array functions against a loop of single calls,
+     * only in interactive mode so that the normal test run stays fast */
+    if (winetest_interactive) {
+        start = GetTickCount();
+        for (j = 0; j < 256; ++j)
+            D3DXVec3TransformCoordArray(vec, sizeof(*vec), exp, sizeof(*exp), &mat, SPEED_COUNT);
+        elapsed = GetTickCount() - start;
+        trace("D3DXVec3TransformCoordArray: %u vectors in %u ms\n", 256 * SPEED_COUNT, elapsed);
+
+        start = GetTickCount();
+        for (j = 0; j < 256; ++j)
+            for (i = 0; i < SPEED_COUNT; ++i)
+                D3DXVec3TransformCoord(&vec[i], &exp[i], &mat);
+        elapsed = GetTickCount() - start;
+        trace("D3DXVec3TransformCoord: %u vectors in %u ms\n", 256 * SPEED_COUNT, elapsed);
+
+        start = GetTickCount();
+        for (j = 0; j < 64; ++j)
+            D3DXVec3ProjectArray(vec, sizeof(*vec), exp, sizeof(*exp), &viewport, &projection, &view, &world, SPEED_COUNT);
+        elapsed = GetTickCount() - start;
+        trace("D3DXVec3ProjectArray: %u vectors in %u ms\n", 64 * SPEED_COUNT, elapsed);
+
+        start = GetTickCount();
+        for (j = 0; j < 64; ++j)
+            for (i = 0; i < SPEED_COUNT; ++i)
+                D3DXVec3Project(&vec[i], &exp[i], &viewport, &projection, &view, &world);
+        elapsed = GetTickCount() - start;
+        trace("D3DXVec3Project: %u vectors in %u ms\n", 64 * SPEED_COUNT, elapsed);
+    }
+
+    HeapFree(GetProcessHeap(), 0, vec);
+    HeapFree(GetProcessHeap(), 0, exp);
+}
+
 START_TEST(math)
 {
     test_D3DXVec_Array();
+    test_D3DXVec_Array_inplace();
 }
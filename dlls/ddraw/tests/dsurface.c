@@ -2394,6 +2394,165 @@ static void BltParamTest(void)
     IDirectDrawSurface_Release(surface2);
 }
 
+static DWORD get_surface_pixel(IDirectDrawSurface *surface, int x, int y, int bpp)
+{
+    DDSURFACEDESC ddsd;
+    DWORD color = 0;
+    BYTE *p;
+    HRESULT rc;
+    int i;
+
+    memset(&ddsd, 0, sizeof(ddsd));
+    ddsd.dwSize = sizeof(ddsd);
+    rc = IDirectDrawSurface_Lock(surface, NULL, &ddsd, DDLOCK_WAIT | DDLOCK_READONLY, NULL);
+    ok(rc == DD_OK, "Lock returned: %x\n", rc);
+    if (FAILED(rc)) return 0xdeadbeef;
+    p = (BYTE *)ddsd.lpSurface + y * U1(ddsd).lPitch + x * (bpp / 8);
+    for (i = 0; i < bpp / 8 && i < 3; i++) color |= p[i] << (8 * i);
+    IDirectDrawSurface_Unlock(surface, NULL);
+    return color;
+}
+
+static void fill_surface(IDirectDrawSurface *surface, RECT *rect, DWORD color)
+{
+    DDBLTFX fx;
+    HRESULT rc;
+
+    memset(&fx, 0, sizeof(fx));
+    fx.dwSize = sizeof(fx);
+    U5(fx).dwFillColor = color;
+    rc = IDirectDrawSurface_Blt(surface, rect, NULL, NULL, DDBLT_COLORFILL | DDBLT_WAIT, &fx);
+    ok(rc == DD_OK, "Blt returned: %x\n", rc);
+}
+
+static void BltFormatTest(int bpp)
+{
+    static const struct
+    {
+        DWORD r, g, b;
+        DWORD key, sprite, fill;
+    } formats[] =
+    {
+        {0xf800, 0x07e0, 0x001f, 0xf81f, 0x1234, 0xcccc},
+        {0xff0000, 0x00ff00, 0x0000ff, 0xff00ff, 0x123456, 0xcccccc},
+    };
+    IDirectDrawSurface *src = NULL, *dst = NULL, *half = NULL;
+    RECT sprite = {100, 100, 200, 150};
+    RECT quarter = {0, 0, 320, 240};
+    DWORD key_color, sprite_color, fill_color, start, color;
+    DDSURFACEDESC ddsd;
+    DDCOLORKEY key;
+    HRESULT rc;
+    int i, f = bpp == 16 ? 0 : 1;
+
+    key_color = formats[f].key;
+    sprite_color = formats[f].sprite;
+    fill_color = formats[f].fill;
+
+    memset(&ddsd, 0, sizeof(ddsd));
+    ddsd.dwSize = sizeof(ddsd);
+    ddsd.dwFlags = DDSD_CAPS | DDSD_WIDTH | DDSD_HEIGHT | DDSD_PIXELFORMAT;
+    ddsd.ddsCaps.dwCaps = DDSCAPS_OFFSCREENPLAIN | DDSCAPS_SYSTEMMEMORY;
+    ddsd.dwWidth = 640;
+    ddsd.dwHeight = 480;
+    ddsd.ddpfPixelFormat.dwSize = sizeof(ddsd.ddpfPixelFormat);
+    ddsd.ddpfPixelFormat.dwFlags = DDPF_RGB;
+    U1(ddsd.ddpfPixelFormat).dwRGBBitCount = bpp;
+    U2(ddsd.ddpfPixelFormat).dwRBitMask = formats[f].r;
+    U3(ddsd.ddpfPixelFormat).dwGBitMask = formats[f].g;
+    U4(ddsd.ddpfPixelFormat).dwBBitMask = formats[f].b;
+    rc = IDirectDraw_CreateSurface(lpDD, &ddsd, &dst, NULL);
+    if (FAILED(rc))
+    {
+        skip("failed to create a %d bpp surface: %x\n", bpp, rc);
+        return;
+    }
+    rc = IDirectDraw_CreateSurface(lpDD, &ddsd, &src, NULL);
+    ok(rc == DD_OK, "CreateSurface returned: %x\n", rc);
+    ddsd.dwWidth = 320;
+    ddsd.dwHeight = 240;
+    rc = IDirectDraw_CreateSurface(lpDD, &ddsd, &half, NULL);
+    ok(rc == DD_OK, "CreateSurface returned: %x\n", rc);
+    if (!src || !half) goto done;
+
+    /* source filled with the key color with a sprite in the middle */
+    fill_surface(src, NULL, key_color);
+    fill_surface(src, &sprite, sprite_color);
+    key.dwColorSpaceLowValue = key.dwColorSpaceHighValue = key_color;
+    IDirectDrawSurface_SetColorKey(src, DDCKEY_SRCBLT, &key);
+
+    fill_surface(dst, NULL, fill_color);
+    color = get_surface_pixel(dst, 639, 479, bpp);
+    ok(color == fill_color, "%d bpp: got color %08x at 639,479\n", bpp, color);
+
+    rc = IDirectDrawSurface_Blt(dst, NULL, src, NULL, DDBLT_KEYSRC | DDBLT_WAIT, NULL);
+    ok(rc == DD_OK, "Blt returned: %x\n", rc);
+    color = get_surface_pixel(dst, 150, 120, bpp);
+    ok(color == sprite_color, "%d bpp: got color %08x at 150,120\n", bpp, color);
+    color = get_surface_pixel(dst, 50, 50, bpp);
+    ok(color == fill_color, "%d bpp: got color %08x at 50,50\n", bpp, color);
+
+    /* keyed fast blit of the sprite to another place */
+    fill_surface(dst, NULL, fill_color);
+    rc = IDirectDrawSurface_BltFast(dst, 10, 20, src, &sprite, DDBLTFAST_SRCCOLORKEY | DDBLTFAST_WAIT);
+    ok(rc == DD_OK, "BltFast returned: %x\n", rc);
+    color = get_surface_pixel(dst, 10, 20, bpp);
+    ok(color == sprite_color, "%d bpp: got color %08x at 10,20\n", bpp, color);
+    color = get_surface_pixel(dst, 109, 69, bpp);
+    ok(color == sprite_color, "%d bpp: got color %08x at 109,69\n", bpp, color);
+    color = get_surface_pixel(dst, 110, 20, bpp);
+    ok(color == fill_color, "%d bpp: got color %08x at 110,20\n", bpp, color);
+    color = get_surface_pixel(dst, 10, 70, bpp);
+    ok(color == fill_color, "%d bpp: got color %08x at 10,70\n", bpp, color);
+
+    /* 2x stretch of the top left quarter of the source */
+    rc = IDirectDrawSurface_BltFast(half, 0, 0, src, &quarter, DDBLTFAST_NOCOLORKEY | DDBLTFAST_WAIT);
+    ok(rc == DD_OK, "BltFast returned: %x\n", rc);
+    rc = IDirectDrawSurface_Blt(dst, NULL, half, NULL, DDBLT_WAIT, NULL);
+    ok(rc == DD_OK, "Blt returned: %x\n", rc);
+    color = get_surface_pixel(dst, 2 * 150, 2 * 120, bpp);
+    ok(color == sprite_color, "%d bpp: got color %08x at 300,240\n", bpp, color);
+    color = get_surface_pixel(dst, 2 * 99 + 1, 2 * 99 + 1, bpp);
+    ok(color == key_color, "%d bpp: got color %08x at 199,199\n", bpp, color);
+    color = get_surface_pixel(dst, 2 * 100, 2 * 100, bpp);
+    ok(color == sprite_color, "%d bpp: got color %08x at 200,200\n", bpp, color);
+
+    /* throughput, only in interactive mode so that the normal test run stays fast */
+    if (winetest_interactive)
+    {
+        start = GetTickCount();
+        for (i = 0; i < 100; i++) fill_surface(dst, NULL, fill_color);
+        trace("%d bpp: 100 640x480 color fills took %u ms\n", bpp, GetTickCount() - start);
+
+        start = GetTickCount();
+        for (i = 0; i < 100; i++)
+            IDirectDrawSurface_Blt(dst, NULL, src, NULL, DDBLT_KEYSRC | DDBLT_WAIT, NULL);
+        trace("%d bpp: 100 640x480 color keyed blits took %u ms\n", bpp, GetTickCount() - start);
+
+        start = GetTickCount();
+        for (i = 0; i < 100; i++)
+            IDirectDrawSurface_BltFast(dst, 0, 0, src, NULL, DDBLTFAST_SRCCOLORKEY | DDBLTFAST_WAIT);
+        trace("%d bpp: 100 640x480 color keyed fast blits took %u ms\n", bpp, GetTickCount() - start);
+
+        start = GetTickCount();
+        for (i = 0; i < 100; i++)
+            IDirectDrawSurface_Blt(dst, NULL, half, NULL, DDBLT_WAIT, NULL);
+        trace("%d bpp: 100 320x240 to 640x480 stretched blits took %u ms\n", bpp, GetTickCount() - start);
+    }
+
+done:
+    if (half) IDirectDrawSurface_Release(half);
+    if (src) IDirectDrawSurface_Release(src);
+    if (dst) IDirectDrawSurface_Release(dst);
+}
+
+static void BltFormatsTest(void)
+{
+    BltFormatTest(16);
+    BltFormatTest(24);
+    BltFormatTest(32);
+}
+
 static void PaletteTest(void)
 {
     HRESULT hr;
@@ -2629,6 +2788,7 @@ START_TEST(dsurface)
     SizeTest();
     PrivateDataTest();
     BltParamTest();
+    BltFormatsTest();
     StructSizeTest();
     PaletteTest();
     ReleaseDirectDraw();
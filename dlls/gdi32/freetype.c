@@ -282,6 +282,12 @@ typedef struct {
     BOOL init;
 } GM;
 
+/* cached result of get_glyph_index_linked for a BMP character */
+typedef struct {
+    GdiFont *font;     /* NULL if the character hasn't been looked up yet */
+    FT_UInt glyph;
+} CHAR_GLYPH;
+
 typedef struct {
     FLOAT eM11, eM12;
     FLOAT eM21, eM22;
@@ -305,10 +311,20 @@ typedef struct {
     GdiFont *font;
 } CHILD_FONT;
 
+#define CHAR_GLYPH_BLOCK_SIZE 256
+
+/* gm, gmsize, char_glyph and tm of a font and of its child fonts are
+ * protected by the cs of the base font, see lock_font().  FreeType calls and
+ * the other members are protected by freetype_cs, which can be taken while
+ * holding a font lock but not the other way round. */
 struct tagGdiFont {
     struct list entry;
+    CRITICAL_SECTION cs;
     GM **gm;
     DWORD gmsize;
+    CHAR_GLYPH *char_glyph[0x10000 / CHAR_GLYPH_BLOCK_SIZE];
+    TEXTMETRICW tm;          /* scaled text metrics, valid if tm_valid */
+    BOOL tm_valid;
     struct list hfontlist;
     OUTLINETEXTMETRICW *potm;
     DWORD total_kern_pairs;
@@ -461,12 +477,25 @@ static CRITICAL_SECTION_DEBUG critsect_debug =
 };
 static CRITICAL_SECTION freetype_cs = { &critsect_debug, -1, 0, 0, 0, 0 };
 
+/* child fonts share the lock of their base font */
+static inline void lock_font(GdiFont *font)
+{
+    EnterCriticalSection( &(font->base_font ? font->base_font : font)->cs );
+}
+
+static inline void unlock_font(GdiFont *font)
+{
+    LeaveCriticalSection( &(font->base_font ? font->base_font : font)->cs );
+}
+
 static const WCHAR font_mutex_nameW[] = {'_','_','W','I','N','E','_','F','O','N','T','_','M','U','T','E','X','_','_','\0'};
 
 static const WCHAR szDefaultFallbackLink[] = {'M','i','c','r','o','s','o','f','t',' ','S','a','n','s',' ','S','e','r','i','f',0};
 static BOOL use_default_fallback = FALSE;
 
 static BOOL get_glyph_index_linked(GdiFont *font, UINT c, GdiFont **linked_font, FT_UInt *glyph);
+static BOOL get_glyph_index_linked_cached(GdiFont *font, UINT c, GdiFont **linked_font, FT_UInt *glyph);
+static void init_glyph_cache(void);
 
 /****************************************
  *   Notes on .fon files
@@ -2647,6 +2676,7 @@ BOOL WineEngInit(void)
     update_reg_entries();
 
     init_system_links();
+    init_glyph_cache();
     
     ReleaseMutex(font_mutex);
     return TRUE;
@@ -2844,6 +2874,8 @@ static GdiFont *alloc_font(void)
     ret->kern_pairs = NULL;
     list_init(&ret->hfontlist);
     list_init(&ret->child_fonts);
+    InitializeCriticalSection(&ret->cs);
+    ret->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": GdiFont.cs");
     return ret;
 }
 
@@ -2877,7 +2909,11 @@ static void free_font(GdiFont *font)
     for (i = 0; i < font->gmsize; i++)
         HeapFree(GetProcessHeap(),0,font->gm[i]);
     HeapFree(GetProcessHeap(), 0, font->gm);
+    for (i = 0; i < sizeof(font->char_glyph) / sizeof(font->char_glyph[0]); i++)
+        HeapFree(GetProcessHeap(), 0, font->char_glyph[i]);
     HeapFree(GetProcessHeap(), 0, font->GSUB_Table);
+    font->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection(&font->cs);
     HeapFree(GetProcessHeap(), 0, font);
 }
 
@@ -4270,17 +4306,205 @@ static inline BOOL is_identity_MAT2(const MAT2 *matrix)
     return !memcmp(matrix, &identity, sizeof(MAT2));
 }
 
-/*************************************************************
- * WineEngGetGlyphOutline
+/****************************************
+ *   Shared glyph bitmap cache
  *
- * Behaves in exactly the same way as the win32 api GetGlyphOutline
- * except that the first parameter is the HWINEENGFONT of the font in
- * question rather than an HDC.
+ * Rendered glyph bitmaps can be kept in a named section shared by all the
+ * processes of the session, so that a glyph is only rasterized once per
+ * session instead of once per process.  It is disabled unless the
+ * GlyphCacheSize value (in Kb) is set under HKCU\Software\Wine\Fonts.
  *
+ * The section is a set-associative table of fixed size slots.  Each slot
+ * is protected by a sequence count which is odd while the slot is being
+ * written: readers don't lock, they copy the slot and then check that the
+ * count hasn't changed, writers skip the slot if they can't bump the count.
+ * A slot is evicted from its set on a least recently used basis.
  */
-DWORD WineEngGetGlyphOutline(GdiFont *incoming_font, UINT glyph, UINT format,
-			     LPGLYPHMETRICS lpgm, DWORD buflen, LPVOID buf,
-			     const MAT2* lpmat)
+
+#define GLYPH_CACHE_MAGIC     0x48434c47  /* "GLCH" */
+#define GLYPH_CACHE_WAYS      4
+#define GLYPH_CACHE_DATA_SIZE 1024
+
+struct glyph_cache_key
+{
+    ULONGLONG    dev;          /* font file */
+    ULONGLONG    ino;
+    LONG         face_index;
+    LONG         x_scale;      /* size the face is scaled to */
+    LONG         y_scale;
+    LONG         xx, xy, yx, yy; /* transformation applied to the outline */
+    BOOL         transform;
+    UINT         load_flags;
+    UINT         format;       /* GGO_ bitmap format */
+    UINT         glyph;        /* FreeType glyph index */
+};
+
+struct glyph_cache_slot
+{
+    LONG                   seq;       /* odd while the slot is being written */
+    LONG                   last_used;
+    DWORD                  hash;      /* 0 if the slot is empty */
+    struct glyph_cache_key key;
+    GLYPHMETRICS           gm;
+    INT                    adv, lsb, bbx;
+    DWORD                  size;
+    BYTE                   data[GLYPH_CACHE_DATA_SIZE];
+};
+
+struct glyph_cache
+{
+    LONG                    magic;      /* set once the header is initialized */
+    DWORD                   sets;
+    LONG                    clock;      /* incremented on every store */
+    LONG                    hits;       /* statistics, for all processes */
+    LONG                    misses;
+    LONG                    stores;
+    LONG                    evictions;
+    struct glyph_cache_slot slots[1];
+};
+
+static const WCHAR glyph_cache_nameW[] = {'_','_','W','I','N','E','_','G','L','Y','P','H','_',
+                                          'C','A','C','H','E','_','_',0};
+static struct glyph_cache *glyph_cache;
+
+static void init_glyph_cache(void)
+{
+    HKEY hkey;
+    char buffer[20];
+    DWORD type, count = sizeof(buffer), size = 0, sets;
+    HANDLE mapping;
+    struct glyph_cache *cache;
+
+    /* @@ Wine registry key: HKCU\Software\Wine\Fonts */
+    if (!RegOpenKeyA(HKEY_CURRENT_USER, "Software\\Wine\\Fonts", &hkey))
+    {
+        if (!RegQueryValueExA(hkey, "GlyphCacheSize", 0, &type, (LPBYTE)buffer, &count) &&
+            type == REG_SZ)
+            size = atoi(buffer) * 1024;
+        RegCloseKey(hkey);
+    }
+    sets = size / (GLYPH_CACHE_WAYS * sizeof(struct glyph_cache_slot));
+    if (!sets) return;
+    size = FIELD_OFFSET(struct glyph_cache, slots[sets * GLYPH_CACHE_WAYS]);
+
+    /* the section may already have been created with another size, its
+     * header is the authority */
+    if (!(mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, size,
+                                       glyph_cache_nameW)))
+    {
+        WARN("failed to create the glyph cache section: %u\n", GetLastError());
+        return;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS) sets = 0;
+    cache = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!cache) return;
+
+    if (sets)
+    {
+        cache->sets = sets;
+        InterlockedExchange(&cache->magic, GLYPH_CACHE_MAGIC);
+    }
+    TRACE("using glyph cache %p, %u sets\n", cache, cache->sets);
+    glyph_cache = cache;
+}
+
+static inline BOOL glyph_cache_ready(void)
+{
+    return glyph_cache && glyph_cache->magic == GLYPH_CACHE_MAGIC;
+}
+
+static DWORD hash_glyph_cache_key(const struct glyph_cache_key *key)
+{
+    const BYTE *p = (const BYTE *)key;
+    DWORD i, hash = 2166136261u;
+
+    for (i = 0; i < sizeof(*key); i++) hash = (hash ^ p[i]) * 16777619;
+    return hash | 1;
+}
+
+static inline struct glyph_cache_slot *glyph_cache_set(DWORD hash)
+{
+    return &glyph_cache->slots[(hash % glyph_cache->sets) * GLYPH_CACHE_WAYS];
+}
+
+/* fills the metrics and the bitmap from the cache, buf can be NULL if only
+ * the size is needed; returns FALSE if the glyph isn't cached */
+static BOOL lookup_glyph_cache(const struct glyph_cache_key *key, GLYPHMETRICS *gm,
+                               INT *adv, INT *lsb, INT *bbx, BYTE *buf, DWORD buflen,
+                               DWORD *needed)
+{
+    struct glyph_cache_slot *slot;
+    DWORD hash = hash_glyph_cache_key(key), size;
+    LONG seq;
+    int i;
+
+    slot = glyph_cache_set(hash);
+    for (i = 0; i < GLYPH_CACHE_WAYS; i++, slot++)
+    {
+        seq = slot->seq;
+        if ((seq & 1) || slot->hash != hash || memcmp(&slot->key, key, sizeof(*key))) continue;
+        /* a writer can change the size at any time, read it only once */
+        size = *(volatile DWORD *)&slot->size;
+        if (size > GLYPH_CACHE_DATA_SIZE || (buf && buflen < size)) break;
+
+        *gm = slot->gm;
+        *adv = slot->adv;
+        *lsb = slot->lsb;
+        *bbx = slot->bbx;
+        *needed = size;
+        if (buf) memcpy(buf, slot->data, size);
+
+        /* the interlocked operation doubles as a memory barrier */
+        if (InterlockedCompareExchange(&slot->seq, seq, seq) != seq) break;
+        slot->last_used = glyph_cache->clock;
+        InterlockedIncrement(&glyph_cache->hits);
+        return TRUE;
+    }
+    if (!(InterlockedIncrement(&glyph_cache->misses) % 1024))
+        TRACE("glyph cache: %d hits, %d misses, %d stores, %d evictions\n",
+              glyph_cache->hits, glyph_cache->misses, glyph_cache->stores, glyph_cache->evictions);
+    return FALSE;
+}
+
+static void store_glyph_cache(const struct glyph_cache_key *key, const GLYPHMETRICS *gm,
+                              INT adv, INT lsb, INT bbx, const BYTE *buf, DWORD size)
+{
+    struct glyph_cache_slot *slot, *victim = NULL;
+    DWORD hash = hash_glyph_cache_key(key);
+    LONG seq;
+    int i;
+
+    if (size > GLYPH_CACHE_DATA_SIZE) return;
+
+    slot = glyph_cache_set(hash);
+    for (i = 0; i < GLYPH_CACHE_WAYS; i++, slot++)
+    {
+        if (!slot->hash) { victim = slot; break; }
+        if (!victim || slot->last_used - victim->last_used < 0) victim = slot;
+    }
+
+    seq = victim->seq;
+    if ((seq & 1) || InterlockedCompareExchange(&victim->seq, seq + 1, seq) != seq) return;
+    if (victim->hash) InterlockedIncrement(&glyph_cache->evictions);
+    victim->hash = hash;
+    victim->key = *key;
+    victim->gm = *gm;
+    victim->adv = adv;
+    victim->lsb = lsb;
+    victim->bbx = bbx;
+    victim->size = size;
+    /* metrics-only queries store no bitmap and may pass a NULL buffer */
+    if (size) memcpy(victim->data, buf, size);
+    victim->last_used = InterlockedIncrement(&glyph_cache->clock);
+    InterlockedExchange(&victim->seq, seq + 2);
+    InterlockedIncrement(&glyph_cache->stores);
+}
+
+/* font lock must be held, freetype_cs is taken when the glyph isn't cached */
+static DWORD get_glyph_outline(GdiFont *incoming_font, UINT glyph, UINT format,
+                               LPGLYPHMETRICS lpgm, DWORD buflen, LPVOID buf,
+                               const MAT2* lpmat)
 {
     static const FT_Matrix identityMat = {(1 << 16), 0, 0, (1 << 16)};
     FT_Face ft_face = incoming_font->ft_face;
@@ -4297,6 +4521,8 @@ DWORD WineEngGetGlyphOutline(GdiFont *incoming_font, UINT glyph, UINT format,
     BOOL needsTransform = FALSE;
     BOOL tategaki = (font->GSUB_Table != NULL);
     UINT original_index;
+    BOOL use_cache;
+    struct glyph_cache_key cache_key;
 
     TRACE("%p, %04x, %08x, %p, %08x, %p, %p\n", font, glyph, format, lpgm,
 	  buflen, buf, lpmat);
@@ -4305,14 +4531,12 @@ DWORD WineEngGetGlyphOutline(GdiFont *incoming_font, UINT glyph, UINT format,
           font->font_desc.matrix.eM11, font->font_desc.matrix.eM12,
           font->font_desc.matrix.eM21, font->font_desc.matrix.eM22);
 
-    EnterCriticalSection( &freetype_cs );
-
     if(format & GGO_GLYPH_INDEX) {
         glyph_index = get_GSUB_vert_glyph(incoming_font,glyph);
         original_index = glyph;
 	format &= ~GGO_GLYPH_INDEX;
     } else {
-        get_glyph_index_linked(incoming_font, glyph, &font, &glyph_index);
+        get_glyph_index_linked_cached(incoming_font, glyph, &font, &glyph_index);
         ft_face = font->ft_face;
         original_index = glyph_index;
     }
@@ -4333,7 +4557,6 @@ DWORD WineEngGetGlyphOutline(GdiFont *incoming_font, UINT glyph, UINT format,
             TRACE("cached: %u,%u,%s,%d,%d\n", lpgm->gmBlackBoxX, lpgm->gmBlackBoxY,
                   wine_dbgstr_point(&lpgm->gmptGlyphOrigin),
                   lpgm->gmCellIncX, lpgm->gmCellIncY);
-            LeaveCriticalSection( &freetype_cs );
 	    return 1; /* FIXME */
 	}
     }
@@ -4344,14 +4567,6 @@ DWORD WineEngGetGlyphOutline(GdiFont *incoming_font, UINT glyph, UINT format,
     if(font->orientation || (format != GGO_METRICS && format != GGO_BITMAP && format != WINE_GGO_GRAY16_BITMAP) || lpmat)
         load_flags |= FT_LOAD_NO_BITMAP;
 
-    err = pFT_Load_Glyph(ft_face, glyph_index, load_flags);
-
-    if(err) {
-        WARN("FT_Load_Glyph on index %x returns %d\n", glyph_index, err);
-        LeaveCriticalSection( &freetype_cs );
-	return GDI_ERROR;
-    }
-	
     /* Scaling factor */
     if (font->aveWidth)
     {
@@ -4365,13 +4580,6 @@ DWORD WineEngGetGlyphOutline(GdiFont *incoming_font, UINT glyph, UINT format,
     else
         widthRatio = font->scale_y;
 
-    left = (INT)(ft_face->glyph->metrics.horiBearingX) & -64;
-    right = (INT)((ft_face->glyph->metrics.horiBearingX + ft_face->glyph->metrics.width) + 63) & -64;
-
-    adv = (INT)((ft_face->glyph->metrics.horiAdvance) + 63) >> 6;
-    lsb = left >> 6;
-    bbx = (right - left) >> 6;
-
     /* Scaling transform */
     if (widthRatio != 1.0 || font->scale_y != 1.0)
     {
@@ -4436,6 +4644,61 @@ DWORD WineEngGetGlyphOutline(GdiFont *incoming_font, UINT glyph, UINT format,
         needsTransform = TRUE;
     }
 
+    use_cache = (format == GGO_BITMAP || format == GGO_GRAY2_BITMAP || format == GGO_GRAY4_BITMAP ||
+                 format == GGO_GRAY8_BITMAP || format == WINE_GGO_GRAY16_BITMAP) &&
+                font->mapping && glyph_cache_ready();
+    if (use_cache)
+    {
+        memset(&cache_key, 0, sizeof(cache_key));
+        cache_key.dev = font->mapping->dev;
+        cache_key.ino = font->mapping->ino;
+        cache_key.face_index = ft_face->face_index;
+        cache_key.x_scale = ft_face->size->metrics.x_scale;
+        cache_key.y_scale = ft_face->size->metrics.y_scale;
+        cache_key.xx = transMat.xx;
+        cache_key.xy = transMat.xy;
+        cache_key.yx = transMat.yx;
+        cache_key.yy = transMat.yy;
+        cache_key.transform = needsTransform;
+        cache_key.load_flags = load_flags;
+        cache_key.format = format;
+        cache_key.glyph = glyph_index;
+
+        if (lookup_glyph_cache(&cache_key, lpgm, &adv, &lsb, &bbx, buf, buflen, &needed))
+        {
+            if ((format == GGO_BITMAP || format == WINE_GGO_GRAY16_BITMAP) &&
+                (!lpmat || is_identity_MAT2(lpmat)))
+            {
+                FONT_GM(font,original_index)->gm = *lpgm;
+                FONT_GM(font,original_index)->adv = adv;
+                FONT_GM(font,original_index)->lsb = lsb;
+                FONT_GM(font,original_index)->bbx = bbx;
+                FONT_GM(font,original_index)->init = TRUE;
+            }
+            /* the gray formats clear the whole buffer */
+            if (buf && buflen > needed && format != GGO_BITMAP)
+                memset((BYTE *)buf + needed, 0, buflen - needed);
+            return needed;
+        }
+    }
+
+    EnterCriticalSection( &freetype_cs );
+
+    err = pFT_Load_Glyph(ft_face, glyph_index, load_flags);
+
+    if(err) {
+        WARN("FT_Load_Glyph on index %x returns %d\n", glyph_index, err);
+        LeaveCriticalSection( &freetype_cs );
+	return GDI_ERROR;
+    }
+
+    left = (INT)(ft_face->glyph->metrics.horiBearingX) & -64;
+    right = (INT)((ft_face->glyph->metrics.horiBearingX + ft_face->glyph->metrics.width) + 63) & -64;
+
+    adv = (INT)((ft_face->glyph->metrics.horiAdvance) + 63) >> 6;
+    lsb = left >> 6;
+    bbx = (right - left) >> 6;
+
     if(!needsTransform) {
 	top = (ft_face->glyph->metrics.horiBearingY + 63) & -64;
 	bottom = (ft_face->glyph->metrics.horiBearingY -
@@ -4588,6 +4851,8 @@ DWORD WineEngGetGlyphOutline(GdiFont *incoming_font, UINT glyph, UINT format,
                 dst += pitch;
             }
             LeaveCriticalSection( &freetype_cs );
+            if (use_cache && buflen >= needed)
+                store_glyph_cache(&cache_key, lpgm, adv, lsb, bbx, buf, needed);
             return needed;
 	  }
         case ft_glyph_format_outline:
@@ -4616,6 +4881,8 @@ DWORD WineEngGetGlyphOutline(GdiFont *incoming_font, UINT glyph, UINT format,
             else /* format == WINE_GGO_GRAY16_BITMAP */
             {
                 LeaveCriticalSection( &freetype_cs );
+                if (use_cache && buflen >= needed)
+                    store_glyph_cache(&cache_key, lpgm, adv, lsb, bbx, buf, needed);
                 return needed;
             }
             break;
@@ -4823,9 +5090,31 @@ DWORD WineEngGetGlyphOutline(GdiFont *incoming_font, UINT glyph, UINT format,
 	return GDI_ERROR;
     }
     LeaveCriticalSection( &freetype_cs );
+    if (use_cache && buf && buflen >= needed)
+        store_glyph_cache(&cache_key, lpgm, adv, lsb, bbx, buf, needed);
     return needed;
 }
 
+/*************************************************************
+ * WineEngGetGlyphOutline
+ *
+ * Behaves in exactly the same way as the win32 api GetGlyphOutline
+ * except that the first parameter is the HWINEENGFONT of the font in
+ * question rather than an HDC.
+ *
+ */
+DWORD WineEngGetGlyphOutline(GdiFont *incoming_font, UINT glyph, UINT format,
+			     LPGLYPHMETRICS lpgm, DWORD buflen, LPVOID buf,
+			     const MAT2* lpmat)
+{
+    DWORD ret;
+
+    lock_font( incoming_font );
+    ret = get_glyph_outline( incoming_font, glyph, format, lpgm, buflen, buf, lpmat );
+    unlock_font( incoming_font );
+    return ret;
+}
+
 static BOOL get_bitmap_text_metrics(GdiFont *font)
 {
     FT_Face ft_face = font->ft_face;
@@ -4999,6 +5288,18 @@ BOOL WineEngGetTextMetrics(GdiFont *font, LPTEXTMETRICW ptm)
     return TRUE;
 }
 
+/* font lock must be held, freetype_cs is only taken the first time */
+static BOOL get_text_metrics_locked(GdiFont *font, LPTEXTMETRICW ptm)
+{
+    if (!font->tm_valid)
+    {
+        if (!WineEngGetTextMetrics(font, &font->tm)) return FALSE;
+        font->tm_valid = TRUE;
+    }
+    *ptm = font->tm;
+    return TRUE;
+}
+
 
 /*************************************************************
  * WineEngGetOutlineTextMetrics
@@ -5277,27 +5578,39 @@ end:
     return ret;
 }
 
+/* the child font is only published once it is fully initialized, so that
+ * callers holding the base font lock but not freetype_cs can test it */
 static BOOL load_child_font(GdiFont *font, CHILD_FONT *child)
 {
     HFONTLIST *hfontlist;
-    child->font = alloc_font();
-    child->font->ft_face = OpenFontFace(child->font, child->face, 0, -font->ppem);
-    if(!child->font->ft_face)
+    GdiFont *child_font;
+
+    EnterCriticalSection( &freetype_cs );
+    if (child->font)
     {
-        free_font(child->font);
-        child->font = NULL;
+        LeaveCriticalSection( &freetype_cs );
+        return TRUE;
+    }
+    child_font = alloc_font();
+    child_font->ft_face = OpenFontFace(child_font, child->face, 0, -font->ppem);
+    if(!child_font->ft_face)
+    {
+        free_font(child_font);
+        LeaveCriticalSection( &freetype_cs );
         return FALSE;
     }
 
-    child->font->ntmFlags = child->face->ntmFlags;
-    child->font->orientation = font->orientation;
-    child->font->scale_y = font->scale_y;
+    child_font->ntmFlags = child->face->ntmFlags;
+    child_font->orientation = font->orientation;
+    child_font->scale_y = font->scale_y;
     hfontlist = HeapAlloc(GetProcessHeap(), 0, sizeof(*hfontlist));
     hfontlist->hfont = CreateFontIndirectW(&font->font_desc.lf);
-    list_add_head(&child->font->hfontlist, &hfontlist->entry);
-    child->font->base_font = font;
-    list_add_head(&child_font_list, &child->font->entry);
+    list_add_head(&child_font->hfontlist, &hfontlist->entry);
+    child_font->base_font = font;
+    list_add_head(&child_font_list, &child_font->entry);
+    child->font = child_font;
     TRACE("created child font hfont %p for base %p child %p\n", hfontlist->hfont, font, child->font);
+    LeaveCriticalSection( &freetype_cs );
     return TRUE;
 }
 
@@ -5333,6 +5646,49 @@ static BOOL get_glyph_index_linked(GdiFont *font, UINT c, GdiFont **linked_font,
     return FALSE;
 }
 
+/* same as get_glyph_index_linked, but remembers the result for the BMP
+ * characters; font lock must be held */
+static BOOL get_glyph_index_linked_cached(GdiFont *font, UINT c, GdiFont **linked_font, FT_UInt *glyph)
+{
+    CHAR_GLYPH *block;
+
+    if(font->base_font)
+        font = font->base_font;
+
+    if(c >= 0x10000)
+        return get_glyph_index_linked(font, c, linked_font, glyph);
+
+    block = font->char_glyph[c / CHAR_GLYPH_BLOCK_SIZE];
+    if(!block)
+    {
+        block = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*block) * CHAR_GLYPH_BLOCK_SIZE);
+        if(!block)
+            return get_glyph_index_linked(font, c, linked_font, glyph);
+        font->char_glyph[c / CHAR_GLYPH_BLOCK_SIZE] = block;
+    }
+    block += c % CHAR_GLYPH_BLOCK_SIZE;
+    if(!block->font)
+    {
+        get_glyph_index_linked(font, c, &block->font, &block->glyph);
+        TRACE("caching %04x -> font %p glyph %u\n", c, block->font, block->glyph);
+    }
+    *linked_font = block->font;
+    *glyph = block->glyph;
+    return *glyph != 0;
+}
+
+/* returns the unrotated metrics of a glyph, loading them through
+ * FreeType only if they aren't cached yet; font lock must be held */
+static const GM *get_glyph_metrics(GdiFont *font, FT_UInt glyph)
+{
+    GLYPHMETRICS gm;
+
+    if(glyph >= font->gmsize * GM_BLOCK_SIZE || !font->gm[glyph / GM_BLOCK_SIZE] ||
+       !FONT_GM(font,glyph)->init)
+        get_glyph_outline(font, glyph, GGO_METRICS | GGO_GLYPH_INDEX, &gm, 0, NULL, NULL);
+    return FONT_GM(font,glyph);
+}
+
 /*************************************************************
  * WineEngGetCharWidth
  *
@@ -5341,20 +5697,17 @@ BOOL WineEngGetCharWidth(GdiFont *font, UINT firstChar, UINT lastChar,
 			 LPINT buffer)
 {
     UINT c;
-    GLYPHMETRICS gm;
     FT_UInt glyph_index;
     GdiFont *linked_font;
 
     TRACE("%p, %d, %d, %p\n", font, firstChar, lastChar, buffer);
 
-    EnterCriticalSection( &freetype_cs );
+    lock_font( font );
     for(c = firstChar; c <= lastChar; c++) {
-        get_glyph_index_linked(font, c, &linked_font, &glyph_index);
-        WineEngGetGlyphOutline(linked_font, glyph_index, GGO_METRICS | GGO_GLYPH_INDEX,
-                               &gm, 0, NULL, NULL);
-	buffer[c - firstChar] = FONT_GM(linked_font,glyph_index)->adv;
+        get_glyph_index_linked_cached(font, c, &linked_font, &glyph_index);
+	buffer[c - firstChar] = get_glyph_metrics(linked_font, glyph_index)->adv;
     }
-    LeaveCriticalSection( &freetype_cs );
+    unlock_font( font );
     return TRUE;
 }
 
@@ -5366,27 +5719,25 @@ BOOL WineEngGetCharABCWidths(GdiFont *font, UINT firstChar, UINT lastChar,
 			     LPABC buffer)
 {
     UINT c;
-    GLYPHMETRICS gm;
     FT_UInt glyph_index;
     GdiFont *linked_font;
+    const GM *gm;
 
     TRACE("%p, %d, %d, %p\n", font, firstChar, lastChar, buffer);
 
     if(!FT_IS_SCALABLE(font->ft_face))
         return FALSE;
 
-    EnterCriticalSection( &freetype_cs );
+    lock_font( font );
 
     for(c = firstChar; c <= lastChar; c++) {
-        get_glyph_index_linked(font, c, &linked_font, &glyph_index);
-        WineEngGetGlyphOutline(linked_font, glyph_index, GGO_METRICS | GGO_GLYPH_INDEX,
-                               &gm, 0, NULL, NULL);
-	buffer[c - firstChar].abcA = FONT_GM(linked_font,glyph_index)->lsb;
-	buffer[c - firstChar].abcB = FONT_GM(linked_font,glyph_index)->bbx;
-	buffer[c - firstChar].abcC = FONT_GM(linked_font,glyph_index)->adv - FONT_GM(linked_font,glyph_index)->lsb -
-            FONT_GM(linked_font,glyph_index)->bbx;
+        get_glyph_index_linked_cached(font, c, &linked_font, &glyph_index);
+        gm = get_glyph_metrics(linked_font, glyph_index);
+	buffer[c - firstChar].abcA = gm->lsb;
+	buffer[c - firstChar].abcB = gm->bbx;
+	buffer[c - firstChar].abcC = gm->adv - gm->lsb - gm->bbx;
     }
-    LeaveCriticalSection( &freetype_cs );
+    unlock_font( font );
     return TRUE;
 }
 
@@ -5398,36 +5749,32 @@ BOOL WineEngGetCharABCWidthsI(GdiFont *font, UINT firstChar, UINT count, LPWORD
 			      LPABC buffer)
 {
     UINT c;
-    GLYPHMETRICS gm;
     FT_UInt glyph_index;
     GdiFont *linked_font;
+    const GM *gm;
 
     if(!FT_HAS_HORIZONTAL(font->ft_face))
         return FALSE;
 
-    EnterCriticalSection( &freetype_cs );
+    lock_font( font );
 
-    get_glyph_index_linked(font, 'a', &linked_font, &glyph_index);
+    get_glyph_index_linked_cached(font, 'a', &linked_font, &glyph_index);
     if (!pgi)
         for(c = firstChar; c < firstChar+count; c++) {
-            WineEngGetGlyphOutline(linked_font, c, GGO_METRICS | GGO_GLYPH_INDEX,
-                                   &gm, 0, NULL, NULL);
-            buffer[c - firstChar].abcA = FONT_GM(linked_font,c)->lsb;
-            buffer[c - firstChar].abcB = FONT_GM(linked_font,c)->bbx;
-            buffer[c - firstChar].abcC = FONT_GM(linked_font,c)->adv - FONT_GM(linked_font,c)->lsb
-                - FONT_GM(linked_font,c)->bbx;
+            gm = get_glyph_metrics(linked_font, c);
+            buffer[c - firstChar].abcA = gm->lsb;
+            buffer[c - firstChar].abcB = gm->bbx;
+            buffer[c - firstChar].abcC = gm->adv - gm->lsb - gm->bbx;
         }
     else
         for(c = 0; c < count; c++) {
-            WineEngGetGlyphOutline(linked_font, pgi[c], GGO_METRICS | GGO_GLYPH_INDEX,
-                                   &gm, 0, NULL, NULL);
-            buffer[c].abcA = FONT_GM(linked_font,pgi[c])->lsb;
-            buffer[c].abcB = FONT_GM(linked_font,pgi[c])->bbx;
-            buffer[c].abcC = FONT_GM(linked_font,pgi[c])->adv
-                - FONT_GM(linked_font,pgi[c])->lsb - FONT_GM(linked_font,pgi[c])->bbx;
+            gm = get_glyph_metrics(linked_font, pgi[c]);
+            buffer[c].abcA = gm->lsb;
+            buffer[c].abcB = gm->bbx;
+            buffer[c].abcC = gm->adv - gm->lsb - gm->bbx;
         }
 
-    LeaveCriticalSection( &freetype_cs );
+    unlock_font( font );
     return TRUE;
 }
 
@@ -5440,7 +5787,6 @@ BOOL WineEngGetTextExtentExPoint(GdiFont *font, LPCWSTR wstr, INT count,
 {
     INT idx;
     INT nfit = 0, ext;
-    GLYPHMETRICS gm;
     TEXTMETRICW tm;
     FT_UInt glyph_index;
     GdiFont *linked_font;
@@ -5448,17 +5794,14 @@ BOOL WineEngGetTextExtentExPoint(GdiFont *font, LPCWSTR wstr, INT count,
     TRACE("%p, %s, %d, %d, %p\n", font, debugstr_wn(wstr, count), count,
 	  max_ext, size);
 
-    EnterCriticalSection( &freetype_cs );
+    lock_font( font );
 
     size->cx = 0;
-    WineEngGetTextMetrics(font, &tm);
-    size->cy = tm.tmHeight;
+    size->cy = get_text_metrics_locked(font, &tm) ? tm.tmHeight : 0;
 
     for(idx = 0; idx < count; idx++) {
-        get_glyph_index_linked(font, wstr[idx], &linked_font, &glyph_index);
-        WineEngGetGlyphOutline(linked_font, glyph_index, GGO_METRICS | GGO_GLYPH_INDEX,
-                               &gm, 0, NULL, NULL);
-	size->cx += FONT_GM(linked_font,glyph_index)->adv;
+        get_glyph_index_linked_cached(font, wstr[idx], &linked_font, &glyph_index);
+	size->cx += get_glyph_metrics(linked_font, glyph_index)->adv;
         ext = size->cx;
         if (! pnfit || ext <= max_ext) {
             ++nfit;
@@ -5470,7 +5813,7 @@ BOOL WineEngGetTextExtentExPoint(GdiFont *font, LPCWSTR wstr, INT count,
     if (pnfit)
         *pnfit = nfit;
 
-    LeaveCriticalSection( &freetype_cs );
+    unlock_font( font );
     TRACE("return %d, %d, %d\n", size->cx, size->cy, nfit);
     return TRUE;
 }
@@ -5484,22 +5827,17 @@ BOOL WineEngGetTextExtentExPointI(GdiFont *font, const WORD *indices, INT count,
 {
     INT idx;
     INT nfit = 0, ext;
-    GLYPHMETRICS gm;
     TEXTMETRICW tm;
 
     TRACE("%p, %p, %d, %d, %p\n", font, indices, count, max_ext, size);
 
-    EnterCriticalSection( &freetype_cs );
+    lock_font( font );
 
     size->cx = 0;
-    WineEngGetTextMetrics(font, &tm);
-    size->cy = tm.tmHeight;
+    size->cy = get_text_metrics_locked(font, &tm) ? tm.tmHeight : 0;
 
     for(idx = 0; idx < count; idx++) {
-        WineEngGetGlyphOutline(font, indices[idx],
-			       GGO_METRICS | GGO_GLYPH_INDEX, &gm, 0, NULL,
-			       NULL);
-        size->cx += FONT_GM(font,indices[idx])->adv;
+        size->cx += get_glyph_metrics(font, indices[idx])->adv;
         ext = size->cx;
         if (! pnfit || ext <= max_ext) {
             ++nfit;
@@ -5511,7 +5849,7 @@ BOOL WineEngGetTextExtentExPointI(GdiFont *font, const WORD *indices, INT count,
     if (pnfit)
         *pnfit = nfit;
 
-    LeaveCriticalSection( &freetype_cs );
+    unlock_font( font );
     TRACE("return %d, %d, %d\n", size->cx, size->cy, nfit);
     return TRUE;
 }
@@ -20,6 +20,7 @@
  */
 
 #include <stdarg.h>
+#include <stdio.h>
 #include <assert.h>
 
 #include "windef.h"
@@ -27,6 +28,7 @@
 #include "wingdi.h"
 #include "winuser.h"
 #include "winnls.h"
+#include "winreg.h"
 
 #include "wine/test.h"
 
@@ -2314,10 +2316,301 @@ static void test_GetTextFace(void)
     ReleaseDC(NULL, dc);
 }
 
+#define EXTENT_THREADS    4
+#define EXTENT_LOOPS      2000
+
+static const char extent_text[] = "The quick brown fox jumps over the lazy dog 0123456789";
+/* CJK and symbol characters that Arial doesn't have, they come from linked
+ * or fallback fonts if there are any, or are the default glyph otherwise */
+static const WCHAR extent_linkedW[] = {'a',0x4e00,'b',0x3042,0x2603,0xac00,'c',0x4e00,0};
+
+struct extent_thread_data
+{
+    SIZE expected;
+    SIZE expected_linked;
+    LONG failures;
+};
+
+static HDC create_extent_dc(void)
+{
+    LOGFONTA lf;
+    HDC hdc = CreateCompatibleDC(0);
+
+    memset(&lf, 0, sizeof(lf));
+    strcpy(lf.lfFaceName, "Arial");
+    lf.lfHeight = 20;
+    SelectObject(hdc, CreateFontIndirectA(&lf));
+    return hdc;
+}
+
+static void delete_extent_dc(HDC hdc)
+{
+    DeleteObject(SelectObject(hdc, GetStockObject(SYSTEM_FONT)));
+    DeleteDC(hdc);
+}
+
+/* each thread uses its own DC, all of them end up on the same font instance */
+static DWORD WINAPI extent_thread_proc(void *arg)
+{
+    struct extent_thread_data *data = arg;
+    HDC hdc = create_extent_dc();
+    SIZE sz;
+    int i;
+
+    for (i = 0; i < EXTENT_LOOPS; i++)
+    {
+        GetTextExtentPoint32A(hdc, extent_text, sizeof(extent_text) - 1, &sz);
+        if (sz.cx != data->expected.cx || sz.cy != data->expected.cy)
+            InterlockedIncrement(&data->failures);
+        GetTextExtentPoint32W(hdc, extent_linkedW, lstrlenW(extent_linkedW), &sz);
+        if (sz.cx != data->expected_linked.cx || sz.cy != data->expected_linked.cy)
+            InterlockedIncrement(&data->failures);
+    }
+    delete_extent_dc(hdc);
+    return 0;
+}
+
+static void test_GetGlyphOutline_repeat(void)
+{
+    static const UINT formats[] = { GGO_BITMAP, GGO_GRAY2_BITMAP, GGO_GRAY8_BITMAP };
+    static const MAT2 mat = { {0,1}, {0,0}, {0,0}, {0,1} };
+    GLYPHMETRICS gm1, gm2;
+    DWORD size1, size2, start, elapsed;
+    BYTE *buf1, *buf2;
+    HDC hdc;
+    int i, j;
+
+    if (!is_truetype_font_installed("Arial"))
+    {
+        skip("Arial is not installed\n");
+        return;
+    }
+    hdc = create_extent_dc();
+
+    /* rendering the same glyph again, possibly from the glyph cache,
+     * must give the same result */
+    for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+    {
+        size1 = GetGlyphOutlineA(hdc, 'g', formats[i], &gm1, 0, NULL, &mat);
+        ok(size1 != GDI_ERROR, "%u: GetGlyphOutlineA error %d\n", formats[i], GetLastError());
+        if (size1 == GDI_ERROR || !size1) continue;
+        buf1 = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, size1);
+        buf2 = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, size1);
+        GetGlyphOutlineA(hdc, 'g', formats[i], &gm1, size1, buf1, &mat);
+        for (j = 0; j < 2; j++)
+        {
+            memset(&gm2, 0xcc, sizeof(gm2));
+            size2 = GetGlyphOutlineA(hdc, 'g', formats[i], &gm2, j ? size1 : 0, j ? buf2 : NULL, &mat);
+            ok(size2 == size1, "%u: got size %u, expected %u\n", formats[i], size2, size1);
+            ok(!memcmp(&gm1, &gm2, sizeof(gm1)), "%u: metrics differ\n", formats[i]);
+        }
+        ok(!memcmp(buf1, buf2, size1), "%u: bitmaps differ\n", formats[i]);
+
+        /* throughput, only in interactive mode so that the normal test run stays fast */
+        if (winetest_interactive)
+        {
+            start = GetTickCount();
+            for (j = 0; j < 2000; j++)
+                GetGlyphOutlineA(hdc, 'g', formats[i], &gm2, size1, buf2, &mat);
+            elapsed = GetTickCount() - start;
+            trace("%u: 2000 GetGlyphOutline calls in %u ms\n", formats[i], elapsed);
+        }
+
+        HeapFree(GetProcessHeap(), 0, buf1);
+        HeapFree(GetProcessHeap(), 0, buf2);
+    }
+    delete_extent_dc(hdc);
+}
+
+static const char glyph_cache_file[] = "glyphs.tst";
+
+/* renders a few glyphs in the bitmap formats, and appends their metrics and
+ * bitmaps to buf; returns the size used, or 0 on failure */
+static DWORD render_cache_glyphs(HDC hdc, BYTE *buf, DWORD buflen)
+{
+    static const char chars[] = "gA@";
+    static const UINT formats[] = { GGO_BITMAP, GGO_GRAY2_BITMAP, GGO_GRAY4_BITMAP, GGO_GRAY8_BITMAP };
+    static const MAT2 mat = { {0,1}, {0,0}, {0,0}, {0,1} };
+    GLYPHMETRICS gm;
+    DWORD size, total = 0;
+    int i, j;
+
+    for (i = 0; chars[i]; i++)
+        for (j = 0; j < sizeof(formats) / sizeof(formats[0]); j++)
+        {
+            size = GetGlyphOutlineA(hdc, chars[i], formats[j], &gm, 0, NULL, &mat);
+            if (size == GDI_ERROR || total + sizeof(gm) + size > buflen) return 0;
+            memcpy(buf + total, &gm, sizeof(gm));
+            total += sizeof(gm);
+            if (size && GetGlyphOutlineA(hdc, chars[i], formats[j], &gm, size, buf + total, &mat) == GDI_ERROR)
+                return 0;
+            total += size;
+        }
+    return total;
+}
+
+/* runs in a child process started with the glyph cache enabled, the first
+ * rendering fills the cache and the second one is read from it */
+static void test_glyph_cache_child(void)
+{
+    static BYTE expected[65536], buf[65536];
+    DWORD size, expected_size;
+    HANDLE file;
+    HDC hdc;
+    int i;
+
+    file = CreateFileA(glyph_cache_file, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "can't open %s, error %u\n", glyph_cache_file, GetLastError());
+    if (file == INVALID_HANDLE_VALUE) return;
+    ReadFile(file, expected, sizeof(expected), &expected_size, NULL);
+    CloseHandle(file);
+
+    hdc = create_extent_dc();
+    for (i = 0; i < 2; i++)
+    {
+        memset(buf, 0xcc, sizeof(buf));
+        size = render_cache_glyphs(hdc, buf, sizeof(buf));
+        ok(size == expected_size, "%d: got size %u, expected %u\n", i, size, expected_size);
+        ok(!memcmp(buf, expected, expected_size), "%d: glyphs differ from the uncached ones\n", i);
+    }
+    delete_extent_dc(hdc);
+}
+
+static void test_glyph_cache(void)
+{
+    static BYTE expected[65536];
+    char cmdline[MAX_PATH + 32], old_size[20], **argv;
+    DWORD size, type, count = sizeof(old_size);
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+    HANDLE file;
+    HKEY hkey;
+    LONG ret;
+    HDC hdc;
+
+    if (!is_truetype_font_installed("Arial"))
+    {
+        skip("Arial is not installed\n");
+        return;
+    }
+
+    /* the uncached results, unless the cache is configured for this session already */
+    hdc = create_extent_dc();
+    size = render_cache_glyphs(hdc, expected, sizeof(expected));
+    delete_extent_dc(hdc);
+    ok(size != 0, "failed to render the glyphs\n");
+    if (!size) return;
+
+    file = CreateFileA(glyph_cache_file, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "can't create %s, error %u\n", glyph_cache_file, GetLastError());
+    if (file == INVALID_HANDLE_VALUE) return;
+    WriteFile(file, expected, size, &count, NULL);
+    CloseHandle(file);
+
+    /* the cache size is read when gdi32 is loaded, so it takes a new process */
+    ret = RegCreateKeyA(HKEY_CURRENT_USER, "Software\\Wine\\Fonts", &hkey);
+    ok(!ret, "RegCreateKeyA error %d\n", ret);
+    if (ret)
+    {
+        DeleteFileA(glyph_cache_file);
+        return;
+    }
+    count = sizeof(old_size);
+    if (RegQueryValueExA(hkey, "GlyphCacheSize", NULL, &type, (BYTE *)old_size, &count) || type != REG_SZ)
+        old_size[0] = 0;
+    RegSetValueExA(hkey, "GlyphCacheSize", 0, REG_SZ, (const BYTE *)"256", 4);
+
+    winetest_get_mainargs(&argv);
+    sprintf(cmdline, "\"%s\" font glyph_cache", argv[0]);
+    memset(&si, 0, sizeof(si));
+    si.cb = sizeof(si);
+    ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi);
+    ok(ret, "CreateProcess error %u\n", GetLastError());
+    if (ret)
+    {
+        winetest_wait_child_process(pi.hProcess);
+        CloseHandle(pi.hProcess);
+        CloseHandle(pi.hThread);
+    }
+
+    if (old_size[0])
+        RegSetValueExA(hkey, "GlyphCacheSize", 0, REG_SZ, (const BYTE *)old_size, strlen(old_size) + 1);
+    else
+        RegDeleteValueA(hkey, "GlyphCacheSize");
+    RegCloseKey(hkey);
+    DeleteFileA(glyph_cache_file);
+}
+
+static void test_text_extent_threads(void)
+{
+    struct extent_thread_data data;
+    HANDLE threads[EXTENT_THREADS];
+    DWORD start, elapsed, tid;
+    HDC hdc;
+    SIZE sz;
+    int i, width;
+
+    if (!is_truetype_font_installed("Arial"))
+    {
+        skip("Arial is not installed\n");
+        return;
+    }
+
+    memset(&data, 0, sizeof(data));
+    hdc = create_extent_dc();
+    GetTextExtentPoint32A(hdc, extent_text, sizeof(extent_text) - 1, &data.expected);
+
+    /* the glyphs from other fonts are measured the same one at a time and
+     * within a string, and the second time from the cache */
+    GetTextExtentPoint32W(hdc, extent_linkedW, lstrlenW(extent_linkedW), &data.expected_linked);
+    width = 0;
+    for (i = 0; extent_linkedW[i]; i++)
+    {
+        GetTextExtentPoint32W(hdc, extent_linkedW + i, 1, &sz);
+        ok(sz.cx > 0, "char %04x: width %d\n", extent_linkedW[i], sz.cx);
+        width += sz.cx;
+    }
+    ok(width == data.expected_linked.cx, "string width %d, sum of char widths %d\n",
+       data.expected_linked.cx, width);
+    GetTextExtentPoint32W(hdc, extent_linkedW, lstrlenW(extent_linkedW), &sz);
+    ok(sz.cx == data.expected_linked.cx && sz.cy == data.expected_linked.cy,
+       "got %d,%d, expected %d,%d\n", sz.cx, sz.cy, data.expected_linked.cx, data.expected_linked.cy);
+    delete_extent_dc(hdc);
+
+    start = GetTickCount();
+    extent_thread_proc(&data);
+    elapsed = GetTickCount() - start;
+    ok(!data.failures, "got %d wrong extents\n", data.failures);
+    trace("1 thread: %u GetTextExtentPoint32 calls in %u ms\n", EXTENT_LOOPS, elapsed);
+
+    start = GetTickCount();
+    for (i = 0; i < EXTENT_THREADS; i++)
+    {
+        threads[i] = CreateThread(NULL, 0, extent_thread_proc, &data, 0, &tid);
+        ok(threads[i] != NULL, "CreateThread error %u\n", GetLastError());
+    }
+    WaitForMultipleObjects(EXTENT_THREADS, threads, TRUE, INFINITE);
+    elapsed = GetTickCount() - start;
+    for (i = 0; i < EXTENT_THREADS; i++) CloseHandle(threads[i]);
+    ok(!data.failures, "got %d wrong extents\n", data.failures);
+    trace("%u threads: %u GetTextExtentPoint32 calls each in %u ms\n",
+          EXTENT_THREADS, EXTENT_LOOPS, elapsed);
+}
+
 START_TEST(font)
 {
+    char **argv;
+    int argc;
+
     init();
 
+    argc = winetest_get_mainargs(&argv);
+    if (argc >= 3 && !strcmp(argv[2], "glyph_cache"))
+    {
+        test_glyph_cache_child();
+        return;
+    }
+
     test_logfont();
     test_bitmap_font();
     test_outline_font();
@@ -2350,4 +2643,7 @@ START_TEST(font)
     test_GetTextMetrics();
     test_GdiRealizationInfo();
     test_GetTextFace();
+    test_GetGlyphOutline_repeat();
+    test_text_extent_threads();
+    test_glyph_cache();
 }
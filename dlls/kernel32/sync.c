@@ -308,8 +308,17 @@ BOOL WINAPI UnregisterWait( HANDLE WaitHandle )
  */
 BOOL WINAPI UnregisterWaitEx( HANDLE WaitHandle, HANDLE CompletionEvent ) 
 {
-    FIXME("%p %p\n",WaitHandle, CompletionEvent);
-    return FALSE;
+    NTSTATUS status;
+
+    TRACE("%p %p\n",WaitHandle, CompletionEvent);
+
+    status = RtlDeregisterWaitEx( WaitHandle, CompletionEvent );
+    if (status != STATUS_SUCCESS)
+    {
+        SetLastError( RtlNtStatusToDosError(status) );
+        return FALSE;
+    }
+    return TRUE;
 }
 
 /***********************************************************************
@@ -1929,7 +1938,8 @@ BOOL WINAPI GetQueuedCompletionStatus( HANDLE CompletionPort, LPDWORD lpNumberOf
         return TRUE;
     }
 
-    SetLastError( RtlNtStatusToDosError(status) );
+    if (status == STATUS_TIMEOUT) SetLastError( WAIT_TIMEOUT );
+    else SetLastError( RtlNtStatusToDosError(status) );
     return FALSE;
 }
 
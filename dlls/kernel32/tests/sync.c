@@ -526,6 +526,44 @@ static void test_iocp_callback(void)
     ok(GetLastError() == ERROR_INVALID_HANDLE, "Last error is %d\n", GetLastError());
 }
 
+static void test_completion_port(void)
+{
+    HANDLE port;
+    DWORD size;
+    ULONG_PTR key;
+    OVERLAPPED *ovl;
+    BOOL ret;
+
+    port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    ok(port != NULL, "CreateIoCompletionPort failed with error %u\n", GetLastError());
+
+    /* an empty port times out with WAIT_TIMEOUT */
+    SetLastError(0xdeadbeef);
+    ovl = (OVERLAPPED *)0xdeadbeef;
+    ret = GetQueuedCompletionStatus(port, &size, &key, &ovl, 0);
+    ok(!ret, "GetQueuedCompletionStatus succeeded\n");
+    ok(GetLastError() == WAIT_TIMEOUT, "wrong error %u\n", GetLastError());
+    ok(ovl == NULL, "got overlapped %p\n", ovl);
+
+    SetLastError(0xdeadbeef);
+    ret = GetQueuedCompletionStatus(port, &size, &key, &ovl, 50);
+    ok(!ret, "GetQueuedCompletionStatus succeeded\n");
+    ok(GetLastError() == WAIT_TIMEOUT, "wrong error %u\n", GetLastError());
+
+    ret = PostQueuedCompletionStatus(port, 12, 34, (OVERLAPPED *)0x5678);
+    ok(ret, "PostQueuedCompletionStatus failed with error %u\n", GetLastError());
+
+    size = key = 0;
+    ovl = NULL;
+    ret = GetQueuedCompletionStatus(port, &size, &key, &ovl, 0);
+    ok(ret, "GetQueuedCompletionStatus failed with error %u\n", GetLastError());
+    ok(size == 12, "got size %u\n", size);
+    ok(key == 34, "got key %lu\n", key);
+    ok(ovl == (OVERLAPPED *)0x5678, "got overlapped %p\n", ovl);
+
+    CloseHandle(port);
+}
+
 START_TEST(sync)
 {
     HMODULE hdll = GetModuleHandle("kernel32");
@@ -539,4 +577,5 @@ START_TEST(sync)
     test_semaphore();
     test_waitable_timer();
     test_iocp_callback();
+    test_completion_port();
 }
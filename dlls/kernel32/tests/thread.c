@@ -75,6 +75,9 @@ static RegisterWaitForSingleObject_t pRegisterWaitForSingleObject=NULL;
 typedef BOOL (WINAPI *UnregisterWait_t)(HANDLE);
 static UnregisterWait_t pUnregisterWait=NULL;
 
+typedef BOOL (WINAPI *UnregisterWaitEx_t)(HANDLE,HANDLE);
+static UnregisterWaitEx_t pUnregisterWaitEx=NULL;
+
 static HANDLE create_target_process(const char *arg)
 {
     char **argv;
@@ -954,8 +957,23 @@ static void CALLBACK timeout_function(PVOID p, BOOLEAN TimerOrWaitFired)
     ok(TimerOrWaitFired, "wait should have timed out\n");
 }
 
+struct slow_wait_context
+{
+    HANDLE started;
+    LONG finished;
+};
+
+static void CALLBACK slow_signaled_function(PVOID p, BOOLEAN TimerOrWaitFired)
+{
+    struct slow_wait_context *context = p;
+    SetEvent(context->started);
+    Sleep(200);
+    context->finished = TRUE;
+}
+
 static void test_RegisterWaitForSingleObject(void)
 {
+    struct slow_wait_context context;
     BOOL ret;
     HANDLE wait_handle;
     HANDLE handle;
@@ -1003,6 +1021,29 @@ static void test_RegisterWaitForSingleObject(void)
 
     ret = pUnregisterWait(wait_handle);
     ok(ret, "UnregisterWait failed with error %d\n", GetLastError());
+
+    if (!pUnregisterWaitEx)
+    {
+        skip("UnregisterWaitEx not implemented\n");
+        return;
+    }
+
+    /* with INVALID_HANDLE_VALUE, UnregisterWaitEx waits for a running callback */
+
+    SetEvent(handle);
+    context.started = CreateEvent(NULL, FALSE, FALSE, NULL);
+    context.finished = FALSE;
+
+    ret = pRegisterWaitForSingleObject(&wait_handle, handle, slow_signaled_function, &context, INFINITE, WT_EXECUTEONLYONCE);
+    ok(ret, "RegisterWaitForSingleObject failed with error %d\n", GetLastError());
+
+    WaitForSingleObject(context.started, INFINITE);
+
+    ret = pUnregisterWaitEx(wait_handle, INVALID_HANDLE_VALUE);
+    ok(ret, "UnregisterWaitEx failed with error %d\n", GetLastError());
+    ok(context.finished, "UnregisterWaitEx returned while the callback was running\n");
+
+    CloseHandle(context.started);
 }
 
 static DWORD TLS_main;
@@ -1198,6 +1239,7 @@ START_TEST(thread)
    pSetThreadPriorityBoost=(SetThreadPriorityBoost_t)GetProcAddress(lib,"SetThreadPriorityBoost");
    pRegisterWaitForSingleObject=(RegisterWaitForSingleObject_t)GetProcAddress(lib,"RegisterWaitForSingleObject");
    pUnregisterWait=(UnregisterWait_t)GetProcAddress(lib,"UnregisterWait");
+   pUnregisterWaitEx=(UnregisterWaitEx_t)GetProcAddress(lib,"UnregisterWaitEx");
 
    if (argc >= 3)
    {
@@ -41,6 +41,7 @@
 #include "winbase.h"
 #include "winternl.h"
 #include "msvcrt.h"
+#include "mtdll.h"
 
 #include "wine/unicode.h"
 
@@ -111,6 +112,24 @@ static CRITICAL_SECTION MSVCRT_file_cs;
 #define LOCK_FILES()    do { EnterCriticalSection(&MSVCRT_file_cs); } while (0)
 #define UNLOCK_FILES()  do { LeaveCriticalSection(&MSVCRT_file_cs); } while (0)
 
+/* our own stream buffers start at this size, and grow up to the maximum
+ * while a stream is read sequentially one full buffer at a time */
+#define MSVCRT_INTERNAL_BUFSIZ 4096
+#define MSVCRT_MAX_BUFSIZ      (64 * 1024)
+
+/* streams allocated by msvcrt_alloc_fp carry their own lock; the static
+ * stdin/stdout/stderr streams use the _STREAM_LOCKS lock table entries */
+typedef struct
+{
+    MSVCRT_FILE         file;
+    CRITICAL_SECTION    crit;
+} file_crit;
+
+static inline BOOL msvcrt_is_std_stream(const MSVCRT_FILE *file)
+{
+    return file >= MSVCRT__iob && file < MSVCRT__iob + sizeof(MSVCRT__iob)/sizeof(MSVCRT__iob[0]);
+}
+
 static void msvcrt_stat64_to_stat(const struct MSVCRT__stat64 *buf64, struct MSVCRT__stat *buf)
 {
     buf->st_dev   = buf64->st_dev;
@@ -249,8 +268,13 @@ static MSVCRT_FILE* msvcrt_alloc_fp(void)
     {
       if (!MSVCRT_fstreams[i])
       {
-        if (!(MSVCRT_fstreams[i] = MSVCRT_calloc(sizeof(MSVCRT_FILE),1)))
+        file_crit *fc = MSVCRT_calloc(sizeof(file_crit),1);
+
+        if (!fc)
           return NULL;
+        InitializeCriticalSection(&fc->crit);
+        fc->crit.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": file_crit.crit");
+        MSVCRT_fstreams[i] = &fc->file;
         if (i == MSVCRT_stream_idx) MSVCRT_stream_idx++;
       }
       return MSVCRT_fstreams[i];
@@ -414,9 +438,9 @@ static int msvcrt_flush_buffer(MSVCRT_FILE* file)
 /* INTERNAL: Allocate stdio file buffer */
 static void msvcrt_alloc_buffer(MSVCRT_FILE* file)
 {
-	file->_base = MSVCRT_calloc(MSVCRT_BUFSIZ,1);
+	file->_base = MSVCRT_calloc(MSVCRT_INTERNAL_BUFSIZ,1);
 	if(file->_base) {
-		file->_bufsiz = MSVCRT_BUFSIZ;
+		file->_bufsiz = MSVCRT_INTERNAL_BUFSIZ;
 		file->_flag |= MSVCRT__IOMYBUF;
 	} else {
 		file->_base = (char*)(&file->_charbuf);
@@ -427,6 +451,32 @@ static void msvcrt_alloc_buffer(MSVCRT_FILE* file)
 	file->_cnt = 0;
 }
 
+/* INTERNAL: Grow our own read buffer when the previous fill was a full
+ * buffer that has been consumed entirely, i.e. the stream is being read
+ * sequentially.  The bytes consumed are what the fill left in the buffer:
+ * in text mode the CRs have been removed from it, so a full fill holds at
+ * least half the buffer.  Seeking resets _ptr, so random access doesn't
+ * grow it. */
+static void msvcrt_grow_buffer(MSVCRT_FILE* file)
+{
+  char *base;
+  int full;
+
+  if (!(file->_flag & MSVCRT__IOMYBUF) || (file->_flag & MSVCRT__IOWRT) ||
+      file->_bufsiz >= MSVCRT_MAX_BUFSIZ || file->_cnt > 0)
+    return;
+  full = file->_bufsiz;
+  if (MSVCRT_fdesc[file->_file].wxflag & WX_TEXT)
+    full /= 2;
+  if (file->_ptr - file->_base < full)
+    return;
+  if (!(base = MSVCRT_realloc(file->_base, file->_bufsiz * 2)))
+    return;
+  file->_base = file->_ptr = base;
+  file->_bufsiz *= 2;
+  TRACE(":file (%p) buffer grown to %d\n", file, file->_bufsiz);
+}
+
 /* INTERNAL: Convert integer to base32 string (0-9a-v), 0 becomes "" */
 static void msvcrt_int_to_base32(int num, char *str)
 {
@@ -458,6 +508,28 @@ MSVCRT_FILE * CDECL __p__iob(void)
  return &MSVCRT__iob[0];
 }
 
+/*********************************************************************
+ *		_lock_file (MSVCRT.@)
+ */
+void CDECL MSVCRT__lock_file(MSVCRT_FILE *file)
+{
+  if (msvcrt_is_std_stream(file))
+    _lock(_STREAM_LOCKS + (file - MSVCRT__iob));
+  else
+    EnterCriticalSection(&((file_crit *)file)->crit);
+}
+
+/*********************************************************************
+ *		_unlock_file (MSVCRT.@)
+ */
+void CDECL MSVCRT__unlock_file(MSVCRT_FILE *file)
+{
+  if (msvcrt_is_std_stream(file))
+    _unlock(_STREAM_LOCKS + (file - MSVCRT__iob));
+  else
+    LeaveCriticalSection(&((file_crit *)file)->crit);
+}
+
 /*********************************************************************
  *		_access (MSVCRT.@)
  */
@@ -605,7 +677,11 @@ int CDECL MSVCRT_fflush(MSVCRT_FILE* file)
   if(!file) {
 	_flushall();
   } else if(file->_flag & MSVCRT__IOWRT) {
-  	int res=msvcrt_flush_buffer(file);
+  	int res;
+
+  	MSVCRT__lock_file(file);
+  	res=msvcrt_flush_buffer(file);
+  	MSVCRT__unlock_file(file);
   	return res;
   }
   return 0;
@@ -788,6 +864,8 @@ int CDECL MSVCRT__fcloseall(void)
 /* free everything on process exit */
 void msvcrt_free_io(void)
 {
+    int i;
+
     MSVCRT__fcloseall();
     /* The Win32 _fcloseall() function explicitly doesn't close stdin,
      * stdout, and stderr (unlike GNU), so we need to fclose() them here
@@ -796,6 +874,18 @@ void msvcrt_free_io(void)
     MSVCRT_fclose(&MSVCRT__iob[0]);
     MSVCRT_fclose(&MSVCRT__iob[1]);
     MSVCRT_fclose(&MSVCRT__iob[2]);
+
+    for (i = 3; i < MSVCRT_stream_idx; i++)
+    {
+        file_crit *fc = (file_crit *)MSVCRT_fstreams[i];
+
+        if (!fc) continue;
+        fc->crit.DebugInfo->Spare[0] = 0;
+        DeleteCriticalSection(&fc->crit);
+        MSVCRT_free(fc);
+        MSVCRT_fstreams[i] = NULL;
+    }
+
     MSVCRT_file_cs.DebugInfo->Spare[0] = 0;
     DeleteCriticalSection(&MSVCRT_file_cs);
 }
@@ -904,6 +994,9 @@ int CDECL MSVCRT__locking(int fd, int mode, LONG nbytes)
  */
 int CDECL MSVCRT_fseek(MSVCRT_FILE* file, long offset, int whence)
 {
+  int ret;
+
+  MSVCRT__lock_file(file);
   /* Flush output if needed */
   if(file->_flag & MSVCRT__IOWRT)
 	msvcrt_flush_buffer(file);
@@ -920,7 +1013,9 @@ int CDECL MSVCRT_fseek(MSVCRT_FILE* file, long offset, int whence)
   }
   /* Clear end of file flag */
   file->_flag &= ~MSVCRT__IOEOF;
-  return (MSVCRT__lseek(file->_file,offset,whence) == -1)?-1:0;
+  ret = (MSVCRT__lseek(file->_file,offset,whence) == -1)?-1:0;
+  MSVCRT__unlock_file(file);
+  return ret;
 }
 
 /*********************************************************************
@@ -1650,13 +1745,24 @@ int CDECL _rmtmp(void)
  */
 static unsigned int remove_cr(char *buf, unsigned int count)
 {
-    unsigned int i, j;
-
-    for (i=0, j=0; j < count; j++)
-        if ((buf[j] != '\r') || ((j+1) < count && buf[j+1] != '\n'))
-	    buf[i++] = buf[j];
+    char *src = buf, *dst, *end = buf + count, *cr;
 
-    return count - i;
+    /* skip quickly to the first \r, most buffers don't need any change */
+    if (!(cr = memchr(buf, '\r', count))) return 0;
+    dst = cr;
+    src = cr;
+    while (src < end)
+    {
+        /* src points to a \r: drop it if it ends the buffer or precedes \n */
+        if (src + 1 < end && src[1] != '\n')
+            *dst++ = '\r';
+        src++;
+        if (!(cr = memchr(src, '\r', end - src))) cr = end;
+        memmove(dst, src, cr - src);
+        dst += cr - src;
+        src = cr;
+    }
+    return count - (dst - buf);
 }
 
 /*********************************************************************
@@ -1686,17 +1792,14 @@ static int read_i(int fd, void *buf, unsigned int count)
     {
         if (MSVCRT_fdesc[fd].wxflag & WX_TEXT)
         {
-            int i;
             /* in text mode, a ctrl-z signals EOF */
-            for (i=0; i<num_read; i++)
+            char *ctrlz = memchr(bufstart, 0x1a, num_read);
+
+            if (ctrlz)
             {
-                if (bufstart[i] == 0x1a)
-                {
-                    num_read = i;
-                    MSVCRT_fdesc[fd].wxflag |= (WX_ATEOF|WX_READEOF);
-                    TRACE(":^Z EOF %s\n",debugstr_an(buf,num_read));
-                    break;
-                }
+                num_read = ctrlz - bufstart;
+                MSVCRT_fdesc[fd].wxflag |= (WX_ATEOF|WX_READEOF);
+                TRACE(":^Z EOF %s\n",debugstr_an(buf,num_read));
             }
         }
         if (count != 0 && num_read == 0)
@@ -2143,6 +2246,7 @@ int CDECL MSVCRT_fclose(MSVCRT_FILE* file)
 {
   int r, flag;
 
+  MSVCRT__lock_file(file);
   flag = file->_flag;
   MSVCRT_free(file->_tmpfname);
   file->_tmpfname = NULL;
@@ -2155,6 +2259,7 @@ int CDECL MSVCRT_fclose(MSVCRT_FILE* file)
   r=MSVCRT__close(file->_file);
 
   file->_flag = 0;
+  MSVCRT__unlock_file(file);
 
   return ((r == -1) || (flag & MSVCRT__IOERR) ? MSVCRT_EOF : 0);
 }
@@ -2200,6 +2305,7 @@ int CDECL MSVCRT__filbuf(MSVCRT_FILE* file)
 	}
   	return c;
   } else {
+	msvcrt_grow_buffer(file);
 	file->_cnt = read_i(file->_file, file->_base, file->_bufsiz);
 	if(file->_cnt<=0) {
             file->_flag |= (file->_cnt == 0) ? MSVCRT__IOEOF : MSVCRT__IOERR;
@@ -2213,9 +2319,9 @@ int CDECL MSVCRT__filbuf(MSVCRT_FILE* file)
 }
 
 /*********************************************************************
- *		fgetc (MSVCRT.@)
+ *		_fgetc_nolock (MSVCRT.@)
  */
-int CDECL MSVCRT_fgetc(MSVCRT_FILE* file)
+int CDECL MSVCRT__fgetc_nolock(MSVCRT_FILE* file)
 {
   unsigned char *i;
   unsigned int j;
@@ -2232,6 +2338,19 @@ int CDECL MSVCRT_fgetc(MSVCRT_FILE* file)
   } while(1);
 }
 
+/*********************************************************************
+ *		fgetc (MSVCRT.@)
+ */
+int CDECL MSVCRT_fgetc(MSVCRT_FILE* file)
+{
+  int ret;
+
+  MSVCRT__lock_file(file);
+  ret = MSVCRT__fgetc_nolock(file);
+  MSVCRT__unlock_file(file);
+  return ret;
+}
+
 /*********************************************************************
  *		_fgetchar (MSVCRT.@)
  */
@@ -2251,11 +2370,36 @@ char * CDECL MSVCRT_fgets(char *s, int size, MSVCRT_FILE* file)
   TRACE(":file(%p) fd (%d) str (%p) len (%d)\n",
 	file,file->_file,s,size);
 
-  while ((size >1) && (cc = MSVCRT_fgetc(file)) != MSVCRT_EOF && cc != '\n')
+  MSVCRT__lock_file(file);
+  while (size > 1)
     {
+      /* copy straight from the buffer up to the end of the line, or up to
+       * a \r in text mode which needs the checks done by fgetc */
+      if (file->_cnt > 0)
+        {
+          int len = min(file->_cnt, size - 1);
+          char *end = memchr(file->_ptr, '\n', len), *cr;
+
+          if (end) len = end - file->_ptr;
+          if ((MSVCRT_fdesc[file->_file].wxflag & WX_TEXT) &&
+              (cr = memchr(file->_ptr, '\r', len)))
+            len = cr - file->_ptr;
+          if (len > 0)
+            {
+              memcpy(s, file->_ptr, len);
+              file->_ptr += len;
+              file->_cnt -= len;
+              s += len;
+              size -= len;
+              continue;
+            }
+        }
+      if ((cc = MSVCRT__fgetc_nolock(file)) == MSVCRT_EOF || cc == '\n')
+        break;
       *s++ = (char)cc;
       size --;
     }
+  MSVCRT__unlock_file(file);
   if ((cc == MSVCRT_EOF) && (s == buf_start)) /* If nothing read, return 0*/
   {
     TRACE(":nothing read\n");
@@ -2269,12 +2413,12 @@ char * CDECL MSVCRT_fgets(char *s, int size, MSVCRT_FILE* file)
 }
 
 /*********************************************************************
- *		fgetwc (MSVCRT.@)
+ *		_fgetwc_nolock (MSVCRT.@)
  *
  * In MSVCRT__O_TEXT mode, multibyte characters are read from the file, dropping
  * the CR from CR/LF combinations
  */
-MSVCRT_wint_t CDECL MSVCRT_fgetwc(MSVCRT_FILE* file)
+MSVCRT_wint_t CDECL MSVCRT__fgetwc_nolock(MSVCRT_FILE* file)
 {
   char c;
 
@@ -2307,7 +2451,7 @@ MSVCRT_wint_t CDECL MSVCRT_fgetwc(MSVCRT_FILE* file)
       return wc;
     }
     
-  c = MSVCRT_fgetc(file);
+  c = MSVCRT__fgetc_nolock(file);
   if ((*__p___mb_cur_max() > 1) && MSVCRT_isleadbyte(c))
     {
       FIXME("Treat Multibyte characters\n");
@@ -2318,6 +2462,19 @@ MSVCRT_wint_t CDECL MSVCRT_fgetwc(MSVCRT_FILE* file)
     return (MSVCRT_wint_t)c;
 }
 
+/*********************************************************************
+ *		fgetwc (MSVCRT.@)
+ */
+MSVCRT_wint_t CDECL MSVCRT_fgetwc(MSVCRT_FILE* file)
+{
+  MSVCRT_wint_t ret;
+
+  MSVCRT__lock_file(file);
+  ret = MSVCRT__fgetwc_nolock(file);
+  MSVCRT__unlock_file(file);
+  return ret;
+}
+
 /*********************************************************************
  *		_getw (MSVCRT.@)
  */
@@ -2326,14 +2483,17 @@ int CDECL MSVCRT__getw(MSVCRT_FILE* file)
   char *ch;
   int i, j, k;
   ch = (char *)&i;
+  MSVCRT__lock_file(file);
   for (j=0; j<sizeof(int); j++) {
-    k = MSVCRT_fgetc(file);
+    k = MSVCRT__fgetc_nolock(file);
     if (k == MSVCRT_EOF) {
       file->_flag |= MSVCRT__IOEOF;
+      MSVCRT__unlock_file(file);
       return EOF;
     }
     ch[j] = k;
   }
+  MSVCRT__unlock_file(file);
   return i;
 }
 
@@ -2372,11 +2532,13 @@ MSVCRT_wchar_t * CDECL MSVCRT_fgetws(MSVCRT_wchar_t *s, int size, MSVCRT_FILE* f
   TRACE(":file(%p) fd (%d) str (%p) len (%d)\n",
         file,file->_file,s,size);
 
-  while ((size >1) && (cc = MSVCRT_fgetwc(file)) != MSVCRT_WEOF && cc != '\n')
+  MSVCRT__lock_file(file);
+  while ((size >1) && (cc = MSVCRT__fgetwc_nolock(file)) != MSVCRT_WEOF && cc != '\n')
     {
       *s++ = (char)cc;
       size --;
     }
+  MSVCRT__unlock_file(file);
   if ((cc == MSVCRT_WEOF) && (s == buf_start)) /* If nothing read, return 0*/
   {
     TRACE(":nothing read\n");
@@ -2390,9 +2552,9 @@ MSVCRT_wchar_t * CDECL MSVCRT_fgetws(MSVCRT_wchar_t *s, int size, MSVCRT_FILE* f
 }
 
 /*********************************************************************
- *		fwrite (MSVCRT.@)
+ *		_fwrite_nolock (MSVCRT.@)
  */
-MSVCRT_size_t CDECL MSVCRT_fwrite(const void *ptr, MSVCRT_size_t size, MSVCRT_size_t nmemb, MSVCRT_FILE* file)
+MSVCRT_size_t CDECL MSVCRT__fwrite_nolock(const void *ptr, MSVCRT_size_t size, MSVCRT_size_t nmemb, MSVCRT_FILE* file)
 {
   MSVCRT_size_t wrcnt=size * nmemb;
   int written = 0;
@@ -2415,7 +2577,19 @@ MSVCRT_size_t CDECL MSVCRT_fwrite(const void *ptr, MSVCRT_size_t size, MSVCRT_si
   if(wrcnt) {
 	/* Flush buffer */
   	int res=msvcrt_flush_buffer(file);
-	if(!res) {
+	/* keep small writes in the buffer, except on the standard streams
+	 * which are written through as before */
+	if(!res && file->_bufsiz == 0 && !(file->_flag & MSVCRT__IONBF) &&
+	   !msvcrt_is_std_stream(file)) {
+		msvcrt_alloc_buffer(file);
+		res = msvcrt_flush_buffer(file);
+	}
+	if(!res && wrcnt < file->_cnt && !msvcrt_is_std_stream(file)) {
+		memcpy(file->_ptr, ptr, wrcnt);
+		file->_cnt -= wrcnt;
+		file->_ptr += wrcnt;
+		written += wrcnt;
+	} else if(!res) {
 		int pwritten = MSVCRT__write(file->_file, ptr, wrcnt);
   		if (pwritten <= 0)
                 {
@@ -2428,6 +2602,19 @@ MSVCRT_size_t CDECL MSVCRT_fwrite(const void *ptr, MSVCRT_size_t size, MSVCRT_si
   return written / size;
 }
 
+/*********************************************************************
+ *		fwrite (MSVCRT.@)
+ */
+MSVCRT_size_t CDECL MSVCRT_fwrite(const void *ptr, MSVCRT_size_t size, MSVCRT_size_t nmemb, MSVCRT_FILE* file)
+{
+  MSVCRT_size_t ret;
+
+  MSVCRT__lock_file(file);
+  ret = MSVCRT__fwrite_nolock(ptr, size, nmemb, file);
+  MSVCRT__unlock_file(file);
+  return ret;
+}
+
 /*********************************************************************
  *		fputwc (MSVCRT.@)
  */
@@ -2522,13 +2709,13 @@ MSVCRT_FILE * CDECL MSVCRT__wfopen(const MSVCRT_wchar_t *path, const MSVCRT_wcha
     return MSVCRT__wfsopen( path, mode, MSVCRT__SH_DENYNO );
 }
 
-/* MSVCRT_fputc calls MSVCRT__flsbuf which calls MSVCRT_fputc */
+/* MSVCRT__fputc_nolock calls MSVCRT__flsbuf which calls MSVCRT__fputc_nolock */
 int CDECL MSVCRT__flsbuf(int c, MSVCRT_FILE* file);
 
 /*********************************************************************
- *		fputc (MSVCRT.@)
+ *		_fputc_nolock (MSVCRT.@)
  */
-int CDECL MSVCRT_fputc(int c, MSVCRT_FILE* file)
+int CDECL MSVCRT__fputc_nolock(int c, MSVCRT_FILE* file)
 {
   if(file->_cnt>0) {
     *file->_ptr++=c;
@@ -2545,6 +2732,19 @@ int CDECL MSVCRT_fputc(int c, MSVCRT_FILE* file)
   }
 }
 
+/*********************************************************************
+ *		fputc (MSVCRT.@)
+ */
+int CDECL MSVCRT_fputc(int c, MSVCRT_FILE* file)
+{
+  int ret;
+
+  MSVCRT__lock_file(file);
+  ret = MSVCRT__fputc_nolock(c, file);
+  MSVCRT__unlock_file(file);
+  return ret;
+}
+
 /*********************************************************************
  *		_flsbuf (MSVCRT.@)
  */
@@ -2563,7 +2763,7 @@ int CDECL MSVCRT__flsbuf(int c, MSVCRT_FILE* file)
   }
   if(file->_bufsiz) {
         int res=msvcrt_flush_buffer(file);
-	return res?res : MSVCRT_fputc(c, file);
+	return res?res : MSVCRT__fputc_nolock(c, file);
   } else {
 	unsigned char cc=c;
         int len;
@@ -2583,9 +2783,9 @@ int CDECL _fputchar(int c)
 }
 
 /*********************************************************************
- *		fread (MSVCRT.@)
+ *		_fread_nolock (MSVCRT.@)
  */
-MSVCRT_size_t CDECL MSVCRT_fread(void *ptr, MSVCRT_size_t size, MSVCRT_size_t nmemb, MSVCRT_FILE* file)
+MSVCRT_size_t CDECL MSVCRT__fread_nolock(void *ptr, MSVCRT_size_t size, MSVCRT_size_t nmemb, MSVCRT_FILE* file)
 { MSVCRT_size_t rcnt=size * nmemb;
   MSVCRT_size_t read=0;
   int pread=0;
@@ -2613,13 +2813,15 @@ MSVCRT_size_t CDECL MSVCRT_fread(void *ptr, MSVCRT_size_t size, MSVCRT_size_t nm
   while(rcnt>0)
   {
     int i;
-    /* Fill the buffer on small reads.
-     * TODO: Use a better buffering strategy.
+    /* Fill the buffer when the rest of the read fits in it, larger
+     * reads go straight to the destination.
      */
-    if (!file->_cnt && size*nmemb <= MSVCRT_BUFSIZ/2 && !(file->_flag & MSVCRT__IONBF)) {
+    if (!file->_cnt && rcnt < (file->_bufsiz ? file->_bufsiz : MSVCRT_INTERNAL_BUFSIZ) &&
+        !(file->_flag & MSVCRT__IONBF)) {
       if (file->_bufsiz == 0) {
         msvcrt_alloc_buffer(file);
       }
+      msvcrt_grow_buffer(file);
       file->_cnt = MSVCRT__read(file->_file, file->_base, file->_bufsiz);
       file->_ptr = file->_base;
       i = (file->_cnt<rcnt) ? file->_cnt : rcnt;
@@ -2656,6 +2858,19 @@ MSVCRT_size_t CDECL MSVCRT_fread(void *ptr, MSVCRT_size_t size, MSVCRT_size_t nm
   return read / size;
 }
 
+/*********************************************************************
+ *		fread (MSVCRT.@)
+ */
+MSVCRT_size_t CDECL MSVCRT_fread(void *ptr, MSVCRT_size_t size, MSVCRT_size_t nmemb, MSVCRT_FILE* file)
+{
+  MSVCRT_size_t ret;
+
+  MSVCRT__lock_file(file);
+  ret = MSVCRT__fread_nolock(ptr, size, nmemb, file);
+  MSVCRT__unlock_file(file);
+  return ret;
+}
+
 /*********************************************************************
  *		freopen (MSVCRT.@)
  *
@@ -2721,6 +2936,8 @@ LONG CDECL MSVCRT_ftell(MSVCRT_FILE* file)
 {
   int off=0;
   long pos;
+
+  MSVCRT__lock_file(file);
   if(file->_bufsiz)  {
 	if( file->_flag & MSVCRT__IOWRT ) {
 		off = file->_ptr - file->_base;
@@ -2729,6 +2946,7 @@ LONG CDECL MSVCRT_ftell(MSVCRT_FILE* file)
 	}
   }
   pos = _tell(file->_file);
+  MSVCRT__unlock_file(file);
   if(pos == -1) return pos;
   return off + pos;
 }
@@ -2763,12 +2981,20 @@ int CDECL MSVCRT_fgetpos(MSVCRT_FILE* file, MSVCRT_fpos_t *pos)
 int CDECL MSVCRT_fputs(const char *s, MSVCRT_FILE* file)
 {
     size_t i, len = strlen(s);
+    int ret = 0;
+
+    MSVCRT__lock_file(file);
     if (!(MSVCRT_fdesc[file->_file].wxflag & WX_TEXT))
-      return MSVCRT_fwrite(s,sizeof(*s),len,file) == len ? 0 : MSVCRT_EOF;
-    for (i=0; i<len; i++)
-      if (MSVCRT_fputc(s[i], file) == MSVCRT_EOF) 
-	return MSVCRT_EOF;
-    return 0;
+      ret = MSVCRT__fwrite_nolock(s,sizeof(*s),len,file) == len ? 0 : MSVCRT_EOF;
+    else
+      for (i=0; i<len; i++)
+        if (MSVCRT__fputc_nolock(s[i], file) == MSVCRT_EOF)
+        {
+          ret = MSVCRT_EOF;
+          break;
+        }
+    MSVCRT__unlock_file(file);
+    return ret;
 }
 
 /*********************************************************************
@@ -2777,16 +3003,27 @@ int CDECL MSVCRT_fputs(const char *s, MSVCRT_FILE* file)
 int CDECL MSVCRT_fputws(const MSVCRT_wchar_t *s, MSVCRT_FILE* file)
 {
     size_t i, len = strlenW(s);
+    int ret = 0;
+
+    MSVCRT__lock_file(file);
     if (!(MSVCRT_fdesc[file->_file].wxflag & WX_TEXT))
-      return MSVCRT_fwrite(s,sizeof(*s),len,file) == len ? 0 : MSVCRT_EOF;
-    for (i=0; i<len; i++)
+      ret = MSVCRT__fwrite_nolock(s,sizeof(*s),len,file) == len ? 0 : MSVCRT_EOF;
+    else
+      for (i=0; i<len; i++)
       {
-        if ((s[i] == '\n') && (MSVCRT_fputc('\r', file) == MSVCRT_EOF))
-	  return MSVCRT_WEOF;
-	if (MSVCRT_fputwc(s[i], file) == MSVCRT_WEOF)
-	  return MSVCRT_WEOF; 
+        if ((s[i] == '\n') && (MSVCRT__fputc_nolock('\r', file) == MSVCRT_EOF))
+        {
+          ret = MSVCRT_WEOF;
+          break;
+        }
+        if (MSVCRT__fwrite_nolock(&s[i], sizeof(s[i]), 1, file) != 1)
+        {
+          ret = MSVCRT_WEOF;
+          break;
+        }
       }
-    return 0;
+    MSVCRT__unlock_file(file);
+    return ret;
 }
 
 /*********************************************************************
@@ -2813,9 +3050,11 @@ char * CDECL MSVCRT_gets(char *buf)
   int    cc;
   char * buf_start = buf;
 
-  for(cc = MSVCRT_fgetc(MSVCRT_stdin); cc != MSVCRT_EOF && cc != '\n';
-      cc = MSVCRT_fgetc(MSVCRT_stdin))
+  MSVCRT__lock_file(MSVCRT_stdin);
+  for(cc = MSVCRT__fgetc_nolock(MSVCRT_stdin); cc != MSVCRT_EOF && cc != '\n';
+      cc = MSVCRT__fgetc_nolock(MSVCRT_stdin))
   if(cc != '\r') *buf++ = (char)cc;
+  MSVCRT__unlock_file(MSVCRT_stdin);
 
   *buf = '\0';
 
@@ -2939,7 +3178,9 @@ int CDECL MSVCRT_setvbuf(MSVCRT_FILE* file, char *buf, int mode, MSVCRT_size_t s
 {
   /* TODO: Check if file busy */
   if(file->_bufsiz) {
-	MSVCRT_free(file->_base);
+	if(file->_flag & MSVCRT__IOMYBUF)
+		MSVCRT_free(file->_base);
+	file->_flag &= ~MSVCRT__IOMYBUF;
 	file->_bufsiz = 0;
 	file->_cnt = 0;
   }
@@ -3126,6 +3367,7 @@ int CDECL MSVCRT_ungetc(int c, MSVCRT_FILE * file)
 {
 	if (c == MSVCRT_EOF)
 		return MSVCRT_EOF;
+	MSVCRT__lock_file(file);
 	if(file->_bufsiz == 0 && !(file->_flag & MSVCRT__IONBF)) {
 		msvcrt_alloc_buffer(file);
 		file->_ptr++;
@@ -3135,9 +3377,10 @@ int CDECL MSVCRT_ungetc(int c, MSVCRT_FILE * file)
 		*file->_ptr=c;
 		file->_cnt++;
 		MSVCRT_clearerr(file);
-		return c;
-	}
-	return MSVCRT_EOF;
+	} else
+		c = MSVCRT_EOF;
+	MSVCRT__unlock_file(file);
+	return c;
 }
 
 /*********************************************************************
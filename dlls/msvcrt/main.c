@@ -90,8 +90,9 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
   case DLL_THREAD_ATTACH:
     break;
   case DLL_PROCESS_DETACH:
-    msvcrt_free_mt_locks();
+    /* Closing the streams takes the stream locks, free them afterwards */
     msvcrt_free_io();
+    msvcrt_free_mt_locks();
     msvcrt_free_console();
     msvcrt_free_args();
     msvcrt_free_signals();
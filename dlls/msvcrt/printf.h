@@ -0,0 +1,289 @@
+/*
+ * general implementation of the printf format engine used by the narrow
+ * and wide sprintf families
+ *
+ * Copyright 1999 Alexandre Julliard
+ * Copyright 2000 Jon Griffiths
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* The format string is parsed in its own character type, so that narrow
+ * formats don't have to be converted to wide chars first.  The output side
+ * (pf_output) handles both narrow and wide buffers. */
+
+#ifdef WIDE_PRINTF
+#define _CHAR_ MSVCRT_wchar_t
+#define _STRCHR_(str, c) strchrW((str), (c))
+#define _DEBUGSTR_(str) debugstr_w(str)
+#define _OUTPUT_STRING_ pf_output_stringW
+#define _FUNCTION_ static int pf_vsnprintf_w( pf_output *out, const MSVCRT_wchar_t *format, va_list valist )
+#else /* WIDE_PRINTF */
+#define _CHAR_ char
+#define _STRCHR_(str, c) strchr((str), (c))
+#define _DEBUGSTR_(str) debugstr_a(str)
+#define _OUTPUT_STRING_ pf_output_stringA
+#define _FUNCTION_ static int pf_vsnprintf_a( pf_output *out, const char *format, va_list valist )
+#endif /* WIDE_PRINTF */
+#define _ISDIGIT_(c) ((c) >= '0' && (c) <= '9')
+
+_FUNCTION_
+{
+    int r;
+    const _CHAR_ *q, *p = format;
+    pf_flags flags;
+
+    TRACE("format is %s\n",_DEBUGSTR_(format));
+    while (*p)
+    {
+        q = _STRCHR_( p, '%' );
+
+        /* there's no % characters left, output the rest of the string */
+        if( !q )
+        {
+            r = _OUTPUT_STRING_(out, p, -1);
+            if( r<0 )
+                return r;
+            p += r;
+            continue;
+        }
+
+        /* there's characters before the %, output them */
+        if( q != p )
+        {
+            r = _OUTPUT_STRING_(out, p, q - p);
+            if( r<0 )
+                return r;
+            p = q;
+        }
+
+        /* we must be at a % now, skip over it */
+        assert( *p == '%' );
+        p++;
+
+        /* output a single % character */
+        if( *p == '%' )
+        {
+            r = _OUTPUT_STRING_(out, p++, 1);
+            if( r<0 )
+                return r;
+            continue;
+        }
+
+        /* parse the flags */
+        memset( &flags, 0, sizeof flags );
+        while (*p)
+        {
+            if( *p == '+' || *p == ' ' )
+            {
+                if ( flags.Sign != '+' )
+                    flags.Sign = *p;
+            }
+            else if( *p == '-' )
+                flags.LeftAlign = *p;
+            else if( *p == '0' )
+                flags.PadZero = *p;
+            else if( *p == '#' )
+                flags.Alternate = *p;
+            else
+                break;
+            p++;
+        }
+
+        /* deal with the field width specifier */
+        flags.FieldLength = 0;
+        if( *p == '*' )
+        {
+            flags.FieldLength = va_arg( valist, int );
+            if (flags.FieldLength < 0)
+            {
+                flags.LeftAlign = '-';
+                flags.FieldLength = -flags.FieldLength;
+            }
+            p++;
+        }
+        else while( _ISDIGIT_(*p) )
+        {
+            flags.FieldLength *= 10;
+            flags.FieldLength += *p++ - '0';
+        }
+
+        /* deal with precision */
+        flags.Precision = -1;
+        if( *p == '.' )
+        {
+            flags.Precision = 0;
+            p++;
+            if( *p == '*' )
+            {
+                flags.Precision = va_arg( valist, int );
+                p++;
+            }
+            else while( _ISDIGIT_(*p) )
+            {
+                flags.Precision *= 10;
+                flags.Precision += *p++ - '0';
+            }
+        }
+
+        /* deal with integer width modifier */
+        while( *p )
+        {
+            if( *p == 'h' || *p == 'l' || *p == 'L' )
+            {
+                flags.IntegerLength = *p;
+                p++;
+            }
+            else if( *p == 'I' )
+            {
+                if( *(p+1) == '6' && *(p+2) == '4' )
+                {
+                    flags.IntegerDouble++;
+                    p += 3;
+                }
+                else if( *(p+1) == '3' && *(p+2) == '2' )
+                    p += 3;
+                else if( _ISDIGIT_(*(p+1)) || *(p+1) == 0 )
+                    break;
+                else
+                    p++;
+            }
+            else if( *p == 'w' )
+                flags.WideString = *p++;
+            else if( *p == 'F' )
+                p++; /* ignore */
+            else
+                break;
+        }
+
+        flags.Format = *p;
+        r = 0;
+
+        /* output a string */
+        if(  flags.Format == 's' || flags.Format == 'S' )
+            r = pf_handle_string_format( out, va_arg(valist, const void*), -1,
+                                         &flags, (flags.Format == 'S') );
+
+        /* output a single character */
+        else if( flags.Format == 'c' || flags.Format == 'C' )
+        {
+            INT ch = va_arg( valist, int );
+
+            r = pf_handle_string_format( out, &ch, 1, &flags, (flags.Format == 'C') );
+        }
+
+        /* output a pointer */
+        else if( flags.Format == 'p' )
+        {
+            char pointer[11];
+
+            flags.PadZero = 0;
+            if( flags.Alternate )
+                sprintf(pointer, "0X%08lX", va_arg(valist, long));
+            else
+                sprintf(pointer, "%08lX", va_arg(valist, long));
+            r = pf_output_format_A( out, pointer, -1, &flags );
+        }
+
+        /* deal with %n */
+        else if( flags.Format == 'n' )
+        {
+            int *x = va_arg(valist, int *);
+            *x = out->used;
+        }
+
+        /* deal with integers */
+        else if( pf_is_integer_format( flags.Format ) )
+        {
+            char number[40], *x = number;
+            LONGLONG value;
+
+            /* Estimate largest possible required buffer size:
+               * Chooses the larger of the field or precision
+               * Includes extra bytes: 1 byte for null, 1 byte for sign,
+                 4 bytes for exponent, 2 bytes for alternate formats, 1 byte 
+                 for a decimal, and 1 byte for an additional float digit. */
+            int x_len = ((flags.FieldLength > flags.Precision) ? 
+                        flags.FieldLength : flags.Precision) + 10;
+
+            if( x_len >= sizeof number)
+                x = HeapAlloc( GetProcessHeap(), 0, x_len );
+
+            if( flags.IntegerDouble )
+                value = va_arg(valist, LONGLONG);
+            else if( flags.Format == 'd' || flags.Format == 'i' )
+            {
+                value = va_arg(valist, int);
+                if( flags.IntegerLength == 'h' )
+                    value = (short)value;
+            }
+            else
+            {
+                value = va_arg(valist, unsigned int);
+                if( flags.IntegerLength == 'h' )
+                    value = (unsigned short)value;
+            }
+            pf_integer_conv( x, x_len, &flags, value );
+
+            r = pf_output_format_A( out, x, -1, &flags );
+            if( x != number )
+                HeapFree( GetProcessHeap(), 0, x );
+        }
+
+        /* deal with floats using libc's printf */
+        else if( pf_is_double_format( flags.Format ) )
+        {
+            char fmt[20], number[40], *x = number;
+
+            /* Estimate largest possible required buffer size:
+               * Chooses the larger of the field or precision
+               * Includes extra bytes: 1 byte for null, 1 byte for sign,
+                 4 bytes for exponent, 2 bytes for alternate formats, 1 byte 
+                 for a decimal, and 1 byte for an additional float digit. */
+            int x_len = ((flags.FieldLength > flags.Precision) ? 
+                        flags.FieldLength : flags.Precision) + 10;
+
+            if( x_len >= sizeof number)
+                x = HeapAlloc( GetProcessHeap(), 0, x_len );
+
+            pf_rebuild_format_string( fmt, &flags );
+
+            sprintf( x, fmt, va_arg(valist, double) );
+
+            r = pf_output_stringA( out, x, -1 );
+            if( x != number )
+                HeapFree( GetProcessHeap(), 0, x );
+        }
+        else
+            continue;
+
+        if( r<0 )
+            return r;
+        p++;
+    }
+
+    /* check we reached the end, and null terminate the string */
+    assert( *p == 0 );
+    _OUTPUT_STRING_( out, p, 1 );
+
+    return out->used - 1;
+}
+
+#undef _CHAR_
+#undef _STRCHR_
+#undef _DEBUGSTR_
+#undef _OUTPUT_STRING_
+#undef _FUNCTION_
+#undef _ISDIGIT_
@@ -36,6 +36,25 @@
 
 static HANDLE proc_handles[2];
 
+static void (__cdecl *p_lock_file)(FILE*);
+static void (__cdecl *p_unlock_file)(FILE*);
+static int (__cdecl *p_fgetc_nolock)(FILE*);
+static int (__cdecl *p_fputc_nolock)(int, FILE*);
+static size_t (__cdecl *p_fread_nolock)(void*, size_t, size_t, FILE*);
+static size_t (__cdecl *p_fwrite_nolock)(const void*, size_t, size_t, FILE*);
+
+static void init(void)
+{
+    HMODULE hmsvcrt = GetModuleHandleA("msvcrt.dll");
+
+    p_lock_file = (void*)GetProcAddress(hmsvcrt, "_lock_file");
+    p_unlock_file = (void*)GetProcAddress(hmsvcrt, "_unlock_file");
+    p_fgetc_nolock = (void*)GetProcAddress(hmsvcrt, "_fgetc_nolock");
+    p_fputc_nolock = (void*)GetProcAddress(hmsvcrt, "_fputc_nolock");
+    p_fread_nolock = (void*)GetProcAddress(hmsvcrt, "_fread_nolock");
+    p_fwrite_nolock = (void*)GetProcAddress(hmsvcrt, "_fwrite_nolock");
+}
+
 static void test_fdopen( void )
 {
     static const char buffer[] = {0,1,2,3,4,5,6,7,8,9};
@@ -1028,11 +1047,183 @@ static void test_pipes(const char* selfname)
     ok(fclose(file) == 0, "unable to close the pipe: %d\n", errno);
 }
 
+struct lock_file_info
+{
+    FILE *file;
+    HANDLE done;
+};
+
+static DWORD WINAPI lock_file_thread(void *arg)
+{
+    struct lock_file_info *info = arg;
+
+    p_lock_file(info->file);
+    p_unlock_file(info->file);
+    SetEvent(info->done);
+    return 0;
+}
+
+static void test_lock_file(FILE *file)
+{
+    struct lock_file_info info;
+    HANDLE thread;
+    DWORD ret, tid;
+
+    info.file = file;
+    info.done = CreateEventA(NULL, FALSE, FALSE, NULL);
+
+    /* the lock is recursive, and keeps other threads out until released */
+    p_lock_file(file);
+    p_lock_file(file);
+    thread = CreateThread(NULL, 0, lock_file_thread, &info, 0, &tid);
+    ret = WaitForSingleObject(info.done, 100);
+    ok(ret == WAIT_TIMEOUT, "thread got the lock, ret %u\n", ret);
+    p_unlock_file(file);
+    ret = WaitForSingleObject(info.done, 100);
+    ok(ret == WAIT_TIMEOUT, "thread got the lock, ret %u\n", ret);
+    p_unlock_file(file);
+    ret = WaitForSingleObject(info.done, 5000);
+    ok(ret == WAIT_OBJECT_0, "thread didn't get the lock, ret %u\n", ret);
+
+    WaitForSingleObject(thread, 5000);
+    CloseHandle(thread);
+    CloseHandle(info.done);
+}
+
+static void test_stream_locks(void)
+{
+    static const char tempfile[] = "locks.tst";
+    static const char data[] = "abcdef";
+    char buf[16];
+    FILE *file;
+    size_t ret;
+
+    if (!p_lock_file || !p_unlock_file)
+    {
+        win_skip("_lock_file not available\n");
+        return;
+    }
+
+    file = fopen(tempfile, "w+b");
+    ok(file != NULL, "unable to create %s\n", tempfile);
+    if (!file) return;
+    test_lock_file(file);
+    test_lock_file(stdout);
+
+    if (!p_fgetc_nolock || !p_fputc_nolock || !p_fread_nolock || !p_fwrite_nolock)
+    {
+        win_skip("_nolock functions not available\n");
+        fclose(file);
+        unlink(tempfile);
+        return;
+    }
+
+    /* the _nolock functions work the same with the stream locked by the caller */
+    p_lock_file(file);
+    ret = p_fwrite_nolock(data, 1, 4, file);
+    ok(ret == 4, "_fwrite_nolock returned %u\n", (unsigned int)ret);
+    ok(p_fputc_nolock('e', file) == 'e', "_fputc_nolock failed\n");
+    ok(fputc('f', file) == 'f', "fputc failed\n");
+    rewind(file);
+    ok(p_fgetc_nolock(file) == 'a', "_fgetc_nolock didn't return 'a'\n");
+    memset(buf, 0, sizeof(buf));
+    ret = p_fread_nolock(buf, 1, sizeof(buf), file);
+    ok(ret == 5, "_fread_nolock returned %u\n", (unsigned int)ret);
+    ok(!strcmp(buf, data + 1), "got '%s'\n", buf);
+    ok(p_fgetc_nolock(file) == EOF, "_fgetc_nolock didn't return EOF\n");
+    p_unlock_file(file);
+
+    fclose(file);
+    unlink(tempfile);
+}
+
+static void test_setvbuf(void)
+{
+    static const char tempfile[] = "setvbuf.tst";
+    char buf1[64], buf2[64], buf[16];
+    FILE *file;
+    int ret;
+
+    file = fopen(tempfile, "w+b");
+    ok(file != NULL, "unable to create %s\n", tempfile);
+    if (!file) return;
+
+    /* replacing a buffer set by the caller must not free it */
+    ret = setvbuf(file, buf1, _IOFBF, sizeof(buf1));
+    ok(!ret, "setvbuf returned %d\n", ret);
+    ret = setvbuf(file, buf2, _IOFBF, sizeof(buf2));
+    ok(!ret, "setvbuf returned %d\n", ret);
+    ok(fputs("hello", file) >= 0, "fputs failed\n");
+    ret = setvbuf(file, NULL, _IONBF, 0);
+    ok(!ret, "setvbuf returned %d\n", ret);
+
+    rewind(file);
+    memset(buf, 0, sizeof(buf));
+    ok(fread(buf, 1, sizeof(buf), file) == 5, "fread failed\n");
+    ok(!strcmp(buf, "hello"), "got '%s'\n", buf);
+    fclose(file);
+    unlink(tempfile);
+}
+
+static void test_stream_speed(void)
+{
+    static const char line[] = "The quick brown fox jumps over the lazy dog 0123456789\n";
+    static const char tempfile[] = "speed.tst";
+    char buf[256], *big;
+    DWORD start, elapsed, count = 50000, i, size;
+    FILE *file;
+
+    if (!winetest_interactive)
+    {
+        skip("timing test, set WINETEST_INTERACTIVE to run it\n");
+        return;
+    }
+
+    file = fopen(tempfile, "wt");
+    ok(file != NULL, "unable to create %s\n", tempfile);
+    if (!file) return;
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+        fputs(line, file);
+    fclose(file);
+    elapsed = GetTickCount() - start;
+    size = count * (sizeof(line) - 1);
+    trace("fputs: %u lines (%u bytes) in %u ms\n", count, size, elapsed);
+
+    file = fopen(tempfile, "rt");
+    start = GetTickCount();
+    for (i = 0; fgets(buf, sizeof(buf), file); i++)
+        if (strcmp(buf, line)) break;
+    elapsed = GetTickCount() - start;
+    ok(i == count, "read %u lines, expected %u\n", i, count);
+    ok(!ferror(file) && feof(file), "expected eof\n");
+    fclose(file);
+    trace("fgets: %u lines in %u ms\n", i, elapsed);
+
+    /* in text mode the \r\n pairs are translated back to \n */
+    big = malloc(size + 1);
+    file = fopen(tempfile, "rt");
+    start = GetTickCount();
+    for (i = 0; i < size; i += 1000)
+        if (!fread(big + i, 1, min(1000, size - i), file)) break;
+    elapsed = GetTickCount() - start;
+    ok(i >= size, "fread stopped at %u, expected %u\n", i, size);
+    ok(!memcmp(big, line, sizeof(line) - 1), "wrong data\n");
+    ok(!memcmp(big + size - sizeof(line) + 1, line, sizeof(line) - 1), "wrong data at the end\n");
+    fclose(file);
+    trace("fread: %u bytes in %u ms\n", size, elapsed);
+    free(big);
+
+    unlink(tempfile);
+}
+
 START_TEST(file)
 {
     int arg_c;
     char** arg_v;
 
+    init();
+
     arg_c = winetest_get_mainargs( &arg_v );
 
     /* testing low-level I/O */
@@ -1068,6 +1259,9 @@ START_TEST(file)
     test_get_osfhandle();
     test_setmaxstdio();
     test_pipes(arg_v[0]);
+    test_stream_locks();
+    test_setvbuf();
+    test_stream_speed();
 
     /* Wait for the (_P_NOWAIT) spawned processes to finish to make sure the report
      * file contains lines in the correct order
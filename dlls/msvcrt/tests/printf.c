@@ -492,6 +492,26 @@ static void test_sprintf( void )
     r = sprintf(buffer, format);
     ok(!strcmp(buffer,"%0"), "failed: \"%s\"\n", buffer);
     ok( r==2, "return count wrong\n");
+
+    format = "%#06x";
+    r = sprintf(buffer, format, 0x1f);
+    ok(!strcmp(buffer,"0x001f") && r==6, "#06x failed: '%s'\n", buffer);
+
+    format = "%#x";
+    r = sprintf(buffer, format, 0);
+    ok(!strcmp(buffer,"0") && r==1, "#x failed: '%s'\n", buffer);
+
+    format = "% 05d";
+    r = sprintf(buffer, format, 42);
+    ok(!strcmp(buffer," 0042") && r==5, "' 05d' failed: '%s'\n", buffer);
+
+    format = "%08.3d";
+    r = sprintf(buffer, format, -42);
+    ok(!strcmp(buffer,"    -042") && r==8, "08.3d failed: '%s'\n", buffer);
+
+    format = "%hd %hu";
+    r = sprintf(buffer, format, 0x1ffff, -1);
+    ok(!strcmp(buffer,"-1 65535") && r==8, "hd hu failed: '%s'\n", buffer);
 }
 
 static void test_swprintf( void )
@@ -547,6 +567,35 @@ static void test_snprintf (void)
     };
 }
 
+static void test_printf_speed(void)
+{
+    static const wchar_t formatW[] = {'%','s',' ','%','5','d',' ','%','0','8','x',' ','%','.','2','f',0};
+    static const wchar_t nameW[] = {'n','a','m','e',0};
+    char buffer[100];
+    wchar_t bufferW[100];
+    DWORD start, count = 200000, i, elapsed;
+
+    if (!winetest_interactive)
+    {
+        skip("timing test, set WINETEST_INTERACTIVE to run it\n");
+        return;
+    }
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+        sprintf(buffer, "%s %5d %08x %.2f", "name", i, i, 1.5);
+    elapsed = GetTickCount() - start;
+    ok(!strcmp(buffer, "name 199999 00030d3f 1.50"), "got '%s'\n", buffer);
+    trace("sprintf: %u calls in %u ms\n", count, elapsed);
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+        swprintf(bufferW, formatW, nameW, i, i, 1.5);
+    elapsed = GetTickCount() - start;
+    ok(wcslen(bufferW) == 25, "got length %d\n", (int)wcslen(bufferW));
+    trace("swprintf: %u calls in %u ms\n", count, elapsed);
+}
+
 static void test_fcvt(void)
 {
     char *str;
@@ -650,4 +699,5 @@ START_TEST(printf)
     test_swprintf();
     test_snprintf();
     test_fcvt();
+    test_printf_speed();
 }
@@ -377,14 +377,6 @@ static inline BOOL pf_is_double_format( char fmt )
     return strchr( float_fmts, fmt ) ? TRUE : FALSE;
 }
 
-static inline BOOL pf_is_valid_format( char fmt )
-{
-    static const char float_fmts[] = "acCdeEfgGinouxX";
-    if (!fmt)
-        return FALSE;
-    return strchr( float_fmts, fmt ) ? TRUE : FALSE;
-}
-
 static void pf_rebuild_format_string( char *p, pf_flags *flags )
 {
     *p++ = '%';
@@ -418,7 +410,7 @@ static void pf_integer_conv( char *buf, int buf_len, pf_flags *flags,
     unsigned int base;
     const char *digits;
 
-    int i, j, k;
+    int i, j, k, prefix = 0;
     char number[40], *tmp = number;
 
     if( buf_len > sizeof number )
@@ -440,6 +432,8 @@ static void pf_integer_conv( char *buf, int buf_len, pf_flags *flags,
         x = -x;
         flags->Sign = '-';
     }
+    else if( flags->Format != 'd' && flags->Format != 'i' )
+        flags->Sign = 0;
 
     /* Do conversion (backwards) */
     i = 0;
@@ -452,19 +446,25 @@ static void pf_integer_conv( char *buf, int buf_len, pf_flags *flags,
             x = (ULONGLONG) x / base;
             tmp[i++] = digits[j];
         }
-    k = flags->Precision - i;
+    if( flags->Alternate && base == 16 && i && tmp[i-1] != '0' )
+        prefix = 2;
+
+    /* zero padding goes between the sign or 0x prefix and the digits, the
+       same way as precision digits; it is ignored if a precision is given */
+    k = flags->Precision;
+    if( flags->PadZero && !flags->LeftAlign && k < 0 )
+        k = flags->FieldLength - prefix - (flags->Sign ? 1 : 0);
+    flags->PadZero = 0;
+    k -= i;
     while( k-- > 0 )
         tmp[i++] = '0';
-    if( flags->Alternate )
+    if( prefix )
     {
-        if( base == 16 )
-        {
-            tmp[i++] = digits[16];
-            tmp[i++] = '0';
-        }
-        else if( base == 8 && tmp[i-1] != '0' )
-            tmp[i++] = '0';
+        tmp[i++] = digits[16];
+        tmp[i++] = '0';
     }
+    else if( flags->Alternate && base == 8 && (!i || tmp[i-1] != '0') )
+        tmp[i++] = '0';
 
     /* Reverse for buf */
     j = 0;
@@ -481,240 +481,13 @@ static void pf_integer_conv( char *buf, int buf_len, pf_flags *flags,
     return;
 }
 
-/*********************************************************************
- *  pf_vsnprintf  (INTERNAL)
- *
- *  implements both A and W vsnprintf functions
- */
-static int pf_vsnprintf( pf_output *out, const WCHAR *format, va_list valist )
-{
-    int r;
-    LPCWSTR q, p = format;
-    pf_flags flags;
-
-    TRACE("format is %s\n",debugstr_w(format));
-    while (*p)
-    {
-        q = strchrW( p, '%' );
-
-        /* there's no % characters left, output the rest of the string */
-        if( !q )
-        {
-            r = pf_output_stringW(out, p, -1);
-            if( r<0 )
-                return r;
-            p += r;
-            continue;
-        }
-
-        /* there's characters before the %, output them */
-        if( q != p )
-        {
-            r = pf_output_stringW(out, p, q - p);
-            if( r<0 )
-                return r;
-            p = q;
-        }
-
-        /* we must be at a % now, skip over it */
-        assert( *p == '%' );
-        p++;
-
-        /* output a single % character */
-        if( *p == '%' )
-        {
-            r = pf_output_stringW(out, p++, 1);
-            if( r<0 )
-                return r;
-            continue;
-        }
-
-        /* parse the flags */
-        memset( &flags, 0, sizeof flags );
-        while (*p)
-        {
-            if( *p == '+' || *p == ' ' )
-            {
-                if ( flags.Sign != '+' )
-                    flags.Sign = *p;
-            }
-            else if( *p == '-' )
-                flags.LeftAlign = *p;
-            else if( *p == '0' )
-                flags.PadZero = *p;
-            else if( *p == '#' )
-                flags.Alternate = *p;
-            else
-                break;
-            p++;
-        }
-
-        /* deal with the field width specifier */
-        flags.FieldLength = 0;
-        if( *p == '*' )
-        {
-            flags.FieldLength = va_arg( valist, int );
-            if (flags.FieldLength < 0)
-            {
-                flags.LeftAlign = '-';
-                flags.FieldLength = -flags.FieldLength;
-            }
-            p++;
-        }
-        else while( isdigit(*p) )
-        {
-            flags.FieldLength *= 10;
-            flags.FieldLength += *p++ - '0';
-        }
-
-        /* deal with precision */
-        flags.Precision = -1;
-        if( *p == '.' )
-        {
-            flags.Precision = 0;
-            p++;
-            if( *p == '*' )
-            {
-                flags.Precision = va_arg( valist, int );
-                p++;
-            }
-            else while( isdigit(*p) )
-            {
-                flags.Precision *= 10;
-                flags.Precision += *p++ - '0';
-            }
-        }
-
-        /* deal with integer width modifier */
-        while( *p )
-        {
-            if( *p == 'h' || *p == 'l' || *p == 'L' )
-            {
-                flags.IntegerLength = *p;
-                p++;
-            }
-            else if( *p == 'I' )
-            {
-                if( *(p+1) == '6' && *(p+2) == '4' )
-                {
-                    flags.IntegerDouble++;
-                    p += 3;
-                }
-                else if( *(p+1) == '3' && *(p+2) == '2' )
-                    p += 3;
-                else if( isdigit(*(p+1)) || *(p+1) == 0 )
-                    break;
-                else
-                    p++;
-            }
-            else if( *p == 'w' )
-                flags.WideString = *p++;
-            else if( *p == 'F' )
-                p++; /* ignore */
-            else
-                break;
-        }
-
-        flags.Format = *p;
-        r = 0;
-
-        /* output a string */
-        if(  flags.Format == 's' || flags.Format == 'S' )
-            r = pf_handle_string_format( out, va_arg(valist, const void*), -1,
-                                         &flags, (flags.Format == 'S') );
-
-        /* output a single character */
-        else if( flags.Format == 'c' || flags.Format == 'C' )
-        {
-            INT ch = va_arg( valist, int );
-
-            r = pf_handle_string_format( out, &ch, 1, &flags, (flags.Format == 'C') );
-        }
-
-        /* output a pointer */
-        else if( flags.Format == 'p' )
-        {
-            char pointer[11];
-
-            flags.PadZero = 0;
-            if( flags.Alternate )
-                sprintf(pointer, "0X%08lX", va_arg(valist, long));
-            else
-                sprintf(pointer, "%08lX", va_arg(valist, long));
-            r = pf_output_format_A( out, pointer, -1, &flags );
-        }
-
-        /* deal with %n */
-        else if( flags.Format == 'n' )
-        {
-            int *x = va_arg(valist, int *);
-            *x = out->used;
-        }
+/* pf_vsnprintf_a */
+#undef WIDE_PRINTF
+#include "printf.h"
 
-        /* deal with 64-bit integers */
-        else if( pf_is_integer_format( flags.Format ) && flags.IntegerDouble )
-        {
-            char number[40], *x = number;
-
-            /* Estimate largest possible required buffer size:
-               * Chooses the larger of the field or precision
-               * Includes extra bytes: 1 byte for null, 1 byte for sign,
-                 4 bytes for exponent, 2 bytes for alternate formats, 1 byte 
-                 for a decimal, and 1 byte for an additional float digit. */
-            int x_len = ((flags.FieldLength > flags.Precision) ? 
-                        flags.FieldLength : flags.Precision) + 10;
-
-            if( x_len >= sizeof number)
-                x = HeapAlloc( GetProcessHeap(), 0, x_len );
-
-            pf_integer_conv( x, x_len, &flags, va_arg(valist, LONGLONG) );
-
-            r = pf_output_format_A( out, x, -1, &flags );
-            if( x != number )
-                HeapFree( GetProcessHeap(), 0, x );
-        }
-
-        /* deal with integers and floats using libc's printf */
-        else if( pf_is_valid_format( flags.Format ) )
-        {
-            char fmt[20], number[40], *x = number;
-
-            /* Estimate largest possible required buffer size:
-               * Chooses the larger of the field or precision
-               * Includes extra bytes: 1 byte for null, 1 byte for sign,
-                 4 bytes for exponent, 2 bytes for alternate formats, 1 byte 
-                 for a decimal, and 1 byte for an additional float digit. */
-            int x_len = ((flags.FieldLength > flags.Precision) ? 
-                        flags.FieldLength : flags.Precision) + 10;
-
-            if( x_len >= sizeof number)
-                x = HeapAlloc( GetProcessHeap(), 0, x_len );
-
-            pf_rebuild_format_string( fmt, &flags );
-
-            if( pf_is_double_format( flags.Format ) )
-                sprintf( x, fmt, va_arg(valist, double) );
-            else
-                sprintf( x, fmt, va_arg(valist, int) );
-
-            r = pf_output_stringA( out, x, -1 );
-            if( x != number )
-                HeapFree( GetProcessHeap(), 0, x );
-        }
-        else
-            continue;
-
-        if( r<0 )
-            return r;
-        p++;
-    }
-
-    /* check we reached the end, and null terminate the string */
-    assert( *p == 0 );
-    pf_output_stringW( out, p, 1 );
-
-    return out->used - 1;
-}
+/* pf_vsnprintf_w */
+#define WIDE_PRINTF 1
+#include "printf.h"
 
 /*********************************************************************
  *		_vsnprintf (MSVCRT.@)
@@ -722,28 +495,14 @@ static int pf_vsnprintf( pf_output *out, const WCHAR *format, va_list valist )
 int CDECL MSVCRT_vsnprintf( char *str, unsigned int len,
                             const char *format, va_list valist )
 {
-    DWORD sz;
-    LPWSTR formatW = NULL;
     pf_output out;
-    int r;
 
     out.unicode = FALSE;
     out.buf.A = str;
     out.used = 0;
     out.len = len;
 
-    if( format )
-    {
-        sz = MultiByteToWideChar( CP_ACP, 0, format, -1, NULL, 0 );
-        formatW = HeapAlloc( GetProcessHeap(), 0, sz*sizeof(WCHAR) );
-        MultiByteToWideChar( CP_ACP, 0, format, -1, formatW, sz );
-    }
-
-    r = pf_vsnprintf( &out, formatW, valist );
-
-    HeapFree( GetProcessHeap(), 0, formatW );
-
-    return r;
+    return pf_vsnprintf_a( &out, format, valist );
 }
 
 /*********************************************************************
@@ -780,7 +539,7 @@ int CDECL MSVCRT_vsnwprintf( MSVCRT_wchar_t *str, unsigned int len,
     out.used = 0;
     out.len = len;
 
-    return pf_vsnprintf( &out, format, valist );
+    return pf_vsnprintf_w( &out, format, valist );
 }
 
 /*********************************************************************
@@ -48,6 +48,7 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(module);
 WINE_DECLARE_DEBUG_CHANNEL(relay);
+WINE_DECLARE_DEBUG_CHANNEL(relayprof);
 WINE_DECLARE_DEBUG_CHANNEL(snoop);
 WINE_DECLARE_DEBUG_CHANNEL(loaddll);
 WINE_DECLARE_DEBUG_CHANNEL(imports);
@@ -420,7 +421,7 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
         const WCHAR *user = current_modref ? current_modref->ldr.BaseDllName.Buffer : NULL;
         proc = SNOOP_GetProcAddress( module, exports, exp_size, proc, ordinal, user );
     }
-    if (TRACE_ON(relay))
+    if (TRACE_ON(relay) || TRACE_ON(relayprof))
     {
         const WCHAR *user = current_modref ? current_modref->ldr.BaseDllName.Buffer : NULL;
         proc = RELAY_GetProcAddress( module, exports, exp_size, proc, ordinal, user );
@@ -1398,7 +1399,7 @@ static void load_builtin_callback( void *module, const char *filename )
     SERVER_END_REQ;
 
     /* setup relay debugging entry points */
-    if (TRACE_ON(relay)) RELAY_SetupDLL( module );
+    if (TRACE_ON(relay) || TRACE_ON(relayprof)) RELAY_SetupDLL( module );
 }
 
 
@@ -2141,6 +2142,7 @@ void WINAPI LdrShutdownProcess(void)
 {
     TRACE("()\n");
     process_detach( TRUE, (LPVOID)1 );
+    RELAY_ProfileProcessDetach();
 }
 
 /******************************************************************
@@ -2176,6 +2178,7 @@ void WINAPI LdrShutdownThread(void)
 
     RtlLeaveCriticalSection( &loader_section );
     RtlFreeHeap( GetProcessHeap(), 0, NtCurrentTeb()->ThreadLocalStoragePointer );
+    RELAY_ProfileThreadDetach();
 }
 
 
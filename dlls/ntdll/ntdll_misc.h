@@ -90,6 +90,8 @@ extern FARPROC RELAY_GetProcAddress( HMODULE module, const IMAGE_EXPORT_DIRECTOR
 extern FARPROC SNOOP_GetProcAddress( HMODULE hmod, const IMAGE_EXPORT_DIRECTORY *exports, DWORD exp_size,
                                      FARPROC origfun, DWORD ordinal, const WCHAR *user );
 extern void RELAY_SetupDLL( HMODULE hmod );
+extern void RELAY_ProfileThreadDetach(void);
+extern void RELAY_ProfileProcessDetach(void);
 extern void SNOOP_SetupDLL( HMODULE hmod );
 extern UNICODE_STRING windows_dir;
 extern UNICODE_STRING system_dir;
@@ -178,8 +180,9 @@ struct ntdll_thread_data
     int                reply_fd;      /* 1e4 fd for receiving server replies */
     int                wait_fd[2];    /* 1e8 fd for sleeping server requests */
     void              *vm86_ptr;      /* 1f0 data for vm86 mode */
+    void              *relay_prof;    /* 1f4 relay profiling ring buffer */
 
-    void              *pad[2];        /* 1f4 change this if you add fields! */
+    void              *pad[1];        /* 1f8 change this if you add fields! */
 };
 
 static inline struct ntdll_thread_data *ntdll_get_thread_data(void)
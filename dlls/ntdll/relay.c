@@ -23,9 +23,17 @@
 #include "wine/port.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -34,12 +42,14 @@
 #include "wine/exception.h"
 #include "ntdll_misc.h"
 #include "wine/unicode.h"
+#include "wine/list.h"
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(relay);
 
 #ifdef __i386__
 
+WINE_DECLARE_DEBUG_CHANNEL(relayprof);
 WINE_DECLARE_DEBUG_CHANNEL(snoop);
 WINE_DECLARE_DEBUG_CHANNEL(seh);
 
@@ -60,8 +70,9 @@ struct relay_descr  /* descriptor for a module */
 
 struct relay_entry_point
 {
-    void       *orig_func;    /* original entry point function */
-    const char *name;         /* function name (if any) */
+    void               *orig_func;    /* original entry point function */
+    const char         *name;         /* function name (if any) */
+    struct prof_export *prof;         /* profiling statistics (if any) */
 };
 
 struct relay_private_data
@@ -299,6 +310,399 @@ static BOOL check_from_module( const WCHAR **includelist, const WCHAR **excludel
     return show;
 }
 
+/***********************************************************************/
+/* relay profiling */
+/***********************************************************************/
+
+/* With +relayprof, every relayed call is recorded as a fixed-size record
+ * in a ring buffer owned by the calling thread, so nothing is formatted
+ * and no lock is taken on the call path.  Full buffers are folded into
+ * per-export call counts and latency histograms, and optionally appended
+ * to the file named by $WINERELAYPROF (with the unix pid appended).  The
+ * statistics are printed at process exit and when the process receives
+ * SIGPROF.  tools/examine-relayprof decodes the file. */
+
+#define PROF_RING_SIZE     4096  /* records per thread */
+#define PROF_HIST_BUCKETS  32
+
+/* file format, little-endian: a header, then a sequence of chunks */
+#define PROF_FILE_MAGIC    0x46505257  /* "WRPF" */
+#define PROF_FILE_VERSION  1
+#define PROF_CHUNK_NAME    1  /* count = export id, data = NUL-terminated name */
+#define PROF_CHUNK_CALLS   2  /* count = number of records, data = records */
+
+struct prof_file_header
+{
+    DWORD magic;
+    DWORD version;
+    DWORD pid;                  /* unix pid */
+    DWORD unit;                 /* duration of a time unit in ns */
+};
+
+struct prof_chunk
+{
+    DWORD type;
+    DWORD tid;                  /* thread that made the calls */
+    DWORD count;
+    DWORD size;                 /* size of the data that follows */
+};
+
+struct prof_record
+{
+    DWORD     id;               /* export id */
+    DWORD     elapsed;          /* duration of the call, saturated */
+    ULONGLONG start;            /* system time at the start of the call */
+};
+
+struct prof_export
+{
+    struct prof_export *next;   /* next in prof_exports list */
+    DWORD               id;
+    DWORD               count;
+    ULONGLONG           total;
+    DWORD               max;
+    DWORD               histogram[PROF_HIST_BUCKETS];  /* by number of significant bits */
+    char                name[1];  /* dll.function */
+};
+
+struct prof_ring
+{
+    struct list         entry;   /* entry in prof_rings list */
+    DWORD               tid;
+    unsigned int        flushed; /* CS records already folded into the statistics */
+    volatile unsigned int count; /* records in use, only written by the owner or under CS */
+    struct prof_record  records[PROF_RING_SIZE];
+};
+
+static struct prof_export *prof_exports;  /* CS prof_section */
+static DWORD prof_export_count;           /* CS prof_section */
+static struct list prof_rings = LIST_INIT( prof_rings );  /* CS prof_section */
+static int prof_fd = -1;
+static BOOL prof_init_done;
+static volatile int prof_dump_requested;
+
+static RTL_CRITICAL_SECTION prof_section;
+static RTL_CRITICAL_SECTION_DEBUG prof_section_debug =
+{
+    0, 0, &prof_section,
+    { &prof_section_debug.ProcessLocksList, &prof_section_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": prof_section") }
+};
+static RTL_CRITICAL_SECTION prof_section = { &prof_section_debug, -1, 0, 0, 0, 0 };
+
+/* write to the profile file, giving up on it on errors */
+static void prof_write( const void *buffer, size_t size )
+{
+    const char *ptr = buffer;
+
+    while (size && prof_fd != -1)
+    {
+        ssize_t ret = write( prof_fd, ptr, size );
+        if (ret < 0)
+        {
+            if (errno == EINTR) continue;
+            ERR_(relayprof)( "write failed, profile file closed: %s\n", strerror(errno) );
+            close( prof_fd );
+            prof_fd = -1;
+            break;
+        }
+        ptr += ret;
+        size -= ret;
+    }
+}
+
+static void prof_sigprof_handler( int signal )
+{
+    prof_dump_requested = 1;
+}
+
+/***********************************************************************
+ *           prof_init
+ *
+ * Open the profile file and install the dump signal handler.
+ */
+static void prof_init(void)
+{
+    struct sigaction sig_act;
+    const char *name;
+
+    if (prof_init_done) return;
+    prof_init_done = TRUE;
+
+    if ((name = getenv( "WINERELAYPROF" )) && *name)
+    {
+        char *path = RtlAllocateHeap( GetProcessHeap(), 0, strlen(name) + 12 );
+
+        if (path)
+        {
+            sprintf( path, "%s.%d", name, (int)getpid() );
+            if ((prof_fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0666 )) != -1)
+            {
+                struct prof_file_header header;
+
+                fcntl( prof_fd, F_SETFD, 1 );  /* set close on exec flag */
+                header.magic   = PROF_FILE_MAGIC;
+                header.version = PROF_FILE_VERSION;
+                header.pid     = getpid();
+                header.unit    = 100;
+                prof_write( &header, sizeof(header) );
+            }
+            else ERR_(relayprof)( "cannot create %s: %s\n", path, strerror(errno) );
+            RtlFreeHeap( GetProcessHeap(), 0, path );
+        }
+    }
+
+    sig_act.sa_handler = prof_sigprof_handler;
+    sig_act.sa_flags   = SA_RESTART;
+    sigemptyset( &sig_act.sa_mask );
+    sigaction( SIGPROF, &sig_act, NULL );
+}
+
+/***********************************************************************
+ *           prof_get_export
+ *
+ * Get the statistics of a relayed entry point, creating them on first use.
+ */
+static struct prof_export *prof_get_export( struct relay_private_data *data, unsigned int ordinal )
+{
+    struct relay_entry_point *entry_point = data->entry_points + ordinal;
+    struct prof_export *export;
+
+    RtlEnterCriticalSection( &prof_section );
+    if (!(export = entry_point->prof))
+    {
+        char name[80];
+        struct prof_chunk chunk;
+
+        if (entry_point->name)
+            snprintf( name, sizeof(name), "%s.%s", data->dllname, entry_point->name );
+        else
+            snprintf( name, sizeof(name), "%s.%u", data->dllname, data->base + ordinal );
+
+        if ((export = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                       sizeof(*export) + strlen(name) )))
+        {
+            strcpy( export->name, name );
+            export->id = prof_export_count++;
+            export->next = prof_exports;
+            prof_exports = export;
+            entry_point->prof = export;
+
+            chunk.type  = PROF_CHUNK_NAME;
+            chunk.tid   = 0;
+            chunk.count = export->id;
+            chunk.size  = (strlen(name) + 4) & ~3;
+            prof_write( &chunk, sizeof(chunk) );
+            memset( name + strlen(name), 0, chunk.size - strlen(name) );
+            prof_write( name, chunk.size );
+        }
+    }
+    RtlLeaveCriticalSection( &prof_section );
+    return export;
+}
+
+/***********************************************************************
+ *           prof_flush_ring
+ *
+ * Fold the pending records of a ring into the statistics and append them
+ * to the profile file. Must be called with prof_section held.
+ */
+static void prof_flush_ring( struct prof_ring *ring, struct prof_export **exports )
+{
+    unsigned int i, end = ring->count;
+    struct prof_export *export;
+    struct prof_chunk chunk;
+
+    if (end == ring->flushed) return;
+
+    for (i = ring->flushed; i < end; i++)
+    {
+        const struct prof_record *rec = &ring->records[i];
+        DWORD elapsed = rec->elapsed;
+        int bucket = 0;
+
+        if (!(export = exports[rec->id])) continue;
+        export->count++;
+        export->total += elapsed;
+        if (elapsed > export->max) export->max = elapsed;
+        while (elapsed && bucket < PROF_HIST_BUCKETS - 1)
+        {
+            elapsed >>= 1;
+            bucket++;
+        }
+        export->histogram[bucket]++;
+    }
+
+    chunk.type  = PROF_CHUNK_CALLS;
+    chunk.tid   = ring->tid;
+    chunk.count = end - ring->flushed;
+    chunk.size  = chunk.count * sizeof(ring->records[0]);
+    prof_write( &chunk, sizeof(chunk) );
+    prof_write( &ring->records[ring->flushed], chunk.size );
+
+    ring->flushed = end;
+}
+
+/* build the table of exports indexed by id; must be called with prof_section held */
+static struct prof_export **prof_get_export_table(void)
+{
+    struct prof_export **exports, *export;
+
+    if (!(exports = RtlAllocateHeap( GetProcessHeap(), 0,
+                                     (prof_export_count + 1) * sizeof(*exports) )))
+        return NULL;
+    for (export = prof_exports; export; export = export->next) exports[export->id] = export;
+    return exports;
+}
+
+/* flush the ring of the current thread when it is full */
+static void prof_flush_current_ring( struct prof_ring *ring )
+{
+    struct prof_export **exports;
+
+    RtlEnterCriticalSection( &prof_section );
+    if ((exports = prof_get_export_table()))
+    {
+        prof_flush_ring( ring, exports );
+        RtlFreeHeap( GetProcessHeap(), 0, exports );
+    }
+    ring->flushed = ring->count = 0;
+    RtlLeaveCriticalSection( &prof_section );
+}
+
+static int prof_compare_exports( const void *p1, const void *p2 )
+{
+    const struct prof_export *e1 = *(const struct prof_export * const *)p1;
+    const struct prof_export *e2 = *(const struct prof_export * const *)p2;
+
+    if (e1->total != e2->total) return e1->total < e2->total ? 1 : -1;
+    return e2->count - e1->count;
+}
+
+/***********************************************************************
+ *           prof_dump
+ *
+ * Flush all the rings and print the per-export statistics, most
+ * expensive first.
+ */
+static void prof_dump(void)
+{
+    struct prof_export **exports, **sorted;
+    struct prof_ring *ring;
+    unsigned int i, count = 0;
+    int j, last;
+
+    RtlEnterCriticalSection( &prof_section );
+
+    if (!(exports = prof_get_export_table())) goto done;
+    LIST_FOR_EACH_ENTRY( ring, &prof_rings, struct prof_ring, entry )
+        prof_flush_ring( ring, exports );
+
+    sorted = exports;  /* reuse the table, ids are no longer needed */
+    for (i = 0; i < prof_export_count; i++)
+        if (exports[i] && exports[i]->count) sorted[count++] = exports[i];
+    qsort( sorted, count, sizeof(*sorted), prof_compare_exports );
+
+    DPRINTF( "%04x:relayprof: %u functions called, times in units of 100ns (inclusive)\n",
+             GetCurrentThreadId(), count );
+    for (i = 0; i < count; i++)
+    {
+        struct prof_export *export = sorted[i];
+
+        DPRINTF( "%04x:relayprof: %-40s calls=%u total=%s avg=%u max=%u hist=",
+                 GetCurrentThreadId(), export->name, export->count,
+                 wine_dbgstr_longlong(export->total),
+                 (DWORD)(export->total / export->count), export->max );
+        for (last = PROF_HIST_BUCKETS - 1; last > 0; last--) if (export->histogram[last]) break;
+        for (j = 0; j <= last; j++) DPRINTF( j ? ",%u" : "%u", export->histogram[j] );
+        DPRINTF( "\n" );
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, exports );
+
+done:
+    RtlLeaveCriticalSection( &prof_section );
+}
+
+/***********************************************************************
+ *           prof_record_call
+ *
+ * Record a call to a relayed entry point in the ring of the current thread.
+ */
+static void prof_record_call( struct relay_private_data *data, unsigned int ordinal,
+                              const LARGE_INTEGER *start )
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct prof_ring *ring = thread_data->relay_prof;
+    struct prof_export *export = data->entry_points[ordinal].prof;
+    struct prof_record *rec;
+    LARGE_INTEGER now;
+    ULONGLONG elapsed;
+
+    NtQuerySystemTime( &now );
+
+    if (!export && !(export = prof_get_export( data, ordinal ))) return;
+
+    if (!ring)
+    {
+        if (!(ring = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*ring) ))) return;
+        ring->tid = GetCurrentThreadId();
+        ring->flushed = ring->count = 0;
+        RtlEnterCriticalSection( &prof_section );
+        list_add_tail( &prof_rings, &ring->entry );
+        RtlLeaveCriticalSection( &prof_section );
+        thread_data->relay_prof = ring;
+    }
+
+    rec = &ring->records[ring->count];
+    rec->id = export->id;
+    elapsed = now.QuadPart - start->QuadPart;
+    rec->elapsed = elapsed > ~0u ? ~0u : elapsed;
+    rec->start = start->QuadPart;
+    if (++ring->count == PROF_RING_SIZE) prof_flush_current_ring( ring );
+
+    if (prof_dump_requested)
+    {
+        prof_dump_requested = 0;
+        prof_dump();
+    }
+}
+
+/***********************************************************************
+ *           RELAY_ProfileThreadDetach
+ *
+ * Flush and free the profiling ring of the exiting thread.
+ */
+void RELAY_ProfileThreadDetach(void)
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct prof_ring *ring = thread_data->relay_prof;
+
+    if (!ring) return;
+    prof_flush_current_ring( ring );
+    RtlEnterCriticalSection( &prof_section );
+    list_remove( &ring->entry );
+    RtlLeaveCriticalSection( &prof_section );
+    thread_data->relay_prof = NULL;
+    RtlFreeHeap( GetProcessHeap(), 0, ring );
+}
+
+
+/***********************************************************************
+ *           RELAY_ProfileProcessDetach
+ *
+ * Print the final statistics and close the profile file.
+ */
+void RELAY_ProfileProcessDetach(void)
+{
+    if (!prof_init_done) return;
+    prof_dump();
+    RtlEnterCriticalSection( &prof_section );
+    if (prof_fd != -1) close( prof_fd );
+    prof_fd = -1;
+    RtlLeaveCriticalSection( &prof_section );
+}
+
+
 /***********************************************************************
  *           RELAY_PrintArgs
  */
@@ -357,9 +761,17 @@ static LONGLONG WINAPI relay_call_from_32( struct relay_descr *descr, unsigned i
     BYTE flags   = HIBYTE(HIWORD(idx));
     struct relay_private_data *data = descr->private;
     struct relay_entry_point *entry_point = data->entry_points + ordinal;
+    LARGE_INTEGER start;
 
     if (!TRACE_ON(relay))
+    {
+        if (!TRACE_ON(relayprof))
+            return call_entry_point( entry_point->orig_func, nb_args, stack + 1 );
+
+        NtQuerySystemTime( &start );
         ret = call_entry_point( entry_point->orig_func, nb_args, stack + 1 );
+        prof_record_call( data, ordinal, &start );
+    }
     else
     {
         if (entry_point->name)
@@ -369,7 +781,9 @@ static LONGLONG WINAPI relay_call_from_32( struct relay_descr *descr, unsigned i
         RELAY_PrintArgs( stack + 1, nb_args, descr->arg_types[ordinal] );
         DPRINTF( ") ret=%08x\n", stack[0] );
 
+        NtQuerySystemTime( &start );
         ret = call_entry_point( entry_point->orig_func, nb_args, stack + 1 );
+        if (TRACE_ON(relayprof)) prof_record_call( data, ordinal, &start );
 
         if (entry_point->name)
             DPRINTF( "%04x:Ret  %s.%s()", GetCurrentThreadId(), data->dllname, entry_point->name );
@@ -401,6 +815,7 @@ void WINAPI __regs_relay_call_from_32_regs( struct relay_descr *descr, unsigned
     BYTE *orig_func = entry_point->orig_func;
     int *args = (int *)context->Esp;
     int args_copy[32];
+    LARGE_INTEGER start;
 
     /* restore the context to what it was before the relay thunk */
     context->Eax = orig_eax;
@@ -432,8 +847,9 @@ void WINAPI __regs_relay_call_from_32_regs( struct relay_descr *descr, unsigned
     memcpy( args_copy, args, nb_args * sizeof(args[0]) );
     args_copy[nb_args++] = (int)context;  /* append context argument */
 
+    NtQuerySystemTime( &start );
     call_entry_point( orig_func + 6 + *(int *)(orig_func + 6), nb_args, args_copy );
-
+    if (TRACE_ON(relayprof)) prof_record_call( data, ordinal, &start );
 
     if (TRACE_ON(relay))
     {
@@ -491,6 +907,7 @@ void RELAY_SetupDLL( HMODULE module )
     const WORD *ordptr;
 
     if (!init_done) init_debug_lists();
+    if (TRACE_ON(relayprof)) prof_init();
 
     exports = RtlImageDirectoryEntryToData( module, TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &size );
     if (!exports) return;
@@ -947,6 +1364,14 @@ void RELAY_SetupDLL( HMODULE module )
 {
 }
 
+void RELAY_ProfileThreadDetach(void)
+{
+}
+
+void RELAY_ProfileProcessDetach(void)
+{
+}
+
 void SNOOP_SetupDLL( HMODULE hmod )
 {
     FIXME("snooping works only on i386 for now.\n");
@@ -79,7 +79,15 @@ HINSTANCE OLE32_hInstance = 0; /* FIXME: make static ... */
 static HRESULT COM_GetRegisteredClassObject(const struct apartment *apt, REFCLSID rclsid,
                                             DWORD dwClsContext, LPUNKNOWN*  ppUnk);
 static void COM_RevokeAllClasses(const struct apartment *apt);
-static HRESULT get_inproc_class_object(APARTMENT *apt, HKEY hkeydll, REFCLSID rclsid, REFIID riid, BOOL hostifnecessary, void **ppv);
+
+/* registry information needed to load an in-process server or handler */
+struct inproc_class_info
+{
+    WCHAR dllpath[MAX_PATH+1];
+    WCHAR threading_model[10 /* strlenW(L"apartment")+1 */];
+};
+
+static HRESULT get_inproc_class_object(APARTMENT *apt, const struct inproc_class_info *info, REFCLSID rclsid, REFIID riid, BOOL hostifnecessary, void **ppv);
 
 static APARTMENT *MTA; /* protected by csApartment */
 static APARTMENT *MainApartment; /* the first STA apartment */
@@ -500,7 +508,7 @@ static APARTMENT *apartment_findmain(void)
 
 struct host_object_params
 {
-    HKEY hkeydll;
+    WCHAR dllpath[MAX_PATH+1]; /* path of the in-process server */
     CLSID clsid; /* clsid of object to marshal */
     IID iid; /* interface to marshal */
     HANDLE event; /* event signalling when ready for multi-threaded case */
@@ -515,18 +523,10 @@ static HRESULT apartment_hostobject(struct apartment *apt,
     IUnknown *object;
     HRESULT hr;
     static const LARGE_INTEGER llZero;
-    WCHAR dllpath[MAX_PATH+1];
 
     TRACE("clsid %s, iid %s\n", debugstr_guid(&params->clsid), debugstr_guid(&params->iid));
 
-    if (COM_RegReadPath(params->hkeydll, NULL, NULL, dllpath, ARRAYSIZE(dllpath)) != ERROR_SUCCESS)
-    {
-        /* failure: CLSID is not found in registry */
-        WARN("class %s not registered inproc\n", debugstr_guid(&params->clsid));
-        return REGDB_E_CLASSNOTREG;
-    }
-
-    hr = apartment_getclassobject(apt, dllpath, params->apartment_threaded,
+    hr = apartment_getclassobject(apt, params->dllpath, params->apartment_threaded,
                                   &params->clsid, &params->iid, (void **)&object);
     if (FAILED(hr))
         return hr;
@@ -609,7 +609,7 @@ static DWORD CALLBACK apartment_hostobject_thread(LPVOID p)
     return S_OK;
 }
 
-static HRESULT apartment_hostobject_in_hostapt(struct apartment *apt, BOOL multi_threaded, BOOL main_apartment, HKEY hkeydll, REFCLSID rclsid, REFIID riid, void **ppv)
+static HRESULT apartment_hostobject_in_hostapt(struct apartment *apt, BOOL multi_threaded, BOOL main_apartment, LPCWSTR dllpath, REFCLSID rclsid, REFIID riid, void **ppv)
 {
     struct host_object_params params;
     HWND apartment_hwnd = NULL;
@@ -679,7 +679,7 @@ static HRESULT apartment_hostobject_in_hostapt(struct apartment *apt, BOOL multi
         }
     }
 
-    params.hkeydll = hkeydll;
+    strcpyW(params.dllpath, dllpath);
     params.clsid = *rclsid;
     params.iid = *riid;
     hr = CreateStreamOnHGlobal(NULL, TRUE, &params.stream);
@@ -2083,11 +2083,215 @@ static void get_threading_model(HKEY key, LPWSTR value, DWORD len)
         value[0] = '\0';
 }
 
-static HRESULT get_inproc_class_object(APARTMENT *apt, HKEY hkeydll,
+/*
+ * Cache of the registry lookups done by CoGetClassObject for in-process
+ * classes. Resolving a class takes several registry calls, each of which is
+ * a round trip to the server, so the results of successful lookups are kept
+ * here. Failures are not cached, so a class is found as soon as it has been
+ * registered. The cache is flushed whenever anything below HKCR\CLSID
+ * changes. A thread pool wait on the change notification bumps
+ * class_cache_changes, so a cache hit doesn't have to leave the process.
+ * This means that a change to a cached class, such as its removal, is only
+ * seen once that wait has run: for a short while after the registry change
+ * CoGetClassObject may still load the old server.
+ */
+struct class_cache_entry
+{
+    struct list entry;
+    CLSID clsid;
+    BOOL handler;  /* InprocHandler32 rather than InprocServer32 */
+    struct inproc_class_info info;
+};
+
+#define CLASS_CACHE_MAX_ENTRIES 256
+
+static struct list class_cache = LIST_INIT(class_cache); /* protected by csClassCache */
+static unsigned int class_cache_count;  /* protected by csClassCache */
+static unsigned int class_cache_generation;  /* protected by csClassCache */
+static HKEY class_cache_key;            /* HKCR\CLSID, watched for changes */
+static HANDLE class_cache_event;        /* signalled when class_cache_key changes */
+static HANDLE class_cache_wait;         /* thread pool wait on class_cache_event */
+static LONG class_cache_changes;        /* bumped when class_cache_event is signalled */
+static LONG class_cache_changes_seen;   /* protected by csClassCache */
+static BOOL class_cache_disabled;       /* change notifications are not available */
+
+static CRITICAL_SECTION csClassCache;
+static CRITICAL_SECTION_DEBUG class_cache_cs_debug =
+{
+    0, 0, &csClassCache,
+    { &class_cache_cs_debug.ProcessLocksList, &class_cache_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": csClassCache") }
+};
+static CRITICAL_SECTION csClassCache = { &class_cache_cs_debug, -1, 0, 0, 0, 0 };
+
+/* must be called with csClassCache held */
+static void COMPOBJ_ClassCache_Flush(void)
+{
+    struct class_cache_entry *cache, *cursor2;
+
+    LIST_FOR_EACH_ENTRY_SAFE(cache, cursor2, &class_cache, struct class_cache_entry, entry)
+    {
+        list_remove(&cache->entry);
+        HeapFree(GetProcessHeap(), 0, cache);
+    }
+    class_cache_count = 0;
+    class_cache_generation++;
+}
+
+static void CALLBACK COMPOBJ_ClassCache_Notify(PVOID context, BOOLEAN timeout)
+{
+    InterlockedIncrement(&class_cache_changes);
+}
+
+/* flushes the cache if the thread pool wait has reported a change to the
+ * registry since the last call and returns FALSE if the cache can't be used.
+ * must be called with csClassCache held */
+static BOOL COMPOBJ_ClassCache_Validate(void)
+{
+    static const WCHAR wszCLSID[] = {'C','L','S','I','D',0};
+    static const DWORD filter = REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET;
+    LONG changes = class_cache_changes;
+
+    if (class_cache_disabled)
+        return FALSE;
+
+    if (!class_cache_event)
+    {
+        if (RegOpenKeyExW(HKEY_CLASSES_ROOT, wszCLSID, 0, KEY_NOTIFY, &class_cache_key) != ERROR_SUCCESS)
+            goto disable;
+        /* manual reset, so that polling doesn't steal the signal from the wait */
+        class_cache_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+        if (!class_cache_event)
+            goto disable;
+    }
+    else
+    {
+        if (changes == class_cache_changes_seen)
+            return TRUE;
+
+        /* the wait only fires once, a new one is registered below */
+        if (class_cache_wait) UnregisterWait(class_cache_wait);
+        class_cache_wait = NULL;
+        ResetEvent(class_cache_event);
+    }
+    class_cache_changes_seen = changes;
+
+    /* (re-)arm the notification before anything is cached, so that changes
+     * racing with the lookups that fill the cache are not missed. The event
+     * is manual reset, so it stays signalled until it is re-armed here */
+    COMPOBJ_ClassCache_Flush();
+    if (RegNotifyChangeKeyValue(class_cache_key, TRUE, filter, class_cache_event, TRUE) == ERROR_SUCCESS &&
+        RegisterWaitForSingleObject(&class_cache_wait, class_cache_event, COMPOBJ_ClassCache_Notify, NULL,
+                                    INFINITE, WT_EXECUTEONLYONCE))
+        return TRUE;
+
+disable:
+    WARN("can't watch HKCR\\CLSID for changes, not caching class lookups\n");
+    class_cache_disabled = TRUE;
+    return FALSE;
+}
+
+static HRESULT COM_ReadInprocClassInfo(REFCLSID rclsid, BOOL handler, struct inproc_class_info *info)
+{
+    static const WCHAR wszInprocServer32[] = {'I','n','p','r','o','c','S','e','r','v','e','r','3','2',0};
+    static const WCHAR wszInprocHandler32[] = {'I','n','p','r','o','c','H','a','n','d','l','e','r','3','2',0};
+    HKEY hkey;
+    HRESULT hr;
+
+    hr = COM_OpenKeyForCLSID(rclsid, handler ? wszInprocHandler32 : wszInprocServer32, KEY_READ, &hkey);
+    if (FAILED(hr))
+        return hr;
+
+    get_threading_model(hkey, info->threading_model, ARRAYSIZE(info->threading_model));
+    if (COM_RegReadPath(hkey, NULL, NULL, info->dllpath, ARRAYSIZE(info->dllpath)) != ERROR_SUCCESS)
+    {
+        /* failure: CLSID is not found in registry */
+        WARN("class %s not registered inproc\n", debugstr_guid(rclsid));
+        hr = REGDB_E_CLASSNOTREG;
+    }
+    RegCloseKey(hkey);
+    return hr;
+}
+
+/* looks up the in-process server or handler of a class, consulting the
+ * cache first */
+static HRESULT COMPOBJ_ClassCache_Get(REFCLSID rclsid, BOOL handler, struct inproc_class_info *info)
+{
+    struct class_cache_entry *cache;
+    unsigned int generation;
+    HRESULT hr;
+
+    EnterCriticalSection(&csClassCache);
+    if (COMPOBJ_ClassCache_Validate())
+    {
+        LIST_FOR_EACH_ENTRY(cache, &class_cache, struct class_cache_entry, entry)
+        {
+            if (cache->handler == handler && IsEqualCLSID(&cache->clsid, rclsid))
+            {
+                /* keep recently used classes at the front */
+                list_remove(&cache->entry);
+                list_add_head(&class_cache, &cache->entry);
+                *info = cache->info;
+                LeaveCriticalSection(&csClassCache);
+                TRACE("%s found in cache\n", debugstr_guid(rclsid));
+                return S_OK;
+            }
+        }
+    }
+    generation = class_cache_generation;
+    LeaveCriticalSection(&csClassCache);
+
+    /* do this outside of csClassCache so that lookups don't serialise
+     * behind the server */
+    hr = COM_ReadInprocClassInfo(rclsid, handler, info);
+
+    /* the class may be registered at any time, so only successes are kept */
+    if (FAILED(hr))
+        return hr;
+
+    EnterCriticalSection(&csClassCache);
+    /* don't cache data that may have been read before a change to the
+     * registry that has already been seen */
+    if (COMPOBJ_ClassCache_Validate() && generation == class_cache_generation &&
+        (cache = HeapAlloc(GetProcessHeap(), 0, sizeof(*cache))))
+    {
+        cache->clsid = *rclsid;
+        cache->handler = handler;
+        cache->info = *info;
+        list_add_head(&class_cache, &cache->entry);
+        if (++class_cache_count > CLASS_CACHE_MAX_ENTRIES)
+        {
+            cache = LIST_ENTRY(list_tail(&class_cache), struct class_cache_entry, entry);
+            list_remove(&cache->entry);
+            HeapFree(GetProcessHeap(), 0, cache);
+            class_cache_count--;
+        }
+    }
+    LeaveCriticalSection(&csClassCache);
+
+    return hr;
+}
+
+/* frees memory associated with the class cache */
+static void COMPOBJ_ClassCache_Free(BOOL process_exit)
+{
+    EnterCriticalSection(&csClassCache);
+    COMPOBJ_ClassCache_Flush();
+    /* wait for a running COMPOBJ_ClassCache_Notify before ole32 is unloaded.
+     * At process exit the thread pool threads are gone and the code stays */
+    if (class_cache_wait) UnregisterWaitEx(class_cache_wait, process_exit ? NULL : INVALID_HANDLE_VALUE);
+    if (class_cache_key) RegCloseKey(class_cache_key);
+    if (class_cache_event) CloseHandle(class_cache_event);
+    class_cache_wait = NULL;
+    class_cache_key = NULL;
+    class_cache_event = NULL;
+    LeaveCriticalSection(&csClassCache);
+}
+
+static HRESULT get_inproc_class_object(APARTMENT *apt, const struct inproc_class_info *info,
                                        REFCLSID rclsid, REFIID riid,
                                        BOOL hostifnecessary, void **ppv)
 {
-    WCHAR dllpath[MAX_PATH+1];
     BOOL apartment_threaded;
 
     if (hostifnecessary)
@@ -2095,22 +2299,21 @@ static HRESULT get_inproc_class_object(APARTMENT *apt, HKEY hkeydll,
         static const WCHAR wszApartment[] = {'A','p','a','r','t','m','e','n','t',0};
         static const WCHAR wszFree[] = {'F','r','e','e',0};
         static const WCHAR wszBoth[] = {'B','o','t','h',0};
-        WCHAR threading_model[10 /* strlenW(L"apartment")+1 */];
+        const WCHAR *threading_model = info->threading_model;
 
-        get_threading_model(hkeydll, threading_model, ARRAYSIZE(threading_model));
         /* "Apartment" */
         if (!strcmpiW(threading_model, wszApartment))
         {
             apartment_threaded = TRUE;
             if (apt->multi_threaded)
-                return apartment_hostobject_in_hostapt(apt, FALSE, FALSE, hkeydll, rclsid, riid, ppv);
+                return apartment_hostobject_in_hostapt(apt, FALSE, FALSE, info->dllpath, rclsid, riid, ppv);
         }
         /* "Free" */
         else if (!strcmpiW(threading_model, wszFree))
         {
             apartment_threaded = FALSE;
             if (!apt->multi_threaded)
-                return apartment_hostobject_in_hostapt(apt, TRUE, FALSE, hkeydll, rclsid, riid, ppv);
+                return apartment_hostobject_in_hostapt(apt, TRUE, FALSE, info->dllpath, rclsid, riid, ppv);
         }
         /* everything except "Apartment", "Free" and "Both" */
         else if (strcmpiW(threading_model, wszBoth))
@@ -2122,7 +2325,7 @@ static HRESULT get_inproc_class_object(APARTMENT *apt, HKEY hkeydll,
                     debugstr_w(threading_model), debugstr_guid(rclsid));
 
             if (apt->multi_threaded || !apt->main)
-                return apartment_hostobject_in_hostapt(apt, FALSE, TRUE, hkeydll, rclsid, riid, ppv);
+                return apartment_hostobject_in_hostapt(apt, FALSE, TRUE, info->dllpath, rclsid, riid, ppv);
         }
         else
             apartment_threaded = FALSE;
@@ -2130,14 +2333,7 @@ static HRESULT get_inproc_class_object(APARTMENT *apt, HKEY hkeydll,
     else
         apartment_threaded = !apt->multi_threaded;
 
-    if (COM_RegReadPath(hkeydll, NULL, NULL, dllpath, ARRAYSIZE(dllpath)) != ERROR_SUCCESS)
-    {
-        /* failure: CLSID is not found in registry */
-        WARN("class %s not registered inproc\n", debugstr_guid(rclsid));
-        return REGDB_E_CLASSNOTREG;
-    }
-
-    return apartment_getclassobject(apt, dllpath, apartment_threaded,
+    return apartment_getclassobject(apt, info->dllpath, apartment_threaded,
                                     rclsid, riid, ppv);
 }
 
@@ -2217,13 +2413,12 @@ HRESULT WINAPI CoGetClassObject(
     /* First try in-process server */
     if (CLSCTX_INPROC_SERVER & dwClsContext)
     {
-        static const WCHAR wszInprocServer32[] = {'I','n','p','r','o','c','S','e','r','v','e','r','3','2',0};
-        HKEY hkey;
+        struct inproc_class_info info;
 
         if (IsEqualCLSID(rclsid, &CLSID_InProcFreeMarshaler))
             return FTMarshalCF_Create(iid, ppv);
 
-        hres = COM_OpenKeyForCLSID(rclsid, wszInprocServer32, KEY_READ, &hkey);
+        hres = COMPOBJ_ClassCache_Get(rclsid, FALSE, &info);
         if (FAILED(hres))
         {
             if (hres == REGDB_E_CLASSNOTREG)
@@ -2236,11 +2431,8 @@ HRESULT WINAPI CoGetClassObject(
         }
 
         if (SUCCEEDED(hres))
-        {
-            hres = get_inproc_class_object(apt, hkey, rclsid, iid,
+            hres = get_inproc_class_object(apt, &info, rclsid, iid,
                 !(dwClsContext & WINE_CLSCTX_DONT_HOST), ppv);
-            RegCloseKey(hkey);
-        }
 
         /* return if we got a class, otherwise fall through to one of the
          * other types */
@@ -2251,10 +2443,9 @@ HRESULT WINAPI CoGetClassObject(
     /* Next try in-process handler */
     if (CLSCTX_INPROC_HANDLER & dwClsContext)
     {
-        static const WCHAR wszInprocHandler32[] = {'I','n','p','r','o','c','H','a','n','d','l','e','r','3','2',0};
-        HKEY hkey;
+        struct inproc_class_info info;
 
-        hres = COM_OpenKeyForCLSID(rclsid, wszInprocHandler32, KEY_READ, &hkey);
+        hres = COMPOBJ_ClassCache_Get(rclsid, TRUE, &info);
         if (FAILED(hres))
         {
             if (hres == REGDB_E_CLASSNOTREG)
@@ -2267,11 +2458,8 @@ HRESULT WINAPI CoGetClassObject(
         }
 
         if (SUCCEEDED(hres))
-        {
-            hres = get_inproc_class_object(apt, hkey, rclsid, iid,
+            hres = get_inproc_class_object(apt, &info, rclsid, iid,
                 !(dwClsContext & WINE_CLSCTX_DONT_HOST), ppv);
-            RegCloseKey(hkey);
-        }
 
         /* return if we got a class, otherwise fall through to one of the
          * other types */
@@ -3768,6 +3956,7 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID fImpLoad)
         COMPOBJ_UninitProcess();
         RPC_UnregisterAllChannelHooks();
         COMPOBJ_DllList_Free();
+        COMPOBJ_ClassCache_Free(fImpLoad != NULL);
         OLE32_hInstance = 0;
 	break;
 
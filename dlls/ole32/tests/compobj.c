@@ -247,6 +247,118 @@ static void test_CoGetClassObject(void)
     ok(hr == E_INVALIDARG, "CoGetClassObject should have returned E_INVALIDARG instead of 0x%08x\n", hr);
 }
 
+/* class lookups may be cached. A newly registered class has to be found
+ * straight away, the removal of a class may take a moment to be noticed */
+static void test_CoGetClassObject_registry_change(void)
+{
+    static const char clsid_key[] = "CLSID\\{12345678-1234-1234-1234-56789abcdef0}";
+    static const char ole32_dll[] = "ole32.dll";
+    IUnknown *pUnk = (IUnknown *)0xdeadbeef;
+    HKEY hkey;
+    LONG res;
+    HRESULT hr;
+    int i;
+
+    pCoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+
+    hr = CoGetClassObject(&CLSID_non_existent, CLSCTX_INPROC_SERVER, NULL, &IID_IClassFactory, (void **)&pUnk);
+    ok(hr == REGDB_E_CLASSNOTREG, "CoGetClassObject should have returned REGDB_E_CLASSNOTREG instead of 0x%08x\n", hr);
+
+    res = RegCreateKeyExA(HKEY_CLASSES_ROOT, clsid_key, 0, NULL, 0, KEY_ALL_ACCESS, NULL, &hkey, NULL);
+    if (res == ERROR_ACCESS_DENIED)
+    {
+        skip("Not authorized to modify the Classes key\n");
+        CoUninitialize();
+        return;
+    }
+    ok(res == ERROR_SUCCESS, "RegCreateKeyExA failed with error %d\n", res);
+    RegCloseKey(hkey);
+
+    /* the class now exists, but not as an in-process server */
+    hr = CoGetClassObject(&CLSID_non_existent, CLSCTX_INPROC_SERVER, NULL, &IID_IClassFactory, (void **)&pUnk);
+    ok(hr == REGDB_E_CLASSNOTREG, "CoGetClassObject should have returned REGDB_E_CLASSNOTREG instead of 0x%08x\n", hr);
+
+    res = RegCreateKeyExA(HKEY_CLASSES_ROOT, "CLSID\\{12345678-1234-1234-1234-56789abcdef0}\\InprocServer32",
+                          0, NULL, 0, KEY_ALL_ACCESS, NULL, &hkey, NULL);
+    ok(res == ERROR_SUCCESS, "RegCreateKeyExA failed with error %d\n", res);
+    res = RegSetValueExA(hkey, NULL, 0, REG_SZ, (const BYTE *)ole32_dll, sizeof(ole32_dll));
+    ok(res == ERROR_SUCCESS, "RegSetValueExA failed with error %d\n", res);
+    RegCloseKey(hkey);
+
+    /* ole32 doesn't implement the class, but it should now be looked for */
+    hr = CoGetClassObject(&CLSID_non_existent, CLSCTX_INPROC_SERVER, NULL, &IID_IClassFactory, (void **)&pUnk);
+    ok(hr != REGDB_E_CLASSNOTREG && hr != S_OK,
+       "CoGetClassObject should have failed to find the class in ole32 instead of returning 0x%08x\n", hr);
+    if (hr == S_OK) IUnknown_Release(pUnk);
+
+    RegDeleteKeyA(HKEY_CLASSES_ROOT, "CLSID\\{12345678-1234-1234-1234-56789abcdef0}\\InprocServer32");
+    RegDeleteKeyA(HKEY_CLASSES_ROOT, clsid_key);
+
+    /* the removal of a cached class is only seen once the registry change
+     * notification has been delivered, so allow for a short delay */
+    for (i = 0; i < 50; i++)
+    {
+        hr = CoGetClassObject(&CLSID_non_existent, CLSCTX_INPROC_SERVER, NULL, &IID_IClassFactory, (void **)&pUnk);
+        if (hr == REGDB_E_CLASSNOTREG) break;
+        if (hr == S_OK) IUnknown_Release(pUnk);
+        Sleep(20);
+    }
+    ok(hr == REGDB_E_CLASSNOTREG, "CoGetClassObject should have returned REGDB_E_CLASSNOTREG instead of 0x%08x\n", hr);
+
+    CoUninitialize();
+}
+
+/* Not a correctness test, traces the cost of repeated class lookups,
+ * which shouldn't need to talk to the server once the class is cached. */
+static void test_CoGetClassObject_timing(void)
+{
+    const unsigned int count = 10000;
+    IUnknown *pUnk;
+    DWORD start, elapsed;
+    unsigned int i;
+    HRESULT hr;
+
+    if (!winetest_interactive)
+    {
+        skip("timing test, set WINETEST_INTERACTIVE to run it\n");
+        return;
+    }
+
+    pCoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+
+    hr = CoGetClassObject(&CLSID_CDeviceMoniker, CLSCTX_INPROC_SERVER, NULL, &IID_IClassFactory, (void **)&pUnk);
+    if (hr != S_OK)
+    {
+        skip("CLSID_CDeviceMoniker not available, hr 0x%08x\n", hr);
+        CoUninitialize();
+        return;
+    }
+    IUnknown_Release(pUnk);
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        hr = CoGetClassObject(&CLSID_CDeviceMoniker, CLSCTX_INPROC_SERVER, NULL, &IID_IClassFactory, (void **)&pUnk);
+        if (hr != S_OK) break;
+        IUnknown_Release(pUnk);
+    }
+    elapsed = GetTickCount() - start;
+    ok(hr == S_OK, "CoGetClassObject failed with error 0x%08x\n", hr);
+    trace("%u registered class lookups in %u ms\n", i, elapsed);
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        hr = CoGetClassObject(&CLSID_non_existent, CLSCTX_INPROC_SERVER, NULL, &IID_IClassFactory, (void **)&pUnk);
+        if (hr != REGDB_E_CLASSNOTREG) break;
+    }
+    elapsed = GetTickCount() - start;
+    ok(hr == REGDB_E_CLASSNOTREG, "CoGetClassObject should have returned REGDB_E_CLASSNOTREG instead of 0x%08x\n", hr);
+    trace("%u unregistered class lookups in %u ms\n", i, elapsed);
+
+    CoUninitialize();
+}
+
 static ATOM register_dummy_class(void)
 {
     WNDCLASS wc =
@@ -1035,6 +1147,8 @@ START_TEST(compobj)
     test_CoCreateInstance();
     test_ole_menu();
     test_CoGetClassObject();
+    test_CoGetClassObject_registry_change();
+    test_CoGetClassObject_timing();
     test_CoRegisterMessageFilter();
     test_CoRegisterPSClsid();
     test_CoGetPSClsid();
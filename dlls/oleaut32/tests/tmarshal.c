@@ -1167,6 +1167,70 @@ static void test_DispCallFunc(void)
     IWidget_Release(pWidget);
 }
 
+static HRESULT invoke_bstrret(ITypeInfo *pTypeInfo, MEMBERID *memid, VARTYPE *vt)
+{
+    static WCHAR wszBstrRet[] = {'b','s','t','r','r','e','t',0};
+    LPOLESTR name = wszBstrRet;
+    DISPPARAMS dispparams;
+    VARIANT varresult;
+    EXCEPINFO excepinfo;
+    HRESULT hr;
+
+    dispparams.cNamedArgs = 0;
+    dispparams.cArgs = 0;
+    dispparams.rgdispidNamedArgs = NULL;
+    dispparams.rgvarg = NULL;
+
+    *memid = MEMBERID_NIL;
+    *vt = VT_EMPTY;
+    hr = ITypeInfo_GetIDsOfNames(pTypeInfo, &name, 1, memid);
+    if (FAILED(hr)) return hr;
+
+    VariantInit(&varresult);
+    hr = ITypeInfo_Invoke(pTypeInfo, &NonOleAutomation, *memid, DISPATCH_METHOD, &dispparams, &varresult, &excepinfo, NULL);
+    *vt = V_VT(&varresult);
+    VariantClear(&varresult);
+    return hr;
+}
+
+static void test_invoke_call_rate(void)
+{
+    ITypeInfo *pTypeInfo;
+    MEMBERID memid;
+    VARTYPE vt;
+    DWORD start, elapsed;
+    HRESULT hr;
+    int i;
+
+    pTypeInfo = NonOleAutomation_GetTypeInfo();
+    if (!pTypeInfo) return;
+
+    /* the first call fills the lookup caches, the second one uses them */
+    for (i = 0; i < 2; i++)
+    {
+        hr = invoke_bstrret(pTypeInfo, &memid, &vt);
+        ok_ole_success(hr, ITypeInfo_Invoke);
+        ok(memid == DISPID_NOA_BSTRRET, "memid should have been DISPID_NOA_BSTRRET instead of %d\n", memid);
+        ok(vt == VT_BSTR, "V_VT(&varresult) should be VT_BSTR instead of %d\n", vt);
+    }
+
+    /* throughput, only in interactive mode so that the normal test run stays fast */
+    if (winetest_interactive)
+    {
+        start = GetTickCount();
+        for (i = 0; i < 10000; i++)
+        {
+            hr = invoke_bstrret(pTypeInfo, &memid, &vt);
+            if (FAILED(hr)) break;
+        }
+        elapsed = GetTickCount() - start;
+        ok_ole_success(hr, ITypeInfo_Invoke);
+        trace("%d GetIDsOfNames/Invoke calls in %u ms\n", i, elapsed);
+    }
+
+    ITypeInfo_Release(pTypeInfo);
+}
+
 START_TEST(tmarshal)
 {
     HRESULT hr;
@@ -1178,6 +1242,7 @@ START_TEST(tmarshal)
 
     test_typelibmarshal();
     test_DispCallFunc();
+    test_invoke_call_rate();
 
     hr = UnRegisterTypeLib(&LIBID_TestTypelib, 1, 0, LOCALE_NEUTRAL, 1);
     ok_ole_success(hr, UnRegisterTypeLib);
@@ -84,6 +84,60 @@ static void ref_count_test(LPCWSTR type_lib)
     ok(ITypeLib_Release(iface) == 0, "ITypeLib should be destroyed here.\n");
 }
 
+static void test_LoadTypeLib_cache(void)
+{
+    static const WCHAR wszName[] = {'N','a','m','e',0};
+    static const WCHAR wszPname[] = {'p','n','a','m','e',0};
+    ITypeLib *pTypeLib, *pTypeLib2;
+    ITypeInfo *pTypeInfo;
+    FUNCDESC *pFuncDesc;
+    BSTR names[2];
+    UINT count;
+    HRESULT hr;
+
+    hr = LoadTypeLib(wszStdOle2, &pTypeLib);
+    ok_ole_success(hr, LoadTypeLib);
+    if (FAILED(hr)) return;
+
+    hr = LoadTypeLib(wszStdOle2, &pTypeLib2);
+    ok_ole_success(hr, LoadTypeLib);
+    ok(pTypeLib == pTypeLib2, "loading the same typelib twice should return the same object\n");
+    ITypeLib_Release(pTypeLib2);
+
+    /* the second function of a propget/propput pair doesn't store its own
+     * name in the typelib */
+    hr = ITypeLib_GetTypeInfoOfGuid(pTypeLib, &IID_IFont, &pTypeInfo);
+    ok_ole_success(hr, ITypeLib_GetTypeInfoOfGuid);
+
+    hr = ITypeInfo_GetFuncDesc(pTypeInfo, 1, &pFuncDesc);
+    ok_ole_success(hr, ITypeInfo_GetFuncDesc);
+    ok(pFuncDesc->invkind == INVOKE_PROPERTYPUT, "invkind was %d\n", pFuncDesc->invkind);
+
+    count = 0;
+    hr = ITypeInfo_GetNames(pTypeInfo, pFuncDesc->memid, names, 2, &count);
+    ok_ole_success(hr, ITypeInfo_GetNames);
+    ok(count == 2, "expected 2 names, got %u\n", count);
+    if (count == 2)
+    {
+        ok(!lstrcmpW(names[0], wszName), "wrong function name\n");
+        ok(!lstrcmpW(names[1], wszPname), "wrong parameter name\n");
+        SysFreeString(names[0]);
+        SysFreeString(names[1]);
+    }
+    ITypeInfo_ReleaseFuncDesc(pTypeInfo, pFuncDesc);
+    ITypeInfo_Release(pTypeInfo);
+
+    ok(ITypeLib_Release(pTypeLib) == 0, "ITypeLib should be destroyed here\n");
+
+    /* a released typelib is loaded again from scratch */
+    hr = LoadTypeLib(wszStdOle2, &pTypeLib);
+    ok_ole_success(hr, LoadTypeLib);
+    hr = ITypeLib_GetTypeInfoOfGuid(pTypeLib, &IID_IFont, &pTypeInfo);
+    ok_ole_success(hr, ITypeLib_GetTypeInfoOfGuid);
+    ITypeInfo_Release(pTypeInfo);
+    ITypeLib_Release(pTypeLib);
+}
+
 static void test_TypeComp(void)
 {
     ITypeLib *pTypeLib;
@@ -1363,6 +1417,7 @@ START_TEST(typelib)
     const char *filename;
 
     ref_count_test(wszStdOle2);
+    test_LoadTypeLib_cache();
     test_TypeComp();
     test_CreateDispTypeInfo();
     test_TypeInfo();
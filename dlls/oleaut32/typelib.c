@@ -874,6 +874,13 @@ typedef struct tagTLBImpLib
     struct tagTLBImpLib * next;
 } TLBImpLib;
 
+/* entry in the pool of names read from the name table of a MSFT typelib */
+typedef struct tagTLBName
+{
+    int offset;                 /* offset in the name table, -1 if unused */
+    BSTR name;
+} TLBName;
+
 /* internal ITypeLib data */
 typedef struct tagITypeLibImpl
 {
@@ -902,11 +909,25 @@ typedef struct tagITypeLibImpl
     struct list ref_list;       /* list of ref types in this typelib */
     HREFTYPE dispatch_href;     /* reference to IDispatch, -1 if unused */
 
+    /* MSFT typelibs are read lazily: the members of a type info are only
+     * read from the image when the type info is first handed out */
+    CRITICAL_SECTION load_cs;   /* protects the lazy loading and ref_list */
+    IUnknown *image;            /* keeps the image mapped, NULL when fully read */
+    LPVOID image_base;
+    DWORD image_length;
+    MSFT_SegDir *pTblDir;       /* segment directory of the image */
+    int pending_typeinfos;      /* number of type infos not fully read yet */
+
+    /* names of MSFT typelibs are read once and shared between type infos */
+    TLBName *name_pool;         /* hash table keyed by name table offset */
+    UINT name_pool_size;
+    UINT name_pool_count;
 
     /* typelibs are cached, keyed by path and index, so store the linked list info within them */
     struct tagITypeLibImpl *next, *prev;
     WCHAR *path;
     INT index;
+    UINT hash;                  /* bucket in the typelib cache */
 } ITypeLibImpl;
 
 static const ITypeLib2Vtbl tlbvt;
@@ -918,7 +939,7 @@ static inline ITypeLibImpl *impl_from_ITypeComp( ITypeComp *iface )
 }
 
 /* ITypeLib methods */
-static ITypeLib2* ITypeLib2_Constructor_MSFT(LPVOID pLib, DWORD dwTLBLength);
+static ITypeLib2* ITypeLib2_Constructor_MSFT(LPVOID pLib, DWORD dwTLBLength, IUnknown *pFile);
 static ITypeLib2* ITypeLib2_Constructor_SLTG(LPVOID pLib, DWORD dwTLBLength);
 
 /*======================= ITypeInfo implementation =======================*/
@@ -966,6 +987,8 @@ typedef struct tagTLBFuncDesc
     BSTR Entry;            /* if its Hiword==0, it numeric; -1 is not present*/
     int ctCustData;
     TLBCustData * pCustData;        /* linked list to cust data; */
+    VARTYPE *invoke_vts;    /* variant types of the parameters and of the
+                               return value, computed on the first Invoke */
     struct tagTLBFuncDesc * next;
 } TLBFuncDesc;
 
@@ -992,6 +1015,23 @@ typedef struct tagTLBImplType
     struct tagTLBImplType *next;
 } TLBImplType;
 
+/* entry of the hash tables of a TLBMemberIndex, unused if func and var are NULL */
+typedef struct tagTLBMemberEntry
+{
+    ULONG hash;                     /* hash of the name, or the member id */
+    const TLBFuncDesc *func;
+    const TLBVarDesc *var;
+    const ULONG *param_hashes;      /* hashes of the parameter names of func */
+} TLBMemberEntry;
+
+/* hash tables used to look up members by name and by member id */
+typedef struct tagTLBMemberIndex
+{
+    UINT mask;                      /* number of slots of each table - 1 */
+    TLBMemberEntry *names;          /* first function or variable of each name */
+    TLBMemberEntry *ids;            /* all functions, keyed by member id */
+} TLBMemberIndex;
+
 /* internal TypeInfo data */
 typedef struct tagITypeInfoImpl
 {
@@ -999,6 +1039,7 @@ typedef struct tagITypeInfoImpl
     const ITypeCompVtbl  *lpVtblTypeComp;
     LONG ref;
     BOOL no_free_data; /* don't free data structures */
+    BOOL members_pending; /* members still have to be read from the typelib image */
     TYPEATTR TypeAttr ;         /* _lots_ of type information. */
     ITypeLibImpl * pTypeLib;        /* back pointer to typelib */
     int index;                  /* index in this typelib; */
@@ -1023,6 +1064,7 @@ typedef struct tagITypeInfoImpl
 
     int ctCustData;
     TLBCustData * pCustData;        /* linked list to cust data; */
+    TLBMemberIndex *member_index;   /* built on the first GetIDsOfNames or Invoke */
     struct tagITypeInfoImpl * next;
 } ITypeInfoImpl;
 
@@ -1421,6 +1463,14 @@ static void *TLB_CopyTypeDesc( TYPEDESC *dest, const TYPEDESC *src, void *buffer
     return buffer;
 }
 
+/* free a name of a type info or one of its members. Names of MSFT typelibs
+ * are owned by the name pool of the typelib */
+static inline void TLB_FreeName(const ITypeLibImpl *pTL, BSTR name)
+{
+    if (!pTL->name_pool)
+        SysFreeString(name);
+}
+
 /* free custom data allocated by MSFT_CustData */
 static inline void TLB_FreeCustData(TLBCustData *pCustData)
 {
@@ -1558,6 +1608,67 @@ static BSTR MSFT_ReadName( TLBContext *pcx, int offset)
     return bstrName;
 }
 
+#define TLB_NAME_POOL_MIN 64
+
+static BOOL TLB_GrowNamePool(ITypeLibImpl *pTL, UINT size)
+{
+    TLBName *pool;
+    UINT i, j;
+
+    pool = HeapAlloc(GetProcessHeap(), 0, size * sizeof(*pool));
+    if (!pool) return FALSE;
+    for (i = 0; i < size; i++)
+        pool[i].offset = -1;
+
+    for (i = 0; i < pTL->name_pool_size; i++)
+    {
+        if (pTL->name_pool[i].offset == -1) continue;
+        for (j = ((UINT)pTL->name_pool[i].offset >> 2) * 2654435761u & (size - 1);
+             pool[j].offset != -1; j = (j + 1) & (size - 1))
+            ;
+        pool[j] = pTL->name_pool[i];
+    }
+
+    HeapFree(GetProcessHeap(), 0, pTL->name_pool);
+    pTL->name_pool = pool;
+    pTL->name_pool_size = size;
+    return TRUE;
+}
+
+/* returns the name at the given offset of the name table. Each name is only
+ * read once, the returned string belongs to the typelib and must not be freed */
+static BSTR MSFT_GetName( TLBContext *pcx, int offset)
+{
+    ITypeLibImpl *pTL = pcx->pLibInfo;
+    TLBName *pool;
+    UINT i, mask;
+
+    if (offset < 0)
+    {
+        ERR_(typelib)("bad offset %d\n", offset);
+        return NULL;
+    }
+
+    /* keep the load factor below 3/4 */
+    if ((pTL->name_pool_count + 1) * 4 > pTL->name_pool_size * 3 &&
+        !TLB_GrowNamePool(pTL, pTL->name_pool_size * 2) &&
+        pTL->name_pool_count + 1 >= pTL->name_pool_size)
+    {
+        ERR("cannot allocate memory\n");
+        return NULL;
+    }
+
+    pool = pTL->name_pool;
+    mask = pTL->name_pool_size - 1;
+    for (i = ((UINT)offset >> 2) * 2654435761u & mask; pool[i].offset != -1; i = (i + 1) & mask)
+        if (pool[i].offset == offset) return pool[i].name;
+
+    pool[i].offset = offset;
+    pool[i].name = MSFT_ReadName(pcx, offset);
+    pTL->name_pool_count++;
+    return pool[i].name;
+}
+
 static BSTR MSFT_ReadString( TLBContext *pcx, int offset)
 {
     char * string;
@@ -1804,9 +1915,9 @@ MSFT_DoFuncs(TLBContext*     pcx,
         /* nameoffset is sometimes -1 on the second half of a propget/propput
          * pair of functions */
         if ((nameoffset == -1) && (i > 0))
-            (*pptfd)->Name = SysAllocString(ptfd_prev->Name);
+            (*pptfd)->Name = ptfd_prev->Name;
         else
-            (*pptfd)->Name = MSFT_ReadName(pcx, nameoffset);
+            (*pptfd)->Name = MSFT_GetName(pcx, nameoffset);
 
         /* read the function information record */
         MSFT_ReadLEDWords(&reclength, sizeof(INT), pcx, recoffset);
@@ -1909,10 +2020,10 @@ MSFT_DoFuncs(TLBContext*     pcx,
                     /* this occurs for [propput] or [propget] methods, so
                      * we should just set the name of the parameter to the
                      * name of the method. */
-                    (*pptfd)->pParamDesc[j].Name = SysAllocString((*pptfd)->Name);
+                    (*pptfd)->pParamDesc[j].Name = (*pptfd)->Name;
                 else
                     (*pptfd)->pParamDesc[j].Name =
-                        MSFT_ReadName( pcx, paraminfo.oName );
+                        MSFT_GetName( pcx, paraminfo.oName );
                 TRACE_(typelib)("param[%d] = %s\n", j, debugstr_w((*pptfd)->pParamDesc[j].Name));
 
                 MSFT_ResolveReferencedTypes(pcx, pTI, &elemdesc->tdesc);
@@ -1985,7 +2096,7 @@ static void MSFT_DoVars(TLBContext *pcx, ITypeInfoImpl *pTI, int cFuncs,
     /* name, eventually add to a hash table */
         MSFT_ReadLEDWords(&nameoffset, sizeof(INT), pcx,
                           offset + infolen + (2*cFuncs + cVars + i + 1) * sizeof(INT));
-        (*pptvd)->Name=MSFT_ReadName(pcx, nameoffset);
+        (*pptvd)->Name=MSFT_GetName(pcx, nameoffset);
     /* read the variable information record */
         MSFT_ReadLEDWords(&reclength, sizeof(INT), pcx, recoffset);
         reclength &=0xff;
@@ -2137,7 +2248,7 @@ static ITypeInfoImpl * MSFT_DoTypeInfo(
 /*    IDLDESC  idldescType; *//* never saw this one != zero  */
 
 /* name, eventually add to a hash table */
-    ptiRet->Name=MSFT_ReadName(pcx, tiBase.NameOffset);
+    ptiRet->Name=MSFT_GetName(pcx, tiBase.NameOffset);
     ptiRet->hreftype = MSFT_ReadHreftype(pcx, tiBase.NameOffset);
     TRACE_(typelib)("reading %s\n", debugstr_w(ptiRet->Name));
     /* help info */
@@ -2151,6 +2262,32 @@ static ITypeInfoImpl * MSFT_DoTypeInfo(
 /* note: InfoType's Help file and HelpStringDll come from the containing
  * library. Further HelpString and Docstring appear to be the same thing :(
  */
+
+    /* the members are read by MSFT_DoTypeInfoMembers once they are needed */
+    ptiRet->members_pending = TRUE;
+
+    TRACE_(typelib)("%s guid: %s kind:%s\n",
+       debugstr_w(ptiRet->Name),
+       debugstr_guid(&ptiRet->TypeAttr.guid),
+       typekind_desc[ptiRet->TypeAttr.typekind]);
+
+    return ptiRet;
+}
+
+/*
+ * read the functions, variables, implemented types and custom data of a
+ * typeinfo record
+ */
+static void MSFT_DoTypeInfoMembers(TLBContext *pcx, ITypeInfoImpl *ptiRet)
+{
+    MSFT_TypeInfoBase tiBase;
+    ITypeLibImpl *pLibInfo = ptiRet->pTypeLib;
+
+    TRACE_(typelib)("reading members of %s\n", debugstr_w(ptiRet->Name));
+
+    MSFT_ReadLEDWords(&tiBase, sizeof(tiBase) ,pcx ,
+                      pcx->pTblDir->pTypeInfoTab.offset+ptiRet->index*sizeof(tiBase));
+
     /* functions */
     if(ptiRet->TypeAttr.cFuncs >0 )
         MSFT_DoFuncs(pcx, ptiRet, ptiRet->TypeAttr.cFuncs,
@@ -2191,21 +2328,57 @@ static ITypeInfoImpl * MSFT_DoTypeInfo(
     }
     ptiRet->ctCustData=
         MSFT_CustData(pcx, tiBase.oCustData, &ptiRet->pCustData);
+}
 
-    TRACE_(typelib)("%s guid: %s kind:%s\n",
-       debugstr_w(ptiRet->Name),
-       debugstr_guid(&ptiRet->TypeAttr.guid),
-       typekind_desc[ptiRet->TypeAttr.typekind]);
+/* drops the reference to the image of a typelib once nothing more has to be
+ * read from it. must be called with load_cs held */
+static void TLB_ReleaseImage(ITypeLibImpl *pTL)
+{
+    if (pTL->image)
+    {
+        TRACE("releasing image of %p\n", pTL);
+        IUnknown_Release(pTL->image);
+        pTL->image = NULL;
+        pTL->image_base = NULL;
+    }
+    HeapFree(GetProcessHeap(), 0, pTL->pTblDir);
+    pTL->pTblDir = NULL;
+}
 
-    return ptiRet;
+/* makes sure that the members of a type info have been read before the type
+ * info is handed out or searched */
+static void TLB_LoadTypeInfo(ITypeInfoImpl *pTI)
+{
+    ITypeLibImpl *pTL = pTI->pTypeLib;
+    TLBContext cx;
+
+    EnterCriticalSection(&pTL->load_cs);
+    if (pTI->members_pending)
+    {
+        cx.oStart = 0;
+        cx.pos = 0;
+        cx.length = pTL->image_length;
+        cx.mapping = pTL->image_base;
+        cx.pTblDir = pTL->pTblDir;
+        cx.pLibInfo = pTL;
+
+        MSFT_DoTypeInfoMembers(&cx, pTI);
+        pTI->members_pending = FALSE;
+        if (!--pTL->pending_typeinfos)
+            TLB_ReleaseImage(pTL);
+    }
+    LeaveCriticalSection(&pTL->load_cs);
 }
 
 /* Because type library parsing has some degree of overhead, and some apps repeatedly load the same
  * typelibs over and over, we cache them here. According to MSDN Microsoft have a similar scheme in
  * place. This will cause a deliberate memory leak, but generally losing RAM for cycles is an acceptable
  * tradeoff here.
+ * The cache is a hash table of linked lists, keyed by path and resource index.
  */
-static ITypeLibImpl *tlb_cache_first;
+#define TLB_CACHE_SIZE 64
+
+static ITypeLibImpl *tlb_cache[TLB_CACHE_SIZE];
 static CRITICAL_SECTION cache_section;
 static CRITICAL_SECTION_DEBUG cache_section_debug =
 {
@@ -2215,6 +2388,25 @@ static CRITICAL_SECTION_DEBUG cache_section_debug =
 };
 static CRITICAL_SECTION cache_section = { &cache_section_debug, -1, 0, 0, 0, 0 };
 
+static UINT TLB_CacheHash(LPCWSTR path, INT index)
+{
+    UINT hash = index;
+
+    while (*path) hash = hash * 31 + tolowerW(*path++);
+    return hash % TLB_CACHE_SIZE;
+}
+
+/* must be called with cache_section held */
+static ITypeLibImpl *TLB_CacheFind(LPCWSTR path, INT index, UINT hash)
+{
+    ITypeLibImpl *entry;
+
+    for (entry = tlb_cache[hash]; entry != NULL; entry = entry->next)
+        if (entry->index == index && !strcmpiW(entry->path, path))
+            return entry;
+    return NULL;
+}
+
 
 typedef struct TLB_PEFile
 {
@@ -2411,6 +2603,7 @@ static HRESULT TLB_ReadTypeLib(LPCWSTR pszFileName, LPWSTR pszPath, UINT cchPath
     ITypeLibImpl *entry;
     HRESULT ret;
     INT index = 1;
+    UINT hash;
     LPWSTR index_str, file = (LPWSTR)pszFileName;
     LPVOID pBase = NULL;
     DWORD dwTLBLength = 0;
@@ -2452,17 +2645,15 @@ static HRESULT TLB_ReadTypeLib(LPCWSTR pszFileName, LPWSTR pszPath, UINT cchPath
     TRACE_(typelib)("File %s index %d\n", debugstr_w(pszPath), index);
 
     /* We look the path up in the typelib cache. If found, we just addref it, and return the pointer. */
+    hash = TLB_CacheHash(pszPath, index);
     EnterCriticalSection(&cache_section);
-    for (entry = tlb_cache_first; entry != NULL; entry = entry->next)
+    if ((entry = TLB_CacheFind(pszPath, index, hash)))
     {
-        if (!strcmpiW(entry->path, pszPath) && entry->index == index)
-        {
-            TRACE("cache hit\n");
-            *ppTypeLib = (ITypeLib2*)entry;
-            ITypeLib_AddRef(*ppTypeLib);
-            LeaveCriticalSection(&cache_section);
-            return S_OK;
-        }
+        TRACE("cache hit\n");
+        *ppTypeLib = (ITypeLib2*)entry;
+        ITypeLib_AddRef(*ppTypeLib);
+        LeaveCriticalSection(&cache_section);
+        return S_OK;
     }
     LeaveCriticalSection(&cache_section);
 
@@ -2477,7 +2668,7 @@ static HRESULT TLB_ReadTypeLib(LPCWSTR pszFileName, LPWSTR pszPath, UINT cchPath
         {
             DWORD dwSignature = FromLEDWord(*((DWORD*) pBase));
             if (dwSignature == MSFT_SIGNATURE)
-                *ppTypeLib = ITypeLib2_Constructor_MSFT(pBase, dwTLBLength);
+                *ppTypeLib = ITypeLib2_Constructor_MSFT(pBase, dwTLBLength, pFile);
             else if (dwSignature == SLTG_SIGNATURE)
                 *ppTypeLib = ITypeLib2_Constructor_SLTG(pBase, dwTLBLength);
             else
@@ -2499,12 +2690,24 @@ static HRESULT TLB_ReadTypeLib(LPCWSTR pszFileName, LPWSTR pszPath, UINT cchPath
 	lstrcpyW(impl->path, pszPath);
 	/* We should really canonicalise the path here. */
         impl->index = index;
+        impl->hash = hash;
 
-        /* FIXME: check if it has added already in the meantime */
         EnterCriticalSection(&cache_section);
-        if ((impl->next = tlb_cache_first) != NULL) impl->next->prev = impl;
+        /* another thread may have loaded the same typelib in the meantime */
+        if ((entry = TLB_CacheFind(pszPath, index, hash)))
+        {
+            TRACE("already loaded by another thread\n");
+            ITypeLib_AddRef((ITypeLib *)entry);
+            LeaveCriticalSection(&cache_section);
+            HeapFree(GetProcessHeap(), 0, impl->path);
+            impl->path = NULL;
+            ITypeLib2_Release(*ppTypeLib);
+            *ppTypeLib = (ITypeLib2 *)entry;
+            return S_OK;
+        }
+        if ((impl->next = tlb_cache[hash]) != NULL) impl->next->prev = impl;
         impl->prev = NULL;
-        tlb_cache_first = impl;
+        tlb_cache[hash] = impl;
         LeaveCriticalSection(&cache_section);
         ret = S_OK;
     } else
@@ -2529,6 +2732,9 @@ static ITypeLibImpl* TypeLibImpl_Constructor(void)
     list_init(&pTypeLibImpl->ref_list);
     pTypeLibImpl->dispatch_href = -1;
 
+    InitializeCriticalSection(&pTypeLibImpl->load_cs);
+    pTypeLibImpl->load_cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": ITypeLibImpl.load_cs");
+
     return pTypeLibImpl;
 }
 
@@ -2537,7 +2743,7 @@ static ITypeLibImpl* TypeLibImpl_Constructor(void)
  *
  * loading an MSFT typelib from an in-memory image
  */
-static ITypeLib2* ITypeLib2_Constructor_MSFT(LPVOID pLib, DWORD dwTLBLength)
+static ITypeLib2* ITypeLib2_Constructor_MSFT(LPVOID pLib, DWORD dwTLBLength, IUnknown *pFile)
 {
     TLBContext cx;
     long lPSegDir;
@@ -2563,6 +2769,7 @@ static ITypeLib2* ITypeLib2_Constructor_MSFT(LPVOID pLib, DWORD dwTLBLength)
     TRACE_(typelib)("\tmagic1=0x%08x ,magic2=0x%08x\n",tlbHeader.magic1,tlbHeader.magic2 );
     if (tlbHeader.magic1 != MSFT_SIGNATURE) {
 	FIXME("Header type magic 0x%08x not supported.\n",tlbHeader.magic1);
+	ITypeLib2_Release((ITypeLib2 *)pTypeLibImpl);
 	return NULL;
     }
     TRACE_(typelib)("\tdispatchpos = 0x%x\n", tlbHeader.dispatchpos);
@@ -2581,10 +2788,17 @@ static ITypeLib2* ITypeLib2_Constructor_MSFT(LPVOID pLib, DWORD dwTLBLength)
     if ( tlbSegDir.pTypeInfoTab.res0c != 0x0F || tlbSegDir.pImpInfo.res0c != 0x0F)
     {
         ERR("cannot find the table directory, ptr=0x%lx\n",lPSegDir);
-	HeapFree(GetProcessHeap(),0,pTypeLibImpl);
+	ITypeLib2_Release((ITypeLib2 *)pTypeLibImpl);
 	return NULL;
     }
 
+    /* names are shared between all type infos of the typelib */
+    if (!TLB_GrowNamePool(pTypeLibImpl, TLB_NAME_POOL_MIN))
+    {
+        ITypeLib2_Release((ITypeLib2 *)pTypeLibImpl);
+        return NULL;
+    }
+
     /* now fill our internal data */
     /* TLIBATTR fields */
     MSFT_ReadGuid(&pTypeLibImpl->LibAttr.guid, tlbHeader.posguid, &cx);
@@ -2743,6 +2957,23 @@ static ITypeLib2* ITypeLib2_Constructor_MSFT(LPVOID pLib, DWORD dwTLBLength)
         }
     }
 
+    /* keep the image around until the members of all type infos are read */
+    pTypeLibImpl->pending_typeinfos = pTypeLibImpl->TypeInfoCount;
+    if (pTypeLibImpl->pending_typeinfos)
+    {
+        pTypeLibImpl->pTblDir = HeapAlloc(GetProcessHeap(), 0, sizeof(tlbSegDir));
+        if (!pTypeLibImpl->pTblDir)
+        {
+            ITypeLib2_Release((ITypeLib2 *)pTypeLibImpl);
+            return NULL;
+        }
+        *pTypeLibImpl->pTblDir = tlbSegDir;
+        pTypeLibImpl->image = pFile;
+        pTypeLibImpl->image_base = pLib;
+        pTypeLibImpl->image_length = dwTLBLength;
+        IUnknown_AddRef(pFile);
+    }
+
     TRACE("(%p)\n", pTypeLibImpl);
     return (ITypeLib2*) pTypeLibImpl;
 }
@@ -3787,7 +4018,7 @@ static ULONG WINAPI ITypeLib2_fnRelease( ITypeLib2 *iface)
           EnterCriticalSection(&cache_section);
           if (This->next) This->next->prev = This->prev;
           if (This->prev) This->prev->next = This->next;
-          else tlb_cache_first = This->next;
+          else tlb_cache[This->hash] = This->next;
           LeaveCriticalSection(&cache_section);
           HeapFree(GetProcessHeap(), 0, This->path);
       }
@@ -3849,6 +4080,15 @@ static ULONG WINAPI ITypeLib2_fnRelease( ITypeLib2 *iface)
 
       if (This->pTypeInfo) /* can be NULL */
       	  ITypeInfo_Release((ITypeInfo*) This->pTypeInfo);
+
+      for (i = 0; i < This->name_pool_size; i++)
+          if (This->name_pool[i].offset != -1)
+              SysFreeString(This->name_pool[i].name);
+      HeapFree(GetProcessHeap(), 0, This->name_pool);
+
+      TLB_ReleaseImage(This);
+      This->load_cs.DebugInfo->Spare[0] = 0;
+      DeleteCriticalSection(&This->load_cs);
       HeapFree(GetProcessHeap(),0,This);
       return 0;
     }
@@ -3896,6 +4136,7 @@ static HRESULT WINAPI ITypeLib2_fnGetTypeInfo(
       }
     }
 
+    TLB_LoadTypeInfo(pTypeInfo);
     *ppTInfo = (ITypeInfo *) pTypeInfo;
 
     ITypeInfo_AddRef(*ppTInfo);
@@ -3978,6 +4219,7 @@ static HRESULT WINAPI ITypeLib2_fnGetTypeInfoOfGuid(
           pTypeInfo,
           debugstr_w(pTypeInfo->Name));
 
+    TLB_LoadTypeInfo(pTypeInfo);
     *ppTInfo = (ITypeInfo*)pTypeInfo;
     ITypeInfo_AddRef(*ppTInfo);
     return S_OK;
@@ -4142,6 +4384,7 @@ static HRESULT WINAPI ITypeLib2_fnIsName(
     *pfName=TRUE;
     for(pTInfo=This->pTypeInfo;pTInfo;pTInfo=pTInfo->next){
         if(!memcmp(szNameBuf,pTInfo->Name, nNameBufLen)) goto ITypeLib2_fnIsName_exit;
+        TLB_LoadTypeInfo(pTInfo);
         for(pFInfo=pTInfo->funclist;pFInfo;pFInfo=pFInfo->next) {
             if(!memcmp(szNameBuf,pFInfo->Name, nNameBufLen)) goto ITypeLib2_fnIsName_exit;
             for(i=0;i<pFInfo->funcdesc.cParams;i++)
@@ -4184,6 +4427,7 @@ static HRESULT WINAPI ITypeLib2_fnFindName(
 
     for(pTInfo=This->pTypeInfo;pTInfo && j<*pcFound; pTInfo=pTInfo->next){
         if(!memcmp(szNameBuf,pTInfo->Name, nNameBufLen)) goto ITypeLib2_fnFindName_exit;
+        TLB_LoadTypeInfo(pTInfo);
         for(pFInfo=pTInfo->funclist;pFInfo;pFInfo=pFInfo->next) {
             if(!memcmp(szNameBuf,pFInfo->Name,nNameBufLen)) goto ITypeLib2_fnFindName_exit;
             for(i=0;i<pFInfo->funcdesc.cParams;i++) {
@@ -4195,6 +4439,7 @@ static HRESULT WINAPI ITypeLib2_fnFindName(
             if(!memcmp(szNameBuf,pVInfo->Name, nNameBufLen)) goto ITypeLib2_fnFindName_exit;
         continue;
 ITypeLib2_fnFindName_exit:
+        TLB_LoadTypeInfo(pTInfo);
         ITypeInfo_AddRef((ITypeInfo*)pTInfo);
         ppTInfo[j]=(LPTYPEINFO)pTInfo;
         j++;
@@ -4429,6 +4674,11 @@ static HRESULT WINAPI ITypeLibComp_fnBind(
     {
         TRACE("testing %s\n", debugstr_w(pTypeInfo->Name));
 
+        if ((pTypeInfo->TypeAttr.typekind == TKIND_ENUM) ||
+            (pTypeInfo->TypeAttr.typekind == TKIND_MODULE) ||
+            (pTypeInfo->TypeAttr.typekind == TKIND_COCLASS))
+            TLB_LoadTypeInfo(pTypeInfo);
+
         /* FIXME: check wFlags here? */
         /* FIXME: we should use a hash table to look this info up using lHash
          * instead of an O(n) search */
@@ -4636,12 +4886,14 @@ static ULONG WINAPI ITypeInfo_fnRelease(ITypeInfo2 *iface)
 
       TRACE("destroying ITypeInfo(%p)\n",This);
 
+      HeapFree(GetProcessHeap(), 0, This->member_index);
+
       if (This->no_free_data)
           goto finish_free;
 
       if (This->Name)
       {
-          SysFreeString(This->Name);
+          TLB_FreeName(This->pTypeLib, This->Name);
           This->Name = 0;
       }
 
@@ -4668,15 +4920,16 @@ static ULONG WINAPI ITypeInfo_fnRelease(ITypeInfo2 *iface)
                   VariantClear(&elemdesc->u.paramdesc.pparamdescex->varDefaultValue);
                   TLB_Free(elemdesc->u.paramdesc.pparamdescex);
               }
-              SysFreeString(pFInfo->pParamDesc[i].Name);
+              TLB_FreeName(This->pTypeLib, pFInfo->pParamDesc[i].Name);
           }
           TLB_Free(pFInfo->funcdesc.lprgelemdescParam);
           TLB_Free(pFInfo->pParamDesc);
           TLB_FreeCustData(pFInfo->pCustData);
+          HeapFree(GetProcessHeap(), 0, pFInfo->invoke_vts);
           if (HIWORD(pFInfo->Entry) != 0 && pFInfo->Entry != (BSTR)-1) 
               SysFreeString(pFInfo->Entry);
           SysFreeString(pFInfo->HelpString);
-          SysFreeString(pFInfo->Name);
+          TLB_FreeName(This->pTypeLib, pFInfo->Name);
 
           pFInfoNext = pFInfo->next;
           TLB_Free(pFInfo);
@@ -4689,7 +4942,7 @@ static ULONG WINAPI ITypeInfo_fnRelease(ITypeInfo2 *iface)
               TLB_Free(pVInfo->vardesc.u.lpvarValue);
           }
           TLB_FreeCustData(pVInfo->pCustData);
-          SysFreeString(pVInfo->Name);
+          TLB_FreeName(This->pTypeLib, pVInfo->Name);
           pVInfoNext = pVInfo->next;
           TLB_Free(pVInfo);
       }
@@ -5261,12 +5514,144 @@ static HRESULT WINAPI ITypeInfo_fnGetImplTypeFlags( ITypeInfo2 *iface,
  * Maps between member names and member IDs, and parameter names and
  * parameter IDs.
  */
+/* case-insensitive hash of a member name. Only letters and digits are
+ * hashed, so that names that lstrcmpiW considers equal always hash equally */
+static ULONG TLB_HashName(LPCWSTR name)
+{
+    ULONG hash = 0;
+
+    if (!name) return 0;
+    for (; *name; name++)
+        if (isalnumW(*name)) hash = hash * 31 + toupperW(*name);
+    return hash;
+}
+
+static inline UINT TLB_HashMemId(MEMBERID memid)
+{
+    return (ULONG)memid * 2654435761u;
+}
+
+static inline LPCWSTR TLB_MemberEntryName(const TLBMemberEntry *entry)
+{
+    return entry->func ? entry->func->Name : entry->var->Name;
+}
+
+static TLBMemberEntry *TLB_FindMemberName(const TLBMemberIndex *index, LPCWSTR name, ULONG hash)
+{
+    TLBMemberEntry *entry;
+    UINT i;
+
+    for (i = hash & index->mask; (entry = &index->names[i])->func || entry->var; i = (i + 1) & index->mask)
+        if (entry->hash == hash && !lstrcmpiW(name, TLB_MemberEntryName(entry)))
+            return entry;
+    return entry; /* unused slot */
+}
+
+static TLBMemberIndex *TLB_BuildMemberIndex(const ITypeInfoImpl *This)
+{
+    const TLBFuncDesc *pFDesc;
+    const TLBVarDesc *pVDesc;
+    TLBMemberIndex *index;
+    TLBMemberEntry *entry;
+    ULONG *param_hashes;
+    UINT count = 0, params = 0, size = 8, i;
+    int j;
+
+    for (pFDesc = This->funclist; pFDesc; pFDesc = pFDesc->next)
+    {
+        count++;
+        params += pFDesc->funcdesc.cParams;
+    }
+    for (pVDesc = This->varlist; pVDesc; pVDesc = pVDesc->next)
+        count++;
+    while (size < count * 2) size *= 2;
+
+    index = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                      sizeof(*index) + 2 * size * sizeof(TLBMemberEntry) + params * sizeof(ULONG));
+    if (!index) return NULL;
+    index->mask = size - 1;
+    index->names = (TLBMemberEntry *)(index + 1);
+    index->ids = index->names + size;
+    param_hashes = (ULONG *)(index->ids + size);
+
+    /* functions take precedence over variables and earlier members over
+     * later ones with the same name, so only the first one is entered */
+    for (pFDesc = This->funclist; pFDesc; pFDesc = pFDesc->next)
+    {
+        ULONG hash = TLB_HashName(pFDesc->Name);
+
+        for (j = 0; j < pFDesc->funcdesc.cParams; j++)
+            param_hashes[j] = TLB_HashName(pFDesc->pParamDesc[j].Name);
+
+        entry = TLB_FindMemberName(index, pFDesc->Name, hash);
+        if (!entry->func && !entry->var)
+        {
+            entry->hash = hash;
+            entry->func = pFDesc;
+            entry->param_hashes = param_hashes;
+        }
+
+        /* functions sharing a member id stay in list order */
+        for (i = TLB_HashMemId(pFDesc->funcdesc.memid) & index->mask; index->ids[i].func; i = (i + 1) & index->mask)
+            ;
+        index->ids[i].hash = pFDesc->funcdesc.memid;
+        index->ids[i].func = pFDesc;
+
+        param_hashes += pFDesc->funcdesc.cParams;
+    }
+    for (pVDesc = This->varlist; pVDesc; pVDesc = pVDesc->next)
+    {
+        ULONG hash = TLB_HashName(pVDesc->Name);
+
+        entry = TLB_FindMemberName(index, pVDesc->Name, hash);
+        if (!entry->func && !entry->var)
+        {
+            entry->hash = hash;
+            entry->var = pVDesc;
+        }
+    }
+
+    TRACE("(%p) %u members, %u slots\n", This, count, size);
+    return index;
+}
+
+static const TLBMemberIndex *ITypeInfoImpl_GetMemberIndex(ITypeInfoImpl *This)
+{
+    TLBMemberIndex *index = This->member_index;
+
+    if (!index)
+    {
+        index = TLB_BuildMemberIndex(This);
+        if (!index) return NULL;
+        /* another thread may have been quicker */
+        if (InterlockedCompareExchangePointer((void **)&This->member_index, index, NULL))
+        {
+            HeapFree(GetProcessHeap(), 0, index);
+            index = This->member_index;
+        }
+    }
+    return index;
+}
+
+/* returns the first function with the given member id and one of the
+ * requested invoke kinds */
+static const TLBFuncDesc *TLB_FindFuncByMemId(const TLBMemberIndex *index, MEMBERID memid, UINT16 wFlags)
+{
+    const TLBMemberEntry *entry;
+    UINT i;
+
+    for (i = TLB_HashMemId(memid) & index->mask; (entry = &index->ids[i])->func; i = (i + 1) & index->mask)
+        if (entry->func->funcdesc.memid == memid && (wFlags & entry->func->funcdesc.invkind))
+            return entry->func;
+    return NULL;
+}
+
 static HRESULT WINAPI ITypeInfo_fnGetIDsOfNames( ITypeInfo2 *iface,
         LPOLESTR  *rgszNames, UINT cNames, MEMBERID  *pMemId)
 {
     ITypeInfoImpl *This = (ITypeInfoImpl *)iface;
-    const TLBFuncDesc *pFDesc;
-    const TLBVarDesc *pVDesc;
+    const TLBMemberIndex *index;
+    const TLBMemberEntry *entry;
     HRESULT ret=S_OK;
     int i;
 
@@ -5277,28 +5662,31 @@ static HRESULT WINAPI ITypeInfo_fnGetIDsOfNames( ITypeInfo2 *iface,
     for (i = 0; i < cNames; i++)
         pMemId[i] = MEMBERID_NIL;
 
-    for(pFDesc=This->funclist; pFDesc; pFDesc=pFDesc->next) {
+    if (!(index = ITypeInfoImpl_GetMemberIndex(This)))
+        return E_OUTOFMEMORY;
+
+    entry = TLB_FindMemberName(index, *rgszNames, TLB_HashName(*rgszNames));
+    if (entry->func) {
+        const TLBFuncDesc *pFDesc = entry->func;
         int j;
-        if(!lstrcmpiW(*rgszNames, pFDesc->Name)) {
-            if(cNames) *pMemId=pFDesc->funcdesc.memid;
-            for(i=1; i < cNames; i++){
-                for(j=0; j<pFDesc->funcdesc.cParams; j++)
-                    if(!lstrcmpiW(rgszNames[i],pFDesc->pParamDesc[j].Name))
-                            break;
-                if( j<pFDesc->funcdesc.cParams)
-                    pMemId[i]=j;
-                else
-                   ret=DISP_E_UNKNOWNNAME;
-            };
-            TRACE("-- 0x%08x\n", ret);
-            return ret;
-        }
+        if(cNames) *pMemId=pFDesc->funcdesc.memid;
+        for(i=1; i < cNames; i++){
+            ULONG hash = TLB_HashName(rgszNames[i]);
+            for(j=0; j<pFDesc->funcdesc.cParams; j++)
+                if(entry->param_hashes[j] == hash &&
+                   !lstrcmpiW(rgszNames[i],pFDesc->pParamDesc[j].Name))
+                        break;
+            if( j<pFDesc->funcdesc.cParams)
+                pMemId[i]=j;
+            else
+               ret=DISP_E_UNKNOWNNAME;
+        };
+        TRACE("-- 0x%08x\n", ret);
+        return ret;
     }
-    for(pVDesc=This->varlist; pVDesc; pVDesc=pVDesc->next) {
-        if(!lstrcmpiW(*rgszNames, pVDesc->Name)) {
-            if(cNames) *pMemId=pVDesc->vardesc.memid;
-            return ret;
-        }
+    if (entry->var) {
+        if(cNames) *pMemId=entry->var->vardesc.memid;
+        return ret;
     }
     /* not found, see if it can be found in an inherited interface */
     if(This->impltypelist) {
@@ -5689,6 +6077,52 @@ DispCallFunc(
 #define INVBUF_GET_ARG_TYPE_ARRAY(buffer, params) \
     ((VARTYPE *)((char *)(buffer) + (sizeof(VARIANTARG) + sizeof(VARIANTARG) + sizeof(VARIANTARG *)) * (params)))
 
+/* functions with up to this many parameters are invoked without allocating
+ * the argument buffer from the heap */
+#define INVBUF_STACK_PARAMS 8
+
+/* returns the variant types of the parameters of a function followed by the
+ * one of its return value. Resolving user defined types is expensive, so
+ * they are only computed on the first call */
+static HRESULT ITypeInfoImpl_GetInvokeTypes(ITypeInfo *iface, TLBFuncDesc *pFuncInfo, const VARTYPE **vts)
+{
+    const FUNCDESC *func_desc = &pFuncInfo->funcdesc;
+    VARTYPE *types;
+    HRESULT hres = S_OK;
+    int i;
+
+    if ((*vts = pFuncInfo->invoke_vts))
+        return S_OK;
+
+    types = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (func_desc->cParams + 1) * sizeof(VARTYPE));
+    if (!types)
+        return E_OUTOFMEMORY;
+
+    for (i = 0; i < func_desc->cParams && SUCCEEDED(hres); i++)
+        hres = typedescvt_to_variantvt(iface, &func_desc->lprgelemdescParam[i].tdesc, &types[i]);
+
+    /* VT_VOID is a special case for return types, so it is not
+     * handled in the general function */
+    if (SUCCEEDED(hres))
+    {
+        if (func_desc->elemdescFunc.tdesc.vt == VT_VOID)
+            types[func_desc->cParams] = VT_EMPTY;
+        else
+            hres = typedescvt_to_variantvt(iface, &func_desc->elemdescFunc.tdesc, &types[func_desc->cParams]);
+    }
+
+    if (FAILED(hres))
+    {
+        HeapFree(GetProcessHeap(), 0, types);
+        return hres;
+    }
+
+    if (InterlockedCompareExchangePointer((void **)&pFuncInfo->invoke_vts, types, NULL))
+        HeapFree(GetProcessHeap(), 0, types);
+    *vts = pFuncInfo->invoke_vts;
+    return S_OK;
+}
+
 static HRESULT WINAPI ITypeInfo_fnInvoke(
     ITypeInfo2 *iface,
     VOID  *pIUnk,
@@ -5705,6 +6139,7 @@ static HRESULT WINAPI ITypeInfo_fnInvoke(
     TYPEKIND type_kind;
     HRESULT hres;
     const TLBFuncDesc *pFuncInfo;
+    const TLBMemberIndex *index;
 
     TRACE("(%p)(%p,id=%d,flags=0x%08x,%p,%p,%p,%p)\n",
       This,pIUnk,memid,wFlags,pDispParams,pVarResult,pExcepInfo,pArgErr
@@ -5727,10 +6162,15 @@ static HRESULT WINAPI ITypeInfo_fnInvoke(
 
     /* we do this instead of using GetFuncDesc since it will return a fake
      * FUNCDESC for dispinterfaces and we want the real function description */
-    for (pFuncInfo = This->funclist; pFuncInfo; pFuncInfo=pFuncInfo->next)
-        if ((memid == pFuncInfo->funcdesc.memid) &&
-            (wFlags & pFuncInfo->funcdesc.invkind))
-            break;
+    if ((index = ITypeInfoImpl_GetMemberIndex(This)))
+        pFuncInfo = TLB_FindFuncByMemId(index, memid, wFlags);
+    else
+    {
+        for (pFuncInfo = This->funclist; pFuncInfo; pFuncInfo=pFuncInfo->next)
+            if ((memid == pFuncInfo->funcdesc.memid) &&
+                (wFlags & pFuncInfo->funcdesc.invkind))
+                break;
+    }
 
     if (pFuncInfo) {
         const FUNCDESC *func_desc = &pFuncInfo->funcdesc;
@@ -5744,15 +6184,28 @@ static HRESULT WINAPI ITypeInfo_fnInvoke(
 	switch (func_desc->funckind) {
 	case FUNC_PUREVIRTUAL:
 	case FUNC_VIRTUAL: {
-            void *buffer = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, INVBUF_ELEMENT_SIZE * func_desc->cParams);
+            VARIANT stack_buffer[(INVBUF_ELEMENT_SIZE * INVBUF_STACK_PARAMS + sizeof(VARIANT) - 1) / sizeof(VARIANT)];
+            void *buffer;
+            const VARTYPE *invoke_vts;
             VARIANT varresult;
             VARIANT retval; /* pointer for storing byref retvals in */
-            VARIANTARG **prgpvarg = INVBUF_GET_ARG_PTR_ARRAY(buffer, func_desc->cParams);
-            VARIANTARG *rgvarg = INVBUF_GET_ARG_ARRAY(buffer, func_desc->cParams);
-            VARTYPE *rgvt = INVBUF_GET_ARG_TYPE_ARRAY(buffer, func_desc->cParams);
+            VARIANTARG **prgpvarg;
+            VARIANTARG *rgvarg;
+            VARTYPE *rgvt;
             UINT cNamedArgs = pDispParams->cNamedArgs;
             DISPID *rgdispidNamedArgs = pDispParams->rgdispidNamedArgs;
 
+            if (func_desc->cParams <= INVBUF_STACK_PARAMS)
+            {
+                buffer = stack_buffer;
+                memset(buffer, 0, INVBUF_ELEMENT_SIZE * func_desc->cParams);
+            }
+            else
+                buffer = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, INVBUF_ELEMENT_SIZE * func_desc->cParams);
+            prgpvarg = INVBUF_GET_ARG_PTR_ARRAY(buffer, func_desc->cParams);
+            rgvarg = INVBUF_GET_ARG_ARRAY(buffer, func_desc->cParams);
+            rgvt = INVBUF_GET_ARG_TYPE_ARRAY(buffer, func_desc->cParams);
+
             hres = S_OK;
 
             if (func_desc->invkind & (INVOKE_PROPERTYPUT|INVOKE_PROPERTYPUTREF))
@@ -5775,13 +6228,10 @@ static HRESULT WINAPI ITypeInfo_fnInvoke(
                 goto func_fail;
             }
 
-            for (i = 0; i < func_desc->cParams; i++)
-            {
-                TYPEDESC *tdesc = &func_desc->lprgelemdescParam[i].tdesc;
-                hres = typedescvt_to_variantvt((ITypeInfo *)iface, tdesc, &rgvt[i]);
-                if (FAILED(hres))
-                    goto func_fail;
-            }
+            hres = ITypeInfoImpl_GetInvokeTypes((ITypeInfo *)iface, (TLBFuncDesc *)pFuncInfo, &invoke_vts);
+            if (FAILED(hres))
+                goto func_fail;
+            memcpy(rgvt, invoke_vts, func_desc->cParams * sizeof(VARTYPE));
 
             TRACE("changing args\n");
             for (i = 0; i < func_desc->cParams; i++)
@@ -5952,16 +6402,7 @@ static HRESULT WINAPI ITypeInfo_fnInvoke(
             }
             if (FAILED(hres)) goto func_fail; /* FIXME: we don't free changed types here */
 
-            /* VT_VOID is a special case for return types, so it is not
-             * handled in the general function */
-            if (func_desc->elemdescFunc.tdesc.vt == VT_VOID)
-                V_VT(&varresult) = VT_EMPTY;
-            else
-            {
-                V_VT(&varresult) = 0;
-                hres = typedescvt_to_variantvt((ITypeInfo *)iface, &func_desc->elemdescFunc.tdesc, &V_VT(&varresult));
-                if (FAILED(hres)) goto func_fail; /* FIXME: we don't free changed types here */
-            }
+            V_VT(&varresult) = invoke_vts[func_desc->cParams];
 
             hres = DispCallFunc(pIUnk, func_desc->oVft, func_desc->callconv,
                                 V_VT(&varresult), func_desc->cParams, rgvt,
@@ -6108,7 +6549,8 @@ static HRESULT WINAPI ITypeInfo_fnInvoke(
             }
 
 func_fail:
-            HeapFree(GetProcessHeap(), 0, buffer);
+            if (buffer != stack_buffer)
+                HeapFree(GetProcessHeap(), 0, buffer);
             break;
         }
 	case FUNC_DISPATCH:  {
@@ -6350,6 +6792,7 @@ static HRESULT WINAPI ITypeInfo_fnGetRefTypeInfo(
 	   */
 	  *pTypeInfoImpl = *This;
 	  pTypeInfoImpl->ref = 0;
+	  pTypeInfoImpl->member_index = NULL;
 
 	  /* change the type to interface */
 	  pTypeInfoImpl->TypeAttr.typekind = TKIND_INTERFACE;
@@ -6375,11 +6818,14 @@ static HRESULT WINAPI ITypeInfo_fnGetRefTypeInfo(
         result = ITypeInfoImpl_GetDispatchRefTypeInfo((ITypeInfo *)iface, &href_dispatch, ppTInfo);
     } else {
         TLBRefType *ref_type;
+        /* ref_list grows as type infos are read */
+        EnterCriticalSection(&This->pTypeLib->load_cs);
         LIST_FOR_EACH_ENTRY(ref_type, &This->pTypeLib->ref_list, TLBRefType, entry)
         {
             if(ref_type->reference == hRefType)
                 break;
         }
+        LeaveCriticalSection(&This->pTypeLib->load_cs);
         if(&ref_type->entry == &This->pTypeLib->ref_list)
         {
             FIXME("Can't find pRefType for ref %x\n", hRefType);
@@ -291,7 +291,7 @@ void ME_InternalDeleteText(ME_TextEditor *editor, int nOfs,
       int i;
       int loc = c.nOffset;
       
-      ME_FindItemBack(c.pRun, diParagraph)->member.para.nFlags |= MEPF_REWRAP;
+      ME_MarkParaForWrapping(editor, ME_FindItemBack(c.pRun, diParagraph));
       
       cursor = c;
       ME_StrRelPos(run->strText, loc, &nChars);
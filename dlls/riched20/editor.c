@@ -1193,14 +1193,12 @@ ME_StreamInRTFString(ME_TextEditor *editor, BOOL selection, char *string)
 ME_DisplayItem *
 ME_FindItemAtOffset(ME_TextEditor *editor, ME_DIType nItemType, int nOffset, int *nItemOffset)
 {
-  ME_DisplayItem *item = ME_FindItemFwd(editor->pBuffer->pFirst, diParagraph);
+  ME_DisplayItem *item = ME_FindParaAtCharOfs(editor, nOffset);
   int runLength;
   
-  while (item && item->member.para.next_para->member.para.nCharOfs <= nOffset)
-    item = ME_FindItemFwd(item, diParagraph);
-
-  if (!item)
-    return item;
+  /* past the end of the text */
+  if (item->member.para.next_para->member.para.nCharOfs <= nOffset)
+    return NULL;
 
   nOffset -= item->member.para.nCharOfs;
   if (nItemType == diParagraph) {
@@ -1628,6 +1626,11 @@ ME_TextEditor *ME_MakeEditor(HWND hWnd) {
   ed->bEmulateVersion10 = FALSE;
   ed->pBuffer = ME_MakeText();
   ed->nZoomNumerator = ed->nZoomDenominator = 0;
+  ed->pParaIndex = NULL;
+  ed->nParaIndexSize = ed->nParaIndexCount = 0;
+  ed->bParaIndexValid = FALSE;
+  ed->nDirtyYPos = 0;
+  ed->nRepaintYPos = 0;
   ME_MakeFirstParagraph(ed);
   ed->bCaretShown = FALSE;
   ed->nCursors = 4;
@@ -1757,6 +1760,7 @@ void ME_DestroyEditor(ME_TextEditor *editor)
 
   FREE_OBJ(editor->pBuffer);
   FREE_OBJ(editor->pCursors);
+  FREE_OBJ(editor->pParaIndex);
 
   FREE_OBJ(editor);
 }
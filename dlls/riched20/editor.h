@@ -233,6 +233,10 @@ void ME_GetSelectionParaFormat(ME_TextEditor *editor, PARAFORMAT2 *pFmt);
 void ME_MarkForWrapping(ME_TextEditor *editor, ME_DisplayItem *first, const ME_DisplayItem *last);
 void ME_MarkForPainting(ME_TextEditor *editor, ME_DisplayItem *first, const ME_DisplayItem *last);
 void ME_MarkAllForWrapping(ME_TextEditor *editor);
+void ME_MarkParaForWrapping(ME_TextEditor *editor, ME_DisplayItem *para);
+void ME_InvalidateParaIndex(ME_TextEditor *editor);
+ME_DisplayItem *ME_FindParaAtCharOfs(ME_TextEditor *editor, int nCharOfs);
+ME_DisplayItem *ME_FindParaBeforeYPos(ME_TextEditor *editor, int y);
 
 /* paint.c */
 void ME_PaintContent(ME_TextEditor *editor, HDC hDC, BOOL bOnlyNew, const RECT *rcUpdate);
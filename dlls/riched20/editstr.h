@@ -308,6 +308,14 @@ typedef struct tagME_TextEditor
   int nUndoLimit;
   ME_UndoMode nUndoMode;
   int nParagraphs;
+  /* paragraphs in document order, for binary searches by offset or position */
+  ME_DisplayItem **pParaIndex;
+  int nParaIndexSize, nParaIndexCount;
+  BOOL bParaIndexValid;
+  /* lowest y position of the paragraphs marked for rewrapping */
+  int nDirtyYPos;
+  /* lowest y position of the paragraphs marked for repainting */
+  int nRepaintYPos;
   int nLastSelStart, nLastSelEnd;
   ME_DisplayItem *pLastSelStartPara, *pLastSelEndPara;
   ME_FontCacheItem pFontCache[HFONT_CACHE_SIZE];
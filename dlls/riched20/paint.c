@@ -34,10 +34,24 @@ void ME_PaintContent(ME_TextEditor *editor, HDC hDC, BOOL bOnlyNew, const RECT *
   SetBkMode(hDC, TRANSPARENT);
   ME_MoveCaret(editor);
   item = editor->pBuffer->pFirst->next;
+  /* when the layout is up to date, skip the paragraphs above the update
+   * rectangle instead of walking the whole document */
+  if (rcUpdate && editor->nDirtyYPos == MAXLONG)
+  {
+    item = ME_FindParaBeforeYPos(editor, rcUpdate->top + yoffset + 1);
+    if (item != editor->pBuffer->pFirst->next)
+      c.pt.y = item->member.para.nYPos;
+  }
   c.pt.y -= yoffset;
   while(item != editor->pBuffer->pLast) {
     int ye;
     assert(item->type == diParagraph);
+    if (rcUpdate && c.pt.y >= rcUpdate->bottom && editor->nDirtyYPos == MAXLONG)
+    {
+      /* nothing below can intersect the update rectangle */
+      c.pt.y = editor->nTotalLength - yoffset;
+      break;
+    }
     ye = c.pt.y + item->member.para.nHeight;
     if (!bOnlyNew || (item->member.para.nFlags & MEPF_REPAINT))
     {
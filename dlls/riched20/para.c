@@ -85,9 +85,134 @@ void ME_MakeFirstParagraph(ME_TextEditor *editor)
 
   text->pLast->member.para.nCharOfs = 1;
 
+  ME_InvalidateParaIndex(editor);
+  editor->nDirtyYPos = 0;
+  editor->nRepaintYPos = 0;
+
   ME_DestroyContext(&c, editor->hWnd);
 }
- 
+
+/* The paragraph index holds the paragraphs in document order.  Their
+ * character offsets and y positions are read from the paragraphs themselves,
+ * so it only needs to be rebuilt when paragraphs are created or destroyed.
+ * Appending a paragraph at the end of the document keeps it valid. */
+void ME_InvalidateParaIndex(ME_TextEditor *editor)
+{
+  editor->bParaIndexValid = FALSE;
+}
+
+static BOOL ME_GrowParaIndex(ME_TextEditor *editor, int nCount)
+{
+  ME_DisplayItem **pNew;
+  int nSize = max(editor->nParaIndexSize, 16);
+
+  if (nCount <= editor->nParaIndexSize) return TRUE;
+  while (nSize < nCount) nSize *= 2;
+  if (editor->pParaIndex)
+    pNew = heap_realloc(editor->pParaIndex, nSize * sizeof(*pNew));
+  else
+    pNew = ALLOC_N_OBJ(ME_DisplayItem *, nSize);
+  if (!pNew) return FALSE;
+  editor->pParaIndex = pNew;
+  editor->nParaIndexSize = nSize;
+  return TRUE;
+}
+
+static BOOL ME_ValidateParaIndex(ME_TextEditor *editor)
+{
+  ME_DisplayItem *para;
+  int n = 0;
+
+  if (editor->bParaIndexValid) return TRUE;
+  if (!ME_GrowParaIndex(editor, editor->nParagraphs)) return FALSE;
+  for (para = editor->pBuffer->pFirst->member.para.next_para;
+       para->type == diParagraph; para = para->member.para.next_para)
+  {
+    if (n == editor->nParaIndexSize && !ME_GrowParaIndex(editor, n + 1))
+      return FALSE;
+    editor->pParaIndex[n++] = para;
+  }
+  editor->nParaIndexCount = n;
+  editor->bParaIndexValid = TRUE;
+  TRACE("rebuilt the index of %d paragraphs\n", n);
+  return TRUE;
+}
+
+static void ME_AddParaToIndex(ME_TextEditor *editor, ME_DisplayItem *prev, ME_DisplayItem *para)
+{
+  int n = editor->nParaIndexCount;
+
+  if (!editor->bParaIndexValid) return;
+  if (!n || editor->pParaIndex[n - 1] != prev || !ME_GrowParaIndex(editor, n + 1))
+  {
+    ME_InvalidateParaIndex(editor);
+    return;
+  }
+  editor->pParaIndex[editor->nParaIndexCount++] = para;
+}
+
+/* returns the paragraph containing the given absolute character offset */
+ME_DisplayItem *ME_FindParaAtCharOfs(ME_TextEditor *editor, int nCharOfs)
+{
+  ME_DisplayItem *para = editor->pBuffer->pFirst->member.para.next_para;
+  int low, high;
+
+  if (!ME_ValidateParaIndex(editor))
+  {
+    while (para->member.para.next_para->type == diParagraph &&
+           para->member.para.next_para->member.para.nCharOfs <= nCharOfs)
+      para = para->member.para.next_para;
+    return para;
+  }
+
+  /* last paragraph starting at or before nCharOfs */
+  low = 0;
+  high = editor->nParaIndexCount - 1;
+  while (low < high)
+  {
+    int mid = (low + high + 1) / 2;
+    if (editor->pParaIndex[mid]->member.para.nCharOfs <= nCharOfs)
+      low = mid;
+    else
+      high = mid - 1;
+  }
+  return editor->pParaIndex[low];
+}
+
+/* returns the last paragraph positioned above y, or the first paragraph */
+ME_DisplayItem *ME_FindParaBeforeYPos(ME_TextEditor *editor, int y)
+{
+  ME_DisplayItem *para = editor->pBuffer->pFirst->member.para.next_para;
+  int low, high;
+
+  if (!ME_ValidateParaIndex(editor))
+  {
+    while (para->member.para.next_para->type == diParagraph &&
+           para->member.para.next_para->member.para.nYPos < y)
+      para = para->member.para.next_para;
+    return para;
+  }
+
+  low = 0;
+  high = editor->nParaIndexCount - 1;
+  while (low < high)
+  {
+    int mid = (low + high + 1) / 2;
+    if (editor->pParaIndex[mid]->member.para.nYPos < y)
+      low = mid;
+    else
+      high = mid - 1;
+  }
+  return editor->pParaIndex[low];
+}
+
+void ME_MarkParaForWrapping(ME_TextEditor *editor, ME_DisplayItem *para)
+{
+  assert(para->type == diParagraph);
+  para->member.para.nFlags |= MEPF_REWRAP;
+  editor->nDirtyYPos = min(editor->nDirtyYPos, para->member.para.nYPos);
+}
+
 void ME_MarkAllForWrapping(ME_TextEditor *editor)
 {
   ME_MarkForWrapping(editor, editor->pBuffer->pFirst->member.para.next_para, editor->pBuffer->pLast);
@@ -97,13 +222,15 @@ void ME_MarkForWrapping(ME_TextEditor *editor, ME_DisplayItem *first, const ME_D
 {
   while(first != last)
   {
-    first->member.para.nFlags |= MEPF_REWRAP;
+    ME_MarkParaForWrapping(editor, first);
     first = first->member.para.next_para;
   }
 }
 
 void ME_MarkForPainting(ME_TextEditor *editor, ME_DisplayItem *first, const ME_DisplayItem *last)
 {
+  if (first != last)
+    editor->nRepaintYPos = min(editor->nRepaintYPos, first->member.para.nYPos);
   while(first != last)
   {
     first->member.para.nFlags |= MEPF_REPAINT;
@@ -148,6 +275,8 @@ ME_DisplayItem *ME_SplitParagraph(ME_TextEditor *editor, ME_DisplayItem *run, ME
   new_para->member.para.nCharOfs += end_len;
   
   new_para->member.para.nFlags = MEPF_REWRAP; /* FIXME copy flags (if applicable) */
+  /* the new paragraph is laid out from where the old one starts */
+  new_para->member.para.nYPos = run_para->member.para.nYPos;
   /* FIXME initialize format style and call ME_SetParaFormat blah blah */
   *new_para->member.para.pFmt = *run_para->member.para.pFmt;
 
@@ -191,12 +320,14 @@ ME_DisplayItem *ME_SplitParagraph(ME_TextEditor *editor, ME_DisplayItem *run, ME
   ME_InsertBefore(new_para, end_run);
 
   /* force rewrap of the */
-  run_para->member.para.prev_para->member.para.nFlags |= MEPF_REWRAP;
-  new_para->member.para.prev_para->member.para.nFlags |= MEPF_REWRAP;
+  if (run_para->member.para.prev_para->type == diParagraph)
+    ME_MarkParaForWrapping(editor, run_para->member.para.prev_para);
+  ME_MarkParaForWrapping(editor, new_para->member.para.prev_para);
   
   /* we've added the end run, so we need to modify nCharOfs in the next paragraphs */
   ME_PropagateCharOffset(next_para, end_len);
   editor->nParagraphs++;
+  ME_AddParaToIndex(editor, run_para, new_para);
   
   return new_para;
 }
@@ -283,7 +414,8 @@ ME_DisplayItem *ME_JoinParagraphs(ME_TextEditor *editor, ME_DisplayItem *tp)
   ME_CheckCharOffsets(editor);
   
   editor->nParagraphs--;
-  tp->member.para.nFlags |= MEPF_REWRAP;
+  ME_InvalidateParaIndex(editor);
+  ME_MarkParaForWrapping(editor, tp);
   return tp;
 }
 
@@ -409,7 +541,7 @@ void ME_SetParaFormat(ME_TextEditor *editor, ME_DisplayItem *para, const PARAFOR
 #undef COPY_FIELD
 
   if (memcmp(&copy, para->member.para.pFmt, sizeof(PARAFORMAT2)))
-    para->member.para.nFlags |= MEPF_REWRAP;
+    ME_MarkParaForWrapping(editor, para);
 }
 
 
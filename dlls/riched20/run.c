@@ -185,7 +185,7 @@ void ME_RunOfsFromCharOfs(ME_TextEditor *editor, int nCharOfs, ME_DisplayItem **
   ME_DisplayItem *pPara;
   int nParaOfs;
 
-  pPara = editor->pBuffer->pFirst->member.para.next_para;
+  pPara = ME_FindParaAtCharOfs(editor, nCharOfs);
   assert(pPara);
   assert(ppRun);
   assert(pOfs);
@@ -239,7 +239,7 @@ void ME_JoinRuns(ME_TextEditor *editor, ME_DisplayItem *p)
   int i;
   assert(p->type == diRun && pNext->type == diRun);
   assert(p->member.run.nCharOfs != -1);
-  ME_GetParagraph(p)->member.para.nFlags |= MEPF_REWRAP;
+  ME_MarkParaForWrapping(editor, ME_GetParagraph(p));
 
   /* Update all cursors so that they don't contain the soon deleted run */
   for (i=0; i<editor->nCursors; i++) {
@@ -346,7 +346,7 @@ ME_DisplayItem *ME_SplitRunSimple(ME_TextEditor *editor, ME_DisplayItem *item, i
       editor->pCursors[i].nOffset -= nVChar;
     }
   }
-  ME_GetParagraph(item)->member.para.nFlags |= MEPF_REWRAP;
+  ME_MarkParaForWrapping(editor, ME_GetParagraph(item));
   return item2;
 }
 
@@ -421,7 +421,7 @@ ME_InsertRunAtCursor(ME_TextEditor *editor, ME_Cursor *cursor, ME_Style *style,
   ME_InsertBefore(cursor->pRun, pDI);
   TRACE("Shift length:%d\n", len);
   ME_PropagateCharOffset(cursor->pRun, len);
-  ME_GetParagraph(cursor->pRun)->member.para.nFlags |= MEPF_REWRAP;
+  ME_MarkParaForWrapping(editor, ME_GetParagraph(cursor->pRun));
   return pDI;
 }
 
@@ -794,7 +794,7 @@ void ME_SetCharFormat(ME_TextEditor *editor, int nOfs, int nChars, CHARFORMAT2W
     tmp2.pRun = ME_SplitRunSimple(editor, tmp2.pRun, tmp2.nOffset);
 
   para = ME_GetParagraph(tmp.pRun);
-  para->member.para.nFlags |= MEPF_REWRAP;
+  ME_MarkParaForWrapping(editor, para);
 
   while(tmp.pRun != tmp2.pRun)
   {
@@ -818,7 +818,7 @@ void ME_SetCharFormat(ME_TextEditor *editor, int nOfs, int nChars, CHARFORMAT2W
       para = tmp.pRun;
       tmp.pRun = ME_FindItemFwd(tmp.pRun, diRun);
       if (tmp.pRun != tmp2.pRun)
-        para->member.para.nFlags |= MEPF_REWRAP;
+        ME_MarkParaForWrapping(editor, para);
     }
     assert(tmp.pRun);
   }
@@ -4424,6 +4424,117 @@ static void test_undo_coalescing(void)
     DestroyWindow(hwnd);
 }
 
+static void test_append_paragraphs(void)
+{
+  HWND hwndRichEdit = new_richedit(NULL);
+  LRESULT result;
+  int i, height, ypos;
+
+  /* Append lines at the end of the text, then check that the character
+   * offsets and positions of all of them are still consistent. */
+  for (i = 0; i < 200; i++)
+  {
+    SendMessage(hwndRichEdit, EM_SETSEL, -1, -1);
+    SendMessage(hwndRichEdit, EM_REPLACESEL, 0, (LPARAM)"0123456789ABCDE\n");
+  }
+  result = SendMessage(hwndRichEdit, EM_GETLINECOUNT, 0, 0);
+  ok(result == 201, "EM_GETLINECOUNT returned %ld, expected 201\n", result);
+
+  result = SendMessage(hwndRichEdit, EM_POSFROMCHAR, 16, 0);
+  height = HIWORD(result);
+  ok(height > 0, "line height is %d\n", height);
+  for (i = 0; i < 200; i++)
+  {
+    result = SendMessage(hwndRichEdit, EM_LINEINDEX, i, 0);
+    ok(result == i * 16, "EM_LINEINDEX(%d) returned %ld, expected %d\n", i, result, i * 16);
+    result = SendMessage(hwndRichEdit, EM_LINEFROMCHAR, i * 16 + 5, 0);
+    ok(result == i, "EM_LINEFROMCHAR(%d) returned %ld, expected %d\n", i * 16 + 5, result, i);
+  }
+  ypos = (short)HIWORD(SendMessage(hwndRichEdit, EM_POSFROMCHAR, 150 * 16, 0));
+  result = SendMessage(hwndRichEdit, EM_POSFROMCHAR, 151 * 16, 0);
+  ok((short)HIWORD(result) == ypos + height, "line 151 is at %d, expected %d\n",
+     (short)HIWORD(result), ypos + height);
+
+  /* insert a paragraph in the middle; the following lines must move down */
+  SendMessage(hwndRichEdit, EM_SETSEL, 100 * 16, 100 * 16);
+  SendMessage(hwndRichEdit, EM_REPLACESEL, 0, (LPARAM)"inserted\n");
+  result = SendMessage(hwndRichEdit, EM_LINEFROMCHAR, 100 * 16 + 9, 0);
+  ok(result == 101, "EM_LINEFROMCHAR returned %ld, expected 101\n", result);
+  result = SendMessage(hwndRichEdit, EM_LINEINDEX, 150, 0);
+  ok(result == 149 * 16 + 9, "EM_LINEINDEX(150) returned %ld, expected %d\n", result, 149 * 16 + 9);
+  ypos = (short)HIWORD(SendMessage(hwndRichEdit, EM_POSFROMCHAR, 149 * 16 + 9, 0));
+  result = SendMessage(hwndRichEdit, EM_POSFROMCHAR, 150 * 16 + 9, 0);
+  ok((short)HIWORD(result) == ypos + height, "line 151 is at %d, expected %d\n",
+     (short)HIWORD(result), ypos + height);
+
+  DestroyWindow(hwndRichEdit);
+}
+
+static void test_scrollbar_last_row(void)
+{
+  HWND hwndRichEdit = new_richedit(NULL);
+  char text[1024];
+  SCROLLBARINFO sbi;
+  RECT rc;
+  int i, y = 0;
+
+  /* a short paragraph followed by one that wraps onto more and more rows,
+   * until its last row starts below the client area */
+  strcpy(text, "line\r");
+  for (i = 0; i < 100; i++)
+  {
+    strcat(text, "word ");
+    SendMessage(hwndRichEdit, WM_SETTEXT, 0, (LPARAM)text);
+    GetClientRect(hwndRichEdit, &rc);
+    y = (short)HIWORD(SendMessage(hwndRichEdit, EM_POSFROMCHAR, strlen(text) - 2, 0));
+    if (y > rc.bottom) break;
+  }
+  ok(i < 100, "last row still at %d, client height %d\n", y, rc.bottom);
+
+  /* the rows of the last paragraph count from its top, the scrollbar is
+   * needed all the same */
+  sbi.cbSize = sizeof(sbi);
+  GetScrollBarInfo(hwndRichEdit, OBJID_VSCROLL, &sbi);
+  ok(!(sbi.rgstate[0] & STATE_SYSTEM_INVISIBLE), "vertical scrollbar not shown, last row at %d\n", y);
+
+  DestroyWindow(hwndRichEdit);
+}
+
+/* Not a correctness test, traces how long editing at the end of a growing
+ * document takes. The later rounds shouldn't take longer than the first
+ * ones when only the changed paragraphs are wrapped and painted. */
+static void test_append_timing(void)
+{
+  HWND hwndRichEdit;
+  DWORD start, elapsed;
+  int round, i;
+
+  if (!winetest_interactive)
+  {
+    skip("timing test, set WINETEST_INTERACTIVE to run it\n");
+    return;
+  }
+
+  hwndRichEdit = new_richedit(NULL);
+  for (round = 0; round < 4; round++)
+  {
+    start = GetTickCount();
+    for (i = 0; i < 1000; i++)
+    {
+      SendMessage(hwndRichEdit, EM_SETSEL, -1, -1);
+      SendMessage(hwndRichEdit, EM_REPLACESEL, 0, (LPARAM)"0123456789ABCDE\n");
+      SendMessage(hwndRichEdit, WM_CHAR, 'x', 0x1);
+      UpdateWindow(hwndRichEdit);
+    }
+    elapsed = GetTickCount() - start;
+    trace("lines %d-%d appended in %u ms\n", round * 1000, round * 1000 + 999, elapsed);
+  }
+  ok(SendMessage(hwndRichEdit, EM_GETLINECOUNT, 0, 0) == 4001, "EM_GETLINECOUNT returned %ld\n",
+     SendMessage(hwndRichEdit, EM_GETLINECOUNT, 0, 0));
+
+  DestroyWindow(hwndRichEdit);
+}
+
 START_TEST( editor )
 {
   MSG msg;
@@ -4470,6 +4581,9 @@ START_TEST( editor )
   test_EM_AUTOURLDETECT();
   test_eventMask();
   test_undo_coalescing();
+  test_append_paragraphs();
+  test_scrollbar_last_row();
+  test_append_timing();
 
   /* Set the environment variable WINETEST_RICHED20 to keep windows
    * responsive and open for 30 seconds. This is useful for debugging.
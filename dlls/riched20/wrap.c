@@ -493,20 +493,23 @@ static void ME_PrepareParagraphForWrapping(ME_Context *c, ME_DisplayItem *tp) {
 }
 
 BOOL ME_WrapMarkedParagraphs(ME_TextEditor *editor) {
-  ME_DisplayItem *item;
+  ME_DisplayItem *item, *start, *row;
   ME_Context c;
   BOOL bModified = FALSE;
   int yStart = -1;
   int yLastPos = 0;
 
   ME_InitContext(&c, editor, GetDC(editor->hWnd));
-  editor->nHeight = 0;
-  item = editor->pBuffer->pFirst->next;
+  /* the paragraphs above the first one marked for rewrapping keep their
+   * layout and position, so start from there */
+  start = ME_FindParaBeforeYPos(editor, editor->nDirtyYPos);
+  if (start != editor->pBuffer->pFirst->member.para.next_para)
+    c.pt.y = start->member.para.nYPos;
+  item = start;
   while(item != editor->pBuffer->pLast) {
     BOOL bRedraw = FALSE;
 
     assert(item->type == diParagraph);
-    editor->nHeight = max(editor->nHeight, item->member.para.nYPos);
     if ((item->member.para.nFlags & MEPF_REWRAP)
      || (item->member.para.nYPos != c.pt.y))
       bRedraw = TRUE;
@@ -517,6 +520,7 @@ BOOL ME_WrapMarkedParagraphs(ME_TextEditor *editor) {
     if (bRedraw)
     {
       item->member.para.nFlags |= MEPF_REPAINT;
+      editor->nRepaintYPos = min(editor->nRepaintYPos, c.pt.y);
       if (yStart == -1)
         yStart = c.pt.y;
     }
@@ -532,16 +536,18 @@ BOOL ME_WrapMarkedParagraphs(ME_TextEditor *editor) {
   
   editor->nTotalLength = c.pt.y;
   editor->pBuffer->pLast->member.para.nYPos = yLastPos;
+  editor->nDirtyYPos = MAXLONG;
 
   ME_DestroyContext(&c, editor->hWnd);
 
-  /* Each paragraph may contain multiple rows, which should be scrollable, even
-     if the containing paragraph has nYPos == 0 */
-  item = editor->pBuffer->pFirst;
-  while ((item = ME_FindItemFwd(item, diStartRow)) != NULL) {
-    assert(item->type == diStartRow);
-    editor->nHeight = max(editor->nHeight, item->member.row.nYPos);
-  }
+  /* Each paragraph may contain multiple rows, which should be scrollable, so
+     the height is the position of the last row in the document.  Its
+     position is relative to its paragraph, so add the paragraph position;
+     the last row can't be higher than any row or paragraph above it. */
+  editor->nHeight = yLastPos;
+  row = ME_FindItemBack(editor->pBuffer->pLast, diStartRow);
+  if (row)
+    editor->nHeight += row->member.row.nYPos;
 
   if (bModified || editor->nTotalLength < editor->nLastTotalLength)
     ME_InvalidateMarkedParagraphs(editor);
@@ -549,15 +555,19 @@ BOOL ME_WrapMarkedParagraphs(ME_TextEditor *editor) {
 }
 
 void ME_InvalidateMarkedParagraphs(ME_TextEditor *editor) {
+  ME_DisplayItem *item;
   ME_Context c;
 
+  /* the paragraphs above the first one marked for repainting can be skipped */
+  item = ME_FindParaBeforeYPos(editor, editor->nRepaintYPos);
+  editor->nRepaintYPos = MAXLONG;
+
   ME_InitContext(&c, editor, GetDC(editor->hWnd));
   if (editor->bRedraw)
   {
     RECT rc = c.rcView;
     int ofs = ME_GetYScrollPos(editor); 
      
-    ME_DisplayItem *item = editor->pBuffer->pFirst;
     while(item != editor->pBuffer->pLast) {
       if (item->member.para.nFlags & MEPF_REPAINT) { 
         rc.top = item->member.para.nYPos - ofs;
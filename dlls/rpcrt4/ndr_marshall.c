@@ -2163,6 +2163,131 @@ static unsigned long EmbeddedComplexMemorySize(PMIDL_STUB_MESSAGE pStubMsg,
 }
 
 
+/* Complex (bogus) structures made up only of base types and simple
+ * structures, with no padding in memory, have the same layout in memory
+ * and on the wire.  The analysis is cached per format string so that such
+ * types can be copied in one go instead of being walked member by member.
+ * A slot is filled once and never changed or freed afterwards, so it can be
+ * read without a lock; format strings that hash to a slot already in use
+ * are simply analysed every time. */
+#define FLAT_CACHE_SIZE 256
+
+struct flat_cache_entry
+{
+  PFORMAT_STRING format;    /* start of the member list */
+  unsigned char alignment;  /* alignment the member list was checked for */
+  ULONG size;               /* flat size, or 0 if the members aren't flat */
+};
+
+static struct flat_cache_entry *flat_cache[FLAT_CACHE_SIZE];
+
+static ULONG ComplexStructFlatSize(PFORMAT_STRING pFormat);
+
+static ULONG ComplexFlatSizeUncached(PFORMAT_STRING pFormat, unsigned char alignment)
+{
+  PFORMAT_STRING desc;
+  unsigned char max_align = 1, member_align;
+  ULONG size = 0, member_size;
+
+  while (*pFormat != RPC_FC_END) {
+    switch (*pFormat) {
+    case RPC_FC_BYTE:
+    case RPC_FC_CHAR:
+    case RPC_FC_SMALL:
+    case RPC_FC_USMALL:
+      size += 1;
+      break;
+    case RPC_FC_WCHAR:
+    case RPC_FC_SHORT:
+    case RPC_FC_USHORT:
+      size += 2;
+      break;
+    case RPC_FC_LONG:
+    case RPC_FC_ULONG:
+    case RPC_FC_ENUM32:
+      size += 4;
+      break;
+    case RPC_FC_HYPER:
+      size += 8;
+      break;
+    case RPC_FC_PAD:
+      break;
+    case RPC_FC_EMBEDDED_COMPLEX:
+      /* only structures without pointers that are flat themselves, placed
+       * where the marshaller won't have to align the buffer */
+      if (pFormat[1]) return 0;
+      desc = pFormat + 2 + *(const SHORT*)(pFormat + 2);
+      if (*desc == RPC_FC_STRUCT)
+        member_size = *(const WORD*)&desc[2];
+      else if (*desc == RPC_FC_BOGUS_STRUCT)
+        member_size = ComplexStructFlatSize(desc);
+      else
+        return 0;
+      if (!member_size) return 0;
+      member_align = desc[1] + 1;
+      if (member_align > alignment || size % member_align) return 0;
+      if (member_align > max_align) max_align = member_align;
+      size += member_size;
+      pFormat += 4;
+      continue;
+    default:
+      /* enum16, pointers, memory alignment and padding change the layout */
+      return 0;
+    }
+    pFormat++;
+  }
+
+  if (size % max_align) return 0;
+  return size;
+}
+
+/* returns the size of the member list if it can be copied as is, 0 otherwise */
+static ULONG ComplexFlatSize(PFORMAT_STRING pFormat, unsigned char alignment)
+{
+  struct flat_cache_entry **slot, *entry;
+  ULONG size;
+
+  slot = &flat_cache[((ULONG_PTR)pFormat >> 2) % FLAT_CACHE_SIZE];
+
+  entry = *slot;
+  if (entry && entry->format == pFormat && entry->alignment == alignment)
+    return entry->size;
+
+  size = ComplexFlatSizeUncached(pFormat, alignment);
+  TRACE("format %p alignment %d: flat size %d\n", pFormat, alignment, size);
+
+  if (!entry && (entry = HeapAlloc(GetProcessHeap(), 0, sizeof(*entry))))
+  {
+    entry->format = pFormat;
+    entry->alignment = alignment;
+    entry->size = size;
+    if (InterlockedCompareExchangePointer((void **)slot, entry, NULL))
+      HeapFree(GetProcessHeap(), 0, entry);
+  }
+
+  return size;
+}
+
+static ULONG ComplexStructFlatSize(PFORMAT_STRING pFormat)
+{
+  unsigned size = *(const WORD*)(pFormat+2);
+
+  /* conformant arrays and pointers need the full treatment */
+  if (*(const WORD*)(pFormat+4) || *(const WORD*)(pFormat+6))
+    return 0;
+  if (ComplexFlatSize(pFormat + 8, pFormat[1] + 1) != size)
+    return 0;
+  return size;
+}
+
+static ULONG ComplexArrayFlatSize(const MIDL_STUB_MESSAGE *pStubMsg,
+                                  PFORMAT_STRING pFormat)
+{
+  /* skip the header and the conformance and variance descriptors */
+  PFORMAT_STRING elem = pFormat + 4 + (pStubMsg->fHasNewCorrDesc ? 12 : 8);
+  return ComplexFlatSize(elem, pFormat[1] + 1);
+}
+
 static unsigned char * ComplexMarshall(PMIDL_STUB_MESSAGE pStubMsg,
                                        unsigned char *pMemory,
                                        PFORMAT_STRING pFormat,
@@ -2751,9 +2876,18 @@ unsigned char * WINAPI NdrComplexStructMarshall(PMIDL_STUB_MESSAGE pStubMsg,
   PFORMAT_STRING pointer_desc = NULL;
   unsigned char *OldMemory = pStubMsg->Memory;
   int pointer_buffer_mark_set = 0;
+  ULONG flat_size;
 
   TRACE("(%p,%p,%p)\n", pStubMsg, pMemory, pFormat);
 
+  if ((flat_size = ComplexStructFlatSize(pFormat)))
+  {
+    ALIGN_POINTER_CLEAR(pStubMsg->Buffer, pFormat[1] + 1);
+    safe_copy_to_buffer(pStubMsg, pMemory, flat_size);
+    STD_OVERFLOW_CHECK(pStubMsg);
+    return NULL;
+  }
+
   if (!pStubMsg->PointerBufferMark)
   {
     int saved_ignore_embedded = pStubMsg->IgnoreEmbeddedPointers;
@@ -2820,6 +2954,27 @@ unsigned char * WINAPI NdrComplexStructUnmarshall(PMIDL_STUB_MESSAGE pStubMsg,
 
   TRACE("(%p,%p,%p,%d)\n", pStubMsg, ppMemory, pFormat, fMustAlloc);
 
+  if (ComplexStructFlatSize(pFormat))
+  {
+    unsigned char *saved_buffer;
+
+    ALIGN_POINTER(pStubMsg->Buffer, pFormat[1] + 1);
+
+    if (fMustAlloc)
+      *ppMemory = NdrAllocate(pStubMsg, size);
+    else if (!pStubMsg->IsClient && !*ppMemory)
+      /* for servers, we just point straight into the RPC buffer */
+      *ppMemory = pStubMsg->Buffer;
+    else if (!*ppMemory)
+      *ppMemory = NdrAllocate(pStubMsg, size);
+
+    saved_buffer = pStubMsg->Buffer;
+    safe_buffer_increment(pStubMsg, size);
+    if (*ppMemory != saved_buffer)
+      memcpy(*ppMemory, saved_buffer, size);
+    return NULL;
+  }
+
   if (!pStubMsg->PointerBufferMark)
   {
     int saved_ignore_embedded = pStubMsg->IgnoreEmbeddedPointers;
@@ -2880,11 +3035,18 @@ void WINAPI NdrComplexStructBufferSize(PMIDL_STUB_MESSAGE pStubMsg,
   PFORMAT_STRING pointer_desc = NULL;
   unsigned char *OldMemory = pStubMsg->Memory;
   int pointer_length_set = 0;
+  ULONG flat_size;
 
   TRACE("(%p,%p,%p)\n", pStubMsg, pMemory, pFormat);
 
   ALIGN_LENGTH(pStubMsg->BufferLength, pFormat[1] + 1);
 
+  if ((flat_size = ComplexStructFlatSize(pFormat)))
+  {
+    safe_buffer_length_increment(pStubMsg, flat_size);
+    return;
+  }
+
   if(!pStubMsg->IgnoreEmbeddedPointers && !pStubMsg->PointerLength)
   {
     int saved_ignore_embedded = pStubMsg->IgnoreEmbeddedPointers;
@@ -2941,6 +3103,12 @@ ULONG WINAPI NdrComplexStructMemorySize(PMIDL_STUB_MESSAGE pStubMsg,
 
   ALIGN_POINTER(pStubMsg->Buffer, pFormat[1] + 1);
 
+  if (ComplexStructFlatSize(pFormat))
+  {
+    safe_buffer_increment(pStubMsg, size);
+    return size;
+  }
+
   pFormat += 4;
   if (*(const WORD*)pFormat) conf_array = pFormat + *(const WORD*)pFormat;
   pFormat += 4;
@@ -2966,6 +3134,10 @@ void WINAPI NdrComplexStructFree(PMIDL_STUB_MESSAGE pStubMsg,
 
   TRACE("(%p,%p,%p)\n", pStubMsg, pMemory, pFormat);
 
+  /* nothing to free in a flat structure */
+  if (ComplexStructFlatSize(pFormat))
+    return;
+
   pFormat += 4;
   if (*(const WORD*)pFormat) conf_array = pFormat + *(const WORD*)pFormat;
   pFormat += 2;
@@ -3301,7 +3473,7 @@ unsigned char * WINAPI NdrComplexArrayMarshall(PMIDL_STUB_MESSAGE pStubMsg,
                                                unsigned char *pMemory,
                                                PFORMAT_STRING pFormat)
 {
-  ULONG i, count, def;
+  ULONG i, count, def, flat_size;
   BOOL variance_present;
   unsigned char alignment;
   int pointer_buffer_mark_set = 0;
@@ -3316,8 +3488,9 @@ unsigned char * WINAPI NdrComplexArrayMarshall(PMIDL_STUB_MESSAGE pStubMsg,
   }
 
   alignment = pFormat[1] + 1;
+  flat_size = ComplexArrayFlatSize(pStubMsg, pFormat);
 
-  if (!pStubMsg->PointerBufferMark)
+  if (!flat_size && !pStubMsg->PointerBufferMark)
   {
     /* save buffer fields that may be changed by buffer sizer functions
      * and that may be needed later on */
@@ -3363,7 +3536,9 @@ unsigned char * WINAPI NdrComplexArrayMarshall(PMIDL_STUB_MESSAGE pStubMsg,
   ALIGN_POINTER_CLEAR(pStubMsg->Buffer, alignment);
 
   count = pStubMsg->ActualCount;
-  for (i = 0; i < count; i++)
+  if (flat_size)
+    safe_copy_to_buffer(pStubMsg, pMemory, safe_multiply(count, flat_size));
+  else for (i = 0; i < count; i++)
     pMemory = ComplexMarshall(pStubMsg, pMemory, pFormat, NULL);
 
   STD_OVERFLOW_CHECK(pStubMsg);
@@ -3385,7 +3560,7 @@ unsigned char * WINAPI NdrComplexArrayUnmarshall(PMIDL_STUB_MESSAGE pStubMsg,
                                                  PFORMAT_STRING pFormat,
                                                  unsigned char fMustAlloc)
 {
-  ULONG i, count, size;
+  ULONG i, count, size, flat_size;
   unsigned char alignment;
   unsigned char *pMemory;
   unsigned char *saved_buffer;
@@ -3403,6 +3578,33 @@ unsigned char * WINAPI NdrComplexArrayUnmarshall(PMIDL_STUB_MESSAGE pStubMsg,
 
   alignment = pFormat[1] + 1;
 
+  if ((flat_size = ComplexArrayFlatSize(pStubMsg, pFormat)))
+  {
+    ULONG copy_size;
+
+    pFormat = ReadConformance(pStubMsg, pFormat + 4);
+    pFormat = ReadVariance(pStubMsg, pFormat, pStubMsg->MaxCount);
+
+    size = safe_multiply(pStubMsg->MaxCount, flat_size);
+    copy_size = safe_multiply(pStubMsg->ActualCount, flat_size);
+    ALIGN_POINTER(pStubMsg->Buffer, alignment);
+
+    if (!fMustAlloc && !*ppMemory && !pStubMsg->IsClient && copy_size == size)
+      /* for servers, we just point straight into the RPC buffer */
+      *ppMemory = pStubMsg->Buffer;
+    else if (fMustAlloc || !*ppMemory)
+    {
+      *ppMemory = NdrAllocate(pStubMsg, size);
+      memset(*ppMemory, 0, size);
+    }
+
+    saved_buffer = pStubMsg->Buffer;
+    safe_buffer_increment(pStubMsg, copy_size);
+    if (*ppMemory != saved_buffer)
+      memcpy(*ppMemory, saved_buffer, copy_size);
+    return NULL;
+  }
+
   saved_ignore_embedded = pStubMsg->IgnoreEmbeddedPointers;
   /* save buffer pointer */
   saved_buffer = pStubMsg->Buffer;
@@ -3458,7 +3660,7 @@ void WINAPI NdrComplexArrayBufferSize(PMIDL_STUB_MESSAGE pStubMsg,
                                       unsigned char *pMemory,
                                       PFORMAT_STRING pFormat)
 {
-  ULONG i, count, def;
+  ULONG i, count, def, flat_size;
   unsigned char alignment;
   BOOL variance_present;
   int pointer_length_set = 0;
@@ -3473,8 +3675,9 @@ void WINAPI NdrComplexArrayBufferSize(PMIDL_STUB_MESSAGE pStubMsg,
   }
 
   alignment = pFormat[1] + 1;
+  flat_size = ComplexArrayFlatSize(pStubMsg, pFormat);
 
-  if (!pStubMsg->IgnoreEmbeddedPointers && !pStubMsg->PointerLength)
+  if (!flat_size && !pStubMsg->IgnoreEmbeddedPointers && !pStubMsg->PointerLength)
   {
     /* save buffer fields that may be changed by buffer sizer functions
      * and that may be needed later on */
@@ -3517,7 +3720,9 @@ void WINAPI NdrComplexArrayBufferSize(PMIDL_STUB_MESSAGE pStubMsg,
   ALIGN_LENGTH(pStubMsg->BufferLength, alignment);
 
   count = pStubMsg->ActualCount;
-  for (i = 0; i < count; i++)
+  if (flat_size)
+    safe_buffer_length_increment(pStubMsg, safe_multiply(count, flat_size));
+  else for (i = 0; i < count; i++)
     pMemory = ComplexBufferSize(pStubMsg, pMemory, pFormat, NULL);
 
   if(pointer_length_set)
@@ -3533,7 +3738,7 @@ void WINAPI NdrComplexArrayBufferSize(PMIDL_STUB_MESSAGE pStubMsg,
 ULONG WINAPI NdrComplexArrayMemorySize(PMIDL_STUB_MESSAGE pStubMsg,
                                        PFORMAT_STRING pFormat)
 {
-  ULONG i, count, esize, SavedMemorySize, MemorySize;
+  ULONG i, count, esize, flat_size, SavedMemorySize, MemorySize;
   unsigned char alignment;
 
   TRACE("(%p,%p)\n", pStubMsg, pFormat);
@@ -3546,6 +3751,7 @@ ULONG WINAPI NdrComplexArrayMemorySize(PMIDL_STUB_MESSAGE pStubMsg,
   }
 
   alignment = pFormat[1] + 1;
+  flat_size = ComplexArrayFlatSize(pStubMsg, pFormat);
 
   pFormat += 4;
 
@@ -3554,6 +3760,14 @@ ULONG WINAPI NdrComplexArrayMemorySize(PMIDL_STUB_MESSAGE pStubMsg,
 
   ALIGN_POINTER(pStubMsg->Buffer, alignment);
 
+  if (flat_size)
+  {
+    MemorySize = safe_multiply(pStubMsg->MaxCount, flat_size);
+    safe_buffer_increment(pStubMsg, safe_multiply(pStubMsg->ActualCount, flat_size));
+    pStubMsg->MemorySize += MemorySize;
+    return MemorySize;
+  }
+
   SavedMemorySize = pStubMsg->MemorySize;
 
   esize = ComplexStructSize(pStubMsg, pFormat);
@@ -3588,6 +3802,10 @@ void WINAPI NdrComplexArrayFree(PMIDL_STUB_MESSAGE pStubMsg,
       return;
   }
 
+  /* nothing to free in elements that are copied as is */
+  if (ComplexArrayFlatSize(pStubMsg, pFormat))
+    return;
+
   def = *(const WORD*)&pFormat[2];
   pFormat += 4;
 
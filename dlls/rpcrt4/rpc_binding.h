@@ -95,6 +95,9 @@ struct connection_ops {
   int (*close)(RpcConnection *conn);
   void (*cancel_call)(RpcConnection *conn);
   int (*wait_for_incoming_data)(RpcConnection *conn);
+  /* server-only: starts waiting for the next request on the connection, which
+   * is posted to the completion port with itself as key once data arrives */
+  RPC_STATUS (*wait_for_request)(RpcConnection *conn, HANDLE completion_port);
   size_t (*get_top_of_tower)(unsigned char *tower_data, const char *networkaddr, const char *endpoint);
   RPC_STATUS (*parse_top_of_tower)(const unsigned char *tower_data, size_t tower_size, char **networkaddr, char **endpoint);
 };
@@ -178,6 +181,11 @@ static inline void rpcrt4_conn_cancel_call(RpcConnection *Connection)
   Connection->ops->cancel_call(Connection);
 }
 
+static inline RPC_STATUS rpcrt4_conn_wait_for_request(RpcConnection *Connection, HANDLE completion_port)
+{
+  return Connection->ops->wait_for_request(Connection, completion_port);
+}
+
 static inline RPC_STATUS rpcrt4_conn_handoff(RpcConnection *old_conn, RpcConnection *new_conn)
 {
   return old_conn->ops->handoff(old_conn, new_conn);
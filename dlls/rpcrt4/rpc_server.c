@@ -47,13 +47,6 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(rpc);
 
-typedef struct _RpcPacket
-{
-  struct _RpcConnection* conn;
-  RpcPktHdr* hdr;
-  RPC_MESSAGE* msg;
-} RpcPacket;
-
 typedef struct _RpcObjTypeMap
 {
   /* FIXME: a hash table would be better. */
@@ -86,6 +79,26 @@ static CRITICAL_SECTION_DEBUG listen_cs_debug =
 };
 static CRITICAL_SECTION listen_cs = { &listen_cs_debug, -1, 0, 0, 0, 0 };
 
+static CRITICAL_SECTION worker_cs;
+static CRITICAL_SECTION_DEBUG worker_cs_debug =
+{
+    0, 0, &worker_cs,
+    { &worker_cs_debug.ProcessLocksList, &worker_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": worker_cs") }
+};
+static CRITICAL_SECTION worker_cs = { &worker_cs_debug, -1, 0, 0, 0, 0 };
+
+/* connections with a pending request are queued to this completion port by
+ * the transports and picked up by the worker threads */
+static HANDLE server_port; /* CS worker_cs, RO once set */
+static UINT server_workers; /* CS worker_cs */
+static UINT server_idle_workers; /* CS worker_cs */
+/* maximum number of calls executed concurrently */
+static UINT server_max_calls = RPC_C_LISTEN_MAX_CALLS_DEFAULT; /* CS worker_cs */
+
+/* time after which surplus idle worker threads exit */
+#define WORKER_IDLE_TIMEOUT 30000
+
 /* whether the server is currently listening */
 static BOOL std_listen;
 /* number of manual listeners (calls to RpcServerListen) */
@@ -353,74 +366,120 @@ static void RPCRT4_process_packet(RpcConnection* conn, RpcPktHdr* hdr, RPC_MESSA
   /* clean up */
   I_RpcFreeBuffer(msg);
   RPCRT4_FreeHeader(hdr);
-  HeapFree(GetProcessHeap(), 0, msg);
 }
 
-static DWORD CALLBACK RPCRT4_worker_thread(LPVOID the_arg)
-{
-  RpcPacket *pkt = the_arg;
-  RPCRT4_process_packet(pkt->conn, pkt->hdr, pkt->msg);
-  HeapFree(GetProcessHeap(), 0, pkt);
-  return 0;
-}
-
-static DWORD CALLBACK RPCRT4_io_thread(LPVOID the_arg)
+/* receives and processes one request, then goes back to waiting for the
+ * next one on the connection */
+static void RPCRT4_serve_connection(RpcConnection* conn)
 {
-  RpcConnection* conn = (RpcConnection*)the_arg;
   RpcPktHdr *hdr;
-  RPC_MESSAGE *msg;
+  RPC_MESSAGE msg;
   RPC_STATUS status;
-  RpcPacket *packet;
 
   TRACE("(%p)\n", conn);
 
-  for (;;) {
-    msg = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(RPC_MESSAGE));
+  memset(&msg, 0, sizeof(msg));
+  status = RPCRT4_Receive(conn, &hdr, &msg);
+  if (status != RPC_S_OK) {
+    WARN("receive failed with error %lx\n", status);
+    RPCRT4_DestroyConnection(conn);
+    return;
+  }
 
-    status = RPCRT4_Receive(conn, &hdr, msg);
-    if (status != RPC_S_OK) {
-      WARN("receive failed with error %lx\n", status);
-      HeapFree(GetProcessHeap(), 0, msg);
-      break;
-    }
+  RPCRT4_process_packet(conn, hdr, &msg);
 
-    packet = HeapAlloc(GetProcessHeap(), 0, sizeof(RpcPacket));
-    if (!packet) {
-      I_RpcFree(msg->Buffer);
-      HeapFree(GetProcessHeap(), 0, msg);
-      break;
-    }
-    packet->conn = conn;
-    packet->hdr = hdr;
-    packet->msg = msg;
-    if (!QueueUserWorkItem(RPCRT4_worker_thread, packet, WT_EXECUTELONGFUNCTION)) {
-      ERR("couldn't queue work item for worker thread, error was %d\n", GetLastError());
-      I_RpcFree(msg->Buffer);
-      HeapFree(GetProcessHeap(), 0, msg);
-      HeapFree(GetProcessHeap(), 0, packet);
-      break;
+  status = rpcrt4_conn_wait_for_request(conn, server_port);
+  if (status != RPC_S_OK) {
+    TRACE("connection %p closed (%lx)\n", conn, status);
+    RPCRT4_DestroyConnection(conn);
+  }
+}
+
+static DWORD CALLBACK RPCRT4_worker_thread(LPVOID the_arg);
+
+/* starts another worker if none is waiting for requests, unless the number
+ * of workers already matches the maximum number of concurrent calls.
+ * must be called with worker_cs held */
+static void RPCRT4_start_worker(void)
+{
+  HANDLE thread;
+
+  if (server_idle_workers || server_workers >= server_max_calls)
+    return;
+
+  thread = CreateThread(NULL, 0, RPCRT4_worker_thread, NULL, 0, NULL);
+  if (!thread) {
+    ERR("failed to create thread, error=%08x\n", GetLastError());
+    return;
+  }
+  CloseHandle(thread);
+  server_workers++;
+  server_idle_workers++;
+  TRACE("%u worker threads\n", server_workers);
+}
+
+static DWORD CALLBACK RPCRT4_worker_thread(LPVOID the_arg)
+{
+  LPOVERLAPPED ovl;
+  ULONG_PTR key;
+  DWORD size;
+
+  for (;;) {
+    if (!GetQueuedCompletionStatus(server_port, &size, &key, &ovl, WORKER_IDLE_TIMEOUT)) {
+      if (GetLastError() != WAIT_TIMEOUT) {
+        ERR("failed to dequeue request, error=%08x\n", GetLastError());
+        break;
+      }
+      /* keep one worker waiting */
+      EnterCriticalSection(&worker_cs);
+      if (server_idle_workers > 1) {
+        server_idle_workers--;
+        server_workers--;
+        LeaveCriticalSection(&worker_cs);
+        return 0;
+      }
+      LeaveCriticalSection(&worker_cs);
+      continue;
     }
 
-    msg = NULL;
+    EnterCriticalSection(&worker_cs);
+    server_idle_workers--;
+    RPCRT4_start_worker();
+    LeaveCriticalSection(&worker_cs);
+
+    RPCRT4_serve_connection((RpcConnection *)key);
+
+    EnterCriticalSection(&worker_cs);
+    server_idle_workers++;
+    LeaveCriticalSection(&worker_cs);
   }
-  RPCRT4_DestroyConnection(conn);
-  return 0;
+
+  EnterCriticalSection(&worker_cs);
+  server_idle_workers--;
+  server_workers--;
+  LeaveCriticalSection(&worker_cs);
+  return 1;
 }
 
 void RPCRT4_new_client(RpcConnection* conn)
 {
-  HANDLE thread = CreateThread(NULL, 0, RPCRT4_io_thread, conn, 0, NULL);
-  if (!thread) {
-    DWORD err = GetLastError();
-    ERR("failed to create thread, error=%08x\n", err);
+  RPC_STATUS status = RPC_S_OK;
+
+  EnterCriticalSection(&worker_cs);
+  if (!server_port)
+    server_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+  if (server_port)
+    RPCRT4_start_worker();
+  if (!server_port || !server_workers)
+    status = RPC_S_OUT_OF_RESOURCES;
+  LeaveCriticalSection(&worker_cs);
+
+  if (status == RPC_S_OK)
+    status = rpcrt4_conn_wait_for_request(conn, server_port);
+  if (status != RPC_S_OK) {
+    ERR("couldn't wait for requests on connection %p, error %lx\n", conn, status);
     RPCRT4_DestroyConnection(conn);
   }
-  /* we could set conn->thread, but then we'd have to make the io_thread wait
-   * for that, otherwise the thread might finish, destroy the connection, and
-   * free the memory we'd write to before we did, causing crashes and stuff -
-   * so let's implement that later, when we really need conn->thread */
-
-  CloseHandle( thread );
 }
 
 static DWORD CALLBACK RPCRT4_server_thread(LPVOID the_arg)
@@ -1025,6 +1084,13 @@ RPC_STATUS WINAPI RpcServerListen( UINT MinimumCallThreads, UINT MaxCalls, UINT
   if (list_empty(&protseqs))
     return RPC_S_NO_PROTSEQS_REGISTERED;
 
+  if (MaxCalls)
+  {
+    EnterCriticalSection(&worker_cs);
+    server_max_calls = MaxCalls;
+    LeaveCriticalSection(&worker_cs);
+  }
+
   status = RPCRT4_start_listen(FALSE);
 
   if (DontWait || (status != RPC_S_OK)) return status;
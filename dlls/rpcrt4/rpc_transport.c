@@ -98,6 +98,10 @@ typedef struct _RpcConnection_np
   HANDLE pipe;
   OVERLAPPED ovl;
   BOOL listening;
+  /* server-only: first byte of the next request, read while waiting for it */
+  BOOL read_pending;
+  char read_byte;
+  HANDLE port;
 } RpcConnection_np;
 
 static RpcConnection *rpcrt4_conn_np_alloc(void)
@@ -108,6 +112,8 @@ static RpcConnection *rpcrt4_conn_np_alloc(void)
     npc->pipe = NULL;
     memset(&npc->ovl, 0, sizeof(npc->ovl));
     npc->listening = FALSE;
+    npc->read_pending = FALSE;
+    npc->port = NULL;
   }
   return &npc->common;
 }
@@ -148,7 +154,7 @@ static RPC_STATUS rpcrt4_conn_create_pipe(RpcConnection *Connection, LPCSTR pnam
   RpcConnection_np *npc = (RpcConnection_np *) Connection;
   TRACE("listening on %s\n", pname);
 
-  npc->pipe = CreateNamedPipeA(pname, PIPE_ACCESS_DUPLEX,
+  npc->pipe = CreateNamedPipeA(pname, PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
                                PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE,
                                PIPE_UNLIMITED_INSTANCES,
                                RPC_MAX_PACKET_SIZE, RPC_MAX_PACKET_SIZE, 5000, NULL);
@@ -374,14 +380,32 @@ static int rpcrt4_conn_np_read(RpcConnection *Connection,
                         void *buffer, unsigned int count)
 {
   RpcConnection_np *npc = (RpcConnection_np *) Connection;
+  /* both server and client pipes get an event once connected; only server
+   * pipes are overlapped, on client pipes the read completes synchronously */
+  LPOVERLAPPED ovl = npc->ovl.hEvent ? &npc->ovl : NULL;
   char *buf = buffer;
   BOOL ret = TRUE;
   unsigned int bytes_left = count;
 
+  if (npc->read_pending && bytes_left)
+  {
+    DWORD bytes_read;
+    npc->read_pending = FALSE;
+    ret = GetOverlappedResult(npc->pipe, ovl, &bytes_read, TRUE);
+    if (!ret && GetLastError() == ERROR_MORE_DATA)
+        ret = TRUE;
+    if (!ret || !bytes_read)
+        return -1;
+    *buf++ = npc->read_byte;
+    bytes_left--;
+  }
+
   while (bytes_left)
   {
     DWORD bytes_read;
-    ret = ReadFile(npc->pipe, buf, bytes_left, &bytes_read, NULL);
+    ret = ReadFile(npc->pipe, buf, bytes_left, &bytes_read, ovl);
+    if (!ret && ovl && GetLastError() == ERROR_IO_PENDING)
+        ret = GetOverlappedResult(npc->pipe, ovl, &bytes_read, TRUE);
     if (!ret || !bytes_read)
         break;
     bytes_left -= bytes_read;
@@ -394,6 +418,7 @@ static int rpcrt4_conn_np_write(RpcConnection *Connection,
                              const void *buffer, unsigned int count)
 {
   RpcConnection_np *npc = (RpcConnection_np *) Connection;
+  LPOVERLAPPED ovl = npc->ovl.hEvent ? &npc->ovl : NULL;
   const char *buf = buffer;
   BOOL ret = TRUE;
   unsigned int bytes_left = count;
@@ -401,7 +426,9 @@ static int rpcrt4_conn_np_write(RpcConnection *Connection,
   while (bytes_left)
   {
     DWORD bytes_written;
-    ret = WriteFile(npc->pipe, buf, bytes_left, &bytes_written, NULL);
+    ret = WriteFile(npc->pipe, buf, bytes_left, &bytes_written, ovl);
+    if (!ret && ovl && GetLastError() == ERROR_IO_PENDING)
+        ret = GetOverlappedResult(npc->pipe, ovl, &bytes_written, TRUE);
     if (!ret || !bytes_written)
         break;
     bytes_left -= bytes_written;
@@ -436,6 +463,144 @@ static int rpcrt4_conn_np_wait_for_incoming_data(RpcConnection *Connection)
     return -1;
 }
 
+/* server pipes waiting for a request are watched by dispatcher threads, each
+ * handling as many pipes as it can wait for at once */
+#define NP_DISPATCH_MAX_CONNS (MAXIMUM_WAIT_OBJECTS - 1)
+
+typedef struct _RpcPipeDispatcher
+{
+  struct list entry; /* CS np_dispatch_cs */
+  HANDLE wake_event; /* RO */
+  unsigned int count; /* CS np_dispatch_cs */
+  RpcConnection_np *conns[NP_DISPATCH_MAX_CONNS]; /* CS np_dispatch_cs */
+} RpcPipeDispatcher;
+
+static struct list np_dispatchers = LIST_INIT(np_dispatchers);
+
+static CRITICAL_SECTION np_dispatch_cs;
+static CRITICAL_SECTION_DEBUG np_dispatch_cs_debug =
+{
+    0, 0, &np_dispatch_cs,
+    { &np_dispatch_cs_debug.ProcessLocksList, &np_dispatch_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": np_dispatch_cs") }
+};
+static CRITICAL_SECTION np_dispatch_cs = { &np_dispatch_cs_debug, -1, 0, 0, 0, 0 };
+
+static DWORD CALLBACK rpcrt4_np_dispatch_thread(LPVOID the_arg)
+{
+  RpcPipeDispatcher *disp = the_arg;
+  RpcConnection_np *conns[NP_DISPATCH_MAX_CONNS];
+  HANDLE objs[NP_DISPATCH_MAX_CONNS + 1];
+  RpcConnection_np *npc;
+  unsigned int count, i;
+  DWORD res;
+
+  for (;;)
+  {
+    /* connections are only removed by this thread, so the copy stays valid
+     * until we remove them ourselves */
+    EnterCriticalSection(&np_dispatch_cs);
+    count = disp->count;
+    memcpy(conns, disp->conns, count * sizeof(conns[0]));
+    LeaveCriticalSection(&np_dispatch_cs);
+
+    objs[0] = disp->wake_event;
+    for (i = 0; i < count; i++)
+      objs[i + 1] = conns[i]->ovl.hEvent;
+
+    do
+      res = WaitForMultipleObjectsEx(count + 1, objs, FALSE, INFINITE, TRUE);
+    while (res == WAIT_IO_COMPLETION);
+
+    if (res == WAIT_FAILED)
+    {
+      ERR("wait failed with error %d\n", GetLastError());
+      return 1;
+    }
+    if (res == WAIT_OBJECT_0)
+      continue;
+
+    npc = conns[res - WAIT_OBJECT_0 - 1];
+    EnterCriticalSection(&np_dispatch_cs);
+    for (i = 0; i < disp->count; i++)
+      if (disp->conns[i] == npc)
+      {
+        disp->conns[i] = disp->conns[--disp->count];
+        break;
+      }
+    LeaveCriticalSection(&np_dispatch_cs);
+
+    PostQueuedCompletionStatus(npc->port, 0, (ULONG_PTR)&npc->common, NULL);
+  }
+}
+
+static RPC_STATUS rpcrt4_np_dispatch_add(RpcConnection_np *npc)
+{
+  RpcPipeDispatcher *disp;
+  HANDLE thread;
+
+  EnterCriticalSection(&np_dispatch_cs);
+  LIST_FOR_EACH_ENTRY(disp, &np_dispatchers, RpcPipeDispatcher, entry)
+    if (disp->count < NP_DISPATCH_MAX_CONNS)
+      goto found;
+
+  disp = HeapAlloc(GetProcessHeap(), 0, sizeof(*disp));
+  if (!disp)
+  {
+    LeaveCriticalSection(&np_dispatch_cs);
+    return RPC_S_OUT_OF_RESOURCES;
+  }
+  disp->count = 0;
+  disp->wake_event = CreateEventW(NULL, FALSE, FALSE, NULL);
+  thread = disp->wake_event ? CreateThread(NULL, 0, rpcrt4_np_dispatch_thread, disp, 0, NULL) : NULL;
+  if (!thread)
+  {
+    ERR("failed to create dispatcher thread, error=%08x\n", GetLastError());
+    if (disp->wake_event) CloseHandle(disp->wake_event);
+    HeapFree(GetProcessHeap(), 0, disp);
+    LeaveCriticalSection(&np_dispatch_cs);
+    return RPC_S_OUT_OF_RESOURCES;
+  }
+  CloseHandle(thread);
+  list_add_tail(&np_dispatchers, &disp->entry);
+  TRACE("started pipe dispatcher %p\n", disp);
+
+found:
+  disp->conns[disp->count++] = npc;
+  SetEvent(disp->wake_event);
+  LeaveCriticalSection(&np_dispatch_cs);
+  return RPC_S_OK;
+}
+
+static RPC_STATUS rpcrt4_conn_np_wait_for_request(RpcConnection *Connection, HANDLE completion_port)
+{
+  RpcConnection_np *npc = (RpcConnection_np *) Connection;
+
+  /* read the first byte of the request asynchronously, the rest of it is
+   * read by the worker that processes it */
+  npc->port = completion_port;
+  npc->read_pending = TRUE;
+  if (ReadFile(npc->pipe, &npc->read_byte, 1, NULL, &npc->ovl) ||
+      GetLastError() == ERROR_MORE_DATA)
+  {
+    PostQueuedCompletionStatus(completion_port, 0, (ULONG_PTR)Connection, NULL);
+    return RPC_S_OK;
+  }
+  if (GetLastError() != ERROR_IO_PENDING)
+  {
+    TRACE("ReadFile failed with error %d\n", GetLastError());
+    npc->read_pending = FALSE;
+    return RPC_S_CALL_FAILED;
+  }
+  if (rpcrt4_np_dispatch_add(npc) != RPC_S_OK)
+  {
+    CancelIo(npc->pipe);
+    npc->read_pending = FALSE;
+    return RPC_S_OUT_OF_RESOURCES;
+  }
+  return RPC_S_OK;
+}
+
 static size_t rpcrt4_ncacn_np_get_top_of_tower(unsigned char *tower_data,
                                                const char *networkaddr,
                                                const char *endpoint)
@@ -738,6 +903,9 @@ typedef struct _RpcConnection_tcp
   RpcConnection common;
   int sock;
   int cancel_fds[2];
+  /* server-only */
+  struct list idle_entry; /* CS tcp_dispatch_cs */
+  HANDLE port;
 } RpcConnection_tcp;
 
 static RpcConnection *rpcrt4_conn_tcp_alloc(void)
@@ -1099,6 +1267,139 @@ static int rpcrt4_conn_tcp_wait_for_incoming_data(RpcConnection *Connection)
     return 0;
 }
 
+/* server sockets waiting for a request are all watched by a single
+ * dispatcher thread */
+static struct list tcp_idle_conns = LIST_INIT(tcp_idle_conns);
+static int tcp_dispatch_wake_fds[2] = { -1, -1 };
+
+static CRITICAL_SECTION tcp_dispatch_cs;
+static CRITICAL_SECTION_DEBUG tcp_dispatch_cs_debug =
+{
+    0, 0, &tcp_dispatch_cs,
+    { &tcp_dispatch_cs_debug.ProcessLocksList, &tcp_dispatch_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": tcp_dispatch_cs") }
+};
+static CRITICAL_SECTION tcp_dispatch_cs = { &tcp_dispatch_cs_debug, -1, 0, 0, 0, 0 };
+
+static DWORD CALLBACK rpcrt4_tcp_dispatch_thread(LPVOID the_arg)
+{
+  struct pollfd *pfds = NULL;
+  RpcConnection_tcp **conns = NULL;
+  RpcConnection_tcp *tcpc;
+  unsigned int count, size = 0, i;
+
+  /* this thread watches the connections of every server in the process, so
+   * it keeps going after errors instead of leaving them all unserved */
+  for (;;)
+  {
+    EnterCriticalSection(&tcp_dispatch_cs);
+    count = list_count(&tcp_idle_conns) + 1;
+    if (count > size)
+    {
+      unsigned int new_size = max(count, size * 2);
+      void *mem;
+
+      /* the connection pointers follow the poll array in the same block */
+      mem = pfds ? HeapReAlloc(GetProcessHeap(), 0, pfds, new_size * (sizeof(*pfds) + sizeof(*conns)))
+                 : HeapAlloc(GetProcessHeap(), 0, new_size * (sizeof(*pfds) + sizeof(*conns)));
+      if (mem)
+      {
+        pfds = mem;
+        conns = (RpcConnection_tcp **)(pfds + new_size);
+        size = new_size;
+      }
+      else
+        ERR("couldn't allocate poll array for %u connections\n", count);
+    }
+    if (!size)
+    {
+      LeaveCriticalSection(&tcp_dispatch_cs);
+      Sleep(100);
+      continue;
+    }
+    /* connections that don't fit are watched once there is memory again */
+    count = min(count, size);
+    pfds[0].fd = tcp_dispatch_wake_fds[0];
+    pfds[0].events = POLLIN;
+    i = 1;
+    /* connections are only removed by this thread, so they stay valid until
+     * we remove them ourselves */
+    LIST_FOR_EACH_ENTRY(tcpc, &tcp_idle_conns, RpcConnection_tcp, idle_entry)
+    {
+      if (i == count) break;
+      pfds[i].fd = tcpc->sock;
+      pfds[i].events = POLLIN;
+      conns[i++] = tcpc;
+    }
+    LeaveCriticalSection(&tcp_dispatch_cs);
+
+    if (poll(pfds, count, -1 /* infinite */) == -1)
+    {
+      if (errno == EINTR) continue;
+      ERR("poll() failed: %s\n", strerror(errno));
+      Sleep(100);
+      continue;
+    }
+
+    if (pfds[0].revents & POLLIN)
+    {
+      char dummy[16];
+      while (read(pfds[0].fd, dummy, sizeof(dummy)) > 0)
+        ;
+    }
+
+    for (i = 1; i < count; i++)
+    {
+      /* errors and hangups are reported by the worker's read */
+      if (!pfds[i].revents) continue;
+      EnterCriticalSection(&tcp_dispatch_cs);
+      list_remove(&conns[i]->idle_entry);
+      LeaveCriticalSection(&tcp_dispatch_cs);
+      PostQueuedCompletionStatus(conns[i]->port, 0, (ULONG_PTR)&conns[i]->common, NULL);
+    }
+  }
+  return 0;
+}
+
+static RPC_STATUS rpcrt4_conn_tcp_wait_for_request(RpcConnection *Connection, HANDLE completion_port)
+{
+  RpcConnection_tcp *tcpc = (RpcConnection_tcp *) Connection;
+  char dummy = 1;
+
+  EnterCriticalSection(&tcp_dispatch_cs);
+  if (tcp_dispatch_wake_fds[0] == -1)
+  {
+    HANDLE thread;
+    int fds[2];
+
+    if (socketpair(PF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+      ERR("socketpair() failed: %s\n", strerror(errno));
+      LeaveCriticalSection(&tcp_dispatch_cs);
+      return RPC_S_OUT_OF_RESOURCES;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    thread = CreateThread(NULL, 0, rpcrt4_tcp_dispatch_thread, NULL, 0, NULL);
+    if (!thread)
+    {
+      ERR("failed to create dispatcher thread, error=%08x\n", GetLastError());
+      close(fds[0]);
+      close(fds[1]);
+      LeaveCriticalSection(&tcp_dispatch_cs);
+      return RPC_S_OUT_OF_RESOURCES;
+    }
+    CloseHandle(thread);
+    tcp_dispatch_wake_fds[0] = fds[0];
+    tcp_dispatch_wake_fds[1] = fds[1];
+  }
+  tcpc->port = completion_port;
+  list_add_tail(&tcp_idle_conns, &tcpc->idle_entry);
+  write(tcp_dispatch_wake_fds[1], &dummy, sizeof(dummy));
+  LeaveCriticalSection(&tcp_dispatch_cs);
+  return RPC_S_OK;
+}
+
 static size_t rpcrt4_ncacn_ip_tcp_get_top_of_tower(unsigned char *tower_data,
                                                    const char *networkaddr,
                                                    const char *endpoint)
@@ -1363,10 +1664,11 @@ static int rpcrt4_protseq_sock_wait_for_new_connection(RpcServerProtseq *protseq
             else
                 ERR("failed to locate connection for fd %d\n", poll_info[i].fd);
             LeaveCriticalSection(&protseq->cs);
+            /* one failed connection mustn't stop the server from listening */
             if (cconn)
                 RPCRT4_new_client(cconn);
             else
-                return -1;
+                ERR("couldn't create a connection for fd %d\n", poll_info[i].fd);
         }
 
     return 1;
@@ -1383,6 +1685,7 @@ static const struct connection_ops conn_protseq_list[] = {
     rpcrt4_conn_np_close,
     rpcrt4_conn_np_cancel_call,
     rpcrt4_conn_np_wait_for_incoming_data,
+    rpcrt4_conn_np_wait_for_request,
     rpcrt4_ncacn_np_get_top_of_tower,
     rpcrt4_ncacn_np_parse_top_of_tower,
   },
@@ -1396,6 +1699,7 @@ static const struct connection_ops conn_protseq_list[] = {
     rpcrt4_conn_np_close,
     rpcrt4_conn_np_cancel_call,
     rpcrt4_conn_np_wait_for_incoming_data,
+    rpcrt4_conn_np_wait_for_request,
     rpcrt4_ncalrpc_get_top_of_tower,
     rpcrt4_ncalrpc_parse_top_of_tower,
   },
@@ -1409,6 +1713,7 @@ static const struct connection_ops conn_protseq_list[] = {
     rpcrt4_conn_tcp_close,
     rpcrt4_conn_tcp_cancel_call,
     rpcrt4_conn_tcp_wait_for_incoming_data,
+    rpcrt4_conn_tcp_wait_for_request,
     rpcrt4_ncacn_ip_tcp_get_top_of_tower,
     rpcrt4_ncacn_ip_tcp_parse_top_of_tower,
   }
@@ -1516,6 +1516,158 @@ static void test_conformant_array(void)
     HeapFree(GetProcessHeap(), 0, StubMsg.RpcMsg->Buffer);
 }
 
+static void test_flat_complex_array(void)
+{
+    RPC_MESSAGE RpcMessage;
+    MIDL_STUB_MESSAGE StubMsg;
+    MIDL_STUB_DESC StubDesc;
+    void *ptr;
+    unsigned char *mem, *mem_orig;
+    struct flat
+    {
+        LONG l;
+        SHORT s1;
+        SHORT s2;
+    } memsrc[16];
+    unsigned int i;
+    DWORD start, elapsed;
+
+    static const unsigned char fmtstr_flat_array[] =
+    {
+/* 0 */
+        0x1a,              /* FC_BOGUS_STRUCT */
+        0x3,               /* align */
+        NdrFcShort( 0x8 ), /* size */
+        NdrFcShort( 0x0 ), /* no conformant array */
+        NdrFcShort( 0x0 ), /* no pointers */
+        0x8,               /* FC_LONG */
+        0x6,               /* FC_SHORT */
+        0x6,               /* FC_SHORT */
+        0x5b,              /* FC_END */
+/* 12 */
+        0x21,              /* FC_BOGUS_ARRAY */
+        0x3,               /* align */
+        NdrFcShort( 0x10 ),/* num elements */
+        0x40,              /* Corr desc:  const */
+        0x0,
+        NdrFcShort(0x10),  /* const = 0x10 */
+        0xff,              /* no variance */
+        0xff,
+        0xff,
+        0xff,
+/* 24 */
+        0x4c,              /* FC_EMBEDDED_COMPLEX */
+        0x0,
+        NdrFcShort( 0xffe6 ), /* Offset= -26 (0) */
+        0x5b,              /* FC_END */
+        0x5b               /* FC_END */
+    };
+
+    for (i = 0; i < sizeof(memsrc) / sizeof(memsrc[0]); i++)
+    {
+        memsrc[i].l = i * i;
+        memsrc[i].s1 = i;
+        memsrc[i].s2 = -i;
+    }
+
+    StubDesc = Object_StubDesc;
+    StubDesc.pFormatTypes = fmtstr_flat_array;
+
+    NdrClientInitializeNew(
+                           &RpcMessage,
+                           &StubMsg,
+                           &StubDesc,
+                           0);
+
+    StubMsg.BufferLength = 0;
+    NdrComplexArrayBufferSize( &StubMsg,
+                          (unsigned char *)memsrc,
+                          fmtstr_flat_array + 12 );
+    ok(StubMsg.BufferLength == 4 + sizeof(memsrc), "length %d\n", StubMsg.BufferLength);
+
+    StubMsg.RpcMsg->Buffer = StubMsg.BufferStart = StubMsg.Buffer = HeapAlloc(GetProcessHeap(), 0, StubMsg.BufferLength);
+    StubMsg.BufferEnd = StubMsg.BufferStart + StubMsg.BufferLength;
+
+    ptr = NdrComplexArrayMarshall( &StubMsg, (unsigned char *)memsrc, fmtstr_flat_array + 12 );
+    ok(ptr == NULL, "ret %p\n", ptr);
+    ok(StubMsg.Buffer - StubMsg.BufferStart == 4 + sizeof(memsrc), "Buffer %p Start %p\n", StubMsg.Buffer, StubMsg.BufferStart);
+    ok(*(DWORD *)StubMsg.BufferStart == 16, "conformance %d\n", *(DWORD *)StubMsg.BufferStart);
+    ok(!memcmp(StubMsg.BufferStart + 4, memsrc, sizeof(memsrc)), "incorrectly marshaled\n");
+
+    StubMsg.Buffer = StubMsg.BufferStart;
+    StubMsg.MemorySize = 0;
+    i = NdrComplexArrayMemorySize( &StubMsg, fmtstr_flat_array + 12 );
+    ok(i == sizeof(memsrc), "size %d\n", i);
+    ok(StubMsg.Buffer - StubMsg.BufferStart == 4 + sizeof(memsrc), "Buffer %p Start %p\n", StubMsg.Buffer, StubMsg.BufferStart);
+
+    my_alloc_called = 0;
+    mem = NULL;
+    StubMsg.Buffer = StubMsg.BufferStart;
+    NdrComplexArrayUnmarshall( &StubMsg, &mem, fmtstr_flat_array + 12, 1);
+    ok(mem != NULL, "mem not alloced\n");
+    ok(mem != StubMsg.BufferStart + 4, "mem pointing at buffer\n");
+    ok(my_alloc_called == 1, "alloc called %d\n", my_alloc_called);
+    ok(StubMsg.Buffer - StubMsg.BufferStart == 4 + sizeof(memsrc), "Buffer %p Start %p\n", StubMsg.Buffer, StubMsg.BufferStart);
+    ok(!memcmp(mem, memsrc, sizeof(memsrc)), "incorrectly unmarshaled\n");
+
+    my_free_called = 0;
+    NdrComplexArrayFree( &StubMsg, mem, fmtstr_flat_array + 12 );
+    ok(my_free_called == 0, "free called %d\n", my_free_called);
+
+    /* servers unmarshal a flat array in place */
+    StubMsg.IsClient = 0;
+    my_alloc_called = 0;
+    mem_orig = mem;
+    mem = NULL;
+    StubMsg.Buffer = StubMsg.BufferStart;
+    NdrComplexArrayUnmarshall( &StubMsg, &mem, fmtstr_flat_array + 12, 0);
+    ok(mem == StubMsg.BufferStart + 4, "mem %p not pointing at buffer %p\n", mem, StubMsg.BufferStart + 4);
+    ok(my_alloc_called == 0, "alloc called %d\n", my_alloc_called);
+    ok(StubMsg.Buffer - StubMsg.BufferStart == 4 + sizeof(memsrc), "Buffer %p Start %p\n", StubMsg.Buffer, StubMsg.BufferStart);
+    ok(!memcmp(mem, memsrc, sizeof(memsrc)), "incorrectly unmarshaled\n");
+    StubMsg.IsClient = 1;
+    mem = mem_orig;
+
+    /* a single element goes over the wire as is too */
+    StubMsg.Buffer = StubMsg.BufferStart;
+    ptr = NdrComplexStructMarshall( &StubMsg, (unsigned char *)&memsrc[3], fmtstr_flat_array );
+    ok(ptr == NULL, "ret %p\n", ptr);
+    ok(StubMsg.Buffer - StubMsg.BufferStart == sizeof(memsrc[3]), "Buffer %p Start %p\n", StubMsg.Buffer, StubMsg.BufferStart);
+    ok(!memcmp(StubMsg.BufferStart, &memsrc[3], sizeof(memsrc[3])), "incorrectly marshaled\n");
+
+    mem_orig = mem;
+    StubMsg.Buffer = StubMsg.BufferStart;
+    NdrComplexStructUnmarshall( &StubMsg, &mem, fmtstr_flat_array, 0);
+    ok(mem == mem_orig, "mem alloced\n");
+    ok(!memcmp(mem, &memsrc[3], sizeof(memsrc[3])), "incorrectly unmarshaled\n");
+
+    /* round trip rate, only in interactive mode so that the normal test run stays fast */
+    if (!winetest_interactive)
+    {
+        StubMsg.pfnFree(mem);
+        HeapFree(GetProcessHeap(), 0, StubMsg.RpcMsg->Buffer);
+        return;
+    }
+
+    start = GetTickCount();
+    for (i = 0; i < 100000; i++)
+    {
+        StubMsg.BufferLength = 0;
+        NdrComplexArrayBufferSize( &StubMsg, (unsigned char *)memsrc, fmtstr_flat_array + 12 );
+        StubMsg.Buffer = StubMsg.BufferStart;
+        NdrComplexArrayMarshall( &StubMsg, (unsigned char *)memsrc, fmtstr_flat_array + 12 );
+        StubMsg.Buffer = StubMsg.BufferStart;
+        NdrComplexArrayUnmarshall( &StubMsg, &mem, fmtstr_flat_array + 12, 0);
+    }
+    elapsed = GetTickCount() - start;
+    ok(mem == mem_orig, "mem alloced\n");
+    ok(!memcmp(mem, memsrc, sizeof(memsrc)), "incorrectly unmarshaled\n");
+    trace("%u array round trips of %u bytes in %u ms\n", i, (unsigned int)sizeof(memsrc), elapsed);
+
+    StubMsg.pfnFree(mem);
+    HeapFree(GetProcessHeap(), 0, StubMsg.RpcMsg->Buffer);
+}
+
 static void test_conformant_string(void)
 {
     RPC_MESSAGE RpcMessage;
@@ -1933,6 +2085,7 @@ START_TEST( ndr_marshall )
     test_server_init();
     test_ndr_allocate();
     test_conformant_array();
+    test_flat_complex_array();
     test_conformant_string();
     test_nonconformant_string();
     test_ndr_buffer();
@@ -1225,6 +1225,53 @@ run_tests(void)
   context_handle_test();
 }
 
+#define CLIENT_THREADS 64
+#define CLIENT_CALLS 200
+
+static DWORD WINAPI
+client_thread(LPVOID arg)
+{
+  int i;
+
+  RpcTryExcept
+  {
+    for (i = 0; i < CLIENT_CALLS; i++)
+      if (int_return() != INT_CODE) break;
+  }
+  RpcExcept(TRUE)
+  {
+    trace("Exception %d\n", RpcExceptionCode());
+    i = 0;
+  }
+  RpcEndExcept
+  ok(i == CLIENT_CALLS, "only %d calls succeeded\n", i);
+  return 0;
+}
+
+/* many clients connected at the same time, each with its own connection */
+static void
+concurrent_clients_test(void)
+{
+  HANDLE threads[CLIENT_THREADS];
+  DWORD start, elapsed;
+  int i;
+
+  start = GetTickCount();
+  for (i = 0; i < CLIENT_THREADS; i++)
+  {
+    threads[i] = CreateThread(NULL, 0, client_thread, NULL, 0, NULL);
+    ok(threads[i] != NULL, "CreateThread failed with error %d\n", GetLastError());
+    if (!threads[i]) break;
+  }
+  while (i--)
+  {
+    ok(WaitForSingleObject(threads[i], 60000) == WAIT_OBJECT_0, "client thread didn't finish\n");
+    CloseHandle(threads[i]);
+  }
+  elapsed = GetTickCount() - start;
+  trace("%d clients made %d calls in %u ms\n", CLIENT_THREADS, CLIENT_THREADS * CLIENT_CALLS, elapsed);
+}
+
 static void
 client(const char *test)
 {
@@ -1254,6 +1301,7 @@ client(const char *test)
     ok(RPC_S_OK == RpcBindingFromStringBinding(binding, &IServer_IfHandle), "RpcBindingFromStringBinding\n");
 
     run_tests();
+    concurrent_clients_test();
     stop();
 
     ok(RPC_S_OK == RpcStringFree(&binding), "RpcStringFree\n");
@@ -30,6 +30,15 @@
 
 #include "tomcrypt.h"
 
+/* AES-NI kernels, used when the CPU supports them */
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && \
+    (defined(__i386__) || defined(__x86_64__))
+#define USE_AESNI
+#include <cpuid.h>
+#include <wmmintrin.h>
+#define AESNI_FUNC __attribute__((target("aes,sse2")))
+#endif
+
 static const ulong32 TE0[256] = {
     0xc66363a5UL, 0xf87c7c84UL, 0xee777799UL, 0xf67b7b8dUL,
     0xfff2f20dUL, 0xd66b6bbdUL, 0xde6f6fb1UL, 0x91c5c554UL,
@@ -934,6 +943,122 @@ static ulong32 setup_mix(ulong32 temp)
           (Te4_0[byte(temp, 3)]);
 }
 
+#ifdef USE_AESNI
+
+static int aesni_supported(void)
+{
+    static int supported = -1;
+    unsigned int eax, ebx, ecx, edx;
+
+    if (supported == -1)
+        supported = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES);
+    return supported;
+}
+
+static inline AESNI_FUNC void aesni_load_keys(__m128i *k, const unsigned char *kb, int Nr)
+{
+    int r;
+
+    for (r = 0; r <= Nr; r++) k[r] = _mm_loadu_si128((const __m128i *)(kb + 16 * r));
+}
+
+static inline AESNI_FUNC __m128i aesni_encrypt(__m128i b, const __m128i *k, int Nr)
+{
+    int r;
+
+    b = _mm_xor_si128(b, k[0]);
+    for (r = 1; r < Nr; r++) b = _mm_aesenc_si128(b, k[r]);
+    return _mm_aesenclast_si128(b, k[Nr]);
+}
+
+static inline AESNI_FUNC __m128i aesni_decrypt(__m128i b, const __m128i *k, int Nr)
+{
+    int r;
+
+    b = _mm_xor_si128(b, k[0]);
+    for (r = 1; r < Nr; r++) b = _mm_aesdec_si128(b, k[r]);
+    return _mm_aesdeclast_si128(b, k[Nr]);
+}
+
+/* The independent blocks of ECB and CBC decryption are processed eight at a
+ * time, so that the latency of the AES instructions is hidden. */
+static AESNI_FUNC void aesni_ecb_crypt(const unsigned char *in, unsigned char *out, unsigned long blocks,
+                                       const aes_key *skey, int enc)
+{
+    __m128i k[15], b[8];
+    int Nr = skey->Nr, r, i;
+
+    aesni_load_keys(k, enc ? skey->eKb : skey->dKb, Nr);
+
+    for (; blocks >= 8; blocks -= 8, in += 128, out += 128) {
+        for (i = 0; i < 8; i++) b[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in + i), k[0]);
+        if (enc) {
+            for (r = 1; r < Nr; r++)
+                for (i = 0; i < 8; i++) b[i] = _mm_aesenc_si128(b[i], k[r]);
+            for (i = 0; i < 8; i++) b[i] = _mm_aesenclast_si128(b[i], k[Nr]);
+        } else {
+            for (r = 1; r < Nr; r++)
+                for (i = 0; i < 8; i++) b[i] = _mm_aesdec_si128(b[i], k[r]);
+            for (i = 0; i < 8; i++) b[i] = _mm_aesdeclast_si128(b[i], k[Nr]);
+        }
+        for (i = 0; i < 8; i++) _mm_storeu_si128((__m128i *)out + i, b[i]);
+    }
+
+    for (; blocks; blocks--, in += 16, out += 16) {
+        b[0] = _mm_loadu_si128((const __m128i *)in);
+        b[0] = enc ? aesni_encrypt(b[0], k, Nr) : aesni_decrypt(b[0], k, Nr);
+        _mm_storeu_si128((__m128i *)out, b[0]);
+    }
+}
+
+static AESNI_FUNC void aesni_cbc_encrypt(const unsigned char *in, unsigned char *out, unsigned long blocks,
+                                         unsigned char *iv, const aes_key *skey)
+{
+    __m128i k[15], c;
+
+    aesni_load_keys(k, skey->eKb, skey->Nr);
+    c = _mm_loadu_si128((const __m128i *)iv);
+    for (; blocks; blocks--, in += 16, out += 16) {
+        c = aesni_encrypt(_mm_xor_si128(c, _mm_loadu_si128((const __m128i *)in)), k, skey->Nr);
+        _mm_storeu_si128((__m128i *)out, c);
+    }
+    _mm_storeu_si128((__m128i *)iv, c);
+}
+
+static AESNI_FUNC void aesni_cbc_decrypt(const unsigned char *in, unsigned char *out, unsigned long blocks,
+                                         unsigned char *iv, const aes_key *skey)
+{
+    __m128i k[15], b[8], c[8], prev;
+    int Nr = skey->Nr, r, i;
+
+    aesni_load_keys(k, skey->dKb, Nr);
+    prev = _mm_loadu_si128((const __m128i *)iv);
+
+    /* all ciphertext blocks are loaded before anything is stored, so in may equal out */
+    for (; blocks >= 8; blocks -= 8, in += 128, out += 128) {
+        for (i = 0; i < 8; i++) {
+            c[i] = _mm_loadu_si128((const __m128i *)in + i);
+            b[i] = _mm_xor_si128(c[i], k[0]);
+        }
+        for (r = 1; r < Nr; r++)
+            for (i = 0; i < 8; i++) b[i] = _mm_aesdec_si128(b[i], k[r]);
+        for (i = 0; i < 8; i++) b[i] = _mm_aesdeclast_si128(b[i], k[Nr]);
+        _mm_storeu_si128((__m128i *)out, _mm_xor_si128(b[0], prev));
+        for (i = 1; i < 8; i++) _mm_storeu_si128((__m128i *)out + i, _mm_xor_si128(b[i], c[i-1]));
+        prev = c[7];
+    }
+
+    for (; blocks; blocks--, in += 16, out += 16) {
+        c[0] = _mm_loadu_si128((const __m128i *)in);
+        b[0] = aesni_decrypt(c[0], k, Nr);
+        _mm_storeu_si128((__m128i *)out, _mm_xor_si128(b[0], prev));
+        prev = c[0];
+    }
+    _mm_storeu_si128((__m128i *)iv, prev);
+}
+
+#endif /* USE_AESNI */
+
 int aes_setup(const unsigned char *key, int keylen, int rounds, aes_key *skey)
 {
     int i, j;
@@ -1058,6 +1183,19 @@ int aes_setup(const unsigned char *key, int keylen, int rounds, aes_key *skey)
     *rk++ = *rrk++;
     *rk   = *rrk;
 
+    /* dK already is the equivalent inverse cipher schedule AESDEC expects,
+     * so both schedules just have to be stored in memory byte order. */
+    skey->aesni = 0;
+#ifdef USE_AESNI
+    if (aesni_supported()) {
+        for (i = 0; i < 4 * (skey->Nr + 1); i++) {
+            STORE32H(skey->eK[i], skey->eKb + 4 * i);
+            STORE32H(skey->dK[i], skey->dKb + 4 * i);
+        }
+        skey->aesni = 1;
+    }
+#endif
+
     return CRYPT_OK;
 }
 
@@ -1066,6 +1204,13 @@ void aes_ecb_encrypt(const unsigned char *pt, unsigned char *ct, aes_key *skey)
     ulong32 s0, s1, s2, s3, t0, t1, t2, t3, *rk;
     int Nr, r;
 
+#ifdef USE_AESNI
+    if (skey->aesni) {
+        aesni_ecb_crypt(pt, ct, 1, skey, 1);
+        return;
+    }
+#endif
+
     Nr = skey->Nr;
     rk = skey->eK;
 
@@ -1167,6 +1312,13 @@ void aes_ecb_decrypt(const unsigned char *ct, unsigned char *pt, aes_key *skey)
     ulong32 s0, s1, s2, s3, t0, t1, t2, t3, *rk;
     int Nr, r;
 
+#ifdef USE_AESNI
+    if (skey->aesni) {
+        aesni_ecb_crypt(ct, pt, 1, skey, 0);
+        return;
+    }
+#endif
+
     Nr = skey->Nr;
     rk = skey->dK;
 
@@ -1264,3 +1416,66 @@ void aes_ecb_decrypt(const unsigned char *ct, unsigned char *pt, aes_key *skey)
         rk[3];
     STORE32H(s3, pt+12);
 }
+
+void aes_ecb_encrypt_blocks(const unsigned char *pt, unsigned char *ct, unsigned long blocks, aes_key *skey)
+{
+#ifdef USE_AESNI
+    if (skey->aesni) {
+        aesni_ecb_crypt(pt, ct, blocks, skey, 1);
+        return;
+    }
+#endif
+    for (; blocks; blocks--, pt += 16, ct += 16)
+        aes_ecb_encrypt(pt, ct, skey);
+}
+
+void aes_ecb_decrypt_blocks(const unsigned char *ct, unsigned char *pt, unsigned long blocks, aes_key *skey)
+{
+#ifdef USE_AESNI
+    if (skey->aesni) {
+        aesni_ecb_crypt(ct, pt, blocks, skey, 0);
+        return;
+    }
+#endif
+    for (; blocks; blocks--, ct += 16, pt += 16)
+        aes_ecb_decrypt(ct, pt, skey);
+}
+
+void aes_cbc_encrypt_blocks(const unsigned char *pt, unsigned char *ct, unsigned long blocks,
+                            unsigned char *iv, aes_key *skey)
+{
+    unsigned char buf[16];
+    int i;
+
+#ifdef USE_AESNI
+    if (skey->aesni) {
+        aesni_cbc_encrypt(pt, ct, blocks, iv, skey);
+        return;
+    }
+#endif
+    for (; blocks; blocks--, pt += 16, ct += 16) {
+        for (i = 0; i < 16; i++) buf[i] = pt[i] ^ iv[i];
+        aes_ecb_encrypt(buf, ct, skey);
+        memcpy(iv, ct, 16);
+    }
+}
+
+void aes_cbc_decrypt_blocks(const unsigned char *ct, unsigned char *pt, unsigned long blocks,
+                            unsigned char *iv, aes_key *skey)
+{
+    unsigned char buf[16], out[16];
+    int i;
+
+#ifdef USE_AESNI
+    if (skey->aesni) {
+        aesni_cbc_decrypt(ct, pt, blocks, iv, skey);
+        return;
+    }
+#endif
+    for (; blocks; blocks--, ct += 16, pt += 16) {
+        memcpy(buf, ct, 16);
+        aes_ecb_decrypt(buf, out, skey);
+        for (i = 0; i < 16; i++) pt[i] = out[i] ^ iv[i];
+        memcpy(iv, buf, 16);
+    }
+}
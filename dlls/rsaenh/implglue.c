@@ -240,6 +240,7 @@ BOOL duplicate_key_impl(ALG_ID aiAlgid, CONST KEY_CONTEXT *pSrcKeyContext,
             mp_init_copy(&pDestKeyContext->rsa.qP, &pSrcKeyContext->rsa.qP);
             mp_init_copy(&pDestKeyContext->rsa.dP, &pSrcKeyContext->rsa.dP);
             mp_init_copy(&pDestKeyContext->rsa.dQ, &pSrcKeyContext->rsa.dQ);
+            rsa_precompute(&pDestKeyContext->rsa);
             break;
         
         default:
@@ -338,6 +339,53 @@ BOOL encrypt_block_impl(ALG_ID aiAlgid, DWORD dwKeySpec, KEY_CONTEXT *pKeyContex
     return TRUE;
 }
 
+/* Encrypts or decrypts dwLen bytes, a multiple of dwBlockLen, in ECB or CBC mode.
+ * pbIn and pbOut may point to the same buffer.  In CBC mode pbChainVector holds
+ * the chaining value and is updated for the next call. */
+BOOL encrypt_blocks_impl(ALG_ID aiAlgid, KEY_CONTEXT *pKeyContext, DWORD dwMode, DWORD dwBlockLen,
+                         BYTE *pbChainVector, CONST BYTE *pbIn, BYTE *pbOut, DWORD dwLen, DWORD enc)
+{
+    BYTE abBlock[16], abOut[16]; /* large enough for all supported block ciphers */
+    DWORD i, j;
+
+    switch (aiAlgid) {
+        case CALG_AES:
+        case CALG_AES_128:
+        case CALG_AES_192:
+        case CALG_AES_256:
+            if (dwMode == CRYPT_MODE_ECB) {
+                if (enc)
+                    aes_ecb_encrypt_blocks(pbIn, pbOut, dwLen / 16, &pKeyContext->aes);
+                else
+                    aes_ecb_decrypt_blocks(pbIn, pbOut, dwLen / 16, &pKeyContext->aes);
+            } else {
+                if (enc)
+                    aes_cbc_encrypt_blocks(pbIn, pbOut, dwLen / 16, pbChainVector, &pKeyContext->aes);
+                else
+                    aes_cbc_decrypt_blocks(pbIn, pbOut, dwLen / 16, pbChainVector, &pKeyContext->aes);
+            }
+            return TRUE;
+    }
+
+    for (i = 0; i + dwBlockLen <= dwLen; i += dwBlockLen, pbIn += dwBlockLen, pbOut += dwBlockLen) {
+        if (dwMode == CRYPT_MODE_CBC && enc) {
+            for (j = 0; j < dwBlockLen; j++) abBlock[j] = pbIn[j] ^ pbChainVector[j];
+            if (!encrypt_block_impl(aiAlgid, 0, pKeyContext, abBlock, abOut, enc)) return FALSE;
+            memcpy(pbChainVector, abOut, dwBlockLen);
+        } else if (dwMode == CRYPT_MODE_CBC) {
+            memcpy(abBlock, pbIn, dwBlockLen);
+            if (!encrypt_block_impl(aiAlgid, 0, pKeyContext, abBlock, abOut, enc)) return FALSE;
+            for (j = 0; j < dwBlockLen; j++) abOut[j] ^= pbChainVector[j];
+            memcpy(pbChainVector, abBlock, dwBlockLen);
+        } else {
+            if (!encrypt_block_impl(aiAlgid, 0, pKeyContext, pbIn, abOut, enc)) return FALSE;
+        }
+        memcpy(pbOut, abOut, dwBlockLen);
+    }
+
+    return TRUE;
+}
+
 BOOL encrypt_stream_impl(ALG_ID aiAlgid, KEY_CONTEXT *pKeyContext, BYTE *stream, DWORD dwLen)
 {
     switch (aiAlgid) {
@@ -378,6 +426,7 @@ BOOL import_public_key_impl(CONST BYTE *pbSrc, KEY_CONTEXT *pKeyContext, DWORD d
         SetLastError(NTE_FAIL);
         return FALSE;
     }
+    pKeyContext->rsa.mont = 0;
 
     pbTemp = HeapAlloc(GetProcessHeap(), 0, dwKeyLen);
     if (!pbTemp) return FALSE;
@@ -388,6 +437,7 @@ BOOL import_public_key_impl(CONST BYTE *pbSrc, KEY_CONTEXT *pKeyContext, DWORD d
     mp_read_unsigned_bin(&pKeyContext->rsa.N, pbTemp, dwKeyLen);
     HeapFree(GetProcessHeap(), 0, pbTemp);
     mp_set_int(&pKeyContext->rsa.e, dwPubExp);
+    rsa_precompute(&pKeyContext->rsa);
 
     return TRUE;    
 }
@@ -432,6 +482,7 @@ BOOL import_private_key_impl(CONST BYTE *pbSrc, KEY_CONTEXT *pKeyContext, DWORD
         SetLastError(NTE_FAIL);
         return FALSE;
     }
+    pKeyContext->rsa.mont = 0;
 
     pbTemp = HeapAlloc(GetProcessHeap(), 0, 2*dwKeyLen+5*((dwKeyLen+1)>>1));
     if (!pbTemp) return FALSE;
@@ -460,6 +511,7 @@ BOOL import_private_key_impl(CONST BYTE *pbSrc, KEY_CONTEXT *pKeyContext, DWORD
     reverse_bytes(pbBigNum, dwKeyLen);
     mp_read_unsigned_bin(&pKeyContext->rsa.d, pbBigNum, dwKeyLen);
     mp_set_int(&pKeyContext->rsa.e, dwPubExp);
+    rsa_precompute(&pKeyContext->rsa);
     
     HeapFree(GetProcessHeap(), 0, pbTemp);
     return TRUE;
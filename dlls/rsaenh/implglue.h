@@ -85,6 +85,8 @@ BOOL duplicate_key_impl(ALG_ID aiAlgid, CONST KEY_CONTEXT *pSrcKeyContext,
 /* dwKeySpec is optional for symmetric key algorithms */
 BOOL encrypt_block_impl(ALG_ID aiAlgid, DWORD dwKeySpec, KEY_CONTEXT *pKeyContext, CONST BYTE *pbIn, BYTE *pbOut, 
                         DWORD enc);
+BOOL encrypt_blocks_impl(ALG_ID aiAlgid, KEY_CONTEXT *pKeyContext, DWORD dwMode, DWORD dwBlockLen,
+                         BYTE *pbChainVector, CONST BYTE *pbIn, BYTE *pbOut, DWORD dwLen, DWORD enc);
 BOOL encrypt_stream_impl(ALG_ID aiAlgid, KEY_CONTEXT *pKeyContext, BYTE *pbInOut, DWORD dwLen);
 
 BOOL export_public_key_impl(BYTE *pbDest, const KEY_CONTEXT *pKeyContext, DWORD dwKeyLen,
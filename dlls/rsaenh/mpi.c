@@ -226,7 +226,7 @@ fast_mp_montgomery_reduce (mp_int * x, const mp_int * n, mp_digit rho)
      * that W[ix-1] have  the carry cleared (see after the inner loop)
      */
     register mp_digit mu;
-    mu = (mp_digit) (((W[ix] & MP_MASK) * rho) & MP_MASK);
+    mu = (((mp_digit) W[ix]) * rho) & MP_MASK;
 
     /* a = a + mu * m * b**i
      *
@@ -1554,46 +1554,30 @@ int mp_exptmod (const mp_int * G, const mp_int * X, mp_int * P, mp_int * Y)
   }
 }
 
-/* computes Y == G**X mod P, HAC pp.616, Algorithm 14.85
- *
- * Uses a left-to-right k-ary sliding window to compute the modular exponentiation.
- * The value of k changes based on the size of the exponent.
- *
- * Uses Montgomery or Diminished Radix reduction [whichever appropriate]
- */
-
-int
-mp_exptmod_fast (const mp_int * G, const mp_int * X, mp_int * P, mp_int * Y, int redmode)
+/* picks the sliding window size for an exponent of x bits */
+static int s_mp_exptmod_winsize(int x)
 {
-  mp_int  M[256], res;
-  mp_digit buf, mp;
-  int     err, bitbuf, bitcpy, bitcnt, mode, digidx, x, y, winsize;
-
-  /* use a pointer to the reduction algorithm.  This allows us to use
-   * one of many reduction algorithms without modding the guts of
-   * the code with if statements everywhere.
-   */
-  int     (*redux)(mp_int*,const mp_int*,mp_digit);
-
-  /* find window size */
-  x = mp_count_bits (X);
   if (x <= 7) {
-    winsize = 2;
+    return 2;
   } else if (x <= 36) {
-    winsize = 3;
+    return 3;
   } else if (x <= 140) {
-    winsize = 4;
+    return 4;
   } else if (x <= 450) {
-    winsize = 5;
+    return 5;
   } else if (x <= 1303) {
-    winsize = 6;
+    return 6;
   } else if (x <= 3529) {
-    winsize = 7;
-  } else {
-    winsize = 8;
+    return 7;
   }
+  return 8;
+}
+
+/* inits M[1] and the upper half of the window table */
+static int s_mp_exptmod_init_table(mp_int *M, int winsize)
+{
+  int err, x, y;
 
-  /* init M array */
   /* init first cell */
   if ((err = mp_init(&M[1])) != MP_OKAY) {
      return err;
@@ -1609,84 +1593,52 @@ mp_exptmod_fast (const mp_int * G, const mp_int * X, mp_int * P, mp_int * Y, int
       return err;
     }
   }
+  return MP_OKAY;
+}
 
-  /* determine and setup reduction code */
-  if (redmode == 0) {
-     /* now setup montgomery  */
-     if ((err = mp_montgomery_setup (P, &mp)) != MP_OKAY) {
-        goto __M;
-     }
-
-     /* automatically pick the comba one if available (saves quite a few calls/ifs) */
-     if (((P->used * 2 + 1) < MP_WARRAY) &&
-          P->used < (1 << ((CHAR_BIT * sizeof (mp_word)) - (2 * DIGIT_BIT)))) {
-        redux = fast_mp_montgomery_reduce;
-     } else {
-        /* use slower baseline Montgomery method */
-        redux = mp_montgomery_reduce;
-     }
-  } else if (redmode == 1) {
-     /* setup DR reduction for moduli of the form B**k - b */
-     mp_dr_setup(P, &mp);
-     redux = mp_dr_reduce;
-  } else {
-     /* setup DR reduction for moduli of the form 2**k - b */
-     if ((err = mp_reduce_2k_setup(P, &mp)) != MP_OKAY) {
-        goto __M;
-     }
-     redux = mp_reduce_2k;
-  }
+static void s_mp_exptmod_clear_table(mp_int *M, int winsize)
+{
+  int x;
 
-  /* setup result */
-  if ((err = mp_init (&res)) != MP_OKAY) {
-    goto __M;
+  mp_clear(&M[1]);
+  for (x = 1<<(winsize-1); x < (1 << winsize); x++) {
+    mp_clear (&M[x]);
   }
+}
 
-  /* create M table
-   *
-
-   *
-   * The first half of the table is not computed though accept for M[0] and M[1]
-   */
-
-  if (redmode == 0) {
-     /* now we need R mod m */
-     if ((err = mp_montgomery_calc_normalization (&res, P)) != MP_OKAY) {
-       goto __RES;
-     }
-
-     /* now set M[1] to G * R mod m */
-     if ((err = mp_mulmod (G, &res, P, &M[1])) != MP_OKAY) {
-       goto __RES;
-     }
-  } else {
-     mp_set(&res, 1);
-     if ((err = mp_mod(G, P, &M[1])) != MP_OKAY) {
-        goto __RES;
-     }
-  }
+/* the k-ary sliding window loop of mp_exptmod_fast and mp_exptmod_mont
+ *
+ * On entry M[1] holds the base and res holds one, both already mapped
+ * into the domain of the reduction.  On exit res holds G**X in that domain.
+ */
+static int s_mp_exptmod_window(const mp_int * X, const mp_int * P, mp_int *M, int winsize,
+                               mp_int *res, int (*redux)(mp_int*,const mp_int*,mp_digit),
+                               mp_digit mp)
+{
+  mp_digit buf;
+  int     err, bitbuf, bitcpy, bitcnt, mode, digidx, x, y;
 
   /* compute the value at M[1<<(winsize-1)] by squaring M[1] (winsize-1) times */
   if ((err = mp_copy (&M[1], &M[1 << (winsize - 1)])) != MP_OKAY) {
-    goto __RES;
+    return err;
   }
 
   for (x = 0; x < (winsize - 1); x++) {
     if ((err = mp_sqr (&M[1 << (winsize - 1)], &M[1 << (winsize - 1)])) != MP_OKAY) {
-      goto __RES;
+      return err;
     }
     if ((err = redux (&M[1 << (winsize - 1)], P, mp)) != MP_OKAY) {
-      goto __RES;
+      return err;
     }
   }
 
   /* create upper table */
   for (x = (1 << (winsize - 1)) + 1; x < (1 << winsize); x++) {
     if ((err = mp_mul (&M[x - 1], &M[1], &M[x])) != MP_OKAY) {
-      goto __RES;
+      return err;
     }
     if ((err = redux (&M[x], P, mp)) != MP_OKAY) {
-      goto __RES;
+      return err;
     }
   }
 
@@ -1725,11 +1677,11 @@ mp_exptmod_fast (const mp_int * G, const mp_int * X, mp_int * P, mp_int * Y, int
 
     /* if the bit is zero and mode == 1 then we square */
     if (mode == 1 && y == 0) {
-      if ((err = mp_sqr (&res, &res)) != MP_OKAY) {
-        goto __RES;
+      if ((err = mp_sqr (res, res)) != MP_OKAY) {
+        return err;
       }
-      if ((err = redux (&res, P, mp)) != MP_OKAY) {
-        goto __RES;
+      if ((err = redux (res, P, mp)) != MP_OKAY) {
+        return err;
       }
       continue;
     }
@@ -1742,20 +1694,20 @@ mp_exptmod_fast (const mp_int * G, const mp_int * X, mp_int * P, mp_int * Y, int
       /* ok window is filled so square as required and multiply  */
       /* square first */
       for (x = 0; x < winsize; x++) {
-        if ((err = mp_sqr (&res, &res)) != MP_OKAY) {
-          goto __RES;
+        if ((err = mp_sqr (res, res)) != MP_OKAY) {
+          return err;
         }
-        if ((err = redux (&res, P, mp)) != MP_OKAY) {
-          goto __RES;
+        if ((err = redux (res, P, mp)) != MP_OKAY) {
+          return err;
         }
       }
 
       /* then multiply */
-      if ((err = mp_mul (&res, &M[bitbuf], &res)) != MP_OKAY) {
-        goto __RES;
+      if ((err = mp_mul (res, &M[bitbuf], res)) != MP_OKAY) {
+        return err;
       }
-      if ((err = redux (&res, P, mp)) != MP_OKAY) {
-        goto __RES;
+      if ((err = redux (res, P, mp)) != MP_OKAY) {
+        return err;
       }
 
       /* empty window and reset */
@@ -1769,27 +1721,119 @@ mp_exptmod_fast (const mp_int * G, const mp_int * X, mp_int * P, mp_int * Y, int
   if (mode == 2 && bitcpy > 0) {
     /* square then multiply if the bit is set */
     for (x = 0; x < bitcpy; x++) {
-      if ((err = mp_sqr (&res, &res)) != MP_OKAY) {
-        goto __RES;
+      if ((err = mp_sqr (res, res)) != MP_OKAY) {
+        return err;
       }
-      if ((err = redux (&res, P, mp)) != MP_OKAY) {
-        goto __RES;
+      if ((err = redux (res, P, mp)) != MP_OKAY) {
+        return err;
       }
 
       /* get next bit of the window */
       bitbuf <<= 1;
       if ((bitbuf & (1 << winsize)) != 0) {
         /* then multiply */
-        if ((err = mp_mul (&res, &M[1], &res)) != MP_OKAY) {
-          goto __RES;
+        if ((err = mp_mul (res, &M[1], res)) != MP_OKAY) {
+          return err;
         }
-        if ((err = redux (&res, P, mp)) != MP_OKAY) {
-          goto __RES;
+        if ((err = redux (res, P, mp)) != MP_OKAY) {
+          return err;
         }
       }
     }
   }
 
+  return MP_OKAY;
+}
+
+/* computes Y == G**X mod P, HAC pp.616, Algorithm 14.85
+ *
+ * Uses a left-to-right k-ary sliding window to compute the modular exponentiation.
+ * The value of k changes based on the size of the exponent.
+ *
+ * Uses Montgomery or Diminished Radix reduction [whichever appropriate]
+ */
+
+int
+mp_exptmod_fast (const mp_int * G, const mp_int * X, mp_int * P, mp_int * Y, int redmode)
+{
+  mp_int  M[256], res;
+  mp_digit mp;
+  int     err, winsize;
+
+  /* use a pointer to the reduction algorithm.  This allows us to use
+   * one of many reduction algorithms without modding the guts of
+   * the code with if statements everywhere.
+   */
+  int     (*redux)(mp_int*,const mp_int*,mp_digit);
+
+  /* find window size */
+  winsize = s_mp_exptmod_winsize (mp_count_bits (X));
+
+  /* init M array */
+  if ((err = s_mp_exptmod_init_table (M, winsize)) != MP_OKAY) {
+    return err;
+  }
+
+  /* determine and setup reduction code */
+  if (redmode == 0) {
+     /* now setup montgomery  */
+     if ((err = mp_montgomery_setup (P, &mp)) != MP_OKAY) {
+        goto __M;
+     }
+
+     /* automatically pick the comba one if available (saves quite a few calls/ifs) */
+     if (((P->used * 2 + 1) < MP_WARRAY) &&
+          P->used < (1 << ((CHAR_BIT * sizeof (mp_word)) - (2 * DIGIT_BIT)))) {
+        redux = fast_mp_montgomery_reduce;
+     } else {
+        /* use slower baseline Montgomery method */
+        redux = mp_montgomery_reduce;
+     }
+  } else if (redmode == 1) {
+     /* setup DR reduction for moduli of the form B**k - b */
+     mp_dr_setup(P, &mp);
+     redux = mp_dr_reduce;
+  } else {
+     /* setup DR reduction for moduli of the form 2**k - b */
+     if ((err = mp_reduce_2k_setup(P, &mp)) != MP_OKAY) {
+        goto __M;
+     }
+     redux = mp_reduce_2k;
+  }
+
+  /* setup result */
+  if ((err = mp_init (&res)) != MP_OKAY) {
+    goto __M;
+  }
+
+  /* create M table
+   *
+
+   *
+   * The first half of the table is not computed though accept for M[0] and M[1]
+   */
+
+  if (redmode == 0) {
+     /* now we need R mod m */
+     if ((err = mp_montgomery_calc_normalization (&res, P)) != MP_OKAY) {
+       goto __RES;
+     }
+
+     /* now set M[1] to G * R mod m */
+     if ((err = mp_mulmod (G, &res, P, &M[1])) != MP_OKAY) {
+       goto __RES;
+     }
+  } else {
+     mp_set(&res, 1);
+     if ((err = mp_mod(G, P, &M[1])) != MP_OKAY) {
+        goto __RES;
+     }
+  }
+
+  if ((err = s_mp_exptmod_window (X, P, M, winsize, &res, redux, mp)) != MP_OKAY) {
+    goto __RES;
+  }
+
   if (redmode == 0) {
      /* fixup result if Montgomery reduction is used
       * recall that any value in a Montgomery system is
@@ -1807,10 +1851,105 @@ mp_exptmod_fast (const mp_int * G, const mp_int * X, mp_int * P, mp_int * Y, int
   err = MP_OKAY;
 __RES:mp_clear (&res);
 __M:
-  mp_clear(&M[1]);
-  for (x = 1<<(winsize-1); x < (1 << winsize); x++) {
-    mp_clear (&M[x]);
+  s_mp_exptmod_clear_table (M, winsize);
+  return err;
+}
+
+/* precomputes rho and R**2 mod P so that exponentiations modulo a fixed
+ * P (e.g. the primes of an RSA key) skip the Montgomery setup and can map
+ * their base into the Montgomery domain without a division.
+ */
+int mp_montgomery_ctx_init(mp_mont_ctx *ctx, const mp_int *P)
+{
+  int err;
+
+  if ((err = mp_montgomery_setup (P, &ctx->rho)) != MP_OKAY) {
+    return err;
+  }
+  if ((err = mp_init (&ctx->rr)) != MP_OKAY) {
+    return err;
+  }
+
+  /* rr = (R mod P)**2 mod P */
+  if ((err = mp_montgomery_calc_normalization (&ctx->rr, P)) != MP_OKAY) {
+    goto __RR;
+  }
+  if ((err = mp_sqrmod (&ctx->rr, (mp_int *)P, &ctx->rr)) != MP_OKAY) {
+    goto __RR;
+  }
+  return MP_OKAY;
+
+__RR:mp_clear (&ctx->rr);
+  return err;
+}
+
+void mp_montgomery_ctx_clear(mp_mont_ctx *ctx)
+{
+  mp_clear (&ctx->rr);
+}
+
+/* computes Y == G**X mod P like mp_exptmod_fast in Montgomery mode, but with
+ * the reduction parameters taken from ctx.  X must be non-negative.
+ */
+int mp_exptmod_mont(const mp_int * G, const mp_int * X, mp_int * P, const mp_mont_ctx *ctx, mp_int * Y)
+{
+  mp_int  M[256], res;
+  int     err, winsize;
+  int     (*redux)(mp_int*,const mp_int*,mp_digit);
+
+  if (X->sign == MP_NEG) {
+    return MP_VAL;
   }
+
+  winsize = s_mp_exptmod_winsize (mp_count_bits (X));
+  if ((err = s_mp_exptmod_init_table (M, winsize)) != MP_OKAY) {
+    return err;
+  }
+
+  if (((P->used * 2 + 1) < MP_WARRAY) &&
+       P->used < (1 << ((CHAR_BIT * sizeof (mp_word)) - (2 * DIGIT_BIT)))) {
+     redux = fast_mp_montgomery_reduce;
+  } else {
+     redux = mp_montgomery_reduce;
+  }
+
+  if ((err = mp_init (&res)) != MP_OKAY) {
+    goto __M;
+  }
+
+  /* res = R mod P, the Montgomery form of one */
+  if ((err = mp_copy (&ctx->rr, &res)) != MP_OKAY) {
+    goto __RES;
+  }
+  if ((err = redux (&res, P, ctx->rho)) != MP_OKAY) {
+    goto __RES;
+  }
+
+  /* M[1] = G * R mod P */
+  if ((err = mp_mod (G, P, &M[1])) != MP_OKAY) {
+    goto __RES;
+  }
+  if ((err = mp_mul (&M[1], &ctx->rr, &M[1])) != MP_OKAY) {
+    goto __RES;
+  }
+  if ((err = redux (&M[1], P, ctx->rho)) != MP_OKAY) {
+    goto __RES;
+  }
+
+  if ((err = s_mp_exptmod_window (X, P, M, winsize, &res, redux, ctx->rho)) != MP_OKAY) {
+    goto __RES;
+  }
+
+  /* leave the Montgomery domain */
+  if ((err = redux (&res, P, ctx->rho)) != MP_OKAY) {
+    goto __RES;
+  }
+
+  mp_exch (&res, Y);
+  err = MP_OKAY;
+__RES:mp_clear (&res);
+__M:
+  s_mp_exptmod_clear_table (M, winsize);
   return err;
 }
 
@@ -2621,7 +2760,7 @@ mp_mod_2d (const mp_int * a, int b, mp_int * c)
     c->dp[x] = 0;
   }
   /* clear the digit that is not completely outside/inside the modulus */
-  c->dp[b / DIGIT_BIT] &= (1 << ((mp_digit)b % DIGIT_BIT)) - 1;
+  c->dp[b / DIGIT_BIT] &= (((mp_digit)1) << ((mp_digit)b % DIGIT_BIT)) - 1;
   mp_clamp (c);
   return MP_OKAY;
 }
@@ -2792,6 +2931,9 @@ mp_montgomery_setup (const mp_int * n, mp_digit * rho)
   x *= 2 - b * x;               /* here x*a==1 mod 2**8 */
   x *= 2 - b * x;               /* here x*a==1 mod 2**16 */
   x *= 2 - b * x;               /* here x*a==1 mod 2**32 */
+#if DIGIT_BIT > 32
+  x *= 2 - b * x;               /* here x*a==1 mod 2**64 */
+#endif
 
   /* rho = -1/m mod b */
   *rho = (((mp_word)1 << ((mp_word) DIGIT_BIT)) - x) & MP_MASK;
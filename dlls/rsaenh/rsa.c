@@ -97,6 +97,7 @@ int rsa_make_key(int size, long e, rsa_key *key)
       return CRYPT_INVALID_ARG;
    }
 
+   key->mont = 0;
    if ((err = mp_init_multi(&p, &q, &tmp1, &tmp2, &tmp3, NULL)) != MP_OKAY) {
       return mpi_to_ltc_error(err);
    }
@@ -156,6 +157,7 @@ int rsa_make_key(int size, long e, rsa_key *key)
 
    /* set key type (in this case it's CRT optimized) */
    key->type = PK_PRIVATE;
+   rsa_precompute(key);
 
    /* return ok and free temps */
    err       = CRYPT_OK;
@@ -170,8 +172,44 @@ done:
    return err;
 }
 
+/* Caches the Montgomery parameters of N (and of p and q for private keys)
+ * in the key, so that the exponentiations done per sign/decrypt operation
+ * don't have to recompute them.  If this fails (e.g. for an even modulus
+ * in a bogus imported key) rsa_exptmod falls back to the generic code.
+ */
+int rsa_precompute(rsa_key *key)
+{
+   int err;
+
+   key->mont = 0;
+   if ((err = mp_montgomery_ctx_init(&key->montN, &key->N)) != MP_OKAY) {
+      return mpi_to_ltc_error(err);
+   }
+   if (key->type == PK_PRIVATE) {
+      if ((err = mp_montgomery_ctx_init(&key->montP, &key->p)) != MP_OKAY) {
+         mp_montgomery_ctx_clear(&key->montN);
+         return mpi_to_ltc_error(err);
+      }
+      if ((err = mp_montgomery_ctx_init(&key->montQ, &key->q)) != MP_OKAY) {
+         mp_montgomery_ctx_clear(&key->montP);
+         mp_montgomery_ctx_clear(&key->montN);
+         return mpi_to_ltc_error(err);
+      }
+   }
+   key->mont = 1;
+   return CRYPT_OK;
+}
+
 void rsa_free(rsa_key *key)
 {
+   if (key->mont) {
+      mp_montgomery_ctx_clear(&key->montN);
+      if (key->type == PK_PRIVATE) {
+         mp_montgomery_ctx_clear(&key->montP);
+         mp_montgomery_ctx_clear(&key->montQ);
+      }
+      key->mont = 0;
+   }
    mp_clear_multi(&key->e, &key->d, &key->N, &key->dQ, &key->dP,
                   &key->qP, &key->p, &key->q, NULL);
 }
@@ -206,12 +244,19 @@ int rsa_exptmod(const unsigned char *in,   unsigned long inlen,
    }
 
    /* are we using the private exponent and is the key optimized? */
-   if (which == PK_PRIVATE) {
+   if (which == PK_PRIVATE && key->mont) {
+      /* tmpa = tmp^dP mod p, tmpb = tmp^dQ mod q with the cached Montgomery parameters */
+      if ((err = mp_exptmod_mont(&tmp, &key->dP, &key->p, &key->montP, &tmpa)) != MP_OKAY) { goto error; }
+      if ((err = mp_exptmod_mont(&tmp, &key->dQ, &key->q, &key->montQ, &tmpb)) != MP_OKAY) { goto error; }
+   } else if (which == PK_PRIVATE) {
       /* tmpa = tmp^dP mod p */
       if ((err = mpi_to_ltc_error(mp_exptmod(&tmp, &key->dP, &key->p, &tmpa))) != MP_OKAY)    { goto error; }
       
       /* tmpb = tmp^dQ mod q */
       if ((err = mpi_to_ltc_error(mp_exptmod(&tmp, &key->dQ, &key->q, &tmpb))) != MP_OKAY)    { goto error; }
+   }
+
+   if (which == PK_PRIVATE) {
 
       /* tmp = (tmpa - tmpb) * qInv (mod p) */
       if ((err = mp_sub(&tmpa, &tmpb, &tmp)) != MP_OKAY)                    { goto error; }
@@ -220,6 +265,8 @@ int rsa_exptmod(const unsigned char *in,   unsigned long inlen,
       /* tmp = tmpb + q * tmp */
       if ((err = mp_mul(&tmp, &key->q, &tmp)) != MP_OKAY)                   { goto error; }
       if ((err = mp_add(&tmp, &tmpb, &tmp)) != MP_OKAY)                     { goto error; }
+   } else if (key->mont) {
+      if ((err = mp_exptmod_mont(&tmp, &key->e, &key->N, &key->montN, &tmp)) != MP_OKAY) { goto error; }
    } else {
       /* exptmod it */
       if ((err = mp_exptmod(&tmp, &key->e, &key->N, &tmp)) != MP_OKAY) { goto error; }
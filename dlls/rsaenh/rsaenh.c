@@ -1996,20 +1996,13 @@ BOOL WINAPI RSAENH_CPEncrypt(HCRYPTPROV hProv, HCRYPTKEY hKey, HCRYPTHASH hHash,
         for (i=*pdwDataLen; i<dwEncryptedLen; i++) pbData[i] = dwEncryptedLen - *pdwDataLen;
         *pdwDataLen = dwEncryptedLen;
 
-        for (i=0, in=pbData; i<*pdwDataLen; i+=pCryptKey->dwBlockLen, in+=pCryptKey->dwBlockLen) {
+        if (pCryptKey->dwMode == CRYPT_MODE_ECB || pCryptKey->dwMode == CRYPT_MODE_CBC) {
+            /* let the implementation process all blocks at once */
+            encrypt_blocks_impl(pCryptKey->aiAlgid, &pCryptKey->context, pCryptKey->dwMode,
+                                pCryptKey->dwBlockLen, pCryptKey->abChainVector, pbData, pbData,
+                                *pdwDataLen, RSAENH_ENCRYPT);
+        } else for (i=0, in=pbData; i<*pdwDataLen; i+=pCryptKey->dwBlockLen, in+=pCryptKey->dwBlockLen) {
             switch (pCryptKey->dwMode) {
-                case CRYPT_MODE_ECB:
-                    encrypt_block_impl(pCryptKey->aiAlgid, 0, &pCryptKey->context, in, out, 
-                                       RSAENH_ENCRYPT);
-                    break;
-                
-                case CRYPT_MODE_CBC:
-                    for (j=0; j<pCryptKey->dwBlockLen; j++) in[j] ^= pCryptKey->abChainVector[j];
-                    encrypt_block_impl(pCryptKey->aiAlgid, 0, &pCryptKey->context, in, out, 
-                                       RSAENH_ENCRYPT);
-                    memcpy(pCryptKey->abChainVector, out, pCryptKey->dwBlockLen);
-                    break;
-
                 case CRYPT_MODE_CFB:
                     for (j=0; j<pCryptKey->dwBlockLen; j++) {
                         encrypt_block_impl(pCryptKey->aiAlgid, 0, &pCryptKey->context, 
@@ -2125,20 +2118,13 @@ BOOL WINAPI RSAENH_CPDecrypt(HCRYPTPROV hProv, HCRYPTKEY hKey, HCRYPTHASH hHash,
     dwMax=*pdwDataLen;
 
     if (GET_ALG_TYPE(pCryptKey->aiAlgid) == ALG_TYPE_BLOCK) {
-        for (i=0, in=pbData; i<*pdwDataLen; i+=pCryptKey->dwBlockLen, in+=pCryptKey->dwBlockLen) {
+        if (pCryptKey->dwMode == CRYPT_MODE_ECB || pCryptKey->dwMode == CRYPT_MODE_CBC) {
+            /* let the implementation process all blocks at once */
+            encrypt_blocks_impl(pCryptKey->aiAlgid, &pCryptKey->context, pCryptKey->dwMode,
+                                pCryptKey->dwBlockLen, pCryptKey->abChainVector, pbData, pbData,
+                                *pdwDataLen, RSAENH_DECRYPT);
+        } else for (i=0, in=pbData; i<*pdwDataLen; i+=pCryptKey->dwBlockLen, in+=pCryptKey->dwBlockLen) {
             switch (pCryptKey->dwMode) {
-                case CRYPT_MODE_ECB:
-                    encrypt_block_impl(pCryptKey->aiAlgid, 0, &pCryptKey->context, in, out, 
-                                       RSAENH_DECRYPT);
-                    break;
-                
-                case CRYPT_MODE_CBC:
-                    encrypt_block_impl(pCryptKey->aiAlgid, 0, &pCryptKey->context, in, out, 
-                                       RSAENH_DECRYPT);
-                    for (j=0; j<pCryptKey->dwBlockLen; j++) out[j] ^= pCryptKey->abChainVector[j];
-                    memcpy(pCryptKey->abChainVector, in, pCryptKey->dwBlockLen);
-                    break;
-
                 case CRYPT_MODE_CFB:
                     for (j=0; j<pCryptKey->dwBlockLen; j++) {
                         encrypt_block_impl(pCryptKey->aiAlgid, 0, &pCryptKey->context, 
@@ -726,6 +726,91 @@ static void test_aes(int keylen)
     ok(result, "%08x\n", GetLastError());
 }
 
+static void test_aes_bulk(void)
+{
+    static const DWORD modes[] = { CRYPT_MODE_ECB, CRYPT_MODE_CBC };
+    const DWORD dwSize = 64 * 1024;
+    const int count = 256;
+    HCRYPTKEY hKey;
+    BYTE *pbPlain, *pbBulk, *pbChunked;
+    DWORD dwLen, dwChunk, dwOffset, dwStart, dwEncTicks, dwDecTicks, i, m;
+    BOOL result;
+    int j;
+
+    result = derive_key(CALG_AES_128, &hKey, 0);
+    if (!result) return;
+
+    pbPlain = HeapAlloc(GetProcessHeap(), 0, dwSize);
+    pbBulk = HeapAlloc(GetProcessHeap(), 0, dwSize + 16);
+    pbChunked = HeapAlloc(GetProcessHeap(), 0, dwSize + 16);
+    for (i = 0; i < dwSize; i++) pbPlain[i] = (BYTE)(i * 7 + (i >> 8));
+
+    for (m = 0; m < sizeof(modes)/sizeof(modes[0]); m++)
+    {
+        result = CryptSetKeyParam(hKey, KP_MODE, (const BYTE *)&modes[m], 0);
+        ok(result, "%08x\n", GetLastError());
+
+        memcpy(pbBulk, pbPlain, dwSize);
+        dwLen = dwSize;
+        result = CryptEncrypt(hKey, 0, TRUE, 0, pbBulk, &dwLen, dwSize + 16);
+        ok(result && dwLen == dwSize + 16, "%08x, dwLen: %d\n", GetLastError(), dwLen);
+
+        /* processing the data in chunks of varying size must give the same result */
+        memcpy(pbChunked, pbPlain, dwSize);
+        for (dwOffset = 0, i = 0; dwOffset < dwSize; dwOffset += dwChunk, i++)
+        {
+            dwChunk = min(16 * (i % 9 + 1), dwSize - dwOffset);
+            dwLen = dwChunk;
+            result = CryptEncrypt(hKey, 0, dwOffset + dwChunk == dwSize, 0, pbChunked + dwOffset,
+                                  &dwLen, dwSize + 16 - dwOffset);
+            if (!result) break;
+        }
+        ok(result, "%08x\n", GetLastError());
+        ok(!memcmp(pbBulk, pbChunked, dwSize + 16), "chunked encryption differs in mode %d\n", modes[m]);
+
+        memcpy(pbChunked, pbBulk, dwSize + 16);
+        for (dwOffset = 0, i = 0; dwOffset < dwSize + 16; dwOffset += dwChunk, i++)
+        {
+            dwChunk = min(16 * (i % 9 + 1), dwSize + 16 - dwOffset);
+            dwLen = dwChunk;
+            result = CryptDecrypt(hKey, 0, dwOffset + dwChunk == dwSize + 16, 0, pbChunked + dwOffset, &dwLen);
+            if (!result) break;
+        }
+        ok(result, "%08x\n", GetLastError());
+        ok(!memcmp(pbChunked, pbPlain, dwSize), "chunked decryption incorrect in mode %d\n", modes[m]);
+
+        dwLen = dwSize + 16;
+        result = CryptDecrypt(hKey, 0, TRUE, 0, pbBulk, &dwLen);
+        ok(result && dwLen == dwSize, "%08x, dwLen: %d\n", GetLastError(), dwLen);
+        ok(!memcmp(pbBulk, pbPlain, dwSize), "decryption incorrect in mode %d\n", modes[m]);
+
+        /* throughput, only in interactive mode so that the normal test run stays fast */
+        if (!winetest_interactive) continue;
+
+        dwEncTicks = dwDecTicks = 0;
+        for (j = 0; j < count; j++)
+        {
+            dwLen = dwSize;
+            dwStart = GetTickCount();
+            result = CryptEncrypt(hKey, 0, TRUE, 0, pbBulk, &dwLen, dwSize + 16);
+            dwEncTicks += GetTickCount() - dwStart;
+            if (!result) break;
+            dwStart = GetTickCount();
+            result = CryptDecrypt(hKey, 0, TRUE, 0, pbBulk, &dwLen);
+            dwDecTicks += GetTickCount() - dwStart;
+            if (!result) break;
+        }
+        ok(result, "%08x\n", GetLastError());
+        trace("AES-128 mode %d: encryption %d MB in %d ms, decryption %d MB in %d ms\n",
+              modes[m], count * dwSize >> 20, dwEncTicks, count * dwSize >> 20, dwDecTicks);
+    }
+
+    HeapFree(GetProcessHeap(), 0, pbPlain);
+    HeapFree(GetProcessHeap(), 0, pbBulk);
+    HeapFree(GetProcessHeap(), 0, pbChunked);
+    CryptDestroyKey(hKey);
+}
+
 static void test_rc2(void)
 {
     static const BYTE rc2encrypted[16] = { 
@@ -1502,6 +1587,74 @@ static void test_rsa_encrypt(void)
     CryptDestroyKey(hRSAKey);
 }
 
+static void test_rsa_sign_speed(void)
+{
+    static const BYTE abData[] = "Wine rocks!";
+    HCRYPTKEY hKey, hPubKey;
+    HCRYPTHASH hHash;
+    BYTE abSignature[256], abPubKey[512];
+    DWORD dwLen, dwPubLen, dwStart, dwSign, dwVerify;
+    BOOL result;
+    int i;
+    const int count = 100;
+
+    if (!winetest_interactive)
+    {
+        skip("timing test, set WINETEST_INTERACTIVE to run it\n");
+        return;
+    }
+
+    result = CryptGenKey(hProv, AT_SIGNATURE, 2048 << 16, &hKey);
+    ok(result, "CryptGenKey failed: %08x\n", GetLastError());
+    if (!result) return;
+
+    dwPubLen = sizeof(abPubKey);
+    result = CryptExportKey(hKey, 0, PUBLICKEYBLOB, 0, abPubKey, &dwPubLen);
+    ok(result, "CryptExportKey failed: %08x\n", GetLastError());
+    result = CryptImportKey(hProv, abPubKey, dwPubLen, 0, 0, &hPubKey);
+    ok(result, "CryptImportKey failed: %08x\n", GetLastError());
+    if (!result)
+    {
+        CryptDestroyKey(hKey);
+        return;
+    }
+
+    dwStart = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        result = CryptCreateHash(hProv, CALG_SHA, 0, 0, &hHash);
+        ok(result, "CryptCreateHash failed: %08x\n", GetLastError());
+        if (!result) break;
+        result = CryptHashData(hHash, abData, sizeof(abData), 0);
+        ok(result, "CryptHashData failed: %08x\n", GetLastError());
+        dwLen = sizeof(abSignature);
+        result = CryptSignHash(hHash, AT_SIGNATURE, NULL, 0, abSignature, &dwLen);
+        ok(result && dwLen == 256, "CryptSignHash failed: %08x, len %d\n", GetLastError(), dwLen);
+        CryptDestroyHash(hHash);
+    }
+    dwSign = GetTickCount() - dwStart;
+
+    dwStart = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        result = CryptCreateHash(hProv, CALG_SHA, 0, 0, &hHash);
+        ok(result, "CryptCreateHash failed: %08x\n", GetLastError());
+        if (!result) break;
+        result = CryptHashData(hHash, abData, sizeof(abData), 0);
+        ok(result, "CryptHashData failed: %08x\n", GetLastError());
+        result = CryptVerifySignature(hHash, abSignature, 256, hPubKey, NULL, 0);
+        ok(result, "CryptVerifySignature failed: %08x\n", GetLastError());
+        CryptDestroyHash(hHash);
+    }
+    dwVerify = GetTickCount() - dwStart;
+
+    trace("%d 2048 bit RSA signatures in %d ms, %d verifications in %d ms\n",
+          count, dwSign, count, dwVerify);
+
+    CryptDestroyKey(hPubKey);
+    CryptDestroyKey(hKey);
+}
+
 static void test_import_export(void)
 {
     DWORD dwLen, dwDataLen;
@@ -1999,6 +2152,7 @@ START_TEST(rsaenh)
     test_rsa_encrypt();
     test_import_export();
     test_enum_container();
+    test_rsa_sign_speed();
     clean_up_base_environment();
     test_schannel_provider();
     test_null_provider();
@@ -2007,5 +2161,6 @@ START_TEST(rsaenh)
     test_aes(128);
     test_aes(192);
     test_aes(256);
+    test_aes_bulk();
     clean_up_aes_environment();
 }
@@ -132,6 +132,8 @@ typedef struct tag_des3_key {
 typedef struct tag_aes_key {
    ulong32 eK[64], dK[64];
    int Nr;
+   int aesni;                          /* use the AES-NI instructions */
+   unsigned char eKb[240], dKb[240];   /* eK and dK in memory byte order for AES-NI */
 } aes_key;
 
 int rc2_setup(const unsigned char *key, int keylen, int bits, int num_rounds, rc2_key *skey);
@@ -149,6 +151,12 @@ void des3_ecb_decrypt(const unsigned char *ct, unsigned char *pt, const des3_key
 int aes_setup(const unsigned char *key, int keylen, int rounds, aes_key *skey);
 void aes_ecb_encrypt(const unsigned char *pt, unsigned char *ct, aes_key *skey);
 void aes_ecb_decrypt(const unsigned char *ct, unsigned char *pt, aes_key *skey);
+void aes_ecb_encrypt_blocks(const unsigned char *pt, unsigned char *ct, unsigned long blocks, aes_key *skey);
+void aes_ecb_decrypt_blocks(const unsigned char *ct, unsigned char *pt, unsigned long blocks, aes_key *skey);
+void aes_cbc_encrypt_blocks(const unsigned char *pt, unsigned char *ct, unsigned long blocks,
+                            unsigned char *iv, aes_key *skey);
+void aes_cbc_decrypt_blocks(const unsigned char *ct, unsigned char *pt, unsigned long blocks,
+                            unsigned char *iv, aes_key *skey);
 
 typedef struct tag_md2_state {
     unsigned char chksum[16], X[48], buf[16];
@@ -181,9 +189,18 @@ unsigned long rc4_read(unsigned char *buf, unsigned long len, prng_state *prng);
  * At the very least a mp_digit must be able to hold 7 bits
  * [any size beyond that is ok provided it doesn't overflow the data type]
  */
+#if defined(__GNUC__) && defined(__x86_64__)
+/* 64-bit limbs with 128-bit double precision products.  Only 60 bits of
+ * each digit are used so that carries fit in the comba column sums.
+ */
+typedef ulong64            mp_digit;
+typedef unsigned long      mp_word __attribute__ ((mode(TI)));
+#define DIGIT_BIT 60
+#else
 typedef unsigned long      mp_digit;
 typedef ulong64            mp_word;
 #define DIGIT_BIT 28
+#endif
    
 #define MP_DIGIT_BIT     DIGIT_BIT
 #define MP_MASK          ((((mp_digit)1)<<((mp_digit)DIGIT_BIT))-((mp_digit)1))
@@ -477,6 +494,21 @@ int mp_reduce_2k(mp_int *a, const mp_int *n, mp_digit d);
 /* d = a**b (mod c) */
 int mp_exptmod(const mp_int *a, const mp_int *b, mp_int *c, mp_int *d);
 
+/* Montgomery parameters of a fixed odd modulus, reusable across exptmods */
+typedef struct {
+    mp_digit rho;   /* -1/m mod b */
+    mp_int   rr;    /* R**2 mod m */
+} mp_mont_ctx;
+
+/* precomputes the Montgomery parameters of the odd modulus b */
+int mp_montgomery_ctx_init(mp_mont_ctx *ctx, const mp_int *b);
+
+/* frees the Montgomery parameters */
+void mp_montgomery_ctx_clear(mp_mont_ctx *ctx);
+
+/* d = a**b (mod c) using the precomputed Montgomery parameters of c */
+int mp_exptmod_mont(const mp_int *a, const mp_int *b, mp_int *c, const mp_mont_ctx *ctx, mp_int *d);
+
 /* ---> Primes <--- */
 
 /* number of primes */
@@ -607,10 +639,14 @@ extern const char *mp_s_rmap;
 typedef struct Rsa_key {
     int type;
     mp_int e, d, N, p, q, qP, dP, dQ;
+    int mont;                        /* montN (and montP, montQ if private) are valid */
+    mp_mont_ctx montN, montP, montQ;
 } rsa_key;
 
 int rsa_make_key(int size, long e, rsa_key *key);
 
+int rsa_precompute(rsa_key *key);
+
 int rsa_exptmod(const unsigned char *in,   unsigned long inlen,
                       unsigned char *out,  unsigned long *outlen, int which,
                       rsa_key *key);
@@ -4767,12 +4767,161 @@ static void test_hwnd_message(void)
     DestroyWindow(hwnd);
 }
 
+static const char foreign_event_name[] = "wine_win_test_foreign_window";
+
+static LRESULT WINAPI foreign_window_procA(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
+{
+    if (msg == WM_DESTROY) PostQuitMessage(0);
+    return DefWindowProcA(hwnd, msg, wparam, lparam);
+}
+
+/* runs in the child process started by test_foreign_window */
+static void foreign_window_child(void)
+{
+    WNDCLASSA cls;
+    HWND hwnd, child;
+    HANDLE event;
+    MSG msg;
+
+    memset(&cls, 0, sizeof(cls));
+    cls.lpfnWndProc = foreign_window_procA;
+    cls.hInstance = GetModuleHandleA(0);
+    cls.lpszClassName = "ForeignWindowClass";
+    if (!RegisterClassA(&cls)) return;
+
+    hwnd = CreateWindowExA(WS_EX_TOOLWINDOW, "ForeignWindowClass", "foreign window",
+                           WS_POPUP | WS_CAPTION, 10, 20, 200, 100, 0, 0, GetModuleHandleA(0), NULL);
+    child = CreateWindowExA(0, "static", "foreign child", WS_CHILD | WS_VISIBLE,
+                            5, 5, 50, 30, hwnd, 0, GetModuleHandleA(0), NULL);
+    ok(hwnd != 0 && child != 0, "failed to create the windows\n");
+
+    event = OpenEventA(EVENT_MODIFY_STATE, FALSE, foreign_event_name);
+    ok(event != 0, "OpenEvent failed with error %u\n", GetLastError());
+    SetEvent(event);
+    CloseHandle(event);
+
+    while (GetMessageA(&msg, 0, 0, 0))
+    {
+        TranslateMessage(&msg);
+        DispatchMessageA(&msg);
+    }
+}
+
+/* windows of other processes are looked up in the window table shared by the server */
+static void test_foreign_window(const char *argv0)
+{
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char cmdline[MAX_PATH];
+    HWND hwnd, child;
+    HANDLE event;
+    DWORD pid, tid, start, elapsed;
+    LONG style;
+    RECT rect;
+    int i;
+
+    event = CreateEventA(NULL, FALSE, FALSE, foreign_event_name);
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+    sprintf(cmdline, "%s win foreign", argv0);
+    if (!CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info))
+    {
+        ok(0, "CreateProcess failed with error %u\n", GetLastError());
+        CloseHandle(event);
+        return;
+    }
+    ok(WaitForSingleObject(event, 10000) == WAIT_OBJECT_0, "child didn't create its windows\n");
+    CloseHandle(event);
+
+    hwnd = FindWindowA("ForeignWindowClass", "foreign window");
+    ok(hwnd != 0, "foreign window not found\n");
+    if (!hwnd)
+    {
+        TerminateProcess(info.hProcess, 1);
+        goto done;
+    }
+    child = FindWindowExA(hwnd, 0, "static", "foreign child");
+    ok(child != 0, "foreign child not found\n");
+
+    ok(IsWindow(hwnd), "IsWindow failed\n");
+    ok(IsWindow((HWND)(ULONG_PTR)LOWORD(hwnd)), "IsWindow failed for the 16-bit handle\n");
+    tid = GetWindowThreadProcessId(hwnd, &pid);
+    ok(tid == info.dwThreadId, "wrong thread %04x, expected %04x\n", tid, info.dwThreadId);
+    ok(pid == info.dwProcessId, "wrong process %04x, expected %04x\n", pid, info.dwProcessId);
+
+    style = GetWindowLongA(hwnd, GWL_STYLE);
+    ok((style & (WS_POPUP | WS_CAPTION)) == (WS_POPUP | WS_CAPTION), "wrong style %08x\n", style);
+    ok(!(style & WS_DISABLED), "window is disabled, style %08x\n", style);
+    style = GetWindowLongA(hwnd, GWL_EXSTYLE);
+    ok(style & WS_EX_TOOLWINDOW, "wrong exstyle %08x\n", style);
+
+    GetWindowRect(hwnd, &rect);
+    ok(rect.left == 10 && rect.top == 20 && rect.right == 210 && rect.bottom == 120,
+       "wrong window rect %d,%d-%d,%d\n", rect.left, rect.top, rect.right, rect.bottom);
+
+    ok(GetParent(child) == hwnd, "wrong parent %p, expected %p\n", GetParent(child), hwnd);
+    if (pGetAncestor)
+        ok(pGetAncestor(child, GA_PARENT) == hwnd, "wrong ancestor %p, expected %p\n",
+           pGetAncestor(child, GA_PARENT), hwnd);
+    GetWindowRect(child, &rect);
+    ok(rect.right - rect.left == 50 && rect.bottom - rect.top == 30,
+       "wrong child rect %d,%d-%d,%d\n", rect.left, rect.top, rect.right, rect.bottom);
+
+    /* changes made by the owner have to be seen straight away */
+    SetWindowPos(hwnd, 0, 30, 40, 100, 50, SWP_NOZORDER | SWP_NOACTIVATE);
+    GetWindowRect(hwnd, &rect);
+    ok(rect.left == 30 && rect.top == 40 && rect.right == 130 && rect.bottom == 90,
+       "wrong window rect %d,%d-%d,%d after SetWindowPos\n", rect.left, rect.top, rect.right, rect.bottom);
+    EnableWindow(hwnd, FALSE);
+    style = GetWindowLongA(hwnd, GWL_STYLE);
+    ok(style & WS_DISABLED, "window isn't disabled, style %08x\n", style);
+    EnableWindow(hwnd, TRUE);
+    style = GetWindowLongA(hwnd, GWL_STYLE);
+    ok(!(style & WS_DISABLED), "window is still disabled, style %08x\n", style);
+
+    /* not a correctness test, traces the cost of looking at a foreign window */
+    if (winetest_interactive)
+    {
+        start = GetTickCount();
+        for (i = 0; i < 10000; i++)
+        {
+            IsWindow(hwnd);
+            GetWindowRect(hwnd, &rect);
+            GetWindowLongA(hwnd, GWL_STYLE);
+            GetParent(child);
+        }
+        elapsed = GetTickCount() - start;
+        trace("%d rounds of foreign window queries in %u ms\n", i, elapsed);
+    }
+
+    SendMessageA(hwnd, WM_CLOSE, 0, 0);
+
+done:
+    winetest_wait_child_process(info.hProcess);
+    CloseHandle(info.hProcess);
+    CloseHandle(info.hThread);
+    if (hwnd)
+    {
+        ok(!IsWindow(hwnd), "foreign window still exists\n");
+        ok(!GetWindowThreadProcessId(hwnd, NULL), "foreign window still has a thread\n");
+    }
+}
+
 START_TEST(win)
 {
+    char **argv;
+    int argc = winetest_get_mainargs( &argv );
+
     pGetAncestor = (void *)GetProcAddress( GetModuleHandleA("user32.dll"), "GetAncestor" );
     pGetWindowInfo = (void *)GetProcAddress( GetModuleHandleA("user32.dll"), "GetWindowInfo" );
     pGetWindowModuleFileNameA = (void *)GetProcAddress( GetModuleHandleA("user32.dll"), "GetWindowModuleFileNameA" );
 
+    if (argc == 3 && !strcmp( argv[2], "foreign" ))
+    {
+        foreign_window_child();
+        return;
+    }
+
     if (!RegisterWindowClasses()) assert(0);
 
     hhook = SetWindowsHookExA(WH_CBT, cbt_hook_proc, 0, GetCurrentThreadId());
@@ -4836,6 +4985,7 @@ START_TEST(win)
     test_gettext();
     test_GetUpdateRect();
     test_Expose();
+    test_foreign_window(argv[0]);
 
     /* add the tests above this line */
     UnhookWindowsHookEx(hhook);
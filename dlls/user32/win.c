@@ -90,6 +90,96 @@ static inline void set_win_data( void *ptr, LONG_PTR val, UINT size )
 
 static void *user_handles[NB_USER_HANDLES];
 
+/* read-only view of the window table published by the server */
+static const struct window_shared *shared_windows;
+static UINT nb_shared_windows;
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+/* x86 doesn't reorder loads, so a compiler barrier is enough to follow the server updates */
+# define USE_SHARED_WINDOW_TABLE
+# define read_barrier() __asm__ __volatile__( "" : : : "memory" )
+#endif
+
+/***********************************************************************
+ *           get_shared_window_table
+ *
+ * Map the shared window table on first use.
+ */
+static const struct window_shared *get_shared_window_table(void)
+{
+    static BOOL failed;
+    HANDLE handle = 0;
+    LARGE_INTEGER offset;
+    SIZE_T size = 0;
+    void *ptr = NULL;
+
+    if (shared_windows || failed) return shared_windows;
+
+    SERVER_START_REQ( get_shared_window_table )
+    {
+        if (!wine_server_call( req ))
+        {
+            handle = reply->handle;
+            size   = reply->size;
+        }
+    }
+    SERVER_END_REQ;
+
+    if (!handle)
+    {
+        failed = TRUE;
+        return NULL;
+    }
+    offset.QuadPart = 0;
+    if (NtMapViewOfSection( handle, GetCurrentProcess(), &ptr, 0, 0, &offset, &size,
+                            ViewShare, 0, PAGE_READONLY ))
+    {
+        WARN( "cannot map the shared window table\n" );
+        failed = TRUE;
+    }
+    else
+    {
+        nb_shared_windows = min( size / sizeof(*shared_windows), NB_USER_HANDLES );
+        if (InterlockedCompareExchangePointer( (void **)&shared_windows, ptr, NULL ))
+            NtUnmapViewOfSection( GetCurrentProcess(), ptr );  /* another thread mapped it first */
+    }
+    CloseHandle( handle );
+    return shared_windows;
+}
+
+/***********************************************************************
+ *           get_shared_window
+ *
+ * Read the state of a window from the shared table, without a server round-trip.
+ * Returns FALSE if the window is not found or is being updated; the caller must
+ * then ask the server.
+ */
+static BOOL get_shared_window( HWND hwnd, struct window_shared *info )
+{
+#ifdef USE_SHARED_WINDOW_TABLE
+    const volatile struct window_shared *entry;
+    WORD index = USER_HANDLE_TO_INDEX(hwnd);
+    unsigned int seq;
+    int retry;
+
+    if (!get_shared_window_table() || index >= nb_shared_windows) return FALSE;
+
+    entry = &shared_windows[index];
+    for (retry = 0; retry < 4; retry++)
+    {
+        if ((seq = entry->seq) & 1) continue;  /* update in progress */
+        read_barrier();
+        *info = *(const struct window_shared *)entry;
+        read_barrier();
+        if (entry->seq != seq) continue;
+
+        if (!info->handle) return FALSE;
+        return (hwnd == info->handle || !HIWORD(hwnd) || HIWORD(hwnd) == 0xffff);
+    }
+#endif
+    return FALSE;
+}
+
 /***********************************************************************
  *           create_window_handle
  *
@@ -485,6 +575,10 @@ HWND WIN_Handle32( HWND16 hwnd16 )
     }
     else  /* may belong to another process */
     {
+        struct window_shared info;
+
+        if (get_shared_window( hwnd, &info )) return info.handle;
+
         SERVER_START_REQ( get_window_info )
         {
             req->handle = hwnd;
@@ -606,6 +700,17 @@ BOOL WIN_GetRectangles( HWND hwnd, RECT *rectWindow, RECT *rectClient )
     }
     else if (win == WND_OTHER_PROCESS)
     {
+        struct window_shared info;
+
+        if (get_shared_window( hwnd, &info ))
+        {
+            if (rectWindow) SetRect( rectWindow, info.window.left, info.window.top,
+                                     info.window.right, info.window.bottom );
+            if (rectClient) SetRect( rectClient, info.client.left, info.client.top,
+                                     info.client.right, info.client.bottom );
+            return TRUE;
+        }
+
         SERVER_START_REQ( get_window_rectangles )
         {
             req->handle = hwnd;
@@ -1850,11 +1955,17 @@ static LONG_PTR WIN_GetWindowLong( HWND hwnd, INT offset, UINT size, BOOL unicod
 
     if (wndPtr == WND_OTHER_PROCESS || wndPtr == WND_DESKTOP)
     {
+        struct window_shared info;
+
         if (offset == GWLP_WNDPROC)
         {
             SetLastError( ERROR_ACCESS_DENIED );
             return 0;
         }
+        if ((offset == GWL_STYLE || offset == GWL_EXSTYLE) && wndPtr == WND_OTHER_PROCESS &&
+            get_shared_window( hwnd, &info ))
+            return (offset == GWL_STYLE) ? info.style : info.ex_style;
+
         SERVER_START_REQ( set_window_info )
         {
             req->handle = hwnd;
@@ -2492,6 +2603,7 @@ INT WINAPI GetWindowTextLengthW( HWND hwnd )
  */
 BOOL WINAPI IsWindow( HWND hwnd )
 {
+    struct window_shared info;
     WND *ptr;
     BOOL ret;
 
@@ -2505,6 +2617,8 @@ BOOL WINAPI IsWindow( HWND hwnd )
     }
 
     /* check other processes */
+    if (get_shared_window( hwnd, &info )) return TRUE;
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = hwnd;
@@ -2520,6 +2634,7 @@ BOOL WINAPI IsWindow( HWND hwnd )
  */
 DWORD WINAPI GetWindowThreadProcessId( HWND hwnd, LPDWORD process )
 {
+    struct window_shared info;
     WND *ptr;
     DWORD tid = 0;
 
@@ -2539,6 +2654,12 @@ DWORD WINAPI GetWindowThreadProcessId( HWND hwnd, LPDWORD process )
     }
 
     /* check other processes */
+    if (ptr == WND_OTHER_PROCESS && get_shared_window( hwnd, &info ))
+    {
+        if (process) *process = info.pid;
+        return info.tid;
+    }
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = hwnd;
@@ -2569,7 +2690,17 @@ HWND WINAPI GetParent( HWND hwnd )
     if (wndPtr == WND_DESKTOP) return 0;
     if (wndPtr == WND_OTHER_PROCESS)
     {
-        LONG style = GetWindowLongW( hwnd, GWL_STYLE );
+        struct window_shared info;
+        LONG style;
+
+        if (get_shared_window( hwnd, &info ))
+        {
+            if (info.style & WS_POPUP) retvalue = info.owner;
+            else if (info.style & WS_CHILD) retvalue = info.parent;
+            return retvalue;
+        }
+
+        style = GetWindowLongW( hwnd, GWL_STYLE );
         if (style & (WS_POPUP | WS_CHILD))
         {
             SERVER_START_REQ( get_window_tree )
@@ -2618,12 +2749,18 @@ HWND WINAPI GetAncestor( HWND hwnd, UINT type )
         }
         else /* need to query the server */
         {
-            SERVER_START_REQ( get_window_tree )
+            struct window_shared info;
+
+            if (get_shared_window( hwnd, &info )) ret = info.parent;
+            else
             {
-                req->handle = hwnd;
-                if (!wine_server_call_err( req )) ret = reply->parent;
+                SERVER_START_REQ( get_window_tree )
+                {
+                    req->handle = hwnd;
+                    if (!wine_server_call_err( req )) ret = reply->parent;
+                }
+                SERVER_END_REQ;
             }
-            SERVER_END_REQ;
         }
         break;
 
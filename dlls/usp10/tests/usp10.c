@@ -833,6 +833,88 @@ static void test_ScriptString(HDC hdc)
      ok(hr == S_OK, "ScriptStringFree should return S_OK not %08x\n", hr);
 }
 
+static void test_ScriptString_repeat(HDC hdc)
+{
+    static const WCHAR teststr[] = {'T','h','e',' ','q','u','i','c','k',' ','b','r','o','w','n',' ',
+                                    'f','o','x',' ','1','2','3',0};
+    int len = sizeof(teststr) / sizeof(WCHAR) - 1;
+    SCRIPT_STRING_ANALYSIS ssa;
+    SCRIPT_CACHE sc = NULL;
+    SCRIPT_ITEM items[8];
+    SCRIPT_VISATTR attrs[2][32];
+    WORD glyphs[2][32];
+    int advances[2][32], widths[2][32];
+    int i, j, nb[2], lines;
+    GOFFSET offsets[32];
+    ABC abc[2], gdi_abc[32], glyph_abc;
+    WORD gdi_glyphs[32], cmap[32];
+    TEXTMETRICW tm;
+    DWORD start;
+    HRESULT hr;
+
+    /* shaping and placing the same run twice must give the same results,
+     * whether or not they come from the font data of the script cache */
+    hr = ScriptItemize(teststr, len, 8, NULL, NULL, items, NULL);
+    ok(hr == S_OK, "ScriptItemize should return S_OK not %08x\n", hr);
+    for (i = 0; i < 2; i++)
+    {
+        hr = ScriptShape(hdc, &sc, teststr, len, 32, &items[0].a, glyphs[i], NULL, attrs[i], &nb[i]);
+        ok(hr == S_OK, "ScriptShape should return S_OK not %08x\n", hr);
+        hr = ScriptPlace(hdc, &sc, glyphs[i], nb[i], attrs[i], &items[0].a, advances[i], offsets, &abc[i]);
+        ok(hr == S_OK, "ScriptPlace should return S_OK not %08x\n", hr);
+    }
+    ok(nb[0] == nb[1], "got %d and %d glyphs\n", nb[0], nb[1]);
+    ok(!memcmp(glyphs[0], glyphs[1], nb[0] * sizeof(WORD)), "glyphs differ\n");
+    ok(!memcmp(advances[0], advances[1], nb[0] * sizeof(int)), "advances differ\n");
+    ok(!memcmp(&abc[0], &abc[1], sizeof(ABC)), "ABC widths differ\n");
+
+    /* and the cached glyph indices and widths must be the ones from GDI */
+    GetTextMetricsW(hdc, &tm);
+    if ((tm.tmPitchAndFamily & TMPF_TRUETYPE) && nb[0] == len)
+    {
+        ok(GetGlyphIndicesW(hdc, teststr, len, gdi_glyphs, 0) == len, "GetGlyphIndicesW failed\n");
+        ok(GetCharABCWidthsI(hdc, 0, len, gdi_glyphs, gdi_abc), "GetCharABCWidthsI failed\n");
+        hr = ScriptGetCMap(hdc, &sc, teststr, len, 0, cmap);
+        ok(hr == S_OK, "ScriptGetCMap should return S_OK not %08x\n", hr);
+        for (j = 0; j < len; j++)
+        {
+            ok(glyphs[1][j] == gdi_glyphs[j], "%d: got glyph %04x, expected %04x\n", j, glyphs[1][j], gdi_glyphs[j]);
+            ok(cmap[j] == gdi_glyphs[j], "%d: got cmap glyph %04x, expected %04x\n", j, cmap[j], gdi_glyphs[j]);
+            ok(advances[1][j] == gdi_abc[j].abcA + gdi_abc[j].abcB + gdi_abc[j].abcC,
+               "%d: got advance %d, expected %d\n", j, advances[1][j],
+               gdi_abc[j].abcA + gdi_abc[j].abcB + gdi_abc[j].abcC);
+            hr = ScriptGetGlyphABCWidth(hdc, &sc, gdi_glyphs[j], &glyph_abc);
+            ok(hr == S_OK, "ScriptGetGlyphABCWidth should return S_OK not %08x\n", hr);
+            ok(!memcmp(&glyph_abc, &gdi_abc[j], sizeof(ABC)), "%d: got ABC %d,%u,%d, expected %d,%u,%d\n", j,
+               glyph_abc.abcA, glyph_abc.abcB, glyph_abc.abcC, gdi_abc[j].abcA, gdi_abc[j].abcB, gdi_abc[j].abcC);
+        }
+    }
+    else skip("not a TrueType font\n");
+    ScriptFreeCache(&sc);
+
+    for (i = 0; i < 2; i++)
+    {
+        hr = ScriptStringAnalyse(hdc, teststr, len, len * 2 + 16, -1, SSA_GLYPHS, 0,
+                                 NULL, NULL, NULL, NULL, NULL, &ssa);
+        ok(hr == S_OK, "ScriptStringAnalyse should return S_OK not %08x\n", hr);
+        if (hr != S_OK) return;
+        hr = ScriptStringGetLogicalWidths(ssa, widths[i]);
+        ok(hr == S_OK, "ScriptStringGetLogicalWidths should return S_OK not %08x\n", hr);
+        ScriptStringFree(&ssa);
+    }
+    for (j = 0; j < len; j++)
+        ok(widths[0][j] == widths[1][j], "%d: got widths %d and %d\n", j, widths[0][j], widths[1][j]);
+
+    start = GetTickCount();
+    for (lines = 0; GetTickCount() - start < 200; lines++)
+    {
+        if (ScriptStringAnalyse(hdc, teststr, len, len * 2 + 16, -1, SSA_GLYPHS, 0,
+                                NULL, NULL, NULL, NULL, NULL, &ssa)) break;
+        ScriptStringFree(&ssa);
+    }
+    trace("analysed %d lines in %u ms\n", lines, GetTickCount() - start);
+}
+
 static void test_ScriptStringXtoCP_CPtoX(HDC hdc)
 {
 /*****************************************************************************************
@@ -1411,6 +1493,7 @@ START_TEST(usp10)
     test_ScriptTextOut2(hdc);
     test_ScriptXtoX();
     test_ScriptString(hdc);
+    test_ScriptString_repeat(hdc);
     test_ScriptStringXtoCP_CPtoX(hdc);
 
     test_ScriptLayout();
@@ -34,6 +34,7 @@
 
 #include "wine/debug.h"
 #include "wine/unicode.h"
+#include "wine/list.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(uniscribe);
 
@@ -138,10 +139,45 @@ static const SCRIPT_PROPERTIES *script_props[] =
     &props[73]
 };
 
+#define GLYPH_BLOCK_SIZE 256
+#define GLYPH_MAX        65536
+#define MAX_CACHED_RUNS  32    /* shaped runs kept per font */
+#define MAX_RUN_LENGTH   256   /* longer runs aren't worth keeping */
+#define MAX_UNUSED_FONTS 8     /* font data kept after the last cache is freed */
+
+/* a run of characters shaped and placed by ScriptStringAnalyse */
+typedef struct {
+    struct list entry;
+    int len;
+    SCRIPT_ANALYSIS sa;
+    int num_glyphs;
+    ABC abc;
+    WCHAR *chars;
+    WORD *glyphs;
+    WORD *pwLogClust;
+    SCRIPT_VISATTR *psva;
+    int *piAdvance;
+} ShapedRun;
+
+/* shaping data of a realized font, shared by all the script caches
+ * created for it; protected by font_data_cs.  The glyph and width blocks
+ * never change once they have been added, see load_cmap() */
+typedef struct {
+    struct list entry;
+    LONG refcount;
+    LOGFONTW lf;
+    TEXTMETRICW tm;
+    WORD *glyphs[GLYPH_MAX / GLYPH_BLOCK_SIZE];  /* char -> glyph index */
+    ABC *widths[GLYPH_MAX / GLYPH_BLOCK_SIZE];   /* glyph index -> ABC widths */
+    struct list runs;                            /* most recently used first */
+    int num_runs;
+} FontData;
+
 typedef struct {
     HDC hdc;
     LOGFONTW lf;
     TEXTMETRICW tm;
+    FontData *font;
 } ScriptCache;
 
 typedef struct {
@@ -207,10 +243,89 @@ static BYTE get_cache_pitch_family(SCRIPT_CACHE *psc)
     return ((ScriptCache *)*psc)->tm.tmPitchAndFamily;
 }
 
+static struct list font_data_list = LIST_INIT(font_data_list);
+
+static CRITICAL_SECTION font_data_cs;
+static CRITICAL_SECTION_DEBUG critsect_debug =
+{
+    0, 0, &font_data_cs,
+    { &critsect_debug.ProcessLocksList, &critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": font_data_cs") }
+};
+static CRITICAL_SECTION font_data_cs = { &critsect_debug, -1, 0, 0, 0, 0 };
+
+static void free_font_data(FontData *font)
+{
+    ShapedRun *run, *next;
+    unsigned int i;
+
+    TRACE("%p\n", font);
+
+    list_remove(&font->entry);
+    LIST_FOR_EACH_ENTRY_SAFE(run, next, &font->runs, ShapedRun, entry)
+        heap_free(run);
+    for (i = 0; i < GLYPH_MAX / GLYPH_BLOCK_SIZE; i++)
+    {
+        heap_free(font->glyphs[i]);
+        heap_free(font->widths[i]);
+    }
+    heap_free(font);
+}
+
+/* fonts are identified by their logical description and their metrics
+ * on the device, so that the same font on another device isn't shared */
+static FontData *grab_font_data(const LOGFONTW *lf, const TEXTMETRICW *tm)
+{
+    FontData *font;
+
+    EnterCriticalSection(&font_data_cs);
+    LIST_FOR_EACH_ENTRY(font, &font_data_list, FontData, entry)
+    {
+        if (memcmp(&font->lf, lf, sizeof(*lf)) || memcmp(&font->tm, tm, sizeof(*tm))) continue;
+        list_remove(&font->entry);
+        list_add_head(&font_data_list, &font->entry);
+        font->refcount++;
+        LeaveCriticalSection(&font_data_cs);
+        return font;
+    }
+    if ((font = heap_alloc_zero(sizeof(*font))))
+    {
+        font->refcount = 1;
+        font->lf = *lf;
+        font->tm = *tm;
+        list_init(&font->runs);
+        list_add_head(&font_data_list, &font->entry);
+        TRACE("new font data %p for %s\n", font, debugstr_w(lf->lfFaceName));
+    }
+    LeaveCriticalSection(&font_data_cs);
+    return font;
+}
+
+static void release_font_data(FontData *font)
+{
+    FontData *cursor, *prev;
+    int unused = 0;
+
+    EnterCriticalSection(&font_data_cs);
+    font->refcount--;
+    /* keep the most recently used fonts around for the next script cache */
+    LIST_FOR_EACH_ENTRY(cursor, &font_data_list, FontData, entry)
+        if (!cursor->refcount) unused++;
+    LIST_FOR_EACH_ENTRY_SAFE_REV(cursor, prev, &font_data_list, FontData, entry)
+    {
+        if (unused <= MAX_UNUSED_FONTS) break;
+        if (cursor->refcount) continue;
+        free_font_data(cursor);
+        unused--;
+    }
+    LeaveCriticalSection(&font_data_cs);
+}
+
 static HRESULT init_script_cache(const HDC hdc, ScriptCache *sc)
 {
     if (!GetTextMetricsW(hdc, &sc->tm)) return E_INVALIDARG;
     if (!GetObjectW(GetCurrentObject(hdc, OBJ_FONT), sizeof(LOGFONTW), &sc->lf)) return E_INVALIDARG;
+    if (!(sc->font = grab_font_data(&sc->lf, &sc->tm))) return E_OUTOFMEMORY;
     sc->hdc = hdc;
     return S_OK;
 }
@@ -251,6 +366,182 @@ static void unselect_cached_font(SCRIPT_CACHE *psc, HFONT old_font)
     DeleteObject(SelectObject(sc->hdc, old_font));
 }
 
+/* adds a block to the font data unless another thread was faster, in
+ * which case the block is freed */
+static void add_block(void **slot, void *block)
+{
+    EnterCriticalSection(&font_data_cs);
+    if (!*slot)
+    {
+        *slot = block;
+        block = NULL;
+    }
+    LeaveCriticalSection(&font_data_cs);
+    heap_free(block);
+}
+
+/* make sure the glyph indices of the given characters are in the font
+ * data, the font is only selected if some have to be retrieved from GDI.
+ * GDI is called without font_data_cs held; once this has returned TRUE
+ * the blocks can be read without the lock, since they never change. */
+static BOOL load_cmap(SCRIPT_CACHE *psc, const WCHAR *chars, int count)
+{
+    ScriptCache *sc = *psc;
+    FontData *font = sc->font;
+    WCHAR block_chars[GLYPH_BLOCK_SIZE];
+    HFONT hfont = NULL;
+    BOOL ret = TRUE, loaded;
+    WORD *block;
+    int i, j;
+
+    EnterCriticalSection(&font_data_cs);
+    for (i = 0; i < count; i++)
+        if (!font->glyphs[chars[i] / GLYPH_BLOCK_SIZE]) break;
+    LeaveCriticalSection(&font_data_cs);
+
+    for (; i < count && ret; i++)
+    {
+        EnterCriticalSection(&font_data_cs);
+        loaded = font->glyphs[chars[i] / GLYPH_BLOCK_SIZE] != NULL;
+        LeaveCriticalSection(&font_data_cs);
+        if (loaded) continue;
+
+        if (!hfont) hfont = select_cached_font(psc);
+        for (j = 0; j < GLYPH_BLOCK_SIZE; j++)
+            block_chars[j] = (chars[i] & ~(GLYPH_BLOCK_SIZE - 1)) + j;
+        if (!(block = heap_alloc(GLYPH_BLOCK_SIZE * sizeof(WORD))) ||
+            GetGlyphIndicesW(sc->hdc, block_chars, GLYPH_BLOCK_SIZE, block, 0) == GDI_ERROR)
+        {
+            heap_free(block);
+            ret = FALSE;
+        }
+        else add_block((void **)&font->glyphs[chars[i] / GLYPH_BLOCK_SIZE], block);
+    }
+    if (hfont) unselect_cached_font(psc, hfont);
+    return ret;
+}
+
+/* same as load_cmap for the ABC widths of glyph indices */
+static BOOL load_widths(SCRIPT_CACHE *psc, const WORD *glyphs, int count)
+{
+    ScriptCache *sc = *psc;
+    FontData *font = sc->font;
+    HFONT hfont = NULL;
+    BOOL ret = TRUE, loaded;
+    ABC *block;
+    int i;
+
+    EnterCriticalSection(&font_data_cs);
+    for (i = 0; i < count; i++)
+        if (!font->widths[glyphs[i] / GLYPH_BLOCK_SIZE]) break;
+    LeaveCriticalSection(&font_data_cs);
+
+    for (; i < count && ret; i++)
+    {
+        EnterCriticalSection(&font_data_cs);
+        loaded = font->widths[glyphs[i] / GLYPH_BLOCK_SIZE] != NULL;
+        LeaveCriticalSection(&font_data_cs);
+        if (loaded) continue;
+
+        if (!hfont) hfont = select_cached_font(psc);
+        if (!(block = heap_alloc(GLYPH_BLOCK_SIZE * sizeof(ABC))) ||
+            !GetCharABCWidthsI(sc->hdc, glyphs[i] & ~(GLYPH_BLOCK_SIZE - 1), GLYPH_BLOCK_SIZE,
+                               NULL, block))
+        {
+            heap_free(block);
+            ret = FALSE;
+        }
+        else add_block((void **)&font->widths[glyphs[i] / GLYPH_BLOCK_SIZE], block);
+    }
+    if (hfont) unselect_cached_font(psc, hfont);
+    return ret;
+}
+
+static inline WORD get_cached_glyph(const FontData *font, WCHAR ch)
+{
+    return font->glyphs[ch / GLYPH_BLOCK_SIZE][ch % GLYPH_BLOCK_SIZE];
+}
+
+static inline const ABC *get_cached_abc(const FontData *font, WORD glyph)
+{
+    return &font->widths[glyph / GLYPH_BLOCK_SIZE][glyph % GLYPH_BLOCK_SIZE];
+}
+
+/* look for a run shaped and placed earlier with the same font, and copy
+ * its results to the given arrays */
+static BOOL get_shaped_run(SCRIPT_CACHE *psc, const WCHAR *chars, int len, const SCRIPT_ANALYSIS *sa,
+                           WORD *glyphs, WORD *pwLogClust, SCRIPT_VISATTR *psva, int *piAdvance,
+                           GOFFSET *pGoffset, ABC *abc, int *num_glyphs)
+{
+    FontData *font = ((ScriptCache *)*psc)->font;
+    ShapedRun *run;
+    int i;
+
+    EnterCriticalSection(&font_data_cs);
+    LIST_FOR_EACH_ENTRY(run, &font->runs, ShapedRun, entry)
+    {
+        if (run->len != len || memcmp(&run->sa, sa, sizeof(*sa)) ||
+            memcmp(run->chars, chars, len * sizeof(WCHAR))) continue;
+
+        memcpy(glyphs, run->glyphs, run->num_glyphs * sizeof(WORD));
+        memcpy(pwLogClust, run->pwLogClust, len * sizeof(WORD));
+        memcpy(psva, run->psva, run->num_glyphs * sizeof(SCRIPT_VISATTR));
+        memcpy(piAdvance, run->piAdvance, run->num_glyphs * sizeof(int));
+        for (i = 0; i < run->num_glyphs; i++) pGoffset[i].du = pGoffset[i].dv = 0;
+        *abc = run->abc;
+        *num_glyphs = run->num_glyphs;
+        list_remove(&run->entry);
+        list_add_head(&font->runs, &run->entry);
+        LeaveCriticalSection(&font_data_cs);
+        return TRUE;
+    }
+    LeaveCriticalSection(&font_data_cs);
+    return FALSE;
+}
+
+static void add_shaped_run(SCRIPT_CACHE *psc, const WCHAR *chars, int len, const SCRIPT_ANALYSIS *sa,
+                           const WORD *glyphs, const WORD *pwLogClust, const SCRIPT_VISATTR *psva,
+                           const int *piAdvance, const ABC *abc, int num_glyphs)
+{
+    FontData *font = ((ScriptCache *)*psc)->font;
+    ShapedRun *run;
+    char *ptr;
+
+    if (len > MAX_RUN_LENGTH) return;
+    if (!(run = heap_alloc(sizeof(*run) + len * (sizeof(WCHAR) + sizeof(WORD)) +
+                           num_glyphs * (sizeof(WORD) + sizeof(int) + sizeof(SCRIPT_VISATTR)))))
+        return;
+
+    /* the ints go first to keep them aligned */
+    ptr = (char *)(run + 1);
+    run->piAdvance = (int *)ptr;            ptr += num_glyphs * sizeof(int);
+    run->psva = (SCRIPT_VISATTR *)ptr;      ptr += num_glyphs * sizeof(SCRIPT_VISATTR);
+    run->chars = (WCHAR *)ptr;              ptr += len * sizeof(WCHAR);
+    run->pwLogClust = (WORD *)ptr;          ptr += len * sizeof(WORD);
+    run->glyphs = (WORD *)ptr;
+
+    run->len = len;
+    run->sa = *sa;
+    run->num_glyphs = num_glyphs;
+    run->abc = *abc;
+    memcpy(run->piAdvance, piAdvance, num_glyphs * sizeof(int));
+    memcpy(run->psva, psva, num_glyphs * sizeof(SCRIPT_VISATTR));
+    memcpy(run->chars, chars, len * sizeof(WCHAR));
+    memcpy(run->pwLogClust, pwLogClust, len * sizeof(WORD));
+    memcpy(run->glyphs, glyphs, num_glyphs * sizeof(WORD));
+
+    EnterCriticalSection(&font_data_cs);
+    list_add_head(&font->runs, &run->entry);
+    if (++font->num_runs > MAX_CACHED_RUNS)
+    {
+        ShapedRun *last = LIST_ENTRY(list_tail(&font->runs), ShapedRun, entry);
+        list_remove(&last->entry);
+        heap_free(last);
+        font->num_runs--;
+    }
+    LeaveCriticalSection(&font_data_cs);
+}
+
 /***********************************************************************
  *      DllMain
  *
@@ -286,7 +577,10 @@ HRESULT WINAPI ScriptFreeCache(SCRIPT_CACHE *psc)
 
     if (psc)
     {
-       heap_free(*psc);
+       ScriptCache *sc = *psc;
+
+       if (sc) release_font_data(sc->font);
+       heap_free(sc);
        *psc = NULL;
     }
     return S_OK;
@@ -643,18 +937,30 @@ HRESULT WINAPI ScriptStringAnalyse(HDC hdc, const void *pString, int cString,
         WORD *glyphs = heap_alloc_zero(sizeof(WORD) * numGlyphs);
         WORD *pwLogClust = heap_alloc_zero(sizeof(WORD) * cChar);
         int *piAdvance = heap_alloc_zero(sizeof(int) * numGlyphs);
-        SCRIPT_VISATTR *psva = heap_alloc_zero(sizeof(SCRIPT_VISATTR) * cChar);
+        SCRIPT_VISATTR *psva = heap_alloc_zero(sizeof(SCRIPT_VISATTR) * numGlyphs);
         GOFFSET *pGoffset = heap_alloc_zero(sizeof(GOFFSET) * numGlyphs);
         ABC *abc = heap_alloc_zero(sizeof(ABC));
         int numGlyphsReturned;
 
         /* FIXME: non unicode strings */
         WCHAR* pStr = (WCHAR*)pString;
-        hr = ScriptShape(hdc, sc, &pStr[analysis->pItem[i].iCharPos],
-                         cChar, numGlyphs, &analysis->pItem[i].a,
-                         glyphs, pwLogClust, psva, &numGlyphsReturned);
-        hr = ScriptPlace(hdc, sc, glyphs, numGlyphsReturned, psva, &analysis->pItem[i].a,
-                         piAdvance, pGoffset, abc);
+
+        /* lines are often laid out again with the same font, so reuse the
+         * glyphs and advances of runs that were shaped before */
+        if (get_script_cache(hdc, sc) ||
+            !get_shaped_run(sc, &pStr[analysis->pItem[i].iCharPos], cChar, &analysis->pItem[i].a,
+                            glyphs, pwLogClust, psva, piAdvance, pGoffset, abc, &numGlyphsReturned))
+        {
+            hr = ScriptShape(hdc, sc, &pStr[analysis->pItem[i].iCharPos],
+                             cChar, numGlyphs, &analysis->pItem[i].a,
+                             glyphs, pwLogClust, psva, &numGlyphsReturned);
+            if (hr == S_OK)
+                hr = ScriptPlace(hdc, sc, glyphs, numGlyphsReturned, psva, &analysis->pItem[i].a,
+                                 piAdvance, pGoffset, abc);
+            if (hr == S_OK)
+                add_shaped_run(sc, &pStr[analysis->pItem[i].iCharPos], cChar, &analysis->pItem[i].a,
+                               glyphs, pwLogClust, psva, piAdvance, abc, numGlyphsReturned);
+        }
 
         analysis->glyphs[i].numGlyphs = numGlyphsReturned;
         analysis->glyphs[i].glyphs = glyphs;
@@ -672,7 +978,7 @@ error:
     heap_free(analysis->glyphs);
     heap_free(analysis->logattrs);
     heap_free(analysis->pItem);
-    heap_free(analysis->sc);
+    ScriptFreeCache((SCRIPT_CACHE *)&analysis->sc);
     heap_free(analysis);
     return hr;
 }
@@ -900,7 +1206,7 @@ HRESULT WINAPI ScriptStringFree(SCRIPT_STRING_ANALYSIS *pssa)
     heap_free(analysis->pItem);
     heap_free(analysis->logattrs);
     heap_free(analysis->sz);
-    heap_free(analysis->sc);
+    ScriptFreeCache((SCRIPT_CACHE *)&analysis->sc);
     heap_free(analysis);
 
     if (invalid) return E_INVALIDARG;
@@ -1252,11 +1558,20 @@ HRESULT WINAPI ScriptShape(HDC hdc, SCRIPT_CACHE *psc, const WCHAR *pwcChars,
 
     *pcGlyphs = cChars;
 
-    hfont = select_cached_font(psc);
-
     if ((get_cache_pitch_family(psc) & TMPF_TRUETYPE) && !psa->fNoGlyphIndex)
     {
-        GetGlyphIndicesW(get_cache_hdc(psc), pwcChars, cChars, pwOutGlyphs, 0);
+        FontData *font = ((ScriptCache *)*psc)->font;
+
+        if (load_cmap(psc, pwcChars, cChars))
+        {
+            for (cnt = 0; cnt < cChars; cnt++) pwOutGlyphs[cnt] = get_cached_glyph(font, pwcChars[cnt]);
+        }
+        else
+        {
+            hfont = select_cached_font(psc);
+            GetGlyphIndicesW(get_cache_hdc(psc), pwcChars, cChars, pwOutGlyphs, 0);
+            unselect_cached_font(psc, hfont);
+        }
     }
     else
     {
@@ -1278,7 +1593,6 @@ HRESULT WINAPI ScriptShape(HDC hdc, SCRIPT_CACHE *psc, const WCHAR *pwcChars,
             if (pwLogClust) pwLogClust[cnt] = cnt;
         }
     }
-    unselect_cached_font(psc, hfont);
     return S_OK;
 }
 
@@ -1317,8 +1631,6 @@ HRESULT WINAPI ScriptPlace(HDC hdc, SCRIPT_CACHE *psc, const WORD *pwGlyphs,
     if (!psva) return E_INVALIDARG;
     if ((hr = get_script_cache(hdc, psc))) return hr;
 
-    hfont = select_cached_font(psc);
-
     /*   Here we need to calculate the width of the run unit.  At this point the input string
      *   has been converted to glyphs and we still need to translate back to the original chars
      *   to get the correct ABC widths.   */
@@ -1328,16 +1640,30 @@ HRESULT WINAPI ScriptPlace(HDC hdc, SCRIPT_CACHE *psc, const WORD *pwGlyphs,
 
     if ((get_cache_pitch_family(psc) & TMPF_TRUETYPE) && !psa->fNoGlyphIndex)
     {
-        GetCharABCWidthsI(get_cache_hdc(psc), 0, cGlyphs, (WORD *)pwGlyphs, lpABC);
+        FontData *font = ((ScriptCache *)*psc)->font;
+
+        if (load_widths(psc, pwGlyphs, cGlyphs))
+        {
+            for (i = 0; i < cGlyphs; i++) lpABC[i] = *get_cached_abc(font, pwGlyphs[i]);
+        }
+        else
+        {
+            hfont = select_cached_font(psc);
+            GetCharABCWidthsI(get_cache_hdc(psc), 0, cGlyphs, (WORD *)pwGlyphs, lpABC);
+            unselect_cached_font(psc, hfont);
+        }
     }
     else
     {
         INT width;
+
+        hfont = select_cached_font(psc);
         for (i = 0; i < cGlyphs; i++)
         {
             GetCharWidth32W(get_cache_hdc(psc), pwGlyphs[i], pwGlyphs[i], &width);
             lpABC[i].abcB = width;
         }
+        unselect_cached_font(psc, hfont);
     }
 
     for (i = 0; i < cGlyphs; i++)
@@ -1358,7 +1684,6 @@ HRESULT WINAPI ScriptPlace(HDC hdc, SCRIPT_CACHE *psc, const WORD *pwGlyphs,
     if (pABC) TRACE("Total for run: abcA=%d, abcB=%d, abcC=%d\n", pABC->abcA, pABC->abcB, pABC->abcC);
 
     heap_free(lpABC);
-    unselect_cached_font(psc, hfont);
     return S_OK;
 }
 
@@ -1390,11 +1715,20 @@ HRESULT WINAPI ScriptGetCMap(HDC hdc, SCRIPT_CACHE *psc, const WCHAR *pwcInChars
 
     if ((hr = get_script_cache(hdc, psc))) return hr;
 
-    hfont = select_cached_font(psc);
-    if (GetGlyphIndicesW(get_cache_hdc(psc), pwcInChars, cChars, pwOutGlyphs, 0) == GDI_ERROR)
-        hr = S_FALSE;
+    if (load_cmap(psc, pwcInChars, cChars))
+    {
+        FontData *font = ((ScriptCache *)*psc)->font;
+        int i;
 
-    unselect_cached_font(psc, hfont);
+        for (i = 0; i < cChars; i++) pwOutGlyphs[i] = get_cached_glyph(font, pwcInChars[i]);
+    }
+    else
+    {
+        hfont = select_cached_font(psc);
+        if (GetGlyphIndicesW(get_cache_hdc(psc), pwcInChars, cChars, pwOutGlyphs, 0) == GDI_ERROR)
+            hr = S_FALSE;
+        unselect_cached_font(psc, hfont);
+    }
     return hr;
 }
 
@@ -1477,10 +1811,14 @@ HRESULT WINAPI ScriptGetGlyphABCWidth(HDC hdc, SCRIPT_CACHE *psc, WORD glyph, AB
 
     if ((hr = get_script_cache(hdc, psc))) return hr;
 
-    hfont = select_cached_font(psc);
-    if (!GetCharABCWidthsI(get_cache_hdc(psc), 0, 1, &glyph, abc)) hr = E_HANDLE;
-
-    unselect_cached_font(psc, hfont);
+    if (load_widths(psc, &glyph, 1))
+        *abc = *get_cached_abc(((ScriptCache *)*psc)->font, glyph);
+    else
+    {
+        hfont = select_cached_font(psc);
+        if (!GetCharABCWidthsI(get_cache_hdc(psc), 0, 1, &glyph, abc)) hr = E_HANDLE;
+        unselect_cached_font(psc, hfont);
+    }
     return hr;
 }
 
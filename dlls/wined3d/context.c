@@ -55,6 +55,62 @@ static void Context_MarkStateDirty(WineD3DContext *context, DWORD state, const s
     context->isStateDirty[idx] |= (1 << shift);
 }
 
+/* Maps a GL capability to its slot in the cap_state shadow, -1 if it isn't shadowed */
+static int context_cap_slot(GLenum cap) {
+    switch(cap) {
+        case GL_LIGHTING:               return 0;
+        case GL_DEPTH_TEST:             return 1;
+        case GL_CULL_FACE:              return 2;
+        case GL_DITHER:                 return 3;
+        case GL_BLEND:                  return 4;
+        case GL_LINE_SMOOTH:            return 5;
+        case GL_ALPHA_TEST:             return 6;
+        case GL_DEPTH_CLAMP_NV:         return 7;
+        case GL_COLOR_SUM_EXT:          return 8;
+        case GL_STENCIL_TEST:           return 9;
+        case GL_FOG:                    return 10;
+        case GL_COLOR_MATERIAL:         return 11;
+        case GL_LINE_STIPPLE:           return 12;
+        case GL_POLYGON_OFFSET_FILL:    return 13;
+        case GL_POLYGON_OFFSET_LINE:    return 14;
+        case GL_POLYGON_OFFSET_POINT:   return 15;
+        case GL_NORMALIZE:              return 16;
+        case GL_POINT_SPRITE_ARB:       return 17;
+        case GL_MULTISAMPLE_ARB:        return 18;
+        case GL_SCISSOR_TEST:           return 19;
+        case GL_VERTEX_BLEND_ARB:       return 20;
+    }
+    if(cap >= GL_LIGHT0 && cap < GL_LIGHT0 + MAX_ACTIVE_LIGHTS) return CAP_SLOT_LIGHT0 + cap - GL_LIGHT0;
+    if(cap >= GL_CLIP_PLANE0 && cap < GL_CLIP_PLANE0 + MAX_CLIPPLANES) return CAP_SLOT_CLIP_PLANE0 + cap - GL_CLIP_PLANE0;
+    return -1;
+}
+
+/*****************************************************************************
+ * context_set_cap
+ *
+ * glEnable / glDisable for the state table. The call is skipped if the
+ * context's shadow says that the capability is already in the requested
+ * state. Must be called with the context active and inside ENTER_GL, the
+ * caller checks for GL errors.
+ *
+ *****************************************************************************/
+void context_set_cap(WineD3DContext *context, GLenum cap, BOOL enable) {
+    BYTE state = enable ? CAP_ENABLED : CAP_DISABLED;
+    int slot = context_cap_slot(cap);
+
+    if(slot >= 0) {
+        if(context->cap_state[slot] == state) {
+            context->gl_calls_skipped++;
+            return;
+        }
+        context->cap_state[slot] = state;
+    }
+    context->gl_calls++;
+
+    if(enable) glEnable(cap);
+    else glDisable(cap);
+}
+
 /*****************************************************************************
  * AddContextToArray
  *
@@ -706,32 +762,32 @@ static inline void SetupForBlit(IWineD3DDeviceImpl *This, WineD3DContext *contex
     Context_MarkStateDirty(context, STATE_TEXTURESTAGE(0, WINED3DTSS_COLOROP), StateTable);
 
     /* Other misc states */
-    glDisable(GL_ALPHA_TEST);
+    context_set_cap(context, GL_ALPHA_TEST, FALSE);
     checkGLcall("glDisable(GL_ALPHA_TEST)");
     Context_MarkStateDirty(context, STATE_RENDER(WINED3DRS_ALPHATESTENABLE), StateTable);
-    glDisable(GL_LIGHTING);
+    context_set_cap(context, GL_LIGHTING, FALSE);
     checkGLcall("glDisable GL_LIGHTING");
     Context_MarkStateDirty(context, STATE_RENDER(WINED3DRS_LIGHTING), StateTable);
-    glDisable(GL_DEPTH_TEST);
+    context_set_cap(context, GL_DEPTH_TEST, FALSE);
     checkGLcall("glDisable GL_DEPTH_TEST");
     Context_MarkStateDirty(context, STATE_RENDER(WINED3DRS_ZENABLE), StateTable);
-    glDisable(GL_FOG);
+    context_set_cap(context, GL_FOG, FALSE);
     checkGLcall("glDisable GL_FOG");
     Context_MarkStateDirty(context, STATE_RENDER(WINED3DRS_FOGENABLE), StateTable);
-    glDisable(GL_BLEND);
+    context_set_cap(context, GL_BLEND, FALSE);
     checkGLcall("glDisable GL_BLEND");
     Context_MarkStateDirty(context, STATE_RENDER(WINED3DRS_ALPHABLENDENABLE), StateTable);
-    glDisable(GL_CULL_FACE);
+    context_set_cap(context, GL_CULL_FACE, FALSE);
     checkGLcall("glDisable GL_CULL_FACE");
     Context_MarkStateDirty(context, STATE_RENDER(WINED3DRS_CULLMODE), StateTable);
-    glDisable(GL_STENCIL_TEST);
+    context_set_cap(context, GL_STENCIL_TEST, FALSE);
     checkGLcall("glDisable GL_STENCIL_TEST");
     Context_MarkStateDirty(context, STATE_RENDER(WINED3DRS_STENCILENABLE), StateTable);
-    glDisable(GL_SCISSOR_TEST);
+    context_set_cap(context, GL_SCISSOR_TEST, FALSE);
     checkGLcall("glDisable GL_SCISSOR_TEST");
     Context_MarkStateDirty(context, STATE_RENDER(WINED3DRS_SCISSORTESTENABLE), StateTable);
     if(GL_SUPPORT(ARB_POINT_SPRITE)) {
-        glDisable(GL_POINT_SPRITE_ARB);
+        context_set_cap(context, GL_POINT_SPRITE_ARB, FALSE);
         checkGLcall("glDisable GL_POINT_SPRITE_ARB");
         Context_MarkStateDirty(context, STATE_RENDER(WINED3DRS_POINTSPRITEENABLE), StateTable);
     }
@@ -739,7 +795,7 @@ static inline void SetupForBlit(IWineD3DDeviceImpl *This, WineD3DContext *contex
     checkGLcall("glColorMask");
     Context_MarkStateDirty(context, STATE_RENDER(WINED3DRS_CLIPPING), StateTable);
     if (GL_SUPPORT(EXT_SECONDARY_COLOR)) {
-        glDisable(GL_COLOR_SUM_EXT);
+        context_set_cap(context, GL_COLOR_SUM_EXT, FALSE);
         Context_MarkStateDirty(context, STATE_RENDER(WINED3DRS_SPECULARENABLE), StateTable);
         checkGLcall("glDisable(GL_COLOR_SUM_EXT)");
     }
@@ -767,12 +823,12 @@ static inline void SetupForBlit(IWineD3DDeviceImpl *This, WineD3DContext *contex
     context->last_was_rhw = TRUE;
     Context_MarkStateDirty(context, STATE_VDECL, StateTable); /* because of last_was_rhw = TRUE */
 
-    glDisable(GL_CLIP_PLANE0); checkGLcall("glDisable(clip plane 0)");
-    glDisable(GL_CLIP_PLANE1); checkGLcall("glDisable(clip plane 1)");
-    glDisable(GL_CLIP_PLANE2); checkGLcall("glDisable(clip plane 2)");
-    glDisable(GL_CLIP_PLANE3); checkGLcall("glDisable(clip plane 3)");
-    glDisable(GL_CLIP_PLANE4); checkGLcall("glDisable(clip plane 4)");
-    glDisable(GL_CLIP_PLANE5); checkGLcall("glDisable(clip plane 5)");
+    context_set_cap(context, GL_CLIP_PLANE0, FALSE); checkGLcall("glDisable(clip plane 0)");
+    context_set_cap(context, GL_CLIP_PLANE1, FALSE); checkGLcall("glDisable(clip plane 1)");
+    context_set_cap(context, GL_CLIP_PLANE2, FALSE); checkGLcall("glDisable(clip plane 2)");
+    context_set_cap(context, GL_CLIP_PLANE3, FALSE); checkGLcall("glDisable(clip plane 3)");
+    context_set_cap(context, GL_CLIP_PLANE4, FALSE); checkGLcall("glDisable(clip plane 4)");
+    context_set_cap(context, GL_CLIP_PLANE5, FALSE); checkGLcall("glDisable(clip plane 5)");
     Context_MarkStateDirty(context, STATE_RENDER(WINED3DRS_CLIPPING), StateTable);
 
     glViewport(0, 0, width, height);
@@ -1027,6 +1083,13 @@ void ActivateContext(IWineD3DDeviceImpl *This, IWineD3DSurface *target, ContextU
     const struct StateEntry       *StateTable = This->shader_backend->StateTable;
 
     TRACE("(%p): Selecting context for render target %p, thread %d\n", This, target, tid);
+    if(This->cs && This->cs->thread_id != tid) {
+        /* GL work outside the command stream. Let the worker finish what it has queued, and
+         * flush this thread's context before the worker draws again
+         */
+        wined3d_cs_finish(This->cs);
+        This->cs->app_gl_dirty = TRUE;
+    }
     if(This->lastActiveRenderTarget != target || tid != This->lastThread) {
         context = FindContext(This, target, tid, &drawBuffer);
         This->lastActiveRenderTarget = target;
@@ -1090,10 +1153,10 @@ void ActivateContext(IWineD3DDeviceImpl *This, IWineD3DSurface *target, ContextU
             /* Blending and clearing should be orthogonal, but tests on the nvidia driver show that disabling
              * blending when clearing improves the clearing performance incredibly.
              */
-            glDisable(GL_BLEND);
+            context_set_cap(context, GL_BLEND, FALSE);
             Context_MarkStateDirty(context, STATE_RENDER(WINED3DRS_ALPHABLENDENABLE), StateTable);
 
-            glEnable(GL_SCISSOR_TEST);
+            context_set_cap(context, GL_SCISSOR_TEST, TRUE);
             checkGLcall("glEnable GL_SCISSOR_TEST");
             context->last_was_blit = FALSE;
             Context_MarkStateDirty(context, STATE_RENDER(WINED3DRS_SCISSORTESTENABLE), StateTable);
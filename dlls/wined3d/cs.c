@@ -0,0 +1,1110 @@
+/*
+ * Command stream: replays device calls on a worker thread in wined3d
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The application thread is the only producer and the worker thread the only
+ * consumer of the ring, so no lock is needed:
+ *
+ *  - head is only written by the application, tail only by the worker. Both
+ *    are free running byte counters, the ring offset is the counter modulo
+ *    CS_RING_SIZE. They are published with interlocked operations, which
+ *    also order the writes to the op data against them.
+ *  - An op never wraps around the end of the ring, a SKIP op pads the rest
+ *    of the ring instead.
+ *  - Objects referenced by an op are AddRef'ed by the application when the op
+ *    is written. Setters that replace a bound object also keep a reference to
+ *    the old one, taken by the worker before it calls the setter. Both are
+ *    released by the application while the worker is idle, so an object is
+ *    never destroyed on the worker thread or while the worker draws with it.
+ *    This happens when the application waits for the worker anyway, or when
+ *    the ring is full. Queries are the one
+ *    exception: their GL query objects belong to the worker's context, so
+ *    the final Release queues a QUERY_DESTROY op and the query is freed by
+ *    the worker.
+ *  - Both sides spin shortly before they go to sleep. The sleeper sets its
+ *    waiting flag, checks the counters again and then waits on its event; the
+ *    other side signals the event if it sees the flag set.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include "wined3d_private.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+
+#define CS_SPIN_COUNT 4000
+
+enum wined3d_cs_op_id
+{
+    WINED3D_CS_OP_SKIP,
+    WINED3D_CS_OP_STOP,
+    WINED3D_CS_OP_FLUSH,
+    WINED3D_CS_OP_SET_RENDER_STATE,
+    WINED3D_CS_OP_SET_SAMPLER_STATE,
+    WINED3D_CS_OP_SET_TEXTURE_STAGE_STATE,
+    WINED3D_CS_OP_SET_TRANSFORM,
+    WINED3D_CS_OP_SET_TEXTURE,
+    WINED3D_CS_OP_SET_STREAM_SOURCE,
+    WINED3D_CS_OP_SET_INDICES,
+    WINED3D_CS_OP_SET_VERTEX_DECLARATION,
+    WINED3D_CS_OP_SET_VERTEX_SHADER,
+    WINED3D_CS_OP_SET_PIXEL_SHADER,
+    WINED3D_CS_OP_SET_VS_CONSTS_F,
+    WINED3D_CS_OP_SET_PS_CONSTS_F,
+    WINED3D_CS_OP_SET_VIEWPORT,
+    WINED3D_CS_OP_SET_MATERIAL,
+    WINED3D_CS_OP_SET_BASE_VERTEX_INDEX,
+    WINED3D_CS_OP_DRAW,
+    WINED3D_CS_OP_DRAW_INDEXED,
+    WINED3D_CS_OP_CLEAR,
+    WINED3D_CS_OP_PRESENT,
+    WINED3D_CS_OP_CREATE_QUERY,
+    WINED3D_CS_OP_QUERY_ISSUE,
+    WINED3D_CS_OP_QUERY_GET_DATA,
+    WINED3D_CS_OP_QUERY_DESTROY,
+};
+
+struct wined3d_cs_op
+{
+    enum wined3d_cs_op_id id;
+    UINT size;              /* including the header, multiple of 8 */
+    IUnknown *refs[2];      /* released by the application after execution */
+};
+
+struct wined3d_cs_render_state
+{
+    struct wined3d_cs_op op;
+    WINED3DRENDERSTATETYPE state;
+    DWORD value;
+};
+
+struct wined3d_cs_sampler_state
+{
+    struct wined3d_cs_op op;
+    DWORD sampler;
+    WINED3DSAMPLERSTATETYPE type;
+    DWORD value;
+};
+
+struct wined3d_cs_texture_stage_state
+{
+    struct wined3d_cs_op op;
+    DWORD stage;
+    WINED3DTEXTURESTAGESTATETYPE type;
+    DWORD value;
+};
+
+struct wined3d_cs_transform
+{
+    struct wined3d_cs_op op;
+    WINED3DTRANSFORMSTATETYPE state;
+    WINED3DMATRIX matrix;
+};
+
+struct wined3d_cs_texture
+{
+    struct wined3d_cs_op op;
+    DWORD stage;
+    IWineD3DBaseTexture *texture;
+};
+
+struct wined3d_cs_stream_source
+{
+    struct wined3d_cs_op op;
+    UINT stream;
+    IWineD3DVertexBuffer *buffer;
+    UINT offset;
+    UINT stride;
+};
+
+struct wined3d_cs_indices
+{
+    struct wined3d_cs_op op;
+    IWineD3DIndexBuffer *buffer;
+};
+
+struct wined3d_cs_vertex_declaration
+{
+    struct wined3d_cs_op op;
+    IWineD3DVertexDeclaration *declaration;
+};
+
+struct wined3d_cs_shader
+{
+    struct wined3d_cs_op op;
+    IWineD3DBase *shader;
+};
+
+struct wined3d_cs_consts_f
+{
+    struct wined3d_cs_op op;
+    UINT start;
+    UINT count;
+    float data[1];
+};
+
+struct wined3d_cs_viewport
+{
+    struct wined3d_cs_op op;
+    WINED3DVIEWPORT viewport;
+};
+
+struct wined3d_cs_material
+{
+    struct wined3d_cs_op op;
+    WINED3DMATERIAL material;
+};
+
+struct wined3d_cs_base_vertex_index
+{
+    struct wined3d_cs_op op;
+    INT index;
+};
+
+struct wined3d_cs_draw
+{
+    struct wined3d_cs_op op;
+    WINED3DPRIMITIVETYPE type;
+    UINT start_vertex;
+    UINT count;
+};
+
+struct wined3d_cs_draw_indexed
+{
+    struct wined3d_cs_op op;
+    WINED3DPRIMITIVETYPE type;
+    UINT min_index;
+    UINT num_vertices;
+    UINT start_index;
+    UINT count;
+};
+
+struct wined3d_cs_clear
+{
+    struct wined3d_cs_op op;
+    DWORD flags;
+    WINED3DCOLOR color;
+    float z;
+    DWORD stencil;
+    DWORD count;
+    WINED3DRECT rects[1];
+};
+
+struct wined3d_cs_present
+{
+    struct wined3d_cs_op op;
+    IWineD3DSwapChain *swapchain;
+    BOOL has_src_rect, has_dst_rect;
+    RECT src_rect;
+    RECT dst_rect;
+    HWND dst_window_override;
+    DWORD flags;
+};
+
+struct wined3d_cs_create_query
+{
+    struct wined3d_cs_op op;
+    WINED3DQUERYTYPE type;
+    IWineD3DQuery **query;
+    IUnknown *parent;
+    HRESULT *hr;
+};
+
+struct wined3d_cs_query_issue
+{
+    struct wined3d_cs_op op;
+    IWineD3DQuery *query;
+    DWORD flags;
+};
+
+struct wined3d_cs_query_get_data
+{
+    struct wined3d_cs_op op;
+    IWineD3DQuery *query;
+    void *data;
+    DWORD size;
+    DWORD flags;
+    HRESULT *hr;
+};
+
+struct wined3d_cs_query_destroy
+{
+    struct wined3d_cs_op op;
+    IWineD3DQueryImpl *query;
+};
+
+static inline ULONG wined3d_cs_get_head(struct wined3d_cs *cs)
+{
+    return InterlockedCompareExchange(&cs->head, 0, 0);
+}
+
+static inline ULONG wined3d_cs_get_tail(struct wined3d_cs *cs)
+{
+    return InterlockedCompareExchange(&cs->tail, 0, 0);
+}
+
+/*****************************************************************************
+ * Worker thread side
+ */
+
+static void cs_op_skip(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+}
+
+static void cs_op_flush(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    if (!cs->worker_gl_dirty) return;
+
+    ENTER_GL();
+    glFlush();
+    checkGLcall("glFlush");
+    LEAVE_GL();
+    cs->worker_gl_dirty = FALSE;
+}
+
+static void cs_op_set_render_state(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_render_state *p = (struct wined3d_cs_render_state *)op;
+
+    IWineD3DDevice_SetRenderState((IWineD3DDevice *)cs->device, p->state, p->value);
+}
+
+static void cs_op_set_sampler_state(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_sampler_state *p = (struct wined3d_cs_sampler_state *)op;
+
+    IWineD3DDevice_SetSamplerState((IWineD3DDevice *)cs->device, p->sampler, p->type, p->value);
+}
+
+static void cs_op_set_texture_stage_state(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_texture_stage_state *p = (struct wined3d_cs_texture_stage_state *)op;
+
+    IWineD3DDevice_SetTextureStageState((IWineD3DDevice *)cs->device, p->stage, p->type, p->value);
+}
+
+static void cs_op_set_transform(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_transform *p = (struct wined3d_cs_transform *)op;
+
+    IWineD3DDevice_SetTransform((IWineD3DDevice *)cs->device, p->state, &p->matrix);
+}
+
+/* Keeps the currently bound object alive until the application releases it */
+static inline void cs_keep_old(struct wined3d_cs_op *op, void *object)
+{
+    op->refs[1] = object;
+    if (object) IUnknown_AddRef(op->refs[1]);
+}
+
+static void cs_op_set_texture(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_texture *p = (struct wined3d_cs_texture *)op;
+
+    cs_keep_old(op, cs->device->updateStateBlock->textures[p->stage]);
+    IWineD3DDevice_SetTexture((IWineD3DDevice *)cs->device, p->stage, p->texture);
+}
+
+static void cs_op_set_stream_source(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_stream_source *p = (struct wined3d_cs_stream_source *)op;
+
+    cs_keep_old(op, cs->device->updateStateBlock->streamSource[p->stream]);
+    IWineD3DDevice_SetStreamSource((IWineD3DDevice *)cs->device, p->stream, p->buffer, p->offset, p->stride);
+}
+
+static void cs_op_set_indices(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_indices *p = (struct wined3d_cs_indices *)op;
+
+    cs_keep_old(op, cs->device->updateStateBlock->pIndexData);
+    IWineD3DDevice_SetIndices((IWineD3DDevice *)cs->device, p->buffer);
+}
+
+static void cs_op_set_vertex_declaration(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_vertex_declaration *p = (struct wined3d_cs_vertex_declaration *)op;
+
+    IWineD3DDevice_SetVertexDeclaration((IWineD3DDevice *)cs->device, p->declaration);
+}
+
+static void cs_op_set_vertex_shader(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_shader *p = (struct wined3d_cs_shader *)op;
+
+    cs_keep_old(op, cs->device->updateStateBlock->vertexShader);
+    IWineD3DDevice_SetVertexShader((IWineD3DDevice *)cs->device, (IWineD3DVertexShader *)p->shader);
+}
+
+static void cs_op_set_pixel_shader(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_shader *p = (struct wined3d_cs_shader *)op;
+
+    cs_keep_old(op, cs->device->updateStateBlock->pixelShader);
+    IWineD3DDevice_SetPixelShader((IWineD3DDevice *)cs->device, (IWineD3DPixelShader *)p->shader);
+}
+
+static void cs_op_set_vs_consts_f(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_consts_f *p = (struct wined3d_cs_consts_f *)op;
+
+    IWineD3DDevice_SetVertexShaderConstantF((IWineD3DDevice *)cs->device, p->start, p->data, p->count);
+}
+
+static void cs_op_set_ps_consts_f(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_consts_f *p = (struct wined3d_cs_consts_f *)op;
+
+    IWineD3DDevice_SetPixelShaderConstantF((IWineD3DDevice *)cs->device, p->start, p->data, p->count);
+}
+
+static void cs_op_set_viewport(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_viewport *p = (struct wined3d_cs_viewport *)op;
+
+    IWineD3DDevice_SetViewport((IWineD3DDevice *)cs->device, &p->viewport);
+}
+
+static void cs_op_set_material(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_material *p = (struct wined3d_cs_material *)op;
+
+    IWineD3DDevice_SetMaterial((IWineD3DDevice *)cs->device, &p->material);
+}
+
+static void cs_op_set_base_vertex_index(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_base_vertex_index *p = (struct wined3d_cs_base_vertex_index *)op;
+
+    IWineD3DDevice_SetBaseVertexIndex((IWineD3DDevice *)cs->device, p->index);
+}
+
+static void cs_op_draw(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_draw *p = (struct wined3d_cs_draw *)op;
+    HRESULT hr;
+
+    hr = IWineD3DDevice_DrawPrimitive((IWineD3DDevice *)cs->device, p->type, p->start_vertex, p->count);
+    if (FAILED(hr)) WARN("Recorded DrawPrimitive failed, hr %#x\n", hr);
+    cs->worker_gl_dirty = TRUE;
+}
+
+static void cs_op_draw_indexed(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_draw_indexed *p = (struct wined3d_cs_draw_indexed *)op;
+    HRESULT hr;
+
+    hr = IWineD3DDevice_DrawIndexedPrimitive((IWineD3DDevice *)cs->device, p->type,
+            p->min_index, p->num_vertices, p->start_index, p->count);
+    if (FAILED(hr)) WARN("Recorded DrawIndexedPrimitive failed, hr %#x\n", hr);
+    cs->worker_gl_dirty = TRUE;
+}
+
+static void cs_op_clear(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_clear *p = (struct wined3d_cs_clear *)op;
+    HRESULT hr;
+
+    hr = IWineD3DDevice_Clear((IWineD3DDevice *)cs->device, p->count, p->count ? p->rects : NULL,
+            p->flags, p->color, p->z, p->stencil);
+    if (FAILED(hr)) WARN("Recorded Clear failed, hr %#x\n", hr);
+    cs->worker_gl_dirty = TRUE;
+}
+
+static void cs_op_present(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_present *p = (struct wined3d_cs_present *)op;
+    HRESULT hr;
+
+    hr = IWineD3DSwapChain_Present(p->swapchain, p->has_src_rect ? &p->src_rect : NULL,
+            p->has_dst_rect ? &p->dst_rect : NULL, p->dst_window_override, NULL, p->flags);
+    if (FAILED(hr)) InterlockedExchange(&cs->present_hr, hr);
+    /* SwapBuffers flushes */
+    cs->worker_gl_dirty = FALSE;
+}
+
+static void cs_op_create_query(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_create_query *p = (struct wined3d_cs_create_query *)op;
+
+    *p->hr = IWineD3DDevice_CreateQuery((IWineD3DDevice *)cs->device, p->type, p->query, p->parent);
+    cs->worker_gl_dirty = TRUE;
+}
+
+static void cs_op_query_issue(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_query_issue *p = (struct wined3d_cs_query_issue *)op;
+
+    IWineD3DQuery_Issue(p->query, p->flags);
+    cs->worker_gl_dirty = TRUE;
+}
+
+static void cs_op_query_get_data(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_query_get_data *p = (struct wined3d_cs_query_get_data *)op;
+
+    *p->hr = IWineD3DQuery_GetData(p->query, p->data, p->size, p->flags);
+}
+
+static void cs_op_query_destroy(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    struct wined3d_cs_query_destroy *p = (struct wined3d_cs_query_destroy *)op;
+
+    query_destroy(p->query);
+}
+
+static void (* const wined3d_cs_op_handlers[])(struct wined3d_cs *cs, struct wined3d_cs_op *op) =
+{
+    /* WINED3D_CS_OP_SKIP                    */ cs_op_skip,
+    /* WINED3D_CS_OP_STOP                    */ cs_op_skip,
+    /* WINED3D_CS_OP_FLUSH                   */ cs_op_flush,
+    /* WINED3D_CS_OP_SET_RENDER_STATE        */ cs_op_set_render_state,
+    /* WINED3D_CS_OP_SET_SAMPLER_STATE       */ cs_op_set_sampler_state,
+    /* WINED3D_CS_OP_SET_TEXTURE_STAGE_STATE */ cs_op_set_texture_stage_state,
+    /* WINED3D_CS_OP_SET_TRANSFORM           */ cs_op_set_transform,
+    /* WINED3D_CS_OP_SET_TEXTURE             */ cs_op_set_texture,
+    /* WINED3D_CS_OP_SET_STREAM_SOURCE       */ cs_op_set_stream_source,
+    /* WINED3D_CS_OP_SET_INDICES             */ cs_op_set_indices,
+    /* WINED3D_CS_OP_SET_VERTEX_DECLARATION  */ cs_op_set_vertex_declaration,
+    /* WINED3D_CS_OP_SET_VERTEX_SHADER       */ cs_op_set_vertex_shader,
+    /* WINED3D_CS_OP_SET_PIXEL_SHADER        */ cs_op_set_pixel_shader,
+    /* WINED3D_CS_OP_SET_VS_CONSTS_F         */ cs_op_set_vs_consts_f,
+    /* WINED3D_CS_OP_SET_PS_CONSTS_F         */ cs_op_set_ps_consts_f,
+    /* WINED3D_CS_OP_SET_VIEWPORT            */ cs_op_set_viewport,
+    /* WINED3D_CS_OP_SET_MATERIAL            */ cs_op_set_material,
+    /* WINED3D_CS_OP_SET_BASE_VERTEX_INDEX   */ cs_op_set_base_vertex_index,
+    /* WINED3D_CS_OP_DRAW                    */ cs_op_draw,
+    /* WINED3D_CS_OP_DRAW_INDEXED            */ cs_op_draw_indexed,
+    /* WINED3D_CS_OP_CLEAR                   */ cs_op_clear,
+    /* WINED3D_CS_OP_PRESENT                 */ cs_op_present,
+    /* WINED3D_CS_OP_CREATE_QUERY            */ cs_op_create_query,
+    /* WINED3D_CS_OP_QUERY_ISSUE             */ cs_op_query_issue,
+    /* WINED3D_CS_OP_QUERY_GET_DATA          */ cs_op_query_get_data,
+    /* WINED3D_CS_OP_QUERY_DESTROY           */ cs_op_query_destroy,
+};
+
+static ULONG wined3d_cs_wait_for_work(struct wined3d_cs *cs, ULONG tail)
+{
+    unsigned int spin;
+    ULONG head;
+
+    for (spin = 0; spin < CS_SPIN_COUNT; ++spin)
+    {
+        if ((head = wined3d_cs_get_head(cs)) != tail) return head;
+    }
+
+    for (;;)
+    {
+        InterlockedExchange(&cs->worker_waiting, 1);
+        if ((head = wined3d_cs_get_head(cs)) != tail) break;
+        WaitForSingleObject(cs->work_event, INFINITE);
+    }
+    InterlockedExchange(&cs->worker_waiting, 0);
+    return head;
+}
+
+static DWORD WINAPI wined3d_cs_run(void *ctx)
+{
+    struct wined3d_cs *cs = ctx;
+    IWineD3DDeviceImpl *device = cs->device;
+    struct wined3d_cs_op *op;
+    ULONG head, tail = 0;
+    enum wined3d_cs_op_id id;
+
+    cs->thread_id = GetCurrentThreadId();
+    TRACE("Command stream %p running in thread %04x\n", cs, cs->thread_id);
+
+    /* Create the GL context of this thread before the application can use
+     * the device, so that queries are created on it */
+    ActivateContext(device, device->lastActiveRenderTarget, CTXUSAGE_RESOURCELOAD);
+    SetEvent(cs->idle_event);
+
+    head = tail;
+    for (;;)
+    {
+        if (head == tail) head = wined3d_cs_wait_for_work(cs, tail);
+
+        op = (struct wined3d_cs_op *)(cs->ring + (tail & (CS_RING_SIZE - 1)));
+        id = op->id;
+        wined3d_cs_op_handlers[id](cs, op);
+        tail += op->size;
+
+        if (id == WINED3D_CS_OP_STOP)
+        {
+            /* Let the application thread destroy the context */
+            pwglMakeCurrent(NULL, NULL);
+            if (device->lastThread == cs->thread_id) device->lastThread = 0;
+        }
+
+        InterlockedExchange(&cs->tail, tail);
+        if (cs->app_waiting && InterlockedExchange(&cs->app_waiting, 0)) SetEvent(cs->idle_event);
+        if (id == WINED3D_CS_OP_STOP) break;
+    }
+
+    TRACE("Command stream %p stopped\n", cs);
+    return 0;
+}
+
+/*****************************************************************************
+ * Application thread side
+ */
+
+/* Waits until the worker has retired everything before pos */
+static void wined3d_cs_wait_for_tail(struct wined3d_cs *cs, ULONG pos)
+{
+    unsigned int spin;
+
+    for (spin = 0; spin < CS_SPIN_COUNT; ++spin)
+    {
+        if ((LONG)(wined3d_cs_get_tail(cs) - pos) >= 0) return;
+    }
+
+    for (;;)
+    {
+        InterlockedExchange(&cs->app_waiting, 1);
+        if ((LONG)(wined3d_cs_get_tail(cs) - pos) >= 0) break;
+        WaitForSingleObject(cs->idle_event, INFINITE);
+    }
+    InterlockedExchange(&cs->app_waiting, 0);
+}
+
+/* Drops the references held by the recorded ops. Releasing the last reference
+ * destroys the object on this thread, which may use GL and the device state,
+ * so the worker has to be idle. Destroying an object can record new ops and
+ * recurse through wined3d_cs_finish, so the worker is waited for before each
+ * op and the op is consumed before its references are released. */
+static void wined3d_cs_reclaim(struct wined3d_cs *cs)
+{
+    while (cs->reclaimed != cs->head)
+    {
+        struct wined3d_cs_op *op = (struct wined3d_cs_op *)(cs->ring + (cs->reclaimed & (CS_RING_SIZE - 1)));
+        IUnknown *refs[2];
+
+        wined3d_cs_wait_for_tail(cs, cs->head);
+        refs[0] = op->refs[0];
+        refs[1] = op->refs[1];
+        cs->reclaimed += op->size;
+
+        if (refs[0]) IUnknown_Release(refs[0]);
+        if (refs[1]) IUnknown_Release(refs[1]);
+    }
+}
+
+static void *wined3d_cs_require_space(struct wined3d_cs *cs, enum wined3d_cs_op_id id, UINT size)
+{
+    struct wined3d_cs_op *op;
+    ULONG head, offset, skip;
+
+    size = (size + 7) & ~7;
+    if (size > CS_RING_SIZE / 2)
+    {
+        ERR("Op %u of %u bytes doesn't fit into the ring\n", id, size);
+        return NULL;
+    }
+
+    /* The application used GL itself since the last op, make its commands
+     * visible to the worker context */
+    if (cs->app_gl_dirty)
+    {
+        ENTER_GL();
+        glFlush();
+        checkGLcall("glFlush");
+        LEAVE_GL();
+        cs->app_gl_dirty = FALSE;
+    }
+
+    for (;;)
+    {
+        head = cs->head;
+        offset = head & (CS_RING_SIZE - 1);
+        skip = offset + size > CS_RING_SIZE ? CS_RING_SIZE - offset : 0;
+        if (head + skip + size - cs->reclaimed <= CS_RING_SIZE) break;
+        TRACE("Ring full, waiting for the worker\n");
+        wined3d_cs_wait_for_tail(cs, head);
+        wined3d_cs_reclaim(cs);
+    }
+
+    if (skip)
+    {
+        op = (struct wined3d_cs_op *)(cs->ring + offset);
+        op->id = WINED3D_CS_OP_SKIP;
+        op->size = skip;
+        op->refs[0] = op->refs[1] = NULL;
+        InterlockedExchange(&cs->head, head + skip);
+        head += skip;
+    }
+
+    op = (struct wined3d_cs_op *)(cs->ring + (head & (CS_RING_SIZE - 1)));
+    op->id = id;
+    op->size = size;
+    op->refs[0] = op->refs[1] = NULL;
+    return op;
+}
+
+/* Holds a reference for the lifetime of the op */
+static inline void cs_keep(struct wined3d_cs_op *op, void *object)
+{
+    op->refs[0] = object;
+    if (object) IUnknown_AddRef(op->refs[0]);
+}
+
+static void wined3d_cs_submit(struct wined3d_cs *cs, struct wined3d_cs_op *op)
+{
+    InterlockedExchange(&cs->head, cs->head + op->size);
+    if (cs->worker_waiting && InterlockedExchange(&cs->worker_waiting, 0)) SetEvent(cs->work_event);
+}
+
+/*****************************************************************************
+ * wined3d_cs_finish
+ *
+ * Waits until the worker has executed all recorded ops and their GL commands
+ * were flushed, then drops the references held by the ops. Called before
+ * anything that is not recorded touches the device state or GL.
+ *
+ *****************************************************************************/
+void wined3d_cs_finish(struct wined3d_cs *cs)
+{
+    struct wined3d_cs_op *op;
+
+    if (wined3d_cs_get_tail(cs) != cs->head || cs->worker_gl_dirty)
+    {
+        if ((op = wined3d_cs_require_space(cs, WINED3D_CS_OP_FLUSH, sizeof(*op))))
+            wined3d_cs_submit(cs, op);
+        wined3d_cs_wait_for_tail(cs, cs->head);
+    }
+    wined3d_cs_reclaim(cs);
+
+    /* The state block is up to date again */
+    cs->indices_recorded = FALSE;
+    cs->vertex_declaration_recorded = FALSE;
+}
+
+HRESULT wined3d_cs_emit_set_render_state(struct wined3d_cs *cs, WINED3DRENDERSTATETYPE state, DWORD value)
+{
+    struct wined3d_cs_render_state *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_SET_RENDER_STATE, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->state = state;
+    p->value = value;
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_set_sampler_state(struct wined3d_cs *cs, DWORD sampler,
+        WINED3DSAMPLERSTATETYPE type, DWORD value)
+{
+    struct wined3d_cs_sampler_state *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_SET_SAMPLER_STATE, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->sampler = sampler;
+    p->type = type;
+    p->value = value;
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_set_texture_stage_state(struct wined3d_cs *cs, DWORD stage,
+        WINED3DTEXTURESTAGESTATETYPE type, DWORD value)
+{
+    struct wined3d_cs_texture_stage_state *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_SET_TEXTURE_STAGE_STATE, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->stage = stage;
+    p->type = type;
+    p->value = value;
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_set_transform(struct wined3d_cs *cs, WINED3DTRANSFORMSTATETYPE state,
+        const WINED3DMATRIX *matrix)
+{
+    struct wined3d_cs_transform *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_SET_TRANSFORM, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->state = state;
+    p->matrix = *matrix;
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_set_texture(struct wined3d_cs *cs, DWORD stage, IWineD3DBaseTexture *texture)
+{
+    struct wined3d_cs_texture *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_SET_TEXTURE, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->stage = stage;
+    p->texture = texture;
+    cs_keep(&p->op, texture);
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_set_stream_source(struct wined3d_cs *cs, UINT stream,
+        IWineD3DVertexBuffer *buffer, UINT offset, UINT stride)
+{
+    struct wined3d_cs_stream_source *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_SET_STREAM_SOURCE, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->stream = stream;
+    p->buffer = buffer;
+    p->offset = offset;
+    p->stride = stride;
+    cs_keep(&p->op, buffer);
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_set_indices(struct wined3d_cs *cs, IWineD3DIndexBuffer *buffer)
+{
+    struct wined3d_cs_indices *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_SET_INDICES, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->buffer = buffer;
+    cs_keep(&p->op, buffer);
+    wined3d_cs_submit(cs, &p->op);
+
+    /* Recorded into the state block that is being recorded, not the device state */
+    if (!cs->device->isRecordingState)
+    {
+        cs->indices_recorded = TRUE;
+        cs->has_indices = buffer != NULL;
+    }
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_set_vertex_declaration(struct wined3d_cs *cs, IWineD3DVertexDeclaration *declaration)
+{
+    struct wined3d_cs_vertex_declaration *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_SET_VERTEX_DECLARATION, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->declaration = declaration;
+    cs_keep(&p->op, declaration);
+    wined3d_cs_submit(cs, &p->op);
+
+    if (!cs->device->isRecordingState)
+    {
+        cs->vertex_declaration_recorded = TRUE;
+        cs->has_vertex_declaration = declaration != NULL;
+    }
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_set_vertex_shader(struct wined3d_cs *cs, IWineD3DVertexShader *shader)
+{
+    struct wined3d_cs_shader *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_SET_VERTEX_SHADER, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->shader = (IWineD3DBase *)shader;
+    cs_keep(&p->op, shader);
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_set_pixel_shader(struct wined3d_cs *cs, IWineD3DPixelShader *shader)
+{
+    struct wined3d_cs_shader *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_SET_PIXEL_SHADER, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->shader = (IWineD3DBase *)shader;
+    cs_keep(&p->op, shader);
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+static HRESULT wined3d_cs_emit_consts_f(struct wined3d_cs *cs, enum wined3d_cs_op_id id,
+        UINT start, const float *data, UINT count)
+{
+    struct wined3d_cs_consts_f *p;
+
+    p = wined3d_cs_require_space(cs, id, FIELD_OFFSET(struct wined3d_cs_consts_f, data[count * 4]));
+    if (!p) return E_OUTOFMEMORY;
+    p->start = start;
+    p->count = count;
+    memcpy(p->data, data, count * 4 * sizeof(*data));
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_set_vs_consts_f(struct wined3d_cs *cs, UINT start, const float *data, UINT count)
+{
+    return wined3d_cs_emit_consts_f(cs, WINED3D_CS_OP_SET_VS_CONSTS_F, start, data, count);
+}
+
+HRESULT wined3d_cs_emit_set_ps_consts_f(struct wined3d_cs *cs, UINT start, const float *data, UINT count)
+{
+    return wined3d_cs_emit_consts_f(cs, WINED3D_CS_OP_SET_PS_CONSTS_F, start, data, count);
+}
+
+HRESULT wined3d_cs_emit_set_viewport(struct wined3d_cs *cs, const WINED3DVIEWPORT *viewport)
+{
+    struct wined3d_cs_viewport *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_SET_VIEWPORT, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->viewport = *viewport;
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_set_material(struct wined3d_cs *cs, const WINED3DMATERIAL *material)
+{
+    struct wined3d_cs_material *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_SET_MATERIAL, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->material = *material;
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_set_base_vertex_index(struct wined3d_cs *cs, INT index)
+{
+    struct wined3d_cs_base_vertex_index *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_SET_BASE_VERTEX_INDEX, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->index = index;
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+/* The draw checks of the device need the bindings. The worker only changes
+ * them when it replays a recorded setter, before that the state block still
+ * holds the bindings and the application thread can read them. */
+static BOOL wined3d_cs_has_vertex_declaration(struct wined3d_cs *cs)
+{
+    if (cs->vertex_declaration_recorded) return cs->has_vertex_declaration;
+    return cs->device->stateBlock->vertexDecl != NULL;
+}
+
+static BOOL wined3d_cs_has_indices(struct wined3d_cs *cs)
+{
+    if (cs->indices_recorded) return cs->has_indices;
+    return cs->device->stateBlock->pIndexData != NULL;
+}
+
+HRESULT wined3d_cs_emit_draw(struct wined3d_cs *cs, WINED3DPRIMITIVETYPE type, UINT start_vertex, UINT count)
+{
+    struct wined3d_cs_draw *p;
+
+    if (!wined3d_cs_has_vertex_declaration(cs))
+    {
+        WARN("(%p) : Called without a valid vertex declaration set\n", cs->device);
+        return WINED3DERR_INVALIDCALL;
+    }
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_DRAW, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->type = type;
+    p->start_vertex = start_vertex;
+    p->count = count;
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_draw_indexed(struct wined3d_cs *cs, WINED3DPRIMITIVETYPE type, UINT min_index,
+        UINT num_vertices, UINT start_index, UINT count)
+{
+    struct wined3d_cs_draw_indexed *p;
+
+    if (!wined3d_cs_has_indices(cs))
+    {
+        ERR("(%p) : Called without a valid index buffer set, returning WINED3DERR_INVALIDCALL\n", cs->device);
+        return WINED3DERR_INVALIDCALL;
+    }
+    if (!wined3d_cs_has_vertex_declaration(cs))
+    {
+        WARN("(%p) : Called without a valid vertex declaration set\n", cs->device);
+        return WINED3DERR_INVALIDCALL;
+    }
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_DRAW_INDEXED, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->type = type;
+    p->min_index = min_index;
+    p->num_vertices = num_vertices;
+    p->start_index = start_index;
+    p->count = count;
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_clear(struct wined3d_cs *cs, DWORD count, const WINED3DRECT *rects,
+        DWORD flags, WINED3DCOLOR color, float z, DWORD stencil)
+{
+    struct wined3d_cs_clear *p;
+
+    if (!rects) count = 0;
+    p = wined3d_cs_require_space(cs, WINED3D_CS_OP_CLEAR, FIELD_OFFSET(struct wined3d_cs_clear, rects[count]));
+    if (!p) return E_OUTOFMEMORY;
+    p->flags = flags;
+    p->color = color;
+    p->z = z;
+    p->stencil = stencil;
+    p->count = count;
+    if (count) memcpy(p->rects, rects, count * sizeof(*rects));
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+/*****************************************************************************
+ * wined3d_cs_emit_present
+ *
+ * Records a present and lets the application run ahead of the worker by at
+ * most CS_MAX_PENDING_PRESENTS frames. The dirty region is unused by Present
+ * and is not recorded. A present that failed on the worker is reported by the
+ * next Present call.
+ *
+ *****************************************************************************/
+HRESULT wined3d_cs_emit_present(struct wined3d_cs *cs, IWineD3DSwapChain *swapchain, const RECT *src_rect,
+        const RECT *dst_rect, HWND dst_window_override, DWORD flags)
+{
+    struct wined3d_cs_present *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_PRESENT, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->swapchain = swapchain;
+    if ((p->has_src_rect = src_rect != NULL)) p->src_rect = *src_rect;
+    if ((p->has_dst_rect = dst_rect != NULL)) p->dst_rect = *dst_rect;
+    p->dst_window_override = dst_window_override;
+    p->flags = flags;
+    cs_keep(&p->op, swapchain);
+    wined3d_cs_submit(cs, &p->op);
+
+    cs->presents[cs->present_idx] = cs->head;
+    cs->present_idx = (cs->present_idx + 1) % CS_MAX_PENDING_PRESENTS;
+    wined3d_cs_wait_for_tail(cs, cs->presents[cs->present_idx]);
+    return InterlockedExchange(&cs->present_hr, WINED3D_OK);
+}
+
+HRESULT wined3d_cs_emit_create_query(struct wined3d_cs *cs, WINED3DQUERYTYPE type,
+        IWineD3DQuery **query, IUnknown *parent)
+{
+    struct wined3d_cs_create_query *p;
+    HRESULT hr;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_CREATE_QUERY, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->type = type;
+    p->query = query;
+    p->parent = parent;
+    p->hr = &hr;
+    wined3d_cs_submit(cs, &p->op);
+    wined3d_cs_finish(cs);
+    return hr;
+}
+
+HRESULT wined3d_cs_emit_query_issue(struct wined3d_cs *cs, IWineD3DQuery *query, DWORD flags)
+{
+    struct wined3d_cs_query_issue *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_QUERY_ISSUE, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->query = query;
+    p->flags = flags;
+    cs_keep(&p->op, query);
+    wined3d_cs_submit(cs, &p->op);
+    return WINED3D_OK;
+}
+
+HRESULT wined3d_cs_emit_query_get_data(struct wined3d_cs *cs, IWineD3DQuery *query,
+        void *data, DWORD size, DWORD flags)
+{
+    struct wined3d_cs_query_get_data *p;
+    HRESULT hr;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_QUERY_GET_DATA, sizeof(*p)))) return E_OUTOFMEMORY;
+    p->query = query;
+    p->data = data;
+    p->size = size;
+    p->flags = flags;
+    p->hr = &hr;
+    wined3d_cs_submit(cs, &p->op);
+    wined3d_cs_finish(cs);
+    return hr;
+}
+
+/* The GL objects of a query belong to the worker context */
+void wined3d_cs_emit_query_destroy(struct wined3d_cs *cs, IWineD3DQuery *query)
+{
+    struct wined3d_cs_query_destroy *p;
+
+    if (!(p = wined3d_cs_require_space(cs, WINED3D_CS_OP_QUERY_DESTROY, sizeof(*p))))
+    {
+        query_destroy((IWineD3DQueryImpl *)query);
+        return;
+    }
+    p->query = (IWineD3DQueryImpl *)query;
+    wined3d_cs_submit(cs, &p->op);
+}
+
+/*****************************************************************************
+ * wined3d_cs_create
+ *
+ * Starts the worker thread of a device. The worker creates its GL context
+ * before this returns; from then on the device calls made by other threads
+ * go through the command stream.
+ *
+ *****************************************************************************/
+HRESULT wined3d_cs_create(IWineD3DDeviceImpl *device)
+{
+    struct wined3d_cs *cs;
+
+    if (!(cs = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cs))))
+        return E_OUTOFMEMORY;
+
+    cs->device = device;
+    if (!(cs->ring = HeapAlloc(GetProcessHeap(), 0, CS_RING_SIZE)))
+        goto fail;
+    if (!(cs->work_event = CreateEventW(NULL, FALSE, FALSE, NULL)))
+        goto fail;
+    if (!(cs->idle_event = CreateEventW(NULL, FALSE, FALSE, NULL)))
+        goto fail;
+    if (!(cs->thread = CreateThread(NULL, 0, wined3d_cs_run, cs, 0, NULL)))
+        goto fail;
+
+    WaitForSingleObject(cs->idle_event, INFINITE);
+    device->cs = cs;
+    TRACE("Created command stream %p for device %p\n", cs, device);
+    return WINED3D_OK;
+
+fail:
+    ERR("Failed to create the command stream\n");
+    if (cs->idle_event) CloseHandle(cs->idle_event);
+    if (cs->work_event) CloseHandle(cs->work_event);
+    HeapFree(GetProcessHeap(), 0, cs->ring);
+    HeapFree(GetProcessHeap(), 0, cs);
+    return E_OUTOFMEMORY;
+}
+
+void wined3d_cs_destroy(IWineD3DDeviceImpl *device)
+{
+    struct wined3d_cs *cs = device->cs;
+    struct wined3d_cs_op *op;
+
+    if (!cs) return;
+    TRACE("Destroying command stream %p\n", cs);
+
+    if ((op = wined3d_cs_require_space(cs, WINED3D_CS_OP_STOP, sizeof(*op))))
+        wined3d_cs_submit(cs, op);
+    WaitForSingleObject(cs->thread, INFINITE);
+    CloseHandle(cs->thread);
+
+    /* Releasing the last references may destroy objects, which must not go
+     * through the command stream anymore */
+    device->cs = NULL;
+    wined3d_cs_reclaim(cs);
+
+    CloseHandle(cs->idle_event);
+    CloseHandle(cs->work_event);
+    HeapFree(GetProcessHeap(), 0, cs->ring);
+    HeapFree(GetProcessHeap(), 0, cs);
+}
@@ -344,6 +344,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_CreateStateBlock(IWineD3DDevice* iface,
     int i, j;
     HRESULT temp_result;
 
+    wined3d_cs_sync(This);
+
     D3DCREATEOBJECTINSTANCE(object, StateBlock)
     object->blockType     = Type;
 
@@ -1178,6 +1180,10 @@ static HRESULT WINAPI IWineD3DDeviceImpl_CreateQuery(IWineD3DDevice *iface, WINE
     HRESULT hr = WINED3DERR_NOTAVAILABLE;
     const IWineD3DQueryVtbl *vtable;
 
+    /* The GL query objects have to be created in the context of the command stream thread */
+    if (ppQuery && wined3d_cs_defer(This))
+        return wined3d_cs_emit_create_query(This->cs, Type, ppQuery, parent);
+
     /* Just a check to see if we support this type of query */
     switch(Type) {
     case WINED3DQUERYTYPE_OCCLUSION:
@@ -2206,6 +2212,10 @@ static HRESULT WINAPI IWineD3DDeviceImpl_Init3D(IWineD3DDevice *iface, WINED3DPR
     }
     This->highest_dirty_ps_const = 0;
     This->highest_dirty_vs_const = 0;
+
+    if(wined3d_settings.cs_multithreaded && FAILED(wined3d_cs_create(This))) {
+        WARN("Failed to create the command stream, continuing single threaded\n");
+    }
     return WINED3D_OK;
 
 err_out:
@@ -2239,6 +2249,9 @@ static HRESULT WINAPI IWineD3DDeviceImpl_Uninit3D(IWineD3DDevice *iface, D3DCB_D
 
     if(!This->d3d_initialized) return WINED3DERR_INVALIDCALL;
 
+    /* Drain the command stream and stop its thread, everything below runs here */
+    if(This->cs) wined3d_cs_destroy(This);
+
     /* I don't think that the interface guarantees that the device is destroyed from the same thread
      * it was created. Thus make sure a context is active for the glDelete* calls
      */
@@ -2399,6 +2412,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetDisplayMode(IWineD3DDevice *iface, U
 
     TRACE("(%p)->(%d,%p) Mode=%dx%dx@%d, %s\n", This, iSwapChain, pMode, pMode->Width, pMode->Height, pMode->RefreshRate, debug_d3dformat(pMode->Format));
 
+    wined3d_cs_sync(This);
+
     /* Resize the screen even without a window:
      * The app could have unset it with SetCooperativeLevel, but not called
      * RestoreDisplayMode first. Then the release will call RestoreDisplayMode,
@@ -2480,6 +2495,8 @@ static UINT WINAPI IWineD3DDeviceImpl_GetAvailableTextureMem(IWineD3DDevice *ifa
 static HRESULT WINAPI IWineD3DDeviceImpl_SetFVF(IWineD3DDevice *iface, DWORD fvf) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
 
+    wined3d_cs_sync(This);
+
     /* Update the current state block */
     This->updateStateBlock->changed.fvf      = TRUE;
 
@@ -2497,6 +2514,7 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetFVF(IWineD3DDevice *iface, DWORD fvf
 
 static HRESULT WINAPI IWineD3DDeviceImpl_GetFVF(IWineD3DDevice *iface, DWORD *pfvf) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
+    wined3d_cs_sync(This);
     TRACE("(%p) : GetFVF returning %x\n", This, This->stateBlock->fvf);
     *pfvf = This->stateBlock->fvf;
     return WINED3D_OK;
@@ -2517,6 +2535,9 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetStreamSource(IWineD3DDevice *iface,
         return WINED3DERR_INVALIDCALL;
     }
 
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_stream_source(This->cs, StreamNumber, pStreamData, OffsetInBytes, Stride);
+
     oldSrc = This->updateStateBlock->streamSource[StreamNumber];
     TRACE("(%p) : StreamNo: %u, OldStream (%p), NewStream (%p), OffsetInBytes %u, NewStride %u\n", This, StreamNumber, oldSrc, pStreamData, OffsetInBytes, Stride);
 
@@ -2565,6 +2586,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetStreamSource(IWineD3DDevice *iface,
 static HRESULT WINAPI IWineD3DDeviceImpl_GetStreamSource(IWineD3DDevice *iface, UINT StreamNumber,IWineD3DVertexBuffer** pStream, UINT *pOffset, UINT* pStride) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
 
+    wined3d_cs_sync(This);
+
     TRACE("(%p) : StreamNo: %u, Stream (%p), Offset %u, Stride %u\n", This, StreamNumber,
            This->stateBlock->streamSource[StreamNumber],
            This->stateBlock->streamOffset[StreamNumber],
@@ -2588,8 +2611,11 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetStreamSource(IWineD3DDevice *iface,
 
 static HRESULT WINAPI IWineD3DDeviceImpl_SetStreamSourceFreq(IWineD3DDevice *iface,  UINT StreamNumber, UINT Divider) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
-    UINT oldFlags = This->updateStateBlock->streamFlags[StreamNumber];
-    UINT oldFreq = This->updateStateBlock->streamFreq[StreamNumber];
+    UINT oldFlags, oldFreq;
+
+    wined3d_cs_sync(This);
+    oldFlags = This->updateStateBlock->streamFlags[StreamNumber];
+    oldFreq = This->updateStateBlock->streamFreq[StreamNumber];
 
     /* Verify input at least in d3d9 this is invalid*/
     if( (Divider & WINED3DSTREAMSOURCE_INSTANCEDATA) && (Divider & WINED3DSTREAMSOURCE_INDEXEDDATA)){
@@ -2623,6 +2649,7 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetStreamSourceFreq(IWineD3DDevice *ifa
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
 
     TRACE("(%p) StreamNumber(%d), Divider(%p)\n", This, StreamNumber, Divider);
+    wined3d_cs_sync(This);
     *Divider = This->updateStateBlock->streamFreq[StreamNumber] | This->updateStateBlock->streamFlags[StreamNumber];
 
     TRACE("(%p) : returning %d\n", This, *Divider);
@@ -2639,6 +2666,9 @@ static HRESULT  WINAPI  IWineD3DDeviceImpl_SetTransform(IWineD3DDevice *iface, W
     /* Most of this routine, comments included copied from ddraw tree initially: */
     TRACE("(%p) : Transform State=%s\n", This, debug_d3dtstype(d3dts));
 
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_transform(This->cs, d3dts, lpmatrix);
+
     /* Handle recording of state blocks */
     if (This->isRecordingState) {
         TRACE("Recording... not performing anything\n");
@@ -2683,6 +2713,7 @@ static HRESULT  WINAPI  IWineD3DDeviceImpl_SetTransform(IWineD3DDevice *iface, W
 static HRESULT WINAPI IWineD3DDeviceImpl_GetTransform(IWineD3DDevice *iface, WINED3DTRANSFORMSTATETYPE State, WINED3DMATRIX* pMatrix) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
     TRACE("(%p) : for Transform State %s\n", This, debug_d3dtstype(State));
+    wined3d_cs_sync(This);
     *pMatrix = This->stateBlock->transforms[State];
     return WINED3D_OK;
 }
@@ -2699,6 +2730,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_MultiplyTransform(IWineD3DDevice *iface
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
     TRACE("(%p) : For state %s\n", This, debug_d3dtstype(State));
 
+    wined3d_cs_sync(This);
+
     if (State < HIGHEST_TRANSFORMSTATE)
     {
         mat = &This->updateStateBlock->transforms[State];
@@ -2730,6 +2763,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetLight(IWineD3DDevice *iface, DWORD I
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
     TRACE("(%p) : Idx(%d), pLight(%p). Hash index is %d\n", This, Index, pLight, Hi);
 
+    wined3d_cs_sync(This);
+
     /* Check the parameter range. Need for speed most wanted sets junk lights which confuse
      * the gl driver.
      */
@@ -2871,6 +2906,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetLight(IWineD3DDevice *iface, DWORD I
     struct list *e;
     TRACE("(%p) : Idx(%d), pLight(%p)\n", This, Index, pLight);
 
+    wined3d_cs_sync(This);
+
     LIST_FOR_EACH(e, &This->stateBlock->lightMap[Hi]) {
         lightInfo = LIST_ENTRY(e, PLIGHTINFOEL, entry);
         if(lightInfo->OriginalIndex == Index) break;
@@ -2897,6 +2934,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetLightEnable(IWineD3DDevice *iface, D
     struct list *e;
     TRACE("(%p) : Idx(%d), enable? %d\n", This, Index, Enable);
 
+    wined3d_cs_sync(This);
+
     /* Tests show true = 128...not clear why */
     Enable = Enable? 128: 0;
 
@@ -2983,6 +3022,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetLightEnable(IWineD3DDevice *iface, D
     UINT Hi = LIGHTMAP_HASHFUNC(Index);
     TRACE("(%p) : for idx(%d)\n", This, Index);
 
+    wined3d_cs_sync(This);
+
     LIST_FOR_EACH(e, &This->stateBlock->lightMap[Hi]) {
         lightInfo = LIST_ENTRY(e, PLIGHTINFOEL, entry);
         if(lightInfo->OriginalIndex == Index) break;
@@ -3005,6 +3046,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetClipPlane(IWineD3DDevice *iface, DWO
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
     TRACE("(%p) : for idx %d, %p\n", This, Index, pPlane);
 
+    wined3d_cs_sync(This);
+
     /* Validate Index */
     if (Index >= GL_LIMITS(clipplanes)) {
         TRACE("Application has requested clipplane this device doesn't support\n");
@@ -3041,6 +3084,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetClipPlane(IWineD3DDevice *iface, DWO
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
     TRACE("(%p) : for idx %d\n", This, Index);
 
+    wined3d_cs_sync(This);
+
     /* Validate Index */
     if (Index >= GL_LIMITS(clipplanes)) {
         TRACE("Application has requested clipplane this device doesn't support\n");
@@ -3088,6 +3133,9 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetMaterial(IWineD3DDevice *iface, CONS
 
     if (!pMaterial) return WINED3DERR_INVALIDCALL;
 
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_material(This->cs, pMaterial);
+
     This->updateStateBlock->changed.material = TRUE;
     This->updateStateBlock->material = *pMaterial;
 
@@ -3103,6 +3151,7 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetMaterial(IWineD3DDevice *iface, CONS
 
 static HRESULT WINAPI IWineD3DDeviceImpl_GetMaterial(IWineD3DDevice *iface, WINED3DMATERIAL* pMaterial) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
+    wined3d_cs_sync(This);
     *pMaterial = This->updateStateBlock->material;
     TRACE("(%p) : Diffuse (%f,%f,%f,%f)\n", This, pMaterial->Diffuse.r, pMaterial->Diffuse.g,
         pMaterial->Diffuse.b, pMaterial->Diffuse.a);
@@ -3125,6 +3174,10 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetIndices(IWineD3DDevice *iface, IWine
     IWineD3DIndexBuffer *oldIdxs;
 
     TRACE("(%p) : Setting to %p\n", This, pIndexData);
+
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_indices(This->cs, pIndexData);
+
     oldIdxs = This->updateStateBlock->pIndexData;
 
     This->updateStateBlock->changed.indices = TRUE;
@@ -3149,6 +3202,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetIndices(IWineD3DDevice *iface, IWine
 static HRESULT WINAPI IWineD3DDeviceImpl_GetIndices(IWineD3DDevice *iface, IWineD3DIndexBuffer** ppIndexData) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
 
+    wined3d_cs_sync(This);
+
     *ppIndexData = This->stateBlock->pIndexData;
 
     /* up ref count on ppindexdata */
@@ -3168,6 +3223,9 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetBaseVertexIndex(IWineD3DDevice *ifac
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
     TRACE("(%p)->(%d)\n", This, BaseIndex);
 
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_base_vertex_index(This->cs, BaseIndex);
+
     if(This->updateStateBlock->baseVertexIndex == BaseIndex) {
         TRACE("Application is setting the old value over, nothing to do\n");
         return WINED3D_OK;
@@ -3188,6 +3246,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetBaseVertexIndex(IWineD3DDevice *ifac
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
     TRACE("(%p) : base_index %p\n", This, base_index);
 
+    wined3d_cs_sync(This);
+
     *base_index = This->stateBlock->baseVertexIndex;
 
     TRACE("Returning %u\n", *base_index);
@@ -3202,6 +3262,10 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetViewport(IWineD3DDevice *iface, CONS
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
 
     TRACE("(%p)\n", This);
+
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_viewport(This->cs, pViewport);
+
     This->updateStateBlock->changed.viewport = TRUE;
     This->updateStateBlock->viewport = *pViewport;
 
@@ -3222,6 +3286,7 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetViewport(IWineD3DDevice *iface, CONS
 static HRESULT WINAPI IWineD3DDeviceImpl_GetViewport(IWineD3DDevice *iface, WINED3DVIEWPORT* pViewport) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
     TRACE("(%p)\n", This);
+    wined3d_cs_sync(This);
     *pViewport = This->stateBlock->viewport;
     return WINED3D_OK;
 }
@@ -3233,10 +3298,15 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetViewport(IWineD3DDevice *iface, WINE
 static HRESULT WINAPI IWineD3DDeviceImpl_SetRenderState(IWineD3DDevice *iface, WINED3DRENDERSTATETYPE State, DWORD Value) {
 
     IWineD3DDeviceImpl  *This     = (IWineD3DDeviceImpl *)iface;
-    DWORD oldValue = This->stateBlock->renderState[State];
+    DWORD oldValue;
 
     TRACE("(%p)->state = %s(%d), value = %d\n", This, debug_d3drenderstate(State), State, Value);
 
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_render_state(This->cs, State, Value);
+
+    oldValue = This->stateBlock->renderState[State];
+
     This->updateStateBlock->changed.renderState[State] = TRUE;
     This->updateStateBlock->renderState[State] = Value;
 
@@ -3258,6 +3328,7 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetRenderState(IWineD3DDevice *iface, W
 
 static HRESULT WINAPI IWineD3DDeviceImpl_GetRenderState(IWineD3DDevice *iface, WINED3DRENDERSTATETYPE State, DWORD *pValue) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
+    wined3d_cs_sync(This);
     TRACE("(%p) for State %d = %d\n", This, State, This->stateBlock->renderState[State]);
     *pValue = This->stateBlock->renderState[State];
     return WINED3D_OK;
@@ -3298,6 +3369,9 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetSamplerState(IWineD3DDevice *iface,
     * Ok GForce say it's ok to use glTexParameter/glGetTexParameter(...).
      ******************/
 
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_sampler_state(This->cs, Sampler, Type, Value);
+
     oldValue = This->stateBlock->samplerState[Sampler][Type];
     This->updateStateBlock->samplerState[Sampler][Type]         = Value;
     This->updateStateBlock->changed.samplerState[Sampler][Type] = Value;
@@ -3324,6 +3398,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetSamplerState(IWineD3DDevice *iface,
     TRACE("(%p) : Sampler %#x, Type %s (%#x)\n",
             This, Sampler, debug_d3dsamplerstate(Type), Type);
 
+    wined3d_cs_sync(This);
+
     if (Sampler >= WINED3DVERTEXTEXTURESAMPLER0 && Sampler <= WINED3DVERTEXTEXTURESAMPLER3) {
         Sampler -= (WINED3DVERTEXTEXTURESAMPLER0 - MAX_FRAGMENT_SAMPLERS);
     }
@@ -3341,6 +3417,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetSamplerState(IWineD3DDevice *iface,
 static HRESULT WINAPI IWineD3DDeviceImpl_SetScissorRect(IWineD3DDevice *iface, CONST RECT* pRect) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
 
+    wined3d_cs_sync(This);
+
     This->updateStateBlock->changed.scissorRect = TRUE;
     if(EqualRect(&This->updateStateBlock->scissorRect, pRect)) {
         TRACE("App is setting the old scissor rectangle over, nothing to do\n");
@@ -3361,6 +3439,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetScissorRect(IWineD3DDevice *iface, C
 static HRESULT WINAPI IWineD3DDeviceImpl_GetScissorRect(IWineD3DDevice *iface, RECT* pRect) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
 
+    wined3d_cs_sync(This);
+
     *pRect = This->updateStateBlock->scissorRect;
     TRACE("(%p)Returning a Scissor Rect of %d:%d-%d:%d\n", This, pRect->left, pRect->top, pRect->right, pRect->bottom);
     return WINED3D_OK;
@@ -3368,10 +3448,15 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetScissorRect(IWineD3DDevice *iface, R
 
 static HRESULT WINAPI IWineD3DDeviceImpl_SetVertexDeclaration(IWineD3DDevice* iface, IWineD3DVertexDeclaration* pDecl) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *) iface;
-    IWineD3DVertexDeclaration *oldDecl = This->updateStateBlock->vertexDecl;
+    IWineD3DVertexDeclaration *oldDecl;
 
     TRACE("(%p) : pDecl=%p\n", This, pDecl);
 
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_vertex_declaration(This->cs, pDecl);
+
+    oldDecl = This->updateStateBlock->vertexDecl;
+
     This->updateStateBlock->vertexDecl = pDecl;
     This->updateStateBlock->changed.vertexDecl = TRUE;
 
@@ -3393,6 +3478,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetVertexDeclaration(IWineD3DDevice* if
 
     TRACE("(%p) : ppDecl=%p\n", This, ppDecl);
 
+    wined3d_cs_sync(This);
+
     *ppDecl = This->stateBlock->vertexDecl;
     if (NULL != *ppDecl) IWineD3DVertexDeclaration_AddRef(*ppDecl);
     return WINED3D_OK;
@@ -3400,8 +3487,12 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetVertexDeclaration(IWineD3DDevice* if
 
 static HRESULT WINAPI IWineD3DDeviceImpl_SetVertexShader(IWineD3DDevice *iface, IWineD3DVertexShader* pShader) {
     IWineD3DDeviceImpl *This        = (IWineD3DDeviceImpl *)iface;
-    IWineD3DVertexShader* oldShader = This->updateStateBlock->vertexShader;
+    IWineD3DVertexShader* oldShader;
 
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_vertex_shader(This->cs, pShader);
+
+    oldShader = This->updateStateBlock->vertexShader;
     This->updateStateBlock->vertexShader         = pShader;
     This->updateStateBlock->changed.vertexShader = TRUE;
 
@@ -3428,6 +3519,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetVertexShader(IWineD3DDevice *iface,
 static HRESULT WINAPI IWineD3DDeviceImpl_GetVertexShader(IWineD3DDevice *iface, IWineD3DVertexShader** ppShader) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
 
+    wined3d_cs_sync(This);
+
     if (NULL == ppShader) {
         return WINED3DERR_INVALIDCALL;
     }
@@ -3451,6 +3544,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetVertexShaderConstantB(
     TRACE("(iface %p, srcData %p, start %d, count %d)\n",
             iface, srcData, start, count);
 
+    wined3d_cs_sync(This);
+
     if (srcData == NULL || cnt < 0)
         return WINED3DERR_INVALIDCALL;
 
@@ -3479,6 +3574,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetVertexShaderConstantB(
     TRACE("(iface %p, dstData %p, start %d, count %d)\n",
             iface, dstData, start, count);
 
+    wined3d_cs_sync(This);
+
     if (dstData == NULL || cnt < 0)
         return WINED3DERR_INVALIDCALL;
 
@@ -3498,6 +3595,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetVertexShaderConstantI(
     TRACE("(iface %p, srcData %p, start %d, count %d)\n",
             iface, srcData, start, count);
 
+    wined3d_cs_sync(This);
+
     if (srcData == NULL || cnt < 0)
         return WINED3DERR_INVALIDCALL;
 
@@ -3527,6 +3626,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetVertexShaderConstantI(
     TRACE("(iface %p, dstData %p, start %d, count %d)\n",
             iface, dstData, start, count);
 
+    wined3d_cs_sync(This);
+
     if (dstData == NULL || ((signed int) MAX_CONST_I - (signed int) start) <= (signed int) 0)
         return WINED3DERR_INVALIDCALL;
 
@@ -3550,6 +3651,9 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetVertexShaderConstantF(
     if (srcData == NULL || start + count > GL_LIMITS(vshader_constantsF) || start > GL_LIMITS(vshader_constantsF))
         return WINED3DERR_INVALIDCALL;
 
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_vs_consts_f(This->cs, start, srcData, count);
+
     memcpy(&This->updateStateBlock->vertexShaderConstantF[start * 4], srcData, count * sizeof(float) * 4);
     if(TRACE_ON(d3d)) {
         for (i = 0; i < count; i++)
@@ -3590,6 +3694,9 @@ UINT count) {
     if (srcData == NULL || start + count > GL_LIMITS(vshader_constantsF) || start > GL_LIMITS(vshader_constantsF))
         return WINED3DERR_INVALIDCALL;
 
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_vs_consts_f(This->cs, start, srcData, count);
+
     memcpy(&This->updateStateBlock->vertexShaderConstantF[start * 4], srcData, count * sizeof(float) * 4);
     if(TRACE_ON(d3d)) {
         for (i = 0; i < count; i++)
@@ -3621,6 +3728,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetVertexShaderConstantF(
     TRACE("(iface %p, dstData %p, start %d, count %d)\n",
             iface, dstData, start, count);
 
+    wined3d_cs_sync(This);
+
     if (dstData == NULL || cnt < 0)
         return WINED3DERR_INVALIDCALL;
 
@@ -3821,7 +3930,12 @@ void IWineD3DDeviceImpl_FindTexUnitMap(IWineD3DDeviceImpl *This) {
 
 static HRESULT WINAPI IWineD3DDeviceImpl_SetPixelShader(IWineD3DDevice *iface, IWineD3DPixelShader *pShader) {
     IWineD3DDeviceImpl *This        = (IWineD3DDeviceImpl *)iface;
-    IWineD3DPixelShader *oldShader  = This->updateStateBlock->pixelShader;
+    IWineD3DPixelShader *oldShader;
+
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_pixel_shader(This->cs, pShader);
+
+    oldShader = This->updateStateBlock->pixelShader;
     This->updateStateBlock->pixelShader         = pShader;
     This->updateStateBlock->changed.pixelShader = TRUE;
 
@@ -3854,6 +3968,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetPixelShader(IWineD3DDevice *iface, I
 static HRESULT WINAPI IWineD3DDeviceImpl_GetPixelShader(IWineD3DDevice *iface, IWineD3DPixelShader **ppShader) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
 
+    wined3d_cs_sync(This);
+
     if (NULL == ppShader) {
         WARN("(%p) : PShader is NULL, returning INVALIDCALL\n", This);
         return WINED3DERR_INVALIDCALL;
@@ -3879,6 +3995,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetPixelShaderConstantB(
     TRACE("(iface %p, srcData %p, start %d, count %d)\n",
             iface, srcData, start, count);
 
+    wined3d_cs_sync(This);
+
     if (srcData == NULL || cnt < 0)
         return WINED3DERR_INVALIDCALL;
 
@@ -3907,6 +4025,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetPixelShaderConstantB(
     TRACE("(iface %p, dstData %p, start %d, count %d)\n",
             iface, dstData, start, count);
 
+    wined3d_cs_sync(This);
+
     if (dstData == NULL || cnt < 0)
         return WINED3DERR_INVALIDCALL;
 
@@ -3926,6 +4046,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetPixelShaderConstantI(
     TRACE("(iface %p, srcData %p, start %d, count %d)\n",
             iface, srcData, start, count);
 
+    wined3d_cs_sync(This);
+
     if (srcData == NULL || cnt < 0)
         return WINED3DERR_INVALIDCALL;
 
@@ -3955,6 +4077,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetPixelShaderConstantI(
     TRACE("(iface %p, dstData %p, start %d, count %d)\n",
             iface, dstData, start, count);
 
+    wined3d_cs_sync(This);
+
     if (dstData == NULL || cnt < 0)
         return WINED3DERR_INVALIDCALL;
 
@@ -3978,6 +4102,9 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetPixelShaderConstantF(
     if (srcData == NULL || start + count > GL_LIMITS(pshader_constantsF) || start > GL_LIMITS(pshader_constantsF))
         return WINED3DERR_INVALIDCALL;
 
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_ps_consts_f(This->cs, start, srcData, count);
+
     memcpy(&This->updateStateBlock->pixelShaderConstantF[start * 4], srcData, count * sizeof(float) * 4);
     if(TRACE_ON(d3d)) {
         for (i = 0; i < count; i++)
@@ -4018,6 +4145,9 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetPixelShaderConstantF_DirtyConst(
     if (srcData == NULL || start + count > GL_LIMITS(pshader_constantsF) || start > GL_LIMITS(pshader_constantsF))
         return WINED3DERR_INVALIDCALL;
 
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_ps_consts_f(This->cs, start, srcData, count);
+
     memcpy(&This->updateStateBlock->pixelShaderConstantF[start * 4], srcData, count * sizeof(float) * 4);
     if(TRACE_ON(d3d)) {
         for (i = 0; i < count; i++)
@@ -4049,6 +4179,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetPixelShaderConstantF(
     TRACE("(iface %p, dstData %p, start %d, count %d)\n",
             iface, dstData, start, count);
 
+    wined3d_cs_sync(This);
+
     if (dstData == NULL || cnt < 0)
         return WINED3DERR_INVALIDCALL;
 
@@ -4415,9 +4547,12 @@ process_vertices_strided(IWineD3DDeviceImpl *This, DWORD dwDestIndex, DWORD dwCo
 static HRESULT WINAPI IWineD3DDeviceImpl_ProcessVertices(IWineD3DDevice *iface, UINT SrcStartIndex, UINT DestIndex, UINT VertexCount, IWineD3DVertexBuffer* pDestBuffer, IWineD3DVertexDeclaration* pVertexDecl, DWORD Flags) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
     WineDirect3DVertexStridedData strided;
-    BOOL vbo = FALSE, streamWasUP = This->stateBlock->streamIsUP;
+    BOOL vbo = FALSE, streamWasUP;
     TRACE("(%p)->(%d,%d,%d,%p,%p,%d\n", This, SrcStartIndex, DestIndex, VertexCount, pDestBuffer, pVertexDecl, Flags);
 
+    wined3d_cs_sync(This);
+    streamWasUP = This->stateBlock->streamIsUP;
+
     if(pVertexDecl) {
         ERR("Output vertex declaration not implemented yet\n");
     }
@@ -4483,7 +4618,7 @@ static HRESULT WINAPI IWineD3DDeviceImpl_ProcessVertices(IWineD3DDevice *iface,
  *****/
 static HRESULT WINAPI IWineD3DDeviceImpl_SetTextureStageState(IWineD3DDevice *iface, DWORD Stage, WINED3DTEXTURESTAGESTATETYPE Type, DWORD Value) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
-    DWORD oldValue = This->updateStateBlock->textureState[Stage][Type];
+    DWORD oldValue;
 
     TRACE("(%p) : Stage=%d, Type=%s(%d), Value=%d\n", This, Stage, debug_d3dtexturestate(Type), Type, Value);
 
@@ -4492,6 +4627,11 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetTextureStageState(IWineD3DDevice *if
         return WINED3D_OK;
     }
 
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_texture_stage_state(This->cs, Stage, Type, Value);
+
+    oldValue = This->updateStateBlock->textureState[Stage][Type];
+
     This->updateStateBlock->changed.textureState[Stage][Type] = TRUE;
     This->updateStateBlock->textureState[Stage][Type]         = Value;
 
@@ -4559,6 +4699,7 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetTextureStageState(IWineD3DDevice *if
 
 static HRESULT WINAPI IWineD3DDeviceImpl_GetTextureStageState(IWineD3DDevice *iface, DWORD Stage, WINED3DTEXTURESTAGESTATETYPE Type, DWORD* pValue) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
+    wined3d_cs_sync(This);
     TRACE("(%p) : requesting Stage %d, Type %d getting %d\n", This, Stage, Type, This->updateStateBlock->textureState[Stage][Type]);
     *pValue = This->updateStateBlock->textureState[Stage][Type];
     return WINED3D_OK;
@@ -4582,15 +4723,18 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetTexture(IWineD3DDevice *iface, DWORD
         return WINED3D_OK; /* Windows accepts overflowing this array ... we do not. */
     }
 
+    /* SetTexture isn't allowed on textures in WINED3DPOOL_SCRATCH */
+    if(pTexture != NULL && ((IWineD3DTextureImpl*)pTexture)->resource.pool == WINED3DPOOL_SCRATCH) {
+        WARN("(%p) Attempt to set scratch texture rejected\n", pTexture);
+        return WINED3DERR_INVALIDCALL;
+    }
+
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_set_texture(This->cs, Stage, pTexture);
+
     oldTexture = This->updateStateBlock->textures[Stage];
 
     if(pTexture != NULL) {
-        /* SetTexture isn't allowed on textures in WINED3DPOOL_SCRATCH; 
-         */
-        if(((IWineD3DTextureImpl*)pTexture)->resource.pool == WINED3DPOOL_SCRATCH) {
-            WARN("(%p) Attempt to set scratch texture rejected\n", pTexture);
-            return WINED3DERR_INVALIDCALL;
-        }
         This->stateBlock->textureDimensions[Stage] = IWineD3DBaseTexture_GetTextureDimensions(pTexture);
     }
 
@@ -4670,6 +4814,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_GetTexture(IWineD3DDevice *iface, DWORD
 
     TRACE("(%p) : Stage %#x, ppTexture %p\n", This, Stage, ppTexture);
 
+    wined3d_cs_sync(This);
+
     if (Stage >= WINED3DVERTEXTEXTURESAMPLER0 && Stage <= WINED3DVERTEXTEXTURESAMPLER3) {
         Stage -= (WINED3DVERTEXTEXTURESAMPLER0 - MAX_FRAGMENT_SAMPLERS);
     }
@@ -4782,6 +4928,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_BeginStateBlock(IWineD3DDevice *iface)
     int i;
 
     TRACE("(%p)\n", This);
+
+    wined3d_cs_sync(This);
     
     if (This->isRecordingState) {
         return WINED3DERR_INVALIDCALL;
@@ -4821,6 +4969,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_EndStateBlock(IWineD3DDevice *iface, IW
     unsigned int i, j;
     IWineD3DStateBlockImpl *object = This->updateStateBlock;
 
+    wined3d_cs_sync(This);
+
     if (!This->isRecordingState) {
         FIXME("(%p) not recording! returning error\n", This);
         *ppStateBlock = NULL;
@@ -4923,6 +5073,12 @@ static HRESULT WINAPI IWineD3DDeviceImpl_EndScene(IWineD3DDevice *iface) {
         return WINED3DERR_INVALIDCALL;
     }
 
+    /* The command stream thread flushes when the application waits for it */
+    if (wined3d_cs_defer(This)) {
+        This->inScene = FALSE;
+        return WINED3D_OK;
+    }
+
     ActivateContext(This, This->lastActiveRenderTarget, CTXUSAGE_RESOURCELOAD);
     /* We only have to do this if we need to read the, swapbuffers performs a flush for us */
     ENTER_GL();
@@ -4939,6 +5095,7 @@ static HRESULT WINAPI IWineD3DDeviceImpl_Present(IWineD3DDevice *iface,
                                           HWND hDestWindowOverride, CONST RGNDATA* pDirtyRegion) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
     IWineD3DSwapChain *swapChain = NULL;
+    HRESULT hr, ret = WINED3D_OK;
     int i;
     int swapchains = IWineD3DDeviceImpl_GetNumberOfSwapChains(iface);
 
@@ -4948,11 +5105,12 @@ static HRESULT WINAPI IWineD3DDeviceImpl_Present(IWineD3DDevice *iface,
 
         IWineD3DDeviceImpl_GetSwapChain(iface, i, &swapChain);
         TRACE("presentinng chain %d, %p\n", i, swapChain);
-        IWineD3DSwapChain_Present(swapChain, pSourceRect, pDestRect, hDestWindowOverride, pDirtyRegion, 0);
+        hr = IWineD3DSwapChain_Present(swapChain, pSourceRect, pDestRect, hDestWindowOverride, pDirtyRegion, 0);
+        if(FAILED(hr)) ret = hr;
         IWineD3DSwapChain_Release(swapChain);
     }
 
-    return WINED3D_OK;
+    return ret;
 }
 
 /* Not called from the VTable (internal subroutine) */
@@ -5152,6 +5310,10 @@ static HRESULT WINAPI IWineD3DDeviceImpl_Clear(IWineD3DDevice *iface, DWORD Coun
         return WINED3DERR_INVALIDCALL;
     }
 
+    /* Huge rectangle lists are not worth a copy, ClearSurface waits for the worker instead */
+    if (wined3d_cs_defer(This) && Count <= CS_MAX_CLEAR_RECTS)
+        return wined3d_cs_emit_clear(This->cs, Count, pRects, Flags, Color, Z, Stencil);
+
     return IWineD3DDeviceImpl_ClearSurface(This, target, Count, pRects, Flags, Color, Z, Stencil);
 }
 
@@ -5167,6 +5329,10 @@ static HRESULT WINAPI IWineD3DDeviceImpl_DrawPrimitive(IWineD3DDevice *iface, WI
                                debug_d3dprimitivetype(PrimitiveType),
                                StartVertex, PrimitiveCount);
 
+    /* The command stream checks the draw against the recorded bindings */
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_draw(This->cs, PrimitiveType, StartVertex, PrimitiveCount);
+
     if(!This->stateBlock->vertexDecl) {
         WARN("(%p) : Called without a valid vertex declaration set\n", This);
         return WINED3DERR_INVALIDCALL;
@@ -5199,6 +5365,9 @@ static HRESULT  WINAPI  IWineD3DDeviceImpl_DrawIndexedPrimitive(IWineD3DDevice *
     WINED3DINDEXBUFFER_DESC  IdxBufDsc;
     GLuint vbo;
 
+    if (wined3d_cs_defer(This))
+        return wined3d_cs_emit_draw_indexed(This->cs, PrimitiveType, minIndex, NumVertices, startIndex, primCount);
+
     pIB = This->stateBlock->pIndexData;
     if (!pIB) {
         /* D3D9 returns D3DERR_INVALIDCALL when DrawIndexedPrimitive is called
@@ -5252,6 +5421,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_DrawPrimitiveUP(IWineD3DDevice *iface,
              debug_d3dprimitivetype(PrimitiveType),
              PrimitiveCount, pVertexStreamZeroData, VertexStreamZeroStride);
 
+    wined3d_cs_sync(This);
+
     if(!This->stateBlock->vertexDecl) {
         WARN("(%p) : Called without a valid vertex declaration set\n", This);
         return WINED3DERR_INVALIDCALL;
@@ -5297,6 +5468,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_DrawIndexedPrimitiveUP(IWineD3DDevice *
              MinVertexIndex, NumVertices, PrimitiveCount, pIndexData,
              IndexDataFormat, pVertexStreamZeroData, VertexStreamZeroStride);
 
+    wined3d_cs_sync(This);
+
     if(!This->stateBlock->vertexDecl) {
         WARN("(%p) : Called without a valid vertex declaration set\n", This);
         return WINED3DERR_INVALIDCALL;
@@ -5343,6 +5516,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_DrawIndexedPrimitiveUP(IWineD3DDevice *
 static HRESULT WINAPI IWineD3DDeviceImpl_DrawPrimitiveStrided (IWineD3DDevice *iface, WINED3DPRIMITIVETYPE PrimitiveType, UINT PrimitiveCount, WineDirect3DVertexStridedData *DrawPrimStrideData) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *) iface;
 
+    wined3d_cs_sync(This);
+
     /* Mark the state dirty until we have nicer tracking
      * its fine to change baseVertexIndex because that call is only called by ddraw which does not need
      * that value.
@@ -5360,6 +5535,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_DrawIndexedPrimitiveStrided(IWineD3DDev
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *) iface;
     DWORD idxSize = (IndexDataFormat == WINED3DFMT_INDEX32 ? 4 : 2);
 
+    wined3d_cs_sync(This);
+
     /* Mark the state dirty until we have nicer tracking
      * its fine to change baseVertexIndex because that call is only called by ddraw which does not need
      * that value.
@@ -5418,6 +5595,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_UpdateTexture (IWineD3DDevice *iface, I
 
     TRACE("(%p) Source %p Destination %p\n", This, pSourceTexture, pDestinationTexture);
 
+    wined3d_cs_sync(This);
+
     /* verify that the source and destination textures aren't NULL */
     if (NULL == pSourceTexture || NULL == pDestinationTexture) {
         WARN("(%p) : source (%p) and destination (%p) textures must not be NULL, returning WINED3DERR_INVALIDCALL\n",
@@ -5547,6 +5726,7 @@ static HRESULT  WINAPI  IWineD3DDeviceImpl_GetFrontBufferData(IWineD3DDevice *if
 
 static HRESULT  WINAPI  IWineD3DDeviceImpl_ValidateDevice(IWineD3DDevice *iface, DWORD* pNumPasses) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
+    wined3d_cs_sync(This);
     /* return a sensible default */
     *pNumPasses = 1;
     /* TODO: If the window is minimized then validate device should return something other than WINED3D_OK */
@@ -5574,6 +5754,8 @@ static HRESULT  WINAPI  IWineD3DDeviceImpl_SetPaletteEntries(IWineD3DDevice *ifa
 
     TRACE("(%p) : PaletteNumber %u\n", This, PaletteNumber);
 
+    wined3d_cs_sync(This);
+
     if (PaletteNumber >= MAX_PALETTES) {
         ERR("(%p) : (%u) Out of range 0-%u, returning Invalid Call\n", This, PaletteNumber, MAX_PALETTES);
         return WINED3DERR_INVALIDCALL;
@@ -5616,6 +5798,7 @@ static HRESULT  WINAPI  IWineD3DDeviceImpl_GetPaletteEntries(IWineD3DDevice *ifa
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
     int j;
     TRACE("(%p) : PaletteNumber %u\n", This, PaletteNumber);
+    wined3d_cs_sync(This);
     if (PaletteNumber >= This->NumberOfPalettes || !This->palettes[PaletteNumber]) {
         /* What happens in such situation isn't documented; Native seems to silently abort
            on such conditions. Return Invalid Call. */
@@ -5635,6 +5818,7 @@ static HRESULT  WINAPI  IWineD3DDeviceImpl_GetPaletteEntries(IWineD3DDevice *ifa
 static HRESULT  WINAPI  IWineD3DDeviceImpl_SetCurrentTexturePalette(IWineD3DDevice *iface, UINT PaletteNumber) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
     TRACE("(%p) : PaletteNumber %u\n", This, PaletteNumber);
+    wined3d_cs_sync(This);
     /* Native appears to silently abort on attempt to make an uninitialized palette current and render.
        (tested with reference rasterizer). Return Invalid Call. */
     if (PaletteNumber >= This->NumberOfPalettes || !This->palettes[PaletteNumber]) {
@@ -5652,6 +5836,7 @@ static HRESULT  WINAPI  IWineD3DDeviceImpl_SetCurrentTexturePalette(IWineD3DDevi
 
 static HRESULT  WINAPI  IWineD3DDeviceImpl_GetCurrentTexturePalette(IWineD3DDevice *iface, UINT* PaletteNumber) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
+    wined3d_cs_sync(This);
     if (PaletteNumber == NULL) {
         WARN("(%p) : returning Invalid Call\n", This);
         return WINED3DERR_INVALIDCALL;
@@ -5665,6 +5850,7 @@ static HRESULT  WINAPI  IWineD3DDeviceImpl_GetCurrentTexturePalette(IWineD3DDevi
 static HRESULT  WINAPI  IWineD3DDeviceImpl_SetSoftwareVertexProcessing(IWineD3DDevice *iface, BOOL bSoftware) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
     static BOOL showFixmes = TRUE;
+    wined3d_cs_sync(This);
     if (showFixmes) {
         FIXME("(%p) : stub\n", This);
         showFixmes = FALSE;
@@ -5748,6 +5934,7 @@ static HRESULT  WINAPI  IWineD3DDeviceImpl_UpdateSurface(IWineD3DDevice *iface,
     WINED3DSURFACE_DESC  winedesc;
 
     TRACE("(%p) : Source (%p)  Rect (%p) Destination (%p) Point(%p)\n", This, pSourceSurface, pSourceRect, pDestinationSurface, pDestPoint);
+    wined3d_cs_sync(This);
     memset(&winedesc, 0, sizeof(winedesc));
     winedesc.Width  = &srcSurfaceWidth;
     winedesc.Height = &srcSurfaceHeight;
@@ -5925,6 +6112,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_DrawRectPatch(IWineD3DDevice *iface, UI
     BOOL found;
     TRACE("(%p) Handle(%d) noSegs(%p) rectpatch(%p)\n", This, Handle, pNumSegs, pRectPatchInfo);
 
+    wined3d_cs_sync(This);
+
     if(!(Handle || pRectPatchInfo)) {
         /* TODO: Write a test for the return value, thus the FIXME */
         FIXME("Both Handle and pRectPatchInfo are NULL\n");
@@ -6003,6 +6192,7 @@ static HRESULT WINAPI IWineD3DDeviceImpl_DrawRectPatch(IWineD3DDevice *iface, UI
 static HRESULT WINAPI IWineD3DDeviceImpl_DrawTriPatch(IWineD3DDevice *iface, UINT Handle, CONST float* pNumSegs, CONST WINED3DTRIPATCH_INFO* pTriPatchInfo) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *)iface;
     TRACE("(%p) Handle(%d) noSegs(%p) tripatch(%p)\n", This, Handle, pNumSegs, pTriPatchInfo);
+    wined3d_cs_sync(This);
     FIXME("(%p) : Stub\n", This);
     return WINED3D_OK;
 }
@@ -6014,6 +6204,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_DeletePatch(IWineD3DDevice *iface, UINT
     struct list *e;
     TRACE("(%p) Handle(%d)\n", This, Handle);
 
+    wined3d_cs_sync(This);
+
     i = PATCHMAP_HASHFUNC(Handle);
     LIST_FOR_EACH(e, &This->patches[i]) {
         patch = LIST_ENTRY(e, struct WineD3DRectPatch, entry);
@@ -6117,7 +6309,7 @@ static void color_fill_fbo(IWineD3DDevice *iface, IWineD3DSurface *surface, CONS
     }
 
     if (rect) {
-        glEnable(GL_SCISSOR_TEST);
+        context_set_cap(This->activeContext, GL_SCISSOR_TEST, TRUE);
         if(!swapchain) {
             glScissor(rect->x1, rect->y1, rect->x2 - rect->x1, rect->y2 - rect->y1);
         } else {
@@ -6126,7 +6318,7 @@ static void color_fill_fbo(IWineD3DDevice *iface, IWineD3DSurface *surface, CONS
         }
         checkGLcall("glScissor");
     } else {
-        glDisable(GL_SCISSOR_TEST);
+        context_set_cap(This->activeContext, GL_SCISSOR_TEST, FALSE);
     }
     IWineD3DDeviceImpl_MarkStateDirty(This, STATE_RENDER(WINED3DRS_SCISSORTESTENABLE));
 
@@ -6264,6 +6456,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_ColorFill(IWineD3DDevice *iface, IWineD
     WINEDDBLTFX BltFx;
     TRACE("(%p) Colour fill Surface: %p rect: %p color: 0x%08x\n", This, pSurface, pRect, color);
 
+    wined3d_cs_sync(This);
+
     if (surface->resource.pool != WINED3DPOOL_DEFAULT && surface->resource.pool != WINED3DPOOL_SYSTEMMEM) {
         FIXME("call to colorfill with non WINED3DPOOL_DEFAULT or WINED3DPOOL_SYSTEMMEM surface\n");
         return WINED3DERR_INVALIDCALL;
@@ -6309,6 +6503,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetFrontBackBuffers(IWineD3DDevice *ifa
 
     TRACE("(%p)->(%p,%p)\n", This, FrontImpl, BackImpl);
 
+    wined3d_cs_sync(This);
+
     hr = IWineD3DDevice_GetSwapChain(iface, 0, (IWineD3DSwapChain **) &Swapchain);
     if(hr != WINED3D_OK) {
         ERR("Can't get the swapchain\n");
@@ -6648,7 +6844,7 @@ void stretch_rect_fbo(IWineD3DDevice *iface, IWineD3DSurface *src_surface, WINED
         glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
         checkGLcall("glDrawBuffer()");
     }
-    glDisable(GL_SCISSOR_TEST);
+    context_set_cap(This->activeContext, GL_SCISSOR_TEST, FALSE);
     IWineD3DDeviceImpl_MarkStateDirty(This, STATE_RENDER(WINED3DRS_SCISSORTESTENABLE));
 
     if (flip) {
@@ -6685,6 +6881,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetRenderTarget(IWineD3DDevice *iface,
 
     TRACE("(%p) : Setting rendertarget %d to %p\n", This, RenderTargetIndex, pRenderTarget);
 
+    wined3d_cs_sync(This);
+
     if (RenderTargetIndex >= GL_LIMITS(buffers)) {
         WARN("(%p) : Unsupported target %u set, returning WINED3DERR_INVALIDCALL(only %u supported)\n",
              This, RenderTargetIndex, GL_LIMITS(buffers));
@@ -6745,6 +6943,8 @@ static HRESULT WINAPI IWineD3DDeviceImpl_SetDepthStencilSurface(IWineD3DDevice *
 
     TRACE("(%p) Swapping z-buffer. Old = %p, new = %p\n",This, This->stencilBufferTarget, pNewZStencil);
 
+    wined3d_cs_sync(This);
+
     if (pNewZStencil == This->stencilBufferTarget) {
         TRACE("Trying to do a NOP SetRenderTarget operation\n");
     } else {
@@ -6783,6 +6983,8 @@ static HRESULT  WINAPI  IWineD3DDeviceImpl_SetCursorProperties(IWineD3DDevice* i
 
     TRACE("(%p) : Spot Pos(%u,%u)\n", This, XHotSpot, YHotSpot);
 
+    wined3d_cs_sync(This);
+
     /* some basic validation checks */
     if(This->cursorTexture) {
         ActivateContext(This, This->lastActiveRenderTarget, CTXUSAGE_RESOURCELOAD);
@@ -6926,6 +7128,8 @@ static void     WINAPI  IWineD3DDeviceImpl_SetCursorPosition(IWineD3DDevice* ifa
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *) iface;
     TRACE("(%p) : SetPos to (%u,%u)\n", This, XScreenSpace, YScreenSpace);
 
+    wined3d_cs_sync(This);
+
     This->xScreenSpace = XScreenSpace;
     This->yScreenSpace = YScreenSpace;
 
@@ -6940,6 +7144,8 @@ static BOOL     WINAPI  IWineD3DDeviceImpl_ShowCursor(IWineD3DDevice* iface, BOO
 
     TRACE("(%p) : visible(%d)\n", This, bShow);
 
+    wined3d_cs_sync(This);
+
     /*
      * When ShowCursor is first called it should make the cursor appear at the OS's last
      * known cursor position.  Because of this, some applications just repetitively call
@@ -6993,6 +7199,7 @@ static HRESULT  WINAPI  IWineD3DDeviceImpl_TestCooperativeLevel(IWineD3DDevice*
 
 static HRESULT  WINAPI  IWineD3DDeviceImpl_EvictManagedResources(IWineD3DDevice* iface) {
     IWineD3DDeviceImpl *This = (IWineD3DDeviceImpl *) iface;
+    wined3d_cs_sync(This);
     /** FIXME: Resource tracking needs to be done,
     * The closes we can do to this is set the priorities of all managed textures low
     * and then reset them.
@@ -7164,6 +7371,9 @@ static HRESULT WINAPI IWineD3DDeviceImpl_Reset(IWineD3DDevice* iface, WINED3DPRE
     TRACE("FullScreen_RefreshRateInHz = %d\n", pPresentationParameters->FullScreen_RefreshRateInHz);
     TRACE("PresentationInterval = %d\n", pPresentationParameters->PresentationInterval);
 
+    /* The command stream thread has the contexts destroyed below current, stop it first */
+    if(This->cs) wined3d_cs_destroy(This);
+
     /* No special treatment of these parameters. Just store them */
     swapchain->presentParms.SwapEffect = pPresentationParameters->SwapEffect;
     swapchain->presentParms.Flags = pPresentationParameters->Flags;
@@ -7307,6 +7517,12 @@ static HRESULT WINAPI IWineD3DDeviceImpl_Reset(IWineD3DDevice* iface, WINED3DPRE
 
 
     hr = This->shader_backend->shader_alloc_private(iface);
+
+    /* The command stream was torn down above, bring it back on the error path as well */
+    if(wined3d_settings.cs_multithreaded && FAILED(wined3d_cs_create(This))) {
+        WARN("Failed to recreate the command stream, continuing single threaded\n");
+    }
+
     if(FAILED(hr)) {
         ERR("Failed to recreate shader private data\n");
         return hr;
@@ -7390,6 +7606,7 @@ static void WINAPI IWineD3DDeviceImpl_ResourceReleased(IWineD3DDevice *iface, IW
     int counter;
 
     TRACE("(%p) : resource %p\n", This, resource);
+    wined3d_cs_sync(This);
     switch(IWineD3DResource_GetType(resource)){
         /* TODO: check front and back buffers, rendertargets etc..  possibly swapchains? */
         case WINED3DRTYPE_SURFACE: {
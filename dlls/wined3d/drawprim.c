@@ -1290,14 +1290,14 @@ HRESULT tesselate_rectpatch(IWineD3DDeviceImpl *This,
         float green[4] = {0, 1, 0, 0};
         float blue[4]  = {0, 0, 1, 0};
         float white[4] = {1, 1, 1, 1};
-        glEnable(GL_LIGHTING);
+        context_set_cap(This->activeContext, GL_LIGHTING, TRUE);
         checkGLcall("glEnable(GL_LIGHTING)");
         glLightModelfv(GL_LIGHT_MODEL_AMBIENT, black);
         checkGLcall("glLightModel for MODEL_AMBIENT");
         IWineD3DDeviceImpl_MarkStateDirty(This, STATE_RENDER(WINED3DRS_AMBIENT));
 
         for(i = 3; i < GL_LIMITS(lights); i++) {
-            glDisable(GL_LIGHT0 + i);
+            context_set_cap(This->activeContext, GL_LIGHT0 + i, FALSE);
             checkGLcall("glDisable(GL_LIGHT0 + i)");
             IWineD3DDeviceImpl_MarkStateDirty(This, STATE_ACTIVELIGHT(i));
         }
@@ -1307,26 +1307,26 @@ HRESULT tesselate_rectpatch(IWineD3DDeviceImpl *This,
         glLightfv(GL_LIGHT0, GL_SPECULAR, black);
         glLightfv(GL_LIGHT0, GL_AMBIENT, black);
         glLightfv(GL_LIGHT0, GL_POSITION, red);
-        glEnable(GL_LIGHT0);
+        context_set_cap(This->activeContext, GL_LIGHT0, TRUE);
         checkGLcall("Setting up light 1\n");
         IWineD3DDeviceImpl_MarkStateDirty(This, STATE_ACTIVELIGHT(1));
         glLightfv(GL_LIGHT1, GL_DIFFUSE, green);
         glLightfv(GL_LIGHT1, GL_SPECULAR, black);
         glLightfv(GL_LIGHT1, GL_AMBIENT, black);
         glLightfv(GL_LIGHT1, GL_POSITION, green);
-        glEnable(GL_LIGHT1);
+        context_set_cap(This->activeContext, GL_LIGHT1, TRUE);
         checkGLcall("Setting up light 2\n");
         IWineD3DDeviceImpl_MarkStateDirty(This, STATE_ACTIVELIGHT(2));
         glLightfv(GL_LIGHT2, GL_DIFFUSE, blue);
         glLightfv(GL_LIGHT2, GL_SPECULAR, black);
         glLightfv(GL_LIGHT2, GL_AMBIENT, black);
         glLightfv(GL_LIGHT2, GL_POSITION, blue);
-        glEnable(GL_LIGHT2);
+        context_set_cap(This->activeContext, GL_LIGHT2, TRUE);
         checkGLcall("Setting up light 3\n");
 
         IWineD3DDeviceImpl_MarkStateDirty(This, STATE_MATERIAL);
         IWineD3DDeviceImpl_MarkStateDirty(This, STATE_RENDER(WINED3DRS_COLORVERTEX));
-        glDisable(GL_COLOR_MATERIAL);
+        context_set_cap(This->activeContext, GL_COLOR_MATERIAL, FALSE);
         glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, black);
         glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, black);
         glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, white);
@@ -154,13 +154,27 @@ static void shader_glsl_load_vsamplers(WineD3D_GL_Info *gl_info, IWineD3DStateBl
     }
 }
 
+/* Uniforms keep their values while the program isn't used, so only the registers whose value
+ * differs from the last one loaded into this program need an upload
+ */
+static inline void shader_glsl_load_uniform4f(WineD3D_GL_Info *gl_info, WineD3DContext *context,
+        GLhandleARB location, float *loaded, const float *value) {
+    if(!memcmp(loaded, value, 4 * sizeof(float))) {
+        context->gl_calls_skipped++;
+        return;
+    }
+    memcpy(loaded, value, 4 * sizeof(float));
+    context->gl_calls++;
+    GL_EXTCALL(glUniform4fvARB(location, 1, value));
+}
+
 /** 
  * Loads floating point constants (aka uniforms) into the currently set GLSL program.
  * When constant_list == NULL, it will load all the constants.
  */
 static void shader_glsl_load_constantsF(IWineD3DBaseShaderImpl* This, WineD3D_GL_Info *gl_info,
-        unsigned int max_constants, float* constants, GLhandleARB *constant_locations,
-        struct list *constant_list) {
+        WineD3DContext *context, unsigned int max_constants, float* constants,
+        GLhandleARB *constant_locations, float *loaded_constants, struct list *constant_list) {
     constants_entry *constant;
     local_constant* lconst;
     GLhandleARB tmp_loc;
@@ -210,7 +224,7 @@ static void shader_glsl_load_constantsF(IWineD3DBaseShaderImpl* This, WineD3D_GL
                     else if(constants[k + 3] > 1.0) lcl_const[3] = 1.0;
                     else lcl_const[3] = constants[k + 3];
 
-                    GL_EXTCALL(glUniform4fvARB(tmp_loc, 1, lcl_const));
+                    shader_glsl_load_uniform4f(gl_info, context, tmp_loc, loaded_constants + k, lcl_const);
                 }
             }
         }
@@ -223,7 +237,8 @@ static void shader_glsl_load_constantsF(IWineD3DBaseShaderImpl* This, WineD3D_GL
                 tmp_loc = constant_locations[i];
                 if (tmp_loc != -1) {
                     /* We found this uniform name in the program - go ahead and send the data */
-                    GL_EXTCALL(glUniform4fvARB(tmp_loc, 1, constants + (i * 4)));
+                    shader_glsl_load_uniform4f(gl_info, context, tmp_loc, loaded_constants + (i * 4),
+                                               constants + (i * 4));
                 }
             }
         }
@@ -251,7 +266,8 @@ static void shader_glsl_load_constantsF(IWineD3DBaseShaderImpl* This, WineD3D_GL
         tmp_loc = constant_locations[lconst->idx];
         if (tmp_loc != -1) {
             /* We found this uniform name in the program - go ahead and send the data */
-            GL_EXTCALL(glUniform4fvARB(tmp_loc, 1, (GLfloat*)lconst->value));
+            shader_glsl_load_uniform4f(gl_info, context, tmp_loc, loaded_constants + (lconst->idx * 4),
+                                       (GLfloat*)lconst->value);
         }
     }
     checkGLcall("glUniform4fvARB()");
@@ -391,8 +407,8 @@ void shader_glsl_load_constants(
         constant_list = &stateBlock->set_vconstantsF;
 
         /* Load DirectX 9 float constants/uniforms for vertex shader */
-        shader_glsl_load_constantsF(vshader, gl_info, GL_LIMITS(vshader_constantsF),
-                stateBlock->vertexShaderConstantF, constant_locations, constant_list);
+        shader_glsl_load_constantsF(vshader, gl_info, deviceImpl->activeContext, GL_LIMITS(vshader_constantsF),
+                stateBlock->vertexShaderConstantF, constant_locations, prog->vuniformF_values, constant_list);
 
         /* Load DirectX 9 integer constants/uniforms for vertex shader */
         shader_glsl_load_constantsI(vshader, gl_info, programId,
@@ -418,8 +434,8 @@ void shader_glsl_load_constants(
         constant_list = &stateBlock->set_pconstantsF;
 
         /* Load DirectX 9 float constants/uniforms for pixel shader */
-        shader_glsl_load_constantsF(pshader, gl_info, GL_LIMITS(pshader_constantsF),
-                stateBlock->pixelShaderConstantF, constant_locations, constant_list);
+        shader_glsl_load_constantsF(pshader, gl_info, deviceImpl->activeContext, GL_LIMITS(pshader_constantsF),
+                stateBlock->pixelShaderConstantF, constant_locations, prog->puniformF_values, constant_list);
 
         /* Load DirectX 9 integer constants/uniforms for pixel shader */
         shader_glsl_load_constantsI(pshader, gl_info, programId,
@@ -2816,6 +2832,8 @@ void delete_glsl_program_entry(IWineD3DDevice *iface, struct glsl_shader_prog_li
     if (entry->pshader) list_remove(&entry->pshader_entry);
     HeapFree(GetProcessHeap(), 0, entry->vuniformF_locations);
     HeapFree(GetProcessHeap(), 0, entry->puniformF_locations);
+    HeapFree(GetProcessHeap(), 0, entry->vuniformF_values);
+    HeapFree(GetProcessHeap(), 0, entry->puniformF_values);
     HeapFree(GetProcessHeap(), 0, entry);
 }
 
@@ -3236,11 +3254,14 @@ static void set_glsl_shader_program(IWineD3DDevice *iface, BOOL use_ps, BOOL use
         snprintf(glsl_name, sizeof(glsl_name), "VI[%i]", i);
         entry->vuniformI_locations[i] = GL_EXTCALL(glGetUniformLocationARB(programId, glsl_name));
     }
+    /* Uniforms are 0 after linking */
+    entry->vuniformF_values = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(float) * 4 * GL_LIMITS(vshader_constantsF));
     entry->puniformF_locations = HeapAlloc(GetProcessHeap(), 0, sizeof(GLhandleARB) * GL_LIMITS(pshader_constantsF));
     for (i = 0; i < GL_LIMITS(pshader_constantsF); ++i) {
         snprintf(glsl_name, sizeof(glsl_name), "PC[%i]", i);
         entry->puniformF_locations[i] = GL_EXTCALL(glGetUniformLocationARB(programId, glsl_name));
     }
+    entry->puniformF_values = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(float) * 4 * GL_LIMITS(pshader_constantsF));
     for (i = 0; i < MAX_CONST_I; ++i) {
         snprintf(glsl_name, sizeof(glsl_name), "PI[%i]", i);
         entry->puniformI_locations[i] = GL_EXTCALL(glGetUniformLocationARB(programId, glsl_name));
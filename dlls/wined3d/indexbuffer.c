@@ -147,6 +147,8 @@ static HRESULT WINAPI IWineD3DIndexBufferImpl_Lock(IWineD3DIndexBuffer *iface, U
     IWineD3DIndexBufferImpl *This = (IWineD3DIndexBufferImpl *)iface;
     TRACE("(%p) : offset %d, size %d, Flags=%x\n", This, OffsetToLock, SizeToLock, Flags);
 
+    /* Queued draws may still read the old contents */
+    wined3d_cs_sync(This->resource.wineD3DDevice);
     InterlockedIncrement(&This->lockcount);
     *ppbData = This->resource.allocatedMemory + OffsetToLock;
 
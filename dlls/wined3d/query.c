@@ -56,29 +56,38 @@ static ULONG  WINAPI IWineD3DQueryImpl_AddRef(IWineD3DQuery *iface) {
     return InterlockedIncrement(&This->ref);
 }
 
+void query_destroy(IWineD3DQueryImpl *This) {
+    ENTER_GL();
+    if(This->type == WINED3DQUERYTYPE_EVENT) {
+        if(GL_SUPPORT(APPLE_FENCE)) {
+            GL_EXTCALL(glDeleteFencesAPPLE(1, &((WineQueryEventData *)(This->extendedData))->fenceId));
+            checkGLcall("glDeleteFencesAPPLE");
+        } else if(GL_SUPPORT(NV_FENCE)) {
+            GL_EXTCALL(glDeleteFencesNV(1, &((WineQueryEventData *)(This->extendedData))->fenceId));
+            checkGLcall("glDeleteFencesNV");
+        }
+    } else if(This->type == WINED3DQUERYTYPE_OCCLUSION && GL_SUPPORT(ARB_OCCLUSION_QUERY)) {
+        GL_EXTCALL(glDeleteQueriesARB(1, &((WineQueryOcclusionData *)(This->extendedData))->queryId));
+        checkGLcall("glDeleteQueriesARB");
+    }
+    LEAVE_GL();
+
+    HeapFree(GetProcessHeap(), 0, This->extendedData);
+    HeapFree(GetProcessHeap(), 0, This);
+}
+
 static ULONG  WINAPI IWineD3DQueryImpl_Release(IWineD3DQuery *iface) {
     IWineD3DQueryImpl *This = (IWineD3DQueryImpl *)iface;
     ULONG ref;
     TRACE("(%p) : Releasing from %d\n", This, This->ref);
     ref = InterlockedDecrement(&This->ref);
     if (ref == 0) {
-        ENTER_GL();
-        if(This->type == WINED3DQUERYTYPE_EVENT) {
-            if(GL_SUPPORT(APPLE_FENCE)) {
-                GL_EXTCALL(glDeleteFencesAPPLE(1, &((WineQueryEventData *)(This->extendedData))->fenceId));
-                checkGLcall("glDeleteFencesAPPLE");
-            } else if(GL_SUPPORT(NV_FENCE)) {
-                GL_EXTCALL(glDeleteFencesNV(1, &((WineQueryEventData *)(This->extendedData))->fenceId));
-                checkGLcall("glDeleteFencesNV");
-            }
-        } else if(This->type == WINED3DQUERYTYPE_OCCLUSION && GL_SUPPORT(ARB_OCCLUSION_QUERY)) {
-            GL_EXTCALL(glDeleteQueriesARB(1, &((WineQueryOcclusionData *)(This->extendedData))->queryId));
-            checkGLcall("glDeleteQueriesARB");
+        /* The fences and queries were created in the context of the command stream thread */
+        if(wined3d_cs_defer(This->wineD3DDevice)) {
+            wined3d_cs_emit_query_destroy(This->wineD3DDevice->cs, iface);
+        } else {
+            query_destroy(This);
         }
-        LEAVE_GL();
-
-        HeapFree(GetProcessHeap(), 0, This->extendedData);
-        HeapFree(GetProcessHeap(), 0, This);
     }
     return ref;
 }
@@ -272,6 +281,10 @@ static HRESULT  WINAPI IWineD3DOcclusionQueryImpl_GetData(IWineD3DQuery* iface,
     HRESULT res;
     TRACE("(%p) : type D3DQUERY_OCCLUSION, pData %p, dwSize %#x, dwGetDataFlags %#x\n", This, pData, dwSize, dwGetDataFlags);
 
+    if(wined3d_cs_defer(This->wineD3DDevice)) {
+        return wined3d_cs_emit_query_get_data(This->wineD3DDevice->cs, iface, pData, dwSize, dwGetDataFlags);
+    }
+
     if(This->state == QUERY_CREATED) {
         /* D3D allows GetData on a new query, OpenGL doesn't. So just invent the data ourselves */
         TRACE("Query wasn't yet started, returning S_OK\n");
@@ -319,6 +332,10 @@ static HRESULT  WINAPI IWineD3DEventQueryImpl_GetData(IWineD3DQuery* iface, void
     WineD3DContext *ctx;
     TRACE("(%p) : type D3DQUERY_EVENT, pData %p, dwSize %#x, dwGetDataFlags %#x\n", This, pData, dwSize, dwGetDataFlags);
 
+    if(wined3d_cs_defer(This->wineD3DDevice) && pData && dwSize) {
+        return wined3d_cs_emit_query_get_data(This->wineD3DDevice->cs, iface, pData, dwSize, dwGetDataFlags);
+    }
+
     ctx = ((WineQueryEventData *)This->extendedData)->ctx;
     if(pData == NULL || dwSize == 0) {
         return S_OK;
@@ -417,6 +434,10 @@ static HRESULT  WINAPI IWineD3DEventQueryImpl_Issue(IWineD3DQuery* iface,  DWORD
     IWineD3DQueryImpl *This = (IWineD3DQueryImpl *)iface;
 
     TRACE("(%p) : dwIssueFlags %#x, type D3DQUERY_EVENT\n", This, dwIssueFlags);
+    if(wined3d_cs_defer(This->wineD3DDevice)) {
+        return wined3d_cs_emit_query_issue(This->wineD3DDevice->cs, iface, dwIssueFlags);
+    }
+
     if (dwIssueFlags & WINED3DISSUE_END) {
         WineD3DContext *ctx = ((WineQueryEventData *)This->extendedData)->ctx;
         if(ctx != This->wineD3DDevice->activeContext || ctx->tid != GetCurrentThreadId()) {
@@ -456,6 +477,10 @@ static HRESULT  WINAPI IWineD3DEventQueryImpl_Issue(IWineD3DQuery* iface,  DWORD
 static HRESULT  WINAPI IWineD3DOcclusionQueryImpl_Issue(IWineD3DQuery* iface,  DWORD dwIssueFlags) {
     IWineD3DQueryImpl *This = (IWineD3DQueryImpl *)iface;
 
+    if(wined3d_cs_defer(This->wineD3DDevice)) {
+        return wined3d_cs_emit_query_issue(This->wineD3DDevice->cs, iface, dwIssueFlags);
+    }
+
     if (GL_SUPPORT(ARB_OCCLUSION_QUERY)) {
         WineD3DContext *ctx = ((WineQueryOcclusionData *)This->extendedData)->ctx;
 
@@ -98,10 +98,10 @@ static void state_lighting(DWORD state, IWineD3DStateBlockImpl *stateblock, Wine
                     stateblock->wineD3DDevice->strided_streams.u.s.position_transformed) ? TRUE : FALSE;
 
     if (stateblock->renderState[WINED3DRS_LIGHTING] && !transformed) {
-        glEnable(GL_LIGHTING);
+        context_set_cap(context, GL_LIGHTING, TRUE);
         checkGLcall("glEnable GL_LIGHTING");
     } else {
-        glDisable(GL_LIGHTING);
+        context_set_cap(context, GL_LIGHTING, FALSE);
         checkGLcall("glDisable GL_LIGHTING");
     }
 }
@@ -110,22 +110,22 @@ static void state_zenable(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD
     /* No z test without depth stencil buffers */
     if(stateblock->wineD3DDevice->stencilBufferTarget == NULL) {
         TRACE("No Z buffer - disabling depth test\n");
-        glDisable(GL_DEPTH_TEST); /* This also disables z writing in gl */
+        context_set_cap(context, GL_DEPTH_TEST, FALSE); /* This also disables z writing in gl */
         checkGLcall("glDisable GL_DEPTH_TEST");
         return;
     }
 
     switch ((WINED3DZBUFFERTYPE) stateblock->renderState[WINED3DRS_ZENABLE]) {
         case WINED3DZB_FALSE:
-            glDisable(GL_DEPTH_TEST);
+            context_set_cap(context, GL_DEPTH_TEST, FALSE);
             checkGLcall("glDisable GL_DEPTH_TEST");
             break;
         case WINED3DZB_TRUE:
-            glEnable(GL_DEPTH_TEST);
+            context_set_cap(context, GL_DEPTH_TEST, TRUE);
             checkGLcall("glEnable GL_DEPTH_TEST");
             break;
         case WINED3DZB_USEW:
-            glEnable(GL_DEPTH_TEST);
+            context_set_cap(context, GL_DEPTH_TEST, TRUE);
             checkGLcall("glEnable GL_DEPTH_TEST");
             FIXME("W buffer is not well handled\n");
             break;
@@ -140,17 +140,17 @@ static void state_cullmode(DWORD state, IWineD3DStateBlockImpl *stateblock, Wine
      */
     switch ((WINED3DCULL) stateblock->renderState[WINED3DRS_CULLMODE]) {
         case WINED3DCULL_NONE:
-            glDisable(GL_CULL_FACE);
+            context_set_cap(context, GL_CULL_FACE, FALSE);
             checkGLcall("glDisable GL_CULL_FACE");
             break;
         case WINED3DCULL_CW:
-            glEnable(GL_CULL_FACE);
+            context_set_cap(context, GL_CULL_FACE, TRUE);
             checkGLcall("glEnable GL_CULL_FACE");
             glCullFace(GL_FRONT);
             checkGLcall("glCullFace(GL_FRONT)");
             break;
         case WINED3DCULL_CCW:
-            glEnable(GL_CULL_FACE);
+            context_set_cap(context, GL_CULL_FACE, TRUE);
             checkGLcall("glEnable GL_CULL_FACE");
             glCullFace(GL_BACK);
             checkGLcall("glCullFace(GL_BACK)");
@@ -180,10 +180,10 @@ static void state_shademode(DWORD state, IWineD3DStateBlockImpl *stateblock, Win
 
 static void state_ditherenable(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3DContext *context) {
     if (stateblock->renderState[WINED3DRS_DITHERENABLE]) {
-        glEnable(GL_DITHER);
+        context_set_cap(context, GL_DITHER, TRUE);
         checkGLcall("glEnable GL_DITHER");
     } else {
-        glDisable(GL_DITHER);
+        context_set_cap(context, GL_DITHER, FALSE);
         checkGLcall("glDisable GL_DITHER");
     }
 }
@@ -249,15 +249,15 @@ static void state_blend(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3D
         /* Disable blending in all cases even without pixelshaders. With blending on we could face a big performance penalty.
          * The d3d9 visual test confirms the behavior. */
         if(!(glDesc->Flags & WINED3DFMT_FLAG_POSTPIXELSHADER_BLENDING)) {
-            glDisable(GL_BLEND);
+            context_set_cap(context, GL_BLEND, FALSE);
             checkGLcall("glDisable GL_BLEND");
             return;
         } else {
-            glEnable(GL_BLEND);
+            context_set_cap(context, GL_BLEND, TRUE);
             checkGLcall("glEnable GL_BLEND");
         }
     } else {
-        glDisable(GL_BLEND);
+        context_set_cap(context, GL_BLEND, FALSE);
         checkGLcall("glDisable GL_BLEND");
         /* Nothing more to do - get out */
         return;
@@ -347,7 +347,7 @@ static void state_blend(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3D
 
     if(stateblock->renderState[WINED3DRS_EDGEANTIALIAS] ||
        stateblock->renderState[WINED3DRS_ANTIALIASEDLINEENABLE]) {
-        glEnable(GL_LINE_SMOOTH);
+        context_set_cap(context, GL_LINE_SMOOTH, TRUE);
         checkGLcall("glEnable(GL_LINE_SMOOTH)");
         if(srcBlend != GL_SRC_ALPHA) {
             WARN("WINED3DRS_EDGEANTIALIAS enabled, but unexpected src blending param\n");
@@ -356,7 +356,7 @@ static void state_blend(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3D
             WARN("WINED3DRS_EDGEANTIALIAS enabled, but unexpected dst blending param\n");
         }
     } else {
-        glDisable(GL_LINE_SMOOTH);
+        context_set_cap(context, GL_LINE_SMOOTH, FALSE);
         checkGLcall("glDisable(GL_LINE_SMOOTH)");
     }
 
@@ -503,10 +503,10 @@ static void state_alpha(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3D
 
     if (stateblock->renderState[WINED3DRS_ALPHATESTENABLE] ||
         (stateblock->renderState[WINED3DRS_COLORKEYENABLE] && enable_ckey)) {
-        glEnable(GL_ALPHA_TEST);
+        context_set_cap(context, GL_ALPHA_TEST, TRUE);
         checkGLcall("glEnable GL_ALPHA_TEST");
     } else {
-        glDisable(GL_ALPHA_TEST);
+        context_set_cap(context, GL_ALPHA_TEST, FALSE);
         checkGLcall("glDisable GL_ALPHA_TEST");
         /* Alpha test is disabled, don't bother setting the params - it will happen on the next
          * enable call
@@ -558,31 +558,31 @@ static void state_clipping(DWORD state, IWineD3DStateBlockImpl *stateblock, Wine
         enable  = stateblock->renderState[WINED3DRS_CLIPPLANEENABLE];
         disable = ~stateblock->renderState[WINED3DRS_CLIPPLANEENABLE];
         if(GL_SUPPORT(NV_DEPTH_CLAMP)) {
-            glDisable(GL_DEPTH_CLAMP_NV);
+            context_set_cap(context, GL_DEPTH_CLAMP_NV, FALSE);
             checkGLcall("glDisable(GL_DEPTH_CLAMP_NV)");
         }
     } else {
         disable = 0xffffffff;
         enable  = 0x00;
         if(GL_SUPPORT(NV_DEPTH_CLAMP)) {
-            glEnable(GL_DEPTH_CLAMP_NV);
+            context_set_cap(context, GL_DEPTH_CLAMP_NV, TRUE);
             checkGLcall("glEnable(GL_DEPTH_CLAMP_NV)");
         }
     }
 
-    if (enable & WINED3DCLIPPLANE0)  { glEnable(GL_CLIP_PLANE0);  checkGLcall("glEnable(clip plane 0)"); }
-    if (enable & WINED3DCLIPPLANE1)  { glEnable(GL_CLIP_PLANE1);  checkGLcall("glEnable(clip plane 1)"); }
-    if (enable & WINED3DCLIPPLANE2)  { glEnable(GL_CLIP_PLANE2);  checkGLcall("glEnable(clip plane 2)"); }
-    if (enable & WINED3DCLIPPLANE3)  { glEnable(GL_CLIP_PLANE3);  checkGLcall("glEnable(clip plane 3)"); }
-    if (enable & WINED3DCLIPPLANE4)  { glEnable(GL_CLIP_PLANE4);  checkGLcall("glEnable(clip plane 4)"); }
-    if (enable & WINED3DCLIPPLANE5)  { glEnable(GL_CLIP_PLANE5);  checkGLcall("glEnable(clip plane 5)"); }
+    if (enable & WINED3DCLIPPLANE0)  { context_set_cap(context, GL_CLIP_PLANE0, TRUE);  checkGLcall("glEnable(clip plane 0)"); }
+    if (enable & WINED3DCLIPPLANE1)  { context_set_cap(context, GL_CLIP_PLANE1, TRUE);  checkGLcall("glEnable(clip plane 1)"); }
+    if (enable & WINED3DCLIPPLANE2)  { context_set_cap(context, GL_CLIP_PLANE2, TRUE);  checkGLcall("glEnable(clip plane 2)"); }
+    if (enable & WINED3DCLIPPLANE3)  { context_set_cap(context, GL_CLIP_PLANE3, TRUE);  checkGLcall("glEnable(clip plane 3)"); }
+    if (enable & WINED3DCLIPPLANE4)  { context_set_cap(context, GL_CLIP_PLANE4, TRUE);  checkGLcall("glEnable(clip plane 4)"); }
+    if (enable & WINED3DCLIPPLANE5)  { context_set_cap(context, GL_CLIP_PLANE5, TRUE);  checkGLcall("glEnable(clip plane 5)"); }
 
-    if (disable & WINED3DCLIPPLANE0) { glDisable(GL_CLIP_PLANE0); checkGLcall("glDisable(clip plane 0)"); }
-    if (disable & WINED3DCLIPPLANE1) { glDisable(GL_CLIP_PLANE1); checkGLcall("glDisable(clip plane 1)"); }
-    if (disable & WINED3DCLIPPLANE2) { glDisable(GL_CLIP_PLANE2); checkGLcall("glDisable(clip plane 2)"); }
-    if (disable & WINED3DCLIPPLANE3) { glDisable(GL_CLIP_PLANE3); checkGLcall("glDisable(clip plane 3)"); }
-    if (disable & WINED3DCLIPPLANE4) { glDisable(GL_CLIP_PLANE4); checkGLcall("glDisable(clip plane 4)"); }
-    if (disable & WINED3DCLIPPLANE5) { glDisable(GL_CLIP_PLANE5); checkGLcall("glDisable(clip plane 5)"); }
+    if (disable & WINED3DCLIPPLANE0) { context_set_cap(context, GL_CLIP_PLANE0, FALSE); checkGLcall("glDisable(clip plane 0)"); }
+    if (disable & WINED3DCLIPPLANE1) { context_set_cap(context, GL_CLIP_PLANE1, FALSE); checkGLcall("glDisable(clip plane 1)"); }
+    if (disable & WINED3DCLIPPLANE2) { context_set_cap(context, GL_CLIP_PLANE2, FALSE); checkGLcall("glDisable(clip plane 2)"); }
+    if (disable & WINED3DCLIPPLANE3) { context_set_cap(context, GL_CLIP_PLANE3, FALSE); checkGLcall("glDisable(clip plane 3)"); }
+    if (disable & WINED3DCLIPPLANE4) { context_set_cap(context, GL_CLIP_PLANE4, FALSE); checkGLcall("glDisable(clip plane 4)"); }
+    if (disable & WINED3DCLIPPLANE5) { context_set_cap(context, GL_CLIP_PLANE5, FALSE); checkGLcall("glDisable(clip plane 5)"); }
 
     /** update clipping status */
     if (enable) {
@@ -692,7 +692,7 @@ state_specularenable(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3DCon
         checkGLcall("glMaterialf(GL_SHININESS)");
 
         if (GL_SUPPORT(EXT_SECONDARY_COLOR)) {
-            glEnable(GL_COLOR_SUM_EXT);
+            context_set_cap(context, GL_COLOR_SUM_EXT, TRUE);
         } else {
             TRACE("Specular colors cannot be enabled in this version of opengl\n");
         }
@@ -711,7 +711,7 @@ state_specularenable(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3DCon
 
         /* for the case of disabled lighting: */
         if (GL_SUPPORT(EXT_SECONDARY_COLOR)) {
-            glDisable(GL_COLOR_SUM_EXT);
+            context_set_cap(context, GL_COLOR_SUM_EXT, FALSE);
         } else {
             TRACE("Specular colors cannot be disabled in this version of opengl\n");
         }
@@ -799,7 +799,7 @@ state_stencil(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3DContext *c
 
     /* No stencil test without a stencil buffer */
     if(stateblock->wineD3DDevice->stencilBufferTarget == NULL) {
-        glDisable(GL_STENCIL_TEST);
+        context_set_cap(context, GL_STENCIL_TEST, FALSE);
         checkGLcall("glDisable GL_STENCIL_TEST");
         return;
     }
@@ -827,7 +827,7 @@ state_stencil(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3DContext *c
     func_ccw, stencilFail_ccw, depthFail_ccw, stencilPass_ccw);
 
     if (twosided_enable && onesided_enable) {
-        glEnable(GL_STENCIL_TEST);
+        context_set_cap(context, GL_STENCIL_TEST, TRUE);
         checkGLcall("glEnable GL_STENCIL_TEST");
 
         if(GL_SUPPORT(EXT_STENCIL_TWO_SIDE)) {
@@ -860,14 +860,14 @@ state_stencil(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3DContext *c
         /* This code disables the ATI extension as well, since the standard stencil functions are equal
          * to calling the ATI functions with GL_FRONT_AND_BACK as face parameter
          */
-        glEnable(GL_STENCIL_TEST);
+        context_set_cap(context, GL_STENCIL_TEST, TRUE);
         checkGLcall("glEnable GL_STENCIL_TEST");
         glStencilFunc(func, ref, mask);
         checkGLcall("glStencilFunc(...)");
         glStencilOp(stencilFail, depthFail, stencilPass);
         checkGLcall("glStencilOp(...)");
     } else {
-        glDisable(GL_STENCIL_TEST);
+        context_set_cap(context, GL_STENCIL_TEST, FALSE);
         checkGLcall("glDisable GL_STENCIL_TEST");
     }
 }
@@ -909,7 +909,7 @@ static void state_fog(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3DCo
 
     if (!fogenable) {
         /* No fog? Disable it, and we're done :-) */
-        glDisable(GL_FOG);
+        context_set_cap(context, GL_FOG, FALSE);
         checkGLcall("glDisable GL_FOG");
         if( use_ps(stateblock->wineD3DDevice)
                 && ((IWineD3DPixelShaderImpl *)stateblock->pixelShader)->baseShader.hex_version < WINED3DPS_VERSION(3,0) ) {
@@ -1146,7 +1146,7 @@ static void state_fog(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3DCo
     }
 
     if(fogenable) {
-        glEnable(GL_FOG);
+        context_set_cap(context, GL_FOG, TRUE);
         checkGLcall("glEnable GL_FOG");
 
         if(fogstart != fogend)
@@ -1170,7 +1170,7 @@ static void state_fog(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3DCo
             TRACE("Fog End == %f\n", fogend);
         }
     } else {
-        glDisable(GL_FOG);
+        context_set_cap(context, GL_FOG, FALSE);
         checkGLcall("glDisable GL_FOG");
         if( use_ps(stateblock->wineD3DDevice) ) {
             /* disable fog in the pixel shader
@@ -1282,12 +1282,12 @@ static void state_colormat(DWORD state, IWineD3DStateBlockImpl *stateblock, Wine
     if (Parm == context->tracking_parm) return;
 
     if(!Parm) {
-        glDisable(GL_COLOR_MATERIAL);
+        context_set_cap(context, GL_COLOR_MATERIAL, FALSE);
         checkGLcall("glDisable GL_COLOR_MATERIAL");
     } else {
         glColorMaterial(GL_FRONT_AND_BACK, Parm);
         checkGLcall("glColorMaterial(GL_FRONT_AND_BACK, Parm)");
-        glEnable(GL_COLOR_MATERIAL);
+        context_set_cap(context, GL_COLOR_MATERIAL, TRUE);
         checkGLcall("glEnable(GL_COLOR_MATERIAL)");
     }
 
@@ -1343,10 +1343,10 @@ static void state_linepattern(DWORD state, IWineD3DStateBlockImpl *stateblock, W
     if (tmppattern.lp.wRepeatFactor) {
         glLineStipple(tmppattern.lp.wRepeatFactor, tmppattern.lp.wLinePattern);
         checkGLcall("glLineStipple(repeat, linepattern)");
-        glEnable(GL_LINE_STIPPLE);
+        context_set_cap(context, GL_LINE_STIPPLE, TRUE);
         checkGLcall("glEnable(GL_LINE_STIPPLE);");
     } else {
-        glDisable(GL_LINE_STIPPLE);
+        context_set_cap(context, GL_LINE_STIPPLE, FALSE);
         checkGLcall("glDisable(GL_LINE_STIPPLE);");
     }
 }
@@ -1362,18 +1362,18 @@ static void state_zbias(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3D
         TRACE("ZBias value %f\n", tmpvalue.f);
         glPolygonOffset(0, -tmpvalue.f);
         checkGLcall("glPolygonOffset(0, -Value)");
-        glEnable(GL_POLYGON_OFFSET_FILL);
+        context_set_cap(context, GL_POLYGON_OFFSET_FILL, TRUE);
         checkGLcall("glEnable(GL_POLYGON_OFFSET_FILL);");
-        glEnable(GL_POLYGON_OFFSET_LINE);
+        context_set_cap(context, GL_POLYGON_OFFSET_LINE, TRUE);
         checkGLcall("glEnable(GL_POLYGON_OFFSET_LINE);");
-        glEnable(GL_POLYGON_OFFSET_POINT);
+        context_set_cap(context, GL_POLYGON_OFFSET_POINT, TRUE);
         checkGLcall("glEnable(GL_POLYGON_OFFSET_POINT);");
     } else {
-        glDisable(GL_POLYGON_OFFSET_FILL);
+        context_set_cap(context, GL_POLYGON_OFFSET_FILL, FALSE);
         checkGLcall("glDisable(GL_POLYGON_OFFSET_FILL);");
-        glDisable(GL_POLYGON_OFFSET_LINE);
+        context_set_cap(context, GL_POLYGON_OFFSET_LINE, FALSE);
         checkGLcall("glDisable(GL_POLYGON_OFFSET_LINE);");
-        glDisable(GL_POLYGON_OFFSET_POINT);
+        context_set_cap(context, GL_POLYGON_OFFSET_POINT, FALSE);
         checkGLcall("glDisable(GL_POLYGON_OFFSET_POINT);");
     }
 }
@@ -1390,10 +1390,10 @@ static void state_normalize(DWORD state, IWineD3DStateBlockImpl *stateblock, Win
     if (stateblock->renderState[WINED3DRS_NORMALIZENORMALS] && (
         stateblock->wineD3DDevice->strided_streams.u.s.normal.lpData ||
         stateblock->wineD3DDevice->strided_streams.u.s.normal.VBO)) {
-        glEnable(GL_NORMALIZE);
+        context_set_cap(context, GL_NORMALIZE, TRUE);
         checkGLcall("glEnable(GL_NORMALIZE);");
     } else {
-        glDisable(GL_NORMALIZE);
+        context_set_cap(context, GL_NORMALIZE, FALSE);
         checkGLcall("glDisable(GL_NORMALIZE);");
     }
 }
@@ -1563,10 +1563,10 @@ static void state_pointsprite(DWORD state, IWineD3DStateBlockImpl *stateblock, W
     }
 
     if (stateblock->renderState[WINED3DRS_POINTSPRITEENABLE]) {
-        glEnable(GL_POINT_SPRITE_ARB);
+        context_set_cap(context, GL_POINT_SPRITE_ARB, TRUE);
         checkGLcall("glEnable(GL_POINT_SPRITE_ARB)");
     } else {
-        glDisable(GL_POINT_SPRITE_ARB);
+        context_set_cap(context, GL_POINT_SPRITE_ARB, FALSE);
         checkGLcall("glDisable(GL_POINT_SPRITE_ARB)");
     }
 }
@@ -1604,10 +1604,10 @@ static void state_wrap(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3DC
 static void state_multisampleaa(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3DContext *context) {
     if( GL_SUPPORT(ARB_MULTISAMPLE) ) {
         if(stateblock->renderState[WINED3DRS_MULTISAMPLEANTIALIAS]) {
-            glEnable(GL_MULTISAMPLE_ARB);
+            context_set_cap(context, GL_MULTISAMPLE_ARB, TRUE);
             checkGLcall("glEnable(GL_MULTISAMPLE_ARB)");
         } else {
-            glDisable(GL_MULTISAMPLE_ARB);
+            context_set_cap(context, GL_MULTISAMPLE_ARB, FALSE);
             checkGLcall("glDisable(GL_MULTISAMPLE_ARB)");
         }
     } else {
@@ -1619,10 +1619,10 @@ static void state_multisampleaa(DWORD state, IWineD3DStateBlockImpl *stateblock,
 
 static void state_scissor(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3DContext *context) {
     if(stateblock->renderState[WINED3DRS_SCISSORTESTENABLE]) {
-        glEnable(GL_SCISSOR_TEST);
+        context_set_cap(context, GL_SCISSOR_TEST, TRUE);
         checkGLcall("glEnable(GL_SCISSOR_TEST)");
     } else {
-        glDisable(GL_SCISSOR_TEST);
+        context_set_cap(context, GL_SCISSOR_TEST, FALSE);
         checkGLcall("glDisable(GL_SCISSOR_TEST)");
     }
 }
@@ -1636,12 +1636,12 @@ static void state_depthbias(DWORD state, IWineD3DStateBlockImpl *stateblock, Win
     if(stateblock->renderState[WINED3DRS_SLOPESCALEDEPTHBIAS] ||
        stateblock->renderState[WINED3DRS_DEPTHBIAS]) {
         tmpvalue.d = stateblock->renderState[WINED3DRS_SLOPESCALEDEPTHBIAS];
-        glEnable(GL_POLYGON_OFFSET_FILL);
+        context_set_cap(context, GL_POLYGON_OFFSET_FILL, TRUE);
         checkGLcall("glEnable(GL_POLYGON_OFFSET_FILL)");
         glPolygonOffset(tmpvalue.f, *((float*)&stateblock->renderState[WINED3DRS_DEPTHBIAS]));
         checkGLcall("glPolygonOffset(...)");
     } else {
-        glDisable(GL_POLYGON_OFFSET_FILL);
+        context_set_cap(context, GL_POLYGON_OFFSET_FILL, FALSE);
         checkGLcall("glDisable(GL_POLYGON_OFFSET_FILL)");
     }
 }
@@ -2659,7 +2659,7 @@ static void state_vertexblend(DWORD state, IWineD3DStateBlockImpl *stateblock, W
         case WINED3DVBF_2WEIGHTS:
         case WINED3DVBF_3WEIGHTS:
             if(GL_SUPPORT(ARB_VERTEX_BLEND)) {
-                glEnable(GL_VERTEX_BLEND_ARB);
+                context_set_cap(context, GL_VERTEX_BLEND_ARB, TRUE);
                 checkGLcall("glEnable(GL_VERTEX_BLEND_ARB)");
 
                 /* D3D adds one more matrix which has weight (1 - sum(weights)). This is enabled at context
@@ -2689,7 +2689,7 @@ static void state_vertexblend(DWORD state, IWineD3DStateBlockImpl *stateblock, W
         case WINED3DVBF_DISABLE:
         case WINED3DVBF_0WEIGHTS: /* for Indexed vertex blending - not supported */
             if(GL_SUPPORT(ARB_VERTEX_BLEND)) {
-                glDisable(GL_VERTEX_BLEND_ARB);
+                context_set_cap(context, GL_VERTEX_BLEND_ARB, FALSE);
                 checkGLcall("glDisable(GL_VERTEX_BLEND_ARB)");
             } else {
                 TRACE("Vertex blending disabled\n");
@@ -3572,7 +3572,7 @@ static void vertexdeclaration(DWORD state, IWineD3DStateBlockImpl *stateblock, W
              * state_clipping state handler
              */
             for(i = 0; i < GL_LIMITS(clipplanes); i++) {
-                glDisable(GL_CLIP_PLANE0 + i);
+                context_set_cap(context, GL_CLIP_PLANE0 + i, FALSE);
                 checkGLcall("glDisable(GL_CLIP_PLANE0 + i)");
             }
 
@@ -3660,7 +3660,7 @@ static void light(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3DContex
     PLIGHTINFOEL *lightInfo = stateblock->activeLights[Index];
 
     if(!lightInfo) {
-        glDisable(GL_LIGHT0 + Index);
+        context_set_cap(context, GL_LIGHT0 + Index, FALSE);
         checkGLcall("glDisable(GL_LIGHT0 + Index)");
     } else {
         float quad_att;
@@ -3763,7 +3763,7 @@ static void light(DWORD state, IWineD3DStateBlockImpl *stateblock, WineD3DContex
         /* Restore the modelview matrix */
         glPopMatrix();
 
-        glEnable(GL_LIGHT0 + Index);
+        context_set_cap(context, GL_LIGHT0 + Index, TRUE);
         checkGLcall("glEnable(GL_LIGHT0 + Index)");
     }
 
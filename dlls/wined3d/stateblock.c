@@ -385,6 +385,8 @@ static HRESULT  WINAPI IWineD3DStateBlockImpl_Capture(IWineD3DStateBlock *iface)
 
     TRACE("(%p) : Updating state block %p ------------------v\n", targetStateBlock, This);
 
+    wined3d_cs_sync(This->wineD3DDevice);
+
     /* If not recorded, then update can just recapture */
     if (This->blockType == WINED3DSBT_RECORDED) {
 
@@ -737,6 +739,10 @@ should really perform a delta so that only the changes get updated*/
 
     TRACE("Blocktype: %d\n", This->blockType);
 
+    /* Apply the block synchronously, the setters below must not be queued behind each other */
+    wined3d_cs_sync(This->wineD3DDevice);
+    if(This->wineD3DDevice->cs) This->wineD3DDevice->cs->direct = TRUE;
+
     if(This->blockType == WINED3DSBT_RECORDED) {
         if (This->changed.vertexShader) {
             IWineD3DDevice_SetVertexShader(pDevice, This->vertexShader);
@@ -1020,6 +1026,7 @@ should really perform a delta so that only the changes get updated*/
             break;
         }
     }
+    if(This->wineD3DDevice->cs) This->wineD3DDevice->cs->direct = FALSE;
     TRACE("(%p) : Applied state block %p ------------------^\n", This, pDevice);
 
     return WINED3D_OK;
@@ -1011,6 +1011,9 @@ static HRESULT WINAPI IWineD3DSurfaceImpl_LockRect(IWineD3DSurface *iface, WINED
 
     TRACE("(%p) : rect@%p flags(%08x), output lockedRect@%p, memory@%p\n", This, pRect, Flags, pLockedRect, This->resource.allocatedMemory);
 
+    /* Queued draws and clears may still render to this surface */
+    wined3d_cs_sync(myDevice);
+
     /* This is also done in the base class, but we have to verify this before loading any data from
      * gl into the sysmem copy. The PBO may be mapped, a different rectangle locked, the discard flag
      * may interfere, and all other bad things may happen
@@ -1723,363 +1726,442 @@ HRESULT d3dfmt_get_conv(IWineD3DSurfaceImpl *This, BOOL need_alpha_ck, BOOL use_
     return WINED3D_OK;
 }
 
-HRESULT d3dfmt_convert_surface(BYTE *src, BYTE *dst, UINT pitch, UINT width, UINT height, UINT outpitch, CONVERT_TYPES convert, IWineD3DSurfaceImpl *This) {
-    BYTE *source, *dest;
-    TRACE("(%p)->(%p),(%d,%d,%d,%d,%p)\n", src, dst, pitch, height, outpitch, convert,This);
+/*****************************************************************************
+ * Surface format conversion
+ *
+ * Every conversion is a function that converts one row, d3dfmt_convert_surface
+ * looks it up in row_converters and runs it over the surface. Large surfaces
+ * are cut in bands of rows which are converted in parallel on the thread pool.
+ *
+ *****************************************************************************/
+struct conversion_params
+{
+    DWORD ck_low, ck_high;      /* source color key */
+    DWORD palette[256];         /* P8 palette as RGBA, in memory order */
+    BOOL nv_texture_shader;
+};
 
-    switch (convert) {
-        case NO_CONVERSION:
-        {
-            memcpy(dst, src, pitch * height);
-            break;
-        }
-        case CONVERT_PALETTED:
-        case CONVERT_PALETTED_CK:
-        {
-            IWineD3DPaletteImpl* pal = This->palette;
-            BYTE table[256][4];
-            unsigned int x, y;
+typedef void (*convert_row_func)(const BYTE *src, BYTE *dst, UINT width, const struct conversion_params *p);
 
-            if( pal == NULL) {
-                /* TODO: If we are a sublevel, try to get the palette from level 0 */
-            }
+static inline BOOL outside_color_key(DWORD color, const struct conversion_params *p)
+{
+    return color < p->ck_low || color > p->ck_high;
+}
 
-            d3dfmt_p8_init_palette(This, table, (convert == CONVERT_PALETTED_CK));
+static void convert_paletted(const BYTE *src, BYTE *dst, UINT width, const struct conversion_params *p)
+{
+    DWORD *d = (DWORD *)dst;
+    UINT x;
 
-            for (y = 0; y < height; y++)
-            {
-                source = src + pitch * y;
-                dest = dst + outpitch * y;
-                /* This is an 1 bpp format, using the width here is fine */
-                for (x = 0; x < width; x++) {
-                    BYTE color = *source++;
-                    *dest++ = table[color][0];
-                    *dest++ = table[color][1];
-                    *dest++ = table[color][2];
-                    *dest++ = table[color][3];
-                }
-            }
-        }
-        break;
+    /* This is an 1 bpp format, using the width here is fine */
+    for (x = 0; x < width; x++) d[x] = p->palette[src[x]];
+}
 
-        case CONVERT_CK_565:
-        {
-            /* Converting the 565 format in 5551 packed to emulate color-keying.
-
-              Note : in all these conversion, it would be best to average the averaging
-                      pixels to get the color of the pixel that will be color-keyed to
-                      prevent 'color bleeding'. This will be done later on if ever it is
-                      too visible.
-
-              Note2: Nvidia documents say that their driver does not support alpha + color keying
-                     on the same surface and disables color keying in such a case
-            */
-            unsigned int x, y;
-            WORD *Source;
-            WORD *Dest;
-
-            TRACE("Color keyed 565\n");
-
-            for (y = 0; y < height; y++) {
-                Source = (WORD *) (src + y * pitch);
-                Dest = (WORD *) (dst + y * outpitch);
-                for (x = 0; x < width; x++ ) {
-                    WORD color = *Source++;
-                    *Dest = ((color & 0xFFC0) | ((color & 0x1F) << 1));
-                    if ((color < This->SrcBltCKey.dwColorSpaceLowValue) ||
-                        (color > This->SrcBltCKey.dwColorSpaceHighValue)) {
-                        *Dest |= 0x0001;
-                    }
-                    Dest++;
-                }
-            }
-        }
-        break;
+/* Converting the 565 format in 5551 packed to emulate color-keying.
 
-        case CONVERT_CK_5551:
-        {
-            /* Converting X1R5G5B5 format to R5G5B5A1 to emulate color-keying. */
-            unsigned int x, y;
-            WORD *Source;
-            WORD *Dest;
-            TRACE("Color keyed 5551\n");
-            for (y = 0; y < height; y++) {
-                Source = (WORD *) (src + y * pitch);
-                Dest = (WORD *) (dst + y * outpitch);
-                for (x = 0; x < width; x++ ) {
-                    WORD color = *Source++;
-		    *Dest = color;
-                    if ((color < This->SrcBltCKey.dwColorSpaceLowValue) ||
-                        (color > This->SrcBltCKey.dwColorSpaceHighValue)) {
-                        *Dest |= (1 << 15);
-                    }
-                    else {
-                        *Dest &= ~(1 << 15);
-                    }
-                    Dest++;
-                }
-            }
-        }
-        break;
+  Note : in all these conversion, it would be best to average the averaging
+          pixels to get the color of the pixel that will be color-keyed to
+          prevent 'color bleeding'. This will be done later on if ever it is
+          too visible.
 
-        case CONVERT_RGB32_888:
-        {
-            /* Converting X8R8G8B8 format to R8G8B8A8 with color-keying. */
-            unsigned int x, y;
-            for (y = 0; y < height; y++)
-            {
-                source = src + pitch * y;
-                dest = dst + outpitch * y;
-                for (x = 0; x < width; x++) {
-                    DWORD color = 0xffffff & *(DWORD*)source;
-                    DWORD dstcolor = color << 8;
-                    if ((color < This->SrcBltCKey.dwColorSpaceLowValue) ||
-                        (color > This->SrcBltCKey.dwColorSpaceHighValue)) {
-                        dstcolor |= 0xff;
-                    }
-                    *(DWORD*)dest = dstcolor;
-                    source += 4;
-                    dest += 4;
-                }
-            }
-        }
-        break;
+  Note2: Nvidia documents say that their driver does not support alpha + color keying
+         on the same surface and disables color keying in such a case
+*/
+static void convert_ck_565(const BYTE *src, BYTE *dst, UINT width, const struct conversion_params *p)
+{
+    const WORD *s = (const WORD *)src;
+    WORD *d = (WORD *)dst;
+    UINT x;
 
-        case CONVERT_V8U8:
-        {
-            unsigned int x, y;
-            short *Source;
-            unsigned char *Dest;
-            for(y = 0; y < height; y++) {
-                Source = (short *) (src + y * pitch);
-                Dest = dst + y * outpitch;
-                for (x = 0; x < width; x++ ) {
-                    long color = (*Source++);
-                    /* B */ Dest[0] = 0xff;
-                    /* G */ Dest[1] = (color >> 8) + 128; /* V */
-                    /* R */ Dest[2] = (color) + 128;      /* U */
-                    Dest += 3;
-                }
-            }
-            break;
-        }
+    for (x = 0; x < width; x++)
+    {
+        WORD color = s[x];
+        d[x] = (color & 0xFFC0) | ((color & 0x1F) << 1) | (outside_color_key(color, p) ? 0x0001 : 0);
+    }
+}
 
-        case CONVERT_V16U16:
-        {
-            unsigned int x, y;
-            DWORD *Source;
-            unsigned short *Dest;
-            for(y = 0; y < height; y++) {
-                Source = (DWORD *) (src + y * pitch);
-                Dest = (unsigned short *) (dst + y * outpitch);
-                for (x = 0; x < width; x++ ) {
-                    DWORD color = (*Source++);
-                    /* B */ Dest[0] = 0xffff;
-                    /* G */ Dest[1] = (color >> 16) + 32768; /* V */
-                    /* R */ Dest[2] = (color      ) + 32768; /* U */
-                    Dest += 3;
-                }
-            }
-            break;
-        }
+/* Converting X1R5G5B5 format to R5G5B5A1 to emulate color-keying. */
+static void convert_ck_5551(const BYTE *src, BYTE *dst, UINT width, const struct conversion_params *p)
+{
+    const WORD *s = (const WORD *)src;
+    WORD *d = (WORD *)dst;
+    UINT x;
 
-        case CONVERT_Q8W8V8U8:
-        {
-            unsigned int x, y;
-            DWORD *Source;
-            unsigned char *Dest;
-            for(y = 0; y < height; y++) {
-                Source = (DWORD *) (src + y * pitch);
-                Dest = dst + y * outpitch;
-                for (x = 0; x < width; x++ ) {
-                    long color = (*Source++);
-                    /* B */ Dest[0] = ((color >> 16) & 0xff) + 128; /* W */
-                    /* G */ Dest[1] = ((color >> 8 ) & 0xff) + 128; /* V */
-                    /* R */ Dest[2] = (color         & 0xff) + 128; /* U */
-                    /* A */ Dest[3] = ((color >> 24) & 0xff) + 128; /* Q */
-                    Dest += 4;
-                }
-            }
-            break;
-        }
+    for (x = 0; x < width; x++)
+    {
+        WORD color = s[x];
+        d[x] = outside_color_key(color, p) ? color | (1 << 15) : color & ~(1 << 15);
+    }
+}
 
-        case CONVERT_L6V5U5:
-        {
-            unsigned int x, y;
-            WORD *Source;
-            unsigned char *Dest;
+/* Converting X8R8G8B8 format to R8G8B8A8 with color-keying. */
+static void convert_rgb32_888(const BYTE *src, BYTE *dst, UINT width, const struct conversion_params *p)
+{
+    const DWORD *s = (const DWORD *)src;
+    DWORD *d = (DWORD *)dst;
+    UINT x;
 
-            if(GL_SUPPORT(NV_TEXTURE_SHADER)) {
-                /* This makes the gl surface bigger(24 bit instead of 16), but it works with
-                 * fixed function and shaders without further conversion once the surface is
-                 * loaded
-                 */
-                for(y = 0; y < height; y++) {
-                    Source = (WORD *) (src + y * pitch);
-                    Dest = dst + y * outpitch;
-                    for (x = 0; x < width; x++ ) {
-                        short color = (*Source++);
-                        unsigned char l = ((color >> 10) & 0xfc);
-                                  char v = ((color >>  5) & 0x3e);
-                                  char u = ((color      ) & 0x1f);
-
-                        /* 8 bits destination, 6 bits source, 8th bit is the sign. gl ignores the sign
-                         * and doubles the positive range. Thus shift left only once, gl does the 2nd
-                         * shift. GL reads a signed value and converts it into an unsigned value.
-                         */
-                        /* M */ Dest[2] = l << 1;
-
-                        /* Those are read as signed, but kept signed. Just left-shift 3 times to scale
-                         * from 5 bit values to 8 bit values.
-                         */
-                        /* V */ Dest[1] = v << 3;
-                        /* U */ Dest[0] = u << 3;
-                        Dest += 3;
-                    }
-                }
-            } else {
-                for(y = 0; y < height; y++) {
-                    unsigned short *Dest_s = (unsigned short *) (dst + y * outpitch);
-                    Source = (WORD *) (src + y * pitch);
-                    for (x = 0; x < width; x++ ) {
-                        short color = (*Source++);
-                        unsigned char l = ((color >> 10) & 0xfc);
-                                 short v = ((color >>  5) & 0x3e);
-                                 short u = ((color      ) & 0x1f);
-                        short v_conv = v + 16;
-                        short u_conv = u + 16;
-
-                        *Dest_s = ((v_conv << 11) & 0xf800) | ((l << 5) & 0x7e0) | (u_conv & 0x1f);
-                        Dest_s += 1;
-                    }
-                }
-            }
-            break;
-        }
+    for (x = 0; x < width; x++)
+    {
+        DWORD color = 0xffffff & s[x];
+        d[x] = (color << 8) | (outside_color_key(color, p) ? 0xff : 0);
+    }
+}
 
-        case CONVERT_X8L8V8U8:
-        {
-            unsigned int x, y;
-            DWORD *Source;
-            unsigned char *Dest;
+static void convert_v8u8(const BYTE *src, BYTE *dst, UINT width, const struct conversion_params *p)
+{
+    const short *s = (const short *)src;
+    UINT x;
 
-            if(GL_SUPPORT(NV_TEXTURE_SHADER)) {
-                /* This implementation works with the fixed function pipeline and shaders
-                 * without further modification after converting the surface.
-                 */
-                for(y = 0; y < height; y++) {
-                    Source = (DWORD *) (src + y * pitch);
-                    Dest = dst + y * outpitch;
-                    for (x = 0; x < width; x++ ) {
-                        long color = (*Source++);
-                        /* L */ Dest[2] = ((color >> 16) & 0xff);   /* L */
-                        /* V */ Dest[1] = ((color >> 8 ) & 0xff);   /* V */
-                        /* U */ Dest[0] = (color         & 0xff);   /* U */
-                        /* I */ Dest[3] = 255;                      /* X */
-                        Dest += 4;
-                    }
-                }
-            } else {
-                /* Doesn't work correctly with the fixed function pipeline, but can work in
-                 * shaders if the shader is adjusted. (There's no use for this format in gl's
-                 * standard fixed function pipeline anyway).
-                 */
-                for(y = 0; y < height; y++) {
-                    Source = (DWORD *) (src + y * pitch);
-                    Dest = dst + y * outpitch;
-                    for (x = 0; x < width; x++ ) {
-                        long color = (*Source++);
-                        /* B */ Dest[0] = ((color >> 16) & 0xff);       /* L */
-                        /* G */ Dest[1] = ((color >> 8 ) & 0xff) + 128; /* V */
-                        /* R */ Dest[2] = (color         & 0xff) + 128;  /* U */
-                        Dest += 4;
-                    }
-                }
-            }
-            break;
-        }
+    for (x = 0; x < width; x++, dst += 3)
+    {
+        long color = s[x];
+        /* B */ dst[0] = 0xff;
+        /* G */ dst[1] = (color >> 8) + 128; /* V */
+        /* R */ dst[2] = (color) + 128;      /* U */
+    }
+}
+
+static void convert_v16u16(const BYTE *src, BYTE *dst, UINT width, const struct conversion_params *p)
+{
+    const DWORD *s = (const DWORD *)src;
+    unsigned short *d = (unsigned short *)dst;
+    UINT x;
+
+    for (x = 0; x < width; x++, d += 3)
+    {
+        DWORD color = s[x];
+        /* B */ d[0] = 0xffff;
+        /* G */ d[1] = (color >> 16) + 32768; /* V */
+        /* R */ d[2] = (color      ) + 32768; /* U */
+    }
+}
+
+static void convert_q8w8v8u8(const BYTE *src, BYTE *dst, UINT width, const struct conversion_params *p)
+{
+    const DWORD *s = (const DWORD *)src;
+    DWORD *d = (DWORD *)dst;
+    UINT x;
+
+    /* Swap U and W, adding 128 to a byte is the same as flipping its top
+     * bit, which can be done for all four channels at once. */
+    for (x = 0; x < width; x++)
+    {
+        DWORD color = s[x];
+        d[x] = ((color & 0xff00ff00) | ((color >> 16) & 0xff) | ((color & 0xff) << 16)) ^ 0x80808080;
+    }
+}
+
+static void convert_l6v5u5(const BYTE *src, BYTE *dst, UINT width, const struct conversion_params *p)
+{
+    const WORD *s = (const WORD *)src;
+    UINT x;
 
-        case CONVERT_A4L4:
+    if (p->nv_texture_shader) {
+        /* This makes the gl surface bigger(24 bit instead of 16), but it works with
+         * fixed function and shaders without further conversion once the surface is
+         * loaded
+         */
+        for (x = 0; x < width; x++, dst += 3)
         {
-            unsigned int x, y;
-            unsigned char *Source;
-            unsigned char *Dest;
-            for(y = 0; y < height; y++) {
-                Source = src + y * pitch;
-                Dest = dst + y * outpitch;
-                for (x = 0; x < width; x++ ) {
-                    unsigned char color = (*Source++);
-                    /* A */ Dest[1] = (color & 0xf0) << 0;
-                    /* L */ Dest[0] = (color & 0x0f) << 4;
-                    Dest += 2;
-                }
-            }
-            break;
+            short color = s[x];
+            unsigned char l = ((color >> 10) & 0xfc);
+                      char v = ((color >>  5) & 0x3e);
+                      char u = ((color      ) & 0x1f);
+
+            /* 8 bits destination, 6 bits source, 8th bit is the sign. gl ignores the sign
+             * and doubles the positive range. Thus shift left only once, gl does the 2nd
+             * shift. GL reads a signed value and converts it into an unsigned value.
+             */
+            /* M */ dst[2] = l << 1;
+
+            /* Those are read as signed, but kept signed. Just left-shift 3 times to scale
+             * from 5 bit values to 8 bit values.
+             */
+            /* V */ dst[1] = v << 3;
+            /* U */ dst[0] = u << 3;
         }
+    } else {
+        unsigned short *d = (unsigned short *)dst;
 
-        case CONVERT_R32F:
+        for (x = 0; x < width; x++)
         {
-            unsigned int x, y;
-            float *Source;
-            float *Dest;
-            for(y = 0; y < height; y++) {
-                Source = (float *) (src + y * pitch);
-                Dest = (float *) (dst + y * outpitch);
-                for (x = 0; x < width; x++ ) {
-                    float color = (*Source++);
-                    Dest[0] = color;
-                    Dest[1] = 1.0;
-                    Dest[2] = 1.0;
-                    Dest += 3;
-                }
-            }
-            break;
+            short color = s[x];
+            unsigned char l = ((color >> 10) & 0xfc);
+                     short v = ((color >>  5) & 0x3e);
+                     short u = ((color      ) & 0x1f);
+            short v_conv = v + 16;
+            short u_conv = u + 16;
+
+            d[x] = ((v_conv << 11) & 0xf800) | ((l << 5) & 0x7e0) | (u_conv & 0x1f);
         }
+    }
+}
+
+static void convert_x8l8v8u8(const BYTE *src, BYTE *dst, UINT width, const struct conversion_params *p)
+{
+    const DWORD *s = (const DWORD *)src;
+    DWORD *d = (DWORD *)dst;
+    UINT x;
 
-        case CONVERT_R16F:
+    if (p->nv_texture_shader) {
+        /* This implementation works with the fixed function pipeline and shaders
+         * without further modification after converting the surface.
+         */
+        for (x = 0; x < width; x++) d[x] = s[x] | 0xff000000;
+    } else {
+        /* Doesn't work correctly with the fixed function pipeline, but can work in
+         * shaders if the shader is adjusted. (There's no use for this format in gl's
+         * standard fixed function pipeline anyway).
+         */
+        for (x = 0; x < width; x++)
         {
-            unsigned int x, y;
-            WORD *Source;
-            WORD *Dest;
-            WORD one = 0x3c00;
-            for(y = 0; y < height; y++) {
-                Source = (WORD *) (src + y * pitch);
-                Dest = (WORD *) (dst + y * outpitch);
-                for (x = 0; x < width; x++ ) {
-                    WORD color = (*Source++);
-                    Dest[0] = color;
-                    Dest[1] = one;
-                    Dest[2] = one;
-                    Dest += 3;
-                }
-            }
-            break;
+            DWORD color = s[x];
+            /* B = L, G = V + 128, R = U + 128 */
+            d[x] = ((color >> 16) & 0xff) | (((color & 0xff00) | ((color & 0xff) << 16)) ^ 0x808000);
         }
+    }
+}
 
-        case CONVERT_G16R16:
-        {
-            unsigned int x, y;
-            WORD *Source;
-            WORD *Dest;
-
-            for(y = 0; y < height; y++) {
-                Source = (WORD *) (src + y * pitch);
-                Dest = (WORD *) (dst + y * outpitch);
-                for (x = 0; x < width; x++ ) {
-                    WORD green = (*Source++);
-                    WORD red = (*Source++);
-                    Dest[0] = green;
-                    Dest[1] = red;
-                    Dest[2] = 0xffff;
-                    Dest += 3;
-                }
-            }
-            break;
+static void convert_a4l4(const BYTE *src, BYTE *dst, UINT width, const struct conversion_params *p)
+{
+    UINT x;
+
+    for (x = 0; x < width; x++, dst += 2)
+    {
+        unsigned char color = src[x];
+        /* A */ dst[1] = (color & 0xf0) << 0;
+        /* L */ dst[0] = (color & 0x0f) << 4;
+    }
+}
+
+static void convert_r32f(const BYTE *src, BYTE *dst, UINT width, const struct conversion_params *p)
+{
+    const float *s = (const float *)src;
+    float *d = (float *)dst;
+    UINT x;
+
+    for (x = 0; x < width; x++, d += 3)
+    {
+        d[0] = s[x];
+        d[1] = 1.0;
+        d[2] = 1.0;
+    }
+}
+
+static void convert_r16f(const BYTE *src, BYTE *dst, UINT width, const struct conversion_params *p)
+{
+    const WORD *s = (const WORD *)src;
+    WORD *d = (WORD *)dst;
+    WORD one = 0x3c00;
+    UINT x;
+
+    for (x = 0; x < width; x++, d += 3)
+    {
+        d[0] = s[x];
+        d[1] = one;
+        d[2] = one;
+    }
+}
+
+static void convert_g16r16(const BYTE *src, BYTE *dst, UINT width, const struct conversion_params *p)
+{
+    const WORD *s = (const WORD *)src;
+    WORD *d = (WORD *)dst;
+    UINT x;
+
+    for (x = 0; x < width; x++, s += 2, d += 3)
+    {
+        d[0] = s[0]; /* green */
+        d[1] = s[1]; /* red */
+        d[2] = 0xffff;
+    }
+}
+
+static const struct
+{
+    CONVERT_TYPES type;
+    convert_row_func convert_row;
+}
+row_converters[] =
+{
+    {CONVERT_PALETTED,      convert_paletted},
+    {CONVERT_PALETTED_CK,   convert_paletted},
+    {CONVERT_CK_565,        convert_ck_565},
+    {CONVERT_CK_5551,       convert_ck_5551},
+    {CONVERT_RGB32_888,     convert_rgb32_888},
+    {CONVERT_V8U8,          convert_v8u8},
+    {CONVERT_V16U16,        convert_v16u16},
+    {CONVERT_Q8W8V8U8,      convert_q8w8v8u8},
+    {CONVERT_L6V5U5,        convert_l6v5u5},
+    {CONVERT_X8L8V8U8,      convert_x8l8v8u8},
+    {CONVERT_A4L4,          convert_a4l4},
+    {CONVERT_R32F,          convert_r32f},
+    {CONVERT_R16F,          convert_r16f},
+    {CONVERT_G16R16,        convert_g16r16},
+};
+
+/* Surfaces smaller than this are converted by the calling thread only */
+#define CONVERT_BAND_MIN_PIXELS (128 * 1024)
+#define CONVERT_MAX_BANDS       4
+
+struct conversion_band
+{
+    convert_row_func convert_row;
+    const struct conversion_params *params;
+    const BYTE *src;
+    BYTE *dst;
+    UINT pitch, outpitch, width, height;
+    LONG *pending;
+    HANDLE done;
+};
+
+static void convert_band(const struct conversion_band *band)
+{
+    UINT y;
+
+    for (y = 0; y < band->height; y++)
+        band->convert_row(band->src + y * band->pitch, band->dst + y * band->outpitch, band->width, band->params);
+}
+
+static DWORD WINAPI convert_band_proc(void *arg)
+{
+    struct conversion_band *band = arg;
+
+    convert_band(band);
+    if (!InterlockedDecrement(band->pending)) SetEvent(band->done);
+    return 0;
+}
+
+static void convert_rows(convert_row_func convert_row, const struct conversion_params *params,
+                         const BYTE *src, BYTE *dst, UINT pitch, UINT outpitch, UINT width, UINT height)
+{
+    static LONG num_cpus;
+    struct conversion_band bands[CONVERT_MAX_BANDS];
+    HANDLE done = NULL;
+    LONG pending;
+    UINT count, i;
+
+    if (!num_cpus)
+    {
+        SYSTEM_INFO si;
+
+        GetSystemInfo(&si);
+        num_cpus = max(si.dwNumberOfProcessors, 1);
+    }
+
+    count = min(num_cpus, CONVERT_MAX_BANDS);
+    count = min(count, (width * height) / CONVERT_BAND_MIN_PIXELS);
+    if (count > 1 && !(done = CreateEventW(NULL, TRUE, FALSE, NULL))) count = 1;
+    if (count < 2) count = 1;
+
+    for (i = 0; i < count; i++)
+    {
+        UINT start = height * i / count;
+
+        bands[i].convert_row = convert_row;
+        bands[i].params = params;
+        bands[i].src = src + start * pitch;
+        bands[i].dst = dst + start * outpitch;
+        bands[i].pitch = pitch;
+        bands[i].outpitch = outpitch;
+        bands[i].width = width;
+        bands[i].height = height * (i + 1) / count - start;
+        bands[i].pending = &pending;
+        bands[i].done = done;
+    }
+
+    /* the calling thread converts the last band itself */
+    pending = count - 1;
+    for (i = 0; i < count - 1; i++)
+    {
+        if (!QueueUserWorkItem(convert_band_proc, &bands[i], WT_EXECUTEDEFAULT))
+            convert_band_proc(&bands[i]);
+    }
+    convert_band(&bands[count - 1]);
+
+    if (done)
+    {
+        WaitForSingleObject(done, INFINITE);
+        CloseHandle(done);
+    }
+}
+
+static convert_row_func get_row_converter(CONVERT_TYPES convert)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(row_converters) / sizeof(*row_converters); i++)
+    {
+        if (row_converters[i].type == convert) return row_converters[i].convert_row;
+    }
+    return NULL;
+}
+
+HRESULT d3dfmt_convert_surface(BYTE *src, BYTE *dst, UINT pitch, UINT width, UINT height, UINT outpitch, CONVERT_TYPES convert, IWineD3DSurfaceImpl *This) {
+    struct conversion_params params;
+    convert_row_func convert_row;
+
+    TRACE("(%p)->(%p),(%d,%d,%d,%d,%p)\n", src, dst, pitch, height, outpitch, convert,This);
+
+    if (convert == NO_CONVERSION)
+    {
+        memcpy(dst, src, pitch * height);
+        return WINED3D_OK;
+    }
+
+    if (!(convert_row = get_row_converter(convert)))
+    {
+        ERR("Unsupported conversation type %d\n", convert);
+        return WINED3D_OK;
+    }
+
+    params.ck_low = This->SrcBltCKey.dwColorSpaceLowValue;
+    params.ck_high = This->SrcBltCKey.dwColorSpaceHighValue;
+    params.nv_texture_shader = GL_SUPPORT(NV_TEXTURE_SHADER);
+    if (convert == CONVERT_PALETTED || convert == CONVERT_PALETTED_CK)
+    {
+        BYTE table[256][4];
+
+        if (This->palette == NULL) {
+            /* TODO: If we are a sublevel, try to get the palette from level 0 */
         }
 
-        default:
-            ERR("Unsupported conversation type %d\n", convert);
+        d3dfmt_p8_init_palette(This, table, (convert == CONVERT_PALETTED_CK));
+        memcpy(params.palette, table, sizeof(table));
     }
+
+    convert_rows(convert_row, &params, src, dst, pitch, outpitch, width, height);
+    return WINED3D_OK;
+}
+
+/*****************************************************************************
+ * WineDirect3DConvertSurface
+ *
+ * Runs a conversion like d3dfmt_convert_surface, with the palette, color key
+ * and NV_texture_shader state passed in instead of taken from a surface and
+ * the GL context. The palette holds 256 RGBA entries in memory order.
+ *
+ *****************************************************************************/
+HRESULT WINAPI WineDirect3DConvertSurface(const BYTE *src, BYTE *dst, UINT pitch, UINT width, UINT height,
+        UINT outpitch, CONVERT_TYPES convert, const DWORD *palette, DWORD ck_low, DWORD ck_high,
+        BOOL nv_texture_shader)
+{
+    struct conversion_params params;
+    convert_row_func convert_row;
+
+    TRACE("(%p,%p,%u,%u,%u,%u,%d,%p,%#x,%#x,%d)\n", src, dst, pitch, width, height, outpitch, convert,
+          palette, ck_low, ck_high, nv_texture_shader);
+
+    if (!(convert_row = get_row_converter(convert))) return WINED3DERR_INVALIDCALL;
+
+    params.ck_low = ck_low;
+    params.ck_high = ck_high;
+    params.nv_texture_shader = nv_texture_shader;
+    if (palette) memcpy(params.palette, palette, sizeof(params.palette));
+    else memset(params.palette, 0, sizeof(params.palette));
+
+    convert_rows(convert_row, &params, src, dst, pitch, outpitch, width, height);
     return WINED3D_OK;
 }
 
@@ -2246,7 +2328,7 @@ static inline void clear_unused_channels(IWineD3DSurfaceImpl *This) {
              * buffer too
              */
             glDrawBuffer(This->resource.wineD3DDevice->offscreenBuffer);
-            glDisable(GL_SCISSOR_TEST);
+            context_set_cap(This->resource.wineD3DDevice->activeContext, GL_SCISSOR_TEST, FALSE);
             glGetBooleanv(GL_COLOR_WRITEMASK, oldwrite);
             glColorMask(GL_FALSE, GL_TRUE, GL_TRUE, GL_TRUE);
             glClearColor(0.0, 1.0, 1.0, 1.0);
@@ -3363,7 +3445,7 @@ static HRESULT IWineD3DSurfaceImpl_BltOverride(IWineD3DSurfaceImpl *This, RECT *
 
         /* This is for color keying */
         if(Flags & (WINEDDBLT_KEYSRC | WINEDDBLT_KEYSRCOVERRIDE)) {
-            glEnable(GL_ALPHA_TEST);
+            context_set_cap(myDevice->activeContext, GL_ALPHA_TEST, TRUE);
             checkGLcall("glEnable GL_ALPHA_TEST");
 
             /* When the primary render target uses P8, the alpha component contains the palette index.
@@ -3375,7 +3457,7 @@ static HRESULT IWineD3DSurfaceImpl_BltOverride(IWineD3DSurfaceImpl *This, RECT *
                 glAlphaFunc(GL_NOTEQUAL, 0.0);
             checkGLcall("glAlphaFunc\n");
         } else {
-            glDisable(GL_ALPHA_TEST);
+            context_set_cap(myDevice->activeContext, GL_ALPHA_TEST, FALSE);
             checkGLcall("glDisable GL_ALPHA_TEST");
         }
 
@@ -3405,7 +3487,7 @@ static HRESULT IWineD3DSurfaceImpl_BltOverride(IWineD3DSurfaceImpl *This, RECT *
         checkGLcall("glEnd");
 
         if(Flags & (WINEDDBLT_KEYSRC | WINEDDBLT_KEYSRCOVERRIDE)) {
-            glDisable(GL_ALPHA_TEST);
+            context_set_cap(myDevice->activeContext, GL_ALPHA_TEST, FALSE);
             checkGLcall("glDisable(GL_ALPHA_TEST)");
         }
 
@@ -3564,6 +3646,7 @@ static HRESULT WINAPI IWineD3DSurfaceImpl_Blt(IWineD3DSurface *iface, RECT *Dest
     TRACE("(%p)->(%p,%p,%p,%x,%p)\n", This, DestRect, SrcSurface, SrcRect, Flags, DDBltFx);
     TRACE("(%p): Usage is %s\n", This, debug_d3dusage(This->resource.usage));
 
+    wined3d_cs_sync(myDevice);
     if ( (This->Flags & SFLAG_LOCKED) || ((Src != NULL) && (Src->Flags & SFLAG_LOCKED)))
     {
         WARN(" Surface is busy, returning DDERR_SURFACEBUSY\n");
@@ -3602,6 +3685,7 @@ HRESULT WINAPI IWineD3DSurfaceImpl_BltFast(IWineD3DSurface *iface, DWORD dstx, D
     IWineD3DDeviceImpl *myDevice = This->resource.wineD3DDevice;
     TRACE("(%p)->(%d, %d, %p, %p, %08x\n", iface, dstx, dsty, Source, rsrc, trans);
 
+    wined3d_cs_sync(myDevice);
     if ( (This->Flags & SFLAG_LOCKED) || ((srcImpl != NULL) && (srcImpl->Flags & SFLAG_LOCKED)))
     {
         WARN(" Surface is busy, returning DDERR_SURFACEBUSY\n");
@@ -675,6 +675,198 @@ IWineD3DSurfaceImpl *surface_convert_format(IWineD3DSurfaceImpl *source, WINED3D
     return (IWineD3DSurfaceImpl *) ret;
 }
 
+/*****************************************************************************
+ * Row kernels for the software blitter
+ *
+ * The blit loops below work on one row at a time and pick the kernel that
+ * matches the pixel size once per blit, so that the per pixel work doesn't
+ * go through a switch.  The kernels for 1, 2 and 4 byte pixels are simple
+ * loops over whole pixels that the compiler can unroll, the 3 byte ones
+ * move 4 pixels as 3 DWORDs where they can.
+ *
+ *****************************************************************************/
+typedef void (*blt_fill_row_func)(BYTE *dst, unsigned int width, DWORD color);
+typedef void (*blt_colorkey_row_func)(BYTE *dst, const BYTE *src, unsigned int width,
+                                      DWORD keymask, DWORD keylow, DWORD keyhigh);
+typedef void (*blt_stretch_row_func)(BYTE *dst, const BYTE *src, unsigned int width,
+                                     const unsigned int *xoffs);
+
+static void blt_fill_row_8(BYTE *dst, unsigned int width, DWORD color)
+{
+    memset(dst, color, width);
+}
+
+static void blt_fill_row_16(BYTE *dst, unsigned int width, DWORD color)
+{
+    WORD *d = (WORD *)dst;
+    DWORD *d32;
+    unsigned int x;
+
+    if (((ULONG_PTR)d & 2) && width)
+    {
+        *d++ = color;
+        width--;
+    }
+    /* two pixels at a time from here */
+    color = (color & 0xffff) | (color << 16);
+    d32 = (DWORD *)d;
+    for (x = 0; x < width / 2; x++) d32[x] = color;
+    if (width & 1) d[width - 1] = color;
+}
+
+static void blt_fill_row_24(BYTE *dst, unsigned int width, DWORD color)
+{
+    DWORD pattern[3];
+    unsigned int x;
+
+    /* 4 pixels fit in 3 DWORDs */
+    color &= 0xffffff;
+    pattern[0] = color | (color << 24);
+    pattern[1] = (color >> 8) | (color << 16);
+    pattern[2] = (color >> 16) | (color << 8);
+    for (x = 0; x + 4 <= width; x += 4, dst += 12) memcpy(dst, pattern, 12);
+    for (; x < width; x++, dst += 3)
+    {
+        dst[0] = (color    ) & 0xff;
+        dst[1] = (color>> 8) & 0xff;
+        dst[2] = (color>>16) & 0xff;
+    }
+}
+
+static void blt_fill_row_32(BYTE *dst, unsigned int width, DWORD color)
+{
+    DWORD *d = (DWORD *)dst;
+    unsigned int x;
+
+    for (x = 0; x < width; x++) d[x] = color;
+}
+
+/* copies the pixels whose masked value is outside of [keylow, keyhigh] */
+#define BLT_COLORKEY_ROW(name, type) \
+static void name(BYTE *dst, const BYTE *src, unsigned int width, \
+                 DWORD keymask, DWORD keylow, DWORD keyhigh) \
+{ \
+    const type *s = (const type *)src; \
+    type *d = (type *)dst; \
+    DWORD range = keyhigh - keylow; \
+    unsigned int x; \
+\
+    /* one unsigned compare instead of two */ \
+    for (x = 0; x < width; x++) \
+        if (((s[x] & keymask) - keylow) > range) d[x] = s[x]; \
+}
+
+BLT_COLORKEY_ROW(blt_colorkey_row_8, BYTE)
+BLT_COLORKEY_ROW(blt_colorkey_row_16, WORD)
+BLT_COLORKEY_ROW(blt_colorkey_row_32, DWORD)
+
+#undef BLT_COLORKEY_ROW
+
+static void blt_colorkey_row_24(BYTE *dst, const BYTE *src, unsigned int width,
+                                DWORD keymask, DWORD keylow, DWORD keyhigh)
+{
+    DWORD pixel, range = keyhigh - keylow;
+    unsigned int x;
+
+    for (x = 0; x < width * 3; x += 3)
+    {
+        pixel = src[x] | (src[x + 1] << 8) | (src[x + 2] << 16);
+        if (((pixel & keymask) - keylow) > range)
+        {
+            dst[x + 0] = src[x + 0];
+            dst[x + 1] = src[x + 1];
+            dst[x + 2] = src[x + 2];
+        }
+    }
+}
+
+/* xoffs holds the source pixel of each destination pixel */
+#define BLT_STRETCH_ROW(name, type) \
+static void name(BYTE *dst, const BYTE *src, unsigned int width, const unsigned int *xoffs) \
+{ \
+    const type *s = (const type *)src; \
+    type *d = (type *)dst; \
+    unsigned int x; \
+\
+    for (x = 0; x < width; x++) d[x] = s[xoffs[x]]; \
+}
+
+BLT_STRETCH_ROW(blt_stretch_row_8, BYTE)
+BLT_STRETCH_ROW(blt_stretch_row_16, WORD)
+BLT_STRETCH_ROW(blt_stretch_row_32, DWORD)
+
+#undef BLT_STRETCH_ROW
+
+static void blt_stretch_row_24(BYTE *dst, const BYTE *src, unsigned int width, const unsigned int *xoffs)
+{
+    const BYTE *s;
+    unsigned int x;
+
+    for (x = 0; x < width; x++, dst += 3)
+    {
+        s = src + 3 * xoffs[x];
+        dst[0] = s[0];
+        dst[1] = s[1];
+        dst[2] = s[2];
+    }
+}
+
+static const struct
+{
+    blt_fill_row_func fill;
+    blt_colorkey_row_func colorkey;
+    blt_stretch_row_func stretch;
+}
+blt_row_funcs[] =
+{
+    {blt_fill_row_8,    blt_colorkey_row_8,     blt_stretch_row_8},
+    {blt_fill_row_16,   blt_colorkey_row_16,    blt_stretch_row_16},
+    {blt_fill_row_24,   blt_colorkey_row_24,    blt_stretch_row_24},
+    {blt_fill_row_32,   blt_colorkey_row_32,    blt_stretch_row_32},
+};
+
+/* Linear interpolation of two 8 bit per channel pixels, red and blue are
+ * computed together in one DWORD, then alpha and green. f is in 1/256th. */
+static inline DWORD lerp_8888(DWORD a, DWORD b, unsigned int f)
+{
+    DWORD rb = (((a & 0x00ff00ff) * (256 - f) + (b & 0x00ff00ff) * f) >> 8) & 0x00ff00ff;
+    DWORD ag = (((a >> 8) & 0x00ff00ff) * (256 - f) + ((b >> 8) & 0x00ff00ff) * f) & 0xff00ff00;
+    return rb | ag;
+}
+
+/*****************************************************************************
+ * _Blt_StretchLinear
+ *
+ * Bilinear stretch for 32 bit formats with 8 bit channels. The sampling
+ * positions are the same as the ones of the point filtered stretch, the
+ * right and bottom edges are clamped.
+ *
+ *****************************************************************************/
+static void _Blt_StretchLinear(BYTE *dbuf, LONG dpitch, int dstwidth, int dstheight,
+                               const BYTE *sbase, LONG spitch, int srcwidth, int srcheight,
+                               int xinc, int yinc)
+{
+    const DWORD *row0, *row1;
+    DWORD *d;
+    int x, y, sx, sy, x1, y1;
+
+    for (y = sy = 0; y < dstheight; y++, sy += yinc)
+    {
+        y1 = min((sy >> 16) + 1, srcheight - 1);
+        row0 = (const DWORD *)(sbase + (sy >> 16) * spitch);
+        row1 = (const DWORD *)(sbase + y1 * spitch);
+        d = (DWORD *)dbuf;
+        for (x = sx = 0; x < dstwidth; x++, sx += xinc)
+        {
+            x1 = min((sx >> 16) + 1, srcwidth - 1);
+            d[x] = lerp_8888(lerp_8888(row0[sx >> 16], row0[x1], (sx >> 8) & 0xff),
+                             lerp_8888(row1[sx >> 16], row1[x1], (sx >> 8) & 0xff),
+                             (sy >> 8) & 0xff);
+        }
+        dbuf += dpitch;
+    }
+}
+
 /*****************************************************************************
  * _Blt_ColorFill
  *
@@ -694,40 +886,17 @@ static HRESULT
                        int bpp, LONG lPitch,
                        DWORD color)
 {
-    int x, y;
+    int y;
     LPBYTE first;
 
-    /* Do first row */
-
-#define COLORFILL_ROW(type) \
-    { \
-    type *d = (type *) buf; \
-    for (x = 0; x < width; x++) \
-    d[x] = (type) color; \
-    break; \
-}
-    switch(bpp)
+    if (bpp < 1 || bpp > 4)
     {
-        case 1: COLORFILL_ROW(BYTE)
-                case 2: COLORFILL_ROW(WORD)
-        case 3:
-        {
-            BYTE *d = buf;
-            for (x = 0; x < width; x++,d+=3)
-            {
-                d[0] = (color    ) & 0xFF;
-                d[1] = (color>> 8) & 0xFF;
-                d[2] = (color>>16) & 0xFF;
-            }
-            break;
-        }
-        case 4: COLORFILL_ROW(DWORD)
-        default:
-            FIXME("Color fill not implemented for bpp %d!\n", bpp*8);
-            return WINED3DERR_NOTAVAILABLE;
+        FIXME("Color fill not implemented for bpp %d!\n", bpp*8);
+        return WINED3DERR_NOTAVAILABLE;
     }
 
-#undef COLORFILL_ROW
+    /* Do first row */
+    blt_row_funcs[bpp - 1].fill(buf, width, color);
 
     /* Now copy first row */
     first = buf;
@@ -794,9 +963,9 @@ IWineD3DBaseSurfaceImpl_Blt(IWineD3DSurface *iface,
         return WINEDDERR_SURFACEBUSY;
     }
 
-    if(Filter != WINED3DTEXF_NONE && Filter != WINED3DTEXF_POINT) {
+    if(Filter != WINED3DTEXF_NONE && Filter != WINED3DTEXF_POINT && Filter != WINED3DTEXF_LINEAR) {
         /* Can happen when d3d9 apps do a StretchRect call which isn't handled in gl */
-        FIXME("Filters not supported in software blit\n");
+        FIXME("Filter %d not supported in software blit\n", Filter);
     }
 
     if (Src == This)
@@ -1113,10 +1282,37 @@ IWineD3DBaseSurfaceImpl_Blt(IWineD3DSurface *iface,
                     }
                 }
             }
+            else if (Filter == WINED3DTEXF_LINEAR && bpp == 4 &&
+                     (dfmt == WINED3DFMT_A8R8G8B8 || dfmt == WINED3DFMT_X8R8G8B8 ||
+                      dfmt == WINED3DFMT_A8B8G8R8 || dfmt == WINED3DFMT_X8B8G8R8))
+            {
+                _Blt_StretchLinear(dbuf, dlock.Pitch, dstwidth, dstheight,
+                                   sbase, slock.Pitch, srcwidth, srcheight, xinc, yinc);
+            }
             else
             {
                 /* Stretching in X direction */
                 int last_sy = -1;
+                unsigned int *xoffs;
+
+                if (bpp < 1 || bpp > 4)
+                {
+                    FIXME("Stretched blit not implemented for bpp %d!\n", bpp*8);
+                    ret = WINED3DERR_NOTAVAILABLE;
+                    goto error;
+                }
+                if (Filter == WINED3DTEXF_LINEAR)
+                    FIXME("Linear filtering not supported for format %s, using point filtering\n",
+                          debug_d3dformat(dfmt));
+
+                /* The source pixel of each column is the same for all rows */
+                if (!(xoffs = HeapAlloc(GetProcessHeap(), 0, dstwidth * sizeof(*xoffs))))
+                {
+                    ret = E_OUTOFMEMORY;
+                    goto error;
+                }
+                for (x = sx = 0; x < dstwidth; x++, sx += xinc) xoffs[x] = sx >> 16;
+
                 for (y = sy = 0; y < dstheight; y++, sy += yinc)
                 {
                     sbuf = sbase + (sy >> 16) * slock.Pitch;
@@ -1130,43 +1326,12 @@ IWineD3DBaseSurfaceImpl_Blt(IWineD3DSurface *iface,
                     }
                     else
                     {
-#define STRETCH_ROW(type) { \
-                        type *s = (type *) sbuf, *d = (type *) dbuf; \
-                        for (x = sx = 0; x < dstwidth; x++, sx += xinc) \
-                        d[x] = s[sx >> 16]; \
-                        break; }
-
-                        switch(bpp)
-                        {
-                            case 1: STRETCH_ROW(BYTE)
-                                    case 2: STRETCH_ROW(WORD)
-                                            case 4: STRETCH_ROW(DWORD)
-                            case 3:
-                            {
-                                LPBYTE s,d = dbuf;
-                                for (x = sx = 0; x < dstwidth; x++, sx+= xinc)
-                                {
-                                    DWORD pixel;
-
-                                    s = sbuf+3*(sx>>16);
-                                    pixel = s[0]|(s[1]<<8)|(s[2]<<16);
-                                    d[0] = (pixel    )&0xff;
-                                    d[1] = (pixel>> 8)&0xff;
-                                    d[2] = (pixel>>16)&0xff;
-                                    d+=3;
-                                }
-                                break;
-                            }
-                            default:
-                                FIXME("Stretched blit not implemented for bpp %d!\n", bpp*8);
-                                ret = WINED3DERR_NOTAVAILABLE;
-                                goto error;
-                        }
-#undef STRETCH_ROW
+                        blt_row_funcs[bpp - 1].stretch(dbuf, sbuf, dstwidth, xoffs);
                     }
                     dbuf += dlock.Pitch;
                     last_sy = sy;
                 }
+                HeapFree(GetProcessHeap(), 0, xoffs);
             }
         }
         else
@@ -1296,6 +1461,23 @@ IWineD3DBaseSurfaceImpl_Blt(IWineD3DSurface *iface,
                 Flags &= ~(WINEDDBLT_DDFX);
             }
 
+            /* Plain source keyed copies, the most common case for sprites */
+            if (dstxinc == bpp && dstyinc == dlock.Pitch && xinc == 1 << 16 && yinc == 1 << 16 &&
+                destkeylow == 0 && destkeyhigh == 0xFFFFFFFF && bpp >= 1 && bpp <= 4)
+            {
+                sbuf = sbase;
+                for (y = 0; y < dstheight; y++)
+                {
+                    if (keylow <= keyhigh)
+                        blt_row_funcs[bpp - 1].colorkey(dbuf, sbuf, dstwidth, keymask, keylow, keyhigh);
+                    else
+                        memmove(dbuf, sbuf, width);
+                    sbuf += slock.Pitch;
+                    dbuf += dlock.Pitch;
+                }
+                goto error;
+            }
+
 #define COPY_COLORKEY_FX(type) { \
             type *s, *d = (type *) dbuf, *dx, tmp; \
             for (y = sy = 0; y < dstheight; y++, sy += yinc) { \
@@ -1396,7 +1578,7 @@ IWineD3DBaseSurfaceImpl_BltFast(IWineD3DSurface *iface,
     IWineD3DSurfaceImpl *This = (IWineD3DSurfaceImpl *) iface;
     IWineD3DSurfaceImpl *Src = (IWineD3DSurfaceImpl *) Source;
 
-    int                 bpp, w, h, x, y;
+    int                 bpp, w, h, y;
     WINED3DLOCKED_RECT  dlock,slock;
     HRESULT             ret = WINED3D_OK;
     RECT                rsrc2;
@@ -1550,54 +1732,22 @@ IWineD3DBaseSurfaceImpl_BltFast(IWineD3DSurface *iface,
             keyhigh = This->DestBltCKey.dwColorSpaceHighValue;
         }
 
-#define COPYBOX_COLORKEY(type) { \
-        type *d, *s, tmp; \
-        s = (type *) sbuf; \
-        d = (type *) dbuf; \
-        for (y = 0; y < h; y++) { \
-        for (x = 0; x < w; x++) { \
-        tmp = s[x]; \
-        if (tmp < keylow || tmp > keyhigh) d[x] = tmp; \
-    } \
-        s = (type *)((BYTE *)s + slock.Pitch); \
-        d = (type *)((BYTE *)d + dlock.Pitch); \
-    } \
-        break; \
-    }
-
-        switch (bpp) {
-            case 1: COPYBOX_COLORKEY(BYTE)
-                    case 2: COPYBOX_COLORKEY(WORD)
-                            case 4: COPYBOX_COLORKEY(DWORD)
-            case 3:
-            {
-                BYTE *d, *s;
-                DWORD tmp;
-                s = sbuf;
-                d = dbuf;
-                for (y = 0; y < h; y++)
-                {
-                    for (x = 0; x < w * 3; x += 3)
-                    {
-                        tmp = (DWORD)s[x] + ((DWORD)s[x + 1] << 8) + ((DWORD)s[x + 2] << 16);
-                        if (tmp < keylow || tmp > keyhigh)
-                        {
-                            d[x + 0] = s[x + 0];
-                            d[x + 1] = s[x + 1];
-                            d[x + 2] = s[x + 2];
-                        }
-                    }
-                    s += slock.Pitch;
-                    d += dlock.Pitch;
-                }
-                break;
-            }
-            default:
-                FIXME("Source color key blitting not supported for bpp %d\n",bpp*8);
-                ret = WINED3DERR_NOTAVAILABLE;
-                goto error;
+        if (bpp < 1 || bpp > 4)
+        {
+            FIXME("Source color key blitting not supported for bpp %d\n",bpp*8);
+            ret = WINED3DERR_NOTAVAILABLE;
+            goto error;
+        }
+
+        for (y = 0; y < h; y++)
+        {
+            if (keylow <= keyhigh)
+                blt_row_funcs[bpp - 1].colorkey(dbuf, sbuf, w, 0xFFFFFFFF, keylow, keyhigh);
+            else
+                memmove(dbuf, sbuf, w * bpp);
+            sbuf += slock.Pitch;
+            dbuf += dlock.Pitch;
         }
-#undef COPYBOX_COLORKEY
         TRACE("Copy Done\n");
     }
     else
@@ -132,6 +132,10 @@ static HRESULT WINAPI IWineD3DSwapChainImpl_Present(IWineD3DSwapChain *iface, CO
     unsigned int sync;
     int retval;
 
+    if(wined3d_cs_defer(This->wineD3DDevice)) {
+        return wined3d_cs_emit_present(This->wineD3DDevice->cs, iface, pSourceRect, pDestRect,
+                                       hDestWindowOverride, dwFlags);
+    }
 
     ActivateContext(This->wineD3DDevice, This->backBuffer[0], CTXUSAGE_RESOURCELOAD);
 
@@ -229,7 +233,14 @@ static HRESULT WINAPI IWineD3DSwapChainImpl_Present(IWineD3DSwapChain *iface, CO
         This->frames++;
         /* every 1.5 seconds */
         if (time - This->prev_time > 1500) {
+            WineD3DContext *context = This->wineD3DDevice->activeContext;
+
             TRACE_(fps)("%p @ approx %.2ffps\n", This, 1000.0*This->frames/(time - This->prev_time));
+            TRACE_(fps)("%p: %u state and constant GL calls per frame, %u redundant ones skipped\n", This,
+                        (unsigned int)(context->gl_calls / This->frames),
+                        (unsigned int)(context->gl_calls_skipped / This->frames));
+            context->gl_calls = 0;
+            context->gl_calls_skipped = 0;
             This->prev_time = time;
             This->frames = 0;
         }
@@ -571,7 +582,7 @@ WineD3DContext *IWineD3DSwapChainImpl_CreateContextForThread(IWineD3DSwapChain *
         return NULL;
     }
 
-    newArray = HeapAlloc(GetProcessHeap(), 0, sizeof(*newArray) * This->num_contexts + 1);
+    newArray = HeapAlloc(GetProcessHeap(), 0, sizeof(*newArray) * (This->num_contexts + 1));
     if(!newArray) {
         ERR("Out of memory when trying to allocate a new context array\n");
         DestroyContext(This->wineD3DDevice, ctx);
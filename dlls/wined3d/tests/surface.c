@@ -0,0 +1,307 @@
+/*
+ * Tests for the wined3d surface format conversions
+ *
+ * These run without GL, WineDirect3DConvertSurface is checked against
+ * straightforward per pixel versions of every conversion.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <stdarg.h>
+
+#include "windef.h"
+#include "winbase.h"
+#include "wine/wined3d_types.h"
+#include "wine/test.h"
+
+static HRESULT (WINAPI *pWineDirect3DConvertSurface)(const BYTE *src, BYTE *dst, UINT pitch, UINT width,
+        UINT height, UINT outpitch, CONVERT_TYPES convert, const DWORD *palette, DWORD ck_low,
+        DWORD ck_high, BOOL nv_texture_shader);
+
+struct convert_params
+{
+    const BYTE *palette;        /* 256 RGBA entries */
+    DWORD ck_low, ck_high;
+    BOOL nv_texture_shader;
+};
+
+typedef void (*convert_pixel_func)(const BYTE *src, BYTE *dst, const struct convert_params *p);
+
+static BOOL outside_ck(DWORD color, const struct convert_params *p)
+{
+    return color < p->ck_low || color > p->ck_high;
+}
+
+static void convert_paletted(const BYTE *src, BYTE *dst, const struct convert_params *p)
+{
+    memcpy(dst, p->palette + src[0] * 4, 4);
+}
+
+static void convert_ck_565(const BYTE *src, BYTE *dst, const struct convert_params *p)
+{
+    WORD color = *(const WORD *)src;
+    WORD *d = (WORD *)dst;
+
+    *d = (color & 0xffc0) | ((color & 0x1f) << 1);
+    if (outside_ck(color, p)) *d |= 0x0001;
+}
+
+static void convert_ck_5551(const BYTE *src, BYTE *dst, const struct convert_params *p)
+{
+    WORD color = *(const WORD *)src;
+    WORD *d = (WORD *)dst;
+
+    if (outside_ck(color, p)) *d = color | 0x8000;
+    else *d = color & ~0x8000;
+}
+
+static void convert_rgb32_888(const BYTE *src, BYTE *dst, const struct convert_params *p)
+{
+    DWORD color = *(const DWORD *)src & 0xffffff;
+
+    *(DWORD *)dst = (color << 8) | (outside_ck(color, p) ? 0xff : 0);
+}
+
+static void convert_v8u8(const BYTE *src, BYTE *dst, const struct convert_params *p)
+{
+    dst[0] = 0xff;
+    dst[1] = src[1] + 128;  /* V */
+    dst[2] = src[0] + 128;  /* U */
+}
+
+static void convert_v16u16(const BYTE *src, BYTE *dst, const struct convert_params *p)
+{
+    const WORD *s = (const WORD *)src;
+    WORD *d = (WORD *)dst;
+
+    d[0] = 0xffff;
+    d[1] = s[1] + 32768;    /* V */
+    d[2] = s[0] + 32768;    /* U */
+}
+
+static void convert_q8w8v8u8(const BYTE *src, BYTE *dst, const struct convert_params *p)
+{
+    dst[0] = src[2] + 128;  /* W */
+    dst[1] = src[1] + 128;  /* V */
+    dst[2] = src[0] + 128;  /* U */
+    dst[3] = src[3] + 128;  /* Q */
+}
+
+static void convert_l6v5u5(const BYTE *src, BYTE *dst, const struct convert_params *p)
+{
+    /* signed, the sign bits end up in the top bits of L */
+    short color = *(const short *)src;
+    BYTE l = (color >> 10) & 0xfc, v = (color >> 5) & 0x3e, u = color & 0x1f;
+
+    if (p->nv_texture_shader)
+    {
+        dst[0] = u << 3;
+        dst[1] = v << 3;
+        dst[2] = l << 1;
+    }
+    else
+    {
+        *(WORD *)dst = (((v + 16) << 11) & 0xf800) | ((l << 5) & 0x7e0) | ((u + 16) & 0x1f);
+    }
+}
+
+static void convert_x8l8v8u8(const BYTE *src, BYTE *dst, const struct convert_params *p)
+{
+    if (p->nv_texture_shader)
+    {
+        memcpy(dst, src, 3);
+        dst[3] = 0xff;
+    }
+    else
+    {
+        dst[0] = src[2];        /* L */
+        dst[1] = src[1] + 128;  /* V */
+        dst[2] = src[0] + 128;  /* U */
+    }
+}
+
+static void convert_a4l4(const BYTE *src, BYTE *dst, const struct convert_params *p)
+{
+    dst[0] = (src[0] & 0x0f) << 4;
+    dst[1] = src[0] & 0xf0;
+}
+
+static void convert_r32f(const BYTE *src, BYTE *dst, const struct convert_params *p)
+{
+    float *d = (float *)dst;
+
+    d[0] = *(const float *)src;
+    d[1] = 1.0f;
+    d[2] = 1.0f;
+}
+
+static void convert_r16f(const BYTE *src, BYTE *dst, const struct convert_params *p)
+{
+    WORD *d = (WORD *)dst;
+
+    d[0] = *(const WORD *)src;
+    d[1] = 0x3c00;
+    d[2] = 0x3c00;
+}
+
+static void convert_g16r16(const BYTE *src, BYTE *dst, const struct convert_params *p)
+{
+    const WORD *s = (const WORD *)src;
+    WORD *d = (WORD *)dst;
+
+    d[0] = s[0];
+    d[1] = s[1];
+    d[2] = 0xffff;
+}
+
+static const struct
+{
+    CONVERT_TYPES type;
+    const char *name;
+    UINT src_bpp, dst_bpp;
+    BOOL nv_texture_shader;
+    convert_pixel_func convert_pixel;
+}
+conversions[] =
+{
+    {CONVERT_PALETTED,    "CONVERT_PALETTED",    1, 4,  FALSE, convert_paletted},
+    {CONVERT_PALETTED_CK, "CONVERT_PALETTED_CK", 1, 4,  FALSE, convert_paletted},
+    {CONVERT_CK_565,      "CONVERT_CK_565",      2, 2,  FALSE, convert_ck_565},
+    {CONVERT_CK_5551,     "CONVERT_CK_5551",     2, 2,  FALSE, convert_ck_5551},
+    {CONVERT_RGB32_888,   "CONVERT_RGB32_888",   4, 4,  FALSE, convert_rgb32_888},
+    {CONVERT_V8U8,        "CONVERT_V8U8",        2, 3,  FALSE, convert_v8u8},
+    {CONVERT_V16U16,      "CONVERT_V16U16",      4, 6,  FALSE, convert_v16u16},
+    {CONVERT_Q8W8V8U8,    "CONVERT_Q8W8V8U8",    4, 4,  FALSE, convert_q8w8v8u8},
+    {CONVERT_L6V5U5,      "CONVERT_L6V5U5",      2, 2,  FALSE, convert_l6v5u5},
+    {CONVERT_L6V5U5,      "CONVERT_L6V5U5 (NV)", 2, 3,  TRUE,  convert_l6v5u5},
+    {CONVERT_X8L8V8U8,    "CONVERT_X8L8V8U8",    4, 4,  FALSE, convert_x8l8v8u8},
+    {CONVERT_X8L8V8U8,    "CONVERT_X8L8V8U8 (NV)", 4, 4, TRUE, convert_x8l8v8u8},
+    {CONVERT_A4L4,        "CONVERT_A4L4",        1, 2,  FALSE, convert_a4l4},
+    {CONVERT_R32F,        "CONVERT_R32F",        4, 12, FALSE, convert_r32f},
+    {CONVERT_R16F,        "CONVERT_R16F",        2, 6,  FALSE, convert_r16f},
+    {CONVERT_G16R16,      "CONVERT_G16R16",      4, 6,  FALSE, convert_g16r16},
+};
+
+static DWORD rand_seed;
+
+static BYTE rand_byte(void)
+{
+    rand_seed = rand_seed * 1103515245 + 12345;
+    return rand_seed >> 16;
+}
+
+static void test_conversion(unsigned int idx, UINT width, UINT height)
+{
+    UINT pitch = width * conversions[idx].src_bpp + 3;
+    UINT outpitch = width * conversions[idx].dst_bpp + 5;
+    struct convert_params params;
+    BYTE palette[256 * 4];
+    BYTE *src, *dst, *expected;
+    UINT x, y, i, diff;
+    HRESULT hr;
+
+    src = HeapAlloc(GetProcessHeap(), 0, pitch * height);
+    dst = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, outpitch * height);
+    expected = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, outpitch * height);
+    if (!src || !dst || !expected)
+    {
+        skip("not enough memory for a %ux%u surface\n", width, height);
+        goto done;
+    }
+
+    rand_seed = idx;
+    for (i = 0; i < sizeof(palette); i++) palette[i] = rand_byte();
+    for (i = 0; i < pitch * height; i++) src[i] = rand_byte();
+    if (conversions[idx].type == CONVERT_R32F)
+    {
+        /* avoid NaNs, copying them through the FPU may change them */
+        for (y = 0; y < height; y++)
+            for (x = 0; x < width; x++)
+                ((float *)(src + y * pitch))[x] = (float)(x * 7 + y) / 3.0f - 100.0f;
+    }
+
+    /* the key ranges cut through the middle of the value range, so that both
+     * keyed and unkeyed pixels show up */
+    params.palette = palette;
+    params.ck_low = conversions[idx].src_bpp == 2 ? 0x4000 : 0x400000;
+    params.ck_high = conversions[idx].src_bpp == 2 ? 0xa000 : 0xa00000;
+    params.nv_texture_shader = conversions[idx].nv_texture_shader;
+
+    for (y = 0; y < height; y++)
+        for (x = 0; x < width; x++)
+            conversions[idx].convert_pixel(src + y * pitch + x * conversions[idx].src_bpp,
+                    expected + y * outpitch + x * conversions[idx].dst_bpp, &params);
+
+    hr = pWineDirect3DConvertSurface(src, dst, pitch, width, height, outpitch, conversions[idx].type,
+            (const DWORD *)palette, params.ck_low, params.ck_high, params.nv_texture_shader);
+    ok(hr == S_OK, "%s: WineDirect3DConvertSurface returned %#x\n", conversions[idx].name, hr);
+
+    for (diff = 0; diff < outpitch * height; diff++)
+        if (dst[diff] != expected[diff]) break;
+    if (diff < outpitch * height)
+        ok(FALSE, "%s %ux%u: byte %u of row %u is %#x, expected %#x\n", conversions[idx].name, width,
+           height, diff % outpitch, diff / outpitch, dst[diff], expected[diff]);
+
+done:
+    HeapFree(GetProcessHeap(), 0, src);
+    HeapFree(GetProcessHeap(), 0, dst);
+    HeapFree(GetProcessHeap(), 0, expected);
+}
+
+static void test_conversions(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(conversions) / sizeof(conversions[0]); i++)
+    {
+        test_conversion(i, 1, 1);
+        test_conversion(i, 7, 5);
+        /* big enough to be cut into bands on all threads */
+        test_conversion(i, 515, 1021);
+    }
+}
+
+static void test_invalid_conversion(void)
+{
+    BYTE src[4] = {0}, dst[4] = {0};
+    HRESULT hr;
+
+    hr = pWineDirect3DConvertSurface(src, dst, 4, 1, 1, 4, NO_CONVERSION, NULL, 0, 0, FALSE);
+    ok(hr != S_OK, "WineDirect3DConvertSurface succeeded for NO_CONVERSION\n");
+    hr = pWineDirect3DConvertSurface(src, dst, 4, 1, 1, 4, CONVERT_CK_8888, NULL, 0, 0, FALSE);
+    ok(hr != S_OK, "WineDirect3DConvertSurface succeeded for CONVERT_CK_8888\n");
+}
+
+START_TEST(surface)
+{
+    HMODULE wined3d = LoadLibraryA("wined3d.dll");
+
+    if (!wined3d)
+    {
+        skip("wined3d.dll is not available\n");
+        return;
+    }
+    pWineDirect3DConvertSurface = (void *)GetProcAddress(wined3d, "WineDirect3DConvertSurface");
+    if (!pWineDirect3DConvertSurface)
+    {
+        win_skip("WineDirect3DConvertSurface is not available\n");
+        FreeLibrary(wined3d);
+        return;
+    }
+
+    test_conversions();
+    test_invalid_conversion();
+    FreeLibrary(wined3d);
+}
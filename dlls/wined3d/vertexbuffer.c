@@ -718,6 +718,8 @@ static HRESULT  WINAPI IWineD3DVertexBufferImpl_Lock(IWineD3DVertexBuffer *iface
     BYTE *data;
     TRACE("(%p)->%d, %d, %p, %08x\n", This, OffsetToLock, SizeToLock, ppbData, Flags);
 
+    /* Queued draws may still read the old contents */
+    wined3d_cs_sync(This->resource.wineD3DDevice);
     InterlockedIncrement(&This->lockcount);
 
     if(This->Flags & VBFLAG_DIRTY) {
@@ -68,6 +68,8 @@ static ULONG WINAPI IWineD3DVertexDeclarationImpl_Release(IWineD3DVertexDeclarat
     TRACE("(%p) : Releasing from %d\n", This, This->ref);
     ref = InterlockedDecrement(&This->ref);
     if (ref == 0) {
+        /* The declaration isn't referenced by the state block, queued draws may still use it */
+        wined3d_cs_sync(This->wineD3DDevice);
         if(iface == This->wineD3DDevice->stateBlock->vertexDecl) {
             /* See comment in PixelShader::Release */
             IWineD3DDeviceImpl_MarkStateDirty(This->wineD3DDevice, STATE_VDECL);
@@ -1,2 +1,3 @@
 @ stdcall WineDirect3DCreate(long long ptr)
 @ stdcall WineDirect3DCreateClipper(ptr)
+@ stdcall -private WineDirect3DConvertSurface(ptr ptr long long long long long ptr long long long)
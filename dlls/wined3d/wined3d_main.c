@@ -45,7 +45,8 @@ wined3d_settings_t wined3d_settings =
     RTL_AUTO,       /* Automatically determine best locking method */
     0,              /* The default of memory is set in FillGLCaps */
     NULL,           /* No wine logo by default */
-    FALSE           /* Disable multisampling for now due to Nvidia driver bugs which happens for some users */
+    FALSE,          /* Disable multisampling for now due to Nvidia driver bugs which happens for some users */
+    FALSE           /* No command stream thread by default */
 };
 
 IWineD3D* WINAPI WineDirect3DCreate(UINT SDKVersion, UINT dxVersion, IUnknown *parent) {
@@ -269,6 +270,14 @@ BOOL WINAPI DllMain(HINSTANCE hInstDLL, DWORD fdwReason, LPVOID lpv)
                     wined3d_settings.allow_multisampling = TRUE;
                 }
             }
+            if ( !get_config_key( hkey, appkey, "CSMT", buffer, size) )
+            {
+                if (!strcmp(buffer,"enabled"))
+                {
+                    TRACE("Using a command stream thread\n");
+                    wined3d_settings.cs_multithreaded = TRUE;
+                }
+            }
        }
        if (wined3d_settings.vs_mode == VS_HW)
            TRACE("Allow HW vertex shaders\n");
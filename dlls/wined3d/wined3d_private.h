@@ -153,50 +153,34 @@ static inline float float_16_to_32(const unsigned short *in) {
 }
 
 static inline unsigned short float_32_to_16(const float *in) {
-    int exp = 0;
-    float tmp = fabs(*in);
+    /* Works on the IEEE representation directly, which gives the same results
+     * as scaling the value into [2^10, 2^11) without a loop per bit. */
+    DWORD bits = *(const DWORD *)in;
+    int exp = ((bits >> 23) & 0xff) - 127 + 15; /* Exponent is encoded with excess 15 */
     unsigned int mantissa;
     unsigned short ret;
 
     /* Deal with special numbers */
-    if(*in == 0.0) return 0x0000;
-    if(isnan(*in)) return 0x7C01;
-    if(isinf(*in)) return (*in < 0.0 ? 0xFC00 : 0x7c00);
-
-    if(tmp < pow(2, 10)) {
-        do
-        {
-            tmp = tmp * 2.0;
-            exp--;
-        }while(tmp < pow(2, 10));
-    } else if(tmp >= pow(2, 11)) {
-        do
-        {
-            tmp /= 2.0;
-            exp++;
-        }while(tmp >= pow(2, 11));
+    if(!(bits & 0x7fffffff)) return 0x0000;
+    if(((bits >> 23) & 0xff) == 0xff) {
+        if(bits & 0x7fffff) return 0x7C01; /* NAN */
+        return (bits & 0x80000000 ? 0xFC00 : 0x7c00);
     }
 
-    mantissa = (unsigned int) tmp;
-    if(tmp - mantissa >= 0.5) mantissa++; /* round to nearest, away from zero */
-
-    exp += 10;  /* Normalize the mantissa */
-    exp += 15;  /* Exponent is encoded with excess 15 */
+    mantissa = ((bits & 0x7fffff) | 0x800000) >> 13;
+    if(bits & 0x1000) mantissa++; /* round to nearest, away from zero */
 
     if(exp > 30) { /* too big */
         ret = 0x7c00; /* INF */
     } else if(exp <= 0) {
         /* exp == 0: Non-normalized mantissa. Returns 0x0000 (=0.0) for too small numbers */
-        while(exp <= 0) {
-            mantissa = mantissa >> 1;
-            exp++;
-        }
+        mantissa = exp > -12 ? mantissa >> (1 - exp) : 0;
         ret = mantissa & 0x3ff;
     } else {
         ret = (exp << 10) | (mantissa & 0x3ff);
     }
 
-    ret |= ((*in < 0.0 ? 1 : 0) << 15); /* Add the sign */
+    ret |= ((bits & 0x80000000 ? 1 : 0) << 15); /* Add the sign */
     return ret;
 }
 
@@ -249,6 +233,8 @@ typedef struct wined3d_settings_s {
   unsigned int emulated_textureram;
   char *logo;
   int allow_multisampling;
+/* Replay the device calls on a worker thread, see cs.c */
+  BOOL cs_multithreaded;
 } wined3d_settings_t;
 
 extern wined3d_settings_t wined3d_settings;
@@ -589,6 +575,15 @@ struct StateEntry
 /* "Base" state table */
 extern const struct StateEntry FFPStateTable[];
 
+/* Slots in WineD3DContext::cap_state, see context_set_cap() */
+#define CAP_SLOT_LIGHT0         21
+#define CAP_SLOT_CLIP_PLANE0    (CAP_SLOT_LIGHT0 + MAX_ACTIVE_LIGHTS)
+#define CAP_SLOT_COUNT          (CAP_SLOT_CLIP_PLANE0 + MAX_CLIPPLANES)
+
+#define CAP_UNKNOWN             0   /* New contexts are zeroed */
+#define CAP_DISABLED            1
+#define CAP_ENABLED             2
+
 /* The new context manager that should deal with onscreen and offscreen rendering */
 struct WineD3DContext {
     /* State dirtification
@@ -621,6 +616,13 @@ struct WineD3DContext {
 
     char                    *vshader_const_dirty, *pshader_const_dirty;
 
+    /* Shadow of the enable state of the capabilities listed in context_cap_slot(). Code that
+     * toggles one of them has to use context_set_cap(), or restore it with glPopAttrib
+     */
+    BYTE                    cap_state[CAP_SLOT_COUNT];
+    /* State and constant GL calls made and skipped as redundant, reported on the fps channel */
+    DWORD                   gl_calls, gl_calls_skipped;
+
     /* The actual opengl context */
     HGLRC                   glCtx;
     HWND                    win_handle;
@@ -641,6 +643,7 @@ void ActivateContext(IWineD3DDeviceImpl *device, IWineD3DSurface *target, Contex
 WineD3DContext *CreateContext(IWineD3DDeviceImpl *This, IWineD3DSurfaceImpl *target, HWND win, BOOL create_pbuffer, const WINED3DPRESENT_PARAMETERS *pPresentParms);
 void DestroyContext(IWineD3DDeviceImpl *This, WineD3DContext *context);
 void apply_fbo_state(IWineD3DDevice *iface);
+void context_set_cap(WineD3DContext *context, GLenum cap, BOOL enable);
 
 /* Macros for doing basic GPU detection based on opengl capabilities */
 #define WINE_D3D6_CAPABLE(gl_info) (gl_info->supported[ARB_MULTITEXTURE])
@@ -922,6 +925,9 @@ struct IWineD3DDeviceImpl
     WineD3DContext          *pbufferContext;             /* The context that has a pbuffer as drawable */
     DWORD                   pbufferWidth, pbufferHeight; /* Size of the buffer drawable */
 
+    /* Command stream, NULL unless CSMT is enabled */
+    struct wined3d_cs       *cs;
+
     /* High level patch management */
 #define PATCHMAP_SIZE 43
 #define PATCHMAP_HASHFUNC(x) ((x) % PATCHMAP_SIZE) /* Primitive and simple function */
@@ -942,6 +948,89 @@ static inline BOOL isStateDirty(WineD3DContext *context, DWORD state) {
     return context->isStateDirty[idx] & (1 << shift);
 }
 
+/*****************************************************************************
+ * Command stream
+ *
+ * With CSMT enabled, the state setters, draws, clears, presents and queries
+ * of the device are recorded into a ring by the application and executed in
+ * order by a worker thread, which owns the GL context. Everything else waits
+ * until the worker has drained the ring and runs on the calling thread.
+ */
+#define CS_RING_SIZE            (1024 * 1024)   /* Must be a power of two */
+#define CS_MAX_PENDING_PRESENTS 2
+#define CS_MAX_CLEAR_RECTS      4096
+
+struct wined3d_cs
+{
+    IWineD3DDeviceImpl     *device;
+    HANDLE                  thread;
+    DWORD                   thread_id;
+    HANDLE                  work_event;     /* Signalled when the application published ops */
+    HANDLE                  idle_event;     /* Signalled when the worker retired ops */
+    LONG                    worker_waiting;
+    LONG                    app_waiting;
+    LONG                    head;           /* Written by the application only */
+    LONG                    tail;           /* Written by the worker only */
+    ULONG                   reclaimed;      /* The references of the ops before this were released */
+    ULONG                   presents[CS_MAX_PENDING_PRESENTS];
+    unsigned int            present_idx;
+    BOOL                    direct;         /* The application calls the setters itself */
+    BOOL                    indices_recorded;   /* A SetIndices op is queued since the last finish */
+    BOOL                    has_indices;
+    BOOL                    vertex_declaration_recorded;
+    BOOL                    has_vertex_declaration;
+    LONG                    present_hr;     /* Failure of a present on the worker */
+    BOOL                    app_gl_dirty;
+    BOOL                    worker_gl_dirty;
+    BYTE                   *ring;
+};
+
+HRESULT wined3d_cs_create(IWineD3DDeviceImpl *device);
+void wined3d_cs_destroy(IWineD3DDeviceImpl *device);
+void wined3d_cs_finish(struct wined3d_cs *cs);
+HRESULT wined3d_cs_emit_set_render_state(struct wined3d_cs *cs, WINED3DRENDERSTATETYPE state, DWORD value);
+HRESULT wined3d_cs_emit_set_sampler_state(struct wined3d_cs *cs, DWORD sampler,
+        WINED3DSAMPLERSTATETYPE type, DWORD value);
+HRESULT wined3d_cs_emit_set_texture_stage_state(struct wined3d_cs *cs, DWORD stage,
+        WINED3DTEXTURESTAGESTATETYPE type, DWORD value);
+HRESULT wined3d_cs_emit_set_transform(struct wined3d_cs *cs, WINED3DTRANSFORMSTATETYPE state,
+        const WINED3DMATRIX *matrix);
+HRESULT wined3d_cs_emit_set_texture(struct wined3d_cs *cs, DWORD stage, IWineD3DBaseTexture *texture);
+HRESULT wined3d_cs_emit_set_stream_source(struct wined3d_cs *cs, UINT stream,
+        IWineD3DVertexBuffer *buffer, UINT offset, UINT stride);
+HRESULT wined3d_cs_emit_set_indices(struct wined3d_cs *cs, IWineD3DIndexBuffer *buffer);
+HRESULT wined3d_cs_emit_set_vertex_declaration(struct wined3d_cs *cs, IWineD3DVertexDeclaration *declaration);
+HRESULT wined3d_cs_emit_set_vertex_shader(struct wined3d_cs *cs, IWineD3DVertexShader *shader);
+HRESULT wined3d_cs_emit_set_pixel_shader(struct wined3d_cs *cs, IWineD3DPixelShader *shader);
+HRESULT wined3d_cs_emit_set_vs_consts_f(struct wined3d_cs *cs, UINT start, const float *data, UINT count);
+HRESULT wined3d_cs_emit_set_ps_consts_f(struct wined3d_cs *cs, UINT start, const float *data, UINT count);
+HRESULT wined3d_cs_emit_set_viewport(struct wined3d_cs *cs, const WINED3DVIEWPORT *viewport);
+HRESULT wined3d_cs_emit_set_material(struct wined3d_cs *cs, const WINED3DMATERIAL *material);
+HRESULT wined3d_cs_emit_set_base_vertex_index(struct wined3d_cs *cs, INT index);
+HRESULT wined3d_cs_emit_draw(struct wined3d_cs *cs, WINED3DPRIMITIVETYPE type, UINT start_vertex, UINT count);
+HRESULT wined3d_cs_emit_draw_indexed(struct wined3d_cs *cs, WINED3DPRIMITIVETYPE type, UINT min_index,
+        UINT num_vertices, UINT start_index, UINT count);
+HRESULT wined3d_cs_emit_clear(struct wined3d_cs *cs, DWORD count, const WINED3DRECT *rects,
+        DWORD flags, WINED3DCOLOR color, float z, DWORD stencil);
+HRESULT wined3d_cs_emit_present(struct wined3d_cs *cs, IWineD3DSwapChain *swapchain, const RECT *src_rect,
+        const RECT *dst_rect, HWND dst_window_override, DWORD flags);
+HRESULT wined3d_cs_emit_create_query(struct wined3d_cs *cs, WINED3DQUERYTYPE type,
+        IWineD3DQuery **query, IUnknown *parent);
+HRESULT wined3d_cs_emit_query_issue(struct wined3d_cs *cs, IWineD3DQuery *query, DWORD flags);
+HRESULT wined3d_cs_emit_query_get_data(struct wined3d_cs *cs, IWineD3DQuery *query,
+        void *data, DWORD size, DWORD flags);
+void wined3d_cs_emit_query_destroy(struct wined3d_cs *cs, IWineD3DQuery *query);
+
+/* TRUE if a recordable call made on this thread has to go through the command stream */
+static inline BOOL wined3d_cs_defer(IWineD3DDeviceImpl *device) {
+    return device->cs && !device->cs->direct && device->cs->thread_id != GetCurrentThreadId();
+}
+
+/* Waits for the worker before the calling thread touches the device state or GL */
+static inline void wined3d_cs_sync(IWineD3DDeviceImpl *device) {
+    if(device->cs && device->cs->thread_id != GetCurrentThreadId()) wined3d_cs_finish(device->cs);
+}
+
 /* Support for IWineD3DResource ::Set/Get/FreePrivateData. */
 typedef struct PrivateData
 {
@@ -1397,31 +1486,6 @@ void get_drawable_size_fbo(IWineD3DSurfaceImpl *This, UINT *width, UINT *height)
                           SFLAG_INDRAWABLE)
 BOOL CalculateTexRect(IWineD3DSurfaceImpl *This, RECT *Rect, float glTexCoord[4]);
 
-typedef enum {
-    NO_CONVERSION,
-    CONVERT_PALETTED,
-    CONVERT_PALETTED_CK,
-    CONVERT_CK_565,
-    CONVERT_CK_5551,
-    CONVERT_CK_4444,
-    CONVERT_CK_4444_ARGB,
-    CONVERT_CK_1555,
-    CONVERT_555,
-    CONVERT_CK_RGB24,
-    CONVERT_CK_8888,
-    CONVERT_CK_8888_ARGB,
-    CONVERT_RGB32_888,
-    CONVERT_V8U8,
-    CONVERT_L6V5U5,
-    CONVERT_X8L8V8U8,
-    CONVERT_Q8W8V8U8,
-    CONVERT_V16U16,
-    CONVERT_A4L4,
-    CONVERT_R32F,
-    CONVERT_R16F,
-    CONVERT_G16R16,
-} CONVERT_TYPES;
-
 HRESULT d3dfmt_get_conv(IWineD3DSurfaceImpl *This, BOOL need_alpha_ck, BOOL use_texturing, GLenum *format, GLenum *internal, GLenum *type, CONVERT_TYPES *convert, int *target_bpp, BOOL srgb_mode);
 
 BOOL palette9_changed(IWineD3DSurfaceImpl *This);
@@ -1665,6 +1729,7 @@ typedef struct IWineD3DQueryImpl
 extern const IWineD3DQueryVtbl IWineD3DQuery_Vtbl;
 extern const IWineD3DQueryVtbl IWineD3DEventQuery_Vtbl;
 extern const IWineD3DQueryVtbl IWineD3DOcclusionQuery_Vtbl;
+void query_destroy(IWineD3DQueryImpl *query);
 
 /* Datastructures for IWineD3DQueryImpl.extendedData */
 typedef struct  WineQueryOcclusionData {
@@ -1821,6 +1886,8 @@ struct glsl_shader_prog_link {
     GLhandleARB             programId;
     GLhandleARB             *vuniformF_locations;
     GLhandleARB             *puniformF_locations;
+    float                   *vuniformF_values;      /* Last values loaded, 4 floats per constant */
+    float                   *puniformF_values;
     GLhandleARB             vuniformI_locations[MAX_CONST_I];
     GLhandleARB             puniformI_locations[MAX_CONST_I];
     GLhandleARB             posFixup_location;
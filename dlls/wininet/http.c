@@ -44,6 +44,9 @@
 #endif
 #include <time.h>
 #include <assert.h>
+#ifdef HAVE_ZLIB
+# include <zlib.h>
+#endif
 
 #include "windef.h"
 #include "winbase.h"
@@ -106,7 +109,7 @@ struct HttpAuthInfo
     BOOL finished; /* finished authenticating */
 };
 
-static BOOL HTTP_OpenConnection(LPWININETHTTPREQW lpwhr);
+static BOOL HTTP_OpenConnection(LPWININETHTTPREQW lpwhr, BOOL *reused);
 static BOOL HTTP_GetResponseHeaders(LPWININETHTTPREQW lpwhr, BOOL clear);
 static BOOL HTTP_ProcessHeader(LPWININETHTTPREQW lpwhr, LPCWSTR field, LPCWSTR value, DWORD dwModifier);
 static LPWSTR * HTTP_InterpretHttpHeader(LPCWSTR buffer);
@@ -121,6 +124,11 @@ static BOOL HTTP_HandleRedirect(LPWININETHTTPREQW lpwhr, LPCWSTR lpszUrl);
 static UINT HTTP_DecodeBase64(LPCWSTR base64, LPSTR bin);
 static BOOL HTTP_VerifyValidHeader(LPWININETHTTPREQW lpwhr, LPCWSTR field);
 static void HTTP_DrainContent(WININETHTTPREQW *req);
+static BOOL HTTP_GetRequestURL(WININETHTTPREQW *req, LPWSTR buf);
+static void HTTP_clear_response_headers(LPWININETHTTPREQW lpwhr);
+static void HTTP_InitGzipStream(WININETHTTPREQW *req);
+static void HTTP_FreeGzipStream(WININETHTTPREQW *req);
+static void HTTP_SetStatus(LPWININETHTTPREQW lpwhr, LPCWSTR version, LPCWSTR status_code, LPCWSTR status_text);
 
 LPHTTPHEADERW HTTP_GetHeader(LPWININETHTTPREQW req, LPCWSTR head)
 {
@@ -864,6 +872,8 @@ BOOL WINAPI HttpEndRequestW(HINTERNET hRequest,
     if (lpwhr->dwContentLength == 0)
         HTTP_FinishedReading(lpwhr);
 
+    HTTP_InitGzipStream(lpwhr);
+
     if(!(lpwhr->hdr.dwFlags & INTERNET_FLAG_NO_AUTO_REDIRECT))
     {
         DWORD dwCode,dwCodeLength=sizeof(DWORD);
@@ -1354,12 +1364,247 @@ static BOOL HTTP_ResolveName(LPWININETHTTPREQW lpwhr)
 }
 
 
+/* Idle keep-alive connections are shared between all request handles of the
+ * process, so that a new request to a server we have just talked to doesn't
+ * have to pay for another TCP connect and TLS handshake. */
+typedef struct
+{
+    struct list entry;
+    LPWSTR lpszServerName;
+    INTERNET_PORT nServerPort;
+    BOOL secure;
+    DWORD dwIdleSince;
+    WININET_NETCONNECTION netConnection;
+} HTTPPOOLEDCONNECTION;
+
+#define HTTP_POOL_IDLE_TIMEOUT      60000 /* ms */
+#define HTTP_POOL_MAX_CONNECTIONS   16
+
+static struct list connection_pool = LIST_INIT(connection_pool);
+static DWORD connection_pool_size;
+
+static CRITICAL_SECTION connection_pool_cs;
+static CRITICAL_SECTION_DEBUG connection_pool_cs_debug =
+{
+    0, 0, &connection_pool_cs,
+    { &connection_pool_cs_debug.ProcessLocksList, &connection_pool_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": connection_pool_cs") }
+};
+static CRITICAL_SECTION connection_pool_cs = { &connection_pool_cs_debug, -1, 0, 0, 0, 0 };
+
+static void HTTP_FreePooledConnection(HTTPPOOLEDCONNECTION *conn)
+{
+    NETCON_close(&conn->netConnection);
+    HeapFree(GetProcessHeap(), 0, conn->lpszServerName);
+    HeapFree(GetProcessHeap(), 0, conn);
+}
+
+/* moves connections that have been idle for too long, and the oldest ones
+ * if the pool is full, to the expired list; called with connection_pool_cs
+ * held */
+static void HTTP_ExpirePooledConnections(struct list *expired)
+{
+    HTTPPOOLEDCONNECTION *conn, *next;
+    DWORD now = GetTickCount();
+
+    LIST_FOR_EACH_ENTRY_SAFE_REV(conn, next, &connection_pool, HTTPPOOLEDCONNECTION, entry)
+    {
+        if (now - conn->dwIdleSince < HTTP_POOL_IDLE_TIMEOUT &&
+            connection_pool_size <= HTTP_POOL_MAX_CONNECTIONS)
+            break;
+        list_remove(&conn->entry);
+        list_add_tail(expired, &conn->entry);
+        connection_pool_size--;
+    }
+}
+
+static void HTTP_FreeExpiredConnections(struct list *expired)
+{
+    HTTPPOOLEDCONNECTION *conn, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE(conn, next, expired, HTTPPOOLEDCONNECTION, entry)
+    {
+        TRACE("closing idle connection to %s:%u\n",
+              debugstr_w(conn->lpszServerName), conn->nServerPort);
+        list_remove(&conn->entry);
+        HTTP_FreePooledConnection(conn);
+    }
+}
+
+/* Tunnels through a proxy are bound to the host behind it, which isn't part
+ * of the key, so those are never pooled. */
+static BOOL HTTP_CanPoolConnection(LPWININETHTTPREQW lpwhr, BOOL secure)
+{
+    LPWININETHTTPSESSIONW lpwhs = lpwhr->lpHttpSession;
+
+    if (!lpwhs->lpszServerName)
+        return FALSE;
+    if (secure && lpwhs->lpAppInfo->lpszProxy)
+        return FALSE;
+    return TRUE;
+}
+
+/***********************************************************************
+ *           HTTP_PoolConnection (internal)
+ *
+ * Hand the connection of a finished request over to the pool.
+ *
+ * RETURNS
+ *    TRUE  if the pool took the connection
+ *    FALSE if the caller still owns it
+ */
+static BOOL HTTP_PoolConnection(LPWININETHTTPREQW lpwhr)
+{
+    LPWININETHTTPSESSIONW lpwhs = lpwhr->lpHttpSession;
+    HTTPPOOLEDCONNECTION *conn;
+    struct list expired = LIST_INIT(expired);
+    DWORD available;
+
+    /* connection based authentication schemes tie the credentials of
+     * this request to the socket */
+    if (!lpwhr->bReusable || lpwhr->pAuthInfo || lpwhr->pProxyAuthInfo)
+        return FALSE;
+    if (!NETCON_connected(&lpwhr->netConnection) ||
+        !HTTP_CanPoolConnection(lpwhr, lpwhr->netConnection.useSSL))
+        return FALSE;
+    if (!NETCON_query_data_available(&lpwhr->netConnection, &available) || available)
+        return FALSE;
+
+    conn = HeapAlloc(GetProcessHeap(), 0, sizeof(*conn));
+    if (!conn)
+        return FALSE;
+    conn->lpszServerName = WININET_strdupW(lpwhs->lpszServerName);
+    if (!conn->lpszServerName)
+    {
+        HeapFree(GetProcessHeap(), 0, conn);
+        return FALSE;
+    }
+    conn->nServerPort = lpwhs->nServerPort;
+    /* a redirect may have changed the flags of the request already, so go
+     * by what the connection actually is */
+    conn->secure = lpwhr->netConnection.useSSL;
+    conn->dwIdleSince = GetTickCount();
+    conn->netConnection = lpwhr->netConnection;
+
+    memset(&lpwhr->netConnection, 0, sizeof(lpwhr->netConnection));
+    lpwhr->netConnection.socketFD = -1;
+    lpwhr->bReusable = FALSE;
+
+    TRACE("pooling connection to %s:%u\n", debugstr_w(conn->lpszServerName), conn->nServerPort);
+
+    EnterCriticalSection(&connection_pool_cs);
+    list_add_head(&connection_pool, &conn->entry);
+    connection_pool_size++;
+    HTTP_ExpirePooledConnections(&expired);
+    LeaveCriticalSection(&connection_pool_cs);
+
+    HTTP_FreeExpiredConnections(&expired);
+    return TRUE;
+}
+
+/***********************************************************************
+ *           HTTP_GetPooledConnection (internal)
+ *
+ * Take an idle connection to the server of the request from the pool.
+ *
+ * RETURNS
+ *    TRUE  if lpwhr->netConnection now holds a pooled connection
+ *    FALSE if a new connection has to be established
+ */
+static BOOL HTTP_GetPooledConnection(LPWININETHTTPREQW lpwhr)
+{
+    LPWININETHTTPSESSIONW lpwhs = lpwhr->lpHttpSession;
+    BOOL secure = (lpwhr->hdr.dwFlags & INTERNET_FLAG_SECURE) != 0;
+    HTTPPOOLEDCONNECTION *conn, *found;
+    struct list expired;
+
+    if (!HTTP_CanPoolConnection(lpwhr, secure))
+        return FALSE;
+
+    for (;;)
+    {
+        found = NULL;
+        list_init(&expired);
+
+        EnterCriticalSection(&connection_pool_cs);
+        HTTP_ExpirePooledConnections(&expired);
+        LIST_FOR_EACH_ENTRY(conn, &connection_pool, HTTPPOOLEDCONNECTION, entry)
+        {
+            if (conn->nServerPort == lpwhs->nServerPort && conn->secure == secure &&
+                !strcmpiW(conn->lpszServerName, lpwhs->lpszServerName))
+            {
+                list_remove(&conn->entry);
+                connection_pool_size--;
+                found = conn;
+                break;
+            }
+        }
+        LeaveCriticalSection(&connection_pool_cs);
+
+        HTTP_FreeExpiredConnections(&expired);
+
+        if (!found)
+            return FALSE;
+
+        if (NETCON_is_alive(&found->netConnection))
+            break;
+
+        TRACE("pooled connection to %s:%u was closed by the server\n",
+              debugstr_w(found->lpszServerName), found->nServerPort);
+        HTTP_FreePooledConnection(found);
+    }
+
+    TRACE("reusing connection to %s:%u\n", debugstr_w(found->lpszServerName), found->nServerPort);
+
+    lpwhr->netConnection = found->netConnection;
+    HeapFree(GetProcessHeap(), 0, found->lpszServerName);
+    HeapFree(GetProcessHeap(), 0, found);
+    return TRUE;
+}
+
+/***********************************************************************
+ *           HTTP_FreeConnectionPool (internal)
+ *
+ * Close all idle connections, called on process detach.
+ */
+void HTTP_FreeConnectionPool(void)
+{
+    HTTPPOOLEDCONNECTION *conn, *next;
+
+    EnterCriticalSection(&connection_pool_cs);
+    LIST_FOR_EACH_ENTRY_SAFE(conn, next, &connection_pool, HTTPPOOLEDCONNECTION, entry)
+    {
+        list_remove(&conn->entry);
+        HTTP_FreePooledConnection(conn);
+    }
+    connection_pool_size = 0;
+    LeaveCriticalSection(&connection_pool_cs);
+}
+
 /***********************************************************************
  *           HTTPREQ_Destroy (internal)
  *
  * Deallocate request handle
  *
  */
+static void HTTP_CloseCacheFile(LPWININETHTTPREQW lpwhr)
+{
+    /* a file still open for writing never made it into the cache */
+    if (lpwhr->hCacheFile)
+    {
+        CloseHandle(lpwhr->hCacheFile);
+        DeleteFileW(lpwhr->lpszCacheFile);
+        lpwhr->hCacheFile = NULL;
+    }
+    if (lpwhr->hCacheData)
+    {
+        CloseHandle(lpwhr->hCacheData);
+        lpwhr->hCacheData = NULL;
+    }
+    HeapFree(GetProcessHeap(), 0, lpwhr->lpszCacheFile);
+    lpwhr->lpszCacheFile = NULL;
+}
+
 static void HTTPREQ_Destroy(WININETHANDLEHEADER *hdr)
 {
     LPWININETHTTPREQW lpwhr = (LPWININETHTTPREQW) hdr;
@@ -1367,13 +1612,8 @@ static void HTTPREQ_Destroy(WININETHANDLEHEADER *hdr)
 
     TRACE("\n");
 
-    if(lpwhr->hCacheFile)
-        CloseHandle(lpwhr->hCacheFile);
-
-    if(lpwhr->lpszCacheFile) {
-        DeleteFileW(lpwhr->lpszCacheFile); /* FIXME */
-        HeapFree(GetProcessHeap(), 0, lpwhr->lpszCacheFile);
-    }
+    HTTP_CloseCacheFile(lpwhr);
+    HTTP_FreeGzipStream(lpwhr);
 
     WININET_Release(&lpwhr->lpHttpSession->hdr);
 
@@ -1403,6 +1643,9 @@ static void HTTPREQ_CloseConnection(WININETHANDLEHEADER *hdr)
     if (!NETCON_connected(&lpwhr->netConnection))
         return;
 
+    if (HTTP_PoolConnection(lpwhr))
+        return;
+
     if (lpwhr->pAuthInfo)
     {
         if (SecIsValidHandle(&lpwhr->pAuthInfo->ctx))
@@ -1456,16 +1699,13 @@ static DWORD HTTPREQ_QueryOption(WININETHANDLEHEADER *hdr, DWORD option, void *b
 
     case INTERNET_OPTION_URL: {
         WCHAR url[INTERNET_MAX_URL_LENGTH];
-        HTTPHEADERW *host;
         DWORD len;
 
-        static const WCHAR formatW[] = {'h','t','t','p',':','/','/','%','s','%','s',0};
-        static const WCHAR hostW[] = {'H','o','s','t',0};
-
         TRACE("INTERNET_OPTION_URL\n");
 
-        host = HTTP_GetHeader(req, hostW);
-        sprintfW(url, formatW, host->lpszValue, req->lpszPath);
+        /* same URL as the cache entries of the request are stored under */
+        if (!HTTP_GetRequestURL(req, url))
+            return ERROR_INTERNET_ITEM_NOT_FOUND;
         TRACE("INTERNET_OPTION_URL: %s\n",debugstr_w(url));
 
         if(unicode) {
@@ -1596,6 +1836,15 @@ static DWORD HTTPREQ_SetOption(WININETHANDLEHEADER *hdr, DWORD option, void *buf
 
         return NETCON_set_timeout(&req->netConnection, option == INTERNET_OPTION_SEND_TIMEOUT,
                     *(DWORD*)buffer);
+
+    case INTERNET_OPTION_HTTP_DECODING:
+        TRACE("INTERNET_OPTION_HTTP_DECODING\n");
+
+        if (size != sizeof(BOOL))
+            return ERROR_INVALID_PARAMETER;
+
+        req->decoding = *(BOOL*)buffer;
+        return ERROR_SUCCESS;
     }
 
     return ERROR_INTERNET_INVALID_OPTION;
@@ -1619,7 +1868,7 @@ static DWORD HTTP_Read(WININETHTTPREQW *req, void *buffer, DWORD size, DWORD *re
     req->dwContentRead += bytes_read;
     *read = bytes_read;
 
-    if(req->lpszCacheFile) {
+    if(req->hCacheFile) {
         BOOL res;
         DWORD dwBytesWritten;
 
@@ -1628,7 +1877,7 @@ static DWORD HTTP_Read(WININETHTTPREQW *req, void *buffer, DWORD size, DWORD *re
             WARN("WriteFile failed: %u\n", GetLastError());
     }
 
-    if(!bytes_read && (req->dwContentRead == req->dwContentLength))
+    if(req->dwContentRead == req->dwContentLength)
         HTTP_FinishedReading(req);
 
     return ERROR_SUCCESS;
@@ -1689,7 +1938,7 @@ static DWORD HTTP_ReadChunked(WININETHTTPREQW *req, void *buffer, DWORD size, DW
         to_write -= bytes_read;
         *read += bytes_read;
 
-        if (req->lpszCacheFile)
+        if (req->hCacheFile)
         {
             DWORD dwBytesWritten;
 
@@ -1716,21 +1965,282 @@ static DWORD HTTP_ReadChunked(WININETHTTPREQW *req, void *buffer, DWORD size, DW
     return ERROR_SUCCESS;
 }
 
-static DWORD HTTPREQ_Read(WININETHTTPREQW *req, void *buffer, DWORD size, DWORD *read, BOOL sync)
+static DWORD HTTP_ReadCached(WININETHTTPREQW *req, void *buffer, DWORD size, DWORD *read)
+{
+    if (!ReadFile(req->hCacheData, buffer, size, read, NULL))
+        return GetLastError();
+
+    req->dwContentRead += *read;
+    return ERROR_SUCCESS;
+}
+
+static BOOL HTTP_IsChunked(WININETHTTPREQW *req)
 {
     WCHAR encoding[20];
     DWORD buflen = sizeof(encoding);
     static const WCHAR szChunked[] = {'c','h','u','n','k','e','d',0};
 
-    if (HTTP_HttpQueryInfoW(req, HTTP_QUERY_TRANSFER_ENCODING, encoding, &buflen, NULL) &&
-        !strcmpiW(encoding, szChunked))
-    {
+    return HTTP_HttpQueryInfoW(req, HTTP_QUERY_TRANSFER_ENCODING, encoding, &buflen, NULL) &&
+           !strcmpiW(encoding, szChunked);
+}
+
+static DWORD HTTP_ReadRaw(WININETHTTPREQW *req, void *buffer, DWORD size, DWORD *read, BOOL sync)
+{
+    if (req->hCacheData)
+        return HTTP_ReadCached(req, buffer, size, read);
+
+    if (HTTP_IsChunked(req))
         return HTTP_ReadChunked(req, buffer, size, read, sync);
-    }
     else
         return HTTP_Read(req, buffer, size, read, sync);
 }
 
+#ifdef HAVE_ZLIB
+
+#define GZIP_BUFFER_SIZE 8192
+
+struct gzip_stream_t
+{
+    z_stream zstream;
+    BYTE buf[GZIP_BUFFER_SIZE];
+    BYTE out[GZIP_BUFFER_SIZE]; /* decoded by InternetQueryDataAvailable, not read yet */
+    DWORD out_pos;
+    DWORD out_len;
+    BOOL end_of_data;
+    BOOL try_raw; /* "deflate" content may come without the zlib header */
+};
+
+static voidpf wininet_zalloc(voidpf opaque, uInt items, uInt size)
+{
+    return HeapAlloc(GetProcessHeap(), 0, items*size);
+}
+
+static void wininet_zfree(voidpf opaque, voidpf address)
+{
+    HeapFree(GetProcessHeap(), 0, address);
+}
+
+/***********************************************************************
+ *           HTTP_InitGzipStream (internal)
+ *
+ * Set up decoding of the response content if the application asked for
+ * it and the server sent the content compressed.
+ */
+static void HTTP_InitGzipStream(WININETHTTPREQW *req)
+{
+    static const WCHAR szGzip[] = {'g','z','i','p',0};
+    static const WCHAR szXGzip[] = {'x','-','g','z','i','p',0};
+    static const WCHAR szDeflate[] = {'d','e','f','l','a','t','e',0};
+    struct gzip_stream_t *gzip;
+    WCHAR encoding[20];
+    DWORD size = sizeof(encoding);
+    int zres;
+
+    if (!req->decoding ||
+        !HTTP_HttpQueryInfoW(req, HTTP_QUERY_CONTENT_ENCODING, encoding, &size, NULL) ||
+        (strcmpiW(encoding, szGzip) && strcmpiW(encoding, szXGzip) && strcmpiW(encoding, szDeflate)))
+        return;
+
+    gzip = HeapAlloc(GetProcessHeap(), 0, sizeof(*gzip));
+    if (!gzip)
+        return;
+
+    gzip->zstream.zalloc = wininet_zalloc;
+    gzip->zstream.zfree = wininet_zfree;
+    gzip->zstream.opaque = NULL;
+    gzip->zstream.next_in = NULL;
+    gzip->zstream.avail_in = 0;
+    gzip->out_pos = gzip->out_len = 0;
+    gzip->end_of_data = FALSE;
+    gzip->try_raw = !strcmpiW(encoding, szDeflate);
+
+    /* maximum window size, +32 to detect gzip and zlib headers automatically */
+    zres = inflateInit2(&gzip->zstream, 15 + 32);
+    if (zres != Z_OK)
+    {
+        ERR("inflateInit2 failed: %d\n", zres);
+        HeapFree(GetProcessHeap(), 0, gzip);
+        return;
+    }
+
+    TRACE("decoding %s content\n", debugstr_w(encoding));
+    req->gzip_stream = gzip;
+}
+
+static void HTTP_FreeGzipStream(WININETHTTPREQW *req)
+{
+    if (!req->gzip_stream)
+        return;
+
+    inflateEnd(&req->gzip_stream->zstream);
+    HeapFree(GetProcessHeap(), 0, req->gzip_stream);
+    req->gzip_stream = NULL;
+}
+
+/***********************************************************************
+ *           HTTP_RetryRawDeflate (internal)
+ *
+ * Many servers send "Content-Encoding: deflate" content as a raw deflate
+ * stream instead of the zlib format the RFC asks for. If the header check
+ * failed on the first buffer, start over on it without expecting a header.
+ */
+static BOOL HTTP_RetryRawDeflate(struct gzip_stream_t *gzip)
+{
+    z_stream *zstream = &gzip->zstream;
+    DWORD len = zstream->next_in - gzip->buf + zstream->avail_in;
+
+    if (!gzip->try_raw || zstream->total_out || zstream->total_in != zstream->next_in - gzip->buf)
+        return FALSE;
+    gzip->try_raw = FALSE;
+
+    inflateEnd(zstream);
+    if (inflateInit2(zstream, -15) != Z_OK)
+        return FALSE;
+
+    TRACE("retrying as raw deflate data\n");
+    zstream->next_in = gzip->buf;
+    zstream->avail_in = len;
+    return TRUE;
+}
+
+/***********************************************************************
+ *           HTTP_EndGzipContent (internal)
+ *
+ * The compressed stream has ended. Read what the content length says is
+ * left so that the connection can be used again. If the end of the
+ * response is not known, waiting for it could block an idle keep-alive
+ * connection for good, so close the connection instead.
+ */
+static void HTTP_EndGzipContent(WININETHTTPREQW *req, BOOL sync)
+{
+    struct gzip_stream_t *gzip = req->gzip_stream;
+    DWORD res, bytes_read;
+
+    if (req->hCacheData)
+        return;
+
+    if (req->dwContentLength == -1 || HTTP_IsChunked(req))
+    {
+        HTTPREQ_CloseConnection(&req->hdr);
+        return;
+    }
+
+    while (req->dwContentRead < req->dwContentLength)
+    {
+        res = HTTP_Read(req, gzip->buf, min(sizeof(gzip->buf), req->dwContentLength - req->dwContentRead),
+                        &bytes_read, sync);
+        if (res != ERROR_SUCCESS || !bytes_read)
+            break;
+    }
+}
+
+static DWORD HTTP_ReadGzip(WININETHTTPREQW *req, BYTE *buffer, DWORD size, DWORD *read, BOOL sync)
+{
+    struct gzip_stream_t *gzip = req->gzip_stream;
+    z_stream *zstream = &gzip->zstream;
+    DWORD res, bytes_read;
+    int zres;
+
+    /* hand out what InternetQueryDataAvailable has decoded first */
+    *read = min(size, gzip->out_len - gzip->out_pos);
+    memcpy(buffer, gzip->out + gzip->out_pos, *read);
+    gzip->out_pos += *read;
+
+    while (*read < size && !gzip->end_of_data)
+    {
+        if (!zstream->avail_in)
+        {
+            /* don't wait for more data once there is something to return */
+            if (*read)
+                break;
+
+            res = HTTP_ReadRaw(req, gzip->buf, sizeof(gzip->buf), &bytes_read, sync);
+            if (res != ERROR_SUCCESS)
+                return res;
+            if (!bytes_read)
+            {
+                gzip->end_of_data = TRUE;
+                break;
+            }
+            zstream->next_in = gzip->buf;
+            zstream->avail_in = bytes_read;
+        }
+
+        zstream->next_out = buffer + *read;
+        zstream->avail_out = size - *read;
+        zres = inflate(zstream, Z_SYNC_FLUSH);
+        *read = size - zstream->avail_out;
+
+        if (zres == Z_DATA_ERROR && HTTP_RetryRawDeflate(gzip))
+            continue;
+
+        if (zres == Z_STREAM_END)
+        {
+            gzip->end_of_data = TRUE;
+            HTTP_EndGzipContent(req, sync);
+        }
+        else if (zres != Z_OK && zres != Z_BUF_ERROR)
+        {
+            WARN("inflate failed: %d\n", zres);
+            return ERROR_INTERNET_DECODING_FAILED;
+        }
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/***********************************************************************
+ *           HTTP_GzipDataAvailable (internal)
+ *
+ * Applications size their reads by InternetQueryDataAvailable, so report
+ * the decoded size. Decode what has arrived into the output buffer; only
+ * wait for more data in blocking mode. Returns FALSE if nothing could be
+ * decoded without waiting.
+ */
+static BOOL HTTP_GzipDataAvailable(WININETHTTPREQW *req, BOOL async, DWORD *available, DWORD *res)
+{
+    struct gzip_stream_t *gzip = req->gzip_stream;
+    DWORD raw = 0;
+
+    *res = ERROR_SUCCESS;
+    if (gzip->out_pos == gzip->out_len && !gzip->end_of_data)
+    {
+        if (async && !req->hCacheData && !gzip->zstream.avail_in &&
+            (!NETCON_query_data_available(&req->netConnection, &raw) || !raw))
+            return FALSE;
+
+        gzip->out_pos = gzip->out_len = 0;
+        *res = HTTP_ReadGzip(req, gzip->out, sizeof(gzip->out), &raw, !async);
+        gzip->out_len = raw;
+    }
+
+    *available = gzip->out_len - gzip->out_pos;
+    return TRUE;
+}
+
+#else
+
+static void HTTP_InitGzipStream(WININETHTTPREQW *req)
+{
+    if (req->decoding)
+        FIXME("compiled without zlib support, content is not decoded\n");
+}
+
+static void HTTP_FreeGzipStream(WININETHTTPREQW *req)
+{
+}
+
+#endif
+
+static DWORD HTTPREQ_Read(WININETHTTPREQW *req, void *buffer, DWORD size, DWORD *read, BOOL sync)
+{
+#ifdef HAVE_ZLIB
+    if (req->gzip_stream)
+        return HTTP_ReadGzip(req, buffer, size, read, sync);
+#endif
+    return HTTP_ReadRaw(req, buffer, size, read, sync);
+}
+
 static DWORD HTTPREQ_ReadFile(WININETHANDLEHEADER *hdr, void *buffer, DWORD size, DWORD *read)
 {
     WININETHTTPREQW *req = (WININETHTTPREQW*)hdr;
@@ -1772,7 +2282,7 @@ static DWORD HTTPREQ_ReadFileExA(WININETHANDLEHEADER *hdr, INTERNET_BUFFERSA *bu
 
     INTERNET_SendCallback(&req->hdr, req->hdr.dwContext, INTERNET_STATUS_RECEIVING_RESPONSE, NULL, 0);
 
-    if (hdr->dwFlags & INTERNET_FLAG_ASYNC) {
+    if ((hdr->dwFlags & INTERNET_FLAG_ASYNC) && !req->hCacheData) {
         DWORD available = 0;
 
         NETCON_query_data_available(&req->netConnection, &available);
@@ -1833,14 +2343,30 @@ static DWORD HTTPREQ_QueryDataAvailable(WININETHANDLEHEADER *hdr, DWORD *availab
 
     TRACE("(%p %p %x %lx)\n", req, available, flags, ctx);
 
+    async = (req->lpHttpSession->lpAppInfo->hdr.dwFlags & INTERNET_FLAG_ASYNC) != 0;
+
+#ifdef HAVE_ZLIB
+    if (req->gzip_stream)
+    {
+        DWORD res;
+
+        if (HTTP_GzipDataAvailable(req, async, available, &res))
+            return res;
+    }
+#endif
+
+    if (req->hCacheData)
+    {
+        *available = req->dwContentLength - req->dwContentRead;
+        return ERROR_SUCCESS;
+    }
+
     if(!NETCON_query_data_available(&req->netConnection, available) || *available)
         return ERROR_SUCCESS;
 
     /* Even if we are in async mode, we need to determine whether
      * there is actually more data available. We do this by trying
      * to peek only a single byte in async mode. */
-    async = (req->lpHttpSession->lpAppInfo->hdr.dwFlags & INTERNET_FLAG_ASYNC) != 0;
-
     if (NETCON_recv(&req->netConnection, buffer,
                     min(async ? 1 : sizeof(buffer), req->dwContentLength - req->dwContentRead),
                     MSG_PEEK, (int *)available) && async && *available)
@@ -2032,6 +2558,9 @@ static void HTTP_DrainContent(WININETHTTPREQW *req)
 {
     DWORD bytes_read;
 
+    /* a 304 answered from the cache left nothing on the connection */
+    if (req->hCacheData) return;
+
     if (!NETCON_connected(&req->netConnection)) return;
 
     if (req->dwContentLength == -1)
@@ -2343,7 +2872,7 @@ static BOOL WINAPI HTTP_HttpQueryInfoW( LPWININETHTTPREQW lpwhr, DWORD dwInfoLev
 	STHook->wDayOfWeek = tmpTM.tm_wday;
 	STHook->wMonth = tmpTM.tm_mon + 1;
 	STHook->wSecond = tmpTM.tm_sec;
-	STHook->wYear = tmpTM.tm_year;
+	STHook->wYear = tmpTM.tm_year + 1900;
 	
 	bSuccess = TRUE;
 	
@@ -2846,17 +3375,365 @@ BOOL WINAPI HttpSendRequestA(HINTERNET hHttpRequest, LPCSTR lpszHeaders,
 static BOOL HTTP_GetRequestURL(WININETHTTPREQW *req, LPWSTR buf)
 {
     LPHTTPHEADERW host_header;
+    INTERNET_PORT port = req->lpHttpSession->nHostPort;
+    BOOL secure = (req->hdr.dwFlags & INTERNET_FLAG_SECURE) != 0;
 
-    static const WCHAR formatW[] = {'h','t','t','p',':','/','/','%','s','%','s',0};
+    static const WCHAR formatW[] = {'%','s',':','/','/','%','s','%','s',0};
+    static const WCHAR formatPortW[] = {'%','s',':','/','/','%','s',':','%','u','%','s',0};
+    static const WCHAR httpW[] = {'h','t','t','p',0};
+    static const WCHAR httpsW[] = {'h','t','t','p','s',0};
 
     host_header = HTTP_GetHeader(req, szHost);
     if(!host_header)
         return FALSE;
 
-    sprintfW(buf, formatW, host_header->lpszValue, req->lpszPath); /* FIXME */
+    /* FIXME */
+    if(port == INTERNET_INVALID_PORT_NUMBER ||
+       port == (secure ? INTERNET_DEFAULT_HTTPS_PORT : INTERNET_DEFAULT_HTTP_PORT) ||
+       strchrW(host_header->lpszValue, ':')) /* redirects put the port in the Host header */
+        sprintfW(buf, formatW, secure ? httpsW : httpW, host_header->lpszValue, req->lpszPath);
+    else
+        sprintfW(buf, formatPortW, secure ? httpsW : httpW, host_header->lpszValue, port, req->lpszPath);
     return TRUE;
 }
 
+/* response stored in the URL cache that a conditional request refers to */
+typedef struct
+{
+    LPWSTR lpszHeaders; /* headers of the entry, set while the validators are in place */
+    LPWSTR lpszFile;
+    HANDLE hFile;
+} HTTPCACHEDRESPONSE;
+
+static INTERNET_CACHE_ENTRY_INFOW *HTTP_GetCacheEntryInfo(LPCWSTR url)
+{
+    INTERNET_CACHE_ENTRY_INFOW *info;
+    DWORD size = 0;
+
+    if (GetUrlCacheEntryInfoW(url, NULL, &size) || GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+        return NULL;
+
+    info = HeapAlloc(GetProcessHeap(), 0, size);
+    if (info && !GetUrlCacheEntryInfoW(url, info, &size))
+    {
+        HeapFree(GetProcessHeap(), 0, info);
+        info = NULL;
+    }
+    return info;
+}
+
+static void HTTP_DeleteCacheEntry(LPCWSTR url)
+{
+    INTERNET_CACHE_ENTRY_INFOW *info = HTTP_GetCacheEntryInfo(url);
+
+    if (!info)
+        return;
+    if (DeleteUrlCacheEntryW(url) && info->lpszLocalFileName)
+        DeleteFileW(info->lpszLocalFileName);
+    HeapFree(GetProcessHeap(), 0, info);
+}
+
+/* returns the value of a header from a block of cached response headers */
+static LPWSTR HTTP_GetCachedHeader(LPCWSTR headers, LPCWSTR field)
+{
+    static const WCHAR szCrLf[] = {'\r','\n',0};
+    int len = strlenW(field);
+    LPCWSTR line, value, end;
+    LPWSTR ret;
+
+    /* the first line is the status line */
+    for (line = strstrW(headers, szCrLf); line; line = strstrW(line, szCrLf))
+    {
+        line += 2;
+        if (strncmpiW(line, field, len) || line[len] != ':')
+            continue;
+
+        for (value = line + len + 1; *value == ' ' || *value == '\t'; value++)
+            ;
+        end = strstrW(value, szCrLf);
+        if (!end)
+            end = value + strlenW(value);
+
+        ret = HeapAlloc(GetProcessHeap(), 0, (end - value + 1) * sizeof(WCHAR));
+        if (ret)
+        {
+            memcpy(ret, value, (end - value) * sizeof(WCHAR));
+            ret[end - value] = 0;
+        }
+        return ret;
+    }
+    return NULL;
+}
+
+/***********************************************************************
+ *           HTTP_ShouldCacheResponse (internal)
+ *
+ * Whether the response may be written to the URL cache.
+ */
+static BOOL HTTP_ShouldCacheResponse(LPWININETHTTPREQW lpwhr)
+{
+    static const WCHAR szNoStore[] = {'n','o','-','s','t','o','r','e',0};
+    WCHAR value[256];
+    DWORD size, status;
+
+    if (lpwhr->hdr.dwFlags & INTERNET_FLAG_NO_CACHE_WRITE)
+        return FALSE;
+    /* secure content only goes to disk when the application asks for a file */
+    if ((lpwhr->hdr.dwFlags & INTERNET_FLAG_SECURE) && !(lpwhr->hdr.dwFlags & INTERNET_FLAG_NEED_FILE))
+        return FALSE;
+    if (strcmpW(lpwhr->lpszVerb, szGET))
+        return FALSE;
+
+    size = sizeof(status);
+    if (!HTTP_HttpQueryInfoW(lpwhr, HTTP_QUERY_FLAG_NUMBER|HTTP_QUERY_STATUS_CODE, &status, &size, NULL) ||
+        status != HTTP_STATUS_OK)
+        return FALSE;
+
+    size = sizeof(value);
+    if (HTTP_HttpQueryInfoW(lpwhr, HTTP_QUERY_CACHE_CONTROL, value, &size, NULL))
+    {
+        strlwrW(value);
+        if (strstrW(value, szNoStore))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/***********************************************************************
+ *           HTTP_CommitCacheEntry (internal)
+ *
+ * Hand a fully read response over to the URL cache.
+ */
+static void HTTP_CommitCacheEntry(LPWININETHTTPREQW lpwhr)
+{
+    WCHAR url[INTERNET_MAX_URL_LENGTH];
+    FILETIME expires, modified;
+    SYSTEMTIME st;
+    DWORD size;
+
+    CloseHandle(lpwhr->hCacheFile);
+    lpwhr->hCacheFile = NULL;
+
+    memset(&expires, 0, sizeof(expires));
+    size = sizeof(st);
+    if (HTTP_HttpQueryInfoW(lpwhr, HTTP_QUERY_EXPIRES|HTTP_QUERY_FLAG_SYSTEMTIME, &st, &size, NULL))
+        SystemTimeToFileTime(&st, &expires);
+
+    memset(&modified, 0, sizeof(modified));
+    size = sizeof(st);
+    if (HTTP_HttpQueryInfoW(lpwhr, HTTP_QUERY_LAST_MODIFIED|HTTP_QUERY_FLAG_SYSTEMTIME, &st, &size, NULL))
+        SystemTimeToFileTime(&st, &modified);
+
+    if (HTTP_GetRequestURL(lpwhr, url))
+    {
+        /* CommitUrlCacheEntryW doesn't update an existing entry */
+        HTTP_DeleteCacheEntry(url);
+
+        if (CommitUrlCacheEntryW(url, lpwhr->lpszCacheFile, expires, modified, NORMAL_CACHE_ENTRY,
+                                 lpwhr->lpszRawHeaders, strlenW(lpwhr->lpszRawHeaders), NULL, NULL))
+        {
+            TRACE("cached %s in %s\n", debugstr_w(url), debugstr_w(lpwhr->lpszCacheFile));
+            return;
+        }
+    }
+
+    WARN("Could not commit cache entry: %u\n", GetLastError());
+    DeleteFileW(lpwhr->lpszCacheFile);
+    HeapFree(GetProcessHeap(), 0, lpwhr->lpszCacheFile);
+    lpwhr->lpszCacheFile = NULL;
+}
+
+/***********************************************************************
+ *           HTTP_CanUseCachedEncoding (internal)
+ *
+ * The cache file holds the body as the server sent it. A compressed body
+ * may only be replayed to a request that advertised that encoding, either
+ * through INTERNET_OPTION_HTTP_DECODING or its own Accept-Encoding header.
+ */
+static BOOL HTTP_CanUseCachedEncoding(LPWININETHTTPREQW lpwhr, LPCWSTR headers)
+{
+    static const WCHAR szIdentity[] = {'i','d','e','n','t','i','t','y',0};
+    LPHTTPHEADERW accept;
+    LPWSTR encoding, accepted;
+    BOOL ret;
+
+    encoding = HTTP_GetCachedHeader(headers, szContent_Encoding);
+    if (!encoding)
+        return TRUE;
+
+    if (!*encoding || !strcmpiW(encoding, szIdentity))
+        ret = TRUE;
+    else if ((accept = HTTP_GetHeader(lpwhr, szAccept_Encoding)) &&
+             (accepted = WININET_strdupW(accept->lpszValue)))
+    {
+        strlwrW(encoding);
+        strlwrW(accepted);
+        ret = strstrW(accepted, encoding) != NULL;
+        HeapFree(GetProcessHeap(), 0, accepted);
+    }
+    else
+        ret = FALSE;
+
+    if (!ret)
+        TRACE("cached content is %s encoded, not accepted by the request\n", debugstr_w(encoding));
+    HeapFree(GetProcessHeap(), 0, encoding);
+    return ret;
+}
+
+/***********************************************************************
+ *           HTTP_AddCacheValidators (internal)
+ *
+ * Make a GET request conditional on what we have in the URL cache, so
+ * the server can answer with 304 instead of sending the content again.
+ */
+static void HTTP_AddCacheValidators(LPWININETHTTPREQW lpwhr, HTTPCACHEDRESPONSE *cached)
+{
+    WCHAR url[INTERNET_MAX_URL_LENGTH];
+    INTERNET_CACHE_ENTRY_INFOW *info;
+    LPWSTR headers = NULL, etag = NULL, modified = NULL;
+    HANDLE file = INVALID_HANDLE_VALUE;
+    int len;
+
+    if (lpwhr->hdr.dwFlags & (INTERNET_FLAG_RELOAD|INTERNET_FLAG_PRAGMA_NOCACHE|INTERNET_FLAG_NO_CACHE_WRITE))
+        return;
+    if (strcmpW(lpwhr->lpszVerb, szGET))
+        return;
+    /* leave requests that the application made conditional alone */
+    if (HTTP_GetHeader(lpwhr, szIf_None_Match) || HTTP_GetHeader(lpwhr, szIf_Modified_Since) ||
+        HTTP_GetHeader(lpwhr, szRange))
+        return;
+
+    if (!HTTP_GetRequestURL(lpwhr, url) || !(info = HTTP_GetCacheEntryInfo(url)))
+        return;
+
+    /* the header info is returned in the ANSI form it is stored in */
+    if (info->lpszLocalFileName && info->lpHeaderInfo)
+    {
+        len = MultiByteToWideChar(CP_ACP, 0, (LPCSTR)info->lpHeaderInfo, -1, NULL, 0);
+        headers = HeapAlloc(GetProcessHeap(), 0, len * sizeof(WCHAR));
+        if (headers)
+        {
+            MultiByteToWideChar(CP_ACP, 0, (LPCSTR)info->lpHeaderInfo, -1, headers, len);
+            if (!HTTP_CanUseCachedEncoding(lpwhr, headers))
+            {
+                HeapFree(GetProcessHeap(), 0, headers);
+                HeapFree(GetProcessHeap(), 0, info);
+                return;
+            }
+            etag = HTTP_GetCachedHeader(headers, szETag);
+            modified = HTTP_GetCachedHeader(headers, szLast_Modified);
+        }
+    }
+
+    if (etag || modified)
+        file = CreateFileW(info->lpszLocalFileName, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE,
+                           NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        TRACE("revalidating cached %s\n", debugstr_w(url));
+
+        if (etag)
+            HTTP_ProcessHeader(lpwhr, szIf_None_Match, etag, HTTP_ADDREQ_FLAG_ADD_IF_NEW | HTTP_ADDHDR_FLAG_REQ);
+        if (modified)
+            HTTP_ProcessHeader(lpwhr, szIf_Modified_Since, modified, HTTP_ADDREQ_FLAG_ADD_IF_NEW | HTTP_ADDHDR_FLAG_REQ);
+
+        cached->lpszHeaders = headers;
+        cached->lpszFile = WININET_strdupW(info->lpszLocalFileName);
+        cached->hFile = file;
+    }
+    else
+        HeapFree(GetProcessHeap(), 0, headers);
+
+    HeapFree(GetProcessHeap(), 0, etag);
+    HeapFree(GetProcessHeap(), 0, modified);
+    HeapFree(GetProcessHeap(), 0, info);
+}
+
+static void HTTP_RemoveCacheValidators(LPWININETHTTPREQW lpwhr, HTTPCACHEDRESPONSE *cached)
+{
+    if (!cached->lpszHeaders)
+        return;
+
+    HTTP_ProcessHeader(lpwhr, szIf_None_Match, NULL, HTTP_ADDHDR_FLAG_REQ | HTTP_ADDHDR_FLAG_REPLACE);
+    HTTP_ProcessHeader(lpwhr, szIf_Modified_Since, NULL, HTTP_ADDHDR_FLAG_REQ | HTTP_ADDHDR_FLAG_REPLACE);
+
+    if (cached->hFile)
+        CloseHandle(cached->hFile);
+    HeapFree(GetProcessHeap(), 0, cached->lpszFile);
+    HeapFree(GetProcessHeap(), 0, cached->lpszHeaders);
+    memset(cached, 0, sizeof(*cached));
+}
+
+/***********************************************************************
+ *           HTTP_UseCachedResponse (internal)
+ *
+ * The server answered our conditional request with 304, so present the
+ * response from the URL cache to the application instead.
+ */
+static void HTTP_UseCachedResponse(LPWININETHTTPREQW lpwhr, HTTPCACHEDRESPONSE *cached)
+{
+    static const WCHAR szCrLf[] = {'\r','\n',0};
+    LPWSTR buffer, line, next, status_code, status_text;
+
+    /* a 304 has no body, so the connection is done with */
+    if (lpwhr->dwContentLength != 0)
+    {
+        lpwhr->dwContentLength = 0;
+        HTTP_FinishedReading(lpwhr);
+    }
+
+    buffer = WININET_strdupW(cached->lpszHeaders);
+    if (!buffer)
+        return;
+
+    HTTP_clear_response_headers(lpwhr);
+    for (line = buffer; *line; line = next)
+    {
+        next = strstrW(line, szCrLf);
+        if (next)
+        {
+            *next = 0;
+            next += 2;
+        }
+        else
+            next = line + strlenW(line);
+
+        if (line == buffer)
+        {
+            if ((status_code = strchrW(line, ' ')) && (status_text = strchrW(status_code + 1, ' ')))
+            {
+                *status_code++ = 0;
+                *status_text++ = 0;
+                HTTP_SetStatus(lpwhr, line, status_code, status_text);
+            }
+        }
+        else if (*line)
+        {
+            LPWSTR *pFieldAndValue = HTTP_InterpretHttpHeader(line);
+
+            if (pFieldAndValue)
+            {
+                HTTP_ProcessHeader(lpwhr, pFieldAndValue[0], pFieldAndValue[1], HTTP_ADDREQ_FLAG_ADD);
+                HTTP_FreeTokens(pFieldAndValue);
+            }
+        }
+    }
+    HeapFree(GetProcessHeap(), 0, buffer);
+
+    HeapFree(GetProcessHeap(), 0, lpwhr->lpszRawHeaders);
+    lpwhr->lpszRawHeaders = WININET_strdupW(cached->lpszHeaders);
+
+    HTTP_CloseCacheFile(lpwhr);
+    lpwhr->hCacheData = cached->hFile;
+    lpwhr->lpszCacheFile = cached->lpszFile;
+    lpwhr->dwContentLength = GetFileSize(cached->hFile, NULL);
+    lpwhr->dwContentRead = 0;
+
+    cached->hFile = NULL;
+    cached->lpszFile = NULL;
+}
+
 /***********************************************************************
  *           HTTP_HandleRedirect (internal)
  */
@@ -3019,6 +3896,11 @@ static BOOL HTTP_HandleRedirect(LPWININETHTTPREQW lpwhr, LPCWSTR lpszUrl)
 
         if (!using_proxy)
         {
+            /* the pool is keyed by the server, so hand the connection
+             * over before switching to the new one */
+            if (!HTTP_PoolConnection(lpwhr))
+                NETCON_close(&lpwhr->netConnection);
+
             HeapFree(GetProcessHeap(), 0, lpwhs->lpszServerName);
             lpwhs->lpszServerName = WININET_strdupW(hostName);
             lpwhs->nServerPort = urlComponents.nPort;
@@ -3026,8 +3908,6 @@ static BOOL HTTP_HandleRedirect(LPWININETHTTPREQW lpwhr, LPCWSTR lpszUrl)
             if (!HTTP_ResolveName(lpwhr))
                 return FALSE;
 
-            NETCON_close(&lpwhr->netConnection);
-
             if (!NETCON_init(&lpwhr->netConnection,lpwhr->hdr.dwFlags & INTERNET_FLAG_SECURE))
                 return FALSE;
         }
@@ -3149,7 +4029,8 @@ BOOL WINAPI HTTP_HttpSendRequestW(LPWININETHTTPREQW lpwhr, LPCWSTR lpszHeaders,
     BOOL bSuccess = FALSE;
     LPWSTR requestString = NULL;
     INT responseLen;
-    BOOL loop_next;
+    BOOL loop_next, reused;
+    HTTPCACHEDRESPONSE cached;
     INTERNET_ASYNC_RESULT iar;
     static const WCHAR szPost[] = { 'P','O','S','T',0 };
     static const WCHAR szContentLength[] =
@@ -3188,6 +4069,16 @@ BOOL WINAPI HTTP_HttpSendRequestW(LPWININETHTTPREQW lpwhr, LPCWSTR lpszHeaders,
         HTTP_HttpAddRequestHeadersW(lpwhr, pragma_nocache, strlenW(pragma_nocache), HTTP_ADDREQ_FLAG_ADD_IF_NEW);
     }
 
+#ifdef HAVE_ZLIB
+    if (lpwhr->decoding)
+    {
+        static const WCHAR accept_encoding[] = {'A','c','c','e','p','t','-','E','n','c','o','d','i','n','g',':',' ',
+                                                'g','z','i','p',',',' ','d','e','f','l','a','t','e','\r','\n',0};
+        HTTP_HttpAddRequestHeadersW(lpwhr, accept_encoding, strlenW(accept_encoding), HTTP_ADDREQ_FLAG_ADD_IF_NEW);
+    }
+#endif
+
+    memset(&cached, 0, sizeof(cached));
     do
     {
         DWORD len;
@@ -3199,6 +4090,10 @@ BOOL WINAPI HTTP_HttpSendRequestW(LPWININETHTTPREQW lpwhr, LPCWSTR lpszHeaders,
          * for all the data */
         HTTP_DrainContent(lpwhr);
         lpwhr->dwContentRead = 0;
+        lpwhr->bReusable = FALSE;
+        HTTP_CloseCacheFile(lpwhr);
+        HTTP_FreeGzipStream(lpwhr);
+        HTTP_RemoveCacheValidators(lpwhr, &cached);
 
         if (TRACE_ON(wininet))
         {
@@ -3221,6 +4116,9 @@ BOOL WINAPI HTTP_HttpSendRequestW(LPWININETHTTPREQW lpwhr, LPCWSTR lpszHeaders,
                         HTTP_ADDREQ_FLAG_ADD | HTTP_ADDHDR_FLAG_REPLACE);
         }
 
+        if (bEndRequest)
+            HTTP_AddCacheValidators(lpwhr, &cached);
+
         if (lpwhr->lpHttpSession->lpAppInfo->lpszProxy && lpwhr->lpHttpSession->lpAppInfo->lpszProxy[0])
         {
             WCHAR *url = HTTP_BuildProxyRequestUrl(lpwhr);
@@ -3234,7 +4132,7 @@ BOOL WINAPI HTTP_HttpSendRequestW(LPWININETHTTPREQW lpwhr, LPCWSTR lpszHeaders,
         TRACE("Request header -> %s\n", debugstr_w(requestString) );
 
         /* Send the request and store the results */
-        if (!HTTP_OpenConnection(lpwhr))
+        if (!HTTP_OpenConnection(lpwhr, &reused))
             goto lend;
 
         /* send the request as ASCII, tack on the optional data */
@@ -3271,10 +4169,21 @@ BOOL WINAPI HTTP_HttpSendRequestW(LPWININETHTTPREQW lpwhr, LPCWSTR lpszHeaders,
             INTERNET_SendCallback(&lpwhr->hdr, lpwhr->hdr.dwContext,
                                 INTERNET_STATUS_RECEIVING_RESPONSE, NULL, 0);
     
+            responseLen = cnt < 0 ? 0 : HTTP_GetResponseHeaders(lpwhr, TRUE);
+            if (!responseLen && reused)
+            {
+                /* the server may close an idle connection at any time, if
+                 * it did so just as we sent the request try a new one */
+                TRACE("kept alive connection was closed, reconnecting\n");
+                NETCON_close(&lpwhr->netConnection);
+                HeapFree(GetProcessHeap(), 0, requestString);
+                requestString = NULL;
+                loop_next = TRUE;
+                continue;
+            }
             if (cnt < 0)
                 goto lend;
-    
-            responseLen = HTTP_GetResponseHeaders(lpwhr, TRUE);
+
             if (responseLen)
                 bSuccess = TRUE;
     
@@ -3306,6 +4215,17 @@ BOOL WINAPI HTTP_HttpSendRequestW(LPWININETHTTPREQW lpwhr, LPCWSTR lpszHeaders,
                                      &dwStatusCode,&dwBufferSize,NULL))
                 dwStatusCode = 0;
 
+            if (dwStatusCode == HTTP_STATUS_NOT_MODIFIED && cached.hFile && bSuccess)
+            {
+                TRACE("not modified, using the cached response\n");
+                HTTP_UseCachedResponse(lpwhr, &cached);
+
+                dwBufferSize = sizeof(dwStatusCode);
+                if (!HTTP_HttpQueryInfoW(lpwhr,HTTP_QUERY_FLAG_NUMBER|HTTP_QUERY_STATUS_CODE,
+                                         &dwStatusCode,&dwBufferSize,NULL))
+                    dwStatusCode = 0;
+            }
+
             if (!(lpwhr->hdr.dwFlags & INTERNET_FLAG_NO_AUTO_REDIRECT) && bSuccess)
             {
                 WCHAR szNewLocation[INTERNET_MAX_URL_LENGTH];
@@ -3366,8 +4286,8 @@ BOOL WINAPI HTTP_HttpSendRequestW(LPWININETHTTPREQW lpwhr, LPCWSTR lpszHeaders,
     }
     while (loop_next);
 
-    /* FIXME: Better check, when we have to create the cache file */
-    if(bSuccess && (lpwhr->hdr.dwFlags & INTERNET_FLAG_NEED_FILE)) {
+    if(bSuccess && !lpwhr->hCacheData &&
+       ((lpwhr->hdr.dwFlags & INTERNET_FLAG_NEED_FILE) || HTTP_ShouldCacheResponse(lpwhr))) {
         WCHAR url[INTERNET_MAX_URL_LENGTH];
         WCHAR cacheFileName[MAX_PATH+1];
         BOOL b;
@@ -3386,14 +4306,20 @@ BOOL WINAPI HTTP_HttpSendRequestW(LPWININETHTTPREQW lpwhr, LPCWSTR lpszHeaders,
             if(lpwhr->hCacheFile == INVALID_HANDLE_VALUE) {
                 WARN("Could not create file: %u\n", GetLastError());
                 lpwhr->hCacheFile = NULL;
+                HeapFree(GetProcessHeap(), 0, lpwhr->lpszCacheFile);
+                lpwhr->lpszCacheFile = NULL;
             }
         }else {
             WARN("Could not create cache entry: %08x\n", GetLastError());
         }
     }
 
+    if(bSuccess && bEndRequest)
+        HTTP_InitGzipStream(lpwhr);
+
 lend:
 
+    HTTP_RemoveCacheValidators(lpwhr, &cached);
     HeapFree(GetProcessHeap(), 0, requestString);
 
     /* TODO: send notification for P3P header */
@@ -3564,14 +4490,15 @@ lerror:
 /***********************************************************************
  *           HTTP_OpenConnection (internal)
  *
- * Connect to a web server
+ * Connect to a web server, *reused is set if the connection was already
+ * established before
  *
  * RETURNS
  *
  *   TRUE  on success
  *   FALSE on failure
  */
-static BOOL HTTP_OpenConnection(LPWININETHTTPREQW lpwhr)
+static BOOL HTTP_OpenConnection(LPWININETHTTPREQW lpwhr, BOOL *reused)
 {
     BOOL bSuccess = FALSE;
     LPWININETHTTPSESSIONW lpwhs;
@@ -3580,6 +4507,7 @@ static BOOL HTTP_OpenConnection(LPWININETHTTPREQW lpwhr)
 
     TRACE("-->\n");
 
+    *reused = FALSE;
 
     if (NULL == lpwhr ||  lpwhr->hdr.htype != WH_HHTTPREQ)
     {
@@ -3587,8 +4515,9 @@ static BOOL HTTP_OpenConnection(LPWININETHTTPREQW lpwhr)
         goto lend;
     }
 
-    if (NETCON_connected(&lpwhr->netConnection))
+    if (NETCON_connected(&lpwhr->netConnection) || HTTP_GetPooledConnection(lpwhr))
     {
+        *reused = TRUE;
         bSuccess = TRUE;
         goto lend;
     }
@@ -3667,6 +4596,23 @@ static void HTTP_clear_response_headers( LPWININETHTTPREQW lpwhr )
     }
 }
 
+/***********************************************************************
+ *           HTTP_SetStatus (internal)
+ *
+ * Store the parts of a response status line.
+ */
+static void HTTP_SetStatus(LPWININETHTTPREQW lpwhr, LPCWSTR version, LPCWSTR status_code, LPCWSTR status_text)
+{
+    HTTP_ProcessHeader(lpwhr, szStatus, status_code,
+            HTTP_ADDHDR_FLAG_REPLACE);
+
+    HeapFree(GetProcessHeap(),0,lpwhr->lpszVersion);
+    HeapFree(GetProcessHeap(),0,lpwhr->lpszStatusText);
+
+    lpwhr->lpszVersion= WININET_strdupW(version);
+    lpwhr->lpszStatusText = WININET_strdupW(status_text);
+}
+
 /***********************************************************************
  *           HTTP_GetResponseHeaders (internal)
  *
@@ -3732,15 +4678,7 @@ static INT HTTP_GetResponseHeaders(LPWININETHTTPREQW lpwhr, BOOL clear)
 
     } while (!strcmpW(status_code, szHundred)); /* ignore "100 Continue" responses */
 
-    /* Add status code */
-    HTTP_ProcessHeader(lpwhr, szStatus, status_code,
-            HTTP_ADDHDR_FLAG_REPLACE);
-
-    HeapFree(GetProcessHeap(),0,lpwhr->lpszVersion);
-    HeapFree(GetProcessHeap(),0,lpwhr->lpszStatusText);
-
-    lpwhr->lpszVersion= WININET_strdupW(buffer);
-    lpwhr->lpszStatusText = WININET_strdupW(status_text);
+    HTTP_SetStatus(lpwhr, buffer, status_code, status_text);
 
     /* Restore the spaces */
     *(status_code-1) = ' ';
@@ -4013,36 +4951,64 @@ static BOOL HTTP_ProcessHeader(LPWININETHTTPREQW lpwhr, LPCWSTR field, LPCWSTR v
 
 
 /***********************************************************************
- *           HTTP_FinishedReading (internal)
- *
- * Called when all content from server has been read by client.
+ *           HTTP_KeepAlive (internal)
  *
+ * Whether the server lets us send another request on the connection.
  */
-BOOL HTTP_FinishedReading(LPWININETHTTPREQW lpwhr)
+static BOOL HTTP_KeepAlive(LPWININETHTTPREQW lpwhr)
 {
+    static const WCHAR szClose[] = {'C','l','o','s','e',0};
     WCHAR szVersion[10];
+    WCHAR szConnectionResponse[20];
     DWORD dwBufferSize = sizeof(szVersion);
+    LPHTTPHEADERW connection;
+    BOOL keepalive;
 
-    TRACE("\n");
+    /* we asked the server to close the connection */
+    connection = HTTP_GetHeader(lpwhr, szConnection);
+    if (connection && !strcmpiW(connection->lpszValue, szClose))
+        return FALSE;
 
     /* as per RFC 2068, S8.1.2.1, if the client is HTTP/1.1 then assume that
      * the connection is keep-alive by default */
-    if (!HTTP_HttpQueryInfoW(lpwhr, HTTP_QUERY_VERSION, szVersion,
-                             &dwBufferSize, NULL) ||
-        strcmpiW(szVersion, g_szHttp1_1))
-    {
-        WCHAR szConnectionResponse[20];
-        dwBufferSize = sizeof(szConnectionResponse);
-        if ((!HTTP_HttpQueryInfoW(lpwhr, HTTP_QUERY_CONNECTION, szConnectionResponse, &dwBufferSize, NULL) ||
-             strcmpiW(szConnectionResponse, szKeepAlive)) &&
-            (!HTTP_HttpQueryInfoW(lpwhr, HTTP_QUERY_PROXY_CONNECTION, szConnectionResponse, &dwBufferSize, NULL) ||
-             strcmpiW(szConnectionResponse, szKeepAlive)))
-        {
-            HTTPREQ_CloseConnection(&lpwhr->hdr);
-        }
-    }
+    keepalive = HTTP_HttpQueryInfoW(lpwhr, HTTP_QUERY_VERSION, szVersion,
+                                    &dwBufferSize, NULL) &&
+                !strcmpiW(szVersion, g_szHttp1_1);
+
+    /* unless either of the connection headers says otherwise */
+    dwBufferSize = sizeof(szConnectionResponse);
+    if (HTTP_HttpQueryInfoW(lpwhr, HTTP_QUERY_CONNECTION, szConnectionResponse, &dwBufferSize, NULL))
+        return !strcmpiW(szConnectionResponse, szKeepAlive);
+    dwBufferSize = sizeof(szConnectionResponse);
+    if (HTTP_HttpQueryInfoW(lpwhr, HTTP_QUERY_PROXY_CONNECTION, szConnectionResponse, &dwBufferSize, NULL))
+        return !strcmpiW(szConnectionResponse, szKeepAlive);
+
+    return keepalive;
+}
+
+/***********************************************************************
+ *           HTTP_FinishedReading (internal)
+ *
+ * Called when all content from server has been read by client.
+ *
+ */
+BOOL HTTP_FinishedReading(LPWININETHTTPREQW lpwhr)
+{
+    TRACE("\n");
 
-    /* FIXME: store data in the URL cache here */
+    if (!HTTP_KeepAlive(lpwhr))
+        HTTPREQ_CloseConnection(&lpwhr->hdr);
+    /* the connection can only be used for another request if we know
+     * where this response ended */
+    else if (lpwhr->dwContentLength != -1 &&
+             lpwhr->dwContentRead == lpwhr->dwContentLength)
+        lpwhr->bReusable = TRUE;
+
+    /* only a response that we know was received completely goes to the cache */
+    if (lpwhr->hCacheFile && lpwhr->dwContentLength != -1 &&
+        lpwhr->dwContentRead == lpwhr->dwContentLength &&
+        HTTP_ShouldCacheResponse(lpwhr))
+        HTTP_CommitCacheEntry(lpwhr);
 
     return TRUE;
 }
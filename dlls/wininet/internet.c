@@ -287,6 +287,13 @@ BOOL WINAPI DllMain (HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 
 	    URLCacheContainers_DeleteAll();
 
+            /* other threads may have been killed while holding the locks */
+            if (!lpvReserved)
+            {
+                HTTP_FreeConnectionPool();
+                NETCON_unload();
+            }
+
 	    if (g_dwTlsErrIndex != TLS_OUT_OF_INDEXES)
 	    {
 	        HeapFree(GetProcessHeap(), 0, TlsGetValue(g_dwTlsErrIndex));
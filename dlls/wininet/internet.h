@@ -189,6 +189,7 @@ typedef struct
 
 
 struct HttpAuthInfo;
+struct gzip_stream_t;
 
 typedef struct
 {
@@ -204,10 +205,14 @@ typedef struct
     DWORD dwContentRead; /* bytes of the content read so far */
     HTTPHEADERW *pCustHeaders;
     DWORD nCustHeaders;
-    HANDLE hCacheFile;
+    HANDLE hCacheFile; /* open for writing until the entry is committed */
     LPWSTR lpszCacheFile;
+    HANDLE hCacheData; /* cached body served for a 304 response */
     struct HttpAuthInfo *pAuthInfo;
     struct HttpAuthInfo *pProxyAuthInfo;
+    BOOL bReusable; /* response fully read on a keep-alive connection */
+    BOOL decoding; /* INTERNET_OPTION_HTTP_DECODING */
+    struct gzip_stream_t *gzip_stream;
 } WININETHTTPREQW, *LPWININETHTTPREQW;
 
 
@@ -376,6 +381,7 @@ INTERNETAPI HINTERNET WINAPI HTTP_HttpOpenRequestW(LPWININETHTTPSESSIONW lpwhs,
 	LPCWSTR lpszReferrer , LPCWSTR *lpszAcceptTypes,
 	DWORD dwFlags, DWORD_PTR dwContext);
 BOOL HTTP_FinishedReading(LPWININETHTTPREQW lpwhr);
+void HTTP_FreeConnectionPool(void);
 
 VOID SendAsyncCallback(LPWININETHANDLEHEADER hdr, DWORD_PTR dwContext,
                        DWORD dwInternetStatus, LPVOID lpvStatusInfo,
@@ -400,9 +406,11 @@ BOOL NETCON_send(WININET_NETCONNECTION *connection, const void *msg, size_t len,
 BOOL NETCON_recv(WININET_NETCONNECTION *connection, void *buf, size_t len, int flags,
 		int *recvd /* out */);
 BOOL NETCON_query_data_available(WININET_NETCONNECTION *connection, DWORD *available);
+BOOL NETCON_is_alive(WININET_NETCONNECTION *connection);
 BOOL NETCON_getNextLine(WININET_NETCONNECTION *connection, LPSTR lpszBuffer, LPDWORD dwBuffer);
 LPCVOID NETCON_GetCert(WININET_NETCONNECTION *connection);
 DWORD NETCON_set_timeout(WININET_NETCONNECTION *connection, BOOL send, int value);
+void NETCON_unload(void);
 
 extern void URLCacheContainers_CreateDefaults(void);
 extern void URLCacheContainers_DeleteAll(void);
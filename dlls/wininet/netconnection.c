@@ -73,6 +73,7 @@
 #include "wincrypt.h"
 
 #include "wine/debug.h"
+#include "wine/unicode.h"
 #include "internet.h"
 
 /* To avoid conflicts with the Unix socket headers. we only need it for
@@ -101,6 +102,29 @@ static void *OpenSSL_crypto_handle;
 static SSL_METHOD *meth;
 static SSL_CTX *ctx;
 
+/* sessions of completed handshakes, so that connecting to the same host
+ * again can use an abbreviated handshake */
+struct ssl_session_entry
+{
+    struct list entry;
+    LPWSTR hostname;
+    SSL_SESSION *session;
+};
+
+#define MAX_SSL_SESSIONS 32
+
+static struct list ssl_sessions = LIST_INIT(ssl_sessions);
+static unsigned int ssl_sessions_count;
+
+static CRITICAL_SECTION ssl_session_cs;
+static CRITICAL_SECTION_DEBUG ssl_session_cs_debug =
+{
+    0, 0, &ssl_session_cs,
+    { &ssl_session_cs_debug.ProcessLocksList, &ssl_session_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": ssl_session_cs") }
+};
+static CRITICAL_SECTION ssl_session_cs = { &ssl_session_cs_debug, -1, 0, 0, 0, 0 };
+
 #define MAKE_FUNCPTR(f) static typeof(f) * p##f
 
 /* OpenSSL functions that we use */
@@ -108,6 +132,7 @@ MAKE_FUNCPTR(SSL_library_init);
 MAKE_FUNCPTR(SSL_load_error_strings);
 MAKE_FUNCPTR(SSLv23_method);
 MAKE_FUNCPTR(SSL_CTX_new);
+MAKE_FUNCPTR(SSL_CTX_free);
 MAKE_FUNCPTR(SSL_new);
 MAKE_FUNCPTR(SSL_free);
 MAKE_FUNCPTR(SSL_set_fd);
@@ -120,6 +145,9 @@ MAKE_FUNCPTR(SSL_get_peer_certificate);
 MAKE_FUNCPTR(SSL_CTX_get_timeout);
 MAKE_FUNCPTR(SSL_CTX_set_timeout);
 MAKE_FUNCPTR(SSL_CTX_set_default_verify_paths);
+MAKE_FUNCPTR(SSL_get1_session);
+MAKE_FUNCPTR(SSL_set_session);
+MAKE_FUNCPTR(SSL_SESSION_free);
 MAKE_FUNCPTR(i2d_X509);
 
 /* OpenSSL's libcrypto functions that we use */
@@ -171,6 +199,7 @@ BOOL NETCON_init(WININET_NETCONNECTION *connection, BOOL useSSL)
 	DYNSSL(SSL_load_error_strings);
 	DYNSSL(SSLv23_method);
 	DYNSSL(SSL_CTX_new);
+	DYNSSL(SSL_CTX_free);
 	DYNSSL(SSL_new);
 	DYNSSL(SSL_free);
 	DYNSSL(SSL_set_fd);
@@ -183,6 +212,9 @@ BOOL NETCON_init(WININET_NETCONNECTION *connection, BOOL useSSL)
 	DYNSSL(SSL_CTX_get_timeout);
 	DYNSSL(SSL_CTX_set_timeout);
 	DYNSSL(SSL_CTX_set_default_verify_paths);
+	DYNSSL(SSL_get1_session);
+	DYNSSL(SSL_set_session);
+	DYNSSL(SSL_SESSION_free);
 	DYNSSL(i2d_X509);
 #undef DYNSSL
 
@@ -353,7 +385,127 @@ static BOOL check_hostname(X509 *cert, char *hostname)
     /* FIXME: implement */
     return TRUE;
 }
+
+/* all connections share one context, there is no point in reloading the
+ * trusted certificates for every handshake */
+static SSL_CTX *get_ssl_context(void)
+{
+    SSL_CTX *new_ctx;
+
+    if (ctx) return ctx;
+
+    new_ctx = pSSL_CTX_new(meth);
+    if (!new_ctx)
+    {
+        ERR("SSL_CTX_new failed: %s\n",
+            pERR_error_string(pERR_get_error(), 0));
+        return NULL;
+    }
+    if (!pSSL_CTX_set_default_verify_paths(new_ctx))
+    {
+        ERR("SSL_CTX_set_default_verify_paths failed: %s\n",
+            pERR_error_string(pERR_get_error(), 0));
+        pSSL_CTX_free(new_ctx);
+        return NULL;
+    }
+    if (InterlockedCompareExchangePointer((void **)&ctx, new_ctx, NULL))
+        pSSL_CTX_free(new_ctx);
+    return ctx;
+}
+
+/* offer the session of the last handshake with this host for resumption */
+static void set_cached_session(SSL *ssl, LPCWSTR hostname)
+{
+    struct ssl_session_entry *cached;
+
+    EnterCriticalSection(&ssl_session_cs);
+    LIST_FOR_EACH_ENTRY(cached, &ssl_sessions, struct ssl_session_entry, entry)
+    {
+        if (!strcmpiW(cached->hostname, hostname))
+        {
+            TRACE("trying to resume session with %s\n", debugstr_w(hostname));
+            pSSL_set_session(ssl, cached->session);
+            break;
+        }
+    }
+    LeaveCriticalSection(&ssl_session_cs);
+}
+
+static void free_cached_session(struct ssl_session_entry *cached)
+{
+    pSSL_SESSION_free(cached->session);
+    HeapFree(GetProcessHeap(), 0, cached->hostname);
+    HeapFree(GetProcessHeap(), 0, cached);
+}
+
+static void cache_session(SSL *ssl, LPCWSTR hostname)
+{
+    struct ssl_session_entry *cached, *evicted = NULL;
+    SSL_SESSION *session, *stale = NULL;
+
+    if (!(session = pSSL_get1_session(ssl))) return;
+
+    EnterCriticalSection(&ssl_session_cs);
+    LIST_FOR_EACH_ENTRY(cached, &ssl_sessions, struct ssl_session_entry, entry)
+    {
+        if (!strcmpiW(cached->hostname, hostname))
+        {
+            stale = cached->session;
+            cached->session = session;
+            session = NULL;
+            break;
+        }
+    }
+    if (session && (cached = HeapAlloc(GetProcessHeap(), 0, sizeof(*cached))))
+    {
+        if ((cached->hostname = WININET_strdupW(hostname)))
+        {
+            cached->session = session;
+            session = NULL;
+            list_add_head(&ssl_sessions, &cached->entry);
+            if (++ssl_sessions_count > MAX_SSL_SESSIONS)
+            {
+                evicted = LIST_ENTRY(list_tail(&ssl_sessions), struct ssl_session_entry, entry);
+                list_remove(&evicted->entry);
+                ssl_sessions_count--;
+            }
+        }
+        else
+            HeapFree(GetProcessHeap(), 0, cached);
+    }
+    LeaveCriticalSection(&ssl_session_cs);
+
+    if (stale) pSSL_SESSION_free(stale);
+    if (session) pSSL_SESSION_free(session);
+    if (evicted) free_cached_session(evicted);
+}
 #endif
+
+/******************************************************************************
+ * NETCON_unload
+ * Frees the resources shared between secure connections.
+ */
+void NETCON_unload(void)
+{
+#ifdef SONAME_LIBSSL
+    struct ssl_session_entry *cached, *next;
+
+    if (!OpenSSL_ssl_handle) return;
+
+    LIST_FOR_EACH_ENTRY_SAFE(cached, next, &ssl_sessions, struct ssl_session_entry, entry)
+    {
+        list_remove(&cached->entry);
+        free_cached_session(cached);
+    }
+    ssl_sessions_count = 0;
+
+    if (ctx)
+    {
+        pSSL_CTX_free(ctx);
+        ctx = NULL;
+    }
+#endif
+}
 /******************************************************************************
  * NETCON_secure_connect
  * Initiates a secure connection over an existing plaintext connection.
@@ -373,11 +525,8 @@ BOOL NETCON_secure_connect(WININET_NETCONNECTION *connection, LPCWSTR hostname)
         return FALSE;
     }
 
-    ctx = pSSL_CTX_new(meth);
-    if (!pSSL_CTX_set_default_verify_paths(ctx))
+    if (!get_ssl_context())
     {
-        ERR("SSL_CTX_set_default_verify_paths failed: %s\n",
-            pERR_error_string(pERR_get_error(), 0));
         INTERNET_SetLastError(ERROR_OUTOFMEMORY);
         return FALSE;
     }
@@ -398,6 +547,8 @@ BOOL NETCON_secure_connect(WININET_NETCONNECTION *connection, LPCWSTR hostname)
         goto fail;
     }
 
+    set_cached_session(connection->ssl_s, hostname);
+
     if (pSSL_connect(connection->ssl_s) <= 0)
     {
         ERR("SSL_connect failed: %s\n",
@@ -438,6 +589,7 @@ BOOL NETCON_secure_connect(WININET_NETCONNECTION *connection, LPCWSTR hostname)
     }
 
     HeapFree(GetProcessHeap(), 0, hostname_unix);
+    cache_session(connection->ssl_s, hostname);
     connection->useSSL = TRUE;
     return TRUE;
 
@@ -621,6 +773,29 @@ BOOL NETCON_query_data_available(WININET_NETCONNECTION *connection, DWORD *avail
     return TRUE;
 }
 
+/******************************************************************************
+ * NETCON_is_alive
+ * Checks whether an idle connection can still be used to send a request.
+ */
+BOOL NETCON_is_alive(WININET_NETCONNECTION *connection)
+{
+    struct pollfd pfd;
+
+    if (!NETCON_connected(connection))
+        return FALSE;
+
+#ifdef SONAME_LIBSSL
+    if (connection->peek_msg) return FALSE;
+#endif
+
+    /* nothing should arrive on an idle connection, so if there is something
+     * to read the server has either closed it or sent data we can't use */
+    pfd.fd = connection->socketFD;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) == 0;
+}
+
 /******************************************************************************
  * NETCON_getNextLine
  */
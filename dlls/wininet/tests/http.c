@@ -1326,6 +1326,91 @@ static const char proxymsg[] =
 "Proxy-Authenticate: Basic realm=\"placebo\"\r\n"
 "\r\n";
 
+static const char reusemsg[] =
+"HTTP/1.1 200 OK\r\n"
+"Server: winetest\r\n"
+"Content-Length: 4\r\n"
+"\r\n"
+"wine";
+
+static const char reuseclosemsg[] =
+"HTTP/1.1 200 OK\r\n"
+"Server: winetest\r\n"
+"Connection: close\r\n"
+"Content-Length: 4\r\n"
+"\r\n"
+"wine";
+
+static const char cachemsg[] =
+"HTTP/1.1 200 OK\r\n"
+"Server: winetest\r\n"
+"Connection: close\r\n"
+"ETag: \"wine\"\r\n"
+"Last-Modified: Mon, 15 Nov 1999 16:09:35 GMT\r\n"
+"Content-Length: 32\r\n"
+"\r\n"
+"<html><body>cached</body></html>";
+
+static const char notmodifiedmsg[] =
+"HTTP/1.1 304 Not Modified\r\n"
+"Server: winetest\r\n"
+"Connection: close\r\n"
+"ETag: \"wine\"\r\n"
+"\r\n";
+
+/* build_corpus() compressed with gzip */
+static const unsigned char gzip_corpus[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x9d, 0xd6,
+    0x4d, 0x0a, 0xc2, 0x30, 0x10, 0x40, 0xe1, 0xbd, 0xe0, 0x1d, 0xca, 0xac,
+    0x5d, 0x38, 0x7f, 0x51, 0x7b, 0x15, 0x71, 0x51, 0xb0, 0xd4, 0x2c, 0x2c,
+    0x05, 0x0b, 0x82, 0xc5, 0xbb, 0x5b, 0xf1, 0x04, 0xbe, 0x5d, 0x26, 0xf0,
+    0x56, 0xf9, 0x48, 0xb2, 0x48, 0xbd, 0x4a, 0xdb, 0xec, 0x77, 0x8d, 0x8c,
+    0xdd, 0xbd, 0x5f, 0x97, 0xf2, 0xac, 0x63, 0x2f, 0xeb, 0x3c, 0x77, 0xc3,
+    0x63, 0x9d, 0xcf, 0x72, 0x9b, 0xe7, 0xe9, 0xbb, 0x31, 0xbc, 0xea, 0x24,
+    0x97, 0xf7, 0x76, 0xb3, 0xfc, 0x22, 0x25, 0x91, 0x91, 0xc8, 0x49, 0x14,
+    0x24, 0x4a, 0x12, 0x15, 0x12, 0x1d, 0x48, 0x74, 0x24, 0xd1, 0x09, 0x1d,
+    0x2e, 0x23, 0x81, 0x4c, 0x28, 0x42, 0xa1, 0x48, 0x85, 0x22, 0x16, 0x8a,
+    0x5c, 0x28, 0x82, 0xa1, 0x48, 0x86, 0x22, 0x1a, 0x8a, 0x6c, 0x18, 0xb2,
+    0x61, 0xec, 0xbe, 0x40, 0x36, 0x0c, 0xd9, 0x30, 0x64, 0xc3, 0x90, 0x0d,
+    0x43, 0x36, 0x0c, 0xd9, 0x30, 0x64, 0xc3, 0x90, 0x0d, 0x47, 0x36, 0x1c,
+    0xd9, 0x70, 0xf6, 0x98, 0x20, 0x1b, 0x8e, 0x6c, 0x38, 0xb2, 0xe1, 0xc8,
+    0x86, 0x23, 0x1b, 0x8e, 0x6c, 0x38, 0xb2, 0x11, 0xc8, 0x46, 0x20, 0x1b,
+    0x81, 0x6c, 0x04, 0xfb, 0x69, 0x20, 0x1b, 0x81, 0x6c, 0x04, 0xb2, 0x11,
+    0xc8, 0x46, 0x20, 0x1b, 0x81, 0x6c, 0x24, 0xb2, 0x91, 0xc8, 0x46, 0x22,
+    0x1b, 0x89, 0x6c, 0x24, 0xfb, 0x86, 0x22, 0x1b, 0x89, 0x6c, 0x24, 0xb2,
+    0x91, 0xc8, 0x46, 0x22, 0x1b, 0x05, 0xd9, 0x28, 0xc8, 0x46, 0x41, 0x36,
+    0xca, 0x7f, 0x36, 0x3e, 0x27, 0xb6, 0xdb, 0x11, 0x76, 0x0d, 0x00, 0x00,
+};
+
+static const char gzipmsg[] =
+"HTTP/1.1 200 OK\r\n"
+"Server: winetest\r\n"
+"Connection: close\r\n"
+"Content-Encoding: gzip\r\n"
+"Content-Length: 240\r\n"
+"\r\n";
+
+/* no Content-Length and the connection stays open, so the end of the
+ * content is only known from the end of the compressed stream */
+static const char deflatemsg[] =
+"HTTP/1.1 200 OK\r\n"
+"Server: winetest\r\n"
+"Content-Encoding: deflate\r\n"
+"\r\n";
+
+static int build_corpus(char *buf)
+{
+    int i, len = 0;
+
+    for (i = 0; i < 64; i++)
+        len += sprintf(buf + len, "{\"id\": %d, \"name\": \"wine\", \"tags\": [\"http\", \"gzip\"]}\r\n", i);
+    return len;
+}
+
+static int server_connections;
+static int server_cache_bytes;
+static int server_cache_validated;
+
 static const char page1[] =
 "<HTML>\r\n"
 "<HEAD><TITLE>wininet test page</TITLE></HEAD>\r\n"
@@ -1343,9 +1428,9 @@ static DWORD CALLBACK server_thread(LPVOID param)
     int r, c, i, on;
     SOCKET s;
     struct sockaddr_in sa;
-    char buffer[0x100];
+    char buffer[0x400];
     WSADATA wsaData;
-    int last_request = 0;
+    int last_request = 0, keep_alive = 0;
 
     WSAStartup(MAKEWORD(1,1), &wsaData);
 
@@ -1371,7 +1456,12 @@ static DWORD CALLBACK server_thread(LPVOID param)
 
     do
     {
-        c = accept(s, NULL, NULL);
+        if (!keep_alive)
+        {
+            c = accept(s, NULL, NULL);
+            server_connections++;
+        }
+        keep_alive = 0;
 
         memset(buffer, 0, sizeof buffer);
         for(i=0; i<(sizeof buffer-1); i++)
@@ -1461,6 +1551,48 @@ static DWORD CALLBACK server_thread(LPVOID param)
             else
                 send(c, notokmsg, sizeof notokmsg-1, 0);
         }
+        if (strstr(buffer, "GET /test_reuse_close"))
+            send(c, reuseclosemsg, sizeof reuseclosemsg-1, 0);
+        else if (strstr(buffer, "GET /test_reuse"))
+        {
+            send(c, reusemsg, sizeof reusemsg-1, 0);
+            keep_alive = 1;
+        }
+        if (strstr(buffer, "GET /test_cache"))
+        {
+            if (strstr(buffer, "If-None-Match: \"wine\""))
+            {
+                server_cache_validated++;
+                server_cache_bytes += send(c, notmodifiedmsg, sizeof notmodifiedmsg-1, 0);
+            }
+            else
+                server_cache_bytes += send(c, cachemsg, sizeof cachemsg-1, 0);
+        }
+        if (strstr(buffer, "GET /test_gzip"))
+        {
+            if (strstr(buffer, "Accept-Encoding: gzip"))
+            {
+                send(c, gzipmsg, sizeof gzipmsg-1, 0);
+                send(c, (const char *)gzip_corpus, sizeof gzip_corpus, 0);
+            }
+            else
+            {
+                char *corpus = HeapAlloc(GetProcessHeap(), 0, 0x1000);
+                int len = build_corpus(corpus);
+
+                sprintf(buffer, "HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: %d\r\n\r\n", len);
+                send(c, buffer, strlen(buffer), 0);
+                send(c, corpus, len, 0);
+                HeapFree(GetProcessHeap(), 0, corpus);
+            }
+        }
+        if (strstr(buffer, "GET /test_deflate"))
+        {
+            /* raw deflate data without the zlib header, the way many servers send it */
+            send(c, deflatemsg, sizeof deflatemsg-1, 0);
+            send(c, (const char *)gzip_corpus + 10, sizeof gzip_corpus - 18, 0);
+            keep_alive = 1;
+        }
         if (strstr(buffer, "GET /quit"))
         {
             send(c, okmsg, sizeof okmsg-1, 0);
@@ -1468,6 +1600,9 @@ static DWORD CALLBACK server_thread(LPVOID param)
             last_request = 1;
         }
 
+        /* keep the connection open for the next request */
+        if (keep_alive) continue;
+
         shutdown(c, 2);
         closesocket(c);
     } while (!last_request);
@@ -1727,6 +1862,208 @@ static void test_connection_header(int port)
     InternetCloseHandle(ses);
 }
 
+static void test_connection_reuse(int port)
+{
+    HINTERNET ses, con, req;
+    DWORD count, start, i;
+    char buffer[0x100];
+    BOOL ret;
+
+    ses = InternetOpen("winetest", INTERNET_OPEN_TYPE_DIRECT, NULL, NULL, 0);
+    ok(ses != NULL, "InternetOpen failed\n");
+
+    con = InternetConnect(ses, "localhost", port, NULL, NULL, INTERNET_SERVICE_HTTP, 0, 0);
+    ok(con != NULL, "InternetConnect failed\n");
+
+    server_connections = 0;
+    start = GetTickCount();
+    for (i = 0; i < 100; i++)
+    {
+        /* every request gets its own handle, the connection is kept by wininet */
+        req = HttpOpenRequest(con, NULL, i < 99 ? "/test_reuse" : "/test_reuse_close",
+                              NULL, NULL, NULL, 0, 0);
+        ok(req != NULL, "HttpOpenRequest failed\n");
+
+        ret = HttpSendRequest(req, NULL, 0, NULL, 0);
+        ok(ret, "HttpSendRequest failed\n");
+
+        count = 0;
+        memset(buffer, 0, sizeof buffer);
+        ret = InternetReadFile(req, buffer, sizeof buffer, &count);
+        ok(ret, "InternetReadFile failed\n");
+        ok(count == 4 && !memcmp(buffer, "wine", 4), "got %u bytes %s\n", count, buffer);
+
+        InternetCloseHandle(req);
+    }
+    trace("%u requests took %u ms\n", i, GetTickCount() - start);
+    ok(server_connections == 1, "expected the requests to share one connection, server saw %d\n",
+       server_connections);
+
+    InternetCloseHandle(con);
+    InternetCloseHandle(ses);
+}
+
+static DWORD fetch_cached(HINTERNET con, DWORD flags, const char *url, char *buffer, DWORD size)
+{
+    char option_url[INTERNET_MAX_URL_LENGTH];
+    HINTERNET req;
+    DWORD count, code, len;
+    BOOL ret;
+
+    req = HttpOpenRequest(con, NULL, "/test_cache", NULL, NULL, NULL, flags, 0);
+    ok(req != NULL, "HttpOpenRequest failed\n");
+
+    /* the URL must include the port, it is the key of the cache entry */
+    len = sizeof(option_url);
+    ret = InternetQueryOption(req, INTERNET_OPTION_URL, option_url, &len);
+    ok(ret, "InternetQueryOption(INTERNET_OPTION_URL) failed: %u\n", GetLastError());
+    ok(!strcmp(option_url, url), "got URL %s, expected %s\n", option_url, url);
+
+    ret = HttpSendRequest(req, NULL, 0, NULL, 0);
+    ok(ret, "HttpSendRequest failed\n");
+
+    len = sizeof(code);
+    ret = HttpQueryInfo(req, HTTP_QUERY_STATUS_CODE|HTTP_QUERY_FLAG_NUMBER, &code, &len, NULL);
+    ok(ret, "HttpQueryInfo failed\n");
+    ok(code == 200, "got status %u\n", code);
+
+    count = 0;
+    memset(buffer, 0, size);
+    ret = InternetReadFile(req, buffer, size, &count);
+    ok(ret, "InternetReadFile failed\n");
+
+    InternetCloseHandle(req);
+    return count;
+}
+
+static void test_cache_revalidation(int port)
+{
+    static const char body[] = "<html><body>cached</body></html>";
+    HINTERNET ses, con;
+    char url[INTERNET_MAX_URL_LENGTH], buffer[0x100];
+    DWORD count, start, size;
+
+    sprintf(url, "http://localhost:%d/test_cache", port);
+    DeleteUrlCacheEntry(url);
+
+    ses = InternetOpen("winetest", INTERNET_OPEN_TYPE_DIRECT, NULL, NULL, 0);
+    ok(ses != NULL, "InternetOpen failed\n");
+
+    con = InternetConnect(ses, "localhost", port, NULL, NULL, INTERNET_SERVICE_HTTP, 0, 0);
+    ok(con != NULL, "InternetConnect failed\n");
+
+    server_cache_bytes = server_cache_validated = 0;
+    start = GetTickCount();
+    count = fetch_cached(con, 0, url, buffer, sizeof buffer);
+    ok(count == sizeof body-1 && !strcmp(buffer, body), "got %u bytes %s\n", count, buffer);
+    ok(!server_cache_validated, "first request was conditional\n");
+    size = 0;
+    ok(!GetUrlCacheEntryInfo(url, NULL, &size) && GetLastError() == ERROR_INSUFFICIENT_BUFFER,
+       "no cache entry for %s: %u\n", url, GetLastError());
+    trace("first fetch: %u ms, %d bytes from the server\n", GetTickCount() - start, server_cache_bytes);
+
+    /* the response is in the cache now, the server only has to confirm it */
+    server_cache_bytes = 0;
+    start = GetTickCount();
+    count = fetch_cached(con, 0, url, buffer, sizeof buffer);
+    ok(count == sizeof body-1 && !strcmp(buffer, body), "got %u bytes %s\n", count, buffer);
+    ok(server_cache_validated == 1, "expected a conditional request\n");
+    ok(server_cache_bytes == sizeof notmodifiedmsg-1, "server sent %d bytes\n", server_cache_bytes);
+    trace("repeat fetch: %u ms, %d bytes from the server\n", GetTickCount() - start, server_cache_bytes);
+
+    server_cache_validated = 0;
+    count = fetch_cached(con, INTERNET_FLAG_RELOAD, url, buffer, sizeof buffer);
+    ok(count == sizeof body-1 && !strcmp(buffer, body), "got %u bytes %s\n", count, buffer);
+    ok(!server_cache_validated, "INTERNET_FLAG_RELOAD request was conditional\n");
+
+    InternetCloseHandle(con);
+    InternetCloseHandle(ses);
+
+    DeleteUrlCacheEntry(url);
+}
+
+static DWORD fetch_gzip(HINTERNET con, const char *path, BOOL decoding, char *buffer, DWORD size, char *encoding)
+{
+    HINTERNET req;
+    DWORD count, total = 0, len, avail;
+    BOOL ret;
+
+    req = HttpOpenRequest(con, NULL, path, NULL, NULL, NULL, 0, 0);
+    ok(req != NULL, "HttpOpenRequest failed\n");
+
+    if (decoding)
+    {
+        ret = InternetSetOption(req, INTERNET_OPTION_HTTP_DECODING, &decoding, sizeof(decoding));
+        ok(ret, "InternetSetOption(INTERNET_OPTION_HTTP_DECODING) failed: %u\n", GetLastError());
+    }
+
+    ret = HttpSendRequest(req, NULL, 0, NULL, 0);
+    ok(ret, "HttpSendRequest failed\n");
+
+    len = 32;
+    if (!HttpQueryInfo(req, HTTP_QUERY_CONTENT_ENCODING, encoding, &len, NULL))
+        encoding[0] = 0;
+
+    /* the available count is that of the decoded data */
+    for (;;)
+    {
+        avail = 0;
+        ret = InternetQueryDataAvailable(req, &avail, 0, 0);
+        ok(ret, "InternetQueryDataAvailable failed: %u\n", GetLastError());
+        if (!ret || !avail || avail > size - total)
+            break;
+
+        count = 0;
+        ret = InternetReadFile(req, buffer + total, avail, &count);
+        ok(ret, "InternetReadFile failed: %u\n", GetLastError());
+        ok(count == avail, "read %u bytes, %u were available\n", count, avail);
+        if (!ret || !count)
+            break;
+        total += count;
+    }
+
+    InternetCloseHandle(req);
+    return total;
+}
+
+static void test_content_decoding(int port)
+{
+    HINTERNET ses, con;
+    char *expect, *buffer, encoding[32];
+    DWORD len, count;
+
+    expect = HeapAlloc(GetProcessHeap(), 0, 0x1000);
+    buffer = HeapAlloc(GetProcessHeap(), 0, 0x1000);
+    len = build_corpus(expect);
+
+    ses = InternetOpen("winetest", INTERNET_OPEN_TYPE_DIRECT, NULL, NULL, 0);
+    ok(ses != NULL, "InternetOpen failed\n");
+
+    con = InternetConnect(ses, "localhost", port, NULL, NULL, INTERNET_SERVICE_HTTP, 0, 0);
+    ok(con != NULL, "InternetConnect failed\n");
+
+    /* without INTERNET_OPTION_HTTP_DECODING nothing is negotiated */
+    count = fetch_gzip(con, "/test_gzip", FALSE, buffer, 0x1000, encoding);
+    ok(!encoding[0], "unexpected Content-Encoding %s\n", encoding);
+    ok(count == len && !memcmp(buffer, expect, len), "got %u bytes, expected %u\n", count, len);
+
+    count = fetch_gzip(con, "/test_gzip", TRUE, buffer, 0x1000, encoding);
+    ok(!strcmp(encoding, "gzip"), "Content-Encoding = %s\n", encoding);
+    ok(count == len && !memcmp(buffer, expect, len), "got %u bytes, expected %u\n", count, len);
+    trace("gzip: %u bytes on the wire for %u bytes of content\n", (DWORD)sizeof(gzip_corpus), len);
+
+    /* must neither fail on the missing zlib header nor wait for the server to close */
+    count = fetch_gzip(con, "/test_deflate", TRUE, buffer, 0x1000, encoding);
+    ok(!strcmp(encoding, "deflate"), "Content-Encoding = %s\n", encoding);
+    ok(count == len && !memcmp(buffer, expect, len), "got %u bytes, expected %u\n", count, len);
+
+    InternetCloseHandle(con);
+    InternetCloseHandle(ses);
+
+    HeapFree(GetProcessHeap(), 0, expect);
+    HeapFree(GetProcessHeap(), 0, buffer);
+}
+
 static void test_http_connection(void)
 {
     struct server_info si;
@@ -1751,6 +2088,9 @@ static void test_http_connection(void)
     test_basic_request(si.port, "POST", "/test5");
     test_basic_request(si.port, "GET", "/test6");
     test_connection_header(si.port);
+    test_connection_reuse(si.port);
+    test_cache_revalidation(si.port);
+    test_content_decoding(si.port);
 
     /* send the basic request again to shutdown the server thread */
     test_basic_request(si.port, "GET", "/quit");
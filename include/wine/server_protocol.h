@@ -156,6 +156,22 @@ typedef struct
 } rectangle_t;
 
 
+
+struct window_shared
+{
+    unsigned int    seq;
+    user_handle_t   handle;
+    thread_id_t     tid;
+    process_id_t    pid;
+    user_handle_t   parent;
+    user_handle_t   owner;
+    unsigned int    style;
+    unsigned int    ex_style;
+    rectangle_t     window;
+    rectangle_t     client;
+};
+
+
 typedef struct
 {
     void           *callback;
@@ -435,6 +451,19 @@ typedef union
 } apc_result_t;
 
 
+struct request_stats
+{
+    process_id_t     pid;
+    int              req;
+    char             name[32];
+    unsigned int     count;
+    unsigned int     __pad;
+    timeout_t        total_time;
+    timeout_t        max_time;
+    file_pos_t       reply_bytes;
+};
+
+
 
 
 
@@ -3001,6 +3030,19 @@ struct get_window_rectangles_reply
 
 
 
+struct get_shared_window_table_request
+{
+    struct request_header __header;
+};
+struct get_shared_window_table_reply
+{
+    struct reply_header __header;
+    obj_handle_t   handle;
+    data_size_t    size;
+};
+
+
+
 struct get_window_text_request
 {
     struct request_header __header;
@@ -4282,6 +4324,24 @@ struct add_fd_completion_reply
 };
 
 
+
+struct get_request_stats_request
+{
+    struct request_header __header;
+    process_id_t   pid;
+    int            timing;
+    int            reset;
+};
+struct get_request_stats_reply
+{
+    struct reply_header __header;
+    timeout_t      since;
+    int            timing;
+    data_size_t    total;
+    /* VARARG(stats,request_stats); */
+};
+
+
 enum request
 {
     REQ_new_process,
@@ -4436,6 +4496,7 @@ enum request
     REQ_set_window_pos,
     REQ_set_window_visible_rect,
     REQ_get_window_rectangles,
+    REQ_get_shared_window_table,
     REQ_get_window_text,
     REQ_set_window_text,
     REQ_get_windows_offset,
@@ -4517,6 +4578,7 @@ enum request
     REQ_query_completion,
     REQ_set_completion_info,
     REQ_add_fd_completion,
+    REQ_get_request_stats,
     REQ_NB_REQUESTS
 };
 
@@ -4676,6 +4738,7 @@ union generic_request
     struct set_window_pos_request set_window_pos_request;
     struct set_window_visible_rect_request set_window_visible_rect_request;
     struct get_window_rectangles_request get_window_rectangles_request;
+    struct get_shared_window_table_request get_shared_window_table_request;
     struct get_window_text_request get_window_text_request;
     struct set_window_text_request set_window_text_request;
     struct get_windows_offset_request get_windows_offset_request;
@@ -4757,6 +4820,7 @@ union generic_request
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
+    struct get_request_stats_request get_request_stats_request;
 };
 union generic_reply
 {
@@ -4914,6 +4978,7 @@ union generic_reply
     struct set_window_pos_reply set_window_pos_reply;
     struct set_window_visible_rect_reply set_window_visible_rect_reply;
     struct get_window_rectangles_reply get_window_rectangles_reply;
+    struct get_shared_window_table_reply get_shared_window_table_reply;
     struct get_window_text_reply get_window_text_reply;
     struct set_window_text_reply set_window_text_reply;
     struct get_windows_offset_reply get_windows_offset_reply;
@@ -4995,8 +5060,9 @@ union generic_reply
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
+    struct get_request_stats_reply get_request_stats_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 340
+#define SERVER_PROTOCOL_VERSION 342
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
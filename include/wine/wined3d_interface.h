@@ -1626,6 +1626,11 @@ DECLARE_INTERFACE_(IWineD3DClipper,IUnknown)
 /* DDraw Clippers are not created from DDraw objects, they have a separate creation function */
 IWineD3DClipper* WINAPI WineDirect3DCreateClipper(IUnknown *parent);
 
+/* Converts surface data without a surface or GL, for the conversion tests */
+HRESULT WINAPI WineDirect3DConvertSurface(const BYTE *src, BYTE *dst, UINT pitch, UINT width, UINT height,
+        UINT outpitch, CONVERT_TYPES convert, const DWORD *palette, DWORD ck_low, DWORD ck_high,
+        BOOL nv_texture_shader);
+
 #if 0 /* FIXME: During porting in from d3d8 - the following will be used */
 extern HRESULT WINAPI IDirect3DVertexShaderImpl_ParseProgram(IDirect3DVertexShaderImpl* This, CONST DWORD* pFunction);
 /* internal Interfaces */
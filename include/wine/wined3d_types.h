@@ -1779,4 +1779,30 @@ typedef struct _WINEDDOVERLAYFX
 #define WINEDDFLIP_INTERVAL3                    0x03000000
 #define WINEDDFLIP_INTERVAL4                    0x04000000
 
+/* Surface conversions done by wined3d on upload, see WineDirect3DConvertSurface */
+typedef enum {
+    NO_CONVERSION,
+    CONVERT_PALETTED,
+    CONVERT_PALETTED_CK,
+    CONVERT_CK_565,
+    CONVERT_CK_5551,
+    CONVERT_CK_4444,
+    CONVERT_CK_4444_ARGB,
+    CONVERT_CK_1555,
+    CONVERT_555,
+    CONVERT_CK_RGB24,
+    CONVERT_CK_8888,
+    CONVERT_CK_8888_ARGB,
+    CONVERT_RGB32_888,
+    CONVERT_V8U8,
+    CONVERT_L6V5U5,
+    CONVERT_X8L8V8U8,
+    CONVERT_Q8W8V8U8,
+    CONVERT_V16U16,
+    CONVERT_A4L4,
+    CONVERT_R32F,
+    CONVERT_R16F,
+    CONVERT_G16R16,
+} CONVERT_TYPES;
+
 #endif
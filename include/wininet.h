@@ -540,6 +540,7 @@ BOOLAPI InternetUnlockRequestFile(HANDLE);
 #define INTERNET_OPTION_ERROR_MASK              62
 #define INTERNET_OPTION_FROM_CACHE_TIMEOUT      63
 #define INTERNET_OPTION_BYPASS_EDITED_ENTRY     64
+#define INTERNET_OPTION_HTTP_DECODING           65
 #define INTERNET_OPTION_DIAGNOSTIC_SOCKET_INFO  67
 #define INTERNET_OPTION_CODEPAGE                68
 #define INTERNET_OPTION_CACHE_TIMESTAMPS        69
@@ -1442,7 +1443,10 @@ INTERNETAPI DWORD WINAPI InternetConfirmZoneCrossingW(HWND ,LPWSTR ,LPWSTR ,BOOL
 #define ERROR_INTERNET_SEC_CERT_REVOKED    (INTERNET_ERROR_BASE + 170)
 #define ERROR_INTERNET_FAILED_DUETOSECURITYCHECK  (INTERNET_ERROR_BASE + 171)
 #define ERROR_INTERNET_NOT_INITIALIZED            (INTERNET_ERROR_BASE + 172)
-#define INTERNET_ERROR_LAST                       ERROR_INTERNET_NOT_INITIALIZED
+#define ERROR_INTERNET_NEED_MSN_SSPI_PKG          (INTERNET_ERROR_BASE + 173)
+#define ERROR_INTERNET_LOGIN_FAILURE_DISPLAY_ENTITY_BODY (INTERNET_ERROR_BASE + 174)
+#define ERROR_INTERNET_DECODING_FAILED            (INTERNET_ERROR_BASE + 175)
+#define INTERNET_ERROR_LAST                       ERROR_INTERNET_DECODING_FAILED
 
 
 #define NORMAL_CACHE_ENTRY              0x00000001
@@ -0,0 +1,126 @@
+/*
+ * Dump the wineserver request statistics
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The output is one comma separated line per request type and process,
+ * preceded by a header line:
+ *
+ *   pid,request,count,total_us,max_us,reply_bytes
+ *
+ * A pid of 0000 gives the totals of all processes since the last reset,
+ * including the ones that have exited.  Times are only accumulated while
+ * handler timing is enabled, either with -t or by sending SIGUSR1 to the
+ * wineserver.
+ */
+
+#include "config.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winbase.h"
+#include "winternl.h"
+#include "wine/server.h"
+
+static const char progname[] = "reqstat";
+
+static void usage(void)
+{
+    fprintf( stderr, "Usage: %s [-t on|off] [-r] [pid]\n", progname );
+    fprintf( stderr, "  -t on|off  enable or disable the timing of the request handlers\n" );
+    fprintf( stderr, "  -r         reset the statistics once they have been read\n" );
+    fprintf( stderr, "  pid        only dump the statistics of the given process (in hex)\n" );
+    exit( 1 );
+}
+
+int main( int argc, char *argv[] )
+{
+    struct request_stats *stats = NULL;
+    data_size_t size = 64 * sizeof(*stats), total = 0, got = 0;
+    process_id_t pid = 0;
+    timeout_t since = 0;
+    int i, timing = -1, reset = 0, enabled = 0;
+    NTSTATUS status;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp( argv[i], "-t" ) && i + 1 < argc)
+        {
+            i++;
+            if (!strcmp( argv[i], "on" )) timing = 1;
+            else if (!strcmp( argv[i], "off" )) timing = 0;
+            else usage();
+        }
+        else if (!strcmp( argv[i], "-r" )) reset = 1;
+        else if (argv[i][0] != '-' && !pid) pid = strtoul( argv[i], NULL, 16 );
+        else usage();
+    }
+
+    /* grow the buffer until all the statistics fit; the counters are only
+     * reset by the server if the reply was not truncated */
+    for (;;)
+    {
+        HeapFree( GetProcessHeap(), 0, stats );
+        if (!(stats = HeapAlloc( GetProcessHeap(), 0, size )))
+        {
+            fprintf( stderr, "%s: out of memory\n", progname );
+            return 1;
+        }
+
+        SERVER_START_REQ( get_request_stats )
+        {
+            req->pid    = pid;
+            req->timing = timing;
+            req->reset  = reset;
+            wine_server_set_reply( req, stats, size );
+            if (!(status = wine_server_call( req )))
+            {
+                since   = reply->since;
+                enabled = reply->timing;
+                total   = reply->total;
+                got     = wine_server_reply_size( reply );
+            }
+        }
+        SERVER_END_REQ;
+
+        if (status)
+        {
+            fprintf( stderr, "%s: cannot get the request statistics: %08x\n", progname, (unsigned int)status );
+            return 1;
+        }
+        if (got >= total) break;
+        size = total + 16 * sizeof(*stats);  /* leave room for new entries */
+        timing = -1;
+    }
+
+    printf( "# since=%x%08x timing=%s\n", (unsigned int)(since >> 32), (unsigned int)since,
+            enabled ? "on" : "off" );
+    printf( "pid,request,count,total_us,max_us,reply_bytes\n" );
+    for (i = 0; i < got / sizeof(*stats); i++)
+        printf( "%04x,%s,%u,%.0f,%u,%.0f\n", stats[i].pid, stats[i].name, stats[i].count,
+                (double)stats[i].total_time / 10, (unsigned int)(stats[i].max_time / 10),
+                (double)stats[i].reply_bytes );
+
+    HeapFree( GetProcessHeap(), 0, stats );
+    return 0;
+}
@@ -26,6 +26,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -402,6 +405,27 @@ int get_page_size(void)
     return page_mask + 1;
 }
 
+/* create an anonymous mapping that the server keeps mapped read/write in its own address space */
+struct object *create_server_mapping( file_pos_t size, void **ptr )
+{
+    struct mapping *mapping;
+    int unix_fd;
+
+    if (!(mapping = (struct mapping *)create_mapping( NULL, NULL, 0, size, VPROT_READ | VPROT_WRITE, 0, NULL )))
+        return NULL;
+    if ((unix_fd = get_file_unix_fd( mapping->file )) == -1) goto error;
+    if ((*ptr = mmap( NULL, mapping->size, PROT_READ | PROT_WRITE, MAP_SHARED, unix_fd, 0 )) == MAP_FAILED)
+    {
+        file_set_error();
+        goto error;
+    }
+    return &mapping->obj;
+
+error:
+    release_object( mapping );
+    return NULL;
+}
+
 /* create a file mapping */
 DECL_HANDLER(create_mapping)
 {
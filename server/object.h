@@ -182,6 +182,7 @@ extern void debug_exit_thread( struct thread *thread );
 /* mapping functions */
 
 extern int get_page_size(void);
+extern struct object *create_server_mapping( file_pos_t size, void **ptr );
 
 /* registry functions */
 
@@ -337,6 +337,7 @@ struct thread *create_process( int fd, struct thread *parent_thread, int inherit
     process->desktop         = 0;
     process->token           = NULL;
     process->trace_data      = 0;
+    process->req_counters    = NULL;
     list_init( &process->thread_list );
     list_init( &process->locks );
     list_init( &process->classes );
@@ -428,6 +429,7 @@ static void process_destroy( struct object *obj )
     if (process->queue) release_object( process->queue );
     if (process->id) free_ptid( process->id );
     if (process->token) release_object( process->token );
+    free( process->req_counters );
 }
 
 /* dump a process on stdout for debugging purposes */
@@ -1243,3 +1245,55 @@ DECL_HANDLER(make_process_system)
             shutdown_timeout = add_timeout_user( master_socket_timeout, server_shutdown_timeout, NULL );
     }
 }
+
+/* retrieve the request statistics, globally and for every process */
+DECL_HANDLER(get_request_stats)
+{
+    struct process *process = NULL;
+    struct request_stats *stats = NULL;
+    unsigned int count, max, n = 0;
+
+    if (req->pid && !(process = get_process_from_id( req->pid ))) return;
+    if (req->timing != -1) set_request_timing( req->timing );
+
+    reply->timing = request_timing;
+    reply->since  = request_stats_time ? request_stats_time : server_start_time;
+
+    /* first count the entries; a process without counters has none */
+    if (process)
+        count = process->req_counters ? get_request_stats( process->id, process->req_counters, NULL, 0, 0 ) : 0;
+    else
+    {
+        struct process *p;
+
+        count = get_request_stats( 0, NULL, NULL, 0, 0 );
+        LIST_FOR_EACH_ENTRY( p, &process_list, struct process, entry )
+            if (p->req_counters) count += get_request_stats( p->id, p->req_counters, NULL, 0, 0 );
+    }
+    reply->total = count * sizeof(*stats);
+
+    max = min( count, get_reply_max_size() / sizeof(*stats) );
+    if (max && !(stats = mem_alloc( max * sizeof(*stats) ))) goto done;
+
+    /* then fill them, the counters are only reset if everything fits */
+    if (process)
+    {
+        if (process->req_counters)
+            n = get_request_stats( process->id, process->req_counters, stats, max, req->reset && max == count );
+    }
+    else
+    {
+        struct process *p;
+        int reset = req->reset && max == count;
+
+        n = get_request_stats( 0, NULL, stats, max, reset );
+        LIST_FOR_EACH_ENTRY( p, &process_list, struct process, entry )
+        {
+            if (!p->req_counters) continue;
+            n += get_request_stats( p->id, p->req_counters, stats + min( n, max ), max - min( n, max ), reset );
+        }
+    }
+    if (stats) set_reply_data_ptr( stats, min( n, max ) * sizeof(*stats) );
+done:
+    if (process) release_object( process );
+}
@@ -27,6 +27,7 @@ struct msg_queue;
 struct atom_table;
 struct handle_table;
 struct startup_info;
+struct request_counter;
 
 /* process startup state */
 enum startup_state { STARTUP_IN_PROGRESS, STARTUP_DONE, STARTUP_ABORTED };
@@ -82,6 +83,7 @@ struct process
     void                *peb;             /* PEB address in client address space */
     void                *ldt_copy;        /* pointer to LDT copy in client addr space */
     unsigned int         trace_data;      /* opaque data used by the process tracing mechanism */
+    struct request_counter *req_counters; /* per-request statistics, allocated on first request */
 };
 
 struct process_snapshot
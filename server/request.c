@@ -122,9 +122,12 @@ unsigned int global_error = 0;  /* global error code for when no thread is curre
 timeout_t server_start_time = 0;  /* server startup time */
 int server_dir_fd = -1;    /* file descriptor for the server dir */
 int config_dir_fd = -1;    /* file descriptor for the config dir */
+int request_timing = 0;    /* time the request handlers */
+timeout_t request_stats_time = 0;  /* time of the last reset of the global statistics */
 
 static struct master_socket *master_socket;  /* the master socket object */
 static struct timeout_user *master_timeout;
+static struct request_counter global_counters[REQ_NB_REQUESTS];  /* statistics of all processes */
 
 /* socket communication static structures */
 static struct iovec myiovec;
@@ -271,11 +274,73 @@ static void send_reply( union generic_reply *reply )
         fatal_protocol_perror( current, "reply write" );
 }
 
+/* get a time stamp with microsecond precision, current_time is only updated once per poll */
+static timeout_t get_precise_time(void)
+{
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return (timeout_t)tv.tv_sec * TICKS_PER_SEC + tv.tv_usec * 10;
+}
+
+/* enable or disable the timing of the request handlers */
+void set_request_timing( int enable )
+{
+    request_timing = (enable != 0);
+    if (debug_level) fprintf( stderr, "wineserver: request timing %s\n",
+                              request_timing ? "enabled" : "disabled" );
+}
+
+/* add the cost of a request to a counter */
+static inline void update_request_counter( struct request_counter *counter, timeout_t elapsed,
+                                           data_size_t reply_size )
+{
+    counter->count++;
+    counter->total_time += elapsed;
+    if (elapsed > counter->max_time) counter->max_time = elapsed;
+    counter->reply_bytes += sizeof(union generic_reply) + reply_size;
+}
+
+/* retrieve the statistics of a set of counters, global ones if counters is NULL */
+/* returns the number of entries needed; at most max are stored */
+unsigned int get_request_stats( process_id_t pid, struct request_counter *counters,
+                                struct request_stats *stats, unsigned int max, int reset )
+{
+    unsigned int i, count = 0;
+
+    if (!counters) counters = global_counters;
+    for (i = 0; i < REQ_NB_REQUESTS; i++)
+    {
+        if (!counters[i].count) continue;
+        if (count < max)
+        {
+            struct request_stats *st = &stats[count];
+            const char *name = get_req_name( i );
+
+            memset( st, 0, sizeof(*st) );
+            st->pid         = pid;
+            st->req         = i;
+            memcpy( st->name, name, min( strlen(name), sizeof(st->name) - 1 ));
+            st->count       = counters[i].count;
+            st->total_time  = counters[i].total_time;
+            st->max_time    = counters[i].max_time;
+            st->reply_bytes = counters[i].reply_bytes;
+        }
+        count++;
+    }
+    if (reset)
+    {
+        memset( counters, 0, REQ_NB_REQUESTS * sizeof(*counters) );
+        if (counters == global_counters) request_stats_time = current_time;
+    }
+    return count;
+}
+
 /* call a request handler */
 static void call_req_handler( struct thread *thread )
 {
     union generic_reply reply;
     enum request req = thread->req.request_header.req;
+    timeout_t start = 0, elapsed = 0;
 
     current = thread;
     current->reply_size = 0;
@@ -285,7 +350,11 @@ static void call_req_handler( struct thread *thread )
     if (debug_level) trace_request();
 
     if (req < REQ_NB_REQUESTS)
+    {
+        if (request_timing) start = get_precise_time();
         req_handlers[req]( &current->req, &reply );
+        if (start) elapsed = get_precise_time() - start;
+    }
     else
         set_error( STATUS_NOT_IMPLEMENTED );
 
@@ -296,6 +365,16 @@ static void call_req_handler( struct thread *thread )
             reply.reply_header.error = current->error;
             reply.reply_header.reply_size = current->reply_size;
             if (debug_level) trace_reply( req, &reply );
+            if (req < REQ_NB_REQUESTS)
+            {
+                struct process *process = current->process;
+
+                update_request_counter( &global_counters[req], elapsed, current->reply_size );
+                if (!process->req_counters)
+                    process->req_counters = calloc( REQ_NB_REQUESTS, sizeof(*process->req_counters) );
+                if (process->req_counters)
+                    update_request_counter( &process->req_counters[req], elapsed, current->reply_size );
+            }
             send_reply( &reply );
         }
         else
@@ -65,6 +65,23 @@ extern int server_dir_fd, config_dir_fd;
 
 extern void trace_request(void);
 extern void trace_reply( enum request req, const union generic_reply *reply );
+extern const char *get_req_name( enum request req );
+
+/* request statistics */
+
+struct request_counter
+{
+    unsigned int     count;        /* number of requests handled */
+    timeout_t        total_time;   /* time spent in the handler while timing was enabled */
+    timeout_t        max_time;     /* longest time spent in the handler */
+    file_pos_t       reply_bytes;  /* total size of the replies */
+};
+
+extern int request_timing;
+extern timeout_t request_stats_time;
+extern void set_request_timing( int enable );
+extern unsigned int get_request_stats( process_id_t pid, struct request_counter *counters,
+                                       struct request_stats *stats, unsigned int max, int reset );
 
 /* get the request vararg data */
 static inline const void *get_req_data(void)
@@ -263,6 +280,7 @@ DECL_HANDLER(get_window_tree);
 DECL_HANDLER(set_window_pos);
 DECL_HANDLER(set_window_visible_rect);
 DECL_HANDLER(get_window_rectangles);
+DECL_HANDLER(get_shared_window_table);
 DECL_HANDLER(get_window_text);
 DECL_HANDLER(set_window_text);
 DECL_HANDLER(get_windows_offset);
@@ -344,6 +362,7 @@ DECL_HANDLER(remove_completion);
 DECL_HANDLER(query_completion);
 DECL_HANDLER(set_completion_info);
 DECL_HANDLER(add_fd_completion);
+DECL_HANDLER(get_request_stats);
 
 #ifdef WANT_REQUEST_HANDLERS
 
@@ -502,6 +521,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_set_window_pos,
     (req_handler)req_set_window_visible_rect,
     (req_handler)req_get_window_rectangles,
+    (req_handler)req_get_shared_window_table,
     (req_handler)req_get_window_text,
     (req_handler)req_set_window_text,
     (req_handler)req_get_windows_offset,
@@ -583,6 +603,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_query_completion,
     (req_handler)req_set_completion_info,
     (req_handler)req_add_fd_completion,
+    (req_handler)req_get_request_stats,
 };
 #endif  /* WANT_REQUEST_HANDLERS */
 
@@ -816,6 +816,25 @@ static void dump_varargs_object_attributes( data_size_t size )
     fputc( '}', stderr );
 }
 
+static void dump_varargs_request_stats( data_size_t size )
+{
+    const struct request_stats *stats = cur_data;
+    data_size_t len = size / sizeof(*stats);
+
+    fputc( '{', stderr );
+    while (len > 0)
+    {
+        fprintf( stderr, "{pid=%04x,req=%s,count=%u,time=%uus,reply=",
+                 stats->pid, stats->name, stats->count, (unsigned int)(stats->total_time / 10) );
+        dump_file_pos( &stats->reply_bytes );
+        fputc( '}', stderr );
+        stats++;
+        if (--len) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+    remove_data( size );
+}
+
 typedef void (*dump_func)( const void *req );
 
 /* Everything below this line is generated automatically by tools/make_requests */
@@ -2751,6 +2770,16 @@ static void dump_get_window_rectangles_reply( const struct get_window_rectangles
     dump_rectangle( &req->client );
 }
 
+static void dump_get_shared_window_table_request( const struct get_shared_window_table_request *req )
+{
+}
+
+static void dump_get_shared_window_table_reply( const struct get_shared_window_table_reply *req )
+{
+    fprintf( stderr, " handle=%p,", req->handle );
+    fprintf( stderr, " size=%u", req->size );
+}
+
 static void dump_get_window_text_request( const struct get_window_text_request *req )
 {
     fprintf( stderr, " handle=%p", req->handle );
@@ -3783,6 +3812,24 @@ static void dump_add_fd_completion_request( const struct add_fd_completion_reque
     fprintf( stderr, " information=%lx", req->information );
 }
 
+static void dump_get_request_stats_request( const struct get_request_stats_request *req )
+{
+    fprintf( stderr, " pid=%04x,", req->pid );
+    fprintf( stderr, " timing=%d,", req->timing );
+    fprintf( stderr, " reset=%d", req->reset );
+}
+
+static void dump_get_request_stats_reply( const struct get_request_stats_reply *req )
+{
+    fprintf( stderr, " since=" );
+    dump_timeout( &req->since );
+    fprintf( stderr, "," );
+    fprintf( stderr, " timing=%d,", req->timing );
+    fprintf( stderr, " total=%u,", req->total );
+    fprintf( stderr, " stats=" );
+    dump_varargs_request_stats( cur_size );
+}
+
 static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_new_process_request,
     (dump_func)dump_get_new_process_info_request,
@@ -3936,6 +3983,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_window_pos_request,
     (dump_func)dump_set_window_visible_rect_request,
     (dump_func)dump_get_window_rectangles_request,
+    (dump_func)dump_get_shared_window_table_request,
     (dump_func)dump_get_window_text_request,
     (dump_func)dump_set_window_text_request,
     (dump_func)dump_get_windows_offset_request,
@@ -4017,6 +4065,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_query_completion_request,
     (dump_func)dump_set_completion_info_request,
     (dump_func)dump_add_fd_completion_request,
+    (dump_func)dump_get_request_stats_request,
 };
 
 static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
@@ -4172,6 +4221,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_window_pos_reply,
     (dump_func)0,
     (dump_func)dump_get_window_rectangles_reply,
+    (dump_func)dump_get_shared_window_table_reply,
     (dump_func)dump_get_window_text_reply,
     (dump_func)0,
     (dump_func)dump_get_windows_offset_reply,
@@ -4253,6 +4303,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_query_completion_reply,
     (dump_func)0,
     (dump_func)0,
+    (dump_func)dump_get_request_stats_reply,
 };
 
 static const char * const req_names[REQ_NB_REQUESTS] = {
@@ -4408,6 +4459,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "set_window_pos",
     "set_window_visible_rect",
     "get_window_rectangles",
+    "get_shared_window_table",
     "get_window_text",
     "set_window_text",
     "get_windows_offset",
@@ -4489,6 +4541,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "query_completion",
     "set_completion_info",
     "add_fd_completion",
+    "get_request_stats",
 };
 
 static const struct
@@ -4603,6 +4656,12 @@ static const char *get_status_name( unsigned int status )
     return buffer;
 }
 
+const char *get_req_name( enum request req )
+{
+    if (req < REQ_NB_REQUESTS) return req_names[req];
+    return NULL;
+}
+
 void trace_request(void)
 {
     enum request req = current->req.request_header.req;
@@ -33,6 +33,7 @@
 #include "winternl.h"
 
 #include "object.h"
+#include "handle.h"
 #include "request.h"
 #include "thread.h"
 #include "process.h"
@@ -114,6 +115,67 @@ static struct window *taskman_window;
 #define WINPTR_TOPMOST   ((struct window *)3L)
 #define WINPTR_NOTOPMOST ((struct window *)4L)
 
+/* shared window table, indexed like the user handles and mapped read-only in the clients */
+#define NB_SHARED_WINDOWS ((LAST_USER_HANDLE - FIRST_USER_HANDLE + 1) >> 1)
+
+static struct object *shared_table_mapping;
+static struct window_shared *shared_windows;
+static int shared_table_failed;
+
+/* create the shared window table on first use */
+static void init_shared_window_table(void)
+{
+    void *ptr;
+
+    if (shared_windows || shared_table_failed) return;
+    if (!(shared_table_mapping = create_server_mapping( NB_SHARED_WINDOWS * sizeof(*shared_windows), &ptr )))
+    {
+        /* not fatal, the clients will simply use the window requests */
+        shared_table_failed = 1;
+        clear_error();
+        return;
+    }
+    make_object_static( shared_table_mapping );
+    shared_windows = ptr;
+}
+
+/* get the shared table entry of a window */
+static inline volatile struct window_shared *get_shared_entry( struct window *win )
+{
+    if (!shared_windows) return NULL;
+    return &shared_windows[(((unsigned long)win->handle & 0xffff) - FIRST_USER_HANDLE) >> 1];
+}
+
+/* publish the current state of a window in the shared table */
+static void update_shared_window( struct window *win )
+{
+    volatile struct window_shared *entry = get_shared_entry( win );
+
+    if (!entry) return;
+    entry->seq++;  /* odd: update in progress */
+    entry->handle   = win->handle;
+    entry->tid      = win->thread ? get_thread_id( win->thread ) : 0;
+    entry->pid      = win->thread ? get_process_id( win->thread->process ) : 0;
+    entry->parent   = win->parent ? win->parent->handle : 0;
+    entry->owner    = win->owner;
+    entry->style    = win->style;
+    entry->ex_style = win->ex_style;
+    entry->window   = win->window_rect;
+    entry->client   = win->client_rect;
+    entry->seq++;
+}
+
+/* remove a window from the shared table */
+static void remove_shared_window( struct window *win )
+{
+    volatile struct window_shared *entry = get_shared_entry( win );
+
+    if (!entry) return;
+    entry->seq++;
+    entry->handle = 0;
+    entry->seq++;
+}
+
 /* retrieve a pointer to a window from its handle */
 static inline struct window *get_window( user_handle_t handle )
 {
@@ -201,6 +263,7 @@ static void link_window( struct window *win, struct window *previous )
     }
 
     win->is_linked = 1;
+    update_shared_window( win );
 }
 
 /* change the parent of a window (or unlink the window if the new parent is NULL) */
@@ -234,6 +297,7 @@ static int set_parent_window( struct window *win, struct window *parent )
         list_add_head( &win->parent->unlinked, &win->entry );
         win->is_linked = 0;
     }
+    update_shared_window( win );
     return 1;
 }
 
@@ -388,6 +452,7 @@ void destroy_window( struct window *win )
     if (win == shell_listview) shell_listview = NULL;
     if (win == progman_window) progman_window = NULL;
     if (win == taskman_window) taskman_window = NULL;
+    remove_shared_window( win );
     free_user_handle( win->handle );
     destroy_properties( win );
     list_remove( &win->entry );
@@ -521,6 +586,8 @@ static struct window *create_window( struct window *parent, struct window *owner
     }
 
     current->desktop_users++;
+    init_shared_window_table();
+    update_shared_window( win );
     return win;
 
 failed:
@@ -1545,6 +1612,7 @@ static void set_window_pos( struct window *win, struct window *previous,
     if (!(swp_flags & SWP_NOZORDER) && win->parent) link_window( win, previous );
     if (swp_flags & SWP_SHOWWINDOW) win->style |= WS_VISIBLE;
     else if (swp_flags & SWP_HIDEWINDOW) win->style &= ~WS_VISIBLE;
+    update_shared_window( win );
 
     /* assume the visible rect stays at the same offset from the window rect */
     win->visible_rect.left   += window_rect->left   - old_window_rect.left;
@@ -1800,7 +1868,11 @@ DECL_HANDLER(destroy_window)
     if (win)
     {
         if (!is_desktop_window(win)) destroy_window( win );
-        else if (win->thread == current) detach_window_thread( win );
+        else if (win->thread == current)
+        {
+            detach_window_thread( win );
+            update_shared_window( win );
+        }
         else set_error( STATUS_ACCESS_DENIED );
     }
 }
@@ -1819,6 +1891,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->top_window );
             desktop->top_window->style  = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_shared_window( desktop->top_window );
         }
     }
 
@@ -1831,6 +1904,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->msg_window );
             desktop->msg_window->style = WS_POPUP | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_shared_window( desktop->msg_window );
         }
     }
 
@@ -1855,6 +1929,7 @@ DECL_HANDLER(set_window_owner)
     }
     reply->prev_owner = win->owner;
     reply->full_owner = win->owner = owner ? owner->handle : 0;
+    update_shared_window( win );
 }
 
 
@@ -1927,6 +2002,8 @@ DECL_HANDLER(set_window_info)
     if (req->flags & SET_WIN_EXTRA) memcpy( win->extra_bytes + req->extra_offset,
                                             &req->extra_value, req->extra_size );
 
+    if (req->flags & (SET_WIN_STYLE | SET_WIN_EXSTYLE)) update_shared_window( win );
+
     /* changing window style triggers a non-client paint */
     if (req->flags & SET_WIN_STYLE) win->paint_flags |= PAINT_NONCLIENT;
 }
@@ -2135,6 +2212,21 @@ DECL_HANDLER(get_window_rectangles)
 }
 
 
+/* get a read-only mapping of the shared window table */
+DECL_HANDLER(get_shared_window_table)
+{
+    init_shared_window_table();
+    if (!shared_windows)
+    {
+        set_error( STATUS_NOT_SUPPORTED );
+        return;
+    }
+    if ((reply->handle = alloc_handle( current->process, shared_table_mapping,
+                                       SECTION_QUERY | SECTION_MAP_READ, 0 )))
+        reply->size = NB_SHARED_WINDOWS * sizeof(*shared_windows);
+}
+
+
 /* get the window text */
 DECL_HANDLER(get_window_text)
 {